@@ -0,0 +1,434 @@
+/* benchmark.cpp
+Copyright (c) 2014 by Michael Zahniser
+
+Microbenchmarks for the parts of Endless Sky that run most often: collision
+masks and collision sets, route finding, data file parsing, condition tests,
+vector and angle math, and the draw list. Each benchmark is timed over and over
+until the total time is long enough to be accurate, and the average time for
+each item it processed is reported.
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "Angle.h"
+#include "CollisionSet.h"
+#include "ConditionSet.h"
+#include "ConditionsStore.h"
+#include "DataFile.h"
+#include "DataNode.h"
+#include "DistanceMap.h"
+#include "DrawList.h"
+#include "Files.h"
+#include "GameData.h"
+#include "Headless.h"
+#include "Mask.h"
+#include "Outfit.h"
+#include "Point.h"
+#include "Projectile.h"
+#include "Random.h"
+#include "Ship.h"
+#include "System.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+	// Each benchmark is repeated until it has run for at least this long.
+	const double MIN_SECONDS = .5;
+	// The number of items in each batch of synthetic inputs.
+	const int BATCH = 1024;
+	
+	// Results are added to this, so that the compiler cannot skip the work.
+	volatile double sink = 0.;
+	
+	// If a filter is given, only the benchmarks whose names contain it are run.
+	string filter;
+	
+	
+	
+	// Time the given function, which processes the given number of items each
+	// time it is called, and print how long each item took.
+	void Run(const string &name, int items, const function<void()> &work)
+	{
+		if(!filter.empty() && name.find(filter) == string::npos)
+			return;
+		
+		// Call the function once first, so that any caches are warmed up.
+		work();
+		
+		int64_t calls = 1;
+		double seconds = 0.;
+		while(true)
+		{
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			for(int64_t i = 0; i < calls; ++i)
+				work();
+			seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+			if(seconds >= MIN_SECONDS)
+				break;
+			calls *= 2;
+		}
+		printf("%-40s%12.1f ns%14lld items\n", name.c_str(),
+			seconds * 1e9 / (calls * items), static_cast<long long>(calls * items));
+		fflush(stdout);
+	}
+	
+	
+	
+	Point RandomPoint(double range)
+	{
+		return Point((2. * Random::Real() - 1.) * range, (2. * Random::Real() - 1.) * range);
+	}
+	
+	
+	
+	// Get every ship model that has a sprite, and therefore a collision mask.
+	vector<const Ship *> ShipModels()
+	{
+		vector<const Ship *> models;
+		for(const auto &it : GameData::Ships())
+			if(it.second.HasSprite() && it.second.GetMask().IsLoaded())
+				models.push_back(&it.second);
+		return models;
+	}
+	
+	
+	
+	// Place copies of the given models at random in a square of the given size.
+	vector<Ship> PlaceShips(const vector<const Ship *> &models, int count, double range)
+	{
+		vector<Ship> ships;
+		ships.reserve(count);
+		for(int i = 0; i < count; ++i)
+		{
+			ships.emplace_back(*models[i % models.size()]);
+			ships.back().Place(RandomPoint(range), RandomPoint(5.), Angle::Random());
+		}
+		return ships;
+	}
+	
+	
+	
+	void BenchmarkMasks(const vector<const Ship *> &models)
+	{
+		// Lines that start outside each mask and point toward somewhere near
+		// its center, so that some of them hit and some of them miss.
+		class Query {
+		public:
+			const Mask *mask;
+			Point from;
+			Point velocity;
+			Angle facing;
+		};
+		vector<Query> queries;
+		for(int i = 0; i < BATCH; ++i)
+		{
+			const Ship &model = *models[i % models.size()];
+			double radius = model.Radius();
+			Point from = Angle::Random().Unit() * (radius + 50.);
+			Point to = RandomPoint(radius);
+			queries.push_back({&model.GetMask(), from, (to - from) * 1.2, Angle::Random()});
+		}
+		
+		Run("Mask::Collide", BATCH, [&queries]()
+		{
+			double sum = 0.;
+			for(const Query &query : queries)
+				sum += query.mask->Collide(query.from, query.velocity, query.facing);
+			sink += sum;
+		});
+		Run("Mask::Contains", BATCH, [&queries]()
+		{
+			int sum = 0;
+			for(const Query &query : queries)
+				sum += query.mask->Contains(query.from + query.velocity * .5, query.facing);
+			sink += sum;
+		});
+	}
+	
+	
+	
+	void BenchmarkCollisionSet(const vector<const Ship *> &models)
+	{
+		// Ships spread out over an area about the size of a busy battle.
+		const int SHIPS = 256;
+		const double RANGE = 4000.;
+		vector<Ship> ships = PlaceShips(models, SHIPS, RANGE);
+		CollisionSet set(256, 32);
+		int step = 0;
+		
+		Run("CollisionSet Add + Finish", SHIPS, [&]()
+		{
+			set.Clear(++step);
+			for(Ship &ship : ships)
+				set.Add(ship);
+			set.Finish();
+		});
+		
+		// Projectiles fired by a ship with no government hit everything.
+		const Outfit *weapon = nullptr;
+		for(const auto &it : GameData::Outfits())
+			if(it.second.IsWeapon() && it.second.Velocity() > 0. && it.second.WeaponSprite().HasSprite())
+			{
+				weapon = &it.second;
+				break;
+			}
+		if(!weapon)
+			return;
+		
+		const Ship &parent = ships.front();
+		vector<Projectile> projectiles;
+		for(int i = 0; i < BATCH; ++i)
+			projectiles.emplace_back(parent, RandomPoint(RANGE), Angle::Random(), weapon);
+		
+		Run("CollisionSet::Line", BATCH, [&]()
+		{
+			double sum = 0.;
+			for(const Projectile &projectile : projectiles)
+			{
+				double closest = 1.;
+				sum += (set.Line(projectile, &closest) != nullptr) + closest;
+			}
+			sink += sum;
+		});
+		vector<CollisionSet::Hit> hits;
+		Run("CollisionSet::Lines", BATCH, [&]()
+		{
+			set.Lines(projectiles, hits);
+			sink += hits.front().range;
+		});
+		
+		vector<Point> centers;
+		for(int i = 0; i < BATCH; ++i)
+			centers.push_back(RandomPoint(RANGE));
+		vector<Body *> inRange;
+		Run("CollisionSet::Circle", BATCH, [&]()
+		{
+			size_t sum = 0;
+			for(const Point &center : centers)
+			{
+				inRange.clear();
+				set.Circle(center, 500., inRange);
+				sum += inRange.size();
+			}
+			sink += sum;
+		});
+	}
+	
+	
+	
+	void BenchmarkDistanceMap()
+	{
+		// Find routes from a few widely separated systems.
+		vector<const System *> systems;
+		for(const auto &it : GameData::Systems())
+			if(!it.second.Name().empty() && !it.second.Links().empty())
+				systems.push_back(&it.second);
+		if(systems.empty())
+			return;
+		
+		vector<const System *> centers;
+		for(int i = 0; i < 8; ++i)
+			centers.push_back(systems[(i * systems.size()) / 8]);
+		
+		Run("DistanceMap (whole map)", centers.size(), [&centers]()
+		{
+			int sum = 0;
+			for(const System *center : centers)
+				sum += DistanceMap(center).Days(center);
+			sink += sum;
+		});
+		Run("DistanceMap (10 jumps)", centers.size(), [&centers]()
+		{
+			int sum = 0;
+			for(const System *center : centers)
+				sum += DistanceMap(center, -1, 10).Days(center);
+			sink += sum;
+		});
+	}
+	
+	
+	
+	void BenchmarkDataFile()
+	{
+		// The biggest real data file, and a synthetic file with many small
+		// nodes nested a few levels deep.
+		string real = Files::Read(Files::Data() + "map.txt");
+		ostringstream out;
+		for(int i = 0; i < 2000; ++i)
+		{
+			out << "ship \"Synthetic " << i << "\"\n";
+			out << "\tattributes\n";
+			out << "\t\t\"hull\" " << 1000 + i << "\n";
+			out << "\t\t\"shields\" " << 2000.5 + i << "\n";
+			out << "\t\tcategory \"Medium Warship\"\n";
+			out << "\toutfits\n";
+			for(int j = 0; j < 8; ++j)
+				out << "\t\t\"Outfit " << j << "\" " << j + 1 << "\n";
+			out << "\tdescription `A synthetic ship, for benchmarking.`\n";
+		}
+		string synthetic = out.str();
+		
+		// Report the time per kilobyte, since the files are very different sizes.
+		for(int i = 0; i < 2; ++i)
+		{
+			const string &text = i ? synthetic : real;
+			if(text.empty())
+				continue;
+			Run(i ? "DataFile (synthetic, per kB)" : "DataFile (map.txt, per kB)", text.size() / 1024 + 1, [&text]()
+			{
+				istringstream in(text);
+				DataFile file(in);
+				sink += (file.begin() != file.end());
+			});
+		}
+	}
+	
+	
+	
+	void BenchmarkConditions()
+	{
+		// A typical mission's conditions, with a nested "or" block.
+		istringstream in(
+			"to offer\n"
+			"\t\"combat rating\" > 100\n"
+			"\thas \"event: war begins\"\n"
+			"\tnot \"Synthetic Mission: done\"\n"
+			"\t\"reputation: Republic\" >= 10\n"
+			"\tor\n"
+			"\t\t\"cargo space\" >= 50\n"
+			"\t\thas \"license: Navy\"\n"
+			"\trandom < 60\n");
+		DataFile file(in);
+		ConditionSet conditions;
+		for(const DataNode &node : file)
+			conditions.Load(node);
+		
+		// A player who has been playing for a while has a lot of conditions.
+		ConditionsStore store;
+		for(int i = 0; i < 500; ++i)
+			store["Synthetic " + to_string(i)] = i;
+		store["combat rating"] = 200;
+		store["event: war begins"] = 1;
+		store["reputation: Republic"] = 20;
+		store["cargo space"] = 100;
+		
+		Run("ConditionSet::Test", BATCH, [&]()
+		{
+			int sum = 0;
+			for(int i = 0; i < BATCH; ++i)
+			{
+				store["random"] = i % 100;
+				sum += conditions.Test(store);
+			}
+			sink += sum;
+		});
+	}
+	
+	
+	
+	void BenchmarkMath()
+	{
+		vector<Point> points;
+		vector<Angle> angles;
+		for(int i = 0; i < BATCH; ++i)
+		{
+			points.push_back(RandomPoint(1000.));
+			angles.push_back(Angle::Random());
+		}
+		
+		Run("Point::Unit + Length", BATCH, [&points]()
+		{
+			double sum = 0.;
+			for(const Point &point : points)
+				sum += point.Unit().X() + point.Length();
+			sink += sum;
+		});
+		Run("Angle(Point)", BATCH, [&points]()
+		{
+			double sum = 0.;
+			for(const Point &point : points)
+				sum += Angle(point).Degrees();
+			sink += sum;
+		});
+		Run("Angle::Unit + Rotate", BATCH, [&points, &angles]()
+		{
+			Point sum;
+			for(int i = 0; i < BATCH; ++i)
+				sum += angles[i].Unit() + angles[i].Rotate(points[i]);
+			sink += sum.X();
+		});
+	}
+	
+	
+	
+	void BenchmarkDrawList(const vector<const Ship *> &models)
+	{
+		// About half of these ships are on screen.
+		const int SHIPS = 512;
+		vector<Ship> ships = PlaceShips(models, SHIPS, 1500.);
+		DrawList list;
+		int step = 0;
+		
+		Run("DrawList::Add", SHIPS, [&]()
+		{
+			list.Clear(++step);
+			list.SetCenter(Point(), Point(3., 1.));
+			int sum = 0;
+			for(const Ship &ship : ships)
+				sum += list.Add(ship);
+			sink += sum;
+		});
+	}
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	// Any argument that is not a path for the game (see Files::Init()) is the
+	// filter for which benchmarks to run.
+	for(int i = 1; i < argc; ++i)
+	{
+		if(!strcmp(argv[i], "-r") || !strcmp(argv[i], "-c") || !strcmp(argv[i], "--resources")
+				|| !strcmp(argv[i], "--config"))
+			++i;
+		else
+			filter = argv[i];
+	}
+	
+	// Load the game data the same way a headless "--benchmark" run does, so
+	// no window or OpenGL context is needed.
+	Headless::Init(argv);
+	Random::Seed(0);
+	
+	vector<const Ship *> models = ShipModels();
+	if(models.empty())
+	{
+		fprintf(stderr, "No ship sprites were found. Check the resource path (-r).\n");
+		return 1;
+	}
+	
+	printf("%-40s%15s%20s\n", "benchmark", "time per item", "items");
+	BenchmarkMasks(models);
+	BenchmarkCollisionSet(models);
+	BenchmarkDistanceMap();
+	BenchmarkDataFile();
+	BenchmarkConditions();
+	BenchmarkMath();
+	BenchmarkDrawList(models);
+	return 0;
+}
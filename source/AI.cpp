@@ -15,7 +15,6 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Armament.h"
 #include "Audio.h"
 #include "Command.h"
-#include "DistanceMap.h"
 #include "Flotsam.h"
 #include "Government.h"
 #include "Mask.h"
@@ -27,19 +26,40 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Point.h"
 #include "Preferences.h"
 #include "Random.h"
+#include "RouteTable.h"
 #include "Ship.h"
 #include "ShipEvent.h"
 #include "System.h"
+#include "ThreadPool.h"
 
-#include <SDL2/SDL.h>
-
+#include <algorithm>
 #include <cmath>
 #include <limits>
 #include <set>
+#include <vector>
 
 using namespace std;
 
 namespace {
+	// IDs of the attributes that are looked up every frame.
+	const int AFTERBURNER_FUEL = Outfit::AttributeID("afterburner fuel");
+	const int AFTERBURNER_THRUST = Outfit::AttributeID("afterburner thrust");
+	const int ATMOSPHERE_SCAN = Outfit::AttributeID("atmosphere scan");
+	const int CARGO_SCAN = Outfit::AttributeID("cargo scan");
+	const int CARGO_SCAN_POWER = Outfit::AttributeID("cargo scan power");
+	const int CLOAK = Outfit::AttributeID("cloak");
+	const int CLOAKING_FUEL = Outfit::AttributeID("cloaking fuel");
+	const int DRAG = Outfit::AttributeID("drag");
+	const int FUEL_CAPACITY = Outfit::AttributeID("fuel capacity");
+	const int HYPERDRIVE = Outfit::AttributeID("hyperdrive");
+	const int JUMP_DRIVE = Outfit::AttributeID("jump drive");
+	const int JUMP_SPEED = Outfit::AttributeID("jump speed");
+	const int OUTFIT_SCAN = Outfit::AttributeID("outfit scan");
+	const int OUTFIT_SCAN_POWER = Outfit::AttributeID("outfit scan power");
+	const int RAMSCOOP = Outfit::AttributeID("ramscoop");
+	const int REVERSE_THRUST = Outfit::AttributeID("reverse thrust");
+	const int SCRAM_DRIVE = Outfit::AttributeID("scram drive");
+	
 	const Command &AutopilotCancelKeys()
 	{
 		static const Command keys(Command::LAND | Command::JUMP | Command::BOARD | Command::AFTERBURNER
@@ -51,7 +71,7 @@ namespace {
 	bool IsStranded(const Ship &ship)
 	{
 		return ship.GetSystem() && !ship.GetSystem()->HasFuelFor(ship) && ship.JumpFuel()
-			&& ship.Attributes().Get("fuel capacity") && !ship.JumpsRemaining();
+			&& ship.Attributes().Get(FUEL_CAPACITY) && !ship.JumpsRemaining();
 	}
 	
 	bool CanBoard(const Ship &ship, const Ship &target)
@@ -71,13 +91,64 @@ namespace {
 		return min(a, 360. - a);
 	}
 	
+	// Forget what was recorded about ships that are no longer in play. These
+	// records are keyed by each ship's address, and a new ship might be created
+	// at the same address as one that was just destroyed.
+	template <class Records>
+	void EraseRemoved(Records &records, const vector<const Ship *> &inPlay)
+	{
+		for(auto it = records.begin(); it != records.end(); )
+		{
+			if(binary_search(inPlay.begin(), inPlay.end(), it->first))
+				++it;
+			else
+				it = records.erase(it);
+		}
+	}
+	
 	static const double MAX_DISTANCE_FROM_CENTER = 10000.;
+	
+	// Ships that are far away from the player and not fighting anyone do not
+	// need to decide what to do every step, and ships in other systems need to
+	// do so even less often. In between, they keep doing what they were doing.
+	static const int IDLE_INTERVAL = 2;
+	static const int ABSENT_INTERVAL = 4;
+	static const double IDLE_DISTANCE = 4000.;
+	// No more than this many of those ships think in any one step, and the ones
+	// that have waited the longest go first. This is a count of ships rather
+	// than a time limit, so that a replay makes the same decisions every time.
+	static const size_t THINK_BUDGET = 32;
+	
+	// Check if this ship is one that can think less often than every step.
+	// The player's ships and any ship that is in the middle of landing,
+	// launching, or jumping always think.
+	bool IsIdle(const Ship &ship, const Ship *flagship, bool isPresent)
+	{
+		if(ship.IsYours() || ship.Zoom() != 1. || ship.IsLanding() || ship.IsHyperspacing())
+			return false;
+		if(!isPresent)
+			return true;
+		return (flagship && !ship.GetTargetShip()
+			&& ship.Position().Distance(flagship->Position()) > IDLE_DISTANCE);
+	}
+	
+	// A ship that is not thinking this step goes on moving the way it was
+	// last told to, but it does not keep turning or firing without looking.
+	void KeepMoving(Ship &ship)
+	{
+		Command command;
+		for(Command bit : {Command::FORWARD, Command::BACK, Command::AFTERBURNER,
+				Command::LAND, Command::JUMP, Command::CLOAK})
+			if(ship.Commands().Has(bit))
+				command |= bit;
+		ship.SetCommands(command);
+	}
 }
 
 
 
 AI::AI(const List<Ship> &ships, const List<Minable> &minables, const List<Flotsam> &flotsam)
-	: ships(ships), minables(minables), flotsam(flotsam)
+	: ships(ships), minables(minables), flotsam(flotsam), strengthGrid(1024, 32), targetGrid(1024, 32)
 {
 }
 
@@ -108,14 +179,14 @@ void AI::IssueMoveTarget(const PlayerInfo &player, const Point &target)
 
 
 // Commands issued via the keyboard (mostly, to the flagship).
-void AI::UpdateKeys(PlayerInfo &player, Command &clickCommands, bool isActive)
+void AI::UpdateKeys(PlayerInfo &player, Command &clickCommands, Command keys, bool shift, bool isActive)
 {
-	shift = (SDL_GetModState() & KMOD_SHIFT);
-	escortsUseAmmo = Preferences::Has("Escorts expend ammo");
-	escortsAreFrugal = Preferences::Has("Escorts use ammo frugally");
+	this->shift = shift;
+	escortsUseAmmo = Preferences::Has(Preferences::ESCORTS_EXPEND_AMMO);
+	escortsAreFrugal = Preferences::Has(Preferences::ESCORTS_USE_AMMO_FRUGALLY);
 	
 	Command oldHeld = keyHeld;
-	keyHeld.ReadKeyboard();
+	keyHeld = keys;
 	keyStuck |= clickCommands;
 	clickCommands.Clear();
 	keyDown = keyHeld.AndNot(oldHeld);
@@ -140,7 +211,7 @@ void AI::UpdateKeys(PlayerInfo &player, Command &clickCommands, bool isActive)
 	// Only toggle the "cloak" command if one of your ships has a cloaking device.
 	if(keyDown.Has(Command::CLOAK))
 		for(const auto &it : player.Ships())
-			if(!it->IsParked() && it->Attributes().Get("cloak"))
+			if(!it->IsParked() && it->Attributes().Get(CLOAK))
 			{
 				isCloaking = !isCloaking;
 				Messages::Add(isCloaking ? "Engaging cloaking device." : "Disengaging cloaking device.");
@@ -203,8 +274,35 @@ void AI::UpdateKeys(PlayerInfo &player, Command &clickCommands, bool isActive)
 
 
 
-void AI::UpdateEvents(const list<ShipEvent> &events)
+// Replace the held steering and firing keys with a more recent reading of
+// the keyboard, taken just before the ships move.
+void AI::LatchKeys(Command keys)
+{
+	// Only keys that act for as long as they are held down are updated. Keys
+	// that trigger an action when first pressed, or that engage or cancel the
+	// autopilot, are still handled once per step by UpdateKeys().
+	static const Command LATE_KEYS(Command::FORWARD | Command::LEFT | Command::RIGHT | Command::BACK
+		| Command::PRIMARY | Command::SECONDARY | Command::AFTERBURNER);
+	if(keyStuck)
+		return;
+	
+	keyHeld = keyHeld.AndNot(LATE_KEYS) | (keys & LATE_KEYS);
+}
+
+
+
+void AI::UpdateEvents(const vector<ShipEvent> &events)
 {
+	// In a battle, the player may commit the same offense against the same
+	// government many times in a row. Each offense must check the attitude of
+	// every government toward the one that was offended, so add up each run
+	// of identical offenses and apply it once. The order of offenses matters,
+	// because an atrocity sets any positive reputation to zero before its
+	// penalty is applied, so only consecutive offenses are combined, and
+	// atrocities are never combined at all.
+	const Government *offended = nullptr;
+	int offense = 0;
+	int offenseCount = 0;
 	for(const ShipEvent &event : events)
 	{
 		if(event.Actor() && event.Target())
@@ -219,9 +317,26 @@ void AI::UpdateEvents(const list<ShipEvent> &events)
 			// If you provoke the same ship twice, it should have an effect both times.
 			if(event.Type() & ShipEvent::PROVOKE)
 				newActions |= ShipEvent::PROVOKE;
-			event.TargetGovernment()->Offend(newActions, event.Target()->RequiredCrew());
+			// Repeating an action that was already done to this ship has no
+			// effect on your reputation.
+			if(!newActions)
+				continue;
+			
+			if(offended == event.TargetGovernment() && offense == newActions
+					&& !(newActions & ShipEvent::ATROCITY))
+				offenseCount += event.Target()->RequiredCrew();
+			else
+			{
+				if(offended)
+					offended->Offend(offense, offenseCount);
+				offended = event.TargetGovernment();
+				offense = newActions;
+				offenseCount = event.Target()->RequiredCrew();
+			}
 		}
 	}
+	if(offended)
+		offended->Offend(offense, offenseCount);
 }
 
 
@@ -240,30 +355,101 @@ void AI::Clean()
 
 
 
+// Forget everything, including the player's keys and orders.
+void AI::Reset()
+{
+	Clean();
+	orders.clear();
+	step = 0;
+	keyDown.Clear();
+	keyHeld.Clear();
+	keyStuck.Clear();
+	wasHyperspacing = false;
+	isLaunching = false;
+	isCloaking = false;
+	shift = false;
+	landKeyInterval = 0;
+}
+
+
+
 void AI::Step(const PlayerInfo &player)
 {
+	vector<const Ship *> inPlay;
+	inPlay.reserve(ships.size());
+	for(const auto &it : ships)
+		inPlay.push_back(it.get());
+	sort(inPlay.begin(), inPlay.end());
+	EraseRemoved(swarmCount, inPlay);
+	EraseRemoved(miningAngle, inPlay);
+	EraseRemoved(miningTime, inPlay);
+	EraseRemoved(appeasmentThreshold, inPlay);
+	EraseRemoved(shipStrength, inPlay);
+	EraseRemoved(lastThought, inPlay);
+	
+	// Sort the ships by system and government.
+	shipOrder.clear();
+	rosters.clear();
+	for(const auto &it : ships)
+		if(it->GetSystem() && it->GetGovernment())
+		{
+			rosters[it->GetSystem()][it->GetGovernment()].push_back(shipOrder.size());
+			shipOrder.push_back(it);
+		}
+	
 	// First, figure out the comparative strengths of the present governments.
 	map<const Government *, int64_t> strength;
+	strengthGrid.Clear();
 	for(const auto &it : ships)
 		if(it->GetGovernment() && it->GetSystem() == player.GetSystem() && !it->IsDisabled())
+		{
 			strength[it->GetGovernment()] += it->Cost();
+			strengthGrid.Add(it, it->Position());
+		}
+	strengthGrid.Finish();
+	
+	// Ships pick their targets based on where the targets will be a second from
+	// now, so sort them by that position.
+	targetGrid.Clear();
+	for(const auto &it : ships)
+		if(it->GetSystem() == player.GetSystem())
+			targetGrid.Add(it, it->Position() + 60. * it->Velocity());
+	targetGrid.Finish();
+	
+	// Which governments are enemies or allies of which others only needs to be
+	// figured out again when a government arrives or leaves. Attitudes toward
+	// the player can also change at any time, so refresh it twice a second.
+	bool governmentsChanged = (!step || relations.size() != strength.size());
+	auto rit = relations.begin();
+	for(auto sit = strength.begin(); !governmentsChanged && sit != strength.end(); ++sit, ++rit)
+		governmentsChanged = (sit->first != rit->first);
+	if(governmentsChanged)
+	{
+		relations.clear();
+		for(const auto &it : strength)
+		{
+			Relations &relation = relations[it.first];
+			set<const Government *> allies;
+			for(const auto &eit : strength)
+				if(eit.first->IsEnemy(it.first))
+				{
+					relation.enemies.push_back(eit.first);
+					for(const auto &ait : strength)
+						if(ait.first->IsEnemy(eit.first) && allies.insert(ait.first).second)
+							relation.allies.push_back(ait.first);
+				}
+		}
+	}
 	enemyStrength.clear();
 	allyStrength.clear();
-	for(const auto &it : strength)
+	for(const auto &it : relations)
 	{
-		set<const Government *> allies;
-		for(const auto &eit : strength)
-			if(eit.first->IsEnemy(it.first))
-			{
-				enemyStrength[it.first] += eit.second;
-				for(const auto &ait : strength)
-					if(ait.first->IsEnemy(eit.first) && !allies.count(ait.first))
-					{
-						allyStrength[it.first] += ait.second;
-						allies.insert(ait.first);
-					}
-			}
+		for(const Government *enemy : it.second.enemies)
+			enemyStrength[it.first] += strength[enemy];
+		for(const Government *ally : it.second.allies)
+			allyStrength[it.first] += strength[ally];
 	}
+	
 	for(const auto &it : ships)
 	{
 		const Government *gov = it->GetGovernment();
@@ -272,21 +458,49 @@ void AI::Step(const PlayerInfo &player)
 			continue;
 		
 		int64_t &strength = shipStrength[it.get()];
-		for(const auto &oit : ships)
+		strengthGrid.Circle(it->Position(), 2000., strengthResult);
+		for(size_t i : strengthResult)
 		{
-			const Government *ogov = oit->GetGovernment();
-			if(!ogov || oit->GetSystem() != player.GetSystem() || oit->IsDisabled())
-				continue;
-			
-			if(ogov->AttitudeToward(gov) > 0. && oit->Position().Distance(it->Position()) < 2000.)
+			const shared_ptr<Ship> &oit = strengthGrid.At(i);
+			if(oit->GetGovernment()->AttitudeToward(gov) > 0. && oit->Position().Distance(it->Position()) < 2000.)
 				strength += oit->Cost();
 		}
-	}		
+	}
 	
 	const Ship *flagship = player.Flagship();
 	step = (step + 1) & 31;
+	++thinkStep;
 	int targetTurn = 0;
+	
+	// Figure out which of the idle ships that are due to think this step have
+	// waited the longest. Ships that have never thought go first of all.
+	vector<int> waiting;
+	for(const auto &it : ships)
+	{
+		bool isPresent = (it->GetSystem() == player.GetSystem());
+		if(!it->GetSystem() || it.get() == flagship || !IsIdle(*it, flagship, isPresent))
+			continue;
+		auto lit = lastThought.find(it.get());
+		int last = (lit == lastThought.end() ? numeric_limits<int>::min() : lit->second);
+		if(lit == lastThought.end() || thinkStep - last >= (isPresent ? IDLE_INTERVAL : ABSENT_INTERVAL))
+			waiting.push_back(last);
+	}
+	// If more ships are due than the budget allows, only the ones that last
+	// thought before the cutoff get to think, plus enough of the ones that last
+	// thought right on it (in list order) to fill up the budget.
+	int cutoff = numeric_limits<int>::max();
+	size_t onCutoff = waiting.size();
+	if(waiting.size() > THINK_BUDGET)
+	{
+		nth_element(waiting.begin(), waiting.begin() + (THINK_BUDGET - 1), waiting.end());
+		cutoff = waiting[THINK_BUDGET - 1];
+		onCutoff = THINK_BUDGET - count_if(waiting.begin(), waiting.end(),
+			[cutoff](int last) { return last < cutoff; });
+	}
+	
 	int minerCount = 0;
+	for(vector<Decision> &wave : waves)
+		wave.clear();
 	for(const auto &it : ships)
 	{
 		// Skip any carried fighters or drones that are somehow in the list.
@@ -313,47 +527,51 @@ void AI::Step(const PlayerInfo &player)
 			Ship *firstAlly = nullptr;
 			bool selectNext = false;
 			Ship *nextAlly = nullptr;
-			for(const auto &ship : ships)
-			{
-				// Never ask yourself for help.
-				if(ship.get() == it.get())
-					continue;
-				if(ship->IsDisabled() || !ship->IsTargetable() || ship->GetSystem() != it->GetSystem())
-					continue;
-				// Fighters and drones can't offer assistance.
-				if(ship->CanBeCarried())
-					continue;
-				
-				const Government *otherGov = ship->GetGovernment();
-				// If any enemies of this ship are in system, it cannot call for help.
-				if(otherGov->IsEnemy(gov) && isPresent)
-				{
-					hasEnemy = true;
-					break;
-				}
-				// Don't ask for help from a ship that is already helping someone.
-				if(ship->GetShipToAssist() && ship->GetShipToAssist().get() != it.get())
-					continue;
-				// Your escorts only help other escorts, and your flagship never helps.
-				if((otherGov->IsPlayer() && !gov->IsPlayer()) || ship.get() == flagship)
-					continue;
-				// Your escorts should not help each other if already under orders.
-				if(otherGov->IsPlayer() && gov->IsPlayer() && orders.count(ship.get()))
-					continue;
-				
-				if(it->IsDisabled() ? (otherGov == gov) : (!otherGov->IsEnemy(gov)))
+			// Ships outside the player's system cannot be targeted, so there is
+			// no point in looking for one that can help.
+			if(isPresent)
+				for(const auto &ship : ships)
 				{
-					if(isStranded && !ship->CanRefuel(*it))
+					// Never ask yourself for help.
+					if(ship.get() == it.get())
+						continue;
+					if(ship->IsDisabled() || !ship->IsTargetable() || ship->GetSystem() != it->GetSystem())
+						continue;
+					// Fighters and drones can't offer assistance.
+					if(ship->CanBeCarried())
 						continue;
 					
-					if(!firstAlly)
-						firstAlly = &*ship;
-					else if(ship == it)
-						selectNext = true;
-					else if(selectNext && !nextAlly)
-						nextAlly = &*ship;
+					const Government *otherGov = ship->GetGovernment();
+					// If any enemies of this ship are in system, it cannot call for help.
+					if(otherGov->IsEnemy(gov))
+					{
+						hasEnemy = true;
+						break;
+					}
+					// Don't ask for help from a ship that is already helping someone.
+					if(ship->GetShipToAssist() && ship->GetShipToAssist().get() != it.get())
+						continue;
+					// Your escorts only help other escorts, and your flagship never helps.
+					if((otherGov->IsPlayer() && !gov->IsPlayer()) || ship.get() == flagship)
+						continue;
+					// Your escorts should not help each other if already under orders.
+					if(otherGov->IsPlayer() && gov->IsPlayer() && orders.count(ship.get()))
+						continue;
+					
+					if(it->IsDisabled() ? (otherGov == gov) : (!otherGov->IsEnemy(gov)))
+					{
+						if(isStranded && !ship->CanRefuel(*it))
+							continue;
+						
+						if(!firstAlly)
+							firstAlly = &*ship;
+						else if(ship == it)
+							selectNext = true;
+						else if(selectNext && !nextAlly)
+							nextAlly = &*ship;
+					}
 				}
-			}
+				
 			
 			isStranded = false;
 			if(!hasEnemy)
@@ -434,201 +652,311 @@ void AI::Step(const PlayerInfo &player)
 			continue;
 		}
 		
-		if(isPresent && personality.IsSurveillance())
-		{
-			DoSurveillance(*it, command);
-			it->SetCommands(command);
-			continue;
+		// Everything that involves a ship other than this one (asking for
+		// help, swarming, picking a parent) has now been done. The rest of this
+		// ship's decisions only affect itself, so they can be made in parallel.
+		// Idle ships only make new decisions every few steps.
+		if(IsIdle(*it, flagship, isPresent))
+		{
+			auto lit = lastThought.find(it.get());
+			bool isDue = (lit == lastThought.end()
+				|| thinkStep - lit->second >= (isPresent ? IDLE_INTERVAL : ABSENT_INTERVAL));
+			int last = (lit == lastThought.end() ? numeric_limits<int>::min() : lit->second);
+			if(isDue && last == cutoff)
+			{
+				isDue = (onCutoff > 0);
+				onCutoff -= isDue;
+			}
+			else if(isDue)
+				isDue = (last < cutoff);
+			if(!isDue)
+			{
+				KeepMoving(*it);
+				continue;
+			}
+			lastThought[it.get()] = thinkStep;
 		}
-		// Pick a target and automatically fire weapons.
-		if(isPresent)
+		
+		Decision decision;
+		decision.ship = it.get();
+		decision.command = command;
+		decision.isStranded = isStranded;
+		bool isSurveilling = (isPresent && personality.IsSurveillance());
+		if(isPresent && !isSurveilling)
 		{
 			// Each ship only switches targets twice a second, so that it can
 			// focus on damaging one particular ship.
 			targetTurn = (targetTurn + 1) & 31;
-			if(targetTurn == step || !target || !target->IsTargetable() || target->IsDestroyed()
-					|| (target->IsDisabled() && personality.Disables()))
-				it->SetTargetShip(FindTarget(*it));
+			decision.targetTurn = targetTurn;
 			
-			command |= AutoFire(*it);
+			// Limit how many ships can be mining at once.
+			decision.isMining = (personality.IsMining() && !target
+				&& it->Cargo().Free() >= 5 && ++miningTime[&*it] < 3600 && ++minerCount < 9);
 		}
-		if(isPresent && personality.Harvests() && DoHarvesting(*it, command))
+		if(!isSurveilling && !decision.isMining)
 		{
-			it->SetCommands(command);
-			continue;
-		}
-		if(isPresent && personality.IsMining() && !target
-				&& it->Cargo().Free() >= 5 && ++miningTime[&*it] < 3600 && ++minerCount < 9)
-		{
-			DoMining(*it, command);
-			it->SetCommands(command);
-			continue;
-		}
-		
-		// Special actions when a ship is near death:
-		if(health < 1.)
-		{
-			if(parent && personality.IsCoward())
-			{
-				// Cowards abandon their fleets.
-				parent.reset();
-				it->SetParent(parent);
-			}
-			if(personality.IsAppeasing() && it->Cargo().Used())
+			// Special actions when a ship is near death:
+			if(health < 1.)
 			{
-				double &threshold = appeasmentThreshold[it.get()];
-				if(1. - health > threshold)
+				if(parent && personality.IsCoward())
+				{
+					// Cowards abandon their fleets.
+					parent.reset();
+					it->SetParent(parent);
+				}
+				if(personality.IsAppeasing() && it->Cargo().Used())
 				{
-					// "Appeasing" ships will dump some fraction of their cargo.
-					int toDump = 11 + (1. - health) * .5 * it->Cargo().Size();
-					for(const auto &commodity : it->Cargo().Commodities())
+					double &threshold = appeasmentThreshold[it.get()];
+					if(1. - health > threshold)
 					{
-						it->Jettison(commodity.first, min(commodity.second, toDump));
-						toDump -= commodity.second;
-						if(toDump <= 0)
-							break;
+						// "Appeasing" ships will dump some fraction of their cargo.
+						int toDump = 11 + (1. - health) * .5 * it->Cargo().Size();
+						for(const auto &commodity : it->Cargo().Commodities())
+						{
+							it->Jettison(commodity.first, min(commodity.second, toDump));
+							toDump -= commodity.second;
+							if(toDump <= 0)
+								break;
+						}
+						Messages::Add(it->GetGovernment()->GetName() + " ship \"" + it->Name()
+							+ "\": Please, just take my cargo and leave me alone.");
+						threshold = (1. - health) + .1;
 					}
-					Messages::Add(it->GetGovernment()->GetName() + " ship \"" + it->Name()
-						+ "\": Please, just take my cargo and leave me alone.");
-					threshold = (1. - health) + .1;
 				}
 			}
-		}
-		
-		double targetDistance = numeric_limits<double>::infinity();
-		target = it->GetTargetShip();
-		if(target)
-			targetDistance = target->Position().Distance(it->Position());
-		
-		// Handle fighters:
-		const string &category = it->Attributes().Category();
-		bool isFighter = (category == "Fighter");
-		if(it->CanBeCarried())
-		{
-			bool hasSpace = (parent && parent->BaysFree(isFighter) && !parent->GetGovernment()->IsEnemy(gov));
-			if(!hasSpace || parent->IsDestroyed() || parent->GetSystem() != it->GetSystem())
+			
+			// Handle orphaned fighters and drones.
+			if(it->CanBeCarried())
 			{
-				// Handle orphaned fighters and drones.
-				parent.reset();
-				it->SetParent(parent);
-				for(const auto &other : ships)
-					if(other->GetGovernment() == gov && !other->IsDisabled()
-							&& other->GetSystem() == it->GetSystem() && !other->CanBeCarried() && other->CanCarry(*it.get()))
+				bool isFighter = (it->Attributes().Category() == "Fighter");
+				bool hasSpace = (parent && parent->BaysFree(isFighter) && !parent->GetGovernment()->IsEnemy(gov));
+				if(!hasSpace || parent->IsDestroyed() || parent->GetSystem() != it->GetSystem())
+				{
+					parent.reset();
+					it->SetParent(parent);
+					for(int index : Roster(it->GetSystem(), gov))
 					{
-						parent = other;
-						it->SetParent(other);
-						if(other->BaysFree(isFighter))
-							break;
+						const shared_ptr<Ship> &other = shipOrder[index];
+						if(!other->IsDisabled() && !other->CanBeCarried() && other->CanCarry(*it.get()))
+						{
+							it->SetParent(other);
+							if(other->BaysFree(isFighter))
+								break;
+						}
 					}
-			}
-			else if(parent && !(it->IsYours() ? thisIsLaunching : parent->Commands().Has(Command::DEPLOY)))
-			{
-				it->SetTargetShip(parent);
-				MoveTo(*it, command, parent->Position(), parent->Velocity(), 40., .8);
-				command |= Command::BOARD;
-				it->SetCommands(command);
-				continue;
-			}
-		}
-		bool mustRecall = false;
-		if(it->HasBays() && !(it->IsYours() ? thisIsLaunching : it->Commands().Has(Command::DEPLOY)) && !target)
-			for(const weak_ptr<const Ship> &ptr : it->GetEscorts())
-			{
-				shared_ptr<const Ship> escort = ptr.lock();
-				if(escort && escort->CanBeCarried() && escort->GetSystem() == it->GetSystem()
-						&& !escort->IsDisabled())
-				{
-					mustRecall = true;
-					break;
 				}
 			}
+		}
 		
-		shared_ptr<Ship> shipToAssist = it->GetShipToAssist();
-		if(shipToAssist)
-		{
-			it->SetTargetShip(shipToAssist);
-			if(shipToAssist->IsDestroyed() || shipToAssist->GetSystem() != it->GetSystem()
-					|| shipToAssist->IsLanding() || shipToAssist->IsHyperspacing()
-					|| (!shipToAssist->IsDisabled() && shipToAssist->JumpsRemaining())
-					|| shipToAssist->GetGovernment()->IsEnemy(gov))
-				it->SetShipToAssist(shared_ptr<Ship>());
-			else if(!it->IsBoarding())
+		// Escorts look at what their parent has decided to do, so each ship
+		// must be in a later wave than its parent.
+		size_t depth = 0;
+		for(shared_ptr<const Ship> ancestor = it->GetParent(); ancestor && depth < ships.size(); ancestor = ancestor->GetParent())
+			++depth;
+		if(waves.size() <= depth)
+			waves.resize(depth + 1);
+		waves[depth].push_back(decision);
+	}
+	
+	// A ship picks a random animation frame the first time its sprite is
+	// looked at, so make sure that happens here rather than in whichever batch
+	// happens to aim at it first.
+	for(const auto &it : ships)
+		it->GetMask(step);
+	
+	// Each batch is small, because each ship's decisions involve looking at
+	// every other ship. As in Engine, the batches do not depend on the number
+	// of threads, and each one gets its own random seed.
+	static const size_t BATCH_SIZE = 8;
+	uint64_t seed = Random::NewSeed();
+	size_t batchCount = 0;
+	for(vector<Decision> &wave : waves)
+	{
+		size_t batches = (wave.size() + BATCH_SIZE - 1) / BATCH_SIZE;
+		ThreadPool::Shared().ParallelFor(batches, [this, &player, &wave, seed, batchCount](size_t batch)
+		{
+			Random::Seed(seed, batchCount + batch);
+			size_t end = min(wave.size(), (batch + 1) * BATCH_SIZE);
+			for(size_t i = batch * BATCH_SIZE; i < end; ++i)
+				StepShip(wave[i], player);
+		});
+		batchCount += batches;
+	}
+	Random::Seed(seed, batchCount);
+	
+	// Mining ships all share the record of what angle they are mining at, so
+	// they must be handled one at a time.
+	for(vector<Decision> &wave : waves)
+		for(Decision &decision : wave)
+			if(decision.isMining)
 			{
-				MoveTo(*it, command, shipToAssist->Position(), shipToAssist->Velocity(), 40., .8);
-				command |= Command::BOARD;
+				DoMining(*decision.ship, decision.command);
+				decision.ship->SetCommands(decision.command);
 			}
-			it->SetCommands(command);
-			continue;
-		}
+}
+
+
+
+// Issue commands to a ship other than the flagship. This only modifies the
+// given ship, so it may be called for several ships in parallel, as long as
+// none of them is the parent of another.
+void AI::StepShip(Decision &decision, const PlayerInfo &player)
+{
+	Ship &ship = *decision.ship;
+	Command &command = decision.command;
+	
+	const Government *gov = ship.GetGovernment();
+	bool isPresent = (ship.GetSystem() == player.GetSystem());
+	bool thisIsLaunching = (isLaunching && ship.GetSystem() == player.GetSystem());
+	
+	const Personality &personality = ship.GetPersonality();
+	shared_ptr<Ship> parent = ship.GetParent();
+	shared_ptr<const Ship> target = ship.GetTargetShip();
+	
+	if(isPresent && personality.IsSurveillance())
+	{
+		DoSurveillance(ship, command);
+		ship.SetCommands(command);
+		return;
+	}
+	// Pick a target and automatically fire weapons.
+	if(isPresent)
+	{
+		if(decision.targetTurn == step || !target || !target->IsTargetable() || target->IsDestroyed()
+				|| (target->IsDisabled() && personality.Disables()))
+			ship.SetTargetShip(FindTarget(ship));
 		
-		bool isPlayerEscort = it->IsYours();
-		if(mustRecall || isStranded)
+		command |= AutoFire(ship);
+	}
+	if(isPresent && personality.Harvests() && DoHarvesting(ship, command))
+	{
+		decision.isMining = false;
+		ship.SetCommands(command);
+		return;
+	}
+	// Mining is done once all the parallel decisions have been made.
+	if(decision.isMining)
+		return;
+	
+	double targetDistance = numeric_limits<double>::infinity();
+	target = ship.GetTargetShip();
+	if(target)
+		targetDistance = target->Position().Distance(ship.Position());
+	
+	// Handle fighters. Orphaned ones have already found a new parent.
+	const string &category = ship.Attributes().Category();
+	bool isFighter = (category == "Fighter");
+	if(ship.CanBeCarried())
+	{
+		bool hasSpace = (parent && parent->BaysFree(isFighter) && !parent->GetGovernment()->IsEnemy(gov));
+		if(hasSpace && !parent->IsDestroyed() && parent->GetSystem() == ship.GetSystem()
+				&& !(ship.IsYours() ? thisIsLaunching : parent->Commands().Has(Command::DEPLOY)))
 		{
-			// Stopping to let fighters board or to be refueled takes priority
-			// even over following orders from the player.
-			if(it->Velocity().Length() > .001 || !target)
-				Stop(*it, command);
-			else
-				command.SetTurn(TurnToward(*it, TargetAim(*it)));
+			ship.SetTargetShip(parent);
+			MoveTo(ship, command, parent->Position(), parent->Velocity(), 40., .8);
+			command |= Command::BOARD;
+			ship.SetCommands(command);
+			return;
 		}
-		else if(FollowOrders(*it, command))
+	}
+	bool mustRecall = false;
+	if(ship.HasBays() && !(ship.IsYours() ? thisIsLaunching : ship.Commands().Has(Command::DEPLOY)) && !target)
+		for(const weak_ptr<const Ship> &ptr : ship.GetEscorts())
 		{
-			// If this is an escort and it has orders to follow, no need for the
-			// AI to figure out what action it must perform.
+			shared_ptr<const Ship> escort = ptr.lock();
+			if(escort && escort->CanBeCarried() && escort->GetSystem() == ship.GetSystem()
+					&& !escort->IsDisabled())
+			{
+				mustRecall = true;
+				break;
+			}
 		}
-		// Hostile "escorts" (i.e. NPCs that are trailing you) only revert to
-		// escort behavior when in a different system from you. Otherwise,
-		// the behavior depends on what the parent is doing, whether there
-		// are hostile targets nearby, and whether the escort has any
-		// immediate needs (like refueling).
-		else if(!parent || parent->IsDestroyed() || (parent->IsDisabled() && !isPlayerEscort))
-			MoveIndependent(*it, command);
-		else if(parent->GetSystem() != it->GetSystem())
+	
+	shared_ptr<Ship> shipToAssist = ship.GetShipToAssist();
+	if(shipToAssist)
+	{
+		ship.SetTargetShip(shipToAssist);
+		if(shipToAssist->IsDestroyed() || shipToAssist->GetSystem() != ship.GetSystem()
+				|| shipToAssist->IsLanding() || shipToAssist->IsHyperspacing()
+				|| (!shipToAssist->IsDisabled() && shipToAssist->JumpsRemaining())
+				|| shipToAssist->GetGovernment()->IsEnemy(gov))
+			ship.SetShipToAssist(shared_ptr<Ship>());
+		else if(!ship.IsBoarding())
 		{
-			if(personality.IsStaying() || !it->Attributes().Get("fuel capacity"))
-				MoveIndependent(*it, command);
-			else
-				MoveEscort(*it, command);
-		}
-		// From here down, we're only dealing with ships that have a "parent"
-		// which is in the same system as them. If you're an enemy of your
-		// "parent," you don't take orders from them.
-		else if(personality.IsStaying() || parent->GetGovernment()->IsEnemy(gov))
-			MoveIndependent(*it, command);
-		// This is a friendly escort. If the parent is getting ready to
-		// jump, always follow.
-		else if(parent->Commands().Has(Command::JUMP) && it->JumpsRemaining())
-			MoveEscort(*it, command);
-		// Timid ships always stay near their parent.
-		else if(personality.IsTimid() && parent->Position().Distance(it->Position()) > 500.)
-			MoveEscort(*it, command);
-		// Otherwise, attack targets depending on how heroic you are.
-		else if(target && (targetDistance < 2000. || personality.IsHeroic()))
-			MoveIndependent(*it, command);
-		// This ship does not feel like fighting.
+			MoveTo(ship, command, shipToAssist->Position(), shipToAssist->Velocity(), 40., .8);
+			command |= Command::BOARD;
+		}
+		ship.SetCommands(command);
+		return;
+	}
+	
+	bool isPlayerEscort = ship.IsYours();
+	if(mustRecall || decision.isStranded)
+	{
+		// Stopping to let fighters board or to be refueled takes priority
+		// even over following orders from the player.
+		if(ship.Velocity().Length() > .001 || !target)
+			Stop(ship, command);
 		else
-			MoveEscort(*it, command);
-		
-		// Apply the afterburner if you're in a heated battle and it will not
-		// use up your last jump worth of fuel.
-		if(it->Attributes().Get("afterburner thrust") && target && !target->IsDisabled()
-				&& target->IsTargetable() && target->GetSystem() == it->GetSystem())
-		{
-			double fuel = it->Fuel() * it->Attributes().Get("fuel capacity");
-			if(fuel - it->Attributes().Get("afterburner fuel") >= it->JumpFuel())
-				if(command.Has(Command::FORWARD) && targetDistance < 1000.)
-					command |= Command::AFTERBURNER;
-		}
-		// Your own ships cloak on your command; all others do it when the
-		// AI considers it appropriate.
-		if(!it->IsYours())
-			DoCloak(*it, command);
-		
-		// Force ships that are overlapping each other to "scatter":
-		DoScatter(*it, command);
-		
-		it->SetCommands(command);
+			command.SetTurn(TurnToward(ship, TargetAim(ship)));
+	}
+	else if(FollowOrders(ship, command))
+	{
+		// If this is an escort and it has orders to follow, no need for the
+		// AI to figure out what action it must perform.
+	}
+	// Hostile "escorts" (i.e. NPCs that are trailing you) only revert to
+	// escort behavior when in a different system from you. Otherwise,
+	// the behavior depends on what the parent is doing, whether there
+	// are hostile targets nearby, and whether the escort has any
+	// immediate needs (like refueling).
+	else if(!parent || parent->IsDestroyed() || (parent->IsDisabled() && !isPlayerEscort))
+		MoveIndependent(ship, command);
+	else if(parent->GetSystem() != ship.GetSystem())
+	{
+		if(personality.IsStaying() || !ship.Attributes().Get(FUEL_CAPACITY))
+			MoveIndependent(ship, command);
+		else
+			MoveEscort(ship, command);
+	}
+	// From here down, we're only dealing with ships that have a "parent"
+	// which is in the same system as them. If you're an enemy of your
+	// "parent," you don't take orders from them.
+	else if(personality.IsStaying() || parent->GetGovernment()->IsEnemy(gov))
+		MoveIndependent(ship, command);
+	// This is a friendly escort. If the parent is getting ready to
+	// jump, always follow.
+	else if(parent->Commands().Has(Command::JUMP) && ship.JumpsRemaining())
+		MoveEscort(ship, command);
+	// Timid ships always stay near their parent.
+	else if(personality.IsTimid() && parent->Position().Distance(ship.Position()) > 500.)
+		MoveEscort(ship, command);
+	// Otherwise, attack targets depending on how heroic you are.
+	else if(target && (targetDistance < 2000. || personality.IsHeroic()))
+		MoveIndependent(ship, command);
+	// This ship does not feel like fighting.
+	else
+		MoveEscort(ship, command);
+	
+	// Apply the afterburner if you're in a heated battle and it will not
+	// use up your last jump worth of fuel.
+	if(ship.Attributes().Get(AFTERBURNER_THRUST) && target && !target->IsDisabled()
+			&& target->IsTargetable() && target->GetSystem() == ship.GetSystem())
+	{
+		double fuel = ship.Fuel() * ship.Attributes().Get(FUEL_CAPACITY);
+		if(fuel - ship.Attributes().Get(AFTERBURNER_FUEL) >= ship.JumpFuel())
+			if(command.Has(Command::FORWARD) && targetDistance < 1000.)
+				command |= Command::AFTERBURNER;
 	}
+	// Your own ships cloak on your command; all others do it when the
+	// AI considers it appropriate.
+	if(!ship.IsYours())
+		DoCloak(ship, command);
+	
+	// Force ships that are overlapping each other to "scatter":
+	DoScatter(ship, command);
+	
+	ship.SetCommands(command);
 }
 
 
@@ -691,7 +1019,21 @@ shared_ptr<Ship> AI::FindTarget(const Ship &ship) const
 	auto strengthIt = shipStrength.find(&ship);
 	if(!person.IsHeroic() && strengthIt != shipStrength.end())
 		maxStrength = 2 * strengthIt->second;
-	for(const auto &it : ships)
+	// Only look at ships that are close enough that they could be chosen. Being
+	// the previous target or the parent's target counts for at most 500 units,
+	// and a plunderer can also count a ship as up to 2000 units closer. So any
+	// ship farther away than that would never be picked. Nemesis ships will go
+	// after one of the player's ships no matter how far away it is.
+	double searchRadius = closest + 500. + 2000. * person.Plunders();
+	if(person.IsNemesis())
+		searchRadius = numeric_limits<double>::infinity();
+	// The grid only holds ships in the player's system, since the AI does not
+	// pick targets for ships in any other system.
+	vector<size_t> nearby;
+	targetGrid.Circle(ship.Position() + 60. * ship.Velocity(), searchRadius, nearby);
+	for(size_t index : nearby)
+	{
+		const shared_ptr<Ship> &it = targetGrid.At(index);
 		if(it->GetSystem() == system && it->IsTargetable() && gov->IsEnemy(it->GetGovernment()))
 		{
 			// If this is a "nemesis" ship and it has found one of the player's
@@ -752,14 +1094,17 @@ shared_ptr<Ship> AI::FindTarget(const Ship &ship) const
 				hasNemesis = isPotentialNemesis;
 			}
 		}
+	}
 	
-	bool cargoScan = ship.Attributes().Get("cargo scan") || ship.Attributes().Get("cargo scan power");
-	bool outfitScan = ship.Attributes().Get("outfit scan") || ship.Attributes().Get("outfit scan power");
+	bool cargoScan = ship.Attributes().Get(CARGO_SCAN) || ship.Attributes().Get(CARGO_SCAN_POWER);
+	bool outfitScan = ship.Attributes().Get(OUTFIT_SCAN) || ship.Attributes().Get(OUTFIT_SCAN_POWER);
 	if(!target && (cargoScan || outfitScan) && !isPlayerEscort)
 	{
 		closest = numeric_limits<double>::infinity();
-		for(const auto &it : ships)
-			if(it->GetSystem() == system && it->GetGovernment() != gov && it->IsTargetable())
+		vector<shared_ptr<Ship>> others;
+		OtherShips(system, gov, false, others);
+		for(const auto &it : others)
+			if(it->IsTargetable())
 			{
 				if((cargoScan && !Has(ship.GetGovernment(), it, ShipEvent::SCAN_CARGO))
 						|| (outfitScan && !Has(ship.GetGovernment(), it, ShipEvent::SCAN_OUTFITS)))
@@ -781,7 +1126,7 @@ shared_ptr<Ship> AI::FindTarget(const Ship &ship) const
 	{
 		// Make sure the ship has somewhere to flee to.
 		const System *system = ship.GetSystem();
-		if(ship.JumpsRemaining() && (!system->Links().empty() || ship.Attributes().Get("jump drive")))
+		if(ship.JumpsRemaining() && (!system->Links().empty() || ship.Attributes().Get(JUMP_DRIVE)))
 			target.reset();
 		else
 			for(const StellarObject &object : system->Objects())
@@ -889,8 +1234,8 @@ void AI::MoveIndependent(Ship &ship, Command &command) const
 	}
 	else if(target)
 	{
-		bool cargoScan = ship.Attributes().Get("cargo scan") || ship.Attributes().Get("cargo scan power");
-		bool outfitScan = ship.Attributes().Get("outfit scan") || ship.Attributes().Get("outfit scan power");
+		bool cargoScan = ship.Attributes().Get(CARGO_SCAN) || ship.Attributes().Get(CARGO_SCAN_POWER);
+		bool outfitScan = ship.Attributes().Get(OUTFIT_SCAN) || ship.Attributes().Get(OUTFIT_SCAN_POWER);
 		if((!cargoScan || Has(ship.GetGovernment(), target, ShipEvent::SCAN_CARGO))
 				&& (!outfitScan || Has(ship.GetGovernment(), target, ShipEvent::SCAN_OUTFITS)))
 			target.reset();
@@ -921,7 +1266,7 @@ void AI::MoveIndependent(Ship &ship, Command &command) const
 		
 		vector<int> systemWeights;
 		int totalWeight = 0;
-		const set<const System *> &links = ship.Attributes().Get("jump drive")
+		const set<const System *> &links = ship.Attributes().Get(JUMP_DRIVE)
 			? ship.GetSystem()->Neighbors() : ship.GetSystem()->Links();
 		if(jumps)
 		{
@@ -1005,7 +1350,7 @@ void AI::MoveIndependent(Ship &ship, Command &command) const
 	else if(ship.GetTargetStellar())
 	{
 		MoveToPlanet(ship, command);
-		if(!ship.GetPersonality().IsStaying() && ship.Attributes().Get("fuel capacity"))
+		if(!ship.GetPersonality().IsStaying() && ship.Attributes().Get(FUEL_CAPACITY))
 			command |= Command::LAND;
 		else if(ship.Position().Distance(ship.GetTargetStellar()->Position()) < 100.)
 			ship.SetTargetStellar(nullptr);
@@ -1022,7 +1367,7 @@ void AI::MoveIndependent(Ship &ship, Command &command) const
 void AI::MoveEscort(Ship &ship, Command &command) const
 {
 	const Ship &parent = *ship.GetParent();
-	bool hasFuelCapacity = ship.Attributes().Get("fuel capacity") && ship.JumpFuel();
+	bool hasFuelCapacity = ship.Attributes().Get(FUEL_CAPACITY) && ship.JumpFuel();
 	bool isStaying = ship.GetPersonality().IsStaying() || !hasFuelCapacity;
 	bool parentIsHere = (ship.GetSystem() == parent.GetSystem());
 	// Check if the parent has a target planet that is in the parent's system.
@@ -1040,9 +1385,8 @@ void AI::MoveEscort(Ship &ship, Command &command) const
 		{
 			// If we're stranded and haven't decided where to go, figure out a
 			// path to the parent ship's system.
-			DistanceMap distance(ship, parent.GetSystem());
 			const System *from = ship.GetSystem();
-			const System *to = distance.Route(from);
+			const System *to = RouteTable::Route(ship, parent.GetSystem());
 			for(const StellarObject &object : from->Objects())
 				if(object.GetPlanet() && object.GetPlanet()->WormholeDestination(from) == to)
 				{
@@ -1078,8 +1422,7 @@ void AI::MoveEscort(Ship &ship, Command &command) const
 		Stop(ship, command, .2);
 	else if(parent.Commands().Has(Command::JUMP) && parent.GetTargetSystem() && !isStaying)
 	{
-		DistanceMap distance(ship, parent.GetTargetSystem());
-		const System *dest = distance.Route(ship.GetSystem());
+		const System *dest = RouteTable::Route(ship, parent.GetTargetSystem());
 		ship.SetTargetSystem(dest);
 		if(!dest || (ship.GetSystem()->HasFuelFor(ship) && !dest->HasFuelFor(ship) && ship.JumpsRemaining() == 1))
 			Refuel(ship, command);
@@ -1233,7 +1576,7 @@ bool AI::Stop(Ship &ship, Command &command, double maxSpeed, const Point directi
 	
 	// If you have a reverse thruster, figure out whether using it is faster
 	// than turning around and using your main thruster.
-	if(ship.Attributes().Get("reverse thrust"))
+	if(ship.Attributes().Get(REVERSE_THRUST))
 	{
 		// Figure out your stopping time using your main engine:
 		double degreesToTurn = TO_DEG * acos(min(1., max(-1., -velocity.Unit().Dot(angle.Unit()))));
@@ -1241,7 +1584,7 @@ bool AI::Stop(Ship &ship, Command &command, double maxSpeed, const Point directi
 		forwardTime += stopTime;
 		
 		// Figure out your reverse thruster stopping time:
-		double reverseAcceleration = ship.Attributes().Get("reverse thrust") / ship.Mass();
+		double reverseAcceleration = ship.Attributes().Get(REVERSE_THRUST) / ship.Mass();
 		double reverseTime = (180. - degreesToTurn) / ship.TurnRate();
 		reverseTime += speed / reverseAcceleration;
 		
@@ -1279,9 +1622,9 @@ bool AI::Stop(Ship &ship, Command &command, double maxSpeed, const Point directi
 
 void AI::PrepareForHyperspace(Ship &ship, Command &command)
 {
-	bool hasHyperdrive = ship.Attributes().Get("hyperdrive");
-	double scramThreshold = ship.Attributes().Get("scram drive");
-	bool hasJumpDrive = ship.Attributes().Get("jump drive");
+	bool hasHyperdrive = ship.Attributes().Get(HYPERDRIVE);
+	double scramThreshold = ship.Attributes().Get(SCRAM_DRIVE);
+	bool hasJumpDrive = ship.Attributes().Get(JUMP_DRIVE);
 	if(!hasHyperdrive && !hasJumpDrive)
 		return;
 	
@@ -1321,9 +1664,9 @@ void AI::PrepareForHyperspace(Ship &ship, Command &command)
 	}
 	// If we're a jump drive, just stop.
 	else if(isJump)
-		Stop(ship, command, ship.Attributes().Get("jump speed"));
+		Stop(ship, command, ship.Attributes().Get(JUMP_SPEED));
 	// Else stop in the fastest way to end facing in the right direction
-	else if(Stop(ship, command, ship.Attributes().Get("jump speed"), direction))
+	else if(Stop(ship, command, ship.Attributes().Get(JUMP_SPEED), direction))
 		command.SetTurn(TurnToward(ship, direction));
 }
 
@@ -1415,12 +1758,12 @@ void AI::KeepStation(Ship &ship, Command &command, const Ship &target)
 		command.SetTurn(targetAngle < 0. ? -1. : 1.);
 	
 	// Determine whether to apply thrust.
-	Point drag = ship.Velocity() * (ship.Attributes().Get("drag") / mass);
-	if(ship.Attributes().Get("reverse thrust"))
+	Point drag = ship.Velocity() * (ship.Attributes().Get(DRAG) / mass);
+	if(ship.Attributes().Get(REVERSE_THRUST))
 	{
 		// Don't take drag into account when reverse thrusting, because this
 		// estimate of how it will be applied can be quite inaccurate.
-		Point a = (unit * (-ship.Attributes().Get("reverse thrust") / mass)).Unit();
+		Point a = (unit * (-ship.Attributes().Get(REVERSE_THRUST) / mass)).Unit();
 		double direction = positionWeight * positionDelta.Dot(a) / POSITION_DEADBAND
 			+ velocityWeight * velocityDelta.Dot(a) / VELOCITY_DEADBAND;
 		if(direction > THRUST_DEADBAND)
@@ -1540,11 +1883,11 @@ void AI::DoSurveillance(Ship &ship, Command &command) const
 		return;
 	}
 	
-	bool cargoScan = ship.Attributes().Get("cargo scan") || ship.Attributes().Get("cargo scan power");
-	bool outfitScan = ship.Attributes().Get("outfit scan") || ship.Attributes().Get("outfit scan power");
-	double atmosphereScan = ship.Attributes().Get("atmosphere scan");
-	bool jumpDrive = ship.Attributes().Get("jump drive");
-	bool hyperdrive = ship.Attributes().Get("hyperdrive");
+	bool cargoScan = ship.Attributes().Get(CARGO_SCAN) || ship.Attributes().Get(CARGO_SCAN_POWER);
+	bool outfitScan = ship.Attributes().Get(OUTFIT_SCAN) || ship.Attributes().Get(OUTFIT_SCAN_POWER);
+	double atmosphereScan = ship.Attributes().Get(ATMOSPHERE_SCAN);
+	bool jumpDrive = ship.Attributes().Get(JUMP_DRIVE);
+	bool hyperdrive = ship.Attributes().Get(HYPERDRIVE);
 	
 	// This function is only called for ships that are in the player's system.
 	if(ship.GetTargetSystem())
@@ -1562,8 +1905,7 @@ void AI::DoSurveillance(Ship &ship, Command &command) const
 		else
 			command |= Command::LAND;
 	}
-	else if(ship.GetTargetShip() && ship.GetTargetShip()->IsTargetable()
-			&& ship.GetTargetShip()->GetSystem() == ship.GetSystem())
+	else if(target && target->IsTargetable() && target->GetSystem() == ship.GetSystem())
 	{
 		bool mustScanCargo = cargoScan && !Has(ship, target, ShipEvent::SCAN_CARGO);
 		bool mustScanOutfits = outfitScan && !Has(ship, target, ShipEvent::SCAN_OUTFITS);
@@ -1590,15 +1932,18 @@ void AI::DoSurveillance(Ship &ship, Command &command) const
 		vector<const System *> targetSystems;
 		
 		if(cargoScan || outfitScan)
-			for(const auto &it : ships)
-				if(it->GetGovernment() != ship.GetGovernment() && it->IsTargetable()
-						&& it->GetSystem() == ship.GetSystem())
+		{
+			vector<shared_ptr<Ship>> others;
+			OtherShips(ship.GetSystem(), ship.GetGovernment(), false, others);
+			for(const auto &it : others)
+				if(it->IsTargetable())
 				{
 					if(Has(ship, it, ShipEvent::SCAN_CARGO) && Has(ship, it, ShipEvent::SCAN_OUTFITS))
 						continue;
 				
 					targetShips.push_back(it);
 				}
+		}
 		
 		if(atmosphereScan)
 			for(const StellarObject &object : ship.GetSystem()->Objects())
@@ -1731,30 +2076,30 @@ bool AI::DoHarvesting(Ship &ship, Command &command)
 
 void AI::DoCloak(Ship &ship, Command &command)
 {
-	if(ship.Attributes().Get("cloak"))
+	if(ship.Attributes().Get(CLOAK))
 	{
 		// Never cloak if it will cause you to be stranded.
-		if(ship.Attributes().Get("cloaking fuel") && !ship.Attributes().Get("ramscoop"))
+		if(ship.Attributes().Get(CLOAKING_FUEL) && !ship.Attributes().Get(RAMSCOOP))
 		{
-			double fuel = ship.Fuel() * ship.Attributes().Get("fuel capacity");
-			fuel -= ship.Attributes().Get("cloaking fuel");
+			double fuel = ship.Fuel() * ship.Attributes().Get(FUEL_CAPACITY);
+			fuel -= ship.Attributes().Get(CLOAKING_FUEL);
 			if(fuel < ship.JumpFuel())
 				return;
 		}
 		// Otherwise, always cloak if you are in imminent danger.
 		static const double MAX_RANGE = 10000.;
 		double nearestEnemy = MAX_RANGE;
-		for(const auto &other : ships)
-			if(other->GetSystem() == ship.GetSystem() && other->IsTargetable()
-					&& other->GetGovernment()->IsEnemy(ship.GetGovernment())
-					&& !other->IsDisabled())
+		vector<shared_ptr<Ship>> enemies;
+		OtherShips(ship.GetSystem(), ship.GetGovernment(), true, enemies);
+		for(const auto &other : enemies)
+			if(other->IsTargetable() && !other->IsDisabled())
 				nearestEnemy = min(nearestEnemy,
 					ship.Position().Distance(other->Position()));
 		
 		// If this ship has started cloaking, it must get at least 40% repaired
 		// or 40% farther away before it begins decloaking again.
 		double hysteresis = ship.Cloaking() ? 1.4 : 1.;
-		double cloakIsFree = !ship.Attributes().Get("cloaking fuel");
+		double cloakIsFree = !ship.Attributes().Get(CLOAKING_FUEL);
 		if(ship.Hull() + .5 * ship.Shields() < hysteresis
 				&& (cloakIsFree || nearestEnemy < 2000. * hysteresis))
 			command |= Command::CLOAK;
@@ -1821,10 +2166,10 @@ Point AI::StoppingPoint(const Ship &ship, const Point &targetVelocity, bool &sho
 	// The average term's value will be v / 2. So:
 	stopDistance += .5 * v * v / acceleration;
 	
-	if(ship.Attributes().Get("reverse thrust"))
+	if(ship.Attributes().Get(REVERSE_THRUST))
 	{
 		// Figure out your reverse thruster stopping distance:
-		double reverseAcceleration = ship.Attributes().Get("reverse thrust") / ship.Mass();
+		double reverseAcceleration = ship.Attributes().Get(REVERSE_THRUST) / ship.Mass();
 		double reverseDistance = v * (180. - degreesToTurn) / turnRate;
 		reverseDistance += .5 * v * v / reverseAcceleration;
 		
@@ -1938,14 +2283,47 @@ Command AI::AutoFire(const Ship &ship, bool secondary) const
 	vector<shared_ptr<const Ship>> enemies;
 	if(currentTarget)
 		enemies.push_back(currentTarget);
-	for(auto target : ships)
-		if(target->IsTargetable() && gov->IsEnemy(target->GetGovernment())
+	vector<shared_ptr<Ship>> inSystem;
+	OtherShips(ship.GetSystem(), gov, true, inSystem);
+	for(const auto &target : inSystem)
+		if(target->IsTargetable()
 				&& !(target->IsHyperspacing() && target->Velocity().Length() > 10.)
-				&& target->GetSystem() == ship.GetSystem()
 				&& target->Position().Distance(ship.Position()) < maxRange
 				&& target != currentTarget)
 			enemies.push_back(target);
 	
+	// Everything about the enemies that does not depend on which weapon is
+	// aiming at them is figured out once, up front: which ones can be shot at,
+	// and where they will be relative to this ship. For each weapon, a quick
+	// check of those arrays (which the compiler can vectorize) finds the few
+	// enemies that are close enough to possibly be hit, and only those need
+	// a full collision check.
+	vector<const Ship *> targets;
+	vector<double> targetX;
+	vector<double> targetY;
+	vector<double> targetVX;
+	vector<double> targetVY;
+	vector<double> targetRadius;
+	for(const shared_ptr<const Ship> &target : enemies)
+	{
+		// Don't shoot ships we want to plunder.
+		bool hasBoarded = Has(ship, target, ShipEvent::BOARD);
+		if(target->IsDisabled() && spareDisabled && !hasBoarded && !disabledOverride)
+			continue;
+		
+		Point v = target->Velocity() - ship.Velocity();
+		Point p = target->Position() - ship.Position() + v;
+		targets.push_back(target.get());
+		targetX.push_back(p.X());
+		targetY.push_back(p.Y());
+		targetVX.push_back(v.X());
+		targetVY.push_back(v.Y());
+		// Allow a little slack for rounding, since the check below does the
+		// arithmetic in a different order than the full collision check.
+		targetRadius.push_back(target->GetMask(step).Radius() + 1.);
+	}
+	vector<char> mayHit(targets.size());
+	
 	for(const Hardpoint &weapon : ship.Weapons())
 	{
 		++index;
@@ -1962,7 +2340,7 @@ Command AI::AutoFire(const Ship &ship, bool secondary) const
 		// fuel that you cannot leave the system if necessary.
 		if(weapon.GetOutfit()->FiringFuel())
 		{
-			double fuel = ship.Fuel() * ship.Attributes().Get("fuel capacity");
+			double fuel = ship.Fuel() * ship.Attributes().Get(FUEL_CAPACITY);
 			fuel -= weapon.GetOutfit()->FiringFuel();
 			// If the ship is not ever leaving this system, it does not need to
 			// reserve any fuel.
@@ -2017,13 +2395,25 @@ Command AI::AutoFire(const Ship &ship, bool secondary) const
 		if(weapon.IsHoming())
 			continue;
 		
-		for(const shared_ptr<const Ship> &target : enemies)
+		// The projectile travels along this vector, relative to the ship.
+		Point aim = (ship.Facing() + weapon.GetAngle()).Unit() * vp;
+		Point offset = start - ship.Position();
+		for(size_t i = 0; i < targets.size(); ++i)
+		{
+			double px = targetX[i] - offset.X();
+			double py = targetY[i] - offset.Y();
+			double vx = (aim.X() - targetVX[i]) * lifetime;
+			double vy = (aim.Y() - targetVY[i]) * lifetime;
+			double reach = targetRadius[i] + sqrt(vx * vx + vy * vy);
+			mayHit[i] = (px * px + py * py <= reach * reach);
+		}
+		
+		for(size_t i = 0; i < targets.size(); ++i)
 		{
-			// Don't shoot ships we want to plunder.
-			bool hasBoarded = Has(ship, target, ShipEvent::BOARD);
-			if(target->IsDisabled() && spareDisabled && !hasBoarded && !disabledOverride)
+			if(!mayHit[i])
 				continue;
 			
+			const Ship *target = targets[i];
 			Point p = target->Position() - start;
 			Point v = target->Velocity() - ship.Velocity();
 			// By the time this action is performed, the ships will have moved
@@ -2374,7 +2764,7 @@ void AI::MovePlayer(Ship &ship, const PlayerInfo &player)
 		if(!ship.GetTargetSystem())
 		{
 			double bestMatch = -2.;
-			const auto &links = (ship.Attributes().Get("jump drive") ?
+			const auto &links = (ship.Attributes().Get(JUMP_DRIVE) ?
 				ship.GetSystem()->Neighbors() : ship.GetSystem()->Links());
 			for(const System *link : links)
 			{
@@ -2399,7 +2789,7 @@ void AI::MovePlayer(Ship &ship, const PlayerInfo &player)
 	else if(keyHeld.Has(Command::SCAN))
 		command |= Command::SCAN;
 	
-	bool hasGuns = Preferences::Has("Automatic firing") && !ship.IsBoarding()
+	bool hasGuns = Preferences::Has(Preferences::AUTOMATIC_FIRING) && !ship.IsBoarding()
 		&& !(keyStuck | keyHeld).Has(Command::LAND | Command::JUMP | Command::BOARD)
 		&& (!ship.GetTargetShip() || ship.GetTargetShip()->GetGovernment()->IsEnemy());
 	if(hasGuns)
@@ -2411,7 +2801,7 @@ void AI::MovePlayer(Ship &ship, const PlayerInfo &player)
 			command.SetTurn(keyHeld.Has(Command::RIGHT) - keyHeld.Has(Command::LEFT));
 		else if(keyHeld.Has(Command::BACK))
 		{
-			if(ship.Attributes().Get("reverse thrust"))
+			if(ship.Attributes().Get(REVERSE_THRUST))
 				command |= Command::BACK;
 			else
 				command.SetTurn(TurnBackward(ship));
@@ -2450,7 +2840,7 @@ void AI::MovePlayer(Ship &ship, const PlayerInfo &player)
 		if(keyHeld.Has(AutopilotCancelKeys()))
 			keyStuck = keyHeld;
 	}
-	if(hasGuns && Preferences::Has("Automatic aiming") && !command.Turn()
+	if(hasGuns && Preferences::Has(Preferences::AUTOMATIC_AIMING) && !command.Turn()
 			&& ship.GetTargetShip() && ship.GetTargetShip()->GetSystem() == ship.GetSystem()
 			&& ship.GetTargetShip()->IsTargetable()
 			&& !keyStuck.Has(Command::LAND | Command::JUMP | Command::BOARD))
@@ -2495,7 +2885,7 @@ void AI::MovePlayer(Ship &ship, const PlayerInfo &player)
 	}
 	else if(keyStuck.Has(Command::JUMP))
 	{
-		if(!ship.Attributes().Get("hyperdrive") && !ship.Attributes().Get("jump drive"))
+		if(!ship.Attributes().Get(HYPERDRIVE) && !ship.Attributes().Get(JUMP_DRIVE))
 		{
 			Messages::Add("You do not have a hyperdrive installed.");
 			keyStuck.Clear();
@@ -2544,6 +2934,43 @@ void AI::MovePlayer(Ship &ship, const PlayerInfo &player)
 
 
 
+// Get the ships in the given system that belong to enemies of the given
+// government, or if "enemiesOnly" is false, to any other government, in the
+// same order as they are in the list of all ships.
+void AI::OtherShips(const System *system, const Government *gov, bool enemiesOnly, vector<shared_ptr<Ship>> &result) const
+{
+	result.clear();
+	auto sit = rosters.find(system);
+	if(sit == rosters.end())
+		return;
+	
+	vector<int> indices;
+	for(const auto &it : sit->second)
+		if(it.first != gov && (!enemiesOnly || gov->IsEnemy(it.first)))
+			indices.insert(indices.end(), it.second.begin(), it.second.end());
+	sort(indices.begin(), indices.end());
+	
+	result.reserve(indices.size());
+	for(int index : indices)
+		result.push_back(shipOrder[index]);
+}
+
+
+
+// Get the indices in shipOrder of the ships in the given system that belong to
+// the given government.
+const vector<int> &AI::Roster(const System *system, const Government *gov) const
+{
+	static const vector<int> EMPTY;
+	auto sit = rosters.find(system);
+	if(sit == rosters.end())
+		return EMPTY;
+	auto it = sit->second.find(gov);
+	return (it == sit->second.end()) ? EMPTY : it->second;
+}
+
+
+
 bool AI::Has(const Ship &ship, const weak_ptr<const Ship> &other, int type) const
 {
 	auto sit = actions.find(ship.shared_from_this());
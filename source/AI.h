@@ -15,11 +15,14 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 #include "Command.h"
 #include "Point.h"
+#include "ShipGrid.h"
 
 #include <cstdint>
 #include <list>
 #include <map>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 class Angle;
 class AsteroidField;
@@ -30,6 +33,7 @@ class Minable;
 class Ship;
 class ShipEvent;
 class StellarObject;
+class System;
 class PlayerInfo;
 
 
@@ -51,18 +55,39 @@ template <class Type>
 	// Fleet commands from the player.
 	void IssueShipTarget(const PlayerInfo &player, const std::shared_ptr<Ship> &target);
 	void IssueMoveTarget(const PlayerInfo &player, const Point &target);
-	// Commands issued via the keyboard (mostly, to the flagship).
-	void UpdateKeys(PlayerInfo &player, Command &clickCommands, bool isActive);
+	// Commands issued via the keyboard (mostly, to the flagship). The keys are
+	// the ones the player is holding down in this step.
+	void UpdateKeys(PlayerInfo &player, Command &clickCommands, Command keys, bool shift, bool isActive);
+	// Replace the held steering and firing keys with a more recent reading of
+	// the keyboard, taken just before the ships move.
+	void LatchKeys(Command keys);
 	
 	// Allow the AI to track any events it is interested in.
-	void UpdateEvents(const std::list<ShipEvent> &events);
+	void UpdateEvents(const std::vector<ShipEvent> &events);
 	// Reset the AI's memory of events.
 	void Clean();
+	// Also forget the player's keys, orders, and everything else, so that the
+	// AI is in the same state as if it had just been created.
+	void Reset();
 	// Issue AI commands to all ships for one game step.
 	void Step(const PlayerInfo &player);
 	
 	
 private:
+	// The decisions for one ship that are made in parallel with other ships.
+	class Decision {
+	public:
+		Ship *ship = nullptr;
+		Command command;
+		int targetTurn = 0;
+		bool isStranded = false;
+		bool isMining = false;
+	};
+	
+	
+private:
+	// Issue commands to one ship, modifying only that ship.
+	void StepShip(Decision &decision, const PlayerInfo &player);
 	// Pick a new target for the given ship.
 	std::shared_ptr<Ship> FindTarget(const Ship &ship) const;
 	
@@ -104,6 +129,14 @@ private:
 	
 	void MovePlayer(Ship &ship, const PlayerInfo &player);
 	
+	// Get the ships in the given system that belong to enemies of the given
+	// government, or if "enemiesOnly" is false, to any other government, in
+	// the same order as they are in the list of all ships.
+	void OtherShips(const System *system, const Government *gov, bool enemiesOnly, std::vector<std::shared_ptr<Ship>> &result) const;
+	// Get the indices in shipOrder of the ships in the given system that belong
+	// to the given government.
+	const std::vector<int> &Roster(const System *system, const Government *gov) const;
+	
 	bool Has(const Ship &ship, const std::weak_ptr<const Ship> &other, int type) const;
 	bool Has(const Government *government, const std::weak_ptr<const Ship> &other, int type) const;
 	
@@ -125,6 +158,14 @@ private:
 		std::weak_ptr<Ship> target;
 		Point point;
 	};
+	
+	// The governments that count toward a given government's strength of
+	// enemies and allies.
+	class Relations {
+	public:
+		std::vector<const Government *> enemies;
+		std::vector<const Government *> allies;
+	};
 
 
 private:
@@ -162,15 +203,40 @@ private:
 	std::map<std::weak_ptr<const Ship>, std::map<std::weak_ptr<const Ship>, int, Comp>, Comp> actions;
 	std::map<const Government *, std::map<std::weak_ptr<const Ship>, int, Comp>> governmentActions;
 	std::map<std::weak_ptr<const Ship>, int, Comp> playerActions;
-	std::map<const Ship *, int> swarmCount;
-	std::map<const Ship *, Angle> miningAngle;
-	std::map<const Ship *, int> miningTime;
-	std::map<const Ship *, double> appeasmentThreshold;
-	
-	std::map<const Ship *, int64_t> shipStrength;
+	// These records are only ever looked up by ship, never iterated over in
+	// order, so they are kept in hash maps. Every record is checked once per
+	// step to see if its ship is still in play, so they are never very large.
+	std::unordered_map<const Ship *, int> swarmCount;
+	std::unordered_map<const Ship *, Angle> miningAngle;
+	std::unordered_map<const Ship *, int> miningTime;
+	std::unordered_map<const Ship *, double> appeasmentThreshold;
+	// The step on which each idle ship last decided what to do.
+	std::unordered_map<const Ship *, int> lastThought;
+	int thinkStep = 0;
+	
+	std::unordered_map<const Ship *, int64_t> shipStrength;
 	
 	std::map<const Government *, int64_t> enemyStrength;
 	std::map<const Government *, int64_t> allyStrength;
+	std::map<const Government *, Relations> relations;
+	// All the ships in the player's system that count toward the strength of
+	// the ships around them.
+	ShipGrid strengthGrid;
+	// All the ships in the player's system that might be chosen as targets.
+	ShipGrid targetGrid;
+	// Vector for returning the result of a strength grid query.
+	std::vector<size_t> strengthResult;
+	// Every ship that is in a system, in the order of the list of all ships,
+	// and for each system, the indices of the ships each government has there.
+	// This is gathered at the start of each step, after ships have arrived,
+	// departed, died or been captured, so that looking for a ship's enemies or
+	// friends only involves the ships in its system of the right governments.
+	std::vector<std::shared_ptr<Ship>> shipOrder;
+	std::map<const System *, std::map<const Government *, std::vector<int>>> rosters;
+	
+	// Ships whose decisions can be made in parallel, split up so that escorts
+	// are always in a later wave than their parents.
+	std::vector<std::vector<Decision>> waves;
 };
 
 
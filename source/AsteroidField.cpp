@@ -19,6 +19,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Random.h"
 #include "Screen.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
 
@@ -26,6 +27,21 @@ using namespace std;
 
 namespace {
 	static const double WRAP = 4096.;
+	
+	// The collision grid divides the wrap square into this many cells in each
+	// direction, each of which is 1 << SHIFT pixels wide.
+	const int SHIFT = 8;
+	const int CELLS = 16;
+	const int CELL_MASK = CELLS - 1;
+	
+	// Get the range of grid coordinates that the given range of positions
+	// covers. There is no need to examine the same cell more than once.
+	void Cells(double from, double to, int &first, int &last)
+	{
+		first = static_cast<int>(floor(from)) >> SHIFT;
+		last = max(first, static_cast<int>(floor(to)) >> SHIFT);
+		last = min(last, first + CELL_MASK);
+	}
 }
 
 
@@ -35,6 +51,9 @@ void AsteroidField::Clear()
 {
 	asteroids.clear();
 	minables.clear();
+	asteroidGrid.Clear();
+	minableGrid.Clear();
+	minableIndex.clear();
 }
 
 
@@ -66,7 +85,7 @@ void AsteroidField::Add(const Minable *minable, int count, double energy, double
 
 
 // Move all the asteroids forward one step.
-void AsteroidField::Step(list<Effect> &effects, list<shared_ptr<Flotsam>> &flotsam)
+void AsteroidField::Step(vector<Effect> &effects, list<shared_ptr<Flotsam>> &flotsam, int step)
 {
 	for(Asteroid &asteroid : asteroids)
 		asteroid.Step();
@@ -81,6 +100,27 @@ void AsteroidField::Step(list<Effect> &effects, list<shared_ptr<Flotsam>> &flots
 		else
 			it = minables.erase(it);
 	}
+	
+	// Record where every asteroid now is, for collision detection. Finding an
+	// asteroid's mask also updates which animation frame it is showing, so do
+	// that here, before projectiles are checked from several threads.
+	asteroidGrid.Clear();
+	for(size_t i = 0; i < asteroids.size(); ++i)
+	{
+		asteroidGrid.Add(i, asteroids[i].Position(), asteroids[i].Radius());
+		asteroids[i].GetMask(step);
+	}
+	asteroidGrid.Finish();
+	
+	minableGrid.Clear();
+	minableIndex.clear();
+	for(const shared_ptr<Minable> &minable : minables)
+	{
+		minableGrid.Add(minableIndex.size(), minable->Position(), minable->Radius());
+		minableIndex.push_back(&*minable);
+		minable->GetMask(step);
+	}
+	minableGrid.Finish();
 }
 
 
@@ -88,8 +128,12 @@ void AsteroidField::Step(list<Effect> &effects, list<shared_ptr<Flotsam>> &flots
 // Draw the asteroids, centered on the given location.
 void AsteroidField::Draw(DrawList &draw, const Point &center, double zoom) const
 {
+	// Find which part of the system is on screen once, rather than separately
+	// for each asteroid.
+	Point topLeft = center + Screen::TopLeft() / zoom;
+	Point bottomRight = center + Screen::BottomRight() / zoom;
 	for(const Asteroid &asteroid : asteroids)
-		asteroid.Draw(draw, center, zoom);
+		asteroid.Draw(draw, topLeft, bottomRight, zoom);
 	for(const shared_ptr<Minable> &minable : minables)
 		draw.Add(*minable);
 }
@@ -97,11 +141,19 @@ void AsteroidField::Draw(DrawList &draw, const Point &center, double zoom) const
 
 
 // Check if the given projectile collides with any asteroids.
-double AsteroidField::Collide(const Projectile &projectile, int step, double closestHit, Point *hitVelocity)
+double AsteroidField::Collide(const Projectile &projectile, int step, double closestHit, Point *hitVelocity, Minable **hitMinable) const
 {
+	// Only the asteroids in the grid cells the projectile passes through can
+	// possibly be hit by it.
+	Point from = projectile.Position();
+	Point to = from + projectile.Velocity();
+	vector<int> candidates;
+	
 	// First, check for collisions with ordinary asteroids.
-	for(const Asteroid &asteroid : asteroids)
+	asteroidGrid.Line(from, to, candidates);
+	for(int i : candidates)
 	{
+		const Asteroid &asteroid = asteroids[i];
 		double thisDistance = asteroid.Collide(projectile, step);
 		if(thisDistance < closestHit)
 		{
@@ -115,19 +167,21 @@ double AsteroidField::Collide(const Projectile &projectile, int step, double clo
 	// closest hit, it really is what the projectile struck - that is, we are
 	// not going to later find a ship or something else that is closer.
 	Minable *hit = nullptr;
-	for(const shared_ptr<Minable> &minable : minables)
+	minableGrid.Line(from, to, candidates);
+	for(int i : candidates)
 	{
+		Minable *minable = minableIndex[i];
 		double thisDistance = minable->Collide(projectile, step);
 		if(thisDistance < closestHit)
 		{
 			closestHit = thisDistance;
-			hit = &*minable;
+			hit = minable;
 			if(hitVelocity)
 				*hitVelocity = minable->Velocity();
 		}
 	}
-	if(hit)
-		hit->TakeDamage(projectile);
+	if(hitMinable)
+		*hitMinable = hit;
 	
 	return closestHit;
 }
@@ -190,17 +244,23 @@ void AsteroidField::Asteroid::Step()
 
 
 
-// Draw any instances of this asteroid that are on screen.
-void AsteroidField::Asteroid::Draw(DrawList &draw, const Point &center, double zoom) const
+// Draw any instances of this asteroid that are within the given part of the
+// system, which is the area that is on screen.
+void AsteroidField::Asteroid::Draw(DrawList &draw, const Point &screenTopLeft, const Point &screenBottomRight, double zoom) const
 {
 	// Any object within this range must be drawn.
-	Point topLeft = center + (Screen::TopLeft() - size) / zoom;
-	Point bottomRight = center + (Screen::BottomRight() + size) / zoom;
+	Point margin = size / zoom;
+	Point topLeft = screenTopLeft - margin;
+	Point bottomRight = screenBottomRight + margin;
 	
 	// Figure out the position of the first instance of this asteroid that is to
-	// the right of and below the top left corner of the screen.
+	// the right of and below the top left corner of the screen. The screen is
+	// much smaller than the wrap square, so most asteroids are not in any of
+	// the columns it covers and can be skipped after checking just that.
 	double startX = fmod(position.X() - topLeft.X(), WRAP);
 	startX += topLeft.X() + WRAP * (startX < 0.);
+	if(startX >= bottomRight.X())
+		return;
 	double startY = fmod(position.Y() - topLeft.Y(), WRAP);
 	startY += topLeft.Y() + WRAP * (startY < 0.);
 	
@@ -228,3 +288,75 @@ double AsteroidField::Asteroid::Collide(const Projectile &projectile, int step)
 	
 	return GetMask(step).Collide(pos - halfVelocity, projectile.Velocity(), angle);
 }
+
+
+
+// Remove all the objects from the grid.
+void AsteroidField::Grid::Clear()
+{
+	counts.assign(CELLS * CELLS + 1, 0);
+	added.clear();
+	sorted.clear();
+}
+
+
+
+// Add the object with the given index, which covers the given circle.
+void AsteroidField::Grid::Add(int index, const Point &center, double radius)
+{
+	int firstX, lastX, firstY, lastY;
+	Cells(center.X() - radius, center.X() + radius, firstX, lastX);
+	Cells(center.Y() - radius, center.Y() + radius, firstY, lastY);
+	for(int y = firstY; y <= lastY; ++y)
+		for(int x = firstX; x <= lastX; ++x)
+			added.emplace_back((y & CELL_MASK) * CELLS + (x & CELL_MASK), index);
+}
+
+
+
+// Finish adding objects, and sort them by grid cell.
+void AsteroidField::Grid::Finish()
+{
+	// Count how many entries there are in each cell, and figure out where
+	// each cell's entries begin.
+	for(const pair<int, int> &entry : added)
+		++counts[entry.first + 1];
+	for(size_t i = 1; i < counts.size(); ++i)
+		counts[i] += counts[i - 1];
+	
+	// Place the entries in order. The entries in each cell stay in the order
+	// they were added, i.e. in order of their indices.
+	sorted.resize(added.size());
+	vector<int> next(counts.begin(), counts.end() - 1);
+	for(const pair<int, int> &entry : added)
+		sorted[next[entry.first]++] = entry.second;
+}
+
+
+
+// Get the indices, in increasing order, of every object that is in any of the
+// cells that the given line crosses.
+void AsteroidField::Grid::Line(const Point &from, const Point &to, vector<int> &result) const
+{
+	result.clear();
+	if(counts.empty())
+		return;
+	
+	int firstX, lastX, firstY, lastY;
+	Cells(min(from.X(), to.X()), max(from.X(), to.X()), firstX, lastX);
+	Cells(min(from.Y(), to.Y()), max(from.Y(), to.Y()), firstY, lastY);
+	for(int y = firstY; y <= lastY; ++y)
+		for(int x = firstX; x <= lastX; ++x)
+		{
+			int cell = (y & CELL_MASK) * CELLS + (x & CELL_MASK);
+			result.insert(result.end(), sorted.begin() + counts[cell], sorted.begin() + counts[cell + 1]);
+		}
+	// Check the objects in the same order as if every one were being checked,
+	// so that if two are hit at exactly the same point, the same one is hit.
+	// An object that covers several of the cells is only checked once.
+	if(firstX != lastX || firstY != lastY)
+	{
+		sort(result.begin(), result.end());
+		result.erase(unique(result.begin(), result.end()), result.end());
+	}
+}
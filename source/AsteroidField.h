@@ -44,16 +44,20 @@ public:
 	void Add(const std::string &name, int count, double energy = 1.);
 	void Add(const Minable *minable, int count, double energy = 1., double beltRadius = 1500.);
 	
-	// Move all the asteroids forward one time step.
-	void Step(std::list<Effect> &effects, std::list<std::shared_ptr<Flotsam>> &flotsam);
+	// Move all the asteroids forward one time step. The current time step must
+	// be given, so we know what animation frame each asteroid is on.
+	void Step(std::vector<Effect> &effects, std::list<std::shared_ptr<Flotsam>> &flotsam, int step);
 	// Draw the asteroid field, with the field of view centered on the given point.
 	void Draw(DrawList &draw, const Point &center, double zoom) const;
 	// Check if the given projectile has hit any of the asteroids. The current
 	// time step must be given, so we know what animation frame each asteroid is
 	// on. If there is a collision the asteroid's velocity is returned so the
-	// projectile's hit effects can take it into account. The return value is
-	// how far along the projectile's path it should be clipped.
-	double Collide(const Projectile &projectile, int step, double closestHit, Point *hitVelocity = nullptr);
+	// projectile's hit effects can take it into account, and if what it hits is
+	// a minable asteroid, that is returned so the caller can damage it. The
+	// return value is how far along the projectile's path it should be clipped.
+	// If Step() was given the same time step, this only reads from the field,
+	// so any number of threads can check projectiles at once.
+	double Collide(const Projectile &projectile, int step, double closestHit, Point *hitVelocity = nullptr, Minable **hitMinable = nullptr) const;
 	
 	// Get the list of mainable asteroids.
 	const std::list<std::shared_ptr<Minable>> &Minables() const;
@@ -67,7 +71,9 @@ private:
 		Asteroid(const Sprite *sprite, double energy);
 		
 		void Step();
-		void Draw(DrawList &draw, const Point &center, double zoom) const;
+		// Draw any instances of this asteroid that are within the given part of
+		// the system, which is the area that is on screen.
+		void Draw(DrawList &draw, const Point &screenTopLeft, const Point &screenBottomRight, double zoom) const;
 		double Collide(const Projectile &projectile, int step) const;
 		
 	private:
@@ -75,10 +81,40 @@ private:
 		Point size;
 	};
 	
+	// A grid of cells the size of the wrap square, keeping track of which
+	// objects might be in each cell, so that a projectile only needs to be
+	// checked against the objects in the cells that its path crosses. Because
+	// of the wrapping, any position maps to one of the cells, and objects in a
+	// cell may really be in another part of the system.
+	class Grid {
+	public:
+		// Remove all the objects from the grid.
+		void Clear();
+		// Add the object with the given index, which covers the given circle.
+		void Add(int index, const Point &center, double radius);
+		// Finish adding objects, and sort them by grid cell.
+		void Finish();
+		// Get the indices, in increasing order, of every object that is in
+		// any of the cells that the given line crosses.
+		void Line(const Point &from, const Point &to, std::vector<int> &result) const;
+		
+	private:
+		// For each cell plus one, the index in "sorted" of its first object.
+		std::vector<int> counts;
+		// The cell and index of each object, in the order they were added.
+		std::vector<std::pair<int, int>> added;
+		std::vector<int> sorted;
+	};
+	
 	
 private:
 	std::vector<Asteroid> asteroids;
 	std::list<std::shared_ptr<Minable>> minables;
+	
+	// Where the asteroids and minables are, as of the last step.
+	Grid asteroidGrid;
+	Grid minableGrid;
+	std::vector<Minable *> minableIndex;
 };
 
 
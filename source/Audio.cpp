@@ -15,8 +15,10 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Files.h"
 #include "Music.h"
 #include "Point.h"
+#include "Preferences.h"
 #include "Random.h"
 #include "Sound.h"
+#include "ThreadPool.h"
 
 #ifndef __APPLE__
 #include <AL/al.h>
@@ -27,8 +29,13 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #endif
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstdint>
+#include <condition_variable>
+#include <functional>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <set>
 #include <stdexcept>
@@ -48,27 +55,78 @@ namespace {
 		
 		Point sum;
 		double weight = 0.;
+		// How many steps this sound has been waiting for its file to load.
+		int age = 0;
+	};
+	
+	// A sound that is decoded a little at a time as it plays, instead of being
+	// in one buffer. Each source that plays one has its own decoder, and a few
+	// small buffers to queue up the decoded audio in.
+	class Stream {
+	public:
+		explicit Stream(const Sound *sound);
+		~Stream();
+		
+		// Queue up any newly decoded audio on the given source, and make sure
+		// that it is playing. This returns false once all of it has been played.
+		bool Update(unsigned source);
+		
+	private:
+		Music music;
+		vector<unsigned> buffers;
+		vector<unsigned> freeBuffers;
+		vector<int16_t> mono;
 	};
 	
 	// OpenAL only allows a certain number of distinct sound sources. To work
 	// around that limitation, multiple instances of the same sound playing at
 	// the same time will be "coalesced" into a single source, and sources will
-	// be recycled once they are no longer playing.
+	// be recycled once they are no longer playing. If there are more sounds
+	// than sources, the quietest sources are taken over by louder sounds.
 	class Source {
 	public:
 		Source(const Sound *sound, unsigned source);
 		
-		void Move(const QueueEntry &entry) const;
+		void Move(const QueueEntry &entry);
+		// Begin playing this source.
+		void Play();
+		// Check if this source is still playing, and give a streamed sound any
+		// audio that has been decoded since the last step.
+		bool Update();
 		unsigned ID() const;
 		const Sound *GetSound() const;
+		// Get the weight of the entry this source was last moved to, which is how
+		// loud it is (squared).
+		double Weight() const;
 		
 	private:
 		const Sound *sound = nullptr;
 		unsigned source = 0;
+		double weight = 0.;
+		shared_ptr<Stream> stream;
+	};
+	
+	// A request from a thread other than the main one to play a sound. These go
+	// in a fixed-size ring buffer that any number of threads can add to without
+	// taking a lock. Each slot's sequence number says whether it is free to be
+	// written (it equals the slot's position) or ready to be read (position + 1).
+	class Request {
+	public:
+		atomic<size_t> sequence;
+		const Sound *sound = nullptr;
+		Point position;
 	};
 	
-	// Thread entry point for loading the sound files.
-	void Load();
+	// Load the given sound from its file. This is run by the thread pool.
+	void Load(const Sound *sound);
+	// Start loading the given sound in the background, unless that was already
+	// done. The audio mutex must be locked.
+	void RequestLoad(const Sound *sound);
+	// Unload the sounds that have gone unplayed the longest until they fit in
+	// the given memory budget. The audio mutex must be locked.
+	void UnloadSounds(size_t budget);
+	// Add a request to the ring buffer. This returns false if it is full.
+	bool PushRequest(const Sound *sound, const Point &position);
 	
 	
 	// Mutex to make sure different threads don't modify the audio at the same time.
@@ -84,25 +142,60 @@ namespace {
 	// added sound is "deferred" until the next audio position update to make
 	// sure that all sounds from a given frame start at the same time.
 	map<const Sound *, QueueEntry> queue;
+	// Requests from other threads, in the order they were made. This must be a
+	// power of two. If it ever fills up, requests go in the "deferred" map,
+	// which is protected by the audio mutex, instead.
+	const size_t REQUEST_COUNT = 4096;
+	Request requests[REQUEST_COUNT];
+	atomic<size_t> requestTail(0);
+	size_t requestHead = 0;
 	map<const Sound *, QueueEntry> deferred;
+	atomic<bool> hasDeferred(false);
 	thread::id mainThreadID;
 	
-	// Sound resources that have been loaded from files.
+	// Sound resources. Each one is only loaded from its file the first time it
+	// is played, and may be unloaded again if sounds are taking up more memory
+	// than the "sound memory" preference allows.
 	map<string, Sound> sounds;
 	// OpenAL "sources" available for playing sounds. There are a limited number
 	// of these, so they must be reused.
 	vector<Source> sources;
 	vector<unsigned> recycledSources;
-	vector<unsigned> endingSources;
+	// Sources that were looping and are now wrapping up a loop. These keep
+	// their Source objects so that streamed sounds keep their buffers.
+	vector<Source> endingSources;
 	unsigned maxSources = 255;
-	
-	// Queue and thread for loading sound files in the background.
-	map<string, string> loadQueue;
-	thread loadThread;
+	// A sound's gain is the square root of its queue entry's weight. Sounds that
+	// would start at less than this gain (around -30 dB) are too quiet to be
+	// worth a source. That is a single sound about 16,000 pixels away.
+	const double MIN_WEIGHT = .001;
+	
+	// Sounds that have been requested to load, and the number of sounds that
+	// are being loaded right now. A sound stays in the set if it fails to load,
+	// so that it is not tried again; once loaded, it is removed so it can be
+	// loaded again if it is ever unloaded.
+	set<const Sound *> requested;
+	size_t loading = 0;
+	condition_variable loadCondition;
+	// Sounds that were played before they were done loading. They are held
+	// back for a few steps, after which they are too late to be worth playing.
+	map<const Sound *, QueueEntry> waiting;
+	const int MAX_WAIT = 10;
+	// The step in which each sound was last playing, to decide which ones to
+	// unload first. Sounds are not unloaded until they have been unused for
+	// long enough that they cannot still be fading out.
+	map<const Sound *, int> lastPlayed;
+	int step = 0;
+	const int MIN_UNUSED = 600;
+	// How often to check if the sounds are over their memory budget.
+	const int UNLOAD_INTERVAL = 60;
 	
 	// The current position of the "listener," i.e. the center of the screen.
 	Point listener;
 	
+	// Each streamed sound queues its decoded audio in this many buffers.
+	const size_t STREAM_BUFFERS = 3;
+	
 	// MP3 streaming:
 	unsigned musicSource = 0;
 	static const size_t MUSIC_BUFFERS = 3;
@@ -115,7 +208,7 @@ namespace {
 
 
 
-// Begin loading sounds (in a separate thread).
+// Find all the sound files. They are not loaded until they are played.
 void Audio::Init(const vector<string> &sources)
 {
 	device = alcOpenDevice(nullptr);
@@ -129,6 +222,8 @@ void Audio::Init(const vector<string> &sources)
 	// If we don't make it to this point, no audio will be played.
 	isInitialized = true;
 	mainThreadID = this_thread::get_id();
+	for(size_t i = 0; i < REQUEST_COUNT; ++i)
+		requests[i].sequence.store(i, memory_order_relaxed);
 	
 	// The listener is looking "into" the screen. This orientation vector is
 	// used to determine what sounds should be in the right or left speaker.
@@ -149,20 +244,19 @@ void Audio::Init(const vector<string> &sources)
 		vector<string> files = Files::RecursiveList(root);
 		for(const string &path : files)
 		{
-			if(!path.compare(path.length() - 4, 4, ".wav"))
+			// Long sounds can be mp3 files, which are streamed as they play.
+			if(!path.compare(path.length() - 4, 4, ".wav") || !path.compare(path.length() - 4, 4, ".mp3"))
 			{
 				// The "name" of the sound is its full path within the "sounds/"
-				// folder, without the ".wav" or "~.wav" suffix.
+				// folder, without the ".wav" or "~.wav" suffix (or ".mp3").
 				size_t end = path.length() - 4;
 				if(path[end - 1] == '~')
 					--end;
-				loadQueue[path.substr(root.length(), end - root.length())] = path;
+				unique_lock<mutex> lock(audioMutex);
+				sounds[path.substr(root.length(), end - root.length())].SetPath(path);
 			}
 		}
 	}
-	// Begin loading the files.
-	if(!loadQueue.empty())
-		loadThread = thread(&Load);
 	
 	// Create the music-streaming threads.
 	currentTrack.reset(new Music());
@@ -181,17 +275,11 @@ void Audio::Init(const vector<string> &sources)
 
 
 
-// Check the progress of loading sounds.
+// Check the progress of loading sounds. Sounds are only loaded once they are
+// played, so there is nothing to wait for.
 double Audio::Progress()
 {
-	unique_lock<mutex> lock(audioMutex);
-	
-	if(loadQueue.empty())
-		return 1.;
-	
-	double done = sounds.size();
-	double total = done + loadQueue.size();
-	return done / total;
+	return 1.;
 }
 
 
@@ -224,6 +312,27 @@ const Sound *Audio::Get(const string &name)
 
 
 
+// Get how much memory the sounds that are loaded take up.
+size_t Audio::Memory()
+{
+	unique_lock<mutex> lock(audioMutex);
+	size_t total = 0;
+	for(const auto &it : sounds)
+		total += it.second.Memory();
+	return total;
+}
+
+
+
+// Get how many sound sources are playing, including looping sounds that
+// are fading out. This must only be called from the main thread.
+int Audio::Voices()
+{
+	return sources.size() + endingSources.size();
+}
+
+
+
 // Set the listener's position, and also update any sounds that have been
 // added but deferred because they were added from a thread other than the
 // main one (the one that called Init()).
@@ -234,9 +343,27 @@ void Audio::Update(const Point &listenerPosition)
 	
 	listener = listenerPosition;
 	
-	for(const auto &it : deferred)
-		queue[it.first].Add(it.second);
-	deferred.clear();
+	// Take each request out of the ring buffer, and free up its slot for the
+	// time when the ring has wrapped around to it again.
+	while(true)
+	{
+		Request &request = requests[requestHead & (REQUEST_COUNT - 1)];
+		if(request.sequence.load(memory_order_acquire) != requestHead + 1)
+			break;
+		
+		queue[request.sound].Add(request.position);
+		request.sequence.store(requestHead + REQUEST_COUNT, memory_order_release);
+		++requestHead;
+	}
+	
+	if(hasDeferred.load(memory_order_acquire))
+	{
+		unique_lock<mutex> lock(audioMutex);
+		for(const auto &it : deferred)
+			queue[it.first].Add(it.second);
+		deferred.clear();
+		hasDeferred.store(false, memory_order_relaxed);
+	}
 }
 
 
@@ -253,17 +380,27 @@ void Audio::Play(const Sound *sound)
 // "listener". This will make it softer and change the left / right balance.
 void Audio::Play(const Sound *sound, const Point &position)
 {
-	if(!isInitialized || !sound || !sound->Buffer() || !volume)
+	if(!isInitialized || !sound || !volume)
 		return;
+	// If this sound has not been loaded yet, start loading it. It will begin
+	// playing once it is loaded, which may take a step or two.
+	if(!sound->IsLoaded())
+	{
+		if(sound->Path().empty())
+			return;
+		unique_lock<mutex> lock(audioMutex);
+		RequestLoad(sound);
+	}
 	
 	// Place sounds from the main thread directly into the queue. They are from
 	// the UI, and the Engine may not be running right now to call Update().
 	if(this_thread::get_id() == mainThreadID)
 		queue[sound].Add(position - listener);
-	else
+	else if(!PushRequest(sound, position - listener))
 	{
 		unique_lock<mutex> lock(audioMutex);
 		deferred[sound].Add(position - listener);
+		hasDeferred.store(true, memory_order_release);
 	}
 }
 
@@ -295,7 +432,7 @@ void Audio::Step()
 	vector<Source> newSources;
 	// For each sound that is looping, see if it is going to continue. For other
 	// sounds, check if they are done playing.
-	for(const Source &source : sources)
+	for(Source &source : sources)
 	{
 		if(source.GetSound()->IsLooping())
 		{
@@ -303,24 +440,28 @@ void Audio::Step()
 			if(it != queue.end())
 			{
 				source.Move(it->second);
+				source.Update();
 				newSources.push_back(source);
 				queue.erase(it);
 			}
 			else
 			{
+				// A streamed sound stops once it has played what is queued.
 				alSourcei(source.ID(), AL_LOOPING, false);
-				endingSources.push_back(source.ID());
+				endingSources.push_back(source);
 			}
 		}
 		else
 		{
 			// Non-looping sounds: check if they're done playing.
-			ALint state;
-			alGetSourcei(source.ID(), AL_SOURCE_STATE, &state);
-			if(state == AL_PLAYING)
+			if(source.Update())
 				newSources.push_back(source);
 			else
+			{
+				// Detach the sound's buffer, so that it can be unloaded.
+				alSourcei(source.ID(), AL_BUFFER, 0);
 				recycledSources.push_back(source.ID());
+			}
 		}
 	}
 	// These sources were looping and are now wrapping up a loop.
@@ -328,58 +469,110 @@ void Audio::Step()
 	while(it != endingSources.end())
 	{
 		ALint state;
-		alGetSourcei(*it, AL_SOURCE_STATE, &state);
+		alGetSourcei(it->ID(), AL_SOURCE_STATE, &state);
 		if(state == AL_PLAYING)
 		{
 			// Fade out the sound. This avoids a clicking or rasping sound if a
 			// sound is cut off in the middle of its loop.
 			float gain = 1.f;
-			alGetSourcef(*it, AL_GAIN, &gain);
+			alGetSourcef(it->ID(), AL_GAIN, &gain);
 			gain = max(0.f, gain - .05f);
-			alSourcef(*it, AL_GAIN, gain);
+			alSourcef(it->ID(), AL_GAIN, gain);
 			++it;
 		}
 		else
 		{
-			recycledSources.push_back(*it);
+			alSourcei(it->ID(), AL_BUFFER, 0);
+			recycledSources.push_back(it->ID());
 			it = endingSources.erase(it);
 		}
 	}
 	newSources.swap(sources);
 	
+	// Sounds that were still loading last step get another chance to start.
+	for(const auto &it : waiting)
+	{
+		QueueEntry &entry = queue[it.first];
+		entry.Add(it.second);
+		entry.age = max(entry.age, it.second.age);
+	}
+	waiting.clear();
+	
 	// Now, what is left in the queue is sounds that want to play, and that do
-	// not correspond to an existing source.
-	for(const auto &it : queue)
+	// not correspond to an existing source. Start the loudest ones first, so if
+	// there are not enough sources the quietest ones are left out. Sounds that
+	// are not loaded yet wait for the next step.
+	vector<map<const Sound *, QueueEntry>::const_iterator> starting;
+	for(auto it = queue.begin(); it != queue.end(); ++it)
+	{
+		if(it->second.weight < MIN_WEIGHT)
+			continue;
+		if(it->first->IsLoaded())
+			starting.push_back(it);
+		else if(it->second.age < MAX_WAIT)
+		{
+			QueueEntry &entry = waiting[it->first];
+			entry = it->second;
+			++entry.age;
+		}
+	}
+	sort(starting.begin(), starting.end(),
+		[](const map<const Sound *, QueueEntry>::const_iterator &a, const map<const Sound *, QueueEntry>::const_iterator &b)
+		{
+			return a->second.weight > b->second.weight;
+		});
+	for(const auto &it : starting)
 	{
 		// Use a recycled source if possible. Otherwise, create a new one.
 		unsigned source = 0;
-		if(recycledSources.empty())
+		if(!recycledSources.empty())
+		{
+			source = recycledSources.back();
+			recycledSources.pop_back();
+		}
+		else if(sources.size() < maxSources)
 		{
-			if(sources.size() >= maxSources)
-				break;
-			
 			alGenSources(1, &source);
+			// If we just tried to generate a new source and OpenAL would not
+			// give us one, we've reached this system's limit for the number of
+			// concurrent sounds.
 			if(!source)
-			{
-				// If we just tried to generate a new source and OpenAL would
-				// not give us one, we've reached this system's limit for the
-				// number of concurrent sounds.
 				maxSources = sources.size();
-				break;
-			}
 		}
-		else
+		if(!source)
 		{
-			source = recycledSources.back();
-			recycledSources.pop_back();
+			// Take over the quietest source, if it is quieter than this sound.
+			// The remaining sounds are all quieter than this one, so if this
+			// one cannot have a source, none of them can.
+			auto quietest = min_element(sources.begin(), sources.end(),
+				[](const Source &a, const Source &b) { return a.Weight() < b.Weight(); });
+			if(quietest == sources.end() || quietest->Weight() >= it->second.weight)
+				break;
+			
+			source = quietest->ID();
+			alSourceStop(source);
+			alSourcei(source, AL_BUFFER, 0);
+			sources.erase(quietest);
 		}
 		// Begin playing this sound.
-		sources.emplace_back(it.first, source);
-		sources.back().Move(it.second);
-		alSourcePlay(source);
+		sources.emplace_back(it->first, source);
+		sources.back().Move(it->second);
+		sources.back().Play();
 	}
 	queue.clear();
 	
+	// Keep track of which sounds have been used recently, and every so often
+	// unload the ones that have not if sounds are over their memory budget.
+	++step;
+	for(const Source &source : sources)
+		lastPlayed[source.GetSound()] = step;
+	size_t budget = static_cast<size_t>(max(0, Preferences::SoundMemory())) << 20;
+	if(budget && !(step % UNLOAD_INTERVAL))
+	{
+		unique_lock<mutex> lock(audioMutex);
+		UnloadSounds(budget);
+	}
+	
 	// Queue up new buffers for the music, if necessary.
 	int buffersDone = 0;
 	alGetSourcei(musicSource, AL_BUFFERS_PROCESSED, &buffersDone);
@@ -423,31 +616,29 @@ void Audio::Step()
 // Shut down the audio system (because we're about to quit).
 void Audio::Quit()
 {
-	// First, check if sounds are still being loaded in a separate thread, and
-	// if so interrupt that thread and wait for it to quit.
+	// First, check if sounds are still being loaded in the background, and if
+	// so wait for them to finish.
 	unique_lock<mutex> lock(audioMutex);
-	if(!loadQueue.empty())
-		loadQueue.clear();
-	if(loadThread.joinable())
-	{
-		lock.unlock();
-		loadThread.join();
-		lock.lock();
-	}
+	while(loading)
+		loadCondition.wait(lock);
 	
 	// Now, stop and delete any OpenAL sources that are playing.
+	// Their streams, if any, delete their buffers once they are detached.
 	for(const Source &source : sources)
 	{
-		alSourceStop(source.ID());
 		ALuint id = source.ID();
+		alSourceStop(id);
+		alSourcei(id, AL_BUFFER, 0);
 		alDeleteSources(1, &id);
 	}
 	sources.clear();
 	
 	// Also clean up any sources that are fading out.
-	for(unsigned id : endingSources)
+	for(const Source &source : endingSources)
 	{
+		ALuint id = source.ID();
 		alSourceStop(id);
+		alSourcei(id, AL_BUFFER, 0);
 		alDeleteSources(1, &id);
 	}
 	endingSources.clear();
@@ -458,11 +649,8 @@ void Audio::Quit()
 	recycledSources.clear();
 	
 	// Free the memory buffers for all the sound resources.
-	for(const auto &it : sounds)
-	{
-		ALuint id = it.second.Buffer();
-		alDeleteBuffers(1, &id);
-	}
+	for(auto &it : sounds)
+		it.second.Unload();
 	sounds.clear();
 	
 	// Clean up the music source and buffers.
@@ -512,6 +700,97 @@ namespace {
 	
 	
 	
+	// Add a request to the ring buffer. This returns false if it is full.
+	bool PushRequest(const Sound *sound, const Point &position)
+	{
+		size_t tail = requestTail.load(memory_order_relaxed);
+		while(true)
+		{
+			Request &request = requests[tail & (REQUEST_COUNT - 1)];
+			size_t sequence = request.sequence.load(memory_order_acquire);
+			intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(tail);
+			if(!difference)
+			{
+				// This slot is free. Claim it, unless another thread beat this
+				// one to it (in which case "tail" is updated to the new tail).
+				if(requestTail.compare_exchange_weak(tail, tail + 1, memory_order_relaxed))
+				{
+					request.sound = sound;
+					request.position = position;
+					request.sequence.store(tail + 1, memory_order_release);
+					return true;
+				}
+			}
+			else if(difference < 0)
+				return false;
+			else
+				tail = requestTail.load(memory_order_relaxed);
+		}
+	}
+	
+	
+	
+	// Start decoding the given sound.
+	Stream::Stream(const Sound *sound)
+		: buffers(STREAM_BUFFERS, 0)
+	{
+		alGenBuffers(STREAM_BUFFERS, &buffers.front());
+		freeBuffers = buffers;
+		music.SetSource(sound->Data(), sound->IsLooping());
+	}
+	
+	
+	
+	// The buffers must no longer be queued on any source when this is deleted.
+	Stream::~Stream()
+	{
+		alDeleteBuffers(STREAM_BUFFERS, &buffers.front());
+	}
+	
+	
+	
+	// Queue up any newly decoded audio on the given source, and make sure that
+	// it is playing. This returns false once all of it has been played.
+	bool Stream::Update(unsigned source)
+	{
+		// Take back the buffers that are done playing.
+		ALint processed = 0;
+		alGetSourcei(source, AL_BUFFERS_PROCESSED, &processed);
+		for( ; processed > 0; --processed)
+		{
+			unsigned buffer = 0;
+			alSourceUnqueueBuffers(source, 1, &buffer);
+			freeBuffers.push_back(buffer);
+		}
+		
+		// Fill them with whatever has been decoded. The decoder's output is in
+		// stereo, but only mono sounds can be positioned, so mix it down.
+		while(!freeBuffers.empty() && music.HasChunk())
+		{
+			const vector<int16_t> &chunk = music.NextChunk();
+			mono.resize(chunk.size() / 2);
+			for(size_t i = 0; i < mono.size(); ++i)
+				mono[i] = (chunk[2 * i] + chunk[2 * i + 1]) / 2;
+			
+			unsigned buffer = freeBuffers.back();
+			freeBuffers.pop_back();
+			alBufferData(buffer, AL_FORMAT_MONO16, &mono.front(), 2 * mono.size(), 44100);
+			alSourceQueueBuffers(source, 1, &buffer);
+		}
+		
+		// The source stops if the decoder falls behind, and only starts out
+		// once the first block has been decoded.
+		bool isQueued = (freeBuffers.size() < STREAM_BUFFERS);
+		ALint state;
+		alGetSourcei(source, AL_SOURCE_STATE, &state);
+		if(state != AL_PLAYING && isQueued)
+			alSourcePlay(source);
+		
+		return isQueued || !music.IsFinished();
+	}
+	
+	
+	
 	// This is a wrapper for an OpenAL audio source.
 	Source::Source(const Sound *sound, unsigned source)
 		: sound(sound), source(source)
@@ -524,15 +803,27 @@ namespace {
 		alSourcef(source, AL_REFERENCE_DISTANCE, 1.);
 		alSourcef(source, AL_ROLLOFF_FACTOR, 1.);
 		alSourcef(source, AL_MAX_DISTANCE, 100.);
-		alSourcei(source, AL_LOOPING, sound->IsLooping());
-		alSourcei(source, AL_BUFFER, sound->Buffer());
+		// Streamed sounds loop by decoding from the start again, not by
+		// looping what is queued on the source.
+		if(sound->IsStreamed())
+		{
+			stream = make_shared<Stream>(sound);
+			alSourcei(source, AL_LOOPING, false);
+			alSourcei(source, AL_BUFFER, 0);
+		}
+		else
+		{
+			alSourcei(source, AL_LOOPING, sound->IsLooping());
+			alSourcei(source, AL_BUFFER, sound->Buffer());
+		}
 	}
 	
 	
 	
 	// Reposition this source based on the given entry in a sound queue.
-	void Source::Move(const QueueEntry &entry) const
+	void Source::Move(const QueueEntry &entry)
 	{
+		weight = entry.weight;
 		Point angle = entry.sum / entry.weight;
 		// The source should be along the vector (angle.X(), angle.Y(), 1).
 		// The length of the vector should be sqrt(1 / weight).
@@ -542,6 +833,32 @@ namespace {
 	
 	
 	
+	// Begin playing this source. A streamed sound starts once it has decoded
+	// enough to play.
+	void Source::Play()
+	{
+		if(stream)
+			stream->Update(source);
+		else
+			alSourcePlay(source);
+	}
+	
+	
+	
+	// Check if this source is still playing, and give a streamed sound any
+	// audio that has been decoded since the last step.
+	bool Source::Update()
+	{
+		if(stream)
+			return stream->Update(source);
+		
+		ALint state;
+		alGetSourcei(source, AL_SOURCE_STATE, &state);
+		return state == AL_PLAYING;
+	}
+	
+	
+	
 	// Get the OpenAL ID for this source.
 	unsigned Source::ID() const
 	{
@@ -558,29 +875,75 @@ namespace {
 	
 	
 	
-	// Thread entry point for loading sounds.
-	void Load()
+	// Get the weight of the entry this source was last moved to, which is how
+	// loud it is (squared).
+	double Source::Weight() const
 	{
-		string name;
-		string path;
-		while(true)
+		return weight;
+	}
+	
+	
+	
+	// Load the given sound from its file. This is run by the thread pool.
+	void Load(const Sound *sound)
+	{
+		// All sounds belong to the "sounds" map, so it is safe to modify them
+		// here. Only this task touches this sound until it is done loading.
+		Sound *target = const_cast<Sound *>(sound);
+		bool success = target->Load();
+		
+		unique_lock<mutex> lock(audioMutex);
+		if(success)
+			requested.erase(sound);
+		else
+			Files::LogError("Unable to load sound from path: " + sound->Path());
+		if(!--loading)
+			loadCondition.notify_all();
+	}
+	
+	
+	
+	// Start loading the given sound in the background, unless that was already
+	// done. The audio mutex must be locked.
+	void RequestLoad(const Sound *sound)
+	{
+		if(!requested.insert(sound).second)
+			return;
+		
+		++loading;
+		ThreadPool::Shared().Submit(bind(&Load, sound));
+	}
+	
+	
+	
+	// Unload the sounds that have gone unplayed the longest until they fit in
+	// the given memory budget. The audio mutex must be locked.
+	void UnloadSounds(size_t budget)
+	{
+		size_t total = 0;
+		vector<pair<int, Sound *>> unused;
+		for(auto &it : sounds)
 		{
-			{
-				unique_lock<mutex> lock(audioMutex);
-				// If this is not the first time through, remove the previous item
-				// in the queue. This is a signal that it has been loaded, so we
-				// must not remove it until after loading the file.
-				if(!path.empty() && !loadQueue.empty())
-					loadQueue.erase(loadQueue.begin());
-				if(loadQueue.empty())
-					return;
-				name = loadQueue.begin()->first;
-				path = loadQueue.begin()->second;
-			}
-			
-			// Unlock the mutex for the time-intensive part of the loop.
-			if(!sounds[name].Load(path))
-				Files::LogError("Unable to load sound \"" + name + "\" from path: " + path);
+			Sound &sound = it.second;
+			size_t memory = sound.Memory();
+			total += memory;
+			// Sounds that are loading or playing must not be unloaded.
+			if(!memory || requested.count(&sound))
+				continue;
+			int last = lastPlayed[&sound];
+			if(step - last >= MIN_UNUSED)
+				unused.emplace_back(last, &sound);
+		}
+		if(total <= budget)
+			return;
+		
+		sort(unused.begin(), unused.end());
+		for(const auto &it : unused)
+		{
+			total -= it.second->Memory();
+			it.second->Unload();
+			if(total <= budget)
+				break;
 		}
 	}
 }
@@ -13,6 +13,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #ifndef AUDIO_H_
 #define AUDIO_H_
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -44,6 +45,11 @@ public:
 	// "sound/" folder, and without ~ if it's on the end, or the extension.
 	// Do not call this function until Progress() is 100%.
 	static const Sound *Get(const std::string &name);
+	// Get how much memory the sounds that are loaded take up.
+	static size_t Memory();
+	// Get how many sound sources are playing, including looping sounds that
+	// are fading out. This must only be called from the main thread.
+	static int Voices();
 	
 	// Set the listener's position, and also update any sounds that have been
 	// added but deferred because they were added from a thread other than the
@@ -54,6 +54,7 @@ BankPanel::BankPanel(PlayerInfo &player)
 	// This panel should allow events it does not respond to to pass through to
 	// the underlying PlanetPanel.
 	SetTrapAllEvents(false);
+	SetIsStatic(true);
 }
 
 
@@ -79,9 +80,9 @@ void BankPanel::Draw()
 	table.DrawAt(Point(0., FIRST_Y));
 	
 	// Use stock colors from the game data.
-	Color back = *GameData::Colors().Get("faint");
-	Color unselected = *GameData::Colors().Get("medium");
-	Color selected = *GameData::Colors().Get("bright");
+	static const Color &back = *GameData::Colors().Get("faint");
+	static const Color &unselected = *GameData::Colors().Get("medium");
+	static const Color &selected = *GameData::Colors().Get("bright");
 	
 	// Draw the heading of the table.
 	table.DrawUnderline(unselected);
@@ -105,10 +106,11 @@ void BankPanel::Draw()
 	int64_t salaries = player.Salaries();
 	int64_t income[2] = {0, 0};
 	static const string prefix[2] = {"salary: ", "tribute: "};
+	const ConditionsStore &conditions = player.Conditions();
 	for(int i = 0; i < 2; ++i)
 	{
-		auto it = player.Conditions().lower_bound(prefix[i]);
-		for( ; it != player.Conditions().end() && !it->first.compare(0, prefix[i].length(), prefix[i]); ++it)
+		auto it = conditions.lower_bound(prefix[i]);
+		for( ; it != conditions.end() && !it->first.compare(0, prefix[i].length(), prefix[i]); ++it)
 			income[i] += it->second;
 	}
 	// Figure out how many rows of the display are for mortgages, and also check
@@ -225,7 +227,7 @@ void BankPanel::Draw()
 	}
 	
 	// Draw the "Pay All" button.
-	const Interface *interface = GameData::Interfaces().Get("bank");
+	static const Interface *interface = GameData::Interfaces().Get("bank");
 	Information info;
 	for(const Mortgage &mortgage : player.Accounts().Mortgages())
 		if(mortgage.Principal() <= player.Accounts().Credits())
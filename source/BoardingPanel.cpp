@@ -119,10 +119,10 @@ void BoardingPanel::Draw()
 	
 	// Draw the list of plunder.
 	Color opaque(.1, 1.);
-	Color back = *GameData::Colors().Get("faint");
-	Color dim = *GameData::Colors().Get("dim");
-	Color medium = *GameData::Colors().Get("medium");
-	Color bright = *GameData::Colors().Get("bright");
+	static const Color &back = *GameData::Colors().Get("faint");
+	static const Color &dim = *GameData::Colors().Get("dim");
+	static const Color &medium = *GameData::Colors().Get("medium");
+	static const Color &bright = *GameData::Colors().Get("bright");
 	FillShader::Fill(Point(-155., -60.), Point(360., 250.), opaque);
 	
 	int index = (scroll - 10) / 20;
@@ -205,7 +205,7 @@ void BoardingPanel::Draw()
 			Round(defenseOdds.DefenderCasualties(vCrew, crew)));
 	}
 	
-	const Interface *interface = GameData::Interfaces().Get("boarding");
+	static const Interface *interface = GameData::Interfaces().Get("boarding");
 	interface->Draw(info, this);
 	
 	// Draw the status messages from hand to hand combat.
@@ -286,16 +286,38 @@ void Body::SetStep(int step, bool isHighDPI) const
 	// If the step is negative or there is no sprite, do nothing. This updates
 	// and caches the mask and the frame so that if further queries are made at
 	// this same time step, we don't need to redo the calculations.
-	if(step < 0 || !sprite || !sprite->Frames() || (step == currentStep && isHighDPI == currentHighDPI))
+	if(step < 0 || !sprite || !sprite->Frames())
+		return;
+	// Which frames are shown only depends on the step. If only the resolution
+	// has changed (e.g. the same body is drawn at a different zoom than it was
+	// last looked up at), only the texture and its layers need to change.
+	if(step != currentStep)
+	{
+		currentStep = step;
+		SetFrames(step);
+	}
+	else if(isHighDPI == currentHighDPI)
 		return;
-	currentStep = step;
 	currentHighDPI = isHighDPI;
 	
+	frame.texture = sprite->Texture(isHighDPI);
+	frame.first = sprite->Layer(firstIndex, isHighDPI);
+	frame.second = sprite->Layer(secondIndex, isHighDPI);
+}
+
+
+
+// Figure out which frames to blend between at the given step, and which one
+// the collision mask should be taken from.
+void Body::SetFrames(int step) const
+{
 	// If the sprite only has one frame, no need to animate anything.
 	int frames = sprite->Frames();
 	if(frames <= 1)
 	{
-		frame.first = sprite->Texture(0, isHighDPI);
+		firstIndex = 0;
+		secondIndex = 0;
+		frame.fade = 0.f;
 		activeIndex = 0;
 		return;
 	}
@@ -320,8 +342,8 @@ void Body::SetStep(int step, bool isHighDPI) const
 	frame.fade = modf(frameF, &frameF);
 	step = frameF;
 	
-	int firstIndex = 0;
-	int secondIndex = 0;
+	firstIndex = 0;
+	secondIndex = 0;
 	if(!rewind)
 	{
 		// This is not a rewinding sprite. It is either playing once through, or
@@ -376,10 +398,9 @@ void Body::SetStep(int step, bool isHighDPI) const
 				frame.fade = 0.f;
 		}
 	}
-	// Cache the frame and mask info so as long as the step stays the same, none
-	// of the above calculations need to be redone. This is important for objects
-	// whose masks may be queried many times for collision tests.
-	frame.first = sprite->Texture(firstIndex, isHighDPI);
-	frame.second = sprite->Texture(secondIndex, isHighDPI);
+	// Collisions use the mask of whichever frame is closer. It is cached along
+	// with the frames, so as long as the step stays the same none of the above
+	// calculations need to be redone, even for objects whose masks are queried
+	// many times for collision tests.
 	activeIndex = (frame.fade > .5f ? secondIndex : firstIndex);
 }
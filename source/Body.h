@@ -35,8 +35,11 @@ public:
 	// between two frames.
 	class Frame {
 	public:
-		uint32_t first = 0;
-		uint32_t second = 0;
+		// The array texture holding this body's sprite, and the layers in it
+		// for the two frames to blend between.
+		uint32_t texture = 0;
+		int first = 0;
+		int second = 0;
 		float fade = 0.f;
 	};
 	
@@ -107,6 +110,9 @@ private:
 	// Set what animation step we're on. This affects future calls to GetMask()
 	// and GetFrame().
 	void SetStep(int step, bool isHighDPI) const;
+	// Figure out which frames to blend between at the given step, and which one
+	// the collision mask should be taken from.
+	void SetFrames(int step) const;
 	
 	
 private:
@@ -128,6 +134,9 @@ private:
 	mutable int currentStep = -1;
 	mutable bool currentHighDPI = false;
 	mutable Frame frame;
+	// The frames being blended between, and the one the mask is taken from.
+	mutable int firstIndex = 0;
+	mutable int secondIndex = 0;
 	mutable int activeIndex = 0;
 };
 
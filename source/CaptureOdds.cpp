@@ -16,17 +16,21 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Ship.h"
 
 #include <algorithm>
+#include <list>
 
 using namespace std;
 
+namespace {
+	// Keep the tables for this many recent pairs of crews.
+	const size_t MAX_TABLES = 8;
+}
+
 
 
 // Constructor.
 CaptureOdds::CaptureOdds(const Ship &attacker, const Ship &defender)
 {
-	powerA = Power(attacker, false);
-	powerD = Power(defender, true);
-	Calculate();
+	table = GetTable(Power(attacker, false), Power(defender, true));
 }
 
 
@@ -46,7 +50,7 @@ double CaptureOdds::Odds(int attackingCrew, int defendingCrew) const
 	if(attackingCrew < 2 || index < 0)
 		return 0.;
 	
-	return capture[index];
+	return table->capture[index];
 }
 
 
@@ -61,7 +65,7 @@ double CaptureOdds::AttackerCasualties(int attackingCrew, int defendingCrew) con
 	if(attackingCrew < 2 || !defendingCrew || index < 0)
 		return 0.;
 	
-	return casualtiesA[index];
+	return table->casualtiesA[index];
 }
 
 
@@ -76,7 +80,7 @@ double CaptureOdds::DefenderCasualties(int attackingCrew, int defendingCrew) con
 	if(attackingCrew < 2 || !defendingCrew || index < 0)
 		return 0.;
 	
-	return casualtiesD[index];
+	return table->casualtiesD[index];
 }
 
 
@@ -85,10 +89,10 @@ double CaptureOdds::DefenderCasualties(int attackingCrew, int defendingCrew) con
 // weapons) for the attacker when they have the given number of crew remaining.
 double CaptureOdds::AttackerPower(int attackingCrew) const
 {
-	if(static_cast<unsigned>(attackingCrew - 1) >= powerA.size())
+	if(static_cast<unsigned>(attackingCrew - 1) >= table->powerA.size())
 		return 0.;
 	
-	return powerA[attackingCrew - 1];
+	return table->powerA[attackingCrew - 1];
 }
 
 
@@ -97,27 +101,41 @@ double CaptureOdds::AttackerPower(int attackingCrew) const
 // weapons) for the defender when they have the given number of crew remaining.
 double CaptureOdds::DefenderPower(int defendingCrew) const
 {
-	if(static_cast<unsigned>(defendingCrew - 1) >= powerD.size())
+	if(static_cast<unsigned>(defendingCrew - 1) >= table->powerD.size())
 		return 0.;
 	
-	return powerD[defendingCrew - 1];
+	return table->powerD[defendingCrew - 1];
 }
 
 
 
-// Generate the lookup tables.
-void CaptureOdds::Calculate()
+// Fill in the lookup tables for every number of attacking crew up to the
+// given one. Each row only depends on the row before it, so the rows for
+// larger crews can be left out until someone asks about them.
+void CaptureOdds::Table::Calculate(unsigned attackingCrew)
 {
 	if(powerD.empty() || powerA.empty())
 		return;
 	
+	attackingCrew = min<unsigned>(attackingCrew, powerA.size());
+	unsigned rows = capture.size() / powerD.size();
+	if(rows >= attackingCrew)
+		return;
+	
 	// The first row represents the case where the attacker has only one crew left.
 	// In that case, the defending ship can never be successfully captured.
-	capture.resize(powerD.size(), 0.);
-	casualtiesA.resize(powerD.size(), 0.);
-	casualtiesD.resize(powerD.size(), 0.);
-	unsigned up = 0;
-	for(unsigned a = 2; a <= powerA.size(); ++a)
+	if(!rows)
+	{
+		capture.resize(powerD.size(), 0.);
+		casualtiesA.resize(powerD.size(), 0.);
+		casualtiesD.resize(powerD.size(), 0.);
+		rows = 1;
+	}
+	capture.reserve(attackingCrew * powerD.size());
+	casualtiesA.reserve(attackingCrew * powerD.size());
+	casualtiesD.reserve(attackingCrew * powerD.size());
+	unsigned up = (rows - 1) * powerD.size();
+	for(unsigned a = rows + 1; a <= attackingCrew; ++a)
 	{
 		double ap = powerA[a - 1];
 		// Special case: odds for defender having only one person,
@@ -145,16 +163,18 @@ void CaptureOdds::Calculate()
 
 
 
-// Map the given crew complements to an index in the lookup tables. There is no
+// Map the given crew complements to an index in the lookup tables, filling in
+// the tables up to that row if they have not been calculated yet. There is no
 // row in the table for 0 crew on either ship.
 int CaptureOdds::Index(int attackingCrew, int defendingCrew) const
 {
-	if(static_cast<unsigned>(attackingCrew - 1) > powerA.size())
+	if(static_cast<unsigned>(attackingCrew - 1) >= table->powerA.size())
 		return -1;
-	if(static_cast<unsigned>(defendingCrew - 1) > powerD.size())
+	if(static_cast<unsigned>(defendingCrew - 1) >= table->powerD.size())
 		return -1;
 	
-	return (attackingCrew - 1) * powerD.size() + (defendingCrew - 1);
+	table->Calculate(attackingCrew);
+	return (attackingCrew - 1) * table->powerD.size() + (defendingCrew - 1);
 }
 
 
@@ -193,3 +213,28 @@ vector<double> CaptureOdds::Power(const Ship &ship, bool isDefender)
 	
 	return power;
 }
+
+
+
+// Find the lookup table for the given attacker and defender power, reusing a
+// recent one if the crews and their weapons are the same. That way, opening the
+// boarding panel again for the same ship does not recalculate anything.
+shared_ptr<CaptureOdds::Table> CaptureOdds::GetTable(vector<double> &&powerA, vector<double> &&powerD)
+{
+	// The most recently used tables are at the front of the list.
+	static list<shared_ptr<Table>> recent;
+	for(auto it = recent.begin(); it != recent.end(); ++it)
+		if((*it)->powerA == powerA && (*it)->powerD == powerD)
+		{
+			recent.splice(recent.begin(), recent, it);
+			return recent.front();
+		}
+	
+	shared_ptr<Table> table = make_shared<Table>();
+	table->powerA = std::move(powerA);
+	table->powerD = std::move(powerD);
+	recent.push_front(table);
+	if(recent.size() > MAX_TABLES)
+		recent.pop_back();
+	return table;
+}
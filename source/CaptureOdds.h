@@ -13,6 +13,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #ifndef CAPTURE_ODDS_H_
 #define CAPTURE_ODDS_H_
 
+#include <memory>
 #include <vector>
 
 class Ship;
@@ -48,26 +49,41 @@ public:
 	
 	
 private:
-	// Generate the lookup table.
-	void Calculate();
-	// Map crew numbers into an index in the lookup table.
+	// The lookup tables for one pair of power tables. These are shared between
+	// every CaptureOdds object for the same two crews, and the rows for each
+	// number of attacking crew are only filled in when they are first needed.
+	class Table {
+	public:
+		// Fill in every row up to the given number of attacking crew.
+		void Calculate(unsigned attackingCrew);
+		
+		// Attacker and defender power lookup tables.
+		std::vector<double> powerA;
+		std::vector<double> powerD;
+		
+		// Capture odds lookup table.
+		std::vector<double> capture;
+		// Expected casualties lookup table.
+		std::vector<double> casualtiesA;
+		std::vector<double> casualtiesD;
+	};
+	
+	
+private:
+	// Map crew numbers into an index in the lookup table, filling in the table
+	// up to that point if necessary.
 	int Index(int attackingCrew, int defendingCrew) const;
 	
 	// Calculate attack or defense power for each number of crew members up to
 	// the given ship's full complement.
 	static std::vector<double> Power(const Ship &ship, bool isDefender);
+	// Find the table for the given power tables, reusing a recent one if the
+	// crews are the same.
+	static std::shared_ptr<Table> GetTable(std::vector<double> &&powerA, std::vector<double> &&powerD);
 	
 	
 private:
-	// Attacker and defender power lookup tables.
-	std::vector<double> powerA;
-	std::vector<double> powerD;
-	
-	// Capture odds lookup table.
-	std::vector<double> capture;
-	// Expected casualties lookup table.
-	std::vector<double> casualtiesA;
-	std::vector<double> casualtiesD;
+	std::shared_ptr<Table> table;
 };
 
 
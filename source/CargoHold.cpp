@@ -25,6 +25,10 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 using namespace std;
 
+namespace {
+	const int MASS = Outfit::AttributeID("mass");
+}
+
 
 
 // Remove any items in this cargo hold.
@@ -36,6 +40,7 @@ void CargoHold::Clear()
 	outfits.clear();
 	missionCargo.clear();
 	passengers.clear();
+	used = 0;
 }
 
 
@@ -66,6 +71,7 @@ void CargoHold::Load(const DataNode &node)
 			}
 		}
 	}
+	UpdateUsed();
 }
 
 
@@ -157,7 +163,7 @@ int CargoHold::Free() const
 // (Some outfits may have non-integral masses.)
 int CargoHold::Used() const
 {
-	return CommoditiesSize() + OutfitsSize() + MissionCargoSize();
+	return used;
 }
 
 
@@ -178,7 +184,7 @@ int CargoHold::OutfitsSize() const
 {
 	double size = 0.;
 	for(const auto &it : outfits)
-		size += it.second * it.first->Get("mass");
+		size += it.second * it.first->Get(MASS);
 	return ceil(size);
 }
 
@@ -259,7 +265,7 @@ int CargoHold::Passengers() const
 // Normal cargo:
 int CargoHold::Get(const string &commodity) const
 {
-	map<string, int>::const_iterator it = commodities.find(commodity);
+	auto it = commodities.find(commodity);
 	return (it == commodities.end() ? 0 : it->second);
 }
 
@@ -268,7 +274,7 @@ int CargoHold::Get(const string &commodity) const
 // Spare outfits (including plunder and mined materials):
 int CargoHold::Get(const Outfit *outfit) const
 {
-	map<const Outfit *, int>::const_iterator it = outfits.find(outfit);
+	auto it = outfits.find(outfit);
 	return (it == outfits.end() ? 0 : it->second);
 }
 
@@ -277,7 +283,7 @@ int CargoHold::Get(const Outfit *outfit) const
 // Mission cargo:
 int CargoHold::Get(const Mission *mission) const
 {
-	map<const Mission *, int>::const_iterator it = missionCargo.find(mission);
+	auto it = missionCargo.find(mission);
 	return (it == missionCargo.end() ? 0 : it->second);
 }
 
@@ -286,14 +292,14 @@ int CargoHold::Get(const Mission *mission) const
 // Check how many passengers for the given mission are being carried.
 int CargoHold::GetPassengers(const Mission *mission) const
 {
-	map<const Mission *, int>::const_iterator it = passengers.find(mission);
+	auto it = passengers.find(mission);
 	return (it == passengers.end() ? 0 : it->second);
 }
 
 
 
 // Access the commodities map directly.
-const map<string, int> &CargoHold::Commodities() const
+const FlatMap<string, int> &CargoHold::Commodities() const
 {
 	return commodities;
 }
@@ -301,7 +307,7 @@ const map<string, int> &CargoHold::Commodities() const
 
 
 // Access the outfits map directly.
-const map<const Outfit *, int> &CargoHold::Outfits() const
+const FlatMap<const Outfit *, int> &CargoHold::Outfits() const
 {
 	return outfits;
 }
@@ -309,7 +315,7 @@ const map<const Outfit *, int> &CargoHold::Outfits() const
 
 
 // Access the mission cargo map directly.
-const map<const Mission *, int> &CargoHold::MissionCargo() const
+const FlatMap<const Mission *, int> &CargoHold::MissionCargo() const
 {
 	return missionCargo;
 }
@@ -317,7 +323,7 @@ const map<const Mission *, int> &CargoHold::MissionCargo() const
 
 
 // Access the mission passenger map directly.
-const map<const Mission *, int> &CargoHold::PassengerList() const
+const FlatMap<const Mission *, int> &CargoHold::PassengerList() const
 {
 	return passengers;
 }
@@ -344,8 +350,12 @@ int CargoHold::Transfer(const string &commodity, int amount, CargoHold *to)
 	
 	// The "to" hold need not be defined.
 	commodities[commodity] -= amount;
+	UpdateUsed();
 	if(to)
+	{
 		to->commodities[commodity] += amount;
+		to->UpdateUsed();
+	}
 	
 	return amount;
 }
@@ -355,7 +365,7 @@ int CargoHold::Transfer(const string &commodity, int amount, CargoHold *to)
 // Transfer outfits from one cargo hold to another.
 int CargoHold::Transfer(const Outfit *outfit, int amount, CargoHold *to)
 {
-	double mass = outfit->Get("mass");
+	double mass = outfit->Get(MASS);
 	
 	// Whichever ship is removing the cargo is limited by how much it has
 	// available. The receiving ship is limited by its free space, but only if
@@ -374,8 +384,12 @@ int CargoHold::Transfer(const Outfit *outfit, int amount, CargoHold *to)
 	
 	// The "to" hold need not be defined.
 	outfits[outfit] -= amount;
+	UpdateUsed();
 	if(to)
+	{
 		to->outfits[outfit] += amount;
+		to->UpdateUsed();
+	}
 	
 	return amount;
 }
@@ -405,8 +419,12 @@ int CargoHold::Transfer(const Mission *mission, int amount, CargoHold *to)
 	
 	// The "to" hold need not be defined.
 	missionCargo[mission] -= amount;
+	UpdateUsed();
 	if(to)
+	{
 		to->missionCargo[mission] += amount;
+		to->UpdateUsed();
+	}
 	
 	return amount;
 }
@@ -451,6 +469,7 @@ void CargoHold::TransferAll(CargoHold *to)
 		outfits.clear();
 		missionCargo.clear();
 		passengers.clear();
+		used = 0;
 		return;
 	}
 	
@@ -518,6 +537,7 @@ void CargoHold::AddMissionCargo(const Mission *mission)
 		missionCargo[mission] += mission->CargoSize();
 	if(mission && mission->Passengers())
 		passengers[mission] += mission->Passengers();
+	UpdateUsed();
 }
 
 
@@ -527,6 +547,7 @@ void CargoHold::RemoveMissionCargo(const Mission *mission)
 {
 	missionCargo.erase(mission);
 	passengers.erase(mission);
+	UpdateUsed();
 }
 
 
@@ -570,3 +591,11 @@ int CargoHold::IllegalCargoFine() const
 	}
 	return worst;
 }
+
+
+
+// Recalculate the total space used, after any change to the cargo.
+void CargoHold::UpdateUsed()
+{
+	used = CommoditiesSize() + OutfitsSize() + MissionCargoSize();
+}
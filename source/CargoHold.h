@@ -13,8 +13,9 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #ifndef CARGO_HOLD_H_
 #define CARGO_HOLD_H_
 
+#include "FlatMap.h"
+
 #include <cstdint>
-#include <map>
 #include <string>
 
 class DataNode;
@@ -66,12 +67,12 @@ public:
 	int Get(const Mission *mission) const;
 	int GetPassengers(const Mission *mission) const;
 	
-	const std::map<std::string, int> &Commodities() const;
-	const std::map<const Outfit *, int> &Outfits() const;
+	const FlatMap<std::string, int> &Commodities() const;
+	const FlatMap<const Outfit *, int> &Outfits() const;
 	// Note: some missions may have cargo that takes up 0 space, but should
 	// still show up on the cargo listing.
-	const std::map<const Mission *, int> &MissionCargo() const;
-	const std::map<const Mission *, int> &PassengerList() const;
+	const FlatMap<const Mission *, int> &MissionCargo() const;
+	const FlatMap<const Mission *, int> &PassengerList() const;
 	
 	// For all the transfer functions, the "other" can be null if you simply want
 	// the commodity to "disappear" or, if the "amount" is negative, to have an
@@ -104,16 +105,23 @@ public:
 	int IllegalCargoFine() const;
 	
 	
+private:
+	// Recalculate the total space used, after any change to the cargo.
+	void UpdateUsed();
+	
+	
 private:
 	// Use -1 to indicate unlimited capacity.
 	int size = -1;
 	int bunks = -1;
+	// Used() is called many times per frame for each ship, so cache it.
+	int used = 0;
 	
 	// Track how many objects of each type are being carried:
-	std::map<std::string, int> commodities;
-	std::map<const Outfit *, int> outfits;
-	std::map<const Mission *, int> missionCargo;
-	std::map<const Mission *, int> passengers;
+	FlatMap<std::string, int> commodities;
+	FlatMap<const Outfit *, int> outfits;
+	FlatMap<const Mission *, int> missionCargo;
+	FlatMap<const Mission *, int> passengers;
 };
 
 
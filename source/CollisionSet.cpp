@@ -18,10 +18,10 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Point.h"
 #include "Projectile.h"
 #include "Ship.h"
+#include "ThreadPool.h"
 
 #include <algorithm>
 #include <numeric>
-#include <set>
 
 using namespace std;
 
@@ -32,11 +32,16 @@ using namespace std;
 CollisionSet::CollisionSet(int cellSize, int cellCount)
 {
 	// Right shift amount to convert from (x, y) location to grid (x, y).
-	SHIFT = 0;
+	int shift = 0;
 	while(cellSize >>= 1)
-		++SHIFT;
-	CELL_SIZE = (1 << SHIFT);
-	CELL_MASK = CELL_SIZE - 1;
+		++shift;
+	// Each level's cells are twice as big as the previous level's.
+	for(Grid &grid : grids)
+	{
+		grid.SHIFT = shift++;
+		grid.CELL_SIZE = (1 << grid.SHIFT);
+		grid.CELL_MASK = grid.CELL_SIZE - 1;
+	}
 	
 	// Number of grid rows and columns.
 	CELLS = 1;
@@ -54,13 +59,15 @@ CollisionSet::CollisionSet(int cellSize, int cellCount)
 void CollisionSet::Clear(int step)
 {
 	this->step = step;
+	bodies = 0;
 	
-	added.clear();
-	sorted.clear();
-	counts.clear();
-	// The counts vector starts with two sentinel slots that will be used in the
-	// course of performing the radix sort.
-	counts.resize(CELLS * CELLS + 2, 0);
+	// Keep the lookup table from the last step, and remember what was in it,
+	// in case it can just be patched.
+	for(Grid &grid : grids)
+	{
+		grid.previous.swap(grid.added);
+		grid.added.clear();
+	}
 }
 
 
@@ -68,45 +75,317 @@ void CollisionSet::Clear(int step)
 // Add an object to the set.
 void CollisionSet::Add(Body &body)
 {
+	// Find the finest grid whose cells are at least as big as this object, so
+	// it will occupy no more than two cells in each direction. Anything too big
+	// for even the coarsest grid just occupies more of its cells.
+	double diameter = 2. * body.Radius();
+	int level = 0;
+	while(level < LEVELS - 1 && grids[level].CELL_SIZE < diameter)
+		++level;
+	Grid &grid = grids[level];
+	
 	// Calculate the range of (x, y) grid coordinates this object covers.
-	int minX = static_cast<int>(body.Position().X() - body.Radius()) >> SHIFT;
-	int minY = static_cast<int>(body.Position().Y() - body.Radius()) >> SHIFT;
-	int maxX = static_cast<int>(body.Position().X() + body.Radius()) >> SHIFT;
-	int maxY = static_cast<int>(body.Position().Y() + body.Radius()) >> SHIFT;
+	int minX = static_cast<int>(body.Position().X() - body.Radius()) >> grid.SHIFT;
+	int minY = static_cast<int>(body.Position().Y() - body.Radius()) >> grid.SHIFT;
+	int maxX = static_cast<int>(body.Position().X() + body.Radius()) >> grid.SHIFT;
+	int maxY = static_cast<int>(body.Position().Y() + body.Radius()) >> grid.SHIFT;
 	
 	// Add a pointer to this object in every grid cell it occupies.
 	for(int y = minY; y <= maxY; ++y)
-	{
-		int gy = y & WRAP_MASK;
 		for(int x = minX; x <= maxX; ++x)
+			grid.added.emplace_back(&body, bodies, x, y);
+	++bodies;
+}
+
+
+
+// Finish adding objects (and organize them into the final lookup table).
+// If the same objects were added in the same order as in the last step,
+// and only a few of them moved to different grid cells, the lookup table
+// from the last step is patched instead of being built from scratch.
+void CollisionSet::Finish()
+{
+	for(Grid &grid : grids)
+	{
+		if(grid.added.empty())
+			grid.sorted.clear();
+		else if(!Patch(grid))
+			Rebuild(grid);
+	}
+	
+	// Finding a body's mask also updates which animation frame it is showing,
+	// so do that here, before any queries might look at the bodies from
+	// several threads at once.
+	for(const Grid &grid : grids)
+		for(const Entry &entry : grid.added)
+			entry.body->GetMask(step);
+}
+
+
+
+// Get the first object that collides with the given projectile. If a
+// "closest hit" value is given, update that value. Like Circle(), this may
+// be called from several threads at once.
+Body *CollisionSet::Line(const Projectile &projectile, double *closestHit) const
+{
+	// Keep track of the closest collision found so far.
+	double closest = 1.;
+	Body *result = nullptr;
+	
+	Query &query = ThreadQuery();
+	for(const Grid &grid : grids)
+		if(!grid.added.empty())
+			Line(grid, projectile, closest, result, query);
+	
+	if(closest < 1. && closestHit)
+		*closestHit = closest;
+	return result;
+}
+
+
+
+// Do a line check for every one of the given projectiles at once, and store
+// the result for each projectile at the same index in the given vector.
+void CollisionSet::Lines(const vector<Projectile> &projectiles, vector<Hit> &hits) const
+{
+	hits.assign(projectiles.size(), Hit());
+	if(projectiles.empty())
+		return;
+	
+	// Sort the projectiles by which cell of the finest grid they start in, so
+	// that projectiles checked one after another mostly examine the same few
+	// objects. This is a radix sort, just like in Finish().
+	const Grid &fine = grids[0];
+	lineCounts.assign(CELLS * CELLS + 2, 0);
+	for(const Projectile &projectile : projectiles)
+	{
+		int gx = (static_cast<int>(projectile.Position().X()) >> fine.SHIFT) & WRAP_MASK;
+		int gy = (static_cast<int>(projectile.Position().Y()) >> fine.SHIFT) & WRAP_MASK;
+		++lineCounts[gy * CELLS + gx + 2];
+	}
+	partial_sum(lineCounts.begin(), lineCounts.end(), lineCounts.begin());
+	lineOrder.resize(projectiles.size());
+	for(size_t i = 0; i < projectiles.size(); ++i)
+	{
+		int gx = (static_cast<int>(projectiles[i].Position().X()) >> fine.SHIFT) & WRAP_MASK;
+		int gy = (static_cast<int>(projectiles[i].Position().Y()) >> fine.SHIFT) & WRAP_MASK;
+		lineOrder[lineCounts[gy * CELLS + gx + 1]++] = i;
+	}
+	
+	// Nothing in the collision set changes while it is being searched, and
+	// each batch keeps its own query stamps and writes to its own results, so
+	// the batches can safely run in parallel.
+	static const size_t BATCH_SIZE = 64;
+	size_t batches = (projectiles.size() + BATCH_SIZE - 1) / BATCH_SIZE;
+	if(batchQueries.size() < batches)
+		batchQueries.resize(batches);
+	ThreadPool::Shared().ParallelFor(batches, [this, &projectiles, &hits](size_t batch)
+	{
+		Query &batchQuery = batchQueries[batch];
+		size_t end = min(lineOrder.size(), (batch + 1) * BATCH_SIZE);
+		for(size_t i = batch * BATCH_SIZE; i < end; ++i)
 		{
-			int gx = x & WRAP_MASK;
-			added.emplace_back(&body, x, y);
-			++counts[gy * CELLS + gx + 2];
+			size_t index = lineOrder[i];
+			Hit &hit = hits[index];
+			for(const Grid &grid : grids)
+				if(!grid.added.empty())
+					Line(grid, projectiles[index], hit.range, hit.body, batchQuery);
+		}
+	});
+}
+
+
+
+// Get all objects within the given range of the given point, replacing the
+// contents of the given vector. Each thread keeps its own query state, so
+// any number of these queries may run at once.
+void CollisionSet::Circle(const Point &center, double radius, vector<Body *> &result) const
+{
+	result.clear();
+	Circle(center, radius, result, ThreadQuery());
+}
+
+
+
+// Do a circle check for every one of the given circles at once. The objects
+// within the circle at index i are stored in the given vector, starting at
+// index offsets[i] and ending just before index offsets[i + 1].
+void CollisionSet::Circles(const vector<Point> &centers, const vector<double> &radii,
+	vector<Body *> &found, vector<size_t> &offsets) const
+{
+	found.clear();
+	offsets.assign(centers.size() + 1, 0);
+	if(centers.empty())
+		return;
+	
+	// As in Lines(), give each batch its own query stamps and its own results.
+	
+	static const size_t BATCH_SIZE = 16;
+	size_t batches = (centers.size() + BATCH_SIZE - 1) / BATCH_SIZE;
+	if(batchQueries.size() < batches)
+		batchQueries.resize(batches);
+	if(batchResults.size() < batches)
+		batchResults.resize(batches);
+	ThreadPool::Shared().ParallelFor(batches, [this, &centers, &radii, &offsets](size_t batch)
+	{
+		vector<Body *> &batchResult = batchResults[batch];
+		batchResult.clear();
+		size_t end = min(centers.size(), (batch + 1) * BATCH_SIZE);
+		for(size_t i = batch * BATCH_SIZE; i < end; ++i)
+		{
+			size_t before = batchResult.size();
+			Circle(centers[i], radii[i], batchResult, batchQueries[batch]);
+			offsets[i + 1] = batchResult.size() - before;
+		}
+	});
+	
+	// Put the results together in the same order as the circles.
+	partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+	found.reserve(offsets.back());
+	for(size_t i = 0; i < batches; ++i)
+		found.insert(found.end(), batchResults[i].begin(), batchResults[i].end());
+}
+
+
+
+// Add all the objects within the given range of the given point to the
+// given vector.
+void CollisionSet::Circle(const Point &center, double radius, vector<Body *> &result, Query &query) const
+{
+	// Keep track of which objects we've already considered.
+	query.Start(bodies);
+	for(const Grid &grid : grids)
+	{
+		if(grid.added.empty())
+			continue;
+		
+		// Calculate the range of (x, y) grid coordinates this circle covers.
+		int minX = static_cast<int>(center.X() - radius) >> grid.SHIFT;
+		int minY = static_cast<int>(center.Y() - radius) >> grid.SHIFT;
+		int maxX = static_cast<int>(center.X() + radius) >> grid.SHIFT;
+		int maxY = static_cast<int>(center.Y() + radius) >> grid.SHIFT;
+		
+		for(int y = minY; y <= maxY; ++y)
+		{
+			int gy = y & WRAP_MASK;
+			for(int x = minX; x <= maxX; ++x)
+			{
+				int gx = x & WRAP_MASK;
+				int i = gy * CELLS + gx;
+				vector<Entry>::const_iterator it = grid.sorted.begin() + grid.counts[i];
+				vector<Entry>::const_iterator end = grid.sorted.begin() + grid.counts[i + 1];
+				
+				for( ; it != end; ++it)
+				{
+					// Skip objects that were put in this same grid cell only
+					// because of the cell coordinates wrapping around.
+					if(it->x != x || it->y != y)
+						continue;
+					
+					if(query.Seen(it->id))
+						continue;
+					
+					const Mask &mask = it->body->GetMask(step);
+					Point offset = center - it->body->Position();
+					if(offset.Length() <= radius || mask.WithinRange(offset, it->body->Facing(), radius))
+						result.push_back(it->body);
+				}
+			}
 		}
 	}
 }
 
 
 
-// Finish adding objects (and organize them into the final lookup table).
-void CollisionSet::Finish()
+// Move the entries of the given grid that changed cells since the last
+// step to their new places in the lookup table. If too much has changed
+// for that to be worthwhile, return false instead.
+bool CollisionSet::Patch(Grid &grid)
 {
-	// Perform a partial sum to convert the counts of items in each bin into the
-	// index of the output element where that bin begins.
-	partial_sum(counts.begin(), counts.end(), counts.begin());
+	// Patching only works if the lookup table holds exactly the same entries,
+	// other than their positions.
+	if(grid.previous.size() != grid.added.size() || grid.sorted.size() != grid.added.size())
+		return false;
+	
+	// Most objects only move a few pixels per step, so usually only a few of
+	// them cross into a different cell. Each entry that does is moved by
+	// shifting the entries between its old and new cells, so if more than a
+	// small fraction of them moved, a full rebuild is cheaper.
+	const size_t maxMoved = max<size_t>(8, grid.added.size() / 8);
+	moved.clear();
+	for(size_t i = 0; i < grid.added.size(); ++i)
+	{
+		const Entry &entry = grid.added[i];
+		const Entry &old = grid.previous[i];
+		if(entry.body != old.body || entry.id != old.id)
+			return false;
+		if(entry.x != old.x || entry.y != old.y)
+		{
+			if(moved.size() == maxMoved)
+				return false;
+			moved.push_back(i);
+		}
+	}
+	
+	for(size_t i : moved)
+	{
+		const Entry &entry = grid.added[i];
+		const Entry &old = grid.previous[i];
+		int from = (old.y & WRAP_MASK) * CELLS + (old.x & WRAP_MASK);
+		int to = (entry.y & WRAP_MASK) * CELLS + (entry.x & WRAP_MASK);
+		
+		// Find this entry in its old cell. If one object has several entries
+		// in that cell, it does not matter which of them is updated.
+		vector<Entry>::iterator begin = grid.sorted.begin() + grid.counts[from];
+		vector<Entry>::iterator end = grid.sorted.begin() + grid.counts[from + 1];
+		vector<Entry>::iterator it = find_if(begin, end,
+			[&old](const Entry &e) { return e.id == old.id && e.x == old.x && e.y == old.y; });
+		*it = entry;
+		
+		// Shift it to the end of its new cell, moving the start of every cell
+		// in between by one.
+		if(from < to)
+		{
+			rotate(it, it + 1, grid.sorted.begin() + grid.counts[to + 1]);
+			for(int cell = from + 1; cell <= to; ++cell)
+				--grid.counts[cell];
+		}
+		else if(from > to)
+		{
+			rotate(grid.sorted.begin() + grid.counts[to + 1], it, it + 1);
+			for(int cell = to + 1; cell <= from; ++cell)
+				++grid.counts[cell];
+		}
+	}
+	return true;
+}
+
+
+
+// Build the lookup table for the given grid from scratch.
+void CollisionSet::Rebuild(Grid &grid)
+{
+	// The counts vector starts with two sentinel slots that will be used in
+	// the course of performing the radix sort.
+	grid.counts.assign(CELLS * CELLS + 2, 0);
+	for(const Entry &entry : grid.added)
+		++grid.counts[(entry.y & WRAP_MASK) * CELLS + (entry.x & WRAP_MASK) + 2];
+	
+	// Perform a partial sum to convert the counts of items in each bin into
+	// the index of the output element where that bin begins.
+	partial_sum(grid.counts.begin(), grid.counts.end(), grid.counts.begin());
 	
 	// Allocate space for a sorted copy of the vector.
-	sorted.resize(added.size());
+	grid.sorted.resize(grid.added.size());
 	
 	// Now, perform a radix sort.
-	for(const Entry &entry : added)
+	for(const Entry &entry : grid.added)
 	{
 		int gx = entry.x & WRAP_MASK;
 		int gy = entry.y & WRAP_MASK;
 		int index = gy * CELLS + gx + 1;
 		
-		sorted[counts[index]++] = entry;
+		grid.sorted[grid.counts[index]++] = entry;
 	}
 	
 	// Now, counts[index] is where a certain bin begins.
@@ -114,9 +393,9 @@ void CollisionSet::Finish()
 
 
 
-// Get the first object that collides with the given projectile. If a
-// "closest hit" value is given, update that value.
-Body *CollisionSet::Line(const Projectile &projectile, double *closestHit) const
+// Check a projectile against all the objects in one grid, updating the
+// closest collision found so far.
+void CollisionSet::Line(const Grid &grid, const Projectile &projectile, double &closest, Body *&result, Query &query) const
 {
 	// What objects the projectile hits depends on its government.
 	const Government *pGov = projectile.GetGovernment();
@@ -130,14 +409,10 @@ Body *CollisionSet::Line(const Projectile &projectile, double *closestHit) const
 	int endY = to.Y();
 	
 	// Figure out which grid cell the line starts and ends in.
-	int gx = x >> SHIFT;
-	int gy = y >> SHIFT;
-	int endGX = endX >> SHIFT;
-	int endGY = endY >> SHIFT;
-	
-	// Keep track of the closest collision found so far.
-	double closest = 1.;
-	Body *result = nullptr;
+	int gx = x >> grid.SHIFT;
+	int gy = y >> grid.SHIFT;
+	int endGX = endX >> grid.SHIFT;
+	int endGY = endY >> grid.SHIFT;
 	
 	// Special case, very common: the projectile is contained in one grid cell.
 	// In this case, all the complicated code below can be skipped.
@@ -145,8 +420,8 @@ Body *CollisionSet::Line(const Projectile &projectile, double *closestHit) const
 	{
 		// Examine all objects in the current grid cell.
 		int i = (gy & WRAP_MASK) * CELLS + (gx & WRAP_MASK);
-		vector<Entry>::const_iterator it = sorted.begin() + counts[i];
-		vector<Entry>::const_iterator end = sorted.begin() + counts[i + 1];
+		vector<Entry>::const_iterator it = grid.sorted.begin() + grid.counts[i];
+		vector<Entry>::const_iterator end = grid.sorted.begin() + grid.counts[i + 1];
 		for( ; it != end; ++it)
 		{
 			// Skip objects that were put in this same grid cell only because
@@ -170,9 +445,7 @@ Body *CollisionSet::Line(const Projectile &projectile, double *closestHit) const
 				result = it->body;
 			}
 		}
-		if(closest < 1. && closestHit)
-			*closestHit = closest;
-		return result;
+		return;
 	}
 	
 	// When stepping from one grid cell to the next, we'll go in this direction.
@@ -184,25 +457,29 @@ Body *CollisionSet::Line(const Projectile &projectile, double *closestHit) const
 	// Behave as if each grid cell has this width and height. This guarantees
 	// that we only need to work with integer coordinates.
 	int scale = max(mx, 1) * max(my, 1);
-	int full = CELL_SIZE * scale;
+	int full = grid.CELL_SIZE * scale;
 	
 	// Get the "remainder" distance that we must travel in x and y in order to
 	// reach the next grid cell.
-	int64_t rx = scale * (x & CELL_MASK);
-	int64_t ry = scale * (y & CELL_MASK);
+	int64_t rx = scale * (x & grid.CELL_MASK);
+	int64_t ry = scale * (y & grid.CELL_MASK);
 	if(stepX > 0)
 		rx = full - rx;
 	if(stepY > 0)
 		ry = full - ry;
 	
 	// Keep track of which objects we've already considered.
-	set<const Body *> seen;
+	query.Start(bodies);
+	// A closer hit may already have been found in another grid. That does not
+	// end the search of this one, but whether a hit has been found in this
+	// grid does.
+	bool found = false;
 	while(true)
 	{
 		// Examine all objects in the current grid cell.
 		int i = (gy & WRAP_MASK) * CELLS + (gx & WRAP_MASK);
-		vector<Entry>::const_iterator it = sorted.begin() + counts[i];
-		vector<Entry>::const_iterator end = sorted.begin() + counts[i + 1];
+		vector<Entry>::const_iterator it = grid.sorted.begin() + grid.counts[i];
+		vector<Entry>::const_iterator end = grid.sorted.begin() + grid.counts[i + 1];
 		for( ; it != end; ++it)
 		{
 			// Skip objects that were put in this same grid cell only because
@@ -210,9 +487,8 @@ Body *CollisionSet::Line(const Projectile &projectile, double *closestHit) const
 			if(it->x != gx || it->y != gy)
 				continue;
 			
-			if(seen.count(it->body))
+			if(query.Seen(it->id))
 				continue;
-			seen.insert(it->body);
 			
 			// Check if this projectile can hit this object. If either the
 			// projectile or the object has no government, it will always hit.
@@ -224,6 +500,8 @@ Body *CollisionSet::Line(const Projectile &projectile, double *closestHit) const
 			Point offset = projectile.Position() - it->body->Position();
 			double range = mask.Collide(offset, projectile.Velocity(), it->body->Facing());
 			
+			if(range < 1.)
+				found = true;
 			if(range < closest)
 			{
 				closest = range;
@@ -232,7 +510,7 @@ Body *CollisionSet::Line(const Projectile &projectile, double *closestHit) const
 		}
 		
 		// Check if we've found a collision or reached the final grid cell.
-		if(result || (gx == endGX && gy == endGY))
+		if(found || (gx == endGX && gy == endGY))
 			break;
 		// If not, move to the next one. Check whether rx / mx < ry / my.
 		int64_t diff = rx * my - ry * mx;
@@ -267,53 +545,48 @@ Body *CollisionSet::Line(const Projectile &projectile, double *closestHit) const
 			gy += stepY;
 		}
 	}
-	
-	if(closest < 1. && closestHit)
-		*closestHit = closest;
-	return result;
 }
 
 
 
-// Get all objects within the given range of the given point.
-const vector<Body *> &CollisionSet::Circle(const Point &center, double radius) const
+// Start a new query of a set with the given number of objects. If the query
+// counter wraps around, the old stamps could be mistaken for new ones, so they
+// must all be cleared.
+// Get the query state for single queries made from the calling thread.
+CollisionSet::Query &CollisionSet::ThreadQuery()
 {
-	// Calculate the range of (x, y) grid coordinates this circle covers.
-	int minX = static_cast<int>(center.X() - radius) >> SHIFT;
-	int minY = static_cast<int>(center.Y() - radius) >> SHIFT;
-	int maxX = static_cast<int>(center.X() + radius) >> SHIFT;
-	int maxY = static_cast<int>(center.Y() + radius) >> SHIFT;
-	
-	// Keep track of which objects we've already considered.
-	set<const Body *> seen;
-	result.clear();
-	for(int y = minY; y <= maxY; ++y)
+	// This is shared by every collision set. That is safe because each query
+	// starts by making sure there is a stamp for every object in its set.
+	thread_local Query query;
+	return query;
+}
+
+
+
+void CollisionSet::Query::Start(int bodies)
+{
+	// The stamps vector only ever grows, so after the first few steps this will
+	// not need to allocate anything.
+	if(lastQuery.size() < static_cast<size_t>(bodies))
 	{
-		int gy = y & WRAP_MASK;
-		for(int x = minX; x <= maxX; ++x)
-		{
-			int gx = x & WRAP_MASK;
-			int i = gy * CELLS + gx;
-			vector<Entry>::const_iterator it = sorted.begin() + counts[i];
-			vector<Entry>::const_iterator end = sorted.begin() + counts[i + 1];
-			
-			for( ; it != end; ++it)
-			{
-				// Skip objects that were put in this same grid cell only because
-				// of the cell coordinates wrapping around.
-				if(it->x != x || it->y != y)
-					continue;
-				
-				if(seen.count(it->body))
-					continue;
-				seen.insert(it->body);
-				
-				const Mask &mask = it->body->GetMask(step);
-				Point offset = center - it->body->Position();
-				if(offset.Length() <= radius || mask.WithinRange(offset, it->body->Facing(), radius))
-					result.push_back(it->body);
-			}
-		}
+		lastQuery.assign(bodies, 0);
+		count = 0;
 	}
-	return result;
+	if(!++count)
+	{
+		fill(lastQuery.begin(), lastQuery.end(), 0);
+		count = 1;
+	}
+}
+
+
+
+// Check whether the object with the given ID has already been seen in this
+// query, and mark it as seen if it has not.
+bool CollisionSet::Query::Seen(int id)
+{
+	if(lastQuery[id] == count)
+		return true;
+	lastQuery[id] = count;
+	return false;
 }
@@ -23,11 +23,15 @@ class Projectile;
 
 // A CollisionSet allows efficient collision detection by splitting space up
 // into a grid and keeping track of which objects are in each grid cell. A check
-// for collisions can then only examine objects in certain cells.
+// for collisions can then only examine objects in certain cells. There are
+// actually several grids, each with cells twice the size of the one before,
+// and each object goes in the finest grid it does not span more than two cells
+// of, so that very large objects do not fill a huge number of cells.
 class CollisionSet {
 public:
 	// Initialize a collision set. The cell size and cell count should both be
-	// powers of two; otherwise, they are rounded down to a power of two.
+	// powers of two; otherwise, they are rounded down to a power of two. The
+	// cell size given is that of the finest grid.
 	CollisionSet(int cellSize, int cellCount);
 	
 	// Clear all objects in the set. Specify which engine step we are on, so we
@@ -36,48 +40,127 @@ public:
 	// Add an object to the set.
 	void Add(Body &body);
 	// Finish adding objects (and organize them into the final lookup table).
+	// If the same objects were added in the same order as in the last step,
+	// and only a few of them moved to different grid cells, the lookup table
+	// from the last step is patched instead of being built from scratch.
 	void Finish();
 	
 	// Get the first object that collides with the given projectile. If a
-	// "closest hit" value is given, update that value.
+	// "closest hit" value is given, update that value. Like Circle(), this may
+	// be called from several threads at once.
 	Body *Line(const Projectile &projectile, double *closestHit = nullptr) const;
 	
-	// Get all objects within the given range of the given point.
-	const std::vector<Body *> &Circle(const Point &center, double radius) const;
+	// The result of a line check: the object that was hit, if any, and how
+	// far along the projectile's motion for this step the collision happens.
+	class Hit {
+	public:
+		Body *body = nullptr;
+		double range = 1.;
+	};
+	// Do a line check for every one of the given projectiles at once, and store
+	// the result for each projectile at the same index in the given vector.
+	// Projectiles near each other are checked together, in parallel.
+	void Lines(const std::vector<Projectile> &projectiles, std::vector<Hit> &hits) const;
+	
+	// Get all objects within the given range of the given point, replacing the
+	// contents of the given vector. Each thread keeps its own query state, so
+	// any number of these queries may run at once.
+	void Circle(const Point &center, double radius, std::vector<Body *> &result) const;
+	// Do a circle check for every one of the given circles at once. The objects
+	// within the circle at index i are stored in the given vector, starting at
+	// index offsets[i] and ending just before index offsets[i + 1].
+	void Circles(const std::vector<Point> &centers, const std::vector<double> &radii,
+		std::vector<Body *> &found, std::vector<std::size_t> &offsets) const;
 	
 	
 private:
 	class Entry {
 	public:
 		Entry() = default;
-		Entry(Body *body, int x, int y) : body(body), x(x), y(y) {}
+		Entry(Body *body, int id, int x, int y) : body(body), id(id), x(x), y(y) {}
 		
 		Body *body;
+		// Each object is numbered in the order it was added, so queries can
+		// keep track of which ones they have already examined.
+		int id;
 		int x;
 		int y;
 	};
 	
+	// Queries keep track of which objects they have already examined by
+	// stamping them with a query number. Queries are numbered in sequence, so
+	// no clearing is needed between one query and the next.
+	class Query {
+	public:
+		// Start a new query of a set with the given number of objects.
+		void Start(int bodies);
+		// Check whether the object with the given ID has already been seen in
+		// this query, and mark it as seen if it has not.
+		bool Seen(int id);
+		
+	private:
+		std::vector<unsigned> lastQuery;
+		unsigned count = 0;
+	};
+	
+	// One level of the grid.
+	class Grid {
+	public:
+		// The size of individual cells of the grid.
+		int CELL_SIZE;
+		int SHIFT;
+		int CELL_MASK;
+		
+		// Vectors to store the objects in this grid. The objects that were
+		// added in the previous step are kept so Finish() can tell which ones
+		// have moved to a different cell.
+		std::vector<Entry> added;
+		std::vector<Entry> previous;
+		std::vector<Entry> sorted;
+		std::vector<int> counts;
+	};
+	
+	
+private:
+	// Move the entries of the given grid that changed cells since the last
+	// step to their new places in the lookup table. If too much has changed
+	// for that to be worthwhile, return false instead.
+	bool Patch(Grid &grid);
+	// Build the lookup table for the given grid from scratch.
+	void Rebuild(Grid &grid);
+	// Check a projectile against all the objects in one grid, updating the
+	// closest collision found so far.
+	void Line(const Grid &grid, const Projectile &projectile, double &closest, Body *&result, Query &query) const;
+	// Add all the objects within the given range of the given point to the
+	// given vector.
+	void Circle(const Point &center, double radius, std::vector<Body *> &result, Query &query) const;
+	// Get the query state for single queries made from the calling thread.
+	static Query &ThreadQuery();
+	
 	
 private:
-	// The size of individual cells of the grid.
-	int CELL_SIZE;
-	int SHIFT;
-	int CELL_MASK;
+	static const int LEVELS = 4;
 	
-	// The number of grid cells.
+	// The number of grid cells, which is the same in each level.
 	int CELLS;
 	int WRAP_MASK;
 	
 	// The current game engine step.
 	int step;
 	
-	// Vectors to store the objects in the collision set.
-	std::vector<Entry> added;
-	std::vector<Entry> sorted;
-	std::vector<int> counts;
+	Grid grids[LEVELS];
+	// The number of objects that have been added.
+	int bodies;
 	
-	// Vector for returning the result of a circle query.
-	mutable std::vector<Body *> result;
+	// The entries that Patch() needs to move.
+	std::vector<std::size_t> moved;
+	// The state for each batch of a call to Lines() or Circles().
+	mutable std::vector<Query> batchQueries;
+	// The objects found by each batch of a call to Circles().
+	mutable std::vector<std::vector<Body *>> batchResults;
+	// The order to check projectiles in for Lines(), grouped by grid cell.
+	mutable std::vector<int> lineCounts;
+	mutable std::vector<std::size_t> lineOrder;
 };
 
 
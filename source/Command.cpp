@@ -254,6 +254,21 @@ Command Command::AndNot(Command command) const
 
 
 
+// Convert the bits to or from a single number.
+uint64_t Command::Bits() const
+{
+	return state;
+}
+
+
+
+Command Command::FromBits(uint64_t bits)
+{
+	return Command(bits);
+}
+
+
+
 // Set the turn direction and amount to a value between -1 and 1.
 void Command::SetTurn(double amount)
 {
@@ -318,6 +333,15 @@ bool Command::operator<(const Command &command) const
 
 
 
+// Get the commands that are set in both of these commands. This ignores
+// the turn field.
+Command Command::operator&(const Command &command) const
+{
+	return Command(state & command.state);
+}
+
+
+
 // Get the commands that are set in either of these commands.
 Command Command::operator|(const Command &command) const
 {
@@ -95,6 +95,10 @@ public:
 	bool Has(Command command) const;
 	// Get the commands that are set in this and not in the given command.
 	Command AndNot(Command command) const;
+	// Convert the bits to or from a single number, e.g. to record them in a
+	// file. This ignores the turn field.
+	uint64_t Bits() const;
+	static Command FromBits(uint64_t bits);
 	
 	// Get or set the turn amount. The amount must be between -1 and 1, but it
 	// can be a fractional value to allow finer control.
@@ -112,6 +116,9 @@ public:
 	// This operator is just provided to allow commands to be used in a map.
 	bool operator<(const Command &command) const;
 	
+	// Get the commands that are set in both of these commands. This ignores
+	// the turn field.
+	Command operator&(const Command &command) const;
 	// Get the commands that are set in either of these commands.
 	Command operator|(const Command &command) const;
 	Command &operator|=(const Command &command);
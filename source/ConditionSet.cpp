@@ -12,40 +12,105 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 #include "ConditionSet.h"
 
+#include "ConditionsStore.h"
 #include "DataNode.h"
 #include "DataWriter.h"
 #include "Random.h"
 
+#include <algorithm>
 #include <cmath>
+#include <map>
 
 using namespace std;
 
 namespace {
-	typedef int (*BinFun)(int, int);
-	BinFun Op(const string &op)
+	// Special values for a token that is not a condition name.
+	const int NONE = -1;
+	const int RANDOM = -2;
+	
+	// The operators. In each one, "a" is the condition's current value and "b"
+	// is the value given as the other argument of the operator. Test
+	// operators return 0 (false) or 1 (true). "Apply" operators return the
+	// value that the condition should have after applying the expression.
+	enum Code {EQ, NE, LT, GT, LE, GE, ASSIGN, ADD, SUBTRACT, MIN, MAX};
+	
+	// Get the code for the given operator, or -1 if it is not one.
+	int Op(const string &op)
 	{
-		// This map defines functions that each "operator" should be mapped to.
-		// In each function "a" is the condition's current value and "b" is the
-		// integer value given as the other argument of the operator.
-		// Test operators return 0 (false) or 1 (true).
-		// "Apply" operators return the value that the condition should have
-		// after applying the expression.
-		static const map<string, BinFun> opMap = {
-			{"==", [](int a, int b) -> int { return a == b; }},
-			{"!=", [](int a, int b) -> int { return a != b; }},
-			{"<", [](int a, int b) -> int { return a < b; }},
-			{">", [](int a, int b) -> int { return a > b; }},
-			{"<=", [](int a, int b) -> int { return a <= b; }},
-			{">=", [](int a, int b) -> int { return a >= b; }},
-			{"=", [](int a, int b) { return b; }},
-			{"+=", [](int a, int b) { return a + b; }},
-			{"-=", [](int a, int b) { return a - b; }},
-			{"<?=", [](int a, int b) { return min(a, b); }},
-			{">?=", [](int a, int b) { return max(a, b); }}
+		static const map<string, int> opMap = {
+			{"==", EQ},
+			{"!=", NE},
+			{"<", LT},
+			{">", GT},
+			{"<=", LE},
+			{">=", GE},
+			{"=", ASSIGN},
+			{"+=", ADD},
+			{"-=", SUBTRACT},
+			{"<?=", MIN},
+			{">?=", MAX}
 		};
 		
 		auto it = opMap.find(op);
-		return (it != opMap.end() ? it->second : nullptr);
+		return (it != opMap.end() ? it->second : -1);
+	}
+	
+	// Apply the operator with the given code.
+	inline int Evaluate(int code, int a, int b)
+	{
+		switch(code)
+		{
+			case EQ:
+				return a == b;
+			case NE:
+				return a != b;
+			case LT:
+				return a < b;
+			case GT:
+				return a > b;
+			case LE:
+				return a <= b;
+			case GE:
+				return a >= b;
+			case ASSIGN:
+				return b;
+			case ADD:
+				return a + b;
+			case SUBTRACT:
+				return a - b;
+			case MIN:
+				return min(a, b);
+			case MAX:
+				return max(a, b);
+			default:
+				return 0;
+		}
+	}
+	
+	// Figure out what the given string token refers to. The special token
+	// "random" means to generate a random number each time it is queried.
+	int Token(const string &token)
+	{
+		if(token == "random")
+			return RANDOM;
+		return token.empty() ? NONE : ConditionsStore::ID(token);
+	}
+	
+	// Get the value of what the given token refers to. If it is not a
+	// condition, or that condition is not set, the value is the given number.
+	inline int TokenValue(int numValue, int token, const ConditionsStore &conditions)
+	{
+		// Special case: if the string of the token is "random," that means to
+		// generate a random number from 0 to 99 each time it is queried.
+		if(token == RANDOM)
+			return Random::Int(100);
+		if(token != NONE)
+		{
+			const int *it = conditions.Find(token);
+			if(it)
+				return *it;
+		}
+		return numValue;
 	}
 }
 
@@ -116,12 +181,15 @@ void ConditionSet::Add(const DataNode &node)
 		}
 	}
 	else if(node.Size() == 1 && node.Token(0) == "never")
-		expressions.emplace_back("", "!=", 0);
+		AddExpression("", "!=", 0);
 	else if(node.Size() == 1 && (node.Token(0) == "and" || node.Token(0) == "or"))
 	{
 		// The "and" and "or" keywords introduce a nested condition set.
 		children.emplace_back();
 		children.back().Load(node);
+		for(int id : children.back().dependencies)
+			AddDependency(id);
+		isRandom |= children.back().isRandom;
 	}
 	else
 		node.PrintTrace("Unrecognized condition expression:");
@@ -134,17 +202,17 @@ bool ConditionSet::Add(const string &firstToken, const string &secondToken)
 {
 	// Each "unary" operator can be mapped to an equivalent binary expression.
 	if(firstToken == "not")
-		expressions.emplace_back(secondToken, "==", 0);
+		AddExpression(secondToken, "==", 0);
 	else if(firstToken == "has")
-		expressions.emplace_back(secondToken, "!=", 0);
+		AddExpression(secondToken, "!=", 0);
 	else if(firstToken == "set")
-		expressions.emplace_back(secondToken, "=", 1);
+		AddExpression(secondToken, "=", 1);
 	else if(firstToken == "clear")
-		expressions.emplace_back(secondToken, "=", 0);
+		AddExpression(secondToken, "=", 0);
 	else if(secondToken == "++")
-		expressions.emplace_back(firstToken, "+=", 1);
+		AddExpression(firstToken, "+=", 1);
 	else if(secondToken == "--")
-		expressions.emplace_back(firstToken, "-=", 1);
+		AddExpression(firstToken, "-=", 1);
 	else
 		return false;
 	
@@ -156,12 +224,11 @@ bool ConditionSet::Add(const string &firstToken, const string &secondToken)
 // Add a binary operator line to the list of expressions.
 bool ConditionSet::Add(const string &name, const string &op, int value)
 {
-	// If the operator is recognized, map it to a binary function.
-	BinFun fun = Op(op);
-	if(!fun || isnan(value))
+	// The operator must be one that is recognized.
+	if(Op(op) < 0 || isnan(value))
 		return false;
 	
-	expressions.emplace_back(name, op, value);
+	AddExpression(name, op, value);
 	return true;
 }
 
@@ -170,53 +237,45 @@ bool ConditionSet::Add(const string &name, const string &op, int value)
 // Add a binary operator line to the list of expressions with a string as value
 bool ConditionSet::Add(const string &name, const string &op, const string &strValue)
 {
-	// If the operator is recognized, map it to a binary function.
-	BinFun fun = Op(op);
-	if(!fun)
+	// The operator must be one that is recognized.
+	if(Op(op) < 0)
 		return false;
 	
-	expressions.emplace_back(name, op, 0);
-	expressions.back().strValue = strValue;
+	AddExpression(name, op, 0, strValue);
 	return true;
 }
 
 
 
 // Check if the given condition values satisfy this set of conditions.
-bool ConditionSet::Test(const map<string, int> &conditions) const
+bool ConditionSet::Test(const ConditionsStore &conditions) const
 {
-	for(const Expression &expression : expressions)
+	// If none of the conditions this set looks at have changed since the last
+	// time it was tested with this store, the result is the same as before.
+	if(isRandom)
+		return Check(conditions);
+	if(testedStore == &conditions && !conditions.HasChanged(dependencies, testedRevision))
 	{
-		int firstValue = TokenValue(0, expression.name, conditions);
-		int secondValue = TokenValue(expression.value, expression.strValue, conditions);
-		bool result = expression.fun(firstValue, secondValue);
-		// If this is a set of "and" conditions, bail out as soon as one of them
-		// returns false. If it is an "or", bail out if anything returns true.
-		if(result == isOr)
-			return result;
+		testedRevision = conditions.Revision();
+		return testedResult;
 	}
-	for(const ConditionSet &child : children)
-	{
-		bool result = child.Test(conditions);
-		if(result == isOr)
-			return result;
-	}
-	// If this is an "and" condition, we got here because all the above conditions
-	// returned true, so we should return true. If it is an "or," we got here because
-	// no condition returned true, so we should return false.
-	return !isOr;
+	
+	testedResult = Check(conditions);
+	testedStore = &conditions;
+	testedRevision = conditions.Revision();
+	return testedResult;
 }
 
 
 
 // Modify the given set of conditions.
-void ConditionSet::Apply(map<string, int> &conditions) const
+void ConditionSet::Apply(ConditionsStore &conditions) const
 {
-	for(const Expression &expression : expressions)
+	for(const Operation &operation : operations)
 	{
-		int &c = conditions[expression.name];
-		int value = TokenValue(expression.value, expression.strValue, conditions);
-		c = expression.fun(c, value);
+		int &c = conditions.Value(operation.id);
+		int value = TokenValue(operation.value, operation.valueToken, conditions);
+		c = Evaluate(operation.code, c, value);
 	}
 	// Note: "and" and "or" make no sense for "Apply()," so a condition set that
 	// is meant to be applied rather than tested should never include them. But
@@ -227,27 +286,68 @@ void ConditionSet::Apply(map<string, int> &conditions) const
 
 
 
-// Check if the passed token is numeric or a string which has to be replaced, and return its value
-double ConditionSet::TokenValue(int numValue, const string &strValue, const map<string, int> &conditions) const
+// Add an expression, and compile it into an operation.
+void ConditionSet::AddExpression(const string &name, const string &op, int value, const string &strValue)
 {
-	int value = numValue;
-	// Special case: if the string of the token is "random," that means to
-	// generate a random number from 0 to 99 each time it is queried.
-	if(strValue == "random")
-		value = Random::Int(100);
-	else
+	expressions.emplace_back(name, op, value, strValue);
+	
+	Operation operation;
+	operation.code = Op(op);
+	operation.id = ConditionsStore::ID(name);
+	operation.value = value;
+	operation.nameToken = Token(name);
+	operation.valueToken = Token(strValue);
+	operations.push_back(operation);
+	
+	for(int token : {operation.nameToken, operation.valueToken})
 	{
-		auto it = conditions.find(strValue);
-		if(it != conditions.end())
-			value = it->second;
+		if(token == RANDOM)
+			isRandom = true;
+		else if(token != NONE)
+			AddDependency(token);
 	}
-	return value;
+}
+
+
+
+// Record that this set depends on the condition with the given ID.
+void ConditionSet::AddDependency(int id)
+{
+	if(find(dependencies.begin(), dependencies.end(), id) == dependencies.end())
+		dependencies.push_back(id);
+}
+
+
+
+// Evaluate the test expressions, without checking for a remembered result.
+bool ConditionSet::Check(const ConditionsStore &conditions) const
+{
+	for(const Operation &operation : operations)
+	{
+		int firstValue = TokenValue(0, operation.nameToken, conditions);
+		int secondValue = TokenValue(operation.value, operation.valueToken, conditions);
+		bool result = Evaluate(operation.code, firstValue, secondValue);
+		// If this is a set of "and" conditions, bail out as soon as one of them
+		// returns false. If it is an "or", bail out if anything returns true.
+		if(result == isOr)
+			return result;
+	}
+	for(const ConditionSet &child : children)
+	{
+		bool result = child.Check(conditions);
+		if(result == isOr)
+			return result;
+	}
+	// If this is an "and" condition, we got here because all the above conditions
+	// returned true, so we should return true. If it is an "or," we got here because
+	// no condition returned true, so we should return false.
+	return !isOr;
 }
 
 
 
 // Constructor for an expression.
-ConditionSet::Expression::Expression(const string &name, const string &op, int value)
-	: name(name), op(op), fun(Op(op)), value(value)
+ConditionSet::Expression::Expression(const string &name, const string &op, int value, const string &strValue)
+	: name(name), op(op), value(value), strValue(strValue)
 {
 }
@@ -13,10 +13,11 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #ifndef CONDITION_SET_H_
 #define CONDITION_SET_H_
 
-#include <map>
+#include <cstdint>
 #include <string>
 #include <vector>
 
+class ConditionsStore;
 class DataNode;
 class DataWriter;
 
@@ -42,36 +43,56 @@ public:
 	bool Add(const std::string &name, const std::string &op, int value);
 	bool Add(const std::string &name, const std::string &op, const std::string &strValue);
 	
-	// Check if the given condition values satisfy this set of conditions.
-	bool Test(const std::map<std::string, int> &conditions) const;
+	// Check if the given condition values satisfy this set of conditions. The
+	// result is remembered, and until one of the conditions this set depends on
+	// changes, testing it again with the same store just returns that result.
+	// So, the same set must not be tested in more than one thread at once.
+	bool Test(const ConditionsStore &conditions) const;
 	// Modify the given set of conditions.
-	void Apply(std::map<std::string, int> &conditions) const;
+	void Apply(ConditionsStore &conditions) const;
 	
 	
 private:
-	// Check if the passed token is numeric or a string which has to be replaced, and return its value
-	double TokenValue(int numValue, const std::string &strValue, const std::map<std::string, int> &conditions) const;
+	// Add an expression, and compile it into an operation.
+	void AddExpression(const std::string &name, const std::string &op, int value, const std::string &strValue = "");
+	// Record that this set depends on the condition with the given ID.
+	void AddDependency(int id);
+	// Evaluate the test expressions, without checking for a remembered result.
+	bool Check(const ConditionsStore &conditions) const;
 	
 	
 private:
 	// This class represents a single expression involving a condition - either
-	// testing what value it has, or modifying it in some way.
+	// testing what value it has, or modifying it in some way. This is the text
+	// of the expression, which is only needed for saving it.
 	class Expression {
 	public:
-		Expression(const std::string &name, const std::string &op, int value);
+		Expression(const std::string &name, const std::string &op, int value, const std::string &strValue);
 		
 		// This is the name of the condition that this entry operates on.
 		std::string name;
-		// This needs to be saved for saving conditions.
 		std::string op;
-		// Pointer to a binary function that defines what operation should be
-		// performed on the condition and the constant value.
-		int (*fun)(int, int);
 		// Constant value specified in the expression.
 		int value;
 		// Allow for dynamic values.
 		std::string strValue;
 	};
+	// The same expression, compiled into what Test() and Apply() use: an
+	// operator code and the IDs of the conditions involved, so evaluating it is
+	// just a couple of lookups and a switch, with no strings involved.
+	class Operation {
+	public:
+		// The operator, as one of the codes defined in ConditionSet.cpp.
+		int code;
+		// This is the ID of the condition in the ConditionsStore.
+		int id;
+		// The constant value, if the value is not a condition.
+		int value;
+		// These are what to look up for the condition and for the value: a
+		// ConditionsStore ID, or NONE or RANDOM.
+		int nameToken;
+		int valueToken;
+	};
 	
 	
 private:
@@ -79,10 +100,23 @@ private:
 	// either an "and" grouping (meaning every condition must be true to satisfy
 	// it) or an "or" grouping where only one condition needs to be true.
 	bool isOr = false;
-	// Conditions that this set tests or applies.
+	// Conditions that this set tests or applies. There is one operation for
+	// each expression.
 	std::vector<Expression> expressions;
+	std::vector<Operation> operations;
 	// Nested sets of conditions to be tested.
 	std::vector<ConditionSet> children;
+	
+	// The IDs of all the conditions that this set and its children look at, and
+	// whether any of them use "random," in which case Test() must evaluate the
+	// set every time.
+	std::vector<int> dependencies;
+	bool isRandom = false;
+	// The store that this set was last tested with, its revision at the time,
+	// and the result.
+	mutable const ConditionsStore *testedStore = nullptr;
+	mutable uint64_t testedRevision = 0;
+	mutable bool testedResult = false;
 };
 
 
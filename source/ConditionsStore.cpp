@@ -0,0 +1,340 @@
+/* ConditionsStore.cpp
+Copyright (c) 2017 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "ConditionsStore.h"
+
+#include <atomic>
+#include <mutex>
+
+using namespace std;
+
+namespace {
+	// Condition names may be registered by missions being loaded or created
+	// at the same time that another thread is looking up an ID.
+	mutex idMutex;
+	map<string, int> ids;
+	vector<const string *> names;
+	
+	// Get the ID for the given name, if it has one. Otherwise, return -1. The
+	// caller must hold the lock.
+	int FindID(const string &name)
+	{
+		auto it = ids.find(name);
+		return (it == ids.end()) ? -1 : it->second;
+	}
+	
+	// Get the name that has the given ID.
+	const string &Name(int id)
+	{
+		lock_guard<mutex> lock(idMutex);
+		return *names[id];
+	}
+	
+	// Revision numbers are shared by all stores, so that a ConditionSet that
+	// remembers which store and revision it was tested with is never fooled by
+	// a different store that happens to be at the same address.
+	atomic<uint64_t> nextRevision(1);
+}
+
+
+
+int ConditionsStore::unresolved = 0;
+
+
+
+// Copy constructor.
+ConditionsStore::ConditionsStore(const ConditionsStore &other)
+	: values(other.values)
+{
+}
+
+
+
+// Assignment operator.
+ConditionsStore &ConditionsStore::operator=(const ConditionsStore &other)
+{
+	values = other.values;
+	pointers.clear();
+	TouchAll();
+	return *this;
+}
+
+
+
+// Get the ID for the given condition name.
+int ConditionsStore::ID(const string &name)
+{
+	lock_guard<mutex> lock(idMutex);
+	auto result = ids.emplace(name, static_cast<int>(ids.size()));
+	if(result.second)
+		names.push_back(&result.first->first);
+	return result.first->second;
+}
+
+
+
+// Look up the condition with the given ID for the first time.
+const int *ConditionsStore::Resolve(int id) const
+{
+	if(static_cast<size_t>(id) >= pointers.size())
+		pointers.resize(id + 1, &unresolved);
+	if(pointers[id] == &unresolved)
+	{
+		auto it = values.find(Name(id));
+		pointers[id] = (it == values.end()) ? nullptr : const_cast<int *>(&it->second);
+	}
+	return pointers[id];
+}
+
+
+
+// Get the value of the condition with the given ID, creating it if needed.
+int &ConditionsStore::Value(int id)
+{
+	const int *value = Find(id);
+	if(!value)
+		return (*this)[Name(id)];
+	
+	Touch(id);
+	return *const_cast<int *>(value);
+}
+
+
+
+// Look up every ID that has been given out so far. Until this store is modified,
+// Find() then only reads from it, so it can be used from any number of threads
+// at once.
+void ConditionsStore::ResolveAll() const
+{
+	size_t count = 0;
+	{
+		lock_guard<mutex> lock(idMutex);
+		count = names.size();
+	}
+	if(pointers.size() < count)
+		pointers.resize(count, &unresolved);
+	for(size_t id = 0; id < count; ++id)
+		if(pointers[id] == &unresolved)
+			Resolve(id);
+}
+
+
+
+// Set the given condition to the given value. Unlike writing to what
+// operator[] returns, this does not count as a change if the condition
+// already has that value.
+void ConditionsStore::Set(const string &name, int value)
+{
+	auto it = values.find(name);
+	if(it == values.end())
+		(*this)[name] = value;
+	else if(it->second != value)
+	{
+		it->second = value;
+		Touch(name);
+	}
+}
+
+
+
+// Get the current revision of this store.
+uint64_t ConditionsStore::Revision() const
+{
+	return revision;
+}
+
+
+
+// Check if any of the conditions with the given IDs might have changed since
+// this store was at the given revision.
+bool ConditionsStore::HasChanged(const vector<int> &ids, uint64_t since) const
+{
+	if(since == revision)
+		return false;
+	if(since < everything)
+		return true;
+	
+	for(int id : ids)
+		if(static_cast<size_t>(id) < changed.size() && changed[id] > since)
+			return true;
+	return false;
+}
+
+
+
+int &ConditionsStore::operator[](const string &name)
+{
+	auto result = values.emplace(name, 0);
+	if(result.second)
+		Update(name, &result.first->second);
+	Touch(name);
+	return result.first->second;
+}
+
+
+
+ConditionsStore::iterator ConditionsStore::find(const string &name)
+{
+	Touch(name);
+	return values.find(name);
+}
+
+
+
+ConditionsStore::const_iterator ConditionsStore::find(const string &name) const
+{
+	return values.find(name);
+}
+
+
+
+ConditionsStore::iterator ConditionsStore::lower_bound(const string &name)
+{
+	TouchAll();
+	return values.lower_bound(name);
+}
+
+
+
+ConditionsStore::const_iterator ConditionsStore::lower_bound(const string &name) const
+{
+	return values.lower_bound(name);
+}
+
+
+
+void ConditionsStore::erase(const string &name)
+{
+	if(values.erase(name))
+	{
+		Update(name, nullptr);
+		Touch(name);
+	}
+}
+
+
+
+void ConditionsStore::erase(iterator first, iterator last)
+{
+	for(auto it = first; it != last; ++it)
+	{
+		Update(it->first, nullptr);
+		Touch(it->first);
+	}
+	values.erase(first, last);
+}
+
+
+
+void ConditionsStore::clear()
+{
+	values.clear();
+	pointers.clear();
+	TouchAll();
+}
+
+
+
+bool ConditionsStore::empty() const
+{
+	return values.empty();
+}
+
+
+
+ConditionsStore::iterator ConditionsStore::begin()
+{
+	TouchAll();
+	return values.begin();
+}
+
+
+
+ConditionsStore::const_iterator ConditionsStore::begin() const
+{
+	return values.begin();
+}
+
+
+
+ConditionsStore::iterator ConditionsStore::end()
+{
+	return values.end();
+}
+
+
+
+ConditionsStore::const_iterator ConditionsStore::end() const
+{
+	return values.end();
+}
+
+
+
+// Record the new location of the condition with the given name, or that it
+// no longer exists (if the pointer is null).
+void ConditionsStore::Update(const string &name, int *value)
+{
+	int id = -1;
+	{
+		lock_guard<mutex> lock(idMutex);
+		id = FindID(name);
+	}
+	// If this ID has not been looked up yet, it will be found when it is.
+	if(id < 0 || static_cast<size_t>(id) >= pointers.size())
+		return;
+	
+	pointers[id] = value;
+}
+
+
+
+// Record that the given condition may have changed.
+void ConditionsStore::Touch(const string &name)
+{
+	int id = -1;
+	{
+		lock_guard<mutex> lock(idMutex);
+		id = FindID(name);
+	}
+	// If this name has no ID, no condition set can depend on it.
+	if(id >= 0)
+		Touch(id);
+}
+
+
+
+void ConditionsStore::Touch(int id)
+{
+	if(static_cast<size_t>(id) >= changed.size())
+		changed.resize(id + 1, everything);
+	revision = NextRevision();
+	changed[id] = revision;
+}
+
+
+
+// Record that every condition may have changed.
+void ConditionsStore::TouchAll()
+{
+	revision = NextRevision();
+	everything = revision;
+	changed.clear();
+}
+
+
+
+// Get a new revision number.
+uint64_t ConditionsStore::NextRevision()
+{
+	return nextRevision++;
+}
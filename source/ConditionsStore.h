@@ -0,0 +1,134 @@
+/* ConditionsStore.h
+Copyright (c) 2017 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef CONDITIONS_STORE_H_
+#define CONDITIONS_STORE_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+
+
+// Class holding the player's named "conditions." It can be used like a map
+// from names to values, and iterating over it lists the conditions in order of
+// their names. But, conditions can also be looked up by an integer ID, which
+// ConditionSet expressions get for the condition names they use when they are
+// loaded. Looking up a condition by ID is usually just a pointer load, rather
+// than a series of string comparisons. The store also keeps track of when each
+// condition last changed, so that a ConditionSet can tell whether any of the
+// conditions it depends on are different than the last time it was tested.
+class ConditionsStore {
+public:
+	typedef std::map<std::string, int>::iterator iterator;
+	typedef std::map<std::string, int>::const_iterator const_iterator;
+	
+	
+public:
+	ConditionsStore() = default;
+	// Copying a store does not copy the IDs it has looked up, since those point
+	// to the other store's values. As far as anyone checking for changes can
+	// tell, every condition in the copy has just changed.
+	ConditionsStore(const ConditionsStore &other);
+	ConditionsStore &operator=(const ConditionsStore &other);
+	
+	// Get the ID for the given condition name. The same name always has the
+	// same ID, in every store.
+	static int ID(const std::string &name);
+	
+	// Get a pointer to the value of the condition with the given ID, or null if
+	// that condition has not been set.
+	const int *Find(int id) const;
+	// Get the value of the condition with the given ID, creating it if needed.
+	int &Value(int id);
+	// Look up every ID that has been given out so far. Until this store is
+	// modified, Find() then only reads from it, so it can be used from any
+	// number of threads at once.
+	void ResolveAll() const;
+	
+	// Set the given condition to the given value. Unlike writing to what
+	// operator[] returns, this does not count as a change if the condition
+	// already has that value.
+	void Set(const std::string &name, int value);
+	
+	// Every time something in the store might have changed, it gets a new
+	// revision number. Revision numbers are never reused, even by other stores.
+	uint64_t Revision() const;
+	// Check if any of the conditions with the given IDs might have changed since
+	// this store was at the given revision. Anything that gives out a reference
+	// that can be written to counts as a change to the conditions involved, so
+	// such a reference should only be used right away, not kept for later.
+	bool HasChanged(const std::vector<int> &ids, uint64_t since) const;
+	
+	// These functions work the same way as they would for a std::map.
+	int &operator[](const std::string &name);
+	iterator find(const std::string &name);
+	const_iterator find(const std::string &name) const;
+	iterator lower_bound(const std::string &name);
+	const_iterator lower_bound(const std::string &name) const;
+	void erase(const std::string &name);
+	void erase(iterator first, iterator last);
+	void clear();
+	bool empty() const;
+	
+	iterator begin();
+	const_iterator begin() const;
+	iterator end();
+	const_iterator end() const;
+	
+	
+private:
+	// Look up the condition with the given ID for the first time.
+	const int *Resolve(int id) const;
+	// Record the new location of the condition with the given name, or that it
+	// no longer exists (if the pointer is null).
+	void Update(const std::string &name, int *value);
+	// Record that the given condition may have changed, or that any condition
+	// may have changed.
+	void Touch(const std::string &name);
+	void Touch(int id);
+	void TouchAll();
+	// Get a new revision number.
+	static uint64_t NextRevision();
+	
+	
+private:
+	std::map<std::string, int> values;
+	// For each condition ID that has been looked up, this holds a pointer to
+	// its value (or null, if it does not exist). IDs that have not been looked
+	// up yet point to "unresolved" instead. The map never moves its values, so
+	// these only change when a condition is added or erased.
+	mutable std::vector<int *> pointers;
+	static int unresolved;
+	
+	// The current revision, the last revision in which every condition may
+	// have changed, and for each condition ID, the last revision in which that
+	// condition may have changed (if it is more recent than "everything").
+	uint64_t revision = NextRevision();
+	uint64_t everything = revision;
+	std::vector<uint64_t> changed;
+};
+
+
+
+// Inline lookup of conditions that have been looked up before, for speed:
+inline const int *ConditionsStore::Find(int id) const
+{
+	if(static_cast<size_t>(id) < pointers.size() && pointers[id] != &unresolved)
+		return pointers[id];
+	return Resolve(id);
+}
+
+
+
+#endif
@@ -202,6 +202,12 @@ void Conversation::Load(const DataNode &node)
 		}
 	}
 	
+	// Note which nodes have text that Substitute() might need to change, so
+	// that it does not need to search through all the others.
+	for(Node &node : nodes)
+		for(const auto &it : node.data)
+			node.hasKeys |= (it.first.find('<') != string::npos);
+	
 	// Free the working buffers that we no longer need.
 	labels.clear();
 	unresolved.clear();
@@ -291,8 +297,9 @@ Conversation Conversation::Substitute(const map<string, string> &subs) const
 {
 	Conversation result = *this;
 	for(Node &node : result.nodes)
-		for(pair<string, int> &choice : node.data)
-			choice.first = Format::Replace(choice.first, subs);
+		if(node.hasKeys)
+			for(pair<string, int> &choice : node.data)
+				choice.first = Format::Replace(choice.first, subs);
 	return result;
 }
 
@@ -91,6 +91,8 @@ private:
 		bool isChoice;
 		// Keep track of whether it's possible to merge future nodes onto this.
 		bool canMergeOnto;
+		// Whether any of this node's text might contain a "<key>" to replace.
+		bool hasKeys = false;
 		
 		// Image that should be shown along with this text.
 		const Sprite *scene = nullptr;
@@ -96,10 +96,10 @@ void ConversationPanel::Draw()
 	
 	// Get the font and colors we'll need for drawing everything.
 	const Font &font = FontSet::Get(14);
-	Color selectionColor = *GameData::Colors().Get("faint");
-	Color dim = *GameData::Colors().Get("dim");
-	Color grey = *GameData::Colors().Get("medium");
-	Color bright = *GameData::Colors().Get("bright");
+	static const Color &selectionColor = *GameData::Colors().Get("faint");
+	static const Color &dim = *GameData::Colors().Get("dim");
+	static const Color &grey = *GameData::Colors().Get("medium");
+	static const Color &bright = *GameData::Colors().Get("bright");
 	
 	// Figure out where we should start drawing.
 	Point point(
@@ -0,0 +1,71 @@
+/* CurrentThread.cpp
+Copyright (c) 2017 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "CurrentThread.h"
+
+#if defined _WIN32
+#include <windows.h>
+#elif defined __APPLE__
+#include <pthread.h>
+#include <pthread/qos.h>
+#else
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+
+using namespace std;
+
+namespace {
+	// On Linux, each thread has its own "nice" value. Lowering it below zero
+	// needs permission, which most users will not have.
+	const int HIGH_PRIORITY_NICE = -5;
+}
+
+
+
+// Give the calling thread a name. Some systems only keep the first 15
+// characters of it.
+void CurrentThread::SetName(const char *name)
+{
+#if defined _WIN32
+	// Thread names need a newer Windows API than the game is built with.
+	(void)name;
+#else
+	char shortName[16];
+	strncpy(shortName, name, sizeof(shortName) - 1);
+	shortName[sizeof(shortName) - 1] = '\0';
+#if defined __APPLE__
+	pthread_setname_np(shortName);
+#else
+	pthread_setname_np(pthread_self(), shortName);
+#endif
+#endif
+}
+
+
+
+// Ask for the calling thread to be scheduled ahead of ordinary threads.
+// On Linux, this only works if the user is allowed to raise priorities.
+void CurrentThread::RaisePriority()
+{
+#if defined _WIN32
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_ABOVE_NORMAL);
+#elif defined __APPLE__
+	pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
+#else
+	setpriority(PRIO_PROCESS, syscall(SYS_gettid), HIGH_PRIORITY_NICE);
+#endif
+}
@@ -0,0 +1,36 @@
+/* CurrentThread.h
+Copyright (c) 2017 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef CURRENT_THREAD_H_
+#define CURRENT_THREAD_H_
+
+
+
+// Functions for describing the calling thread to the operating system. Naming
+// each thread makes it easy to tell them apart in a debugger or in a system
+// profiler like perf or Instruments, and raising the priority of the threads
+// that the frame rate depends on keeps other programs (or the game's own
+// background work) from delaying them. Anything that the operating system does
+// not support, or that the game is not allowed to do, is silently skipped.
+class CurrentThread {
+public:
+	// Give the calling thread a name. Some systems only keep the first 15
+	// characters of it.
+	static void SetName(const char *name);
+	// Ask for the calling thread to be scheduled ahead of ordinary threads.
+	// On Linux, this only works if the user is allowed to raise priorities.
+	static void RaisePriority();
+};
+
+
+
+#endif
@@ -13,9 +13,99 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "DataFile.h"
 
 #include "Files.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
 
 using namespace std;
 
+namespace {
+	// Bump this whenever the compiled format or the parser's output changes,
+	// so that files compiled by older versions are parsed again.
+	const uint32_t COMPILED_VERSION = 1;
+	
+	// 64-bit FNV-1a hash.
+	uint64_t Hash(const string &data)
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		for(char c : data)
+		{
+			hash ^= static_cast<unsigned char>(c);
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+	
+	// Get the path where the compiled form of the given file is cached.
+	string CompiledPath(const string &path)
+	{
+		if(Files::Cache().empty())
+			return string();
+		
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.data", static_cast<unsigned long long>(Hash(path)));
+		return Files::Cache() + name;
+	}
+	
+	// Saved games may be stored in the binary form. Those files begin with this
+	// string, which can never begin a text file, followed by the version.
+	const char BINARY_MAGIC[4] = {'\0', 'E', 'S', 'B'};
+	const uint32_t BINARY_VERSION = 1;
+	
+	// Functions for writing and reading the compiled form. Numbers are always
+	// written in little-endian byte order, since saved games in this form may
+	// be copied from one computer to another.
+	template <class Type>
+	void Append(string &out, Type value)
+	{
+		for(size_t i = 0; i < sizeof(value); ++i)
+			out += static_cast<char>(value >> (8 * i));
+	}
+	
+	void Append(string &out, const string &value)
+	{
+		Append(out, static_cast<uint32_t>(value.size()));
+		out += value;
+	}
+	
+	class Reader {
+	public:
+		Reader(const char *it, const char *end) : it(it), end(end) {}
+		
+		template <class Type>
+		bool Read(Type &value)
+		{
+			if(static_cast<size_t>(end - it) < sizeof(value))
+				return false;
+			value = 0;
+			for(size_t i = 0; i < sizeof(value); ++i)
+				value |= static_cast<Type>(static_cast<unsigned char>(*it++)) << (8 * i);
+			return true;
+		}
+		
+		bool Read(string &value)
+		{
+			uint32_t size = 0;
+			if(!Read(size) || static_cast<size_t>(end - it) < size)
+				return false;
+			value.assign(it, size);
+			it += size;
+			return true;
+		}
+		
+		size_t Remaining() const { return end - it; }
+		const char *Position() const { return it; }
+		
+	private:
+		const char *it;
+		const char *end;
+	};
+}
+
 
 
 // Constructor, taking a file path (in UTF-8).
@@ -37,15 +127,47 @@ DataFile::DataFile(istream &in)
 // Load from a file path (in UTF-8).
 void DataFile::Load(const string &path)
 {
-	string data = Files::Read(path);
-	if(data.empty())
+	if(!LoadText(path))
 		return;
 	
-	// As a sentinel, make sure the file always ends in a newline.
-	if(data.empty() || data.back() != '\n')
-		data.push_back('\n');
+	// Note what file this node is in, so it will show up in error traces.
+	root.tokens.push_back("file");
+	root.tokens.push_back(path);
+}
+
+
+
+// Load from a file path, but if the file has not changed since the last
+// time it was loaded this way, read the nodes from a compiled copy of it
+// in the cache folder instead of parsing the text again.
+void DataFile::LoadCached(const string &path)
+{
+	string compiledPath = CompiledPath(path);
+	if(compiledPath.empty())
+	{
+		Load(path);
+		return;
+	}
 	
-	Load(&*data.begin(), &*data.end());
+	// Checking the timestamp rather than a hash of the contents means the text
+	// does not even need to be read if the compiled copy is current.
+	uint64_t timestamp = Files::Timestamp(path);
+	{
+		// The mapping must be closed again before the compiled file is replaced.
+		MappedFile compiled(compiledPath);
+		if(compiled && LoadCompiled(compiled.begin(), compiled.end(), path, timestamp))
+		{
+			root.tokens.push_back("file");
+			root.tokens.push_back(path);
+			return;
+		}
+	}
+	
+	if(!LoadText(path))
+		return;
+	
+	if(!hasWarnings)
+		Files::WriteAtomically(compiledPath, Compile(path, timestamp));
 	
 	// Note what file this node is in, so it will show up in error traces.
 	root.tokens.push_back("file");
@@ -77,7 +199,7 @@ void DataFile::Load(istream &in)
 
 
 // Get an iterator to the start of the list of nodes in this file.
-list<DataNode>::const_iterator DataFile::begin() const
+vector<DataNode>::const_iterator DataFile::begin() const
 {
 	return root.begin();
 }
@@ -85,21 +207,82 @@ list<DataNode>::const_iterator DataFile::begin() const
 
 
 // Get an iterator to the end of the list of nodes in this file.
-list<DataNode>::const_iterator DataFile::end() const
+vector<DataNode>::const_iterator DataFile::end() const
 {
 	return root.end();
 }
 
 
 
+// Parse the text of the given file, reading it in place from a memory mapping.
+// This returns false if the file is empty or cannot be opened.
+bool DataFile::LoadText(const string &path)
+{
+	MappedFile file(path);
+	if(!file)
+		return false;
+	
+	// Saved games may be compressed. Those must be decompressed into memory
+	// before they can be read.
+	const char *begin = file.begin();
+	const char *end = file.end();
+	string data;
+	if(Files::IsCompressed(begin, end))
+	{
+		data = Files::Decompress(begin, end);
+		begin = data.data();
+		end = begin + data.size();
+	}
+	
+	// Saved games may also be in the binary form, which needs no parsing.
+	if(IsBinary(begin, end))
+	{
+		if(!LoadBinary(begin, end))
+			Files::LogError("Error: unable to read binary data file \"" + path + "\".");
+		return true;
+	}
+	
+	// The parser needs every file to end in a newline as a sentinel, but the
+	// mapping cannot be modified. In the rare case that the last newline is
+	// missing, parse a copy of the file instead.
+	if(begin != end && end[-1] == '\n')
+		Load(begin, end);
+	else
+	{
+		string copy(begin, end);
+		copy.push_back('\n');
+		Load(&*copy.begin(), &*copy.end());
+	}
+	return true;
+}
+
+
+
 // Parse the given text.
 void DataFile::Load(const char *it, const char *end)
 {
+	// The lines are parsed into a flat list first, so that once the number of
+	// children of each node is known, each node's children can be allocated in
+	// a single block that never has to grow. The tokens are just references to
+	// the text until then, so each is copied only once, into its final place.
+	struct Line {
+		int parent;
+		int children;
+		bool missingQuote;
+		size_t firstToken;
+	};
+	vector<Line> lines;
+	vector<pair<const char *, const char *>> tokens;
+	size_t lineCount = count(it, end, '\n');
+	lines.reserve(lineCount);
+	tokens.reserve(2 * lineCount);
+	
 	// Keep track of the current stack of indentation levels and the most recent
-	// node at each level - that is, the node that will be the "parent" of any
-	// new node added at the next deeper indentation level.
-	vector<DataNode *> stack(1, &root);
+	// line at each level - that is, the line that will be the "parent" of any
+	// new line added at the next deeper indentation level.
+	vector<int> stack(1, -1);
 	vector<int> whiteStack(1, -1);
+	int rootChildren = 0;
 	
 	for( ; it != end; ++it)
 	{
@@ -126,13 +309,14 @@ void DataFile::Load(const char *it, const char *end)
 			stack.pop_back();
 		}
 		
-		// Add this node as a child of the proper node.
-		list<DataNode> &children = stack.back()->children;
-		children.emplace_back(stack.back());
-		DataNode &node = children.back();
+		// Add this line as a child of the proper line.
+		int parent = stack.back();
+		++(parent < 0 ? rootChildren : lines[parent].children);
+		lines.push_back(Line{parent, 0, false, tokens.size()});
+		Line &line = lines.back();
 		
 		// Remember where in the tree we are.
-		stack.push_back(&node);
+		stack.push_back(lines.size() - 1);
 		whiteStack.push_back(white);
 		
 		// Tokenize the line. Skip comments and empty lines.
@@ -150,16 +334,8 @@ void DataFile::Load(const char *it, const char *end)
 			while(*it != '\n' && (isQuoted ? (*it != endQuote) : (*it > ' ')))
 				++it;
 			
-			// It ought to be legal to construct a string from an empty iterator
-			// range, but it appears that some libraries do not handle that case
-			// correctly. So:
-			if(start == it)
-				node.tokens.emplace_back();
-			else
-				node.tokens.emplace_back(start, it);
-			// This is not a fatal error, but it may indicate a format mistake:
-			if(isQuoted && *it == '\n')
-				node.PrintTrace("Closing quotation mark is missing:");
+			tokens.emplace_back(start, it);
+			line.missingQuote |= (isQuoted && *it == '\n');
 			
 			if(*it != '\n')
 			{
@@ -179,4 +355,219 @@ void DataFile::Load(const char *it, const char *end)
 			}
 		}
 	}
+	
+	// Now, build the tree. Because every node's children are reserved up front,
+	// adding a child never moves any node that has already been placed.
+	root.children.reserve(root.children.size() + rootChildren);
+	vector<DataNode *> nodes;
+	nodes.reserve(lines.size());
+	for(size_t i = 0; i < lines.size(); ++i)
+	{
+		const Line &line = lines[i];
+		auto first = tokens.begin() + line.firstToken;
+		auto last = (i + 1 < lines.size() ? tokens.begin() + lines[i + 1].firstToken : tokens.end());
+		DataNode *parent = (line.parent < 0 ? &root : nodes[line.parent]);
+		parent->children.emplace_back(parent);
+		DataNode &node = parent->children.back();
+		node.children.reserve(line.children);
+		node.tokens.reserve(last - first);
+		node.values.reserve(last - first);
+		for( ; first != last; ++first)
+		{
+			// It ought to be legal to construct a string from an empty iterator
+			// range, but it appears that some libraries do not handle that case
+			// correctly. So:
+			if(first->first == first->second)
+				node.tokens.emplace_back();
+			else
+				node.tokens.emplace_back(first->first, first->second);
+			node.values.push_back(DataNode::ParseNumber(node.tokens.back()));
+		}
+		nodes.push_back(&node);
+		
+		// This is not a fatal error, but it may indicate a format mistake:
+		if(line.missingQuote)
+		{
+			node.PrintTrace("Closing quotation mark is missing:");
+			hasWarnings = true;
+		}
+	}
+}
+
+
+
+// Read the compiled form of a file, if it was compiled from the given file
+// when it had the given timestamp. This returns false if it cannot be used.
+bool DataFile::LoadCompiled(const char *begin, const char *end, const string &path, uint64_t timestamp)
+{
+	Reader in(begin, end);
+	uint32_t version = 0;
+	uint64_t fileTimestamp = 0;
+	string filePath;
+	if(!in.Read(version) || version != COMPILED_VERSION || !in.Read(fileTimestamp)
+			|| fileTimestamp != timestamp || !in.Read(filePath) || filePath != path)
+		return false;
+	
+	return LoadTree(in.Position(), end);
+}
+
+
+
+// Check if the given data is in the binary form.
+bool DataFile::IsBinary(const char *begin, const char *end)
+{
+	return (static_cast<size_t>(end - begin) >= sizeof(BINARY_MAGIC)
+		&& !memcmp(begin, BINARY_MAGIC, sizeof(BINARY_MAGIC)));
+}
+
+
+
+// Get the binary form of this file's nodes, for saving.
+string DataFile::ToBinary() const
+{
+	string out(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+	Append(out, BINARY_VERSION);
+	out += CompileTree();
+	return out;
+}
+
+
+
+// Read a file in the binary form. This returns false if it is not valid.
+bool DataFile::LoadBinary(const char *begin, const char *end)
+{
+	Reader in(begin + sizeof(BINARY_MAGIC), end);
+	uint32_t version = 0;
+	if(!in.Read(version) || version != BINARY_VERSION)
+		return false;
+	
+	return LoadTree(in.Position(), end);
+}
+
+
+
+// Read the string table and the nodes, in the form that CompileTree() writes.
+bool DataFile::LoadTree(const char *begin, const char *end)
+{
+	Reader in(begin, end);
+	uint32_t count = 0;
+	if(!in.Read(count) || count > in.Remaining())
+		return false;
+	vector<string> strings(count);
+	for(string &str : strings)
+		if(!in.Read(str))
+			return false;
+	// Each distinct token only needs to be parsed as a number once.
+	vector<double> values;
+	values.reserve(strings.size());
+	for(const string &str : strings)
+		values.push_back(DataNode::ParseNumber(str));
+	
+	// Each node is stored as its token count, the index of each token in the
+	// string table, and its number of children. Its children follow it.
+	if(!in.Read(count) || count > in.Remaining())
+		return false;
+	root.children.reserve(count);
+	vector<pair<DataNode *, uint32_t>> stack(1, make_pair(&root, count));
+	while(!stack.empty())
+	{
+		if(!stack.back().second)
+		{
+			stack.pop_back();
+			continue;
+		}
+		--stack.back().second;
+		DataNode *parent = stack.back().first;
+		parent->children.emplace_back(parent);
+		DataNode &node = parent->children.back();
+		
+		uint32_t tokens = 0;
+		if(!in.Read(tokens) || tokens > in.Remaining() / sizeof(uint32_t))
+			break;
+		node.tokens.reserve(tokens);
+		node.values.reserve(tokens);
+		for(uint32_t i = 0; i < tokens; ++i)
+		{
+			uint32_t index = strings.size();
+			if(!in.Read(index) || index >= strings.size())
+				break;
+			node.tokens.push_back(strings[index]);
+			node.values.push_back(values[index]);
+		}
+		
+		uint32_t children = 0;
+		if(node.tokens.size() != tokens || !in.Read(children))
+			break;
+		if(children)
+		{
+			// Reserving the exact space needed means the children never move.
+			if(children > in.Remaining())
+				break;
+			node.children.reserve(children);
+			stack.emplace_back(&node, children);
+		}
+	}
+	
+	if(!stack.empty() || in.Remaining())
+	{
+		root.children.clear();
+		return false;
+	}
+	return true;
+}
+
+
+
+// Get the compiled form of this file's nodes. The tokens are stored in a
+// string table, since many of them (like "outfit" or "sprite") are repeated
+// many times in each file.
+string DataFile::Compile(const string &path, uint64_t timestamp) const
+{
+	string out;
+	Append(out, COMPILED_VERSION);
+	Append(out, timestamp);
+	Append(out, path);
+	out += CompileTree();
+	return out;
+}
+
+
+
+// Get the string table and the nodes, in the same form whether this is being
+// cached or saved.
+string DataFile::CompileTree() const
+{
+	map<string, uint32_t> strings;
+	string nodes;
+	Append(nodes, static_cast<uint32_t>(root.children.size()));
+	
+	typedef vector<DataNode>::const_iterator It;
+	vector<pair<It, It>> stack(1, make_pair(root.children.begin(), root.children.end()));
+	while(!stack.empty())
+	{
+		if(stack.back().first == stack.back().second)
+		{
+			stack.pop_back();
+			continue;
+		}
+		const DataNode &node = *stack.back().first++;
+		
+		Append(nodes, static_cast<uint32_t>(node.tokens.size()));
+		for(const string &token : node.tokens)
+			Append(nodes, strings.emplace(token, strings.size()).first->second);
+		Append(nodes, static_cast<uint32_t>(node.children.size()));
+		if(!node.children.empty())
+			stack.emplace_back(node.children.begin(), node.children.end());
+	}
+	
+	vector<const string *> table(strings.size());
+	for(const auto &it : strings)
+		table[it.second] = &it.first;
+	
+	string out;
+	Append(out, static_cast<uint32_t>(table.size()));
+	for(const string *str : table)
+		Append(out, *str);
+	out += nodes;
+	return out;
 }
@@ -15,8 +15,10 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 #include "DataNode.h"
 
+#include <cstdint>
 #include <istream>
 #include <list>
+#include <string>
 
 
 
@@ -35,19 +37,40 @@ public:
 	
 	void Load(const std::string &path);
 	void Load(std::istream &in);
+	// Load from a file path, but if the file has not changed since the last
+	// time it was loaded this way, read the nodes from a compiled copy of it
+	// in the cache folder instead of parsing the text again.
+	void LoadCached(const std::string &path);
+	
+	// Saved games may also be stored in a binary form, which holds the same
+	// nodes but can be read without parsing any text. Loading a file from a
+	// path automatically recognizes that form.
+	static bool IsBinary(const char *begin, const char *end);
+	std::string ToBinary() const;
 	
 	// Functions for iterating through all DataNodes in this file.
-	std::list<DataNode>::const_iterator begin() const;
-	std::list<DataNode>::const_iterator end() const;
+	std::vector<DataNode>::const_iterator begin() const;
+	std::vector<DataNode>::const_iterator end() const;
 	
 	
 private:
+	bool LoadText(const std::string &path);
 	void Load(const char *it, const char *end);
+	// Read or write the compiled form of this file's nodes.
+	bool LoadCompiled(const char *begin, const char *end, const std::string &path, uint64_t timestamp);
+	std::string Compile(const std::string &path, uint64_t timestamp) const;
+	bool LoadBinary(const char *begin, const char *end);
+	// Read or write the string table and nodes, which both forms share.
+	bool LoadTree(const char *begin, const char *end);
+	std::string CompileTree() const;
 	
 	
 private:
 	// This is the container for all DataNodes in this file.
 	DataNode root;
+	// Files that produced warnings when parsed are not cached, so that the
+	// warnings will still be shown the next time the game starts.
+	bool hasWarnings = false;
 };
 
 
@@ -17,43 +17,146 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include <algorithm>
 #include <cctype>
 #include <cmath>
+#include <limits>
 
 using namespace std;
 
+namespace {
+	// Check if the given token is a number in a format that DataNode is able
+	// to parse.
+	bool IsNumberToken(const char *it)
+	{
+		bool hasDecimalPoint = false;
+		bool hasExponent = false;
+		bool isLeading = true;
+		for( ; *it; ++it)
+		{
+			// If this is the start of the number or the exponent, it is allowed to
+			// be a '-' or '+' sign.
+			if(isLeading)
+			{
+				isLeading = false;
+				if(*it == '-' || *it == '+')
+					continue;
+			}
+			// If this is a decimal, it may or may not be allowed.
+			if(*it == '.')
+			{
+				if(hasDecimalPoint || hasExponent)
+					return false;
+				hasDecimalPoint = true;
+			}
+			else if(*it == 'e' || *it == 'E')
+			{
+				if(hasExponent)
+					return false;
+				hasExponent = true;
+				// At the start of an exponent, a '-' or '+' is allowed.
+				isLeading = true;
+			}
+			else if(*it < '0' || *it > '9')
+				return false;
+		}
+		return true;
+	}
+	
+	// Convert as much of the given text as possible to a number. The first
+	// character must be a sign, a digit or a decimal point.
+	double ParseValue(const char *it)
+	{
+		// Check for leading sign.
+		double sign = (*it == '-') ? -1. : 1.;
+		it += (*it == '-' || *it == '+');
+		
+		// Digits before the decimal point.
+		int64_t value = 0;
+		while(*it >= '0' && *it <= '9')
+			value = (value * 10) + (*it++ - '0');
+		
+		// Digits after the decimal point (if any).
+		int64_t power = 0;
+		if(*it == '.')
+		{
+			++it;
+			while(*it >= '0' && *it <= '9')
+			{
+				value = (value * 10) + (*it++ - '0');
+				--power;
+			}
+		}
+		
+		// Exponent.
+		if(*it == 'e' || *it == 'E')
+		{
+			++it;
+			int64_t sign = (*it == '-') ? -1 : 1;
+			it += (*it == '-' || *it == '+');
+			
+			int64_t exponent = 0;
+			while(*it >= '0' && *it <= '9')
+				exponent = (exponent * 10) + (*it++ - '0');
+			
+			power += sign * exponent;
+		}
+		
+		// Compose the return value.
+		return copysign(value * pow(10., power), sign);
+	}
+}
+
 
 
 // Construct a DataNode and remember what its parent is.
 DataNode::DataNode(const DataNode *parent)
 	: parent(parent)
 {
-	// To avoid a lot of memory reallocation, have every node start out with
-	// capacity for four tokens. This makes file loading slightly faster, at the
-	// cost of DataFiles taking up a bit more memory.
-	tokens.reserve(4);
 }
 
 
 
 // Copy constructor.
 DataNode::DataNode(const DataNode &other)
-	: children(other.children), tokens(other.tokens)
+	: children(other.children), tokens(other.tokens), values(other.values)
 {
 	Reparent();
 }
 
 
 
+// Move constructor.
+DataNode::DataNode(DataNode &&other) noexcept
+	: children(move(other.children)), tokens(move(other.tokens)), values(move(other.values)), parent(other.parent)
+{
+	AdoptChildren();
+}
+
+
+
 // Assignment operator.
 DataNode &DataNode::operator=(const DataNode &other)
 {
 	children = other.children;
 	tokens = other.tokens;
+	values = other.values;
 	Reparent();
 	return *this;
 }
 
 
 
+// Move assignment operator.
+DataNode &DataNode::operator=(DataNode &&other) noexcept
+{
+	children = move(other.children);
+	tokens = move(other.tokens);
+	values = move(other.values);
+	parent = other.parent;
+	AdoptChildren();
+	return *this;
+}
+
+
+
 // Get the number of tokens in this line of the data file.
 int DataNode::Size() const
 {
@@ -80,6 +183,10 @@ double DataNode::Value(int index) const
 		return 0.;
 	}
 	
+	// Numbers were already parsed when the file was loaded.
+	if(static_cast<size_t>(index) < values.size() && !std::isnan(values[index]))
+		return values[index];
+	
 	// Allowed format: "[+-]?[0-9]*[.]?[0-9]*([eE][+-]?[0-9]*)?".
 	const char *it = tokens[index].c_str();
 	if(*it != '-' && *it != '.' && *it != '+' && !(*it >= '0' && *it <= '9'))
@@ -88,43 +195,7 @@ double DataNode::Value(int index) const
 		return 0.;
 	}
 	
-	// Check for leading sign.
-	double sign = (*it == '-') ? -1. : 1.;
-	it += (*it == '-' || *it == '+');
-	
-	// Digits before the decimal point.
-	int64_t value = 0;
-	while(*it >= '0' && *it <= '9')
-		value = (value * 10) + (*it++ - '0');
-	
-	// Digits after the decimal point (if any).
-	int64_t power = 0;
-	if(*it == '.')
-	{
-		++it;
-		while(*it >= '0' && *it <= '9')
-		{
-			value = (value * 10) + (*it++ - '0');
-			--power;
-		}
-	}
-	
-	// Exponent.
-	if(*it == 'e' || *it == 'E')
-	{
-		++it;
-		int64_t sign = (*it == '-') ? -1 : 1;
-		it += (*it == '-' || *it == '+');
-		
-		int64_t exponent = 0;
-		while(*it >= '0' && *it <= '9')
-			exponent = (exponent * 10) + (*it++ - '0');
-		
-		power += sign * exponent;
-	}
-	
-	// Compose the return value.
-	return copysign(value * pow(10., power), sign);
+	return ParseValue(it);
 }
 
 
@@ -137,38 +208,10 @@ bool DataNode::IsNumber(int index) const
 	if(static_cast<size_t>(index) >= tokens.size() || tokens[index].empty())
 		return false;
 	
-	bool hasDecimalPoint = false;
-	bool hasExponent = false;
-	bool isLeading = true;
-	for(const char *it = tokens[index].c_str(); *it; ++it)
-	{
-		// If this is the start of the number or the exponent, it is allowed to
-		// be a '-' or '+' sign.
-		if(isLeading)
-		{
-			isLeading = false;
-			if(*it == '-' || *it == '+')
-				continue;
-		}
-		// If this is a decimal, it may or may not be allowed.
-		if(*it == '.')
-		{
-			if(hasDecimalPoint || hasExponent)
-				return false;
-			hasDecimalPoint = true;
-		}
-		else if(*it == 'e' || *it == 'E')
-		{
-			if(hasExponent)
-				return false;
-			hasExponent = true;
-			// At the start of an exponent, a '-' or '+' is allowed.
-			isLeading = true;
-		}
-		else if(*it < '0' || *it > '9')
-			return false;
-	}
-	return true;
+	if(static_cast<size_t>(index) < values.size() && !std::isnan(values[index]))
+		return true;
+	
+	return IsNumberToken(tokens[index].c_str());
 }
 
 
@@ -182,7 +225,7 @@ bool DataNode::HasChildren() const
 
 
 // Iterator to the beginning of the list of children.
-list<DataNode>::const_iterator DataNode::begin() const
+vector<DataNode>::const_iterator DataNode::begin() const
 {
 	return children.begin();
 }
@@ -190,7 +233,7 @@ list<DataNode>::const_iterator DataNode::begin() const
 
 
 // Iterator to the end of the list of children.
-list<DataNode>::const_iterator DataNode::end() const
+vector<DataNode>::const_iterator DataNode::end() const
 {
 	return children.end();
 }
@@ -246,3 +289,25 @@ void DataNode::Reparent()
 		child.Reparent();
 	}
 }
+
+
+
+// Adjust the parent pointers of this node's children after it has moved. The
+// grandchildren do not need to change, because the children's storage does not.
+void DataNode::AdoptChildren()
+{
+	for(DataNode &child : children)
+		child.parent = this;
+}
+
+
+
+// Get the value of the given token if it is a number in a format that this
+// class is able to parse, or NaN if it is not.
+double DataNode::ParseNumber(const string &token)
+{
+	if(token.empty() || !IsNumberToken(token.c_str()))
+		return numeric_limits<double>::quiet_NaN();
+	
+	return ParseValue(token.c_str());
+}
@@ -13,7 +13,6 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #ifndef DATA_NODE_H_
 #define DATA_NODE_H_
 
-#include <list>
 #include <string>
 #include <vector>
 
@@ -32,8 +31,12 @@ public:
 	explicit DataNode(const DataNode *parent = nullptr);
 	// Copy constructor.
 	DataNode(const DataNode &other);
+	// Moving a node only needs to update the parent pointers of its immediate
+	// children. This is what allows children to be stored contiguously.
+	DataNode(DataNode &&other) noexcept;
 	
 	DataNode &operator=(const DataNode &other);
+	DataNode &operator=(DataNode &&other) noexcept;
 	
 	// Get the number of tokens in this node.
 	int Size() const;
@@ -49,8 +52,8 @@ public:
 	// Check if this node has any children. If so, the iterator functions below
 	// can be used to access them.
 	bool HasChildren() const;
-	std::list<DataNode>::const_iterator begin() const;
-	std::list<DataNode>::const_iterator end() const;
+	std::vector<DataNode>::const_iterator begin() const;
+	std::vector<DataNode>::const_iterator end() const;
 	
 	// Print a message followed by a "trace" of this node and its parents.
 	int PrintTrace(const std::string &message = "") const;
@@ -59,13 +62,24 @@ public:
 private:
 	// Adjust the parent pointers when a copy is made of a DataNode.
 	void Reparent();
+	// Adjust only the parent pointers of this node's immediate children.
+	void AdoptChildren();
+	
+	// Get the value of the given token if it is a number in a format that this
+	// class is able to parse, or NaN if it is not.
+	static double ParseNumber(const std::string &token);
 	
 	
 private:
 	// These are "child" nodes found on subsequent lines with deeper indentation.
-	std::list<DataNode> children;
+	// They are stored in one block, rather than each in its own allocation.
+	std::vector<DataNode> children;
 	// These are the tokens found in this particular line of the data file.
 	std::vector<std::string> tokens;
+	// The value of each token that is a number, or NaN for the ones that are
+	// not, so that each number is only parsed once, when the file is loaded.
+	// Nodes that DataFile creates itself may not have these.
+	std::vector<double> values;
 	// The parent pointer is used only for printing stack traces.
 	const DataNode *parent = nullptr;
 	
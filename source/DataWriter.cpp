@@ -12,11 +12,79 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 #include "DataWriter.h"
 
+#include "DataFile.h"
 #include "DataNode.h"
 #include "Files.h"
+#include "SaveJournal.h"
+#include "ThreadPool.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
 
 using namespace std;
 
+namespace {
+	// Background saves waiting to be done, and whether one is in progress.
+	mutex saveMutex;
+	condition_variable saveCondition;
+	deque<function<void()>> saves;
+	bool isSaving = false;
+	
+	// Write the file under a temporary name and then rename it, so that if
+	// the program is stopped partway through, the old file is still intact.
+	// A journaled file is only written in full when its journal is compacted.
+	void Save(const string &path, const string &data, bool isCompressed, bool isJournaled, bool isBinary)
+	{
+		isJournaled &= !isBinary;
+		if(isJournaled && SaveJournal::Append(path, data))
+			return;
+		
+		string tempPath = path + ".tmp";
+		if(!isBinary && !isCompressed)
+			Files::Write(tempPath, data);
+		else
+		{
+			string binary;
+			if(isBinary)
+			{
+				istringstream in(data);
+				binary = DataFile(in).ToBinary();
+			}
+			const string &bytes = isBinary ? binary : data;
+			Files::WriteBinary(tempPath, isCompressed ? Files::Compress(bytes) : bytes);
+		}
+		Files::Move(tempPath, path);
+		
+		// Any journal the file had no longer applies to it.
+		if(isJournaled)
+			SaveJournal::Reset(path, data);
+		else if(SaveJournal::Exists(path))
+			SaveJournal::Delete(path);
+	}
+	
+	// Do the queued saves, one by one, until there are none left. Only one
+	// task does this at a time, so that the saves happen in order.
+	void DoSaves()
+	{
+		unique_lock<mutex> lock(saveMutex);
+		while(!saves.empty())
+		{
+			function<void()> save = move(saves.front());
+			saves.pop_front();
+			
+			lock.unlock();
+			save();
+			lock.lock();
+		}
+		isSaving = false;
+		saveCondition.notify_all();
+	}
+}
+
 
 
 // This string constant is just used for remembering what string needs to be
@@ -29,7 +97,6 @@ const string DataWriter::space = " ";
 DataWriter::DataWriter(const string &path)
 	: path(path), before(&indent)
 {
-	out.precision(8);
 }
 
 
@@ -37,7 +104,74 @@ DataWriter::DataWriter(const string &path)
 // Destructor, which saves the file all in one block.
 DataWriter::~DataWriter()
 {
-	Files::Write(path, out.str());
+	if(!isSaved)
+		Save(path, out, isCompressed, isJournaled, isBinary);
+}
+
+
+
+// Instead of saving the file when this object is destroyed, save it now in a
+// background thread. If a function is given, it is called in that thread just
+// before saving (e.g. to make backup copies of the old file).
+void DataWriter::SaveInBackground(function<void()> beforeSaving)
+{
+	isSaved = true;
+	// The output is moved rather than copied, since a saved game may be a few
+	// megabytes in size and this object will not use it again.
+	shared_ptr<string> data = make_shared<string>(move(out));
+	string path = this->path;
+	bool isCompressed = this->isCompressed;
+	bool isJournaled = this->isJournaled;
+	bool isBinary = this->isBinary;
+	
+	bool start = false;
+	{
+		unique_lock<mutex> lock(saveMutex);
+		saves.emplace_back([path, data, isCompressed, isJournaled, isBinary, beforeSaving]()
+		{
+			if(beforeSaving)
+				beforeSaving();
+			Save(path, *data, isCompressed, isJournaled, isBinary);
+		});
+		start = !isSaving;
+		isSaving = true;
+	}
+	if(start)
+		ThreadPool::Shared().Submit(DoSaves);
+}
+
+
+
+// Wait until all the background saves have finished.
+void DataWriter::FinishSaving()
+{
+	unique_lock<mutex> lock(saveMutex);
+	while(isSaving)
+		saveCondition.wait(lock);
+}
+
+
+
+// Compress the file with gzip when it is saved.
+void DataWriter::EnableCompression()
+{
+	isCompressed = true;
+}
+
+
+
+// Append the changes to a journal instead of writing the whole file.
+void DataWriter::EnableJournal()
+{
+	isJournaled = true;
+}
+
+
+
+// Save the file in the binary form instead of as text.
+void DataWriter::EnableBinary()
+{
+	isBinary = true;
 }
 
 
@@ -67,7 +201,7 @@ void DataWriter::Write(const DataNode &node)
 // Begin a new line of the file.
 void DataWriter::Write()
 {
-	out << '\n';
+	out += '\n';
 	before = &indent;
 }
 
@@ -92,7 +226,10 @@ void DataWriter::EndChild()
 // Write a comment line, at the current indentation level.
 void DataWriter::WriteComment(const string &str)
 {
-	out << indent << "# " << str << '\n';
+	out += indent;
+	out += "# ";
+	out += str;
+	out += '\n';
 }
 
 
@@ -110,13 +247,13 @@ void DataWriter::WriteToken(const char *a)
 	}
 	
 	// Write the token, enclosed in quotes if necessary.
-	out << *before;
-	if(hasSpace && hasQuote)
-		out << '`' << a << '`';
-	else if(hasSpace)
-		out << '"' << a << '"';
-	else
-		out << a;
+	out += *before;
+	char quote = (hasSpace && hasQuote) ? '`' : hasSpace ? '"' : '\0';
+	if(quote)
+		out += quote;
+	out += a;
+	if(quote)
+		out += quote;
 	
 	// The next token written will not be the first one on this line, so it only
 	// needs to have a single space before it.
@@ -130,3 +267,44 @@ void DataWriter::WriteToken(const string &a)
 {
 	WriteToken(a.c_str());
 }
+
+
+
+// Write a signed integer.
+void DataWriter::WriteNumber(int64_t value)
+{
+	if(value < 0)
+	{
+		out += '-';
+		// Negate in unsigned arithmetic so that the most negative value works.
+		WriteNumber(-static_cast<uint64_t>(value));
+	}
+	else
+		WriteNumber(static_cast<uint64_t>(value));
+}
+
+
+
+// Write an unsigned integer, building its digits from the end.
+void DataWriter::WriteNumber(uint64_t value)
+{
+	char buffer[20];
+	char *it = end(buffer);
+	do {
+		*--it = '0' + value % 10;
+		value /= 10;
+	} while(value);
+	out.append(it, end(buffer));
+}
+
+
+
+// Write a floating point value, in the same format an ostream would use with
+// its precision set to 8.
+void DataWriter::WriteNumber(double value)
+{
+	char buffer[32];
+	int length = snprintf(buffer, sizeof(buffer), "%.8g", value);
+	if(length > 0)
+		out.append(buffer, length);
+}
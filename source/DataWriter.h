@@ -13,8 +13,10 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #ifndef DATA_WRITER_H_
 #define DATA_WRITER_H_
 
+#include <cstdint>
+#include <functional>
 #include <string>
-#include <sstream>
+#include <type_traits>
 
 class DataNode;
 
@@ -30,9 +32,31 @@ public:
 	// Constructor, specifying the file to write.
 	explicit DataWriter(const std::string &path);
 	// The file is not actually saved until the destructor is called. This makes
-	// it possible to write the whole file in a single chunk.
+	// it possible to write the whole file in a single chunk. It is written to a
+	// temporary file first, then renamed, so that an interrupted save never
+	// leaves a partly written file in place of the old one.
 	~DataWriter();
 	
+	// Instead of saving the file when this object is destroyed, save it now in
+	// a background thread. If a function is given, it is called in that thread
+	// just before saving (e.g. to make backup copies of the old file). The
+	// background saves are done one at a time, in the order they were begun.
+	void SaveInBackground(std::function<void()> beforeSaving = std::function<void()>());
+	// Wait until all the background saves have finished. This must be done
+	// before reading any file that may have a save still pending, and before
+	// the program exits.
+	static void FinishSaving();
+	// Compress the file with gzip when it is saved. DataFile recognizes such
+	// files and reads them the same way as uncompressed ones.
+	void EnableCompression();
+	// Instead of writing the whole file each time, append just the parts that
+	// changed since it was last saved to a journal (see SaveJournal). Files
+	// saved this way must be read with SaveJournal::Load().
+	void EnableJournal();
+	// Save the file in DataFile's binary form instead of as text. Files saved
+	// this way cannot be journaled, so that option is ignored.
+	void EnableBinary();
+	
 	// The Write() function can take any number of arguments. Each argument is
 	// converted to a token. Arguments may be strings or numeric values.
   template <class A, class ...B>
@@ -61,6 +85,14 @@ public:
 	void WriteToken(const A &a);
 	
 	
+private:
+	// Format numbers directly into the output. Integers are converted digit by
+	// digit, and floating point values are given eight significant digits.
+	void WriteNumber(int64_t value);
+	void WriteNumber(uint64_t value);
+	void WriteNumber(double value);
+	
+	
 private:
 	// Save path (in UTF-8).
 	std::string path;
@@ -73,7 +105,15 @@ private:
 	// "indent" for the first token in a line and "space" for subsequent tokens.
 	const std::string *before;
 	// Compose the output in memory before writing it to file.
-	std::ostringstream out;
+	std::string out;
+	// Whether the output has already been handed off to a background save.
+	bool isSaved = false;
+	// Whether to compress the file with gzip when saving it.
+	bool isCompressed = false;
+	// Whether to append only the changes to a journal instead of the whole file.
+	bool isJournaled = false;
+	// Whether to save the file in DataFile's binary form instead of as text.
+	bool isBinary = false;
 };
 
 
@@ -96,7 +136,13 @@ void DataWriter::WriteToken(const A &a)
 	static_assert(std::is_arithmetic<A>::value,
 		"DataWriter cannot output anything but strings and arithmetic types.");
 	
-	out << *before << a;
+	out += *before;
+	if(std::is_floating_point<A>::value)
+		WriteNumber(static_cast<double>(a));
+	else if(std::is_signed<A>::value)
+		WriteNumber(static_cast<int64_t>(a));
+	else
+		WriteNumber(static_cast<uint64_t>(a));
 	before = &space;
 }
 
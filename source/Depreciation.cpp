@@ -57,7 +57,7 @@ void Depreciation::Load(const DataNode &node)
 			continue;
 		
 		// Figure out which record we're modifying.
-		map<int, int> &entry = isShip ?
+		FlatMap<int, int> &entry = isShip ?
 			ships[GameData::Ships().Get(child.Token(1))] :
 			outfits[GameData::Outfits().Get(child.Token(1))];
 		
@@ -201,8 +201,8 @@ void Depreciation::Buy(const Outfit *outfit, int day, Depreciation *source)
 // Get the value of an entire fleet.
 int64_t Depreciation::Value(const vector<shared_ptr<Ship>> &fleet, int day) const
 {
-	map<const Ship *, int> shipCount;
-	map<const Outfit *, int> outfitCount;
+	FlatMap<const Ship *, int> shipCount;
+	FlatMap<const Outfit *, int> outfitCount;
 	
 	for(const shared_ptr<Ship> &ship : fleet)
 	{
@@ -268,7 +268,7 @@ int64_t Depreciation::Value(const Outfit *outfit, int day, int count) const
 
 // "Sell" an item, removing it from the given record and returning the base
 // day for its depreciation.
-int Depreciation::Sell(map<int, int> &record)
+int Depreciation::Sell(FlatMap<int, int> &record)
 {
 	// If we're a planet, we start by selling the oldest, cheapest thing.
 	auto it = (isStock ? record.begin() : --record.end());
@@ -286,14 +286,14 @@ int Depreciation::Sell(map<int, int> &record)
 
 
 // Calculate depreciation for some number of items.
-double Depreciation::Depreciate(const map<int, int> &record, int day, int count) const
+double Depreciation::Depreciate(const FlatMap<int, int> &record, int day, int count) const
 {
 	if(record.empty())
 		return count * DefaultDepreciation();
 	
 	// Depending on whether this is a planet's stock or a player's fleet, we
 	// should either start with the oldest item, or the newest.
-	map<int, int>::const_iterator it = (isStock ? record.begin() : --record.end());
+	auto it = (isStock ? record.begin() : --record.end());
 	
 	double sum = 0.;
 	while(true)
@@ -336,9 +336,20 @@ double Depreciation::Depreciate(int age) const
 	if(age >= MAX_AGE)
 		return FULL_DEPRECIATION;
 	
-	double daily = pow(DAILY_DEPRECIATION, age);
-	double linear = static_cast<double>(MAX_AGE - age) / MAX_AGE;
-	return FULL_DEPRECIATION + (1. - FULL_DEPRECIATION) * daily * linear;
+	// There are only MAX_AGE possible ages, so calculate the value of each of
+	// them once rather than calling pow() for every item in every record.
+	static const vector<double> table = []()
+	{
+		vector<double> result(MAX_AGE);
+		for(int age = 0; age < MAX_AGE; ++age)
+		{
+			double daily = pow(DAILY_DEPRECIATION, age);
+			double linear = static_cast<double>(MAX_AGE - age) / MAX_AGE;
+			result[age] = FULL_DEPRECIATION + (1. - FULL_DEPRECIATION) * daily * linear;
+		}
+		return result;
+	}();
+	return table[age];
 }
 
 
@@ -13,8 +13,9 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #ifndef DEPRECIATION_H_
 #define DEPRECIATION_H_
 
+#include "FlatMap.h"
+
 #include <cstdint>
-#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -63,9 +64,9 @@ public:
 private:
 	// "Sell" an item, removing it from the given record and returning the base
 	// day for its depreciation.
-	int Sell(std::map<int, int> &record);
+	int Sell(FlatMap<int, int> &record);
 	// Calculate depreciation:
-	double Depreciate(const std::map<int, int> &record, int day, int count = 1) const;
+	double Depreciate(const FlatMap<int, int> &record, int day, int count = 1) const;
 	double Depreciate(int age) const;
 	// Depreciation of an item for which no record exists. If buying, items
 	// default to no depreciation. When selling, they default to full.
@@ -81,8 +82,11 @@ private:
 	// Check if any data has been loaded.
 	bool isLoaded = false;
 	
-	std::map<const Ship *, std::map<int, int>> ships;
-	std::map<const Outfit *, std::map<int, int>> outfits;
+	// For each ship and outfit, the number of items bought on each day. These
+	// are small and are searched far more often than they change, so they are
+	// kept in sorted vectors.
+	FlatMap<const Ship *, FlatMap<int, int>> ships;
+	FlatMap<const Outfit *, FlatMap<int, int>> outfits;
 };
 
 
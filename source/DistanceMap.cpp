@@ -19,6 +19,58 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 using namespace std;
 
+namespace {
+	// The star map, stored as flat arrays indexed by System::Index(). The
+	// systems linked to system i are links[linkStart[i]] through
+	// links[linkStart[i + 1] - 1], and likewise for its neighbors.
+	vector<const System *> graph;
+	vector<int> linkStart;
+	vector<int> links;
+	vector<int> neighborStart;
+	vector<int> neighbors;
+	
+	// Get the index of the given system, or -1 if it is not part of the graph.
+	int IndexOf(const System *system)
+	{
+		int index = system ? system->Index() : -1;
+		return (index >= 0 && static_cast<size_t>(index) < graph.size() && graph[index] == system) ? index : -1;
+	}
+	
+	void AddEdges(const set<const System *> &systems, vector<int> &start, vector<int> &list)
+	{
+		for(const System *system : systems)
+		{
+			int index = IndexOf(system);
+			if(index >= 0)
+				list.push_back(index);
+		}
+		start.push_back(list.size());
+	}
+}
+
+
+
+// Rebuild the flat arrays of links and neighbors that the pathfinding
+// uses. This must be done any time the systems or their links change.
+void DistanceMap::UpdateGraph(const Set<System> &systems)
+{
+	graph.clear();
+	for(const auto &it : systems)
+		graph.push_back(&it.second);
+	
+	linkStart.assign(1, 0);
+	links.clear();
+	neighborStart.assign(1, 0);
+	neighbors.clear();
+	for(const System *system : graph)
+	{
+		AddEdges(system->Links(), linkStart, links);
+		AddEdges(system->Neighbors(), neighborStart, neighbors);
+	}
+}
+
+
+
 
 
 // Find paths to the given system. If the given maximum count is above zero,
@@ -58,9 +110,10 @@ DistanceMap::DistanceMap(const PlayerInfo &player, const System *center)
 
 // Calculate the path for the given ship to get to the given system. The
 // ship will use a jump drive or hyperdrive depending on what it has. The
-// pathfinding will stop once a path to the destination is found.
-DistanceMap::DistanceMap(const Ship &ship, const System *destination)
-	: source(ship.GetSystem())
+// pathfinding will stop once a path to the destination is found, unless
+// "complete" is set, in which case paths from every system are found.
+DistanceMap::DistanceMap(const Ship &ship, const System *destination, bool complete)
+	: source(ship.GetSystem()), stopAtSource(!complete)
 {
 	if(!source || !destination)
 		return;
@@ -73,7 +126,7 @@ DistanceMap::DistanceMap(const Ship &ship, const System *destination)
 // Find out if the given system is reachable.
 bool DistanceMap::HasRoute(const System *system) const
 {
-	return route.count(system);
+	return Days(system) >= 0;
 }
 
 
@@ -81,8 +134,8 @@ bool DistanceMap::HasRoute(const System *system) const
 // Find out how many days away the given system is.
 int DistanceMap::Days(const System *system) const
 {
-	auto it = route.find(system);
-	return (it == route.end() ? -1 : it->second.days);
+	int index = IndexOf(system);
+	return (index < 0 || static_cast<size_t>(index) >= route.size()) ? -1 : route[index].days;
 }
 
 
@@ -90,8 +143,8 @@ int DistanceMap::Days(const System *system) const
 // Starting in the given system, what is the next system along the route?
 const System *DistanceMap::Route(const System *system) const
 {
-	auto it = route.find(system);
-	return (it == route.end() ? nullptr : it->second.next);
+	int index = IndexOf(system);
+	return (index < 0 || static_cast<size_t>(index) >= route.size()) ? nullptr : route[index].next;
 }
 	
 	
@@ -100,8 +153,9 @@ const System *DistanceMap::Route(const System *system) const
 set<const System *> DistanceMap::Systems() const
 {
 	set<const System *> systems;
-	for(const auto &it : route)
-		systems.insert(it.first);
+	for(size_t i = 0; i < route.size(); ++i)
+		if(route[i].days >= 0)
+			systems.insert(graph[i]);
 	return systems;
 }
 
@@ -135,10 +189,14 @@ bool DistanceMap::Edge::operator<(const Edge &other) const
 // source system or the maximum count is reached.
 void DistanceMap::Init(const System *center, const Ship *ship)
 {
-	if(!center)
+	int centerIndex = IndexOf(center);
+	if(centerIndex < 0)
 		return;
 	
-	route[center] = Edge();
+	Edge unreached;
+	unreached.days = -1;
+	route.assign(graph.size(), unreached);
+	route[centerIndex] = Edge();
 	if(!maxDistance)
 		return;
 	
@@ -168,7 +226,7 @@ void DistanceMap::Init(const System *center, const Ship *ship)
 		Edge top = edges.top();
 		edges.pop();
 		
-		if(top.next == source)
+		if(stopAtSource && top.next == source)
 			break;
 		// Increment the danger and the travel time to include this system. The
 		// fuel cost will be incremented later, because it depends on what type
@@ -220,8 +278,15 @@ bool DistanceMap::Propagate(Edge edge, bool useJump)
 {
 	// The "length" of this link is 2 if using a jump drive.
 	edge.fuel += (useJump ? jumpFuel : hyperspaceFuel);
-	for(const System *link : (useJump ? edge.next->Neighbors() : edge.next->Links()))
+	int from = IndexOf(edge.next);
+	if(from < 0)
+		return true;
+	
+	const vector<int> &start = (useJump ? neighborStart : linkStart);
+	const vector<int> &list = (useJump ? neighbors : links);
+	for(int i = start[from]; i < start[from + 1]; ++i)
 	{
+		const System *link = graph[list[i]];
 		// Find out whether we already have a better path to this system, and
 		// check whether this link can be traveled. If this route is being
 		// selected by the player, they are constrained to known routes.
@@ -238,10 +303,15 @@ bool DistanceMap::Propagate(Edge edge, bool useJump)
 
 
 // Check if we already have a better path to the given system.
-bool DistanceMap::HasBetter(const System *to, const Edge &edge)
+bool DistanceMap::HasBetter(const System *to, const Edge &edge) const
 {
-	auto it = route.find(to);
-	return (it != route.end() && !(it->second < edge));
+	// Systems that are not part of the graph can never be reached.
+	int index = IndexOf(to);
+	if(index < 0)
+		return true;
+	
+	const Edge &existing = route[index];
+	return (existing.days >= 0 && !(existing < edge));
 }
 
 
@@ -251,7 +321,7 @@ void DistanceMap::Add(const System *to, Edge edge)
 {
 	// This is the best path we have found so far to this system, but it is
 	// conceivable that a better one will be found.
-	route[to] = edge;
+	route[IndexOf(to)] = edge;
 	edge.next = to;
 	if(maxDistance < 0 || edge.days < maxDistance)
 		edges.emplace(edge);
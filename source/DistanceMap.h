@@ -13,10 +13,12 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #ifndef DISTANCE_MAP_H_
 #define DISTANCE_MAP_H_
 
-#include <map>
+#include "Set.h"
+
 #include <queue>
 #include <set>
 #include <utility>
+#include <vector>
 
 class Ship;
 class System;
@@ -30,6 +32,11 @@ class PlayerInfo;
 // but can also travel to any of a system's "neighbors." A distance map can also
 // be used to calculate the shortest route between two systems.
 class DistanceMap {
+public:
+	// Rebuild the flat arrays of links and neighbors that the pathfinding
+	// uses. This must be done any time the systems or their links change.
+	static void UpdateGraph(const Set<System> &systems);
+	
 public:
 	// Find paths to the given system. The optional arguments put a limit on how
 	// many systems will be returned and how far away they are allowed to be.
@@ -40,8 +47,9 @@ public:
 	explicit DistanceMap(const PlayerInfo &player, const System *center = nullptr);
 	// Calculate the path for the given ship to get to the given system. The
 	// ship will use a jump drive or hyperdrive depending on what it has. The
-	// pathfinding will stop once a path to the destination is found.
-	DistanceMap(const Ship &ship, const System *destination);
+	// pathfinding will stop once a path to the destination is found, unless
+	// "complete" is set, in which case paths from every system are found.
+	DistanceMap(const Ship &ship, const System *destination, bool complete = false);
 	
 	// Find out if the given system is reachable.
 	bool HasRoute(const System *system) const;
@@ -81,7 +89,7 @@ private:
 	// Add the given links to the map. Return false if an end condition is hit.
 	bool Propagate(Edge edge, bool useJump);
 	// Check if we already have a better path to the given system.
-	bool HasBetter(const System *to, const Edge &edge);
+	bool HasBetter(const System *to, const Edge &edge) const;
 	// Add the given path to the record.
 	void Add(const System *to, Edge edge);
 	// Check whether the given link is travelable. If no player was given in the
@@ -91,12 +99,15 @@ private:
 	
 	
 private:
-	std::map<const System *, Edge> route;
+	// The best route to each system, indexed by System::Index(). Systems that
+	// cannot be reached have a "days" of -1.
+	std::vector<Edge> route;
 	
 	// Variables only used during construction:
 	std::priority_queue<Edge> edges;
 	const PlayerInfo *player = nullptr;
 	const System *source = nullptr;
+	bool stopAtSource = true;
 	int maxCount = -1;
 	int maxDistance = -1;
 	// How much fuel is used for travel. If either value is zero, it means that
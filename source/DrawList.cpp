@@ -19,16 +19,30 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "SpriteSet.h"
 #include "SpriteShader.h"
 
+#include <algorithm>
 #include <cmath>
 
 using namespace std;
 
+namespace {
+	// Objects smaller than this many pixels on the screen, counting their
+	// motion blur, are drawn in less detail.
+	const double DISTANT_SIZE = 6.;
+	// Effects smaller than this on the screen are not drawn at all.
+	const double MIN_EFFECT_SIZE = 1.5;
+}
+
 
 
-// Clear the list.
-void DrawList::Clear(int step, double zoom)
+// Clear the list, also setting the global time step for animation. If the
+// list will not be drawn, nothing is added to it until it is cleared again.
+void DrawList::Clear(int step, double zoom, bool isShown)
 {
+	this->isShown = isShown;
 	items.clear();
+	groupStart = 0;
+	distant.clear();
+	isSorted = true;
 	this->step = step;
 	this->zoom = zoom;
 	isHighDPI = (Screen::IsHighResolution() ? zoom > .5 : zoom > 1.);
@@ -47,91 +61,108 @@ void DrawList::SetCenter(const Point &center, const Point &centerVelocity)
 // Add an object based on the Body class.
 bool DrawList::Add(const Body &body, double cloak)
 {
-	Point position = body.Position() - center;
-	Point blur = body.Velocity() - centerVelocity;
-	if(Cull(body, position, blur) || cloak >= 1.)
+	if(cloak >= 1.)
 		return false;
 	
-	Push(body, position, blur, cloak, 1., body.GetSwizzle());
-	return true;
+	return Push(body, body.Position() - center, body.Velocity() - centerVelocity, cloak, 1., body.GetSwizzle());
 }
 
 
 
 bool DrawList::Add(const Body &body, Point position)
 {
-	position -= center;
-	Point blur = body.Velocity() - centerVelocity;
-	if(Cull(body, position, blur))
-		return false;
-	
-	Push(body, position, blur, 0., 1., body.GetSwizzle());
-	return true;
+	return Push(body, position - center, body.Velocity() - centerVelocity, 0., 1., body.GetSwizzle());
 }
 
 
 
 bool DrawList::AddUnblurred(const Body &body)
 {
-	Point position = body.Position() - center;
-	Point blur;
-	if(Cull(body, position, blur))
-		return false;
-	
-	Push(body, position, blur, 0., 1., body.GetSwizzle());
-	return true;
+	return Push(body, body.Position() - center, Point(), 0., 1., body.GetSwizzle());
 }
 
 
 
 bool DrawList::AddProjectile(const Body &body, const Point &adjustedVelocity, double clip)
 {
-	Point position = body.Position() + .5 * body.Velocity() - center;
-	Point blur = adjustedVelocity - centerVelocity;
-	if(Cull(body, position, blur) || clip <= 0.)
+	if(clip <= 0.)
 		return false;
 	
-	Push(body, position, blur, 0., clip, body.GetSwizzle());
-	return true;
+	Point position = body.Position() + .5 * body.Velocity() - center;
+	return Push(body, position, adjustedVelocity - centerVelocity, 0., clip, body.GetSwizzle());
 }
 
 
 
 bool DrawList::AddSwizzled(const Body &body, int swizzle)
 {
-	Point position = body.Position() - center;
-	Point blur = body.Velocity() - centerVelocity;
-	if(Cull(body, position, blur))
+	return Push(body, body.Position() - center, body.Velocity() - centerVelocity, 0., 1., swizzle);
+}
+
+
+
+// Add an effect, unless it is too small on the screen to be worth drawing.
+bool DrawList::AddEffect(const Body &body)
+{
+	if(max(body.Width(), body.Height()) * zoom < MIN_EFFECT_SIZE)
 		return false;
 	
-	Push(body, position, blur, 0., 1., swizzle);
-	return true;
+	return Push(body, body.Position() - center, Point(), 0., 1., body.GetSwizzle());
 }
 
 
 
-// Draw all the items in this list.
-void DrawList::Draw() const
+// Mark the start and end of a group of items whose order among themselves
+// does not matter, like the asteroids or the projectiles. Each group is
+// still drawn in the order it was added, but the items inside it are sorted
+// by texture so that more of them can be drawn in a single batch.
+void DrawList::BeginGroup()
 {
-	bool showBlur = Preferences::Has("Render motion blur");
-	SpriteShader::Bind();
+	groupStart = items.size();
+}
 
-	for(const Item &item : items)
-		SpriteShader::Add(
-			item.tex0, item.tex1, item.position, item.transform,
-			item.Swizzle(), item.Clip(), item.Fade(), showBlur ? item.blur : nullptr);
 
-	SpriteShader::Unbind();
+
+void DrawList::EndGroup()
+{
+	// The sort is stable, so items that share a texture keep their order and
+	// the result does not flicker from one frame to the next. The swizzle is
+	// part of each instance, so it does not break up a batch.
+	stable_sort(items.begin() + groupStart, items.end(),
+		[](const SpriteShader::Item &a, const SpriteShader::Item &b)
+		{
+			return (a.tex0 == b.tex0) ? a.tex1 < b.tex1 : a.tex0 < b.tex0;
+		});
+	groupStart = items.size();
 }
 
 
 
-bool DrawList::Cull(const Body &body, const Point &position, const Point &blur) const
+// Draw all the items in this list.
+void DrawList::Draw(double interpolation, bool allowBlur) const
+{
+	// The items are moved back to where they were between steps by the shader,
+	// so the list can be drawn as it is.
+	bool showBlur = allowBlur && Preferences::Has(Preferences::RENDER_MOTION_BLUR);
+	SpriteShader::Draw(items, showBlur, interpolation);
+	
+	// Distant objects are too small for their draw order to matter much.
+	if(!isSorted)
+	{
+		stable_sort(distant.begin(), distant.end(),
+			[](const SpriteShader::Item &a, const SpriteShader::Item &b) { return a.tex0 < b.tex0; });
+		isSorted = true;
+	}
+	SpriteShader::Draw(distant, false, interpolation);
+}
+
+
+
+bool DrawList::Cull(const Body &body, const Point &position, const Point &blur, const Point &unit) const
 {
 	if(!body.HasSprite() || !body.Zoom())
 		return true;
 	
-	Point unit = body.Facing().Unit();
 	// Cull sprites that are completely off screen, to reduce the number of draw
 	// calls that we issue (which may be the bottleneck on some systems).
 	Point size(
@@ -149,19 +180,42 @@ bool DrawList::Cull(const Body &body, const Point &position, const Point &blur)
 
 
 
-void DrawList::Push(const Body &body, Point pos, Point blur, double cloak, double clip, int swizzle)
+// Add the given body to the list, unless it is off screen. The unit vector of
+// its facing is needed both for culling and for the transform, so it is only
+// looked up once.
+bool DrawList::Push(const Body &body, Point pos, Point blur, double cloak, double clip, int swizzle)
 {
-	Item item;
+	if(!isShown)
+		return false;
+	
+	Point unit = body.Facing().Unit();
+	if(Cull(body, pos, blur, unit))
+		return false;
+	
+	SpriteShader::Item item;
 	
 	Body::Frame frame = body.GetFrame(step, isHighDPI);
-	item.tex0 = frame.first;
-	item.tex1 = frame.second;
-	item.flags = swizzle | (static_cast<uint32_t>(frame.fade * 256.f) << 8);
+	item.tex0 = frame.texture;
+	item.layers[0] = frame.first;
+	if(cloak > 0.)
+	{
+		const Sprite *cloaked = SpriteSet::Get("ship/cloaked");
+		item.tex1 = cloaked->Texture();
+		item.layers[1] = cloaked->Layer();
+		item.flags = swizzle | (static_cast<uint32_t>(cloak * 256.f) << 8);
+	}
+	else
+	{
+		// Both frames come from the same array texture, so items showing any
+		// frames of the same sprite can all be drawn together.
+		item.tex1 = frame.texture;
+		item.layers[1] = frame.second;
+		item.flags = swizzle | (static_cast<uint32_t>(frame.fade * 256.f) << 8);
+	}
 	
 	// Get unit vectors in the direction of the object's width and height.
 	double width = body.Width();
 	double height = body.Height();
-	Point unit = body.Facing().Unit();
 	Point uw = unit * width;
 	Point uh = unit * height;
 	
@@ -188,40 +242,25 @@ void DrawList::Push(const Body &body, Point pos, Point blur, double cloak, doubl
 	blur *= zoom;
 	item.blur[0] = unit.Cross(blur) / (width * 4.);
 	item.blur[1] = -unit.Dot(blur) / (height * 4.);
-
-	if(cloak > 0.f)
-		item.Cloak(cloak);
+	
+	Point motion = (body.Velocity() - centerVelocity) * zoom;
+	item.motion[0] = static_cast<float>(motion.X());
+	item.motion[1] = static_cast<float>(motion.Y());
+	
+	// Something this small looks the same without blur or blending between
+	// frames, and can be drawn in a batch with every other copy of its sprite.
+	if(cloak <= 0. && max(width, height) * zoom + blur.Length() < DISTANT_SIZE)
+	{
+		item.tex1 = item.tex0;
+		item.layers[1] = item.layers[0];
+		item.flags = swizzle;
+		item.blur[0] = 0.f;
+		item.blur[1] = 0.f;
+		distant.push_back(item);
+		isSorted = false;
+		return true;
+	}
 	
 	items.push_back(item);
-}
-
-
-		
-// Get the color swizzle.
-uint32_t DrawList::Item::Swizzle() const
-{
-	return (flags & 7);
-}
-
-
-		
-float DrawList::Item::Clip() const
-{
-	return clip;
-}
-
-
-
-float DrawList::Item::Fade() const
-{
-	return (flags >> 8) / 256.f;
-}
-
-
-
-void DrawList::Item::Cloak(double cloak)
-{
-	tex1 = SpriteSet::Get("ship/cloaked")->Texture();
-	flags &= 0xFF;
-	flags |= static_cast<uint32_t>(cloak * 256.f) << 8;
+	return true;
 }
@@ -14,8 +14,9 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #define DRAW_LIST_H_
 
 #include "Point.h"
+#include "SpriteShader.h"
 
-#include <cstdint>
+#include <cstddef>
 #include <vector>
 
 class Body;
@@ -27,11 +28,15 @@ class Sprite;
 // work of calculating the transformation matrices to be done in a separate
 // thread from the graphics thread. However, the SpriteShader class is also
 // available for drawing individual sprites in contexts where putting them into
-// a DrawList first does not make sense.
+// a DrawList first does not make sense. Objects that are only a few pixels
+// across on the screen (which, when zoomed out, may be most of them) are drawn
+// in less detail: without motion blur or animation blending, and after all the
+// others, grouped by sprite so that each sprite's copies take one draw call.
 class DrawList {
 public:
-	// Clear the list, also setting the global time step for animation.
-	void Clear(int step = 0, double zoom = 1.);
+	// Clear the list, also setting the global time step for animation. If the
+	// list will not be drawn, nothing is added to it until it is cleared again.
+	void Clear(int step = 0, double zoom = 1., bool isShown = true);
 	void SetCenter(const Point &center, const Point &centerVelocity = Point());
 	
 	// Add an object based on the Body class.
@@ -40,44 +45,41 @@ public:
 	bool AddUnblurred(const Body &body);
 	bool AddProjectile(const Body &body, const Point &adjustedVelocity, double clip);
 	bool AddSwizzled(const Body &body, int swizzle);
+	// Add an effect, unless it is too small on the screen to be worth drawing.
+	bool AddEffect(const Body &body);
 	
-	// Draw all the items in this list.
-	void Draw() const;
+	// Mark the start and end of a group of items whose order among themselves
+	// does not matter, like the asteroids or the projectiles. Each group is
+	// still drawn in the order it was added, but the items inside it are sorted
+	// by texture so that more of them can be drawn in a single batch.
+	void BeginGroup();
+	void EndGroup();
 	
-	
-private:
-	bool Cull(const Body &body, const Point &position, const Point &blur) const;
-	
-	void Push(const Body &body, Point pos, Point blur, double cloak, double clip, int swizzle);
+	// Draw all the items in this list. If the interpolation is less than 1,
+	// each item is drawn that fraction of the way from where it was in the
+	// previous step to where it is in this one. Motion blur is only drawn if
+	// it is allowed and the preference for it is set.
+	void Draw(double interpolation = 1., bool allowBlur = true) const;
 	
 	
 private:
-	class Item {
-	public:
-		// Get the color swizzle.
-		uint32_t Swizzle() const;
-		
-		float Clip() const;
-		float Fade() const;
-		
-		void Cloak(double cloak);
-		
-	public:
-		uint32_t tex0;
-		uint32_t tex1;
-		float position[2];
-		float transform[4];
-		float blur[2];
-		float clip;
-		uint32_t flags;
-	};
+	bool Cull(const Body &body, const Point &position, const Point &blur, const Point &unit) const;
+	
+	bool Push(const Body &body, Point pos, Point blur, double cloak, double clip, int swizzle);
 	
 	
 private:
 	int step = 0;
 	double zoom = 1.;
+	bool isShown = true;
 	bool isHighDPI = false;
-	std::vector<Item> items;
+	std::vector<SpriteShader::Item> items;
+	// Where in the list of items the current group began.
+	std::size_t groupStart = 0;
+	// The items that are drawn in less detail. They are sorted by texture the
+	// first time the list is drawn.
+	mutable std::vector<SpriteShader::Item> distant;
+	mutable bool isSorted = true;
 	
 	Point center;
 	Point centerVelocity;
@@ -0,0 +1,149 @@
+/* DynamicResolution.cpp
+Copyright (c) 2017 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "DynamicResolution.h"
+
+#include "gl_header.h"
+#include "Preferences.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+	// How long the GPU should take to draw the world, in milliseconds. This
+	// leaves room in a 60 Hz frame for the HUD, the panels, and the driver.
+	const double TARGET_TIME = 10.;
+	// Never draw the world at less than this fraction of the full resolution.
+	const double MIN_SCALE = .5;
+	// Change the scale by at most this much each frame, so that the change is
+	// not noticeable, and so that a single slow frame does not matter much.
+	const double MAX_STEP = .02;
+	
+	double scale = 1.;
+	
+	// The off-screen target, and the size of its texture.
+	GLuint framebuffer = 0;
+	GLuint texture = 0;
+	GLint textureWidth = 0;
+	GLint textureHeight = 0;
+	
+	// The viewport of the screen, while the world is being drawn off screen.
+	GLint viewport[4] = {0, 0, 0, 0};
+	bool isActive = false;
+	
+	// Update the scale based on how long the GPU took to draw the world in the
+	// most recent frame whose timer queries have been read back. Drawing time
+	// is roughly proportional to the number of pixels, i.e. to the square of
+	// the scale. If the driver does not support timer queries, the time is
+	// always zero, and the scale just stays at 1.
+	void UpdateScale()
+	{
+		double time = Profiler::Latest(Profiler::GPU_BACKGROUND) + Profiler::Latest(Profiler::GPU_SPRITES);
+		if(time <= 0.)
+			return;
+		
+		// Only react when the time is well outside the target, so the scale
+		// does not hunt back and forth from one frame to the next.
+		double ideal = scale * sqrt(TARGET_TIME / time);
+		if(time > TARGET_TIME)
+			scale = max(MIN_SCALE, max(ideal, scale - MAX_STEP));
+		else if(time < .8 * TARGET_TIME)
+			scale = min(1., min(ideal, scale + MAX_STEP));
+	}
+	
+	// Make sure the off-screen texture is at least the given size.
+	void Reserve(GLint width, GLint height)
+	{
+		if(!framebuffer)
+		{
+			glGenFramebuffers(1, &framebuffer);
+			glGenTextures(1, &texture);
+		}
+		if(width <= textureWidth && height <= textureHeight)
+			return;
+		
+		textureWidth = max(width, textureWidth);
+		textureHeight = max(height, textureHeight);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, textureWidth, textureHeight, 0,
+			GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+	
+	// Get the size of the world's part of the off-screen target.
+	GLint Scaled(GLint size)
+	{
+		return max<GLint>(1, static_cast<GLint>(size * scale + .5));
+	}
+}
+
+
+
+// Begin drawing the world. If dynamic resolution is off, this does nothing.
+void DynamicResolution::Begin()
+{
+	if(!Preferences::Has(Preferences::DYNAMIC_RESOLUTION))
+	{
+		scale = 1.;
+		return;
+	}
+	
+	UpdateScale();
+	if(scale >= 1.)
+		return;
+	
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLint width = Scaled(viewport[2]);
+	GLint height = Scaled(viewport[3]);
+	Reserve(width, height);
+	
+	// All the shaders map the screen to the viewport, so drawing into a
+	// smaller viewport just draws everything at a smaller scale.
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, width, height);
+	glClear(GL_COLOR_BUFFER_BIT);
+	isActive = true;
+}
+
+
+
+// Scale the world up onto the screen, and go back to drawing there.
+void DynamicResolution::End()
+{
+	if(!isActive)
+		return;
+	isActive = false;
+	
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glBlitFramebuffer(0, 0, Scaled(viewport[2]), Scaled(viewport[3]),
+		viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3],
+		GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+
+
+// Get the fraction of the full resolution that the world is drawn at.
+double DynamicResolution::Scale()
+{
+	return scale;
+}
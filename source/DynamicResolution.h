@@ -0,0 +1,37 @@
+/* DynamicResolution.h
+Copyright (c) 2017 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef DYNAMIC_RESOLUTION_H_
+#define DYNAMIC_RESOLUTION_H_
+
+
+
+// Class for drawing the world (the stars and everything in the DrawList) at a
+// lower resolution when the graphics card cannot keep up. If the "Dynamic
+// resolution" preference is set, the world is drawn into an off-screen texture
+// whose size is adjusted every frame based on how long the GPU took to draw
+// the world a few frames ago, and then scaled up to fill the screen. The HUD
+// and the user interface are still drawn at the full resolution.
+class DynamicResolution {
+public:
+	// Begin drawing the world. If dynamic resolution is off, this does nothing.
+	static void Begin();
+	// Scale the world up onto the screen, and go back to drawing there.
+	static void End();
+	
+	// Get the fraction of the full resolution that the world is drawn at.
+	static double Scale();
+};
+
+
+
+#endif
@@ -88,3 +88,11 @@ bool Effect::Move()
 	
 	return true;
 }
+
+
+
+// Get the number of steps this effect has left before it is deleted.
+int Effect::Lifetime() const
+{
+	return lifetime;
+}
@@ -46,6 +46,8 @@ public:
 	
 	// This returns false if it is time to delete this effect.
 	bool Move();
+	// Get the number of steps this effect has left before it is deleted.
+	int Lifetime() const;
 	
 	
 private:
@@ -13,8 +13,11 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Engine.h"
 
 #include "Audio.h"
+#include "CurrentThread.h"
+#include "DynamicResolution.h"
 #include "Effect.h"
 #include "FillShader.h"
+#include "Fleet.h"
 #include "Font.h"
 #include "FontSet.h"
 #include "Format.h"
@@ -32,7 +35,9 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Politics.h"
 #include "PointerShader.h"
 #include "Preferences.h"
+#include "Profiler.h"
 #include "Random.h"
+#include "Replay.h"
 #include "RingShader.h"
 #include "Screen.h"
 #include "Sprite.h"
@@ -40,13 +45,60 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "SpriteShader.h"
 #include "StarField.h"
 #include "System.h"
+#include "ThreadPool.h"
+
+#include <SDL2/SDL.h>
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <iterator>
+#include <set>
 
 using namespace std;
 
 namespace {
+	// The most effects that are kept at once. Room for this many is reserved
+	// up front, so in all but the most extreme battles adding an effect never
+	// allocates memory.
+	const size_t MAX_EFFECTS = 10000;
+	
+	// If the effects quality is set to adjust automatically, this is how much
+	// of the CPU the calculations, and how much of each frame the GPU, may use
+	// before the number of new effects is reduced, and how little they must use
+	// before it goes back up. The GPU times are in milliseconds.
+	const double HIGH_LOAD = .8;
+	const double LOW_LOAD = .6;
+	const double HIGH_GPU_TIME = 14.;
+	const double LOW_GPU_TIME = 10.;
+	// Never show fewer than this fraction of the new effects.
+	const double MIN_EFFECTS_QUALITY = .25;
+	// New effects that cannot come within this distance of the edge of the
+	// screen before they expire are dropped as soon as they are created. The
+	// margin allows for the view changing speed or zooming out meanwhile.
+	const double EFFECT_CULL_MARGIN = 500.;
+	
+	// Keys for the values shown in the HUD, looked up once instead of every frame.
+	const int PLAYER_SPRITE = Information::Key("player sprite");
+	const int LOCATION = Information::Key("location");
+	const int DATE = Information::Key("date");
+	const int FUEL = Information::Key("fuel");
+	const int ENERGY = Information::Key("energy");
+	const int HEAT = Information::Key("heat");
+	const int SHIELDS = Information::Key("shields");
+	const int HULL = Information::Key("hull");
+	const int CREDITS = Information::Key("credits");
+	const int NAVIGATION_MODE = Information::Key("navigation mode");
+	const int DESTINATION = Information::Key("destination");
+	const int TARGET_SPRITE = Information::Key("target sprite");
+	const int TARGET_NAME = Information::Key("target name");
+	const int TARGET_TYPE = Information::Key("target type");
+	const int TARGET_GOVERNMENT = Information::Key("target government");
+	const int TARGET_SHIELDS = Information::Key("target shields");
+	const int TARGET_HULL = Information::Key("target hull");
+	
 	int RadarType(const StellarObject &object, const Ship *flagship)
 	{
 		if(object.IsStar())
@@ -75,15 +127,50 @@ namespace {
 			return Radar::HOSTILE;
 		return Radar::UNFRIENDLY;
 	}
+	
+	// If this is set, a hash of the simulation's state is written to it after
+	// every step, along with the number of steps that have been logged.
+	FILE *stateLog = nullptr;
+	int64_t loggedSteps = 0;
+	
+	// Add the given values to a 64-bit FNV-1a hash.
+	void Hash(uint64_t &hash, const void *data, size_t size)
+	{
+		const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+		for(size_t i = 0; i < size; ++i)
+			hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+	}
+	
+	void Hash(uint64_t &hash, double value)
+	{
+		Hash(hash, &value, sizeof(value));
+	}
+	
+	void Hash(uint64_t &hash, const Point &point)
+	{
+		Hash(hash, point.X());
+		Hash(hash, point.Y());
+	}
+	
+	// Place five seconds worth of fleets. Check for undefined fleets by not
+	// trying to create anything with no government set.
+	void PlaceFleets(const System &system, list<shared_ptr<Ship>> &ships)
+	{
+		for(int i = 0; i < 5; ++i)
+			for(const System::FleetProbability &fleet : system.Fleets())
+				if(fleet.Get()->GetGovernment() && Random::Int(fleet.Period()) < 60)
+					fleet.Get()->Place(system, ships);
+	}
 }
 
 
 
 Engine::Engine(PlayerInfo &player)
 	: player(player), ai(ships, asteroids.Minables(), flotsam),
-	shipCollisions(256, 32), cloakedCollisions(256, 32)
+	shipCollisions(256, 32), cloakedCollisions(256, 32), antiMissileCollisions(256, 32)
 {
 	zoom = Preferences::ViewZoom();
+	effects.reserve(MAX_EFFECTS);
 	
 	// Start the thread for doing calculations.
 	calcThread = thread(&Engine::ThreadEntryPoint, this);
@@ -104,6 +191,7 @@ Engine::Engine(PlayerInfo &player)
 	// Now we know the player's current position. Draw the planets.
 	draw[calcTickTock].Clear(step, zoom);
 	draw[calcTickTock].SetCenter(center);
+	radar[calcTickTock].Clear();
 	radar[calcTickTock].SetCenter(center);
 	const Ship *flagship = player.Flagship();
 	for(const StellarObject &object : player.GetSystem()->Objects())
@@ -137,12 +225,31 @@ Engine::~Engine()
 	}
 	condition.notify_all();
 	calcThread.join();
+	FinishArrival();
 }
 
 
 
 void Engine::Place()
 {
+	// A replay must begin from the same state whether it is being recorded or
+	// played back, no matter what happened in earlier flights.
+	if(Replay::IsBeginning())
+	{
+		step = Replay::FirstStep(step);
+		ai.Reset();
+		grudgeTime = 0;
+		alarmTime = 0;
+		jumpCount = 0;
+		flash = 0.;
+		doFlash = false;
+		hadHostiles = false;
+		wasActive = false;
+		doClickNextStep = false;
+		groupSelect = -1;
+		seedCalculation = true;
+		calculationSeed = Replay::CalculationSeed();
+	}
 	ships.clear();
 	
 	EnterSystem();
@@ -266,12 +373,27 @@ void Engine::Place()
 void Engine::Wait()
 {
 	unique_lock<mutex> lock(swapMutex);
+	if(calcTickTock == drawTickTock)
+		return;
+	
+	// Keep track of how long the calling thread is stalled.
+	Profiler::Scope scope(Profiler::ENGINE_WAIT);
 	while(calcTickTock != drawTickTock)
 		condition.wait(lock);
 }
 
 
 
+// Check whether the previous calculations are done, i.e. whether Wait() would
+// return right away.
+bool Engine::IsReady()
+{
+	unique_lock<mutex> lock(swapMutex);
+	return (calcTickTock == drawTickTock);
+}
+
+
+
 // Begin the next step of calculations.
 void Engine::Step(bool isActive)
 {
@@ -310,16 +432,65 @@ void Engine::Step(bool isActive)
 		}
 		else if(jumpCount > 0)
 			--jumpCount;
+		
+		// As soon as a jump target is chosen, start loading what will be
+		// needed there, rather than waiting until the jump is over.
+		const System *target = flagship->GetTargetSystem();
+		if(target && target != preloadedSystem)
+		{
+			preloadedSystem = target;
+			PreloadSystem(*target);
+		}
 	}
 	ai.UpdateEvents(events);
-	ai.UpdateKeys(player, clickCommands, isActive && wasActive);
+	
+	// Gather everything the player did since the last step. If a replay is
+	// being recorded, this is saved; if one is being played back, the recorded
+	// input is used instead (and there may not even be a keyboard to read).
+	Replay::Input input;
+	if(!Replay::IsPlaying())
+	{
+		input.keys.ReadKeyboard();
+		input.shift = (SDL_GetModState() & KMOD_SHIFT);
+	}
+	input.isActive = isActive;
+	input.zoom = zoom;
+	input.zoomTarget = Preferences::ViewZoom();
+	input.hasClick = doClickNextStep;
+	input.isRightClick = isRightClick;
+	input.clickShift = hasShift;
+	input.clickPoint = clickPoint;
+	input.clickBox = clickBox;
+	input.group = groupSelect;
+	input.groupShift = hasShift;
+	input.groupControl = hasControl;
+	seedCalculation = (Replay::IsRecording() || Replay::IsPlaying());
+	if(seedCalculation)
+	{
+		Replay::Step(input);
+		calculationSeed = Replay::CalculationSeed();
+		isActive = input.isActive;
+		zoom = input.zoom;
+		doClickNextStep = input.hasClick;
+		isRightClick = input.isRightClick;
+		clickPoint = input.clickPoint;
+		clickBox = input.clickBox;
+		groupSelect = input.group;
+		hasShift = (input.hasClick ? input.clickShift : input.groupShift);
+		hasControl = input.groupControl;
+	}
+	ai.UpdateKeys(player, clickCommands, input.keys, input.shift, isActive && wasActive);
+	inputTime = chrono::steady_clock::now();
+	// Recorded and replayed input must be exactly what the step used, so the
+	// keyboard is only read late when no replay is involved.
+	lateInput = (Preferences::Has(Preferences::LATE_INPUT) && isActive && wasActive && !seedCalculation);
 	wasActive = isActive;
 	Audio::Update(center);
 	
 	// Smoothly zoom in and out.
 	if(isActive)
 	{
-		double zoomTarget = Preferences::ViewZoom();
+		double zoomTarget = input.zoomTarget;
 		if(zoom < zoomTarget)
 			zoom = min(zoomTarget, zoom * 1.01);
 		else if(zoom > zoomTarget)
@@ -327,7 +498,7 @@ void Engine::Step(bool isActive)
 	}
 		
 	// Draw a highlight to distinguish the flagship from other ships.
-	if(flagship && !flagship->IsDestroyed() && Preferences::Has("Highlight player's flagship"))
+	if(flagship && !flagship->IsDestroyed() && Preferences::Has(Preferences::HIGHLIGHT_PLAYERS_FLAGSHIP))
 	{
 		highlightSprite = flagship->GetSprite();
 		highlightUnit = flagship->Unit() * zoom;
@@ -384,30 +555,28 @@ void Engine::Step(bool isActive)
 	// are not owned by the player.
 	escorts.Clear();
 	bool fleetIsJumping = (flagship && flagship->Commands().Has(Command::JUMP));
+	const Ship *flagshipTarget = flagship ? flagship->GetTargetShip().get() : nullptr;
 	for(const auto &it : ships)
 		if(it->GetGovernment()->IsPlayer() || it->GetPersonality().IsEscort())
 			if(!it->IsYours() && !it->CanBeCarried())
 			{
-				bool isSelected = (flagship && flagship->GetTargetShip() == it);
+				bool isSelected = (it.get() == flagshipTarget);
 				escorts.Add(*it, it->GetSystem() == currentSystem, fleetIsJumping, isSelected);
 			}
+	// Look up the selected ships once, instead of once for each escort.
+	set<const Ship *> selected;
+	for(const weak_ptr<Ship> &ptr : player.SelectedShips())
+		selected.insert(ptr.lock().get());
 	for(const shared_ptr<Ship> &escort : player.Ships())
 		if(!escort->IsParked() && escort != flagship && !escort->IsDestroyed())
 		{
-			// Check if this escort is selected.
-			bool isSelected = false;
-			for(const weak_ptr<Ship> &ptr : player.SelectedShips())
-				if(ptr.lock() == escort)
-				{
-					isSelected = true;
-					break;
-				}
+			bool isSelected = selected.count(escort.get());
 			escorts.Add(*escort, escort->GetSystem() == currentSystem, fleetIsJumping, isSelected);
 		}
 	
 	// Create the status overlays.
 	statuses.clear();
-	if(isActive && Preferences::Has("Show status overlays"))
+	if(isActive && Preferences::Has(Preferences::SHOW_STATUS_OVERLAYS))
 		for(const auto &it : ships)
 		{
 			if(!it->GetGovernment() || it->GetSystem() != currentSystem || it->Cloaking() == 1.)
@@ -427,7 +596,7 @@ void Engine::Step(bool isActive)
 	
 	// Create the planet labels.
 	labels.clear();
-	if(currentSystem && Preferences::Has("Show planet labels"))
+	if(currentSystem && Preferences::Has(Preferences::SHOW_PLANET_LABELS))
 	{
 		for(const StellarObject &object : currentSystem->Objects())
 		{
@@ -447,42 +616,57 @@ void Engine::Step(bool isActive)
 	{
 		int frame = flagship->GetFrameIndex(step);
 		Point shipFacingUnit(0., -1.);
-		if(Preferences::Has("Rotate flagship in HUD"))
+		if(Preferences::Has(Preferences::ROTATE_FLAGSHIP_IN_HUD))
 			shipFacingUnit = flagship->Facing().Unit();
 		
-		info.SetSprite("player sprite", flagship->GetSprite(), shipFacingUnit, frame);
+		info.SetSprite(PLAYER_SPRITE, flagship->GetSprite(), shipFacingUnit, frame);
 	}
 	else
-		info.SetSprite("player sprite", nullptr);
+		info.SetSprite(PLAYER_SPRITE, nullptr);
 	if(currentSystem)
-		info.SetString("location", currentSystem->Name());
-	info.SetString("date", player.GetDate().ToString());
+		info.SetString(LOCATION, currentSystem->Name());
+	info.SetString(DATE, player.GetDate().ToString());
 	if(flagship)
 	{
-		info.SetBar("fuel", flagship->Fuel(),
+		info.SetBar(FUEL, flagship->Fuel(),
 			flagship->Attributes().Get("fuel capacity") * .01);
-		info.SetBar("energy", flagship->Energy());
-		info.SetBar("heat", flagship->Heat());
-		info.SetBar("shields", flagship->Shields());
-		info.SetBar("hull", flagship->Hull(), 20.);
+		info.SetBar(ENERGY, flagship->Energy());
+		info.SetBar(HEAT, flagship->Heat());
+		info.SetBar(SHIELDS, flagship->Shields());
+		info.SetBar(HULL, flagship->Hull(), 20.);
 	}
 	else
 	{
-		info.SetBar("fuel", 0.);
-		info.SetBar("energy", 0.);
-		info.SetBar("heat", 0.);
-		info.SetBar("shields", 0.);
-		info.SetBar("hull", 0.);
+		info.SetBar(FUEL, 0.);
+		info.SetBar(ENERGY, 0.);
+		info.SetBar(HEAT, 0.);
+		info.SetBar(SHIELDS, 0.);
+		info.SetBar(HULL, 0.);
+	}
+	// The credits rarely change, so only format them again when they do.
+	int64_t credits = player.Accounts().Credits();
+	if(creditsString.empty() || credits != shownCredits)
+	{
+		shownCredits = credits;
+		Format::Number(credits, creditsString);
+		creditsString += " credits";
+		info.SetString(CREDITS, creditsString);
 	}
-	info.SetString("credits",
-		Format::Number(player.Accounts().Credits()) + " credits");
 	bool isJumping = flagship && (flagship->Commands().Has(Command::JUMP) || flagship->IsEnteringHyperspace());
 	if(flagship && flagship->GetTargetStellar() && !isJumping)
 	{
 		const StellarObject *object = flagship->GetTargetStellar();
-		info.SetString("navigation mode", "Landing on:");
+		// The landscapes of this system were loaded on arriving here, but some
+		// may have been unloaded since then. Make sure the one for the planet
+		// the flagship is landing on is there by the time it lands.
+		if(object->GetPlanet() != preloadedPlanet)
+		{
+			preloadedPlanet = object->GetPlanet();
+			GameData::Preload(preloadedPlanet->Landscape());
+		}
+		info.SetString(NAVIGATION_MODE, "Landing on:");
 		const string &name = object->Name();
-		info.SetString("destination", name);
+		info.SetString(DESTINATION, name);
 		
 		targets.push_back({
 			object->Position() - center,
@@ -492,16 +676,16 @@ void Engine::Step(bool isActive)
 	}
 	else if(flagship && flagship->GetTargetSystem())
 	{
-		info.SetString("navigation mode", "Hyperspace:");
+		info.SetString(NAVIGATION_MODE, "Hyperspace:");
 		if(player.HasVisited(flagship->GetTargetSystem()))
-			info.SetString("destination", flagship->GetTargetSystem()->Name());
+			info.SetString(DESTINATION, flagship->GetTargetSystem()->Name());
 		else
-			info.SetString("destination", "unexplored system");
+			info.SetString(DESTINATION, "unexplored system");
 	}
 	else
 	{
-		info.SetString("navigation mode", "Navigation:");
-		info.SetString("destination", "no destination");
+		info.SetString(NAVIGATION_MODE, "Navigation:");
+		info.SetString(DESTINATION, "no destination");
 	}
 	// Use the radar that was just populated. (The draw tick-tock has not
 	// yet been toggled, but it will be at the end of this function.)
@@ -511,31 +695,31 @@ void Engine::Step(bool isActive)
 		target = flagship->GetTargetShip();
 	if(!target)
 	{
-		info.SetSprite("target sprite", nullptr);
-		info.SetString("target name", "no target");
-		info.SetString("target type", "");
-		info.SetString("target government", "");
-		info.SetBar("target shields", 0.);
-		info.SetBar("target hull", 0.);
+		info.SetSprite(TARGET_SPRITE, nullptr);
+		info.SetString(TARGET_NAME, "no target");
+		info.SetString(TARGET_TYPE, "");
+		info.SetString(TARGET_GOVERNMENT, "");
+		info.SetBar(TARGET_SHIELDS, 0.);
+		info.SetBar(TARGET_HULL, 0.);
 	}
 	else
 	{
 		if(target->GetSystem() == player.GetSystem() && target->Cloaking() < 1.)
 			targetUnit = target->Facing().Unit();
-		info.SetSprite("target sprite", target->GetSprite(), targetUnit, target->GetFrameIndex(step));
-		info.SetString("target name", target->Name());
-		info.SetString("target type", target->ModelName());
+		info.SetSprite(TARGET_SPRITE, target->GetSprite(), targetUnit, target->GetFrameIndex(step));
+		info.SetString(TARGET_NAME, target->Name());
+		info.SetString(TARGET_TYPE, target->ModelName());
 		if(!target->GetGovernment())
-			info.SetString("target government", "No Government");
+			info.SetString(TARGET_GOVERNMENT, "No Government");
 		else
-			info.SetString("target government", target->GetGovernment()->GetName());
+			info.SetString(TARGET_GOVERNMENT, target->GetGovernment()->GetName());
 		
 		int targetType = RadarType(*target, step);
 		info.SetOutlineColor(Radar::GetColor(targetType));
 		if(target->GetSystem() == player.GetSystem() && target->IsTargetable())
 		{
-			info.SetBar("target shields", target->Shields());
-			info.SetBar("target hull", target->Hull(), 20.);
+			info.SetBar(TARGET_SHIELDS, target->Shields());
+			info.SetBar(TARGET_HULL, target->Hull(), 20.);
 		
 			// The target area will be a square, with sides proportional to the average
 			// of the width and the height of the sprite.
@@ -556,8 +740,8 @@ void Engine::Step(bool isActive)
 		}
 		else
 		{
-			info.SetBar("target shields", 0.);
-			info.SetBar("target hull", 0.);
+			info.SetBar(TARGET_SHIELDS, 0.);
+			info.SetBar(TARGET_HULL, 0.);
 		}
 	}
 	if(target && !target->IsDestroyed() && target->GetSystem() == currentSystem 
@@ -616,24 +800,30 @@ void Engine::Step(bool isActive)
 				Radar::PLAYER});
 		}
 	}
+	
+	RecordHUD();
+	UpdateEffectsQuality();
 }
 
 
 
-// Begin the next step of calculations.
-void Engine::Go()
+// Begin the next step of calculations. If its results will never be shown,
+// the lists of things to draw are not filled in.
+void Engine::Go(bool isShown)
 {
 	{
 		unique_lock<mutex> lock(swapMutex);
 		++step;
 		drawTickTock = !drawTickTock;
+		isCalcShown = isShown;
 	}
 	condition.notify_all();
+	Replay::Go();
 }
 
 
 
-const list<ShipEvent> &Engine::Events() const
+const vector<ShipEvent> &Engine::Events() const
 {
 	return events;
 }
@@ -641,40 +831,39 @@ const list<ShipEvent> &Engine::Events() const
 
 
 // Draw a frame.
-void Engine::Draw() const
+void Engine::Draw(double interpolation) const
 {
-	GameData::Background().Draw(center, centerVelocity, zoom);
+	Profiler::Scope scope(Profiler::DRAW_ENGINE);
+	Profiler::GPUScope gpuScope(Profiler::GPU_BACKGROUND);
+	// Measure how old the input behind what is being drawn is.
+	if(drawInputTime[drawTickTock] != chrono::steady_clock::time_point())
+		Profiler::Add(Profiler::INPUT_LATENCY, chrono::steady_clock::now() - drawInputTime[drawTickTock]);
+	// If the graphics card is falling behind, draw the world at a lower
+	// resolution and then scale it up to fill the screen.
+	DynamicResolution::Begin();
+	
+	// Move the view back along with everything in it, so that the stars scroll
+	// as smoothly as the ships move.
+	GameData::Background().Draw(center - (1. - interpolation) * centerVelocity, centerVelocity, zoom);
 	
 	// Draw any active planet labels.
+	gpuScope.Next(Profiler::GPU_HUD);
 	for(const PlanetLabel &label : labels)
 		label.Draw();
 	
-	draw[drawTickTock].Draw();
+	gpuScope.Next(Profiler::GPU_SPRITES);
+	// Motion blur is the first thing to go when the game is falling behind.
+	draw[drawTickTock].Draw(interpolation, effectsQuality >= 1.);
+	DynamicResolution::End();
 	
-	for(const auto &it : statuses)
-	{
-		static const Color color[6] = {
-			Color(0., .5, 0., .25),
-			Color(.5, .15, 0., .25),
-			Color(.5, .5, .5, .25),
-			Color(.45, .5, 0., .25),
-			Color(.5, .3, 0., .25),
-			Color(.7, .7, .7, .25)
-		};
-		Point pos = it.position * zoom;
-		double radius = it.radius * zoom;
-		if(it.outer > 0.)
-			RingShader::Draw(pos, radius + 3., 1.5, it.outer, color[it.type], 0., it.angle);
-		double dashes = (it.type >= 2) ? 0. : 20. * min(1., zoom);
-		if(it.inner > 0.)
-			RingShader::Draw(pos, radius, 1.5, it.inner, color[3 + it.type], dashes, it.angle);
-	}
+	gpuScope.Next(Profiler::GPU_HUD);
+	RingShader::Draw(statusRings);
 	
 	// Draw the flagship highlight, if any.
 	if(highlightSprite)
 	{
 		Point size(highlightSprite->Width(), highlightSprite->Height());
-		const Color &color = *GameData::Colors().Get("flagship highlight");
+		static const Color &color = *GameData::Colors().Get("flagship highlight");
 		// The flagship is always in the dead center of the screen.
 		OutlineShader::Draw(highlightSprite, Point(), size, color, highlightUnit, highlightFrame);
 	}
@@ -705,18 +894,7 @@ void Engine::Draw() const
 	}
 	
 	// Draw crosshairs around anything that is targeted.
-	for(const Target &target : targets)
-	{
-		Angle a = target.angle;
-		Angle da(90.);
-		
-		for(int i = 0; i < 4; ++i)
-		{
-			PointerShader::Draw(target.center * zoom, a.Unit(), 12., 14., -target.radius * zoom,
-				Radar::GetColor(target.type));
-			a += da;
-		}
-	}
+	PointerShader::Draw(targetPointers);
 	
 	const Interface *interfaces[2] = {
 		GameData::Interfaces().Get("status"),
@@ -740,15 +918,15 @@ void Engine::Draw() const
 			PointerShader::Draw(center, targetAngle, 10., 10., radius, Color(1.));
 		}
 	}
-	if(jumpCount && Preferences::Has("Show mini-map"))
+	if(jumpCount && Preferences::Has(Preferences::SHOW_MINI_MAP))
 		MapPanel::DrawMiniMap(player, .5 * min(1., jumpCount / 30.), jumpInProgress, step);
 	
 	// Draw ammo status.
 	Point pos(Screen::Right() - 80, Screen::Bottom());
 	const Sprite *selectedSprite = SpriteSet::Get("ui/ammo selected");
 	const Sprite *unselectedSprite = SpriteSet::Get("ui/ammo unselected");
-	Color selectedColor = *GameData::Colors().Get("bright");
-	Color unselectedColor = *GameData::Colors().Get("dim");
+	static const Color &selectedColor = *GameData::Colors().Get("bright");
+	static const Color &unselectedColor = *GameData::Colors().Get("dim");
 	for(const pair<const Outfit *, int> &it : ammo)
 	{
 		pos.Y() -= 30.;
@@ -776,10 +954,12 @@ void Engine::Draw() const
 	// filling the entire backlog of sprites before landing on a planet.
 	GameData::Progress();
 	
-	if(Preferences::Has("Show CPU / GPU load"))
+	if(Preferences::Has(Preferences::SHOW_CPU_GPU_LOAD))
 	{
 		string loadString = to_string(static_cast<int>(load * 100. + .5)) + "% CPU";
-		Color color = *GameData::Colors().Get("medium");
+		if(DynamicResolution::Scale() < 1.)
+			loadString += ", " + to_string(static_cast<int>(DynamicResolution::Scale() * 100. + .5)) + "% resolution";
+		static const Color &color = *GameData::Colors().Get("medium");
 		font.Draw(loadString,
 			Point(-10 - font.Width(loadString), Screen::Height() * -.5 + 5.), color);
 	}
@@ -819,11 +999,168 @@ void Engine::SelectGroup(int group, bool hasShift, bool hasControl)
 
 
 
+// Place the given fleets in the player's system, then run the given number
+// of steps in this thread without drawing anything. If more than one run is
+// asked for, each one starts over from a snapshot of the world as it was
+// right after the fleets were placed.
+int Engine::Simulate(const vector<const Fleet *> &fleets, int steps, int runs)
+{
+	if(!SetUpSimulation(fleets))
+		return 0;
+	
+	Snapshot start;
+	if(runs > 1)
+		TakeSnapshot(start);
+	for(int run = 0; run < runs; ++run)
+	{
+		if(run)
+			Restore(start);
+		for(int i = 0; i < steps; ++i)
+		{
+			CalculateStep();
+			// Do the part of Step() that affects what the ships do next.
+			events.swap(eventQueue);
+			eventQueue.clear();
+			ai.UpdateEvents(events);
+			Profiler::EndFrame();
+		}
+	}
+	return ships.size();
+}
+
+
+
+// Save the state of the world, or put it back the way it was when the
+// given snapshot was taken, e.g. to run the same benchmark several times
+// or to jump back to an earlier point in a replay. This must only be done
+// while the calculation thread is paused (i.e. after Wait()).
+void Engine::TakeSnapshot(Snapshot &snapshot) const
+{
+	snapshot.step = step;
+	snapshot.ships = ships;
+	snapshot.shipStates.clear();
+	snapshot.carried.clear();
+	// Ships in the bays are not in the list of ships, and a copy of a ship
+	// does not include the ships it is carrying, so save those separately.
+	vector<shared_ptr<Ship>> toSave(ships.begin(), ships.end());
+	for(unsigned i = 0; i < toSave.size(); ++i)
+	{
+		const shared_ptr<Ship> &ship = toSave[i];
+		snapshot.shipStates.emplace_back(ship, *ship);
+		snapshot.carried.emplace_back();
+		for(const Ship::Bay &bay : ship->Bays())
+		{
+			snapshot.carried.back().push_back(bay.ship);
+			if(bay.ship)
+				toSave.push_back(bay.ship);
+		}
+	}
+	
+	snapshot.projectiles = projectiles;
+	snapshot.flotsam.clear();
+	for(const shared_ptr<Flotsam> &it : flotsam)
+		snapshot.flotsam.emplace_back(it, *it);
+	snapshot.effects = effects;
+	snapshot.asteroids = asteroids;
+	snapshot.minables.clear();
+	for(const shared_ptr<Minable> &it : asteroids.Minables())
+		snapshot.minables.emplace_back(it, *it);
+	snapshot.grudge = grudge;
+	snapshot.grudgeTime = grudgeTime;
+	snapshot.random = Random::State();
+}
+
+
+
+void Engine::Restore(const Snapshot &snapshot)
+{
+	step = snapshot.step;
+	ships = snapshot.ships;
+	for(unsigned i = 0; i < snapshot.shipStates.size(); ++i)
+	{
+		Ship &ship = *snapshot.shipStates[i].first;
+		ship = snapshot.shipStates[i].second;
+		ship.RestoreBays(snapshot.carried[i]);
+	}
+	
+	projectiles = snapshot.projectiles;
+	flotsam.clear();
+	for(const auto &it : snapshot.flotsam)
+	{
+		*it.first = it.second;
+		flotsam.push_back(it.first);
+	}
+	effects = snapshot.effects;
+	asteroids = snapshot.asteroids;
+	for(const auto &it : snapshot.minables)
+		*it.first = it.second;
+	grudge = snapshot.grudge;
+	grudgeTime = snapshot.grudgeTime;
+	Random::SetState(snapshot.random);
+	
+	// Nothing that happened after the snapshot was taken should be reported,
+	// and the AI should not remember it either.
+	eventQueue.clear();
+	events.clear();
+	ai.Clean();
+}
+
+
+
+// Place the given fleets in the player's system, then let them fight in
+// this thread until at most one government has any ships left that can
+// still fight, or until the given number of steps have passed. This returns
+// the government that won, or null if neither side did, and sets the
+// number of steps that the battle took. Seed the random number generator
+// first; each battle only uses the generator of the thread it runs in.
+const Government *Engine::Battle(const vector<const Fleet *> &fleets, int maxSteps, int &steps)
+{
+	steps = 0;
+	if(!SetUpSimulation(fleets))
+		return nullptr;
+	
+	// Nothing in a battle is ever drawn, so skip filling in the draw lists.
+	isCalcShown = false;
+	const System *system = player.GetSystem();
+	while(steps < maxSteps)
+	{
+		CalculateStep();
+		events.swap(eventQueue);
+		eventQueue.clear();
+		ai.UpdateEvents(events);
+		++steps;
+		
+		// Ships that are disabled or that have left the system are out of the
+		// fight. The battle is over once only one government is left in it.
+		const Government *winner = nullptr;
+		bool isOver = true;
+		for(const shared_ptr<Ship> &ship : ships)
+			if(ship->GetSystem() == system && !ship->IsDestroyed() && !ship->IsDisabled())
+			{
+				if(winner && winner != ship->GetGovernment())
+				{
+					isOver = false;
+					break;
+				}
+				winner = ship->GetGovernment();
+			}
+		if(isOver)
+			return winner;
+	}
+	return nullptr;
+}
+
+
+
 void Engine::EnterSystem()
 {
 	ai.Clean();
 	grudge.clear();
 	
+	// The fleets that were being created in the background read the state of
+	// the system, so they must be done before anything here can change it.
+	FinishArrival();
+	
 	const Ship *flagship = player.Flagship();
 	if(!flagship)
 		return;
@@ -864,12 +1201,13 @@ void Engine::EnterSystem()
 			asteroids.Add(a.Name(), a.Count(), a.Energy());
 	}
 	
-	// Place five seconds worth of fleets. Check for undefined fleets by not
-	// trying to create anything with no government set.
-	for(int i = 0; i < 5; ++i)
-		for(const System::FleetProbability &fleet : system->Fleets())
-			if(fleet.Get()->GetGovernment() && Random::Int(fleet.Period()) < 60)
-				fleet.Get()->Place(*system, ships);
+	// If the flagship arrived where it was expected to, the fleets were already
+	// created during the jump. Otherwise, create them now.
+	if(arrival && arrival->system == system)
+		ships.splice(ships.begin(), arrival->ships);
+	else
+		PlaceFleets(*system, ships);
+	arrival.reset();
 	
 	const Fleet *raidFleet = system->GetGovernment()->RaidFleet();
 	if(raidFleet && raidFleet->GetGovernment())
@@ -915,8 +1253,163 @@ void Engine::EnterSystem()
 
 
 // Thread entry point.
+// Begin loading the sprites that will be needed on arriving in the given
+// system, so that they can be loaded while the jump is in progress.
+void Engine::PreloadSystem(const System &system)
+{
+	for(const StellarObject &object : system.Objects())
+		GameData::Preload(object.GetSprite());
+	
+	for(const System::Asteroid &a : system.Asteroids())
+	{
+		if(a.Type())
+			GameData::Preload(a.Type()->GetSprite());
+		else
+			GameData::Preload(SpriteSet::Get("asteroid/" + a.Name() + "/spin"));
+	}
+	
+	for(const System::FleetProbability &fleet : system.Fleets())
+		for(const Ship *ship : fleet.Get()->ShipModels())
+			GameData::Preload(ship->GetSprite());
+}
+
+
+
+// Start creating the fleets that will be in the given system when the
+// flagship arrives there, in a background thread.
+void Engine::PrepareArrival(const System *system)
+{
+	FinishArrival();
+	arrival = make_shared<Arrival>();
+	arrival->system = system;
+	
+	// The random numbers must still be the same every time a replay is run, so
+	// the background thread draws from a stream seeded from the main one.
+	uint64_t seed = Random::NewSeed();
+	shared_ptr<Arrival> state = arrival;
+	ThreadPool::Shared().Submit([state, seed]()
+	{
+		Random::Seed(seed, 0);
+		PlaceFleets(*state->system, state->ships);
+		
+		unique_lock<mutex> lock(state->mutex);
+		state->isDone = true;
+		state->condition.notify_all();
+	});
+}
+
+
+
+// Wait for the background thread to finish creating those fleets.
+void Engine::FinishArrival()
+{
+	if(!arrival)
+		return;
+	
+	unique_lock<mutex> lock(arrival->mutex);
+	while(!arrival->isDone)
+		arrival->condition.wait(lock);
+}
+
+
+
+// After every step, write a hash of the state of every ship, of all the
+// projectiles and flotsam, and of the random number generator to the given
+// file. Comparing two of these logs shows the first step where two runs
+// that should be identical (e.g. a replay and the original flight) differ.
+void Engine::WriteStateLog(const string &path)
+{
+	if(stateLog)
+		fclose(stateLog);
+	stateLog = fopen(path.c_str(), "w");
+	loggedSteps = 0;
+	if(!stateLog)
+		cerr << "Unable to write to \"" << path << "\"." << endl;
+}
+
+
+
+// Clear out the player's system and place the given fleets in it, for a
+// simulation. This returns false if the player is not in any system.
+bool Engine::SetUpSimulation(const vector<const Fleet *> &fleets)
+{
+	// The calculation thread must not be running at the same time.
+	Wait();
+	const System *system = player.GetSystem();
+	if(!system)
+		return false;
+	
+	ships.clear();
+	projectiles.clear();
+	effects.clear();
+	flotsam.clear();
+	asteroids.Clear();
+	for(const System::Asteroid &a : system->Asteroids())
+	{
+		if(a.Type())
+			asteroids.Add(a.Type(), a.Count(), a.Energy(), system->AsteroidBelt());
+		else
+			asteroids.Add(a.Name(), a.Count(), a.Energy());
+	}
+	for(const Fleet *fleet : fleets)
+		if(fleet->GetGovernment())
+			fleet->Place(*system, ships);
+	
+	return true;
+}
+
+
+
+// Write one line for each ship, one for everything else, and then a line
+// with the hash of the whole step. The ships are listed in the order they are
+// moved in, so a difference in that order also shows up.
+void Engine::LogState() const
+{
+	const uint64_t FNV_OFFSET = 0xCBF29CE484222325ull;
+	uint64_t total = FNV_OFFSET;
+	int index = 0;
+	for(const shared_ptr<Ship> &ship : ships)
+	{
+		uint64_t hash = FNV_OFFSET;
+		Hash(hash, ship->Position());
+		Hash(hash, ship->Velocity());
+		Hash(hash, ship->Facing().Degrees());
+		Hash(hash, ship->Shields());
+		Hash(hash, ship->Hull());
+		Hash(hash, ship->Energy());
+		Hash(hash, ship->Heat());
+		Hash(hash, ship->Fuel());
+		fprintf(stateLog, "%lld ship %d %016llx %s\n", static_cast<long long>(loggedSteps), index++,
+			static_cast<unsigned long long>(hash), ship->ModelName().c_str());
+		Hash(total, &hash, sizeof(hash));
+	}
+	
+	uint64_t hash = FNV_OFFSET;
+	for(const Projectile &projectile : projectiles)
+	{
+		Hash(hash, projectile.Position());
+		Hash(hash, projectile.Velocity());
+	}
+	for(const shared_ptr<Flotsam> &it : flotsam)
+		Hash(hash, it->Position());
+	uint64_t random = Random::Peek();
+	Hash(hash, &random, sizeof(random));
+	fprintf(stateLog, "%lld other %016llx %d projectiles, %d flotsam\n", static_cast<long long>(loggedSteps),
+		static_cast<unsigned long long>(hash), static_cast<int>(projectiles.size()), static_cast<int>(flotsam.size()));
+	Hash(total, &hash, sizeof(hash));
+	
+	fprintf(stateLog, "%lld step %016llx\n", static_cast<long long>(loggedSteps), static_cast<unsigned long long>(total));
+	++loggedSteps;
+}
+
+
+
 void Engine::ThreadEntryPoint()
 {
+	// Every frame waits for this thread, so it should not have to wait for
+	// anything else to be scheduled.
+	CurrentThread::SetName("es-engine");
+	CurrentThread::RaisePriority();
 	while(true)
 	{
 		{
@@ -944,15 +1437,34 @@ void Engine::ThreadEntryPoint()
 void Engine::CalculateStep()
 {
 	FrameTimer loadTimer;
-	
-	// Clear the list of objects to draw.
-	draw[calcTickTock].Clear(step, zoom);
-	radar[calcTickTock].Clear();
+	Profiler::Scope stepScope(Profiler::CALCULATE);
+	if(seedCalculation)
+		Random::Seed(calculationSeed);
+	
+	// Clear the list of objects to draw. During fast-forward, most steps are
+	// never drawn, so there is no need to fill in the lists for them.
+	draw[calcTickTock].Clear(step, zoom, isCalcShown);
+	radar[calcTickTock].Clear(isCalcShown);
+	// If asked to, read the keyboard again right before the ships decide what
+	// to do, instead of using what was read when the main thread last stepped.
+	// SDL only updates the keyboard state while handling events in the main
+	// thread, so at worst this reads a state from partway through that.
+	if(lateInput)
+	{
+		Command keys;
+		keys.ReadKeyboard();
+		ai.LatchKeys(keys);
+		inputTime = chrono::steady_clock::now();
+	}
+	drawInputTime[calcTickTock] = inputTime;
+	// Any effects after these ones are created during this step.
+	size_t oldEffects = effects.size();
 	
 	if(!player.GetSystem())
 		return;
 	
 	// Now, all the ships must decide what they are doing next.
+	Profiler::Scope scope(Profiler::AI_STEP);
 	ai.Step(player);
 	const Ship *flagship = player.Flagship();
 	bool wasHyperspacing = (flagship && flagship->IsEnteringHyperspace());
@@ -961,14 +1473,23 @@ void Engine::CalculateStep()
 	// them fire, or their turrets will be targeting where a given ship was
 	// instead of where it is now. This is also where ships get deleted, and
 	// where they may create explosions if they are dying.
-	for(auto it = ships.begin(); it != ships.end(); )
-	{
-		bool isJump = (*it)->IsUsingJumpDrive();
-		bool wasHere = (flagship && (*it)->GetSystem() == flagship->GetSystem());
-		bool wasHyperspacing = (*it)->IsHyperspacing();
-		// Give the ship the list of effects so that it can draw explosions,
-		// ion sparks, jump drive flashes, etc.
-		if(!(*it)->Move(effects, flotsam))
+	scope.Next(Profiler::SHIP_MOVE);
+	const System *flagshipSystem = flagship ? flagship->GetSystem() : nullptr;
+	moving.clear();
+	for(const shared_ptr<Ship> &ship : ships)
+	{
+		ship->PrepareToMove();
+		moving.push_back({ship.get(), ship->IsUsingJumpDrive(),
+			flagship && ship->GetSystem() == flagshipSystem, ship->IsHyperspacing(), true});
+	}
+	MoveShips();
+	
+	// Anything that involves more than one ship must be done one ship at a
+	// time, once they have all moved.
+	auto mit = moving.begin();
+	for(auto it = ships.begin(); it != ships.end(); ++mit)
+	{
+		if(!mit->isAlive)
 		{
 			// If Move() returns false, it means the ship should be removed from
 			// play. That may be because it was destroyed, because it is an
@@ -981,20 +1502,22 @@ void Engine::CalculateStep()
 		}
 		else
 		{
+			(*it)->MoveRelative();
+			
 			// Check if we need to play sounds for a ship jumping in or out of
 			// the system. Make no sound if it entered via wormhole.
 			if(&**it != flagship && (*it)->Zoom() == 1.)
 			{
 				// Did this ship just begin hyperspacing?
-				if(wasHere && !wasHyperspacing && (*it)->IsHyperspacing())
+				if(mit->wasHere && !mit->wasHyperspacing && (*it)->IsHyperspacing())
 					Audio::Play(
-						Audio::Get(isJump ? "jump out" : "hyperdrive out"),
+						Audio::Get(mit->isJump ? "jump out" : "hyperdrive out"),
 						(*it)->Position());
 				
 				// Did this ship just jump into the player's system?
-				if(!wasHere && flagship && (*it)->GetSystem() == flagship->GetSystem())
+				if(!mit->wasHere && flagship && (*it)->GetSystem() == flagship->GetSystem())
 					Audio::Play(
-						Audio::Get(isJump ? "jump in" : "hyperdrive in"),
+						Audio::Get(mit->isJump ? "jump in" : "hyperdrive in"),
 						(*it)->Position());
 			}
 			
@@ -1010,7 +1533,11 @@ void Engine::CalculateStep()
 	}
 	
 	if(!wasHyperspacing && flagship && flagship->IsEnteringHyperspace())
+	{
 		Audio::Play(Audio::Get(flagship->IsUsingJumpDrive() ? "jump drive" : "hyperdrive"));
+		if(flagship->GetTargetSystem())
+			PrepareArrival(flagship->GetTargetSystem());
+	}
 	
 	if(flagship && player.GetSystem() != flagship->GetSystem())
 	{
@@ -1021,12 +1548,13 @@ void Engine::CalculateStep()
 						it.GetPlanet()->WormholeDestination(player.GetSystem()) == flagship->GetSystem())
 					player.Visit(it.GetPlanet());
 		
-		doFlash = Preferences::Has("Show hyperspace flash");
+		doFlash = Preferences::Has(Preferences::SHOW_HYPERSPACE_FLASH);
 		player.SetSystem(flagship->GetSystem());
 		EnterSystem();
 	}
 	
 	// Populate the collision detection set.
+	scope.Next(Profiler::COLLISION);
 	shipCollisions.Clear(step);
 	cloakedCollisions.Clear(step);
 	for(const shared_ptr<Ship> &it : ships)
@@ -1044,6 +1572,7 @@ void Engine::CalculateStep()
 	cloakedCollisions.Finish();
 	
 	// Draw the planets.
+	scope.Next(Profiler::DRAW_LIST);
 	Point newCenter = center;
 	Point newCenterVelocity;
 	if(flagship)
@@ -1103,8 +1632,10 @@ void Engine::CalculateStep()
 	// Now that the planets have been drawn, we can draw the asteroids on top
 	// of them. This could be done later, as long as it is done before the
 	// collision detection.
-	asteroids.Step(effects, flotsam);
+	asteroids.Step(effects, flotsam, step);
+	draw[calcTickTock].BeginGroup();
 	asteroids.Draw(draw[calcTickTock], newCenter, zoom);
+	draw[calcTickTock].EndGroup();
 	
 	// Move existing projectiles. Do this before ships fire, which will create
 	// new projectiles, since those should just stay where they are created for
@@ -1112,20 +1643,34 @@ void Engine::CalculateStep()
 	// result in a "die" effect or a sub-munition being created. We could not
 	// move the projectiles before this because some of them are homing and need
 	// to know the current positions of the ships.
-	list<Projectile> newProjectiles;
-	for(auto it = projectiles.begin(); it != projectiles.end(); )
+	scope.Next(Profiler::PROJECTILE_MOVE);
+	Projectile::UpdateTargets(projectiles, tracking);
+	for(size_t i = 0; i < projectiles.size(); )
 	{
-		if(!it->Move(effects))
+		if(!projectiles[i].Move(effects))
 		{
-			it->MakeSubmunitions(newProjectiles);
-			it = projectiles.erase(it);
+			projectiles[i].MakeSubmunitions(newProjectiles);
+			if(i + 1 != projectiles.size())
+				projectiles[i] = std::move(projectiles.back());
+			projectiles.pop_back();
 		}
 		else
-			++it;
+			++i;
 	}
-	projectiles.splice(projectiles.end(), newProjectiles);
-	
-	// Move the flotsam, which should be drawn underneath the ships.
+	// The submunitions are built in place in newProjectiles, which keeps its
+	// capacity from step to step, and then moved over in one block.
+	projectiles.insert(projectiles.end(),
+		make_move_iterator(newProjectiles.begin()), make_move_iterator(newProjectiles.end()));
+	newProjectiles.clear();
+	
+	// Move the flotsam, which should be drawn underneath the ships. Flotsam that
+	// no ship has room for does not need to look for a ship to collect it.
+	int mostFree = 0;
+	if(!flotsam.empty())
+		for(const shared_ptr<Ship> &ship : ships)
+			if(!ship->CannotAct())
+				mostFree = max(mostFree, ship->Cargo().Free());
+	draw[calcTickTock].BeginGroup();
 	for(auto it = flotsam.begin(); it != flotsam.end(); )
 	{
 		if(!(*it)->Move(effects))
@@ -1135,7 +1680,11 @@ void Engine::CalculateStep()
 		}
 		
 		Ship *collector = nullptr;
-		for(Body *body : shipCollisions.Circle((*it)->Position(), 5.))
+		if(mostFree >= (*it)->UnitSize())
+			shipCollisions.Circle((*it)->Position(), 5., nearby);
+		else
+			nearby.clear();
+		for(Body *body : nearby)
 		{
 			Ship *ship = reinterpret_cast<Ship *>(body);
 			if(!ship->CannotAct() && ship != (*it)->Source() && ship->Cargo().Free() >= (*it)->UnitSize())
@@ -1198,16 +1747,13 @@ void Engine::CalculateStep()
 		draw[calcTickTock].Add(**it);
 		++it;
 	}
+	draw[calcTickTock].EndGroup();
 	
-	// Keep track of the relative strength of each government in this system. Do
-	// not add more ships to make a winning team even stronger. This is mostly
-	// to avoid having the player get mobbed by pirates, say, if they hang out
-	// in one system for too long.
-	map<const Government *, int64_t> strength;
 	// Now, ships fire new projectiles, which includes launching fighters. If an
 	// anti-missile system is ready to fire, it does not actually fire unless a
 	// missile is detected in range during collision detection, below.
-	vector<Ship *> hasAntiMissile;
+	scope.Next(Profiler::SHIP_FIRE);
+	hasAntiMissile.clear();
 	double clickRange = 50.;
 	const Ship *previousTarget = nullptr;
 	shared_ptr<Ship> clickTarget;
@@ -1219,8 +1765,6 @@ void Engine::CalculateStep()
 	for(shared_ptr<Ship> &ship : ships)
 		if(ship->GetSystem() == player.GetSystem())
 		{
-			strength[ship->GetGovernment()] += ship->Cost();
-			
 			// Note: if a ship "fires" a fighter, that fighter was already in
 			// existence and under the control of the same AI as the ship, but
 			// its system was null to mark that it was not active.
@@ -1282,6 +1826,17 @@ void Engine::CalculateStep()
 			hasHostiles |= (type == Radar::HOSTILE);
 			radar[calcTickTock].Add(isYourTarget ? Radar::SPECIAL : type, ship->Position(), size);
 		}
+	// Sort the ships with anti-missiles ready by where they are, so that the
+	// collision checks below can find which of them might reach each missile.
+	antiMissileCollisions.Clear(step);
+	antiMissileRange = 0.;
+	for(Ship *ship : hasAntiMissile)
+	{
+		antiMissileCollisions.Add(*ship);
+		antiMissileRange = max(antiMissileRange, ship->AntiMissileRange());
+	}
+	antiMissileCollisions.Finish();
+	
 	if(flagship && showFlagship)
 	{
 		AddSprites(*flagship);
@@ -1313,7 +1868,7 @@ void Engine::CalculateStep()
 		--alarmTime;
 	else if(hasHostiles && !hadHostiles)
 	{
-		if(Preferences::Has("Warning siren"))
+		if(Preferences::Has(Preferences::WARNING_SIREN))
 			Audio::Play(Audio::Get("alarm"));
 		alarmTime = 180;
 		hadHostiles = true;
@@ -1322,84 +1877,125 @@ void Engine::CalculateStep()
 		hadHostiles = false;
 	
 	// Collision detection:
+	scope.Next(Profiler::COLLISION);
 	if(grudgeTime)
 		--grudgeTime;
-	for(Projectile &projectile : projectiles)
+	// Nothing that happens when a projectile hits something changes which ships
+	// or asteroids the other projectiles will hit, so find what every projectile
+	// hits up front. This only reads from the collision sets and the asteroid
+	// field, so it is done in parallel; then the projectiles explode and do
+	// damage one at a time, in order, so the results are always the same.
+	shipCollisions.Lines(projectiles, lineHits);
+	impacts.assign(projectiles.size(), Impact());
+	static const size_t BATCH_SIZE = 64;
+	size_t batches = (projectiles.size() + BATCH_SIZE - 1) / BATCH_SIZE;
+	ThreadPool::Shared().ParallelFor(batches, [this](size_t batch)
 	{
-		// The asteroids can collide with projectiles, the same as any other
-		// object. If the asteroid turns out to be closer than the ship, it
-		// shields the ship (unless the projectile has a blast radius).
-		Point hitVelocity;
-		double closestHit = 1.;
-		shared_ptr<Ship> hit;
-		const Government *gov = projectile.GetGovernment();
-		
-		// If this "projectile" is a ship explosion, it always explodes.
-		if(!gov)
-			closestHit = 0.;
-		else
+		size_t end = min(projectiles.size(), (batch + 1) * BATCH_SIZE);
+		for(size_t i = batch * BATCH_SIZE; i < end; ++i)
 		{
-			double triggerRadius = projectile.GetWeapon().TriggerRadius();
-			if(triggerRadius)
+			const Projectile &projectile = projectiles[i];
+			Impact &impact = impacts[i];
+			// If this "projectile" is a ship explosion, it always explodes.
+			if(!projectile.GetGovernment())
 			{
-				// Check if something triggered this projectile.
-				for(const Body *body : shipCollisions.Circle(projectile.Position(), triggerRadius))
-					if(body == projectile.Target() || gov->IsEnemy(body->GetGovernment()))
-					{
-						closestHit = 0.;
-						break;
-					}
+				impact.range = 0.;
+				continue;
 			}
-			if(closestHit > 0.)
+			
+			const CollisionSet::Hit &lineHit = lineHits[i];
+			if(lineHit.body)
 			{
-				// If the projectile was not triggered, check if it hit a ship.
-				Ship *ship = reinterpret_cast<Ship *>(shipCollisions.Line(projectile, &closestHit));
-				if(ship)
-				{
-					hit = ship->shared_from_this();
-					hitVelocity = ship->Velocity();
-				}
+				impact.ship = reinterpret_cast<Ship *>(lineHit.body);
+				impact.range = lineHit.range;
+				impact.velocity = impact.ship->Velocity();
 			}
-			// Check if the projectile hits an asteroid that is closer than the
-			// ship that it hit (if any).
-			double closestAsteroid = asteroids.Collide(projectile, step, closestHit, &hitVelocity);
-			if(closestAsteroid < closestHit)
+			// The asteroids can collide with projectiles, the same as any other
+			// object. If the asteroid turns out to be closer than the ship, it
+			// shields the ship (unless the projectile has a blast radius).
+			double closestAsteroid = asteroids.Collide(projectile, step, impact.range, &impact.velocity, &impact.minable);
+			if(closestAsteroid < impact.range)
 			{
-				closestHit = closestAsteroid;
-				hit = nullptr;
+				impact.range = closestAsteroid;
+				impact.ship = nullptr;
 			}
 		}
+	});
+	// Check if something triggered each projectile before it could hit anything
+	// else, and find where all the blasts are.
+	blastCenters.clear();
+	blastRadii.clear();
+	for(size_t i = 0; i < projectiles.size(); ++i)
+	{
+		const Projectile &projectile = projectiles[i];
+		Impact &impact = impacts[i];
+		const Government *gov = projectile.GetGovernment();
+		double triggerRadius = gov ? projectile.GetWeapon().TriggerRadius() : 0.;
+		if(triggerRadius)
+		{
+			shipCollisions.Circle(projectile.Position(), triggerRadius, nearby);
+			for(const Body *body : nearby)
+				if(body == projectile.Target() || gov->IsEnemy(body->GetGovernment()))
+				{
+					impact = Impact();
+					impact.range = 0.;
+					break;
+				}
+		}
+		
+		double blastRadius = projectile.GetWeapon().BlastRadius();
+		if(impact.range < 1. && blastRadius)
+		{
+			blastCenters.push_back(projectile.Position() + impact.range * projectile.Velocity());
+			blastRadii.push_back(blastRadius);
+		}
+	}
+	// Even friendly ships can be hit by a blast, and so can cloaked ships. Find
+	// all the ships within every blast at once.
+	shipCollisions.Circles(blastCenters, blastRadii, blastHits, blastOffsets);
+	cloakedCollisions.Circles(blastCenters, blastRadii, cloakedBlastHits, cloakedBlastOffsets);
+	
+	size_t blast = 0;
+	draw[calcTickTock].BeginGroup();
+	for(size_t i = 0; i < projectiles.size(); ++i)
+	{
+		Projectile &projectile = projectiles[i];
+		const Impact &impact = impacts[i];
+		const Government *gov = projectile.GetGovernment();
+		double closestHit = impact.range;
+		shared_ptr<Ship> hit;
+		if(impact.ship)
+			hit = impact.ship->shared_from_this();
+		if(impact.minable)
+			impact.minable->TakeDamage(projectile);
 		
 		if(closestHit < 1.)
 		{
 			// Create the explosion the given distance along the projectile's
 			// motion path for this step.
-			projectile.Explode(effects, closestHit, hitVelocity);
+			projectile.Explode(effects, closestHit, impact.velocity);
 			
-			// If this projectile has a blast radius, find all ships within its
-			// radius. Otherwise, only one is damaged.
-			double blastRadius = projectile.GetWeapon().BlastRadius();
-			if(blastRadius)
+			// If this projectile has a blast radius, damage all the ships that
+			// were found within its radius. Otherwise, only one is damaged.
+			if(projectile.GetWeapon().BlastRadius())
 			{
-				// Even friendly ships can be hit by the blast.
-				Point hitPos = projectile.Position() + closestHit * projectile.Velocity();
-				for(Body *body : shipCollisions.Circle(hitPos, blastRadius))
+				for(size_t j = blastOffsets[blast]; j < blastOffsets[blast + 1]; ++j)
 				{
-					shared_ptr<Ship> ship = reinterpret_cast<Ship *>(body)->shared_from_this();
+					shared_ptr<Ship> ship = reinterpret_cast<Ship *>(blastHits[j])->shared_from_this();
 					int eventType = ship->TakeDamage(projectile, ship != hit);
 					if(eventType)
 						eventQueue.emplace_back(
 							projectile.GetGovernment(), ship, eventType);
 				}
-				// Cloaked ships can be hit be a blast, too.
-				for(Body *body : cloakedCollisions.Circle(hitPos, blastRadius))
+				for(size_t j = cloakedBlastOffsets[blast]; j < cloakedBlastOffsets[blast + 1]; ++j)
 				{
-					shared_ptr<Ship> ship = reinterpret_cast<Ship *>(body)->shared_from_this();
+					shared_ptr<Ship> ship = reinterpret_cast<Ship *>(cloakedBlastHits[j])->shared_from_this();
 					int eventType = ship->TakeDamage(projectile, ship != hit);
 					if(eventType)
 						eventQueue.emplace_back(
 							projectile.GetGovernment(), ship, eventType);
 				}
+				++blast;
 			}
 			else if(hit)
 			{
@@ -1419,16 +2015,24 @@ void Engine::CalculateStep()
 				isEnemy ? Radar::SPECIAL : Radar::INACTIVE, projectile.Position(), 1.);
 			
 			// If the projectile did not hit anything, give the anti-missile
-			// systems a chance to shoot it down.
-			for(Ship *ship : hasAntiMissile)
-				if(ship == projectile.Target()
-						|| gov->IsEnemy(ship->GetGovernment())
-						|| ship->GetGovernment()->IsEnemy(gov))
-					if(ship->FireAntiMissile(projectile, effects))
-					{
-						projectile.Kill();
-						break;
-					}
+			// systems a chance to shoot it down. Only the ships that are within
+			// the longest anti-missile range of it might be able to.
+			if(!hasAntiMissile.empty())
+			{
+				antiMissileCollisions.Circle(projectile.Position(), antiMissileRange, nearby);
+				for(Body *body : nearby)
+				{
+					Ship *ship = reinterpret_cast<Ship *>(body);
+					if(ship == projectile.Target()
+							|| gov->IsEnemy(ship->GetGovernment())
+							|| ship->GetGovernment()->IsEnemy(gov))
+						if(ship->FireAntiMissile(projectile, effects))
+						{
+							projectile.Kill();
+							break;
+						}
+				}
+			}
 		}
 		else if(projectile.GetWeapon().BlastRadius())
 			radar[calcTickTock].Add(Radar::SPECIAL, projectile.Position(), 1.8);
@@ -1439,21 +2043,63 @@ void Engine::CalculateStep()
 		Point relativeVelocity = projectile.Velocity() - projectile.Unit() * innateVelocity;
 		draw[calcTickTock].AddProjectile(projectile, relativeVelocity, closestHit);
 	}
+	draw[calcTickTock].EndGroup();
 	
 	// Finally, draw all the effects, and then move them (because their motion
 	// is not dependent on anything else, and this way we do all the work on
 	// them in a single place.
-	for(auto it = effects.begin(); it != effects.end(); )
+	// Effects that are done are removed as this goes, by copying each survivor
+	// down into the first free slot; this keeps them in order of creation.
+	scope.Next(Profiler::DRAW_LIST);
+	size_t excess = (effects.size() > MAX_EFFECTS) ? effects.size() - MAX_EFFECTS : 0;
+	auto out = effects.begin();
+	auto firstNew = effects.begin() + max(excess, oldEffects);
+	// Effects are purely cosmetic, and any sound they make was played when
+	// they were placed, so a new effect that will never drift onto the screen
+	// can be discarded without moving or drawing it even once.
+	double viewZoom = min(zoom, Preferences::ViewZoom());
+	double viewRadius = .5 * Point(Screen::Width(), Screen::Height()).Length() / viewZoom
+		+ EFFECT_CULL_MARGIN;
+	draw[calcTickTock].BeginGroup();
+	for(auto it = effects.begin() + excess; it != effects.end(); ++it)
 	{
-		draw[calcTickTock].AddUnblurred(*it);
+		if(it >= firstNew)
+		{
+			double reach = (it->Velocity() - newCenterVelocity).Length() * max(0, it->Lifetime());
+			if(it->Position().Distance(newCenter) - it->Radius() - reach > viewRadius)
+				continue;
+		}
+		// If the game is falling behind, only keep some of the new effects.
+		// They are thinned out evenly rather than at random, so that this does
+		// not change the random numbers that the rest of the game sees.
+		if(it >= firstNew && effectsQuality < 1.)
+		{
+			effectsKept += effectsQuality;
+			if(effectsKept < 1.)
+				continue;
+			effectsKept -= 1.;
+		}
+		draw[calcTickTock].AddEffect(*it);
 		
-		if(!it->Move())
-			it = effects.erase(it);
-		else
-			++it;
+		if(it->Move())
+		{
+			if(out != it)
+				*out = std::move(*it);
+			++out;
+		}
 	}
+	draw[calcTickTock].EndGroup();
+	effects.erase(out, effects.end());
 	
 	// Add incoming ships.
+	scope.End();
+	// Keep track of the relative strength of each government in this system. Do
+	// not add more ships to make a winning team even stronger. This is mostly
+	// to avoid having the player get mobbed by pirates, say, if they hang out
+	// in one system for too long. Fleets only rarely try to enter, so only add
+	// up the strengths if one of them does.
+	map<const Government *, int64_t> strength;
+	bool hasStrength = false;
 	for(const System::FleetProbability &fleet : player.GetSystem()->Fleets())
 		if(!Random::Int(fleet.Period()))
 		{
@@ -1461,6 +2107,13 @@ void Engine::CalculateStep()
 			if(!gov)
 				continue;
 			
+			if(!hasStrength)
+			{
+				hasStrength = true;
+				for(const shared_ptr<Ship> &ship : ships)
+					if(ship->GetSystem() == player.GetSystem())
+						strength[ship->GetGovernment()] += ship->Cost();
+			}
 			int64_t enemyStrength = 0;
 			for(const auto &it : strength)
 				if(gov->IsEnemy(it.first))
@@ -1544,6 +2197,50 @@ void Engine::CalculateStep()
 		loadSum = 0.;
 		loadCount = 0;
 	}
+	
+	Profiler::SetCounts(ships.size(), projectiles.size(), effects.size(), flotsam.size());
+	if(stateLog)
+		LogState();
+}
+
+
+
+// Call Move() for every ship in the "moving" list, splitting them into batches
+// that can be spread across the worker threads.
+void Engine::MoveShips()
+{
+	// Each batch should be big enough to be worth handing to another thread.
+	// The batch boundaries must not depend on the number of threads, or the
+	// outcome would depend on what computer the game is running on.
+	static const size_t BATCH_SIZE = 16;
+	size_t batches = (moving.size() + BATCH_SIZE - 1) / BATCH_SIZE;
+	if(moveBatches.size() < batches)
+		moveBatches.resize(batches);
+	
+	// Ships use random numbers as they move, and each thread has its own random
+	// number generator. Seed it separately for each batch, so that the results
+	// do not depend on which thread happens to move which batch.
+	uint64_t seed = Random::NewSeed();
+	ThreadPool::Shared().ParallelFor(batches, [this, seed](size_t batch)
+	{
+		Random::Seed(seed, batch);
+		MoveBatch &output = moveBatches[batch];
+		size_t end = min(moving.size(), (batch + 1) * BATCH_SIZE);
+		for(size_t i = batch * BATCH_SIZE; i < end; ++i)
+			moving[i].isAlive = moving[i].ship->Move(output.effects, output.flotsam);
+	});
+	// This thread may or may not have moved some of the batches itself, so reseed
+	// it as well to keep its random numbers predictable.
+	Random::Seed(seed, batches);
+	
+	// Gather the effects and flotsam in the same order regardless of which
+	// batches finished first.
+	for(size_t i = 0; i < batches; ++i)
+	{
+		effects.insert(effects.end(), moveBatches[i].effects.begin(), moveBatches[i].effects.end());
+		moveBatches[i].effects.clear();
+		flotsam.splice(flotsam.end(), moveBatches[i].flotsam);
+	}
 }
 
 
@@ -1604,6 +2301,72 @@ void Engine::AddSprites(const Ship &ship)
 
 
 
+// Record the vertices of the status rings and the target crosshairs. This is
+// done here rather than when drawing, so that it overlaps with the render
+// thread putting the last frame on the screen, and so that drawing a frame
+// is only a matter of submitting the lists.
+void Engine::RecordHUD()
+{
+	statusRings.clear();
+	for(const auto &it : statuses)
+	{
+		static const Color color[6] = {
+			Color(0., .5, 0., .25),
+			Color(.5, .15, 0., .25),
+			Color(.5, .5, .5, .25),
+			Color(.45, .5, 0., .25),
+			Color(.5, .3, 0., .25),
+			Color(.7, .7, .7, .25)
+		};
+		Point pos = it.position * zoom;
+		double radius = it.radius * zoom;
+		if(it.outer > 0.)
+			RingShader::Add(statusRings, pos, radius + 3., 1.5, it.outer, color[it.type], 0., it.angle);
+		double dashes = (it.type >= 2) ? 0. : 20. * min(1., zoom);
+		if(it.inner > 0.)
+			RingShader::Add(statusRings, pos, radius, 1.5, it.inner, color[3 + it.type], dashes, it.angle);
+	}
+	
+	targetPointers.clear();
+	for(const Target &target : targets)
+	{
+		Angle a = target.angle;
+		Angle da(90.);
+		
+		for(int i = 0; i < 4; ++i)
+		{
+			PointerShader::Add(targetPointers, target.center * zoom, a.Unit(), 12., 14., -target.radius * zoom,
+				Radar::GetColor(target.type));
+			a += da;
+		}
+	}
+}
+
+
+
+// Decide what fraction of the new effects to show, either based on the
+// preference or, if that is set to adjust automatically, based on how much of
+// the CPU the calculations are using and how long the GPU takes to draw.
+void Engine::UpdateEffectsQuality()
+{
+	int percent = Preferences::EffectsQuality();
+	if(percent)
+	{
+		effectsQuality = percent * .01;
+		return;
+	}
+	
+	// Back off quickly when falling behind, and recover slowly once there is
+	// time to spare, so the quality does not flicker up and down.
+	double gpuTime = Profiler::Latest(Profiler::GPU_PANELS);
+	if(load > HIGH_LOAD || gpuTime > HIGH_GPU_TIME)
+		effectsQuality = max(MIN_EFFECTS_QUALITY, effectsQuality - .02);
+	else if(load < LOW_LOAD && gpuTime < LOW_GPU_TIME)
+		effectsQuality = min(1., effectsQuality + .005);
+}
+
+
+
 void Engine::DoGrudge(const shared_ptr<Ship> &target, const Government *attacker)
 {
 	if(attacker->IsPlayer())
@@ -20,6 +20,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "EscortDisplay.h"
 #include "Flotsam.h"
 #include "Information.h"
+#include "Minable.h"
 #include "PlanetLabel.h"
 #include "Point.h"
 #include "Projectile.h"
@@ -28,15 +29,21 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Ship.h"
 #include "ShipEvent.h"
 
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <thread>
 #include <vector>
 
+class Fleet;
 class Government;
 class Outfit;
+class Planet;
 class PlayerInfo;
 
 
@@ -58,30 +65,106 @@ public:
 	
 	// Wait for the previous calculations (if any) to be done.
 	void Wait();
+	// Check whether the previous calculations are done, i.e. whether Wait() would
+	// return right away.
+	bool IsReady();
 	// Perform all the work that can only be done while the calculation thread
 	// is paused (for thread safety reasons).
 	void Step(bool isActive);
-	// Begin the next step of calculations.
-	void Go();
+	// Begin the next step of calculations. If its results will never be shown,
+	// the lists of things to draw are not filled in.
+	void Go(bool isShown = true);
 	
 	// Get any special events that happened in this step.
-	const std::list<ShipEvent> &Events() const;
+	const std::vector<ShipEvent> &Events() const;
 	
-	// Draw a frame.
-	void Draw() const;
+	// Draw a frame. The interpolation is how far this frame is between the
+	// last step and the next one (see UI::DrawAll()).
+	void Draw(double interpolation = 1.) const;
 	
 	// Select the object the player clicked on.
 	void Click(const Point &from, const Point &to, bool hasShift);
 	void RClick(const Point &point);
 	void SelectGroup(int group, bool hasShift, bool hasControl);
 	
+	// Place the given fleets in the player's system, then run the given number
+	// of steps in this thread without drawing anything, and return how many
+	// ships are left. This is for benchmarking; seed the random number
+	// generator first to make the results repeatable. If more than one run is
+	// asked for, each one starts over from a snapshot of the world as it was
+	// right after the fleets were placed.
+	int Simulate(const std::vector<const Fleet *> &fleets, int steps, int runs = 1);
+	// Place the given fleets in the player's system, then let them fight in
+	// this thread until at most one government has any ships left that can
+	// still fight, or until the given number of steps have passed. This returns
+	// the government that won, or null if neither side did, and sets the
+	// number of steps that the battle took. Seed the random number generator
+	// first; each battle only uses the generator of the thread it runs in.
+	const Government *Battle(const std::vector<const Fleet *> &fleets, int maxSteps, int &steps);
+	
+	// After every step, write a hash of the state of every ship, of all the
+	// projectiles and flotsam, and of the random number generator to the given
+	// file. Comparing two of these logs shows the first step where two runs
+	// that should be identical (e.g. a replay and the original flight) differ.
+	static void WriteStateLog(const std::string &path);
+	
+	// A copy of everything that is in flight: the ships (including the ones
+	// being carried), projectiles, flotsam, effects and asteroids, and the
+	// state of the random number generator. Objects are restored in place, so
+	// anything that points to a ship, flotsam or minable asteroid that existed
+	// when the snapshot was taken still points to the same object afterwards.
+	class Snapshot {
+	private:
+		friend class Engine;
+		
+		int step = 0;
+		std::list<std::shared_ptr<Ship>> ships;
+		// A copy of every ship that is in the list above or in one of their
+		// bays, and for each one, the ships that were in its own bays.
+		std::vector<std::pair<std::shared_ptr<Ship>, Ship>> shipStates;
+		std::vector<std::vector<std::shared_ptr<Ship>>> carried;
+		std::vector<Projectile> projectiles;
+		std::vector<std::pair<std::shared_ptr<Flotsam>, Flotsam>> flotsam;
+		std::vector<Effect> effects;
+		AsteroidField asteroids;
+		std::vector<std::pair<std::shared_ptr<Minable>, Minable>> minables;
+		std::map<const Government *, std::weak_ptr<const Ship>> grudge;
+		int grudgeTime = 0;
+		std::string random;
+	};
+	// Save the state of the world, or put it back the way it was when the
+	// given snapshot was taken, e.g. to run the same benchmark several times
+	// or to jump back to an earlier point in a replay. This must only be done
+	// while the calculation thread is paused (i.e. after Wait()). The random
+	// number generator that is saved and restored is the one for this thread,
+	// which is the one that Simulate() uses. The AI's memory of what every
+	// ship was doing is not saved; restoring a snapshot clears it instead.
+	void TakeSnapshot(Snapshot &snapshot) const;
+	void Restore(const Snapshot &snapshot);
+	
 	
 private:
 	void EnterSystem();
+	// Clear out the player's system and place the given fleets in it, for a
+	// simulation. This returns false if the player is not in any system.
+	bool SetUpSimulation(const std::vector<const Fleet *> &fleets);
+	void LogState() const;
+	// Begin loading the sprites that will be needed on arriving in the given
+	// system, so that they can be loaded while the jump is in progress.
+	void PreloadSystem(const System &system);
+	// Start creating the fleets that will be in the given system when the
+	// flagship arrives there, in a background thread.
+	void PrepareArrival(const System *system);
+	// Wait for the background thread to finish creating those fleets.
+	void FinishArrival();
 	
 	void ThreadEntryPoint();
 	void CalculateStep();
+	void MoveShips();
 	void AddSprites(const Ship &ship);
+	// Record the vertices of the status rings and the target crosshairs.
+	void RecordHUD();
+	void UpdateEffectsQuality();
 	
 	void DoGrudge(const std::shared_ptr<Ship> &target, const Government *attacker);
 	
@@ -95,6 +178,50 @@ private:
 		int type;
 	};
 	
+	// Information about a ship that is moving during the current step.
+	class MovingShip {
+	public:
+		Ship *ship;
+		// The ship's state before it moved.
+		bool isJump;
+		bool wasHere;
+		bool wasHyperspacing;
+		// Whether the ship is still in play after moving.
+		bool isAlive;
+	};
+	
+	// Ships are moved in batches, which may run in parallel. Each batch has its
+	// own lists for whatever effects and flotsam its ships create.
+	class MoveBatch {
+	public:
+		std::vector<Effect> effects;
+		std::list<std::shared_ptr<Flotsam>> flotsam;
+	};
+	
+	// What a projectile hits in this step, if anything: how far along its path
+	// the hit is, the velocity of what it hits, and which ship or minable it
+	// hits. If it hits an ordinary asteroid, both of those are null.
+	class Impact {
+	public:
+		double range = 1.;
+		Point velocity;
+		Ship *ship = nullptr;
+		Minable *minable = nullptr;
+	};
+	
+	// The fleets that will be in the system the flagship is jumping to. These
+	// are created in a background thread during the jump, and then added to
+	// the list of ships once the flagship arrives.
+	class Arrival {
+	public:
+		const System *system = nullptr;
+		std::list<std::shared_ptr<Ship>> ships;
+		
+		std::mutex mutex;
+		std::condition_variable condition;
+		bool isDone = false;
+	};
+	
 	class Status {
 	public:
 		Status(const Point &position, double outer, double inner, double radius, int type, double angle = 0.);
@@ -117,9 +244,17 @@ private:
 	std::condition_variable condition;
 	std::mutex swapMutex;
 	
+	std::shared_ptr<Arrival> arrival;
+	
 	bool calcTickTock = false;
 	bool drawTickTock = false;
 	bool terminate = false;
+	bool isCalcShown = true;
+	// Whether the calculation thread should read the keyboard again just before
+	// the ships move, and when the keyboard was read for each draw buffer.
+	bool lateInput = false;
+	std::chrono::steady_clock::time_point inputTime;
+	std::chrono::steady_clock::time_point drawInputTime[2];
 	bool wasActive = false;
 	DrawList draw[2];
 	Radar radar[2];
@@ -128,15 +263,23 @@ private:
 	Point centerVelocity;
 	// Other information to display.
 	Information info;
+	int64_t shownCredits = 0;
+	std::string creditsString;
 	std::vector<Target> targets;
 	Point targetAngle;
 	Point targetUnit;
 	EscortDisplay escorts;
 	std::vector<Status> statuses;
+	// The status rings and target crosshairs, ready to be drawn.
+	std::vector<float> statusRings;
+	std::vector<float> targetPointers;
 	std::vector<PlanetLabel> labels;
 	std::vector<std::pair<const Outfit *, int>> ammo;
 	int jumpCount = 0;
 	const System *jumpInProgress[2] = {nullptr, nullptr};
+	const System *preloadedSystem = nullptr;
+	// The planet whose landscape was loaded because the flagship is landing.
+	const Planet *preloadedPlanet = nullptr;
 	const Sprite *highlightSprite = nullptr;
 	Point highlightUnit;
 	int highlightFrame = 0;
@@ -144,15 +287,27 @@ private:
 	int step = 0;
 	
 	std::list<std::shared_ptr<Ship>> ships;
-	std::list<Projectile> projectiles;
+	std::vector<MovingShip> moving;
+	std::vector<MoveBatch> moveBatches;
+	// Projectiles are stored contiguously. When one dies, the last one takes
+	// its place, so the order they are drawn in is not preserved.
+	std::vector<Projectile> projectiles;
+	std::vector<Projectile> newProjectiles;
+	// Scratch space for CalculateStep(), kept here so it is not reallocated
+	// every step.
+	std::vector<Ship *> hasAntiMissile;
+	std::vector<Body *> nearby;
+	std::vector<std::pair<const Ship *, Projectile *>> tracking;
 	std::list<std::shared_ptr<Flotsam>> flotsam;
-	std::list<Effect> effects;
-	// Keep track of which ships we have not seen for long enough that it is
-	// time to stop tracking their movements.
-	std::map<std::list<Ship>::iterator, int> forget;
-	
-	std::list<ShipEvent> eventQueue;
-	std::list<ShipEvent> events;
+	// Effects are also stored contiguously. If there are ever more of them
+	// than the engine is willing to draw, the oldest ones are dropped.
+	std::vector<Effect> effects;
+	// Events are double buffered: the calculation thread adds to the queue
+	// while the main thread handles the previous step's events. Clearing a
+	// vector keeps its storage, so once these have grown to the usual number
+	// of events per step, adding events does not allocate.
+	std::vector<ShipEvent> eventQueue;
+	std::vector<ShipEvent> events;
 	// Keep track of who has asked for help in fighting whom.
 	std::map<const Government *, std::weak_ptr<const Ship>> grudge;
 	int grudgeTime = 0;
@@ -161,6 +316,23 @@ private:
 	
 	CollisionSet shipCollisions;
 	CollisionSet cloakedCollisions;
+	// The ships with anti-missiles ready to fire, so each missile only needs to
+	// be checked against the ones that are near it, and the longest range of
+	// any of those anti-missiles.
+	CollisionSet antiMissileCollisions;
+	double antiMissileRange = 0.;
+	// Which ship, if any, each projectile is on course to hit in this step, and
+	// what it hits once the asteroids are taken into account.
+	std::vector<CollisionSet::Hit> lineHits;
+	std::vector<Impact> impacts;
+	// Where each projectile that explodes with a blast radius does so, and
+	// which ships, cloaked or not, are within each of those blasts.
+	std::vector<Point> blastCenters;
+	std::vector<double> blastRadii;
+	std::vector<Body *> blastHits;
+	std::vector<std::size_t> blastOffsets;
+	std::vector<Body *> cloakedBlastHits;
+	std::vector<std::size_t> cloakedBlastOffsets;
 	
 	int alarmTime = 0;
 	double flash = 0.;
@@ -177,12 +349,20 @@ private:
 	Rectangle clickBox;
 	int groupSelect = -1;
 	Command clickCommands;
+	// While a replay is being recorded or played back, the calculations in
+	// each step use their own random seed.
+	bool seedCalculation = false;
+	uint64_t calculationSeed = 0;
 	
 	double zoom = 1.;
 	
 	double load = 0.;
 	int loadCount = 0;
 	double loadSum = 0.;
+	// The fraction of new effects to show, and a running total that is used
+	// to pick which ones to keep.
+	double effectsQuality = 1.;
+	double effectsKept = 0.;
 };
 
 
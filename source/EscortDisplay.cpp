@@ -25,7 +25,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "System.h"
 
 #include <algorithm>
-#include <set>
+#include <map>
 
 using namespace std;
 
@@ -51,18 +51,18 @@ void EscortDisplay::Add(const Ship &ship, bool isHere, bool fleetIsJumping, bool
 void EscortDisplay::Draw() const
 {
 	MergeStacks();
-	icons.sort();
+	stable_sort(icons.begin(), icons.end());
 	stacks.clear();
 	zones.clear();
 	
 	// Draw escort status.
 	const Font &font = FontSet::Get(14);
 	Point pos = Point(Screen::Left() + 20., Screen::Bottom());
-	const Color &elsewhereColor = *GameData::Colors().Get("escort elsewhere");
-	const Color &cannotJumpColor = *GameData::Colors().Get("escort blocked");
-	const Color &notReadyToJumpColor = *GameData::Colors().Get("escort not ready");
-	const Color &selectedColor = *GameData::Colors().Get("escort selected");
-	const Color &hereColor = *GameData::Colors().Get("escort present");
+	static const Color &elsewhereColor = *GameData::Colors().Get("escort elsewhere");
+	static const Color &cannotJumpColor = *GameData::Colors().Get("escort blocked");
+	static const Color &notReadyToJumpColor = *GameData::Colors().Get("escort not ready");
+	static const Color &selectedColor = *GameData::Colors().Get("escort selected");
+	static const Color &hereColor = *GameData::Colors().Get("escort present");
 	for(const Icon &escort : icons)
 	{
 		if(!escort.sprite)
@@ -74,8 +74,8 @@ void EscortDisplay::Draw() const
 			break;
 		
 		// Draw the system name for any escort not in the current system.
-		if(!escort.system.empty())
-			font.Draw(escort.system, pos + Point(-10., 10.), elsewhereColor);
+		if(escort.system)
+			font.Draw(escort.system->Name(), pos + Point(-10., 10.), elsewhereColor);
 
 		Color color;
 		if(!escort.isHere)
@@ -169,9 +169,9 @@ EscortDisplay::Icon::Icon(const Ship &ship, bool isHere, bool fleetIsJumping, bo
 	cannotJump(fleetIsJumping && !ship.IsHyperspacing() && !ship.JumpsRemaining()),
 	isSelected(isSelected),
 	cost(ship.Cost()),
-	system((!isHere && ship.GetSystem()) ? ship.GetSystem()->Name() : ""),
+	system(isHere ? nullptr : ship.GetSystem()),
 	low{ship.Shields(), ship.Hull(), ship.Energy(), ship.Heat(), ship.Fuel()},
-	high(low),
+	high{low[0], low[1], low[2], low[3], low[4]},
 	ships(1, &ship)
 {
 }
@@ -188,7 +188,7 @@ bool EscortDisplay::Icon::operator<(const Icon &other) const
 
 int EscortDisplay::Icon::Height() const
 {
-	return 30 + 15 * !system.empty();
+	return 30 + 15 * !!system;
 }
 
 
@@ -199,10 +199,10 @@ void EscortDisplay::Icon::Merge(const Icon &other)
 	notReadyToJump |= other.notReadyToJump;
 	cannotJump |= other.cannotJump;
 	isSelected |= other.isSelected;
-	if(system.empty() && !other.system.empty())
+	if(!system && other.system)
 		system = other.system;
 	
-	for(unsigned i = 0; i < low.size(); ++i)
+	for(unsigned i = 0; i < 5; ++i)
 	{
 		low[i] = min(low[i], other.low[i]);
 		high[i] = max(high[i], other.high[i]);
@@ -212,59 +212,78 @@ void EscortDisplay::Icon::Merge(const Icon &other)
 
 
 
+// If the icons do not all fit on screen, stack together the escorts that have
+// the same sprite and are in the same system, starting with the cheapest kind
+// of escort, until they do fit. Stacking a set of escorts never changes the
+// height of the icons that are left, so rather than repeatedly merging and
+// measuring, this first figures out how much each sprite's stacks would save
+// and which sprites need to be stacked, and then merges them in a single pass.
 void EscortDisplay::MergeStacks() const
 {
 	if(icons.empty())
 		return;
 	
+	class Group {
+	public:
+		// The cheapest escort with this sprite.
+		int64_t cost;
+		// The order in which the sprites were first seen, to break ties.
+		size_t order;
+		// How much shorter the list would be if this sprite were stacked.
+		int saved;
+		bool isMerged;
+	};
+	map<const Sprite *, Group> groups;
+	map<pair<const Sprite *, const System *>, Icon *> first;
+	
+	int height = 0;
+	for(Icon &icon : icons)
+	{
+		height += icon.Height();
+		auto it = groups.emplace(icon.sprite, Group{icon.cost, groups.size(), 0, false}).first;
+		it->second.cost = min(it->second.cost, icon.cost);
+		// Every escort after the first with this sprite in the same system
+		// would be merged into that first one.
+		if(!first.emplace(make_pair(icon.sprite, icon.system), &icon).second)
+			it->second.saved += icon.Height();
+	}
+	
 	int maxHeight = Screen::Height() - 450;
-	set<const Sprite *> unstackable;
-	while(true)
+	if(height < maxHeight)
+		return;
+	
+	// Stack the cheapest kinds of escorts first.
+	vector<Group *> order;
+	for(auto &it : groups)
+		order.push_back(&it.second);
+	sort(order.begin(), order.end(), [](const Group *a, const Group *b)
 	{
-		Icon *cheapest = nullptr;
-		
-		int height = 0;
-		for(Icon &icon : icons)
-		{
-			if(!unstackable.count(icon.sprite) && (!cheapest || *cheapest < icon))
-				cheapest = &icon;
-			
-			height += icon.Height();
-		}
-		
-		if(height < maxHeight || !cheapest)
+		return (a->cost != b->cost) ? (a->cost < b->cost) : (a->order < b->order);
+	});
+	for(Group *group : order)
+	{
+		if(height < maxHeight)
 			break;
-		
-		// Merge together each group of escorts that have this icon annd are in
-		// the same system.
-		map<string, Icon *> merged;
-		
-		// The "cheapest" element in the list may be removed to merge it with an
-		// earlier ship of the same type, so store a copy of its sprite pointer:
-		const Sprite *sprite = cheapest->sprite;
-		list<Icon>::iterator it = icons.begin();
-		while(it != icons.end())
+		group->isMerged = true;
+		height -= group->saved;
+	}
+	
+	// Merge each stacked escort into the first one with the same sprite that is
+	// in the same system, and remove it from the list.
+	vector<Icon> stacked;
+	stacked.reserve(icons.size());
+	for(Icon &icon : icons)
+	{
+		Icon *&target = first[make_pair(icon.sprite, icon.system)];
+		if(!groups[icon.sprite].isMerged || target == &icon)
 		{
-			if(it->sprite != sprite)
-			{
-				++it;
-				continue;
-			}
-			
-			// If this is the first escort we've seen so far in its system, it
-			// is the one we will merge all others in this system into.
-			auto mit = merged.find(it->system);
-			if(mit == merged.end())
-			{
-				merged[it->system] = &*it;
-				++it;
-			}
-			else
-			{
-				mit->second->Merge(*it);
-				it = icons.erase(it);	
-			}
+			stacked.push_back(std::move(icon));
+			// Anything merged into this icon must now go to its new location.
+			if(target == &icon)
+				target = &stacked.back();
 		}
-		unstackable.insert(sprite);
+		else
+			target->Merge(icon);
 	}
+	icons.swap(stacked);
 }
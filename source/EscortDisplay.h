@@ -16,12 +16,11 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Point.h"
 
 #include <cstdint>
-#include <list>
-#include <string>
 #include <vector>
 
 class Ship;
 class Sprite;
+class System;
 
 
 
@@ -58,9 +57,10 @@ private:
 		bool cannotJump;
 		bool isSelected;
 		int64_t cost;
-		std::string system;
-		std::vector<double> low;
-		std::vector<double> high;
+		// The system this escort is in, if it is not in the player's system.
+		const System *system;
+		double low[5];
+		double high[5];
 		std::vector<const Ship *> ships;
 	};
 	
@@ -70,7 +70,7 @@ private:
 	
 	
 private:
-	mutable std::list<Icon> icons;
+	mutable std::vector<Icon> icons;
 	mutable std::vector<std::vector<const Ship *>> stacks;
 	mutable std::vector<Point> zones; 
 };
@@ -25,11 +25,14 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include <unistd.h>
 
 #include <cstdlib>
+#include <ctime>
 #include <fstream>
 #include <iostream>
 #include <mutex>
 #include <stdexcept>
 
+#include <zlib.h>
+
 using namespace std;
 
 namespace {
@@ -40,6 +43,7 @@ namespace {
 	string images;
 	string sounds;
 	string saves;
+	string cache;
 	
 	mutex errorMutex;
 	FILE *errorLog = nullptr;
@@ -79,6 +83,82 @@ namespace {
 		return result;
 	}
 #endif
+	
+	// Get the path where the list of files in the given directory is cached.
+	// The file name is a 64-bit FNV-1a hash of the directory path.
+	string ManifestPath(const string &directory)
+	{
+		if(Files::Cache().empty())
+			return string();
+		
+		uint64_t hash = 14695981039346656037ULL;
+		for(char c : directory)
+		{
+			hash ^= static_cast<unsigned char>(c);
+			hash *= 1099511628211ULL;
+		}
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.list", static_cast<unsigned long long>(hash));
+		return Files::Cache() + name;
+	}
+	
+	// A manifest begins with the number of directories in the tree, followed by
+	// the timestamp and path of each directory, one per line, and then the path
+	// of each file. Adding, removing, or renaming a file changes the timestamp
+	// of the directory it is in, so if none of the timestamps have changed, the
+	// list of files is still current. This returns false if it is not.
+	bool ReadManifest(const string &path, vector<string> &list)
+	{
+		string text = Files::Read(path);
+		size_t pos = 0;
+		auto NextLine = [&text, &pos](string &line) -> bool
+		{
+			size_t end = text.find('\n', pos);
+			if(end == string::npos)
+				return false;
+			line.assign(text, pos, end - pos);
+			pos = end + 1;
+			return true;
+		};
+		
+		string line;
+		if(!NextLine(line))
+			return false;
+		long long directories = atoll(line.c_str());
+		for(long long i = 0; i < directories; ++i)
+		{
+			size_t space;
+			if(!NextLine(line) || (space = line.find(' ')) == string::npos)
+				return false;
+			if(atoll(line.c_str()) != static_cast<long long>(Files::Timestamp(line.substr(space + 1))))
+				return false;
+		}
+		while(NextLine(line))
+			list.push_back(line);
+		return directories > 0;
+	}
+	
+	void WriteManifest(const string &path, const vector<string> &list, const vector<string> &directories, time_t start)
+	{
+		string text = to_string(directories.size()) + '\n';
+		for(const string &directory : directories)
+		{
+			// If a directory changed within the last second, it might change
+			// again without its timestamp changing, so don't cache it yet.
+			time_t timestamp = Files::Timestamp(directory);
+			if(timestamp >= start - 1 || directory.find('\n') != string::npos)
+				return;
+			text += to_string(static_cast<long long>(timestamp)) + ' ' + directory + '\n';
+		}
+		for(const string &file : list)
+		{
+			if(file.find('\n') != string::npos)
+				return;
+			text += file + '\n';
+		}
+		
+		Files::WriteAtomically(path, text);
+	}
 }
 
 
@@ -182,6 +262,18 @@ void Files::Init(const char * const *argv)
 		throw runtime_error("Unable to find the resource directories!");
 	if(!Exists(saves))
 		throw runtime_error("Unable to create config directory!");
+	
+	// The cache directory is optional: if it cannot be created, anything that
+	// would have been cached is just regenerated each time.
+	cache = config + "cache/";
+	if(!Exists(cache))
+	{
+#if defined _WIN32
+		CreateDirectoryW(ToUTF16(cache).c_str(), nullptr);
+#else
+		mkdir(cache.c_str(), 0700);
+#endif
+	}
 }
 
 
@@ -228,6 +320,13 @@ const string &Files::Saves()
 
 
 
+const string &Files::Cache()
+{
+	return cache;
+}
+
+
+
 vector<string> Files::List(string directory)
 {
 	if(directory.empty() || directory.back() != '/')
@@ -341,24 +440,49 @@ vector<string> Files::ListDirectories(string directory)
 
 
 
+// Get a list of all regular files in the given directory or any directory
+// that it contains, recursively. If nothing in the directory tree has changed
+// since the last time it was listed, the list is read from the cache instead.
 vector<string> Files::RecursiveList(const string &directory)
 {
 	vector<string> list;
-	RecursiveList(directory, &list);
+	string manifestPath = ManifestPath(directory);
+	if(!Exists(directory) || manifestPath.empty())
+	{
+		RecursiveList(directory, &list);
+		return list;
+	}
+	
+	if(ReadManifest(manifestPath, list))
+		return list;
+	
+	list.clear();
+	vector<string> directories;
+	time_t start = time(nullptr);
+	RecursiveList(directory, &list, &directories);
+	WriteManifest(manifestPath, list, directories, start);
 	return list;
 }
 
 
 
-void Files::RecursiveList(string directory, vector<string> *list)
+// Add every regular file in the given directory tree to the given list, and if
+// a list of directories is given, add each directory in the tree to it.
+void Files::RecursiveList(string directory, vector<string> *list, vector<string> *directories)
 {
 	if(directory.empty() || directory.back() != '/')
 		directory += '/';
+	if(directories)
+		directories->push_back(directory);
 	
 #if defined _WIN32
+	// Only the name and attributes of each file are needed, so skip looking up
+	// the short names and ask for the directory contents in larger batches.
+	// That makes a big difference on slow or network drives.
 	WIN32_FIND_DATAW ffd;
-	HANDLE hFind = FindFirstFileW(ToUTF16(directory + '*').c_str(), &ffd);
-	if(!hFind)
+	HANDLE hFind = FindFirstFileExW(ToUTF16(directory + '*').c_str(), FindExInfoBasic, &ffd,
+		FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+	if(hFind == INVALID_HANDLE_VALUE)
 		return;
 	
 	do {
@@ -368,7 +492,7 @@ void Files::RecursiveList(string directory, vector<string> *list)
 		if(!(ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
 			list->push_back(directory + ToUTF8(ffd.cFileName));
 		else
-			RecursiveList(directory + ToUTF8(ffd.cFileName) + '/', list);
+			RecursiveList(directory + ToUTF8(ffd.cFileName) + '/', list, directories);
 	} while(FindNextFileW(hFind, &ffd));
 	
 	FindClose(hFind);
@@ -387,17 +511,30 @@ void Files::RecursiveList(string directory, vector<string> *list)
 			continue;
 		
 		string name = directory + ent->d_name;
-		// Don't assume that this operating system's implementation of dirent
-		// includes the t_type field; in particular, on Windows it will not.
-		struct stat buf;
-		stat(name.c_str(), &buf);
-		bool isRegularFile = S_ISREG(buf.st_mode);
-		bool isDirectory = S_ISDIR(buf.st_mode);
+		// Where dirent includes the d_type field, use it to avoid a stat() call
+		// for every file. Some file systems do not fill it in, though, and on
+		// others (e.g. MinGW) the field does not exist at all.
+		bool isRegularFile = false;
+		bool isDirectory = false;
+#if defined DT_UNKNOWN
+		if(ent->d_type != DT_UNKNOWN && ent->d_type != DT_LNK)
+		{
+			isRegularFile = (ent->d_type == DT_REG);
+			isDirectory = (ent->d_type == DT_DIR);
+		}
+		else
+#endif
+		{
+			struct stat buf;
+			stat(name.c_str(), &buf);
+			isRegularFile = S_ISREG(buf.st_mode);
+			isDirectory = S_ISDIR(buf.st_mode);
+		}
 		
 		if(isRegularFile)
 			list->push_back(name);
 		else if(isDirectory)
-			RecursiveList(name + '/', list);
+			RecursiveList(name + '/', list, directories);
 	}
 	
 	closedir(dir);
@@ -444,6 +581,18 @@ void Files::Copy(const string &from, const string &to)
 
 
 
+// Rename a file, replacing any file that already has the new name.
+void Files::Move(const string &from, const string &to)
+{
+#if defined _WIN32
+	MoveFileExW(ToUTF16(from).c_str(), ToUTF16(to).c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+	rename(from.c_str(), to.c_str());
+#endif
+}
+
+
+
 void Files::Delete(const string &filePath)
 {
 #if defined _WIN32
@@ -528,6 +677,114 @@ void Files::Write(FILE *file, const string &data)
 
 
 
+// Write the given data exactly as is, without converting line endings.
+void Files::WriteBinary(const string &path, const string &data)
+{
+#if defined _WIN32
+	FILE *file = _wfopen(ToUTF16(path).c_str(), L"wb");
+#else
+	FILE *file = fopen(path.c_str(), "wb");
+#endif
+	if(!file)
+		return;
+	
+	Write(file, data);
+	fclose(file);
+}
+
+
+
+// Write the given data exactly as is, to a temporary file that is then
+// moved into place, so a partially written file is never mistaken for a
+// complete one.
+void Files::WriteAtomically(const string &path, const string &data)
+{
+	string tempPath = path + ".tmp";
+	WriteBinary(tempPath, data);
+	Move(tempPath, path);
+}
+
+
+
+// Add the given data to the end of a file, without converting line endings.
+void Files::Append(const string &path, const string &data)
+{
+#if defined _WIN32
+	FILE *file = _wfopen(ToUTF16(path).c_str(), L"ab");
+#else
+	FILE *file = fopen(path.c_str(), "ab");
+#endif
+	if(!file)
+		return;
+	
+	Write(file, data);
+	fclose(file);
+}
+
+
+
+// Compress the given data in the gzip format.
+string Files::Compress(const string &data)
+{
+	z_stream stream = {};
+	// Adding 16 to the window bits makes zlib write a gzip header, so the
+	// saved files can be opened with the usual tools.
+	if(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return data;
+	
+	string result(deflateBound(&stream, data.size()), '\0');
+	stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+	stream.avail_in = data.size();
+	stream.next_out = reinterpret_cast<Bytef *>(&result[0]);
+	stream.avail_out = result.size();
+	int status = deflate(&stream, Z_FINISH);
+	result.resize(stream.total_out);
+	deflateEnd(&stream);
+	
+	return (status == Z_STREAM_END) ? result : data;
+}
+
+
+
+// Check whether the given data begins with the gzip "magic number."
+bool Files::IsCompressed(const char *begin, const char *end)
+{
+	return (end - begin >= 2 && static_cast<unsigned char>(begin[0]) == 0x1F
+		&& static_cast<unsigned char>(begin[1]) == 0x8B);
+}
+
+
+
+// Decompress data that is in the gzip format.
+string Files::Decompress(const char *begin, const char *end)
+{
+	string result;
+	z_stream stream = {};
+	if(inflateInit2(&stream, 15 + 16) != Z_OK)
+		return result;
+	
+	// Text usually compresses to a fifth of its size or less, so start with a
+	// buffer large enough that it will rarely need to grow.
+	result.resize(5 * (end - begin) + 4096);
+	stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(begin));
+	stream.avail_in = end - begin;
+	int status = Z_OK;
+	while(status == Z_OK)
+	{
+		if(stream.total_out == result.size())
+			result.resize(2 * result.size());
+		stream.next_out = reinterpret_cast<Bytef *>(&result[stream.total_out]);
+		stream.avail_out = result.size() - stream.total_out;
+		status = inflate(&stream, Z_NO_FLUSH);
+	}
+	result.resize(status == Z_STREAM_END ? stream.total_out : 0);
+	inflateEnd(&stream);
+	
+	return result;
+}
+
+
+
 void Files::LogError(const string &message)
 {
 	lock_guard<mutex> lock(errorMutex);
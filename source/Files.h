@@ -37,19 +37,26 @@ public:
 	static const std::string &Images();
 	static const std::string &Sounds();
 	static const std::string &Saves();
+	// Directory for data that can be regenerated if it is missing or stale.
+	static const std::string &Cache();
 	
 	// Get a list of all regular files in the given directory.
 	static std::vector<std::string> List(std::string directory);
 	// Get a list of any directories in the given directory.
 	static std::vector<std::string> ListDirectories(std::string directory);
 	// Get a list of all regular files in the given directory or any directory
-	// that it contains, recursively.
+	// that it contains, recursively. If nothing in the directory tree has changed
+	// since the last time it was listed, the list is read from the cache instead.
 	static std::vector<std::string> RecursiveList(const std::string &directory);
-	static void RecursiveList(std::string directory, std::vector<std::string> *list);
+	// Add every regular file in the given directory tree to the given list, and if
+	// a list of directories is given, add each directory in the tree to it.
+	static void RecursiveList(std::string directory, std::vector<std::string> *list, std::vector<std::string> *directories = nullptr);
 	
 	static bool Exists(const std::string &filePath);
 	static std::time_t Timestamp(const std::string &filePath);
 	static void Copy(const std::string &from, const std::string &to);
+	// Rename a file, replacing any file that already has the new name.
+	static void Move(const std::string &from, const std::string &to);
 	static void Delete(const std::string &filePath);
 	
 	// Get the filename from a path.
@@ -61,6 +68,20 @@ public:
 	static std::string Read(FILE *file);
 	static void Write(const std::string &path, const std::string &data);
 	static void Write(FILE *file, const std::string &data);
+	// Write the given data exactly as is, without converting line endings.
+	static void WriteBinary(const std::string &path, const std::string &data);
+	// Write the given data exactly as is, to a temporary file that is then
+	// moved into place, so a partially written file is never mistaken for a
+	// complete one.
+	static void WriteAtomically(const std::string &path, const std::string &data);
+	// Add the given data to the end of a file, creating it if necessary.
+	static void Append(const std::string &path, const std::string &data);
+	
+	// Compress data in the gzip format, or check for and undo that compression.
+	// If the data cannot be decompressed, this returns an empty string.
+	static std::string Compress(const std::string &data);
+	static bool IsCompressed(const char *begin, const char *end);
+	static std::string Decompress(const char *begin, const char *end);
 	
 	static void LogError(const std::string &message);
 };
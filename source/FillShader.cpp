@@ -16,20 +16,34 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Point.h"
 #include "Screen.h"
 #include "Shader.h"
+#include "StreamBuffer.h"
 
 #include <stdexcept>
+#include <vector>
 
 using namespace std;
 
 namespace {
 	Shader shader;
 	GLint scaleI;
-	GLint centerI;
-	GLint sizeI;
+	
+	GLint vertI;
 	GLint colorI;
 	
 	GLuint vao;
-	GLuint vbo;
+	
+	// Each rectangle is drawn as two triangles, with its corners in screen
+	// coordinates followed by its color.
+	const int FLOATS = 6;
+	const GLfloat CORNERS[12] = {
+		-.5f, -.5f,
+		 .5f, -.5f,
+		-.5f,  .5f,
+		 .5f, -.5f,
+		-.5f,  .5f,
+		 .5f,  .5f
+	};
+	vector<GLfloat> vertices;
 }
 
 
@@ -38,76 +52,92 @@ void FillShader::Init()
 {
 	static const char *vertexCode =
 		"uniform vec2 scale;\n"
-		"uniform vec2 center;\n"
-		"uniform vec2 size;\n"
 		
 		"in vec2 vert;\n"
+		"in vec4 color;\n"
+		"flat out vec4 fillColor;\n"
 		
 		"void main() {\n"
-		"  gl_Position = vec4((center + vert * size) * scale, 0, 1);\n"
+		"  fillColor = color;\n"
+		"  gl_Position = vec4(vert * scale, 0, 1);\n"
 		"}\n";
 
 	static const char *fragmentCode =
-		"uniform vec4 color = vec4(1, 1, 1, 1);\n"
-		
+		"flat in vec4 fillColor;\n"
 		"out vec4 finalColor;\n"
 		
 		"void main() {\n"
-		"  finalColor = color;\n"
+		"  finalColor = fillColor;\n"
 		"}\n";
 	
 	shader = Shader(vertexCode, fragmentCode);
 	scaleI = shader.Uniform("scale");
-	centerI = shader.Uniform("center");
-	sizeI = shader.Uniform("size");
-	colorI = shader.Uniform("color");
 	
-	// Generate the vertex data for drawing sprites.
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	vertI = shader.Attrib("vert");
+	colorI = shader.Attrib("color");
 	
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	
-	GLfloat vertexData[] = {
-		-.5f, -.5f,
-		 .5f, -.5f,
-		-.5f,  .5f,
-		 .5f,  .5f
-	};
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertexData), vertexData, GL_STATIC_DRAW);
+	// The vertex data is streamed in each time something is filled, so the VAO
+	// only needs to remember which attributes are enabled.
+	glGenVertexArrays(1, &vao);
+}
+
+
+
+void FillShader::Fill(const Point &center, const Point &size, const Color &color)
+{
+	Bind();
 	
-	glEnableVertexAttribArray(shader.Attrib("vert"));
-	glVertexAttribPointer(shader.Attrib("vert"), 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), nullptr);
+	Add(center, size, color);
 	
-	// unbind the VBO and VAO
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	Unbind();
 }
 
 
 
-void FillShader::Fill(const Point &center, const Point &size, const Color &color)
+void FillShader::Bind()
 {
 	if(!shader.Object())
-		throw runtime_error("FillShader: Draw() called before Init().");
+		throw runtime_error("FillShader: Bind() called before Init().");
+	
+	vertices.clear();
+}
+
+
+
+void FillShader::Add(const Point &center, const Point &size, const Color &color)
+{
+	const float *c = color.Get();
+	for(int i = 0; i < 12; i += 2)
+	{
+		Point corner = center + Point(CORNERS[i] * size.X(), CORNERS[i + 1] * size.Y());
+		vertices.push_back(corner.X());
+		vertices.push_back(corner.Y());
+		vertices.insert(vertices.end(), c, c + 4);
+	}
+}
+
+
+
+void FillShader::Unbind()
+{
+	if(vertices.empty())
+		return;
 	
-	glUseProgram(shader.Object());
-	glBindVertexArray(vao);
+	shader.Use();
+	Shader::BindVertexArray(vao);
 	
 	GLfloat scale[2] = {2.f / Screen::Width(), -2.f / Screen::Height()};
 	glUniform2fv(scaleI, 1, scale);
 	
-	GLfloat centerV[2] = {static_cast<float>(center.X()), static_cast<float>(center.Y())};
-	glUniform2fv(centerI, 1, centerV);
-	
-	GLfloat sizeV[2] = {static_cast<float>(size.X()), static_cast<float>(size.Y())};
-	glUniform2fv(sizeI, 1, sizeV);
-	
-	glUniform4fv(colorI, 1, color.Get());
+	GLintptr start = StreamBuffer::Upload(vertices.data(), vertices.size() * sizeof(GLfloat));
+	glEnableVertexAttribArray(vertI);
+	glVertexAttribPointer(vertI, 2, GL_FLOAT, GL_FALSE, FLOATS * sizeof(GLfloat),
+		(const GLvoid*)(start));
+	glEnableVertexAttribArray(colorI);
+	glVertexAttribPointer(colorI, 4, GL_FLOAT, GL_FALSE, FLOATS * sizeof(GLfloat),
+		(const GLvoid*)(start + 2 * sizeof(GLfloat)));
+	glDrawArrays(GL_TRIANGLES, 0, vertices.size() / FLOATS);
 	
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	
-	glBindVertexArray(0);
-	glUseProgram(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	vertices.clear();
 }
@@ -26,6 +26,10 @@ public:
 	static void Init();
 	
 	static void Fill(const Point &center, const Point &size, const Color &color);
+	
+	static void Bind();
+	static void Add(const Point &center, const Point &size, const Color &color);
+	static void Unbind();
 };
 
 
@@ -0,0 +1,186 @@
+/* FlatMap.h
+Copyright (c) 2017 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef FLAT_MAP_H_
+#define FLAT_MAP_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+
+
+// A FlatMap works like a std::map, and iterates over its entries in the same
+// order, but it stores them in a single sorted vector. That makes it much
+// faster to copy and to iterate over, at the cost of slower insertion into a
+// large map. It is meant for the small maps that describe a ship's outfits or
+// cargo, which are copied and iterated over far more often than they change.
+// Unlike a std::map, adding or removing an entry invalidates all iterators and
+// references into the map.
+template <class Key, class Value>
+class FlatMap {
+public:
+	typedef Key key_type;
+	typedef Value mapped_type;
+	typedef std::pair<Key, Value> value_type;
+	typedef typename std::vector<value_type>::iterator iterator;
+	typedef typename std::vector<value_type>::const_iterator const_iterator;
+	
+public:
+	FlatMap() = default;
+	FlatMap(std::initializer_list<value_type> init);
+	
+	iterator begin() { return entries.begin(); }
+	iterator end() { return entries.end(); }
+	const_iterator begin() const { return entries.begin(); }
+	const_iterator end() const { return entries.end(); }
+	
+	bool empty() const { return entries.empty(); }
+	std::size_t size() const { return entries.size(); }
+	void clear() { entries.clear(); }
+	
+	// Find the entry with the given key, or end() if there is none.
+	iterator find(const Key &key);
+	const_iterator find(const Key &key) const;
+	std::size_t count(const Key &key) const;
+	// Find the first entry whose key is not less than the given key.
+	iterator lower_bound(const Key &key);
+	const_iterator lower_bound(const Key &key) const;
+	
+	// Get the value with the given key, inserting a default one if necessary.
+	Value &operator[](const Key &key);
+	// Insert the given entry if its key is not already present.
+	std::pair<iterator, bool> insert(const value_type &value);
+	std::pair<iterator, bool> emplace(const Key &key, const Value &value);
+	
+	// Remove an entry, returning an iterator to the entry after it.
+	iterator erase(const_iterator it);
+	std::size_t erase(const Key &key);
+	
+	bool operator==(const FlatMap &other) const { return entries == other.entries; }
+	bool operator!=(const FlatMap &other) const { return entries != other.entries; }
+	
+	
+private:
+	static bool Less(const value_type &entry, const Key &key) { return std::less<Key>()(entry.first, key); }
+	
+	
+private:
+	std::vector<value_type> entries;
+};
+
+
+
+template <class Key, class Value>
+FlatMap<Key, Value>::FlatMap(std::initializer_list<value_type> init)
+{
+	for(const value_type &value : init)
+		insert(value);
+}
+
+
+
+template <class Key, class Value>
+typename FlatMap<Key, Value>::iterator FlatMap<Key, Value>::find(const Key &key)
+{
+	iterator it = lower_bound(key);
+	return (it == entries.end() || std::less<Key>()(key, it->first)) ? entries.end() : it;
+}
+
+
+
+template <class Key, class Value>
+typename FlatMap<Key, Value>::const_iterator FlatMap<Key, Value>::find(const Key &key) const
+{
+	const_iterator it = lower_bound(key);
+	return (it == entries.end() || std::less<Key>()(key, it->first)) ? entries.end() : it;
+}
+
+
+
+template <class Key, class Value>
+std::size_t FlatMap<Key, Value>::count(const Key &key) const
+{
+	return find(key) != entries.end();
+}
+
+
+
+template <class Key, class Value>
+typename FlatMap<Key, Value>::iterator FlatMap<Key, Value>::lower_bound(const Key &key)
+{
+	return std::lower_bound(entries.begin(), entries.end(), key, Less);
+}
+
+
+
+template <class Key, class Value>
+typename FlatMap<Key, Value>::const_iterator FlatMap<Key, Value>::lower_bound(const Key &key) const
+{
+	return std::lower_bound(entries.begin(), entries.end(), key, Less);
+}
+
+
+
+template <class Key, class Value>
+Value &FlatMap<Key, Value>::operator[](const Key &key)
+{
+	return emplace(key, Value()).first->second;
+}
+
+
+
+template <class Key, class Value>
+std::pair<typename FlatMap<Key, Value>::iterator, bool> FlatMap<Key, Value>::insert(const value_type &value)
+{
+	return emplace(value.first, value.second);
+}
+
+
+
+template <class Key, class Value>
+std::pair<typename FlatMap<Key, Value>::iterator, bool> FlatMap<Key, Value>::emplace(const Key &key, const Value &value)
+{
+	iterator it = lower_bound(key);
+	if(it != entries.end() && !std::less<Key>()(key, it->first))
+		return std::make_pair(it, false);
+	
+	return std::make_pair(entries.emplace(it, key, value), true);
+}
+
+
+
+template <class Key, class Value>
+typename FlatMap<Key, Value>::iterator FlatMap<Key, Value>::erase(const_iterator it)
+{
+	return entries.erase(it);
+}
+
+
+
+template <class Key, class Value>
+std::size_t FlatMap<Key, Value>::erase(const Key &key)
+{
+	iterator it = find(key);
+	if(it == entries.end())
+		return 0;
+	
+	entries.erase(it);
+	return 1;
+}
+
+
+
+#endif
@@ -19,6 +19,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Phrase.h"
 #include "pi.h"
 #include "Planet.h"
+#include "PoolAllocator.h"
 #include "Random.h"
 #include "Ship.h"
 #include "StellarObject.h"
@@ -322,6 +323,20 @@ int64_t Fleet::Strength() const
 
 
 
+// Get every ship model that may appear in this fleet.
+vector<const Ship *> Fleet::ShipModels() const
+{
+	vector<const Ship *> models;
+	for(const Variant &variant : variants)
+		models.insert(models.end(), variant.ships.begin(), variant.ships.end());
+	
+	sort(models.begin(), models.end());
+	models.erase(unique(models.begin(), models.end()), models.end());
+	return models;
+}
+
+
+
 Fleet::Variant::Variant(const DataNode &node)
 {
 	weight = (node.Size() < 2) ? 1 : static_cast<int>(node.Value(1));
@@ -374,7 +389,7 @@ vector<shared_ptr<Ship>> Fleet::Instantiate(const Variant &variant) const
 			continue;
 		}
 		
-		shared_ptr<Ship> ship(new Ship(*model));
+		shared_ptr<Ship> ship = allocate_shared<Ship>(PoolAllocator<Ship>(), *model);
 		
 		bool isFighter = ship->CanBeCarried();
 		const Phrase *phrase = ((isFighter && fighterNames) ? fighterNames : names);
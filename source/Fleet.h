@@ -51,6 +51,8 @@ public:
 	static void Place(const System &system, Ship &ship);
 	
 	int64_t Strength() const;
+	// Get every ship model that may appear in this fleet.
+	std::vector<const Ship *> ShipModels() const;
 	
 	
 private:
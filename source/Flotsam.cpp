@@ -82,7 +82,7 @@ void Flotsam::Place(const Body &source, const Point &dv)
 
 
 // Move the object one time-step forward.
-bool Flotsam::Move(list<Effect> &effects)
+bool Flotsam::Move(vector<Effect> &effects)
 {
 	position += velocity;
 	angle += spin;
@@ -91,7 +91,7 @@ bool Flotsam::Move(list<Effect> &effects)
 		return true;
 	
 	// This flotsam has reached the end of its life. 
-	const Effect *effect = GameData::Effects().Get("flotsam death");
+	static const Effect *effect = GameData::Effects().Get("flotsam death");
 	for(int i = 0; i < 3; ++i)
 	{
 		effects.push_back(*effect);
@@ -46,14 +46,14 @@ namespace {
 	GLuint vbo;
 	GLuint texture = 0;
 	
-	// Keep track of the previous frame's view so that if it is unchanged we can
-	// skip regenerating the mask.
-	double previousZoom = 0.;
-	double previousLeft = 0.;
-	double previousTop = 0.;
-	int previousColumns = 0;
-	int previousRows = 0;
-	Point previousCenter;
+	// The mask covers the part of the galaxy around the systems the player has
+	// visited, one pixel per GRID units of map space, so it does not depend on
+	// how the map is panned or zoomed. It only needs to be generated again
+	// when the player's knowledge of the map changes.
+	int previousVersion = -1;
+	Point origin;
+	int columns = 0;
+	int rows = 0;
 }
 
 
@@ -87,13 +87,12 @@ void FogShader::Init()
 	cornerI = shader.Uniform("corner");
 	dimensionsI = shader.Uniform("dimensions");
 	
-	glUseProgram(shader.Object());
+	shader.Use();
 	glUniform1i(shader.Uniform("tex"), 0);
-	glUseProgram(0);
 	
 	// Generate the vertex data for drawing sprites.
 	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	Shader::BindVertexArray(vao);
 	
 	glGenBuffers(1, &vbo);
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
@@ -113,65 +112,63 @@ void FogShader::Init()
 	
 	// Unbind the VBO and VAO.
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	Shader::BindVertexArray(0);
 }
 
 
 
 void FogShader::Redraw()
 {
-	previousZoom = 0.;
+	previousVersion = -1;
 }
 
 
 
 void FogShader::Draw(const Point &center, double zoom, const PlayerInfo &player)
 {
-	// Generate a scaled-down mask image that represents the entire screen plus
-	// enough pixels beyond the screen to include any systems that may be off
-	// screen but close enough to "illuminate" part of the on-screen map.
-	double left = Screen::Left() - GRID * PAD * zoom + fmod(center.X(), GRID) * zoom;
-	double top = Screen::Top() - GRID * PAD * zoom + fmod(center.Y(), GRID) * zoom;
-	int columns = ceil(Screen::Width() / (GRID * zoom)) + 1 + 2 * PAD;
-	int rows = ceil(Screen::Height() / (GRID * zoom)) + 1 + 2 * PAD;
-	// Round up to a multiple of 4 so the rows will be 32-bit aligned.
-	columns = (columns + 3) & ~3;
-	
-	// To avoid extra work, don't regenerate the mask buffer if the view has not
-	// moved. This might cause an inaccurate mask if you explore more systems,
-	// come back to the original, and view the map again without viewing it in
-	// between. But, that's an unlikely situation.
-	bool shouldRegenerate = (
-		zoom != previousZoom || center.X() != previousCenter.X() || center.Y() != previousCenter.Y() ||
-		left != previousLeft || top != previousTop || columns != previousColumns || rows != previousRows);
-	if(shouldRegenerate)
+	if(player.KnowledgeVersion() != previousVersion || !texture)
 	{
-		bool sizeChanged = (!texture || columns != previousColumns || rows != previousRows);
+		previousVersion = player.KnowledgeVersion();
 		
-		// Remember the current viewport attributes.
-		previousZoom = zoom;
-		previousCenter = center;
-		previousLeft = left;
-		previousTop = top;
-		previousColumns = columns;
-		previousRows = rows;
-		
-		// This buffer will hold the mask image.
-		vector<unsigned char> buffer(rows * columns, LIMIT);
-	
-		// For each system the player knows about, its "distance" pixel in the
-		// buffer should be set to 0.
+		// Find the bounds of the systems the player has visited, in grid cells.
+		// Add enough padding around them that the edge of the mask is farther
+		// than LIMIT from any of them, so that beyond the edges (which the
+		// texture clamps to) everything is fully fogged.
+		vector<Point> known;
 		for(const auto &it : GameData::Systems())
 		{
 			const System &system = it.second;
-			if(system.Name().empty() || !player.HasVisited(&system))
-				continue;
-			Point pos = zoom * (system.Position() + center);
+			if(!system.Name().empty() && player.HasVisited(&system))
+				known.push_back(Point(round(system.Position().X() / GRID), round(system.Position().Y() / GRID)));
+		}
+		Point low;
+		Point high;
+		if(!known.empty())
+		{
+			low = known.front();
+			high = known.front();
+			for(const Point &point : known)
+			{
+				low = min(low, point);
+				high = max(high, point);
+			}
+		}
+		low -= Point(PAD, PAD);
+		high += Point(PAD, PAD);
+		origin = low * GRID;
+		columns = static_cast<int>(high.X() - low.X()) + 1;
+		rows = static_cast<int>(high.Y() - low.Y()) + 1;
+		// Round up to a multiple of 4 so the rows will be 32-bit aligned.
+		columns = (columns + 3) & ~3;
 		
-			int x = round((pos.X() - left) / (GRID * zoom));
-			int y = round((pos.Y() - top) / (GRID * zoom));
-			if(x >= 0 && y >= 0 && x < columns && y < rows)
-				buffer[x + y * columns] = 0;
+		// This buffer will hold the mask image. For each system the player
+		// knows about, its "distance" pixel in the buffer should be set to 0.
+		vector<unsigned char> buffer(rows * columns, LIMIT);
+		for(const Point &point : known)
+		{
+			int x = point.X() - low.X();
+			int y = point.Y() - low.Y();
+			buffer[x + y * columns] = 0;
 		}
 	
 		// Distance transformation: make two passes through the buffer. In the first
@@ -195,50 +192,46 @@ void FogShader::Draw(const Point &center, double zoom, const PlayerInfo &player)
 		const void *data = &buffer.front();
 		
 		// Set up the OpenGL texture if it doesn't exist yet.
-		if(sizeChanged)
+		if(!texture)
 		{
-			// If the texture size changed, it must be reallocated.
-			if(texture)
-				glDeleteTextures(1, &texture);
-			
 			glGenTextures(1, &texture);
 			glBindTexture(GL_TEXTURE_2D, texture);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			
-			// Upload the new "image."
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, columns, rows, 0, GL_RED, GL_UNSIGNED_BYTE, data);
 		}
 		else
-		{
 			glBindTexture(GL_TEXTURE_2D, texture);
-			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, columns, rows, GL_RED, GL_UNSIGNED_BYTE, data);
-		}
+		
+		// Upload the new "image." It is small, so just reallocate it each time.
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, columns, rows, 0, GL_RED, GL_UNSIGNED_BYTE, data);
 	}
 	else
 		glBindTexture(GL_TEXTURE_2D, texture);
 	
+	// Each pixel of the mask is centered on a multiple of GRID in map space, so
+	// the image starts half a pixel before the origin. Panning and zooming just
+	// move and scale it.
+	Point corner = zoom * (origin - Point(.5 * GRID, .5 * GRID) + center);
+	
 	// Set up to draw the image.
-	glUseProgram(shader.Object());
-	glBindVertexArray(vao);
+	shader.Use();
+	Shader::BindVertexArray(vao);
 	glActiveTexture(GL_TEXTURE0);
 	
-	GLfloat corner[2] = {
-		static_cast<float>((left - .5f * GRID * zoom) / (.5f * Screen::Width())),
-		static_cast<float>((top - .5f * GRID * zoom) / (-.5f * Screen::Height()))};
-	glUniform2fv(cornerI, 1, corner);
+	GLfloat cornerV[2] = {
+		static_cast<float>(corner.X() / (.5 * Screen::Width())),
+		static_cast<float>(corner.Y() / (-.5 * Screen::Height()))};
+	glUniform2fv(cornerI, 1, cornerV);
 	GLfloat dimensions[2] = {
-		static_cast<float>(GRID * zoom * (columns + 1.f) / (.5f * Screen::Width())),
-		static_cast<float>(GRID * zoom * (rows + 1.f) / (-.5f * Screen::Height()))};
+		static_cast<float>(GRID * zoom * columns / (.5 * Screen::Width())),
+		static_cast<float>(GRID * zoom * rows / (-.5 * Screen::Height()))};
 	glUniform2fv(dimensionsI, 1, dimensions);
 	
 	// Call the shader program to draw the image.
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 	
 	// Clean up.
-	glBindVertexArray(0);
-	glUseProgram(0);
 	glBindTexture(GL_TEXTURE_2D, 0);
 }
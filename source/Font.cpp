@@ -16,7 +16,10 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "ImageBuffer.h"
 #include "Point.h"
 #include "Screen.h"
+#include "Shader.h"
+#include "StreamBuffer.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
@@ -29,24 +32,24 @@ namespace {
 	static const char *vertexCode =
 		// "scale" maps pixel coordinates to GL coordinates (-1 to 1).
 		"uniform vec2 scale;\n"
-		// The (x, y) coordinates of the top left corner of the glyph.
+		// The (x, y) coordinates of the top left corner of the string.
 		"uniform vec2 position;\n"
-		// The glyph to draw. (ASCII value - 32).
-		"uniform int glyph;\n"
-		// Aspect ratio of rendered glyph (unity by default).
-		"uniform float aspect = 1.f;\n"
 		
-		// Inputs from the VBO.
+		// The part of the atlas this font is in: its width, and the top and
+		// height of its row, all as fractions of the atlas size.
+		"uniform vec3 atlas;\n"
+		
+		// Inputs from the VBO: the position of this vertex relative to the
+		// start of the string, and the texture coordinates of its glyph.
 		"in vec2 vert;\n"
-		"in vec2 corner;\n"
+		"in vec2 vertTexCoord;\n"
 		
 		// Output to the fragment shader.
 		"out vec2 texCoord;\n"
 		
-		// Pick the proper glyph out of the texture.
 		"void main() {\n"
-		"  texCoord = vec2((glyph + corner.x) / 98.f, corner.y);\n"
-		"  gl_Position = vec4((aspect * vert.x + position.x) * scale.x, (vert.y + position.y) * scale.y, 0, 1);\n"
+		"  texCoord = vec2(vertTexCoord.x * atlas.x, atlas.y + vertTexCoord.y * atlas.z);\n"
+		"  gl_Position = vec4((vert + position) * scale, 0, 1);\n"
 		"}\n";
 	
 	static const char *fragmentCode =
@@ -60,19 +63,187 @@ namespace {
 		// Output color.
 		"out vec4 finalColor;\n"
 		
-		// Multiply the texture by the user-specified color (including alpha).
+		// The texture holds the distance to the edge of the glyph, with .5 being
+		// right on the edge. Fade from transparent to opaque over the width of
+		// one screen pixel, whatever scale the text is being drawn at.
 		"void main() {\n"
-		"  finalColor = texture(tex, texCoord).a * color;\n"
+		"  float distance = texture(tex, texCoord).r;\n"
+		"  float width = max(.5 * fwidth(distance), .001);\n"
+		"  finalColor = smoothstep(.5 - width, .5 + width, distance) * color;\n"
 		"}\n";
 	
+	// Each glyph is drawn as two triangles, with four floats per vertex.
+	static const GLfloat CORNERS[12] = {
+		0.f, 0.f,
+		0.f, 1.f,
+		1.f, 0.f,
+		0.f, 1.f,
+		1.f, 0.f,
+		1.f, 1.f
+	};
+	static const int FLOATS = 4;
+	
+	// Once this many strings are cached, start a new cache.
+	static const size_t CACHE_SIZE = 500;
+	
 	static const int KERN = 2;
+	
+	// Distances are stored out to this many texels from the edge of a glyph.
+	static const int RADIUS = 4;
+	
+	// Every font is drawn with the same shader, and the distance fields for all
+	// of them are stacked in rows of the same texture.
+	Shader shader;
+	GLuint vao = 0;
+	GLuint texture = 0;
+	
+	GLint colorI = 0;
+	GLint scaleI = 0;
+	GLint positionI = 0;
+	GLint atlasI = 0;
+	GLint vertI = 0;
+	GLint texCoordI = 0;
+	
+	int screenWidth = 0;
+	int screenHeight = 0;
+	
+	class Field {
+	public:
+		int width;
+		int height;
+		// Where this field's row begins in the atlas.
+		int y;
+		vector<unsigned char> data;
+	};
+	vector<Field> fields;
+	int atlasWidth = 0;
+	int atlasHeight = 0;
+	
+	// Convert the alpha channel of a font image into a signed distance field.
+	// Each texel stores its distance to the nearest edge of its glyph, scaled
+	// so that 0 is RADIUS texels outside, 255 is RADIUS texels inside, and the
+	// edge itself is halfway between.
+	Field DistanceField(const ImageBuffer &image, int glyphs)
+	{
+		Field field;
+		field.width = image.Width();
+		field.height = image.Height();
+		field.y = 0;
+		field.data.resize(field.width * field.height);
+		int cellWidth = field.width / glyphs;
+		
+		const uint32_t *pixels = image.Pixels();
+		auto alpha = [&pixels, &field](int x, int y) -> int
+		{
+			return pixels[x + y * field.width] >> 24;
+		};
+		
+		for(int y = 0; y < field.height; ++y)
+			for(int x = 0; x < field.width; ++x)
+			{
+				int a = alpha(x, y);
+				bool isInside = (a >= 128);
+				
+				double distance;
+				if(a > 0 && a < 255)
+				{
+					// Antialiased texels are on the edge, so their coverage is a
+					// better estimate of the distance than the search below.
+					distance = (a - 127.5) / 255.;
+				}
+				else
+				{
+					// Search the nearby texels (within this glyph's cell) for the
+					// closest one on the other side of the edge.
+					int cellLeft = cellWidth ? (x / cellWidth) * cellWidth : 0;
+					int cellRight = cellWidth ? min(field.width, cellLeft + cellWidth) : field.width;
+					int best = RADIUS * RADIUS + 1;
+					for(int dy = -RADIUS; dy <= RADIUS; ++dy)
+						for(int dx = -RADIUS; dx <= RADIUS; ++dx)
+						{
+							int nx = x + dx;
+							int ny = y + dy;
+							if(nx < cellLeft || nx >= cellRight || ny < 0 || ny >= field.height)
+								continue;
+							int d = dx * dx + dy * dy;
+							if(d < best && (alpha(nx, ny) >= 128) != isInside)
+								best = d;
+						}
+					distance = sqrt(best) - .5;
+					if(!isInside)
+						distance = -distance;
+				}
+				double value = .5 + distance / (2. * RADIUS);
+				field.data[x + y * field.width] = max(0, min(255, static_cast<int>(value * 255. + .5)));
+			}
+		return field;
+	}
+	
+	// Stack all the distance fields into one texture.
+	void UploadAtlas()
+	{
+		atlasWidth = 0;
+		atlasHeight = 0;
+		for(Field &field : fields)
+		{
+			field.y = atlasHeight;
+			atlasHeight += field.height;
+			atlasWidth = max(atlasWidth, field.width);
+		}
+		
+		vector<unsigned char> data(atlasWidth * atlasHeight, 0);
+		for(const Field &field : fields)
+			for(int y = 0; y < field.height; ++y)
+				copy(field.data.begin() + y * field.width, field.data.begin() + (y + 1) * field.width,
+					data.begin() + (field.y + y) * atlasWidth);
+		
+		if(!texture)
+		{
+			glGenTextures(1, &texture);
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+		else
+			glBindTexture(GL_TEXTURE_2D, texture);
+		
+		// The rows of a one-byte-per-texel image are not padded.
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlasWidth, atlasHeight, 0,
+			GL_RED, GL_UNSIGNED_BYTE, data.data());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+	
+	void SetUpShader()
+	{
+		if(shader.Object())
+			return;
+		
+		shader = Shader(vertexCode, fragmentCode);
+		shader.Use();
+		
+		// The glyph vertices are streamed in each time a string is drawn, so the
+		// VAO only needs to remember which attributes are enabled.
+		glGenVertexArrays(1, &vao);
+		
+		// The texture always comes from texture unit 0.
+		glUniform1ui(shader.Uniform("tex"), 0);
+		
+		colorI = shader.Uniform("color");
+		scaleI = shader.Uniform("scale");
+		positionI = shader.Uniform("position");
+		atlasI = shader.Uniform("atlas");
+		vertI = shader.Attrib("vert");
+		texCoordI = shader.Attrib("vertTexCoord");
+	}
 }
 
 
 
 Font::Font()
-	: texture(0), vao(0), vbo(0), colorI(0), scaleI(0), glyphI(0), aspectI(0),
-	  positionI(0), height(0), space(0), screenWidth(0), screenHeight(0)
+	: field(-1), glyphWidth(0.f), glyphHeight(0.f), cacheUnderlines(false), height(0), space(0)
 {
 }
 
@@ -88,16 +259,26 @@ Font::Font(const string &imagePath)
 
 void Font::Load(const string &imagePath)
 {
-	// Load the texture.
+	// Load the glyph image.
 	ImageBuffer *image = ImageBuffer::Read(imagePath);
 	if(!image)
 		return;
 	
-	LoadTexture(image);
+	// The glyph images are drawn at half size.
+	glyphWidth = .5f * (image->Width() / GLYPHS);
+	glyphHeight = .5f * image->Height();
 	CalculateAdvances(image);
-	SetUpShader(image->Width() / GLYPHS, image->Height());
 	
+	field = fields.size();
+	fields.push_back(DistanceField(*image, GLYPHS));
 	delete image;
+	
+	SetUpShader();
+	UploadAtlas();
+	
+	// We must update the screen size next time we draw.
+	screenWidth = 0;
+	screenHeight = 0;
 }
 
 
@@ -111,12 +292,22 @@ void Font::Draw(const string &str, const Point &point, const Color &color) const
 
 void Font::DrawAliased(const string &str, double x, double y, const Color &color) const
 {
-	glUseProgram(shader.Object());
+	const vector<GLfloat> &vertices = Layout(str);
+	if(vertices.empty() || field < 0)
+		return;
+	
+	shader.Use();
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, texture);
-	glBindVertexArray(vao);
+	Shader::BindVertexArray(vao);
 	
 	glUniform4fv(colorI, 1, color.Get());
+	const Field &glyphs = fields[field];
+	GLfloat atlas[3] = {
+		static_cast<float>(glyphs.width) / atlasWidth,
+		static_cast<float>(glyphs.y) / atlasHeight,
+		static_cast<float>(glyphs.height) / atlasHeight};
+	glUniform3fv(atlasI, 1, atlas);
 	
 	// Update the scale, only if the screen size has changed.
 	if(Screen::Width() != screenWidth || Screen::Height() != screenHeight)
@@ -128,52 +319,21 @@ void Font::DrawAliased(const string &str, double x, double y, const Color &color
 	}
 	
 	GLfloat textPos[2] = {
-		static_cast<float>(x - 1.),
+		static_cast<float>(x),
 		static_cast<float>(y)};
-	int previous = 0;
-	bool isAfterSpace = true;
-	bool underlineChar = false;
-	const int underscoreGlyph = max(0, min(GLYPHS - 1, '_' - 32));
+	glUniform2fv(positionI, 1, textPos);
 	
-	for(char c : str)
-	{
-		if(c == '_')
-		{
-			underlineChar = showUnderlines;
-			continue;
-		}
-		
-		int glyph = Glyph(c, isAfterSpace);
-		if(c != '"' && c != '\'')
-			isAfterSpace = !glyph;
-		if(!glyph)
-		{
-			textPos[0] += space;
-			continue;
-		}
-		
-		glUniform1i(glyphI, glyph);
-		glUniform1f(aspectI, 1.f);
-		
-		textPos[0] += advance[previous * GLYPHS + glyph] + KERN;
-		glUniform2fv(positionI, 1, textPos);
-		
-		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-		
-		if(underlineChar)
-		{
-			glUniform1i(glyphI, underscoreGlyph);
-			glUniform1f(aspectI, static_cast<float>(advance[glyph * GLYPHS] + KERN)
-				/ (advance[underscoreGlyph * GLYPHS] + KERN));
-			
-			glUniform2fv(positionI, 1, textPos);
-			
-			glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-			underlineChar = false;
-		}
-		
-		previous = glyph;
-	}
+	// Draw the whole string at once.
+	GLintptr start = StreamBuffer::Upload(vertices.data(), vertices.size() * sizeof(GLfloat));
+	glEnableVertexAttribArray(vertI);
+	glVertexAttribPointer(vertI, 2, GL_FLOAT, GL_FALSE, FLOATS * sizeof(GLfloat),
+		(const GLvoid*)(start));
+	glEnableVertexAttribArray(texCoordI);
+	glVertexAttribPointer(texCoordI, 2, GL_FLOAT, GL_FALSE, FLOATS * sizeof(GLfloat),
+		(const GLvoid*)(start + 2 * sizeof(GLfloat)));
+	glDrawArrays(GL_TRIANGLES, 0, vertices.size() / FLOATS);
+	
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 
@@ -316,18 +476,82 @@ int Font::Glyph(char c, bool isAfterSpace)
 
 
 
-void Font::LoadTexture(ImageBuffer *image)
+// Get the vertex data for the given string, drawn starting at (0, 0). The
+// result is only valid until the next call to Layout().
+const vector<GLfloat> &Font::Layout(const string &str) const
 {
-	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
+	// Whether underlines are shown changes the layout of any string with an
+	// underscore in it, so the cache must be thrown out.
+	if(cacheUnderlines != showUnderlines)
+	{
+		recent.clear();
+		older.clear();
+		cacheUnderlines = showUnderlines;
+	}
 	
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	auto it = recent.find(str);
+	if(it != recent.end())
+		return it->second;
 	
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image->Width(), image->Height(), 0,
-		GL_BGRA, GL_UNSIGNED_BYTE, image->Pixels());
+	if(recent.size() >= CACHE_SIZE)
+	{
+		older.swap(recent);
+		recent.clear();
+	}
+	vector<GLfloat> &vertices = recent[str];
+	it = older.find(str);
+	if(it != older.end())
+	{
+		vertices.swap(it->second);
+		older.erase(it);
+		return vertices;
+	}
+	
+	float textX = -1.f;
+	int previous = 0;
+	bool isAfterSpace = true;
+	bool underlineChar = false;
+	const int underscoreGlyph = max(0, min(GLYPHS - 1, '_' - 32));
+	
+	for(char c : str)
+	{
+		if(c == '_')
+		{
+			underlineChar = showUnderlines;
+			continue;
+		}
+		
+		int glyph = Glyph(c, isAfterSpace);
+		if(c != '"' && c != '\'')
+			isAfterSpace = !glyph;
+		if(!glyph)
+		{
+			textX += space;
+			continue;
+		}
+		
+		textX += advance[previous * GLYPHS + glyph] + KERN;
+		
+		// Add this glyph, and then an underscore stretched to its width if
+		// it is underlined.
+		for(int pass = 0; pass <= underlineChar; ++pass)
+		{
+			int drawn = pass ? underscoreGlyph : glyph;
+			float aspect = !pass ? 1.f : static_cast<float>(advance[glyph * GLYPHS] + KERN)
+				/ (advance[underscoreGlyph * GLYPHS] + KERN);
+			for(int i = 0; i < 12; i += 2)
+			{
+				vertices.push_back(textX + CORNERS[i] * glyphWidth * aspect);
+				vertices.push_back(CORNERS[i + 1] * glyphHeight);
+				vertices.push_back((drawn + CORNERS[i]) / GLYPHS);
+				vertices.push_back(CORNERS[i + 1]);
+			}
+		}
+		underlineChar = false;
+		
+		previous = glyph;
+	}
+	return vertices;
 }
 
 
@@ -392,49 +616,3 @@ void Font::CalculateAdvances(ImageBuffer *image)
 	space = (width + 3) / 6 + 1;
 }
 
-
-
-void Font::SetUpShader(float glyphW, float glyphH)
-{
-	glyphW *= .5f;
-	glyphH *= .5f;
-	
-	shader = Shader(vertexCode, fragmentCode);
-	glUseProgram(shader.Object());
-	
-	// Create the VAO and VBO.
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-	
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	
-	GLfloat vertices[] = {
-		   0.f,    0.f, 0.f, 0.f,
-		   0.f, glyphH, 0.f, 1.f,
-		glyphW,    0.f, 1.f, 0.f,
-		glyphW, glyphH, 1.f, 1.f
-	};
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-	
-	// connect the xy to the "vert" attribute of the vertex shader
-	glEnableVertexAttribArray(shader.Attrib("vert"));
-	glVertexAttribPointer(shader.Attrib("vert"), 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), nullptr);
-	
-	glEnableVertexAttribArray(shader.Attrib("corner"));
-	glVertexAttribPointer(shader.Attrib("corner"), 2, GL_FLOAT, GL_FALSE,
-		4 * sizeof(GLfloat), (const GLvoid*)(2 * sizeof(GLfloat)));
-	
-	// We must update the screen size next time we draw.
-	screenWidth = 0;
-	screenHeight = 0;
-	
-	// The texture always comes from texture unit 0.
-	glUniform1ui(shader.Uniform("tex"), 0);
-
-	colorI = shader.Uniform("color");
-	scaleI = shader.Uniform("scale");
-	glyphI = shader.Uniform("glyph");
-	aspectI = shader.Uniform("aspect");
-	positionI = shader.Uniform("position");
-}
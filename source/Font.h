@@ -13,11 +13,11 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #ifndef FONT_H_
 #define FONT_H_
 
-#include "Shader.h"
-
 #include "gl_header.h"
 
+#include <map>
 #include <string>
+#include <vector>
 
 class Color;
 class ImageBuffer;
@@ -28,7 +28,9 @@ class Point;
 // Class for drawing text in OpenGL. Each font is based on a single image with
 // glyphs for each character in ASCII order (not counting control characters).
 // The kerning between characters is automatically adjusted to look good. At the
-// moment only plain ASCII characters are supported, not Unicode.
+// moment only plain ASCII characters are supported, not Unicode. The glyphs are
+// converted to distance fields, so they stay sharp at any scale, and all the
+// fonts share one texture and one shader.
 class Font {
 public:
 	Font();
@@ -53,27 +55,25 @@ public:
 	
 private:
 	static int Glyph(char c, bool isAfterSpace);
-	void LoadTexture(ImageBuffer *image);
+	const std::vector<GLfloat> &Layout(const std::string &str) const;
 	void CalculateAdvances(ImageBuffer *image);
-	void SetUpShader(float glyphW, float glyphH);
 	
 	
 private:
-	Shader shader;
-	GLuint texture;
-	GLuint vao;
-	GLuint vbo;
+	// The index of this font's distance field in the shared texture.
+	int field;
+	
+	float glyphWidth;
+	float glyphHeight;
 	
-	GLint colorI;
-	GLint scaleI;
-	GLint glyphI;
-	GLint aspectI;
-	GLint positionI;
+	// Cache the vertex data for recently drawn strings. Strings that have not
+	// been drawn since the newer cache filled up are dropped.
+	mutable std::map<std::string, std::vector<GLfloat>> recent;
+	mutable std::map<std::string, std::vector<GLfloat>> older;
+	mutable bool cacheUnderlines;
 	
 	int height;
 	int space;
-	mutable int screenWidth;
-	mutable int screenHeight;
 	
 	static const int GLYPHS = 98;
 	int advance[GLYPHS * GLYPHS];
@@ -15,7 +15,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include <algorithm>
 #include <cctype>
 #include <cmath>
-#include <sstream>
+#include <cstdio>
 
 using namespace std;
 
@@ -23,24 +23,37 @@ using namespace std;
 
 string Format::Number(double value)
 {
+	string result;
+	Number(value, result);
+	return result;
+}
+
+
+
+// Do the same, but replace the contents of the given string with the
+// result, so a string that is reused does not need to allocate.
+void Format::Number(double value, string &result)
+{
+	result.clear();
 	if(!value)
-		return "0";
+	{
+		result += '0';
+		return;
+	}
 	
 	// Check what the power will be, after the value is rounded to five digits.
 	int power = floor(log10(fabs(value)) - log10(.999995));
 	if(power >= 15 || power <= -5)
 	{
 		// Fall back to scientific notation if the number is outside the range
-		// we can format "nicely".
-		ostringstream out;
-		out.precision(3);
-		out << value;
-		return out.str();
+		// we can format "nicely". This is the same format a stream would use
+		// with a precision of 3, but without building a stream to do it.
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%.3g", value);
+		result += buffer;
+		return;
 	}
 	
-	string result;
-	result.reserve(8);
-	
 	bool isNegative = (value < 0.);
 	bool nonzero = false;
 	
@@ -108,8 +121,6 @@ string Format::Number(double value)
 	
 	// Reverse the string.
 	reverse(result.begin(), result.end());
-	
-	return result;
 }
 
 
@@ -165,13 +176,14 @@ double Format::Parse(const string &str)
 
 
 
-string Format::Replace(const string &source, const map<string, string> keys)
+string Format::Replace(const string &source, const map<string, string> &keys)
 {
 	string result;
 	result.reserve(source.length());
 	
 	size_t start = 0;
 	size_t search = start;
+	string key;
 	while(search < source.length())
 	{
 		size_t left = source.find('<', search);
@@ -182,21 +194,18 @@ string Format::Replace(const string &source, const map<string, string> keys)
 		if(right == string::npos)
 			break;
 		
-		bool matched = false;
+		// Look up this key in the map instead of comparing it to every key.
 		++right;
-		size_t length = right - left;
-		for(const auto &it : keys)
-			if(!source.compare(left, length, it.first))
-			{
-				result.append(source, start, left - start);
-				result.append(it.second);
-				start = right;
-				search = start;
-				matched = true;
-				break;
-			}
-		
-		if(!matched)
+		key.assign(source, left, right - left);
+		auto it = keys.find(key);
+		if(it != keys.end())
+		{
+			result.append(source, start, left - start);
+			result.append(it->second);
+			start = right;
+			search = start;
+		}
+		else
 			search = left + 1;
 	}
 	
@@ -19,6 +19,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "DataFile.h"
 #include "DataNode.h"
 #include "DataWriter.h"
+#include "DistanceMap.h"
 #include "Effect.h"
 #include "Files.h"
 #include "FillShader.h"
@@ -30,6 +31,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Government.h"
 #include "Interface.h"
 #include "LineShader.h"
+#include "LocationFilter.h"
 #include "Minable.h"
 #include "Mission.h"
 #include "Music.h"
@@ -38,9 +40,12 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Person.h"
 #include "Phrase.h"
 #include "Planet.h"
+#include "Point.h"
 #include "PointerShader.h"
 #include "Politics.h"
+#include "Preferences.h"
 #include "RingShader.h"
+#include "RouteTable.h"
 #include "Sale.h"
 #include "Set.h"
 #include "Ship.h"
@@ -50,11 +55,22 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "SpriteShader.h"
 #include "StarField.h"
 #include "StartConditions.h"
+#include "StellarObject.h"
+#include "StreamBuffer.h"
 #include "System.h"
+#include "SystemGrid.h"
+#include "ThreadPool.h"
+
+#if !defined _WIN32
+#include <sys/resource.h>
+#endif
 
 #include <algorithm>
+#include <chrono>
+#include <ctime>
 #include <iostream>
 #include <map>
+#include <set>
 #include <utility>
 #include <vector>
 
@@ -111,12 +127,302 @@ namespace {
 	map<const Sprite *, vector<string>> deferred;
 	map<const Sprite *, int> preloaded;
 	
+	// If there is a limit on how much memory sprites can use, most sprites are
+	// only loaded once they are drawn, and are unloaded again if they have not
+	// been drawn for a while and the limit has been reached.
+	class StreamedSprite {
+	public:
+		vector<string> paths;
+		int lastUsed = 0;
+		bool isLoaded = false;
+	};
+	map<const Sprite *, StreamedSprite> streamed;
+	int streamStep = 0;
+	// The @2x frames are only needed on high DPI screens or when zoomed in, so
+	// they are not loaded until a sprite is drawn at high resolution. Until
+	// then, the ordinary frames are drawn instead.
+	map<const Sprite *, vector<string>> highDPI;
+	// Never unload a sprite that was drawn within this many frames (i.e. ten
+	// seconds), since it is likely to be drawn again soon.
+	const int MIN_UNUSED_STEPS = 600;
+	
+	// Begin loading a streamed sprite, unless it is loaded already, and mark it
+	// as just used so it is not unloaded before it can be drawn.
+	void LoadStreamed(const Sprite *sprite, StreamedSprite &stream)
+	{
+		stream.lastUsed = streamStep;
+		if(stream.isLoaded)
+			return;
+		
+		stream.isLoaded = true;
+		for(const string &path : stream.paths)
+			spriteQueue.Add(sprite->Name(), path);
+	}
+	
+	// In debug mode, report how long each step of loading took once it is done.
+	bool printLoadTiming = false;
+	// The time spent listing the files in the resource directories, parsing the
+	// data files from each source (added up over all threads), turning the
+	// parsed nodes into game objects, and compiling the shaders, in seconds.
+	double scanTime = 0.;
+	vector<double> parseTime;
+	double objectTime = 0.;
+	double shaderTime = 0.;
+	// The peak memory use once the game data was loaded, in megabytes.
+	double dataMemory = 0.;
+	
+	// The data files that were loaded, in order, and when each was last
+	// modified, so that a reload can tell which of them have changed.
+	bool isDebugMode = false;
+	vector<string> loadedFiles;
+	vector<time_t> loadedTimes;
+	// For each object that the data files define, the last file that defines
+	// it. If a reloaded file defines an object that a later file overrides,
+	// that later file must be applied again as well.
+	map<string, size_t> lastDefinition;
+	
+	// Check if the given image is an @2x image.
+	bool Is2x(const string &path)
+	{
+		size_t len = path.length();
+		return (len > 7 && path[len - 7] == '@' && path[len - 6] == '2' && path[len - 5] == 'x');
+	}
+	
+	double SecondsSince(chrono::steady_clock::time_point start)
+	{
+		return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	}
+	
+	// Print the given memory use, rounded to the nearest megabyte, as part of
+	// the loading report. Nothing is printed if it is not known (i.e. zero).
+	void PrintMemory(const string &label, double megabytes)
+	{
+		if(megabytes)
+			cerr << "    " << label << static_cast<int>(megabytes + .5) << " MB" << endl;
+	}
+	
 	const Government *playerGovernment = nullptr;
+	
+	// The mission templates that are offered on planets, sorted by the most
+	// specific place they can be offered: a single planet, any of a set of
+	// planets or systems, a government's systems, or anywhere. Each template is
+	// only listed under one kind of place, so when landing on a planet, at most
+	// one of its lists can match. Along with each template is its position in
+	// the "missions" set, so that the matches can be put back in that order.
+	typedef vector<pair<size_t, const Mission *>> MissionList;
+	MissionList missionsAnywhere;
+	map<const Planet *, MissionList> missionsByPlanet;
+	map<const System *, MissionList> missionsBySystem;
+	map<const Government *, MissionList> missionsByGovernment;
+	
+	// Sort the mission templates into the lists above. Missions never change
+	// after they are loaded, but which system a planet is in and which
+	// government a system belongs to may, so that is checked when landing.
+	void IndexMissions()
+	{
+		missionsAnywhere.clear();
+		missionsByPlanet.clear();
+		missionsBySystem.clear();
+		missionsByGovernment.clear();
+		
+		size_t index = 0;
+		for(const auto &it : missions)
+		{
+			const Mission &mission = it.second;
+			pair<size_t, const Mission *> entry(index++, &mission);
+			if(mission.IsAtLocation(Mission::BOARDING) || mission.IsAtLocation(Mission::ASSISTING))
+				continue;
+			
+			const LocationFilter &filter = mission.SourceFilter();
+			if(mission.Source())
+				missionsByPlanet[mission.Source()].push_back(entry);
+			else if(!filter.Planets().empty())
+				for(const Planet *planet : filter.Planets())
+					missionsByPlanet[planet].push_back(entry);
+			else if(!filter.Systems().empty())
+				for(const System *system : filter.Systems())
+					missionsBySystem[system].push_back(entry);
+			else if(!filter.Governments().empty())
+				for(const Government *government : filter.Governments())
+					missionsByGovernment[government].push_back(entry);
+			else
+				missionsAnywhere.push_back(entry);
+		}
+	}
+	
+	// Add the missions listed under the given key, if any.
+	template <class Type>
+	void AddMissions(MissionList &found, const map<const Type *, MissionList> &lists, const Type *key)
+	{
+		auto it = lists.find(key);
+		if(it != lists.end())
+			found.insert(found.end(), it->second.begin(), it->second.end());
+	}
+	
+	// Get the name that identifies the object the given root node defines, or
+	// an empty string if it does not define a named object.
+	string DefinitionKey(const DataNode &node)
+	{
+		if(node.Size() < 2)
+			return string();
+		// A ship variant is named by its third token, not by its model.
+		int name = (node.Token(0) == "ship" && node.Size() > 2) ? 2 : 1;
+		return node.Token(0) + ' ' + node.Token(name);
+	}
+	
+	// Finish loading the given ship models. A variant copies any data it does
+	// not define from its base model, so the ships are finished in waves,
+	// where each wave only contains ships whose base is not waiting to be
+	// finished. The ships within a wave are independent.
+	void FinishShips(vector<Ship *> pending)
+	{
+		set<const Ship *> waiting(pending.begin(), pending.end());
+		while(!pending.empty())
+		{
+			vector<Ship *> wave;
+			vector<Ship *> later;
+			for(Ship *ship : pending)
+			{
+				const Ship *base = ship->Base();
+				if(!base || base == ship || !waiting.count(base))
+					wave.push_back(ship);
+				else
+					later.push_back(ship);
+			}
+			// If the remaining variants are each other's bases, there is no right
+			// order, so just finish them one at a time.
+			if(wave.empty())
+			{
+				for(Ship *ship : later)
+					ship->FinishLoading();
+				break;
+			}
+			ThreadPool::Shared().ParallelFor(wave.size(), [&wave](size_t i)
+			{
+				wave[i]->FinishLoading();
+			});
+			for(const Ship *ship : wave)
+				waiting.erase(ship);
+			pending.swap(later);
+		}
+	}
+	
+	// Copy the current state of an object that was reloaded into the state
+	// that the universe is reverted to, if it is one of the kinds of objects
+	// that events can change.
+	void UpdateDefault(const string &key, const string &name)
+	{
+		if(key == "fleet")
+			*defaultFleets.Get(name) = *fleets.Get(name);
+		else if(key == "government")
+			*defaultGovernments.Get(name) = *governments.Get(name);
+		else if(key == "planet")
+			*defaultPlanets.Get(name) = *planets.Get(name);
+		else if(key == "system")
+			*defaultSystems.Get(name) = *systems.Get(name);
+		else if(key == "shipyard")
+			*defaultShipSales.Get(name) = *shipSales.Get(name);
+		else if(key == "outfitter")
+			*defaultOutfitSales.Get(name) = *outfitSales.Get(name);
+	}
+	
+	// The values that the map colors systems by, each indexed by System::Index():
+	// the number of ships for sale, the number of outfits for sale, and then
+	// the price of each commodity. They are rebuilt the next time they are
+	// needed after the prices or the systems have changed.
+	vector<vector<int>> mapValues;
+	bool mapValuesAreValid = false;
+	
+	const vector<vector<int>> &MapValues()
+	{
+		if(mapValuesAreValid)
+			return mapValues;
+		mapValuesAreValid = true;
+		
+		const vector<Trade::Commodity> &commodities = trade.Commodities();
+		mapValues.assign(2 + commodities.size(), vector<int>(systems.size(), 0));
+		for(const auto &it : systems)
+		{
+			const System &system = it.second;
+			if(system.Index() < 0 || system.Index() >= systems.size())
+				continue;
+			
+			for(const StellarObject &object : system.Objects())
+				if(object.GetPlanet())
+				{
+					mapValues[0][system.Index()] += object.GetPlanet()->Shipyard().size();
+					mapValues[1][system.Index()] += object.GetPlanet()->Outfitter().size();
+				}
+			for(size_t i = 0; i < commodities.size(); ++i)
+				mapValues[2 + i][system.Index()] = system.Trade(commodities[i].name);
+		}
+		return mapValues;
+	}
+	
+	// Mark all the planets in the given system as modified, so that reverting
+	// the game data will also restore which systems they belong to.
+	void ModifyPlanets(const System &system)
+	{
+		for(const StellarObject &object : system.Objects())
+			if(object.GetPlanet())
+				planets.Modify(object.GetPlanet()->TrueName());
+	}
+	
+	// Recalculate the neighbors of only the systems that are within jump range
+	// of the given positions, where systems have been moved or changed. This is
+	// only valid if no systems have been added, so their indices are the same.
+	void UpdateNeighborsNear(const vector<Point> &positions)
+	{
+		SystemGrid::Update(systems);
+		set<const System *> changed;
+		vector<const System *> nearby;
+		for(const Point &position : positions)
+		{
+			SystemGrid::Circle(position, System::NEIGHBOR_DISTANCE, nearby);
+			changed.insert(nearby.begin(), nearby.end());
+		}
+		for(const System *system : changed)
+			systems.Get(system->Name())->UpdateNeighbors(system->Index());
+		DistanceMap::UpdateGraph(systems);
+	}
+	
+	// Apply a single change to the universe. The caller must update anything
+	// that depends on the changed objects.
+	void ApplyChange(const DataNode &node)
+	{
+		if(node.Token(0) == "fleet" && node.Size() >= 2)
+			fleets.Modify(node.Token(1))->Load(node);
+		else if(node.Token(0) == "galaxy" && node.Size() >= 2)
+			galaxies.Get(node.Token(1))->Load(node);
+		else if(node.Token(0) == "government" && node.Size() >= 2)
+			governments.Modify(node.Token(1))->Load(node);
+		else if(node.Token(0) == "outfitter" && node.Size() >= 2)
+			outfitSales.Modify(node.Token(1))->Load(node, outfits);
+		else if(node.Token(0) == "planet" && node.Size() >= 2)
+			planets.Modify(node.Token(1))->Load(node, shipSales, outfitSales);
+		else if(node.Token(0) == "shipyard" && node.Size() >= 2)
+			shipSales.Modify(node.Token(1))->Load(node, ships);
+		else if(node.Token(0) == "system" && node.Size() >= 2)
+		{
+			// Changing a system's objects also changes which systems the planets
+			// that are added to it or removed from it belong to.
+			System *system = systems.Modify(node.Token(1));
+			ModifyPlanets(*system);
+			system->Load(node, planets);
+			ModifyPlanets(*system);
+		}
+		else if(node.Token(0) == "link" && node.Size() >= 3)
+			systems.Modify(node.Token(1))->Link(systems.Modify(node.Token(2)));
+		else if(node.Token(0) == "unlink" && node.Size() >= 3)
+			systems.Modify(node.Token(1))->Unlink(systems.Modify(node.Token(2)));
+		else
+			node.PrintTrace("Invalid \"event\" data:");
+	}
 }
 
 
 
-void GameData::BeginLoad(const char * const *argv)
+void GameData::BeginLoad(const char * const *argv, bool isHeadless)
 {
 	bool printShips = false;
 	bool printWeapons = false;
@@ -135,9 +441,15 @@ void GameData::BeginLoad(const char * const *argv)
 			continue;
 		}
 	}
+	printLoadTiming = debugMode;
+	isDebugMode = debugMode;
 	Files::Init(argv);
+	// The preferences determine how sprites are loaded, so they must be read
+	// before any sprites are queued up.
+	Preferences::Load();
 	
 	// Initialize the list of "source" folders based on any active plugins.
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
 	LoadSources();
 	
 	// Now, read all the images in all the path directories. For each unique
@@ -145,38 +457,135 @@ void GameData::BeginLoad(const char * const *argv)
 	// paths override the default images.
 	map<string, string> images;
 	LoadImages(images);
+	scanTime = SecondsSince(start);
 	
-	// From the name, strip out any frame number, plus the extension.
+	// From the name, strip out any frame number, plus the extension. A benchmark
+	// runs without any OpenGL context, so it only loads the sprites' sizes and
+	// masks, never streams them, and skips the landscapes entirely.
+	bool isStreaming = Preferences::SpriteMemory() && !isHeadless;
+	set<string> hasStandard;
+	for(const auto &it : images)
+		if(!Is2x(it.first))
+			hasStandard.insert(Name(it.first));
 	for(const auto &it : images)
 	{
 		string name = Name(it.first);
 		// For landscapes, remember all the source files but don't load them yet.
 		if(name.substr(0, 5) == "land/")
-			deferred[SpriteSet::Get(name)].push_back(it.second);
+		{
+			if(!isHeadless)
+				deferred[SpriteSet::Get(name)].push_back(it.second);
+		}
+		// Streamed sprites need their sizes and masks right away, but their
+		// images are not loaded until they are drawn. The interface sprites
+		// are always drawn, so there is no point in streaming them.
+		else if(isStreaming && name.compare(0, 3, "ui/"))
+		{
+			streamed[SpriteSet::Get(name)].paths.push_back(it.second);
+			spriteQueue.Add(name, it.second, true);
+		}
+		// If a sprite has standard frames, its @2x frames are not loaded until
+		// they are needed for a high-DPI screen, and never in a headless run.
+		else if(Is2x(it.first) && hasStandard.count(name))
+		{
+			if(!isHeadless)
+				highDPI[SpriteSet::Get(name)].push_back(it.second);
+		}
+		// Everything else, including a sprite that has only @2x frames, is
+		// loaded right away.
 		else
-			spriteQueue.Add(name, it.second);
+			spriteQueue.Add(name, it.second, isHeadless);
 	}
 	
 	// Generate a catalog of music files.
+	start = chrono::steady_clock::now();
 	Music::Init(sources);
 	
-	for(const string &source : sources)
+	// Iterate through the paths starting with the last directory given. That
+	// is, things in folders near the start of the path have the ability to
+	// override things in folders later in the path. Remember which source
+	// each file came from, so the time spent parsing it can be reported.
+	vector<string> dataFiles;
+	vector<size_t> dataSources;
+	for(size_t i = 0; i < sources.size(); ++i)
+		for(const string &path : Files::RecursiveList(sources[i] + "data/"))
+			if(path.length() >= 4 && !path.compare(path.length() - 4, 4, ".txt"))
+			{
+				dataFiles.push_back(path);
+				dataSources.push_back(i);
+			}
+	scanTime += SecondsSince(start);
+	
+	// Parsing the files takes most of the loading time, and each file can be
+	// parsed independently, so do that in parallel. The parsed files are then
+	// loaded one at a time in the original order, so that overrides work the
+	// same no matter which file finished parsing first. A benchmark must be
+	// repeatable, though, and some containers are sorted by the addresses of
+	// objects created while loading, which depend on what memory other threads
+	// have freed. So, it lets the sprites finish loading and then parses the
+	// files one at a time.
+	vector<DataFile> data(dataFiles.size());
+	vector<double> fileTime(dataFiles.size(), 0.);
+	auto parse = [&data, &dataFiles, &fileTime](size_t i)
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		data[i].LoadCached(dataFiles[i]);
+		fileTime[i] = SecondsSince(start);
+	};
+	if(!isHeadless)
+		ThreadPool::Shared().ParallelFor(dataFiles.size(), parse);
+	else
+	{
+		spriteQueue.Finish();
+		for(size_t i = 0; i < data.size(); ++i)
+			parse(i);
+	}
+	parseTime.assign(sources.size(), 0.);
+	for(size_t i = 0; i < fileTime.size(); ++i)
+		parseTime[dataSources[i]] += fileTime[i];
+	
+	start = chrono::steady_clock::now();
+	for(size_t i = 0; i < data.size(); ++i)
 	{
-		// Iterate through the paths starting with the last directory given. That
-		// is, things in folders near the start of the path have the ability to
-		// override things in folders later in the path.
-		vector<string> dataFiles = Files::RecursiveList(source + "data/");
-		for(const string &path : dataFiles)
-			LoadFile(path, debugMode);
+		for(const DataNode &node : data[i])
+		{
+			string key = DefinitionKey(node);
+			if(!key.empty())
+				lastDefinition[key] = i;
+		}
+		LoadFile(data[i], dataFiles[i], debugMode);
+		// Free each file's nodes as soon as they have been loaded.
+		data[i] = DataFile();
 	}
 	
 	// Now that all the stars are loaded, update the neighbor lists.
 	UpdateNeighbors();
-	// And, update the ships with the outfits we've now finished loading.
-	for(auto &it : ships)
+	IndexMissions();
+	// And, update the ships with the outfits we've now finished loading. This
+	// fills in each weapon's cached damage and range, so after this the outfits
+	// can safely be read from multiple threads.
+	for(auto &it : outfits)
 		it.second.FinishLoading();
+	
+	vector<Ship *> models;
+	for(auto &it : ships)
+		models.push_back(&it.second);
+	FinishShips(models);
+	
+	// Persons' ships only depend on their models, which are all finished now.
+	vector<Ship *> personShips;
 	for(const auto &it : persons)
-		it.second.GetShip()->FinishLoading();
+		personShips.push_back(it.second.GetShip().get());
+	ThreadPool::Shared().ParallelFor(personShips.size(), [&personShips](size_t i)
+	{
+		personShips[i]->FinishLoading();
+	});
+	objectTime = SecondsSince(start);
+	dataMemory = PeakMemory();
+	
+	loadedFiles = dataFiles;
+	for(const string &path : loadedFiles)
+		loadedTimes.push_back(Files::Timestamp(path));
 	
 	// Store the current state, to revert back to later.
 	defaultFleets = fleets;
@@ -197,6 +606,133 @@ void GameData::BeginLoad(const char * const *argv)
 
 
 
+// Check whether the game was started in debug mode.
+bool GameData::DebugMode()
+{
+	return isDebugMode;
+}
+
+
+
+// Reload any data files that have changed since they were loaded, and bring
+// the objects that depend on them up to date. This must not be called while
+// the engine is calculating a step. Return the number of files reloaded.
+int GameData::Reload()
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	vector<bool> reload(loadedFiles.size(), false);
+	for(size_t i = 0; i < loadedFiles.size(); ++i)
+	{
+		time_t timestamp = Files::Timestamp(loadedFiles[i]);
+		reload[i] = (timestamp != loadedTimes[i]);
+		loadedTimes[i] = timestamp;
+	}
+	
+	// Parse the changed files. Applying a file again undoes any overrides of
+	// its objects in later files, so those files must be applied again too.
+	// They can only be later in the list, so one pass finds all of them.
+	vector<DataFile> data(loadedFiles.size());
+	int count = 0;
+	for(size_t i = 0; i < loadedFiles.size(); ++i)
+	{
+		if(!reload[i])
+			continue;
+		
+		++count;
+		data[i].LoadCached(loadedFiles[i]);
+		for(const DataNode &node : data[i])
+		{
+			string key = DefinitionKey(node);
+			if(key.empty())
+				continue;
+			size_t &last = lastDefinition[key];
+			if(last > i)
+				reload[last] = true;
+			else
+				last = i;
+		}
+	}
+	if(!count)
+		return 0;
+	
+	// Apply the files in their original order, remembering what they changed.
+	vector<Outfit *> reloadedOutfits;
+	vector<Ship *> reloadedShips;
+	set<pair<string, string>> changedDefaults;
+	vector<Point> moved;
+	bool addedSystems = false;
+	bool changedMissions = false;
+	bool changedGovernments = false;
+	for(size_t i = 0; i < loadedFiles.size(); ++i)
+	{
+		if(!reload[i])
+			continue;
+		
+		for(const DataNode &node : data[i])
+			if(node.Token(0) == "system" && node.Size() >= 2)
+			{
+				addedSystems |= !systems.Has(node.Token(1));
+				if(systems.Has(node.Token(1)))
+					moved.push_back(systems.Get(node.Token(1))->Position());
+			}
+		LoadFile(data[i], loadedFiles[i], isDebugMode);
+		for(const DataNode &node : data[i])
+		{
+			if(node.Size() < 2)
+				continue;
+			
+			const string &key = node.Token(0);
+			if(key == "outfit")
+				reloadedOutfits.push_back(outfits.Get(node.Token(1)));
+			else if(key == "ship")
+				reloadedShips.push_back(ships.Get(node.Token((node.Size() > 2) ? 2 : 1)));
+			else if(key == "system")
+				moved.push_back(systems.Get(node.Token(1))->Position());
+			changedMissions |= (key == "mission");
+			changedGovernments |= (key == "government");
+			changedDefaults.emplace(key, node.Token(1));
+		}
+		data[i] = DataFile();
+	}
+	
+	// Any weapon may have a reloaded weapon as a submunition, so all of the
+	// weapons' totals must be added up again.
+	if(!reloadedOutfits.empty())
+	{
+		for(auto &it : outfits)
+			it.second.ResetTotals();
+		for(auto &it : outfits)
+			it.second.FinishLoading();
+	}
+	sort(reloadedShips.begin(), reloadedShips.end());
+	reloadedShips.erase(unique(reloadedShips.begin(), reloadedShips.end()), reloadedShips.end());
+	FinishShips(reloadedShips);
+	// Reloading a person gives it a new ship, which must be finished as well.
+	for(const auto &it : changedDefaults)
+		if(it.first == "person" && persons.Get(it.second)->GetShip())
+			persons.Get(it.second)->GetShip()->FinishLoading();
+	
+	if(addedSystems)
+		UpdateNeighbors();
+	else if(!moved.empty())
+		UpdateNeighborsNear(moved);
+	if(changedMissions)
+		IndexMissions();
+	if(changedGovernments)
+		politics.UpdateAttitudes();
+	for(const auto &it : changedDefaults)
+		UpdateDefault(it.first, it.second);
+	RouteTable::Invalidate();
+	LocationFilter::Invalidate();
+	mapValuesAreValid = false;
+	
+	if(isDebugMode)
+		cerr << "Reloaded " << count << " changed data files in " << SecondsSince(start) << " seconds." << endl;
+	return count;
+}
+
+
+
 // Check for objects that are referred to but never defined.
 void GameData::CheckReferences()
 {
@@ -221,6 +757,7 @@ void GameData::CheckReferences()
 
 void GameData::LoadShaders()
 {
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
 	FontSet::Add(Files::Images() + "font/ubuntu14r.png", 14);
 	FontSet::Add(Files::Images() + "font/ubuntu18r.png", 18);
 	
@@ -228,6 +765,7 @@ void GameData::LoadShaders()
 	Command::LoadSettings(Files::Resources() + "keys.txt");
 	Command::LoadSettings(Files::Config() + "keys.txt");
 	
+	StreamBuffer::Init();
 	FillShader::Init();
 	FogShader::Init();
 	LineShader::Init();
@@ -237,21 +775,52 @@ void GameData::LoadShaders()
 	SpriteShader::Init();
 	
 	background.Init(16384, 4096);
+	shaderTime = SecondsSince(start);
 }
 
 
 
 double GameData::Progress()
 {
-	return min(spriteQueue.Progress(), Audio::Progress());
+	double progress = min(spriteQueue.Progress(), Audio::Progress());
+	if(printLoadTiming && progress == 1.)
+	{
+		printLoadTiming = false;
+		cerr << "Loaded the game data from " << sources.size() << " sources." << endl;
+		cerr << "    listing files: " << scanTime << endl;
+		for(size_t i = 0; i < parseTime.size() && i < sources.size(); ++i)
+			cerr << "    parsing " << sources[i] << "data/: " << parseTime[i] << endl;
+		cerr << "    creating objects: " << objectTime << endl;
+		cerr << "    compiling shaders: " << shaderTime << endl;
+		PrintMemory("peak memory: ", dataMemory);
+		
+		SpriteQueue::Timing timing = spriteQueue.GetTiming();
+		cerr << "Loaded " << timing.images << " images in " << timing.elapsed << " seconds." << endl;
+		cerr << "    reading: " << timing.read << endl;
+		cerr << "    tracing masks: " << timing.mask << endl;
+		cerr << "    compressing: " << timing.compress << endl;
+		cerr << "    uploading: " << timing.upload << endl;
+		cerr << "    waiting for images: " << timing.wait << endl;
+		cerr << "    reading paused " << timing.pauses << " times." << endl;
+		PrintMemory("peak memory: ", PeakMemory());
+	}
+	return progress;
 }
 
 
 
 // Begin loading a sprite that was previously deferred. Currently this is
-// done with all landscapes to speed up the program's startup.
+// done with all landscapes to speed up the program's startup. If sprites are
+// being streamed, this also loads a streamed sprite before it is drawn.
 void GameData::Preload(const Sprite *sprite)
 {
+	auto sit = streamed.find(sprite);
+	if(sprite && sit != streamed.end())
+	{
+		LoadStreamed(sprite, sit->second);
+		return;
+	}
+	
 	// Make sure this sprite actually is one that uses deferred loading.
 	auto dit = deferred.find(sprite);
 	if(!sprite || dit == deferred.end())
@@ -281,7 +850,7 @@ void GameData::Preload(const Sprite *sprite)
 		++pit->second;
 		if(pit->second >= 20)
 		{
-			spriteQueue.Unload(name);
+			spriteQueue.Unload(pit->first->Name());
 			pit = preloaded.erase(pit);
 		}
 		else
@@ -303,6 +872,101 @@ void GameData::FinishLoading()
 
 
 
+// If sprites are being streamed, load the ones that have been drawn since this
+// was last called, and unload any that have not been drawn in a while if they
+// take up more memory than the preferences allow.
+void GameData::StreamSprites()
+{
+	for(auto it = highDPI.begin(); it != highDPI.end(); )
+	{
+		if(it->first->CheckUsed2x())
+		{
+			for(const string &path : it->second)
+				spriteQueue.Add(it->first->Name(), path);
+			it = highDPI.erase(it);
+		}
+		else
+			++it;
+	}
+	
+	if(streamed.empty())
+	{
+		// Upload any @2x frames that have finished loading.
+		spriteQueue.Progress();
+		return;
+	}
+	
+	++streamStep;
+	size_t memory = 0;
+	for(auto &it : streamed)
+	{
+		const Sprite *sprite = it.first;
+		StreamedSprite &stream = it.second;
+		if(sprite->CheckUsed())
+			LoadStreamed(sprite, stream);
+		if(stream.isLoaded)
+			memory += sprite->Memory();
+	}
+	// Upload any sprites that have finished loading.
+	spriteQueue.Progress();
+	
+	size_t limit = static_cast<size_t>(Preferences::SpriteMemory()) << 20;
+	if(!limit || memory <= limit)
+		return;
+	
+	// Unload the sprites that were drawn least recently. A sprite that is
+	// loaded but takes up no memory is still being read, so leave it alone.
+	vector<pair<int, const Sprite *>> unused;
+	for(const auto &it : streamed)
+		if(it.second.isLoaded && it.first->Memory() && it.second.lastUsed < streamStep - MIN_UNUSED_STEPS)
+			unused.emplace_back(it.second.lastUsed, it.first);
+	sort(unused.begin(), unused.end());
+	for(const auto &it : unused)
+	{
+		if(memory <= limit)
+			break;
+		
+		memory -= it.second->Memory();
+		streamed[it.second].isLoaded = false;
+		spriteQueue.Unload(it.second->Name(), true);
+	}
+}
+
+
+
+// Load the @2x frames of every sprite that has not loaded them yet. This
+// should be called if the screen is high DPI.
+void GameData::LoadHighDPI()
+{
+	for(const auto &it : highDPI)
+		for(const string &path : it.second)
+			spriteQueue.Add(it.first->Name(), path);
+	highDPI.clear();
+}
+
+
+
+// Get the most memory this process has used so far, in megabytes, or zero
+// if that is not known on this platform.
+double GameData::PeakMemory()
+{
+#if defined _WIN32
+	return 0.;
+#else
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage))
+		return 0.;
+#if defined __APPLE__
+	// On macOS, the peak is given in bytes instead of kilobytes.
+	return usage.ru_maxrss / 1048576.;
+#else
+	return usage.ru_maxrss / 1024.;
+#endif
+#endif
+}
+
+
+
 // Get the list of resource sources (i.e. plugin folders).
 const vector<string> &GameData::Sources()
 {
@@ -314,17 +978,32 @@ const vector<string> &GameData::Sources()
 // Revert any changes that have been made to the universe.
 void GameData::Revert()
 {
+	// Only the objects that events have modified need to be copied back.
 	fleets.Revert(defaultFleets);
 	governments.Revert(defaultGovernments);
 	planets.Revert(defaultPlanets);
-	systems.Revert(defaultSystems);
+	bool systemsChanged = systems.Revert(defaultSystems);
 	shipSales.Revert(defaultShipSales);
 	outfitSales.Revert(defaultOutfitSales);
+	// The economy changes every day in every system, so reset it everywhere.
+	for(auto &it : systems)
+	{
+		const System *original = defaultSystems.Find(it.first);
+		if(original)
+			for(const Trade::Commodity &commodity : trade.Commodities())
+				it.second.SetSupply(commodity.name, original->Supply(commodity.name));
+	}
+	// If any system was added or changed, the neighbor lists of the systems
+	// around it may refer to the old version of it.
+	if(systemsChanged)
+		UpdateNeighbors();
 	for(auto &it : persons)
 		it.second.GetShip()->Restore();
 	
 	politics.Reset();
 	purchases.clear();
+	mapValuesAreValid = false;
+	LocationFilter::Invalidate();
 }
 
 
@@ -344,6 +1023,7 @@ void GameData::ReadEconomy(const DataNode &node)
 		return;
 	
 	vector<string> headings;
+	mapValuesAreValid = false;
 	for(const DataNode &child : node)
 	{
 		if(child.Token(0) == "purchases")
@@ -409,6 +1089,8 @@ void GameData::WriteEconomy(DataWriter &out)
 
 void GameData::StepEconomy()
 {
+	mapValuesAreValid = false;
+	
 	// First, apply any purchases the player made. These are deferred until now
 	// so that prices will not change as you are buying or selling goods.
 	for(const auto &pit : purchases)
@@ -425,23 +1107,21 @@ void GameData::StepEconomy()
 	
 	// Finally, send out the trade goods. This has to be done in a separate step
 	// because otherwise whichever systems trade last would already have gotten
-	// supplied by the other systems.
+	// supplied by the other systems. Each system only changes its own supply
+	// based on the others' exports, so this step can be done in parallel.
+	vector<System *> importers;
 	for(auto &it : systems)
+		if(!it.second.Links().empty())
+			importers.push_back(&it.second);
+	
+	static const size_t BATCH_SIZE = 32;
+	size_t batches = (importers.size() + BATCH_SIZE - 1) / BATCH_SIZE;
+	ThreadPool::Shared().ParallelFor(batches, [&importers](size_t batch)
 	{
-		System &system = it.second;
-		if(system.Links().size())
-			for(const Trade::Commodity &commodity : trade.Commodities())
-			{
-				double supply = system.Supply(commodity.name);
-				for(const System *neighbor : system.Links())
-				{
-					double scale = neighbor->Links().size();
-					if(scale)
-						supply += neighbor->Exports(commodity.name) / scale;
-				}
-				system.SetSupply(commodity.name, supply);
-			}
-	}
+		size_t end = min(importers.size(), (batch + 1) * BATCH_SIZE);
+		for(size_t i = batch * BATCH_SIZE; i < end; ++i)
+			importers[i]->ImportGoods();
+	});
 }
 
 
@@ -454,29 +1134,73 @@ void GameData::AddPurchase(const System &system, const string &commodity, int to
 
 
 
-// Apply the given change to the universe.
-void GameData::Change(const DataNode &node)
-{
-	if(node.Token(0) == "fleet" && node.Size() >= 2)
-		fleets.Get(node.Token(1))->Load(node);
-	else if(node.Token(0) == "galaxy" && node.Size() >= 2)
-		galaxies.Get(node.Token(1))->Load(node);
-	else if(node.Token(0) == "government" && node.Size() >= 2)
-		governments.Get(node.Token(1))->Load(node);
-	else if(node.Token(0) == "outfitter" && node.Size() >= 2)
-		outfitSales.Get(node.Token(1))->Load(node, outfits);
-	else if(node.Token(0) == "planet" && node.Size() >= 2)
-		planets.Get(node.Token(1))->Load(node, shipSales, outfitSales);
-	else if(node.Token(0) == "shipyard" && node.Size() >= 2)
-		shipSales.Get(node.Token(1))->Load(node, ships);
-	else if(node.Token(0) == "system" && node.Size() >= 2)
-		systems.Get(node.Token(1))->Load(node, planets);
-	else if(node.Token(0) == "link" && node.Size() >= 3)
-		systems.Get(node.Token(1))->Link(systems.Get(node.Token(2)));
-	else if(node.Token(0) == "unlink" && node.Size() >= 3)
-		systems.Get(node.Token(1))->Unlink(systems.Get(node.Token(2)));
-	else
-		node.PrintTrace("Invalid \"event\" data:");
+// Apply the given changes to the universe. Anything that depends on them,
+// including the systems' neighbor lists, is only updated once, after all of
+// them have been applied. Return true if any of the changes affected the star
+// systems.
+bool GameData::Change(const list<DataNode> &changes)
+{
+	// Only the last link or unlink between any two systems matters, unless the
+	// links of one of those systems are replaced in between. Long campaigns can
+	// toggle the same link many times, so skip all but the last one.
+	vector<bool> skip(changes.size(), false);
+	set<pair<string, string>> linked;
+	size_t i = changes.size();
+	for(auto it = changes.rbegin(); it != changes.rend(); ++it)
+	{
+		--i;
+		if(it->Token(0) == "system")
+			linked.clear();
+		else if((it->Token(0) == "link" || it->Token(0) == "unlink") && it->Size() >= 3)
+		{
+			const string &first = it->Token(1);
+			const string &second = it->Token(2);
+			skip[i] = !linked.emplace(min(first, second), max(first, second)).second;
+		}
+	}
+	
+	// Keep track of where systems have been changed. Linking two systems makes
+	// them neighbors, so that needs no other update. If a new system is added,
+	// all the systems' indices change, so they must all be updated.
+	bool changedSystems = false;
+	bool addedSystems = false;
+	bool changedGovernments = false;
+	vector<Point> moved;
+	i = 0;
+	for(const DataNode &node : changes)
+	{
+		if(skip[i++])
+			continue;
+		
+		const string &key = node.Token(0);
+		changedGovernments |= (key == "government");
+		if(key == "system" || key == "link" || key == "unlink")
+		{
+			changedSystems = true;
+			int names = min(node.Size(), (key == "system") ? 2 : 3);
+			for(int j = 1; j < names; ++j)
+				addedSystems |= !systems.Has(node.Token(j));
+		}
+		if(key == "system" && node.Size() >= 2 && systems.Has(node.Token(1)))
+			moved.push_back(systems.Get(node.Token(1))->Position());
+		ApplyChange(node);
+		if(key == "system" && node.Size() >= 2)
+			moved.push_back(systems.Get(node.Token(1))->Position());
+	}
+	if(changedGovernments)
+		politics.UpdateAttitudes();
+	if(addedSystems)
+		UpdateNeighbors();
+	else if(changedSystems)
+		UpdateNeighborsNear(moved);
+	
+	// Any change to a system or planet may change what routes are possible,
+	// which ones a location filter might match, and what is sold where.
+	RouteTable::Invalidate();
+	LocationFilter::Invalidate();
+	mapValuesAreValid = false;
+	
+	return changedSystems;
 }
 
 
@@ -485,8 +1209,14 @@ void GameData::Change(const DataNode &node)
 // that a change creates or moves a system.
 void GameData::UpdateNeighbors()
 {
+	SystemGrid::Update(systems);
+	int index = 0;
 	for(auto &it : systems)
-		it.second.UpdateNeighbors(systems);
+		it.second.UpdateNeighbors(index++);
+	DistanceMap::UpdateGraph(systems);
+	RouteTable::Invalidate();
+	LocationFilter::Invalidate();
+	mapValuesAreValid = false;
 }
 
 
@@ -563,6 +1293,31 @@ const Set<Mission> &GameData::Missions()
 
 
 
+// Get the mission templates that could possibly be offered on the given planet,
+// in the same order as in Missions(). This leaves out any that are offered when
+// boarding or assisting a ship.
+vector<const Mission *> GameData::MissionsOffered(const Planet *planet)
+{
+	vector<const Mission *> result;
+	if(!planet)
+		return result;
+	
+	const System *system = planet->GetSystem();
+	MissionList found = missionsAnywhere;
+	AddMissions(found, missionsByPlanet, planet);
+	AddMissions(found, missionsBySystem, system);
+	if(system)
+		AddMissions(found, missionsByGovernment, system->GetGovernment());
+	sort(found.begin(), found.end());
+	
+	result.reserve(found.size());
+	for(const auto &it : found)
+		result.push_back(it.second);
+	return result;
+}
+
+
+
 const Set<Outfit> &GameData::Outfits()
 {
 	return outfits;
@@ -641,6 +1396,30 @@ const vector<Trade::Commodity> &GameData::SpecialCommodities()
 
 
 
+// Get the price of the given commodity in every system, or the number of
+// ships or outfits for sale in every system, indexed by System::Index().
+// These are only recalculated after the prices or the systems have changed.
+const vector<int> &GameData::SystemPrices(int commodity)
+{
+	return MapValues()[2 + commodity];
+}
+
+
+
+const vector<int> &GameData::ShipyardSizes()
+{
+	return MapValues()[0];
+}
+
+
+
+const vector<int> &GameData::OutfitterSizes()
+{
+	return MapValues()[1];
+}
+
+
+
 // Custom messages to be shown when trying to land on certain stellar objects.
 bool GameData::HasLandingMessage(const Sprite *sprite)
 {
@@ -761,13 +1540,8 @@ void GameData::LoadSources()
 
 
 
-void GameData::LoadFile(const string &path, bool debugMode)
+void GameData::LoadFile(const DataFile &data, const string &path, bool debugMode)
 {
-	// This is an ordinary file. Check to see if it is an image.
-	if(path.length() < 4 || path.compare(path.length() - 4, 4, ".txt"))
-		return;
-	
-	DataFile data(path);
 	if(debugMode)
 		Files::LogError("Parsing: " + path);
 	
@@ -16,12 +16,14 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Set.h"
 #include "Trade.h"
 
+#include <list>
 #include <map>
 #include <string>
 #include <vector>
 
 class Color;
 class Conversation;
+class DataFile;
 class DataNode;
 class DataWriter;
 class Date;
@@ -54,15 +56,36 @@ class System;
 // universe.
 class GameData {
 public:
-	static void BeginLoad(const char * const *argv);
+	// Begin loading the game data. A headless run (e.g. a benchmark) has no
+	// OpenGL context, so only what the engine needs is loaded.
+	static void BeginLoad(const char * const *argv, bool isHeadless = false);
 	// Check for objects that are referred to but never defined.
 	static void CheckReferences();
 	static void LoadShaders();
 	static double Progress();
 	// Begin loading a sprite that was previously deferred. Currently this is
-	// done with all landscapes to speed up the program's startup.
+	// done with all landscapes to speed up the program's startup. If sprites
+	// are being streamed, this also loads a streamed sprite before it is drawn.
 	static void Preload(const Sprite *sprite);
 	static void FinishLoading();
+	// Reload any data files that have changed since they were loaded, and bring
+	// the objects that depend on them up to date. This must not be called while
+	// the engine is calculating a step. Return the number of files reloaded.
+	static int Reload();
+	// Check whether the game was started in debug mode.
+	static bool DebugMode();
+	// If sprites are being streamed, load the ones that have been drawn since
+	// this was last called, and unload any that have not been drawn in a while
+	// if they take up more memory than the preferences allow. Also load the
+	// @2x frames of any sprite that has been drawn at high resolution. This
+	// should be called once per frame, after drawing.
+	static void StreamSprites();
+	// Load the @2x frames of every sprite that has not loaded them yet. This
+	// should be called if the screen is high DPI.
+	static void LoadHighDPI();
+	// Get the most memory this process has used so far, in megabytes, or zero
+	// if that is not known on this platform.
+	static double PeakMemory();
 	
 	// Get the list of resource sources (i.e. plugin folders).
 	static const std::vector<std::string> &Sources();
@@ -75,8 +98,9 @@ public:
 	static void WriteEconomy(DataWriter &out);
 	static void StepEconomy();
 	static void AddPurchase(const System &system, const std::string &commodity, int tons);
-	// Apply the given change to the universe.
-	static void Change(const DataNode &node);
+	// Apply the given changes to the universe, and update the neighbor lists of
+	// any systems they affect. Return true if any of them affected the systems.
+	static bool Change(const std::list<DataNode> &changes);
 	// Update the neighbor lists of all the systems. This must be done any time
 	// that a change creates or moves a system.
 	static void UpdateNeighbors();
@@ -91,6 +115,10 @@ public:
 	static const Set<Interface> &Interfaces();
 	static const Set<Minable> &Minables();
 	static const Set<Mission> &Missions();
+	// Get the mission templates that could possibly be offered on the given
+	// planet, in the same order as in Missions(). This leaves out any that are
+	// offered when boarding or assisting a ship.
+	static std::vector<const Mission *> MissionsOffered(const Planet *planet);
 	static const Set<Outfit> &Outfits();
 	static const Set<Person> &Persons();
 	static const Set<Phrase> &Phrases();
@@ -104,6 +132,12 @@ public:
 	
 	static const std::vector<Trade::Commodity> &Commodities();
 	static const std::vector<Trade::Commodity> &SpecialCommodities();
+	// Get the price of the given commodity in every system, or the number of
+	// ships or outfits for sale in every system, indexed by System::Index().
+	// These are only recalculated after the prices or the systems have changed.
+	static const std::vector<int> &SystemPrices(int commodity);
+	static const std::vector<int> &ShipyardSizes();
+	static const std::vector<int> &OutfitterSizes();
 	
 	// Custom messages to be shown when trying to land on certain stellar objects.
 	static bool HasLandingMessage(const Sprite *sprite);
@@ -124,7 +158,7 @@ public:
 	
 private:
 	static void LoadSources();
-	static void LoadFile(const std::string &path, bool debugMode);
+	static void LoadFile(const DataFile &data, const std::string &path, bool debugMode);
 	static void LoadImages(std::map<std::string, std::string> &images);
 	static void LoadImage(const std::string &path, std::map<std::string, std::string> &images, size_t start);
 	static std::string Name(const std::string &path);
@@ -93,7 +93,7 @@ void GameEvent::Apply(PlayerInfo &player)
 	for(const auto &it : GameData::Governments())
 	{
 		int rep = it.second.Reputation();
-		player.Conditions()["reputation: " + it.first] = rep;
+		player.Conditions().Set("reputation: " + it.first, rep);
 	}
 	
 	conditionsToApply.Apply(player.Conditions());
@@ -102,7 +102,7 @@ void GameEvent::Apply(PlayerInfo &player)
 	for(const auto &it : GameData::Governments())
 	{
 		int rep = it.second.Reputation();
-		int newRep = player.Conditions()["reputation: " + it.first];
+		int newRep = player.GetCondition("reputation: " + it.first);
 		if(rep != newRep)
 			it.second.AddReputation(newRep - rep);
 	}
@@ -24,6 +24,15 @@ using namespace std;
 
 namespace {
 	static unsigned nextID = 0;
+	
+	// Get the index in the penalty table of the given ShipEvent type.
+	int PenaltyIndex(int eventType)
+	{
+		int index = 0;
+		while(eventType >>= 1)
+			++index;
+		return index;
+	}
 }
 
 
@@ -32,12 +41,12 @@ namespace {
 Government::Government()
 {
 	// Default penalties:
-	penaltyFor[ShipEvent::ASSIST] = -0.1;
-	penaltyFor[ShipEvent::DISABLE] = 0.5;
-	penaltyFor[ShipEvent::BOARD] = 0.3;
-	penaltyFor[ShipEvent::CAPTURE] = 1.;
-	penaltyFor[ShipEvent::DESTROY] = 1.;
-	penaltyFor[ShipEvent::ATROCITY] = 10.;
+	penaltyFor[PenaltyIndex(ShipEvent::ASSIST)] = -0.1;
+	penaltyFor[PenaltyIndex(ShipEvent::DISABLE)] = 0.5;
+	penaltyFor[PenaltyIndex(ShipEvent::BOARD)] = 0.3;
+	penaltyFor[PenaltyIndex(ShipEvent::CAPTURE)] = 1.;
+	penaltyFor[PenaltyIndex(ShipEvent::DESTROY)] = 1.;
+	penaltyFor[PenaltyIndex(ShipEvent::ATROCITY)] = 10.;
 	
 	id = nextID++;
 }
@@ -78,17 +87,17 @@ void Government::Load(const DataNode &node)
 				if(grand.Size() >= 2)
 				{
 					if(grand.Token(0) == "assist")
-						penaltyFor[ShipEvent::ASSIST] = grand.Value(1);
+						penaltyFor[PenaltyIndex(ShipEvent::ASSIST)] = grand.Value(1);
 					else if(grand.Token(0) == "disable")
-						penaltyFor[ShipEvent::DISABLE] = grand.Value(1);
+						penaltyFor[PenaltyIndex(ShipEvent::DISABLE)] = grand.Value(1);
 					else if(grand.Token(0) == "board")
-						penaltyFor[ShipEvent::BOARD] = grand.Value(1);
+						penaltyFor[PenaltyIndex(ShipEvent::BOARD)] = grand.Value(1);
 					else if(grand.Token(0) == "capture")
-						penaltyFor[ShipEvent::CAPTURE] = grand.Value(1);
+						penaltyFor[PenaltyIndex(ShipEvent::CAPTURE)] = grand.Value(1);
 					else if(grand.Token(0) == "destroy")
-						penaltyFor[ShipEvent::DESTROY] = grand.Value(1);
+						penaltyFor[PenaltyIndex(ShipEvent::DESTROY)] = grand.Value(1);
 					else if(grand.Token(0) == "atrocity")
-						penaltyFor[ShipEvent::ATROCITY] = grand.Value(1);
+						penaltyFor[PenaltyIndex(ShipEvent::ATROCITY)] = grand.Value(1);
 					else
 						grand.PrintTrace("Skipping unrecognized attribute:");
 				}
@@ -138,6 +147,14 @@ const Color &Government::GetColor() const
 
 
 
+// Get the unique index of this government, for looking it up in tables.
+unsigned Government::Index() const
+{
+	return id;
+}
+
+
+
 // Get the government's initial disposition toward other governments or
 // toward the player.
 double Government::AttitudeToward(const Government *other) const
@@ -166,9 +183,9 @@ double Government::InitialPlayerReputation() const
 double Government::PenaltyFor(int eventType) const
 {
 	double penalty = 0.;
-	for(const auto &it : penaltyFor)
-		if(eventType & it.first)
-			penalty += it.second;
+	for(int i = 0; i < PENALTY_TYPES && (eventType >> i); ++i)
+		if(eventType & (1 << i))
+			penalty += penaltyFor[i];
 	return penalty;
 }
 
@@ -15,7 +15,6 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 #include "Color.h"
 
-#include <map>
 #include <string>
 #include <vector>
 
@@ -48,6 +47,8 @@ public:
 	int GetSwizzle() const;
 	// Get the color to use for displaying this government on the map.
 	const Color &GetColor() const;
+	// Get the unique index of this government, for looking it up in tables.
+	unsigned Index() const;
 	
 	// Get the government's initial disposition toward other governments or
 	// toward the player.
@@ -110,7 +111,9 @@ private:
 	
 	std::vector<double> attitudeToward;
 	double initialPlayerReputation = 0.;
-	std::map<int, double> penaltyFor;
+	// The penalty for each ShipEvent type, indexed by the bit it is stored in.
+	static const int PENALTY_TYPES = 10;
+	double penaltyFor[PENALTY_TYPES] = {};
 	double bribe = 0.;
 	double fine = 1.;
 	const Conversation *deathSentence = nullptr;
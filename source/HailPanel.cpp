@@ -184,7 +184,7 @@ void HailPanel::Draw()
 		}
 	}
 	
-	const Interface *interface = GameData::Interfaces().Get("hail panel");
+	static const Interface *interface = GameData::Interfaces().Get("hail panel");
 	interface->Draw(info, this);
 	
 	// Draw the sprite, rotated, scaled, and swizzled as necessary.
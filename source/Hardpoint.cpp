@@ -29,7 +29,7 @@ using namespace std;
 
 namespace {
 	// Create all the effects in the given list, at the given location, velocity, and angle.
-	void CreateEffects(const map<const Effect *, int> &m, Point pos, Point vel, Angle angle, list<Effect> &effects)
+	void CreateEffects(const map<const Effect *, int> &m, Point pos, Point vel, Angle angle, vector<Effect> &effects)
 	{
 		for(const auto &it : m)
 			for(int i = 0; i < it.second; ++i)
@@ -147,9 +147,9 @@ void Hardpoint::Step()
 
 
 // Fire this weapon. If it is a turret, it automatically points toward
-// the given ship's target. If the weapon requires ammunition, it will
-// be subtracted from the given ship.
-void Hardpoint::Fire(Ship &ship, list<Projectile> &projectiles, list<Effect> &effects)
+// the given target (which may be null). If the weapon requires ammunition,
+// it will be subtracted from the given ship.
+void Hardpoint::Fire(Ship &ship, const Ship *target, vector<Projectile> &projectiles, vector<Effect> &effects)
 {
 	// Since this is only called internally by Armament (no one else has non-
 	// const access), assume Armament checked that this is a valid call.
@@ -160,25 +160,15 @@ void Hardpoint::Fire(Ship &ship, list<Projectile> &projectiles, list<Effect> &ef
 	// ship that fired them.
 	Point start = ship.Position() + aim.Rotate(point) - .5 * ship.Velocity();
 	
-	shared_ptr<const Ship> target = ship.GetTargetShip();
-	// If you are boarding your target, do not fire on it.
-	if(ship.IsBoarding() || ship.Commands().Has(Command::BOARD))
-		target.reset();
-	
 	// If this is a fixed gun, or it if is a turret but you have no target
 	// selected, it should fire straight forward, angled in slightly to cause
 	// the shots to converge (gun harmonization).
-	if(!isTurret || !target || !target->IsTargetable())
+	if(!isTurret || !target)
 	{
 		// If this is a turret and it is not tracking a target, reset its angle
 		// to the proper convergence angle.
 		if(isTurret)
-		{
-			double d = outfit->Range();
-			// Projectiles with a range of zero should fire straight forward. A
-			// special check is needed to avoid divide by zero errors.
-			angle = Angle(d <= 0. ? 0. : -asin(point.X() / d) * TO_DEG);
-		}
+			angle = baseAngle;
 	}
 	else
 	{
@@ -216,7 +206,7 @@ void Hardpoint::Fire(Ship &ship, list<Projectile> &projectiles, list<Effect> &ef
 
 
 // Fire an anti-missile. Returns true if the missile should be killed.
-bool Hardpoint::FireAntiMissile(Ship &ship, const Projectile &projectile, list<Effect> &effects)
+bool Hardpoint::FireAntiMissile(Ship &ship, const Projectile &projectile, vector<Effect> &effects)
 {
 	// Make sure this hardpoint really is an anti-missile.
 	int strength = outfit->AntiMissile();
@@ -277,7 +267,8 @@ void Hardpoint::Install(const Outfit *outfit)
 		double d = outfit->Range();
 		// Projectiles with a range of zero should fire straight forward. A
 		// special check is needed to avoid divide by zero errors.
-		angle = Angle(d <= 0. ? 0. : -asin(point.X() / d) * TO_DEG);
+		baseAngle = Angle(d <= 0. ? 0. : -asin(point.X() / d) * TO_DEG);
+		angle = baseAngle;
 	}
 }
 
@@ -16,7 +16,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Point.h"
 #include "Angle.h"
 
-#include <list>
+#include <vector>
 
 class Effect;
 class Outfit;
@@ -55,11 +55,11 @@ public:
 	void Step();
 	
 	// Fire this weapon. If it is a turret, it automatically points toward
-	// the given ship's target. If the weapon requires ammunition, it will
-	// be subtracted from the given ship.
-	void Fire(Ship &ship, std::list<Projectile> &projectiles, std::list<Effect> &effects);
+	// the given target (which may be null). If the weapon requires ammunition,
+	// it will be subtracted from the given ship.
+	void Fire(Ship &ship, const Ship *target, std::vector<Projectile> &projectiles, std::vector<Effect> &effects);
 	// Fire an anti-missile. Returns true if the missile should be killed.
-	bool FireAntiMissile(Ship &ship, const Projectile &projectile, std::list<Effect> &effects);
+	bool FireAntiMissile(Ship &ship, const Projectile &projectile, std::vector<Effect> &effects);
 	
 	// Install a weapon here (assuming it is empty). This is only for
 	// Armament to call internally.
@@ -78,6 +78,8 @@ private:
 	Point point;
 	// Angle adjustment for convergence.
 	Angle angle;
+	// The convergence angle that a turret returns to when it has no target.
+	Angle baseAngle;
 	// Reload timers and other attributes.
 	double reload = 0.;
 	double burstReload = 0.;
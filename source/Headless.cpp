@@ -0,0 +1,689 @@
+/* Headless.cpp
+Copyright (c) 2017 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "Headless.h"
+
+#include "DataFile.h"
+#include "DataNode.h"
+#include "DataWriter.h"
+#include "DistanceMap.h"
+#include "Engine.h"
+#include "Files.h"
+#include "Fleet.h"
+#include "GameData.h"
+#include "Government.h"
+#include "Planet.h"
+#include "PlayerInfo.h"
+#include "Point.h"
+#include "Profiler.h"
+#include "Random.h"
+#include "Replay.h"
+#include "SaveJournal.h"
+#include "Screen.h"
+#include "Ship.h"
+#include "System.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+
+
+// Check whether the command line asks for one of the tools that run without a
+// window. If it does, run that tool, set the exit status it returns, and
+// return true.
+bool Headless::Run(const char * const *argv, int &status)
+{
+	for(const char * const *it = argv + 1; *it; ++it)
+	{
+		string arg = *it;
+		if(arg == "--compare-logs" && it[1] && it[2])
+			status = CompareStateLogs(it[1], it[2]);
+		else if(arg == "--convert" && it[1] && it[2])
+			status = ConvertSave(it[1], it[2]);
+		else if(arg == "--benchmark" && it[1])
+		{
+			Init(argv);
+			status = RunBenchmark(it[1]);
+		}
+		else if(arg == "--simulate" && it[1])
+		{
+			Init(argv);
+			status = RunSimulation(it[1]);
+		}
+		else if(arg == "--soak" && it[1])
+		{
+			Init(argv);
+			status = RunSoak(it[1]);
+		}
+		else if(arg == "--generate-galaxy" && it[1] && it[2])
+		{
+			Init(argv);
+			status = GenerateGalaxy(max(1, atoi(it[1])), it[2]);
+		}
+		else
+			continue;
+		return true;
+	}
+	return false;
+}
+
+
+
+// Load the game data without a window or an OpenGL context, and set up
+// everything else that the engine needs to run the same way every time.
+void Headless::Init(const char * const *argv)
+{
+	GameData::BeginLoad(argv, true);
+	// Culling depends on the screen size, so use the same size every time.
+	Screen::SetRaw(1920, 1080);
+}
+
+
+
+// Convert a saved game from text to the binary form, or from binary to text.
+int Headless::ConvertSave(const string &from, const string &to)
+{
+	string data = Files::Read(from);
+	if(Files::IsCompressed(data.data(), data.data() + data.size()))
+		data = Files::Decompress(data.data(), data.data() + data.size());
+	bool isBinary = DataFile::IsBinary(data.data(), data.data() + data.size());
+	
+	DataFile file = SaveJournal::Load(from);
+	DataWriter out(to);
+	if(!isBinary)
+		out.EnableBinary();
+	for(const DataNode &node : file)
+		out.Write(node);
+	return 0;
+}
+
+
+
+// Run a scenario as fast as possible without drawing it. The scenario file
+// names the system it takes place in and the fleets to place there, e.g.:
+//   system Rutilicus
+//   fleet "Small Southern Merchants" 4
+//   fleet "Large Core Pirates" 2
+//   steps 3600
+//   seed 1
+// To time more steps of the same battle, it may be run several times, each
+// time starting over from a snapshot taken right after the fleets are placed:
+//   runs 5
+// It may also ask for the calculations that depend on the size of the whole
+// galaxy to be timed, by giving how many route maps to build from systems
+// spread across the map, and how many days of the economy to simulate:
+//   routes 100
+//   economy 100
+int Headless::RunBenchmark(const string &path)
+{
+	const System *system = nullptr;
+	vector<const Fleet *> fleets;
+	int steps = 3600;
+	int runs = 1;
+	uint64_t seed = 0;
+	int routes = 0;
+	int economy = 0;
+	string replay;
+	DataFile file(path);
+	for(const DataNode &node : file)
+	{
+		if(node.Token(0) == "system" && node.Size() >= 2)
+			system = GameData::Systems().Find(node.Token(1));
+		else if(node.Token(0) == "fleet" && node.Size() >= 2)
+		{
+			const Fleet *fleet = GameData::Fleets().Find(node.Token(1));
+			if(!fleet || !fleet->GetGovernment())
+			{
+				node.PrintTrace("Skipping undefined fleet:");
+				continue;
+			}
+			int count = (node.Size() >= 3) ? max(0., node.Value(2)) : 1;
+			fleets.insert(fleets.end(), count, fleet);
+		}
+		else if(node.Token(0) == "steps" && node.Size() >= 2)
+			steps = max(0., node.Value(1));
+		else if(node.Token(0) == "runs" && node.Size() >= 2)
+			runs = max(1., node.Value(1));
+		else if(node.Token(0) == "seed" && node.Size() >= 2)
+			seed = node.Value(1);
+		else if(node.Token(0) == "routes" && node.Size() >= 2)
+			routes = max(0., node.Value(1));
+		else if(node.Token(0) == "economy" && node.Size() >= 2)
+			economy = max(0., node.Value(1));
+		else if(node.Token(0) == "replay" && node.Size() >= 2)
+			replay = node.Token(1);
+		else
+			node.PrintTrace("Skipping unrecognized attribute:");
+	}
+	
+	PlayerInfo player;
+	if(!replay.empty())
+	{
+		if(!Replay::Load(replay, player))
+		{
+			cerr << "Unable to load the replay \"" << replay << "\"." << endl;
+			return 1;
+		}
+	}
+	else if(!system || system->Name().empty())
+	{
+		cerr << "The benchmark must take place in a defined system." << endl;
+		return 1;
+	}
+	else
+	{
+		Random::Seed(seed);
+		player.SetSystem(system);
+	}
+	
+	int ships = 0;
+	double seconds = 0.;
+	{
+		Engine engine(player);
+		// Don't count the time spent loading as part of the first step.
+		Profiler::Reset();
+		auto start = chrono::steady_clock::now();
+		if(Replay::IsPlaying())
+		{
+			// Take off the same way the planet panel and main panel do when
+			// the replay is recorded, then play back one step at a time.
+			Replay::Begin(player);
+			player.TakeOff(nullptr);
+			engine.Place();
+			engine.Go();
+			engine.Wait();
+			engine.Step(true);
+			engine.Go();
+			Profiler::EndFrame();
+			for(steps = 1; Replay::PlayStep(engine, player); ++steps)
+				Profiler::EndFrame();
+			Replay::End();
+		}
+		else
+		{
+			ships = engine.Simulate(fleets, steps, runs);
+			steps *= runs;
+		}
+		seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	}
+	
+	Profiler::PrintTotals();
+	cout << steps << " steps in " << seconds << " seconds ("
+		<< (seconds ? steps / seconds : 0.) << " steps per second)." << endl;
+	if(!replay.empty())
+	{
+		// Where the flagship ends up is a quick check that the replay was the
+		// same as what was recorded.
+		const Ship *flagship = player.Flagship();
+		if(flagship)
+			cout << "Flagship ended at " << flagship->Position().X() << ", "
+				<< flagship->Position().Y() << "." << endl;
+	}
+	else
+		cout << ships << " ships remaining." << endl;
+	
+	if(routes)
+	{
+		vector<const System *> systems;
+		for(const auto &it : GameData::Systems())
+			if(!it.second.Name().empty())
+				systems.push_back(&it.second);
+		auto start = chrono::steady_clock::now();
+		for(int i = 0; i < routes && !systems.empty(); ++i)
+			DistanceMap distance(systems[i * systems.size() / routes]);
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		cout << routes << " route maps of " << systems.size() << " systems in " << seconds << " seconds." << endl;
+	}
+	if(economy)
+	{
+		auto start = chrono::steady_clock::now();
+		for(int i = 0; i < economy; ++i)
+			GameData::StepEconomy();
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		cout << economy << " days of the economy in " << seconds << " seconds." << endl;
+	}
+	return 0;
+}
+
+
+
+// Run many battles between pairs of fleets, spread across all the cores, and
+// report how often each side wins. Each battle gets its own engine and its own
+// random seed, so the results are the same no matter how many cores there are.
+int Headless::RunSimulation(const string &path)
+{
+	const System *system = nullptr;
+	vector<pair<const Fleet *, const Fleet *>> matchups;
+	int battles = 100;
+	int maxSteps = 60 * 60 * 5;
+	uint64_t seed = 0;
+	DataFile file(path);
+	for(const DataNode &node : file)
+	{
+		if(node.Token(0) == "system" && node.Size() >= 2)
+			system = GameData::Systems().Find(node.Token(1));
+		else if(node.Token(0) == "battle" && node.Size() >= 3)
+		{
+			const Fleet *first = GameData::Fleets().Find(node.Token(1));
+			const Fleet *second = GameData::Fleets().Find(node.Token(2));
+			if(!first || !first->GetGovernment() || !second || !second->GetGovernment())
+				node.PrintTrace("Skipping battle with an undefined fleet:");
+			else if(first->GetGovernment() == second->GetGovernment())
+				node.PrintTrace("Skipping battle between fleets of the same government:");
+			else
+				matchups.emplace_back(first, second);
+		}
+		else if(node.Token(0) == "battles" && node.Size() >= 2)
+			battles = max(1., node.Value(1));
+		else if(node.Token(0) == "steps" && node.Size() >= 2)
+			maxSteps = max(1., node.Value(1));
+		else if(node.Token(0) == "seed" && node.Size() >= 2)
+			seed = node.Value(1);
+		else
+			node.PrintTrace("Skipping unrecognized attribute:");
+	}
+	if(!system || system->Name().empty())
+	{
+		cerr << "The battles must take place in a defined system." << endl;
+		return 1;
+	}
+	if(matchups.empty())
+	{
+		cerr << "No battles to simulate." << endl;
+		return 1;
+	}
+	
+	// For each battle, which side won (0 or 1, or -1 for neither), and how many
+	// steps it took.
+	size_t total = matchups.size() * battles;
+	vector<int> winners(total, -1);
+	vector<int> steps(total, 0);
+	atomic<size_t> next(0);
+	auto run = [&]()
+	{
+		for(size_t i = next++; i < total; i = next++)
+		{
+			const pair<const Fleet *, const Fleet *> &matchup = matchups[i / battles];
+			Random::Seed(seed, i);
+			PlayerInfo player;
+			player.SetSystem(system);
+			Engine engine(player);
+			const Government *winner = engine.Battle({matchup.first, matchup.second}, maxSteps, steps[i]);
+			if(winner == matchup.first->GetGovernment())
+				winners[i] = 0;
+			else if(winner == matchup.second->GetGovernment())
+				winners[i] = 1;
+		}
+	};
+	
+	auto start = chrono::steady_clock::now();
+	unsigned threadCount = max(1u, thread::hardware_concurrency());
+	vector<thread> threads;
+	for(unsigned i = 1; i < threadCount; ++i)
+		threads.emplace_back(run);
+	run();
+	for(thread &it : threads)
+		it.join();
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	
+	int64_t totalSteps = 0;
+	for(size_t m = 0; m < matchups.size(); ++m)
+	{
+		const Fleet *fleets[2] = {matchups[m].first, matchups[m].second};
+		int wins[2] = {0, 0};
+		int64_t winSteps[2] = {0, 0};
+		for(size_t i = m * battles; i < (m + 1) * battles; ++i)
+		{
+			totalSteps += steps[i];
+			if(winners[i] >= 0)
+			{
+				++wins[winners[i]];
+				winSteps[winners[i]] += steps[i];
+			}
+		}
+		
+		cout << fleets[0]->GetGovernment()->GetName() << " vs. " << fleets[1]->GetGovernment()->GetName()
+			<< " (" << battles << " battles):" << endl;
+		for(int side = 0; side < 2; ++side)
+		{
+			cout << "    " << fleets[side]->GetGovernment()->GetName() << " won "
+				<< (100. * wins[side]) / battles << "%";
+			if(wins[side])
+				cout << ", taking " << (winSteps[side] / 60.) / wins[side] << " seconds on average";
+			cout << "." << endl;
+		}
+		int draws = battles - wins[0] - wins[1];
+		if(draws)
+			cout << "    " << (100. * draws) / battles << "% were not over after "
+				<< maxSteps / 60. << " seconds." << endl;
+	}
+	cout << total << " battles (" << totalSteps << " steps) in " << seconds << " seconds on "
+		<< threadCount << " threads: " << (seconds ? totalSteps / seconds : 0.) << " steps per second, "
+		<< (seconds ? total / seconds : 0.) << " battles per second." << endl;
+	return 0;
+}
+
+
+
+// Fly the pilot in the given saved game around a route of planets for many
+// days without drawing anything, to catch memory leaks and anything that gets
+// slower as the pilot's history grows. Each day, the pilot takes off, jumps
+// straight to the next planet's system, arrives there the same way the engine
+// does after any jump (which is what advances the date by one day), lets the
+// engine run for a while, lands, and takes every job there is room for. The scenario file says:
+//   pilot "saves/Some Pilot.txt"
+//   route "New Boston" "Luna" "Martini"
+//   days 3650
+//   report 100
+//   steps 600
+//   output "soak.txt"
+// Every "report" days, the pilot is saved to the output file, and the time each
+// part of a day took, on average, is printed along with the peak memory use.
+int Headless::RunSoak(const string &path)
+{
+	string pilot;
+	vector<const Planet *> route;
+	int days = 365;
+	int report = 30;
+	int steps = 600;
+	string output = Files::Config() + "soak.txt";
+	DataFile file(path);
+	for(const DataNode &node : file)
+	{
+		if(node.Token(0) == "pilot" && node.Size() >= 2)
+			pilot = node.Token(1);
+		else if(node.Token(0) == "route")
+			for(int i = 1; i < node.Size(); ++i)
+			{
+				const Planet *planet = GameData::Planets().Find(node.Token(i));
+				if(planet && planet->GetSystem())
+					route.push_back(planet);
+				else
+					node.PrintTrace("Skipping undefined planet \"" + node.Token(i) + "\":");
+			}
+		else if(node.Token(0) == "days" && node.Size() >= 2)
+			days = max(1., node.Value(1));
+		else if(node.Token(0) == "report" && node.Size() >= 2)
+			report = max(1., node.Value(1));
+		else if(node.Token(0) == "steps" && node.Size() >= 2)
+			steps = max(0., node.Value(1));
+		else if(node.Token(0) == "output" && node.Size() >= 2)
+			output = node.Token(1);
+		else
+			node.PrintTrace("Skipping unrecognized attribute:");
+	}
+	
+	PlayerInfo player;
+	if(!pilot.empty())
+	{
+		player.Load(pilot);
+		player.ApplyChanges();
+	}
+	if(!player.IsLoaded() || !player.GetPlanet() || !player.Flagship())
+	{
+		cerr << "The soak test needs a pilot who is landed and has a flagship." << endl;
+		return 1;
+	}
+	if(route.empty())
+	{
+		cerr << "The soak test needs a route with at least one planet on it." << endl;
+		return 1;
+	}
+	
+	Engine engine(player);
+	auto Since = [](chrono::steady_clock::time_point start)
+	{
+		return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	};
+	
+	// The total time spent in each part of the days since the last report, in
+	// milliseconds, and how many jobs were taken in those days.
+	double arriveTime = 0.;
+	double stepTime = 0.;
+	double landTime = 0.;
+	int jobs = 0;
+	int lastReport = 0;
+	printf("%8s  %-20s%10s%10s%10s%10s%10s%10s%10s\n", "day", "date",
+		"arrive ms", "step ms", "land ms", "save ms", "missions", "jobs", "peak MB");
+	for(int day = 1; day <= days; ++day)
+	{
+		const Planet *planet = route[(day - 1) % route.size()];
+		if(!player.TakeOff(nullptr))
+		{
+			cerr << "The pilot was unable to take off on day " << day << "." << endl;
+			return 1;
+		}
+		
+		// Every ship that is with the flagship comes along on the jump.
+		const System *system = planet->GetSystem();
+		for(const shared_ptr<Ship> &ship : player.Ships())
+			if(ship->GetSystem() == player.GetSystem() && !ship->IsParked())
+				ship->SetSystem(system);
+		player.SetSystem(system);
+		
+		// Placing the flagship in the new system advances the date, steps the
+		// economy and creates the system's fleets, just as arriving there after
+		// a jump in the game does.
+		auto start = chrono::steady_clock::now();
+		engine.Place();
+		arriveTime += Since(start);
+		
+		start = chrono::steady_clock::now();
+		engine.Simulate(vector<const Fleet *>(), steps);
+		stepTime += Since(start);
+		
+		// Landing is also when new missions and jobs are created.
+		start = chrono::steady_clock::now();
+		player.SetPlanet(planet);
+		player.Land(nullptr);
+		landTime += Since(start);
+		if(player.IsDead())
+		{
+			cerr << "The pilot died on day " << day << "." << endl;
+			return 1;
+		}
+		
+		for(bool accepted = true; accepted; )
+		{
+			accepted = false;
+			for(const Mission &mission : player.AvailableJobs())
+				if(mission.HasSpace(player))
+				{
+					player.AcceptJob(mission, nullptr);
+					accepted = true;
+					++jobs;
+					break;
+				}
+		}
+		
+		if(day % report && day != days)
+			continue;
+		
+		start = chrono::steady_clock::now();
+		player.Save(output);
+		double saveTime = Since(start);
+		
+		int count = day - lastReport;
+		printf("%8d  %-20s%10.3f%10.3f%10.3f%10.3f%10d%10d%10.1f\n", day, player.GetDate().ToString().c_str(),
+			arriveTime / count, steps ? stepTime / (count * steps) : 0., landTime / count, saveTime,
+			static_cast<int>(player.Missions().size()), jobs, GameData::PeakMemory());
+		fflush(stdout);
+		arriveTime = 0.;
+		stepTime = 0.;
+		landTime = 0.;
+		jobs = 0;
+		lastReport = day;
+	}
+	return 0;
+}
+
+
+
+// Write a synthetic galaxy with the given number of systems to the given file,
+// to be loaded as part of a plugin, so that the parts of the game that depend
+// on the size of the map can be tested with far more systems than the game
+// has. A benchmark scenario set in the middle of it is printed to stdout.
+int Headless::GenerateGalaxy(int count, const string &path)
+{
+	// The systems are laid out in a jittered square grid far from the rest of
+	// the map, about as far apart as ordinary systems are. Each row is linked
+	// from end to end, the rows are linked at the start, and half of the other
+	// links to the next row are kept, for an average of three per system.
+	static const double SPACING = 80.;
+	static const Point ORIGIN(5000., 5000.);
+	int columns = max(1, static_cast<int>(ceil(sqrt(count))));
+	Random::Seed(count);
+	auto Name = [](int i) { return "Synthetic " + to_string(i + 1); };
+	
+	vector<Point> positions;
+	vector<vector<int>> links(count);
+	for(int i = 0; i < count; ++i)
+	{
+		int x = i % columns;
+		int y = i / columns;
+		positions.push_back(ORIGIN + SPACING * Point(x + .6 * (Random::Real() - .5), y + .6 * (Random::Real() - .5)));
+		
+		if(x + 1 < columns && i + 1 < count)
+		{
+			links[i].push_back(i + 1);
+			links[i + 1].push_back(i);
+		}
+		if(i + columns < count && (!x || Random::Real() < .5))
+		{
+			links[i].push_back(i + columns);
+			links[i + columns].push_back(i);
+		}
+	}
+	
+	// Divide the galaxy into regions belonging to some of the governments and
+	// fleets of the ordinary game, so that the systems have some traffic.
+	vector<string> governments;
+	for(const char *name : {"Republic", "Free Worlds", "Syndicate", "Pirate"})
+		if(GameData::Governments().Find(name))
+			governments.push_back(name);
+	vector<string> fleets;
+	for(const char *name : {"Small Southern Merchants", "Large Southern Merchants", "Small Republic", "Small Southern Pirates"})
+		if(GameData::Fleets().Find(name))
+			fleets.push_back(name);
+	if(governments.empty())
+	{
+		cerr << "The synthetic galaxy needs the game's ordinary governments to be loaded." << endl;
+		return 1;
+	}
+	
+	DataWriter out(path);
+	for(int i = 0; i < count; ++i)
+	{
+		out.Write("system", Name(i));
+		out.BeginChild();
+		{
+			out.Write("pos", positions[i].X(), positions[i].Y());
+			out.Write("government", governments[(i % columns / 8 + i / columns / 8) % governments.size()]);
+			out.Write("habitable", 1000);
+			out.Write("belt", 1500);
+			for(int link : links[i])
+				out.Write("link", Name(link));
+			for(const Trade::Commodity &commodity : GameData::Commodities())
+				out.Write("trade", commodity.name,
+					commodity.low + static_cast<int>(Random::Int(max(1, commodity.high - commodity.low))));
+			for(const string &fleet : fleets)
+				out.Write("fleet", fleet, 1000 + static_cast<int>(Random::Int(2000)));
+			out.Write("object");
+			out.BeginChild();
+			{
+				out.Write("sprite", "star/g0");
+				out.Write("period", 25);
+			}
+			out.EndChild();
+			// One system in three has a planet that can be landed on.
+			if(i % 3 == 0)
+			{
+				out.Write("object", Name(i) + " Prime");
+				out.BeginChild();
+				{
+					out.Write("sprite", "planet/earth");
+					out.Write("distance", 600);
+					out.Write("period", 200);
+				}
+				out.EndChild();
+			}
+		}
+		out.EndChild();
+	}
+	for(int i = 0; i < count; i += 3)
+	{
+		out.Write("planet", Name(i) + " Prime");
+		out.BeginChild();
+		{
+			out.Write("attributes", "urban");
+			out.Write("landscape", "land/city3");
+			out.Write("description", "A synthetic world, generated for testing.");
+			out.Write("spaceport", "A synthetic spaceport, generated for testing.");
+			out.Write("security", .5);
+		}
+		out.EndChild();
+	}
+	
+	int center = min(count - 1, (columns / 2) * columns + columns / 2);
+	cout << "system \"" << Name(center) << "\"" << endl;
+	for(const string &fleet : fleets)
+		cout << "fleet \"" << fleet << "\" 2" << endl;
+	cout << "steps 3600" << endl;
+	cout << "routes 100" << endl;
+	cout << "economy 100" << endl;
+	return 0;
+}
+
+
+
+// Find the first line where two state logs differ. Each line is one ship, or
+// everything else, in one step, so this shows when the two runs diverged and
+// what diverged first.
+int Headless::CompareStateLogs(const string &first, const string &second)
+{
+	ifstream firstIn(first);
+	ifstream secondIn(second);
+	istream *in[2] = {&firstIn, &secondIn};
+	if(!firstIn || !secondIn)
+	{
+		cerr << "Unable to read \"" << (firstIn ? second : first) << "\"." << endl;
+		return 1;
+	}
+	
+	string line[2];
+	int64_t count = 0;
+	while(true)
+	{
+		bool hasLine[2] = {static_cast<bool>(getline(*in[0], line[0])), static_cast<bool>(getline(*in[1], line[1]))};
+		if(!hasLine[0] && !hasLine[1])
+			break;
+		if(hasLine[0] != hasLine[1] || line[0] != line[1])
+		{
+			cout << "The logs differ at line " << (count + 1) << ":" << endl;
+			cout << "    " << first << ": " << (hasLine[0] ? line[0] : "(end of file)") << endl;
+			cout << "    " << second << ": " << (hasLine[1] ? line[1] : "(end of file)") << endl;
+			return 1;
+		}
+		++count;
+	}
+	cout << "The logs are identical (" << count << " lines)." << endl;
+	return 0;
+}
@@ -0,0 +1,55 @@
+/* Headless.h
+Copyright (c) 2017 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef HEADLESS_H_
+#define HEADLESS_H_
+
+#include <string>
+
+
+
+// The tools that run from the command line without opening a window: the
+// benchmark, battle simulation and soak test, the synthetic galaxy generator,
+// and utilities for converting saved games and comparing state logs. Each one
+// returns the exit status for the program.
+class Headless {
+public:
+	// Check whether the command line asks for one of the tools that run without a
+	// window. If it does, run that tool, set the exit status it returns, and
+	// return true.
+	static bool Run(const char * const *argv, int &status);
+	// Load the game data without a window or an OpenGL context, and set up
+	// everything else that the engine needs to run the same way every time.
+	static void Init(const char * const *argv);
+	
+	
+private:
+	// Convert a saved game from text to the binary form, or from binary to text.
+	static int ConvertSave(const std::string &from, const std::string &to);
+	// Run a scenario as fast as possible without drawing it.
+	static int RunBenchmark(const std::string &path);
+	// Run many battles between pairs of fleets, spread across all the cores, and
+	// report how often each side wins.
+	static int RunSimulation(const std::string &path);
+	// Fly the pilot in the given saved game around a route of planets for many
+	// days without drawing anything.
+	static int RunSoak(const std::string &path);
+	// Write a synthetic galaxy with the given number of systems to the given file,
+	// and print a benchmark scenario set in the middle of it.
+	static int GenerateGalaxy(int count, const std::string &path);
+	// Find the first line where two state logs differ.
+	static int CompareStateLogs(const std::string &first, const std::string &second);
+};
+
+
+
+#endif
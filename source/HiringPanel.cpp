@@ -28,6 +28,7 @@ HiringPanel::HiringPanel(PlayerInfo &player)
 	: player(player), maxHire(0), maxFire(0)
 {
 	SetTrapAllEvents(false);
+	SetIsStatic(true);
 }
 
 
@@ -48,7 +49,7 @@ void HiringPanel::Draw()
 	// Draw a line in the same place as the trading and bank panels.
 	FillShader::Fill(Point(-60., 95.), Point(480., 1.), *GameData::Colors().Get("medium"));
 	
-	const Interface *interface = GameData::Interfaces().Get("hiring");
+	static const Interface *interface = GameData::Interfaces().Get("hiring");
 	Information info;
 	
 	int flagshipBunks = flagship.Attributes().Get("bunks");
@@ -13,19 +13,39 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "ImageBuffer.h"
 
 #include "File.h"
+#include "Files.h"
+#include "MappedFile.h"
 
 #include <png.h>
 #include <jpeglib.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <vector>
 
 using namespace std;
 
 namespace {
+	// Bump this whenever a change to the compressor would produce different
+	// blocks, so that images compressed by older versions are redone.
+	const uint32_t CACHE_VERSION = 1;
+	
 	ImageBuffer *ReadPNG(const string &path);
 	ImageBuffer *ReadJPG(const string &path);
+	bool ReadPNGSize(const string &path, int &width, int &height);
+	bool ReadJPGSize(const string &path, int &width, int &height);
 	void Premultiply(ImageBuffer *buffer, int additive);
+	void PremultiplyPixels(uint32_t *it, uint32_t *end, int additive);
+	void ShrinkRow(const unsigned char *aIt, const unsigned char *bIt, unsigned char *out, int outWidth);
+	void CompressBlock(const ImageBuffer &image, int x, int y, char *out);
+	void DecompressBlock(const char *in, ImageBuffer &image, int x, int y);
+	string CachePath(const string &path);
 }
 
 
@@ -97,20 +117,11 @@ void ImageBuffer::ShrinkToHalfSize()
 {
 	ImageBuffer result(width / 2, height / 2);
 	
-	unsigned char *begin = reinterpret_cast<unsigned char *>(pixels);
+	const unsigned char *begin = reinterpret_cast<const unsigned char *>(pixels);
 	unsigned char *out = reinterpret_cast<unsigned char *>(result.pixels);
 	for(int y = 0; y < result.height; ++y)
-	{
-		unsigned char *aIt = begin + (4 * width) * (2 * y);
-		unsigned char *aEnd = aIt + 4 * 2 * result.width;
-		unsigned char *bIt = begin + (4 * width) * (2 * y + 1);
-		for( ; aIt != aEnd; aIt += 4, bIt += 4)
-		{
-			for(int channel = 0; channel < 4; ++channel, ++aIt, ++bIt, ++out)
-				*out = (static_cast<unsigned>(aIt[0]) + static_cast<unsigned>(bIt[0])
-					+ static_cast<unsigned>(aIt[4]) + static_cast<unsigned>(bIt[4]) + 2) / 4;
-		}
-	}
+		ShrinkRow(begin + (4 * width) * (2 * y), begin + (4 * width) * (2 * y + 1),
+			out + (4 * result.width) * y, result.width);
 	swap(width, result.width);
 	swap(height, result.height);
 	swap(pixels, result.pixels);
@@ -118,6 +129,58 @@ void ImageBuffer::ShrinkToHalfSize()
 
 
 
+// Convert this image to DXT5 blocks, discarding the pixels.
+bool ImageBuffer::Compress()
+{
+	if(!pixels || !width || !height || (width & 3) || (height & 3))
+		return false;
+	
+	// Each 4x4 block of pixels is compressed to 16 bytes.
+	blocks.resize(static_cast<size_t>(width) * height);
+	char *out = &blocks[0];
+	for(int y = 0; y < height; y += 4)
+		for(int x = 0; x < width; x += 4, out += 16)
+			CompressBlock(*this, x, y, out);
+	
+	delete [] pixels;
+	pixels = nullptr;
+	return true;
+}
+
+
+
+// Convert the compressed blocks back to pixels.
+void ImageBuffer::Decompress()
+{
+	if(blocks.empty())
+		return;
+	
+	pixels = new uint32_t[width * height];
+	const char *in = blocks.data();
+	for(int y = 0; y < height; y += 4)
+		for(int x = 0; x < width; x += 4, in += 16)
+			DecompressBlock(in, *this, x, y);
+	
+	blocks.clear();
+	blocks.shrink_to_fit();
+}
+
+
+
+bool ImageBuffer::IsCompressed() const
+{
+	return !blocks.empty();
+}
+
+
+
+const string &ImageBuffer::Blocks() const
+{
+	return blocks;
+}
+
+
+
 ImageBuffer *ImageBuffer::Read(const string &path)
 {
 	// First, make sure this is a JPG or PNG file.
@@ -154,6 +217,81 @@ ImageBuffer *ImageBuffer::Read(const string &path)
 
 
 
+// Read just the dimensions of the given image, without decoding it.
+bool ImageBuffer::ReadSize(const string &path, int &width, int &height)
+{
+	if(path.length() < 4)
+		return false;
+	
+	string extension = path.substr(path.length() - 4);
+	if(extension == ".png" || extension == ".PNG")
+		return ReadPNGSize(path, width, height);
+	if(extension == ".jpg" || extension == ".JPG")
+		return ReadJPGSize(path, width, height);
+	return false;
+}
+
+
+
+// Read the compressed copy of the given image from the cache, if there is one
+// and the image has not changed since it was saved.
+ImageBuffer *ImageBuffer::ReadCompressed(const string &path)
+{
+	string cachePath = CachePath(path);
+	if(cachePath.empty())
+		return nullptr;
+	MappedFile file(cachePath);
+	if(!file)
+		return nullptr;
+	
+	// The file begins with the cache version, the image timestamp, the image
+	// dimensions, and the length of the image path, followed by the path.
+	uint32_t header[5];
+	if(file.Size() < sizeof(header))
+		return nullptr;
+	memcpy(header, file.begin(), sizeof(header));
+	const char *it = file.begin() + sizeof(header);
+	
+	uint64_t timestamp = static_cast<uint64_t>(Files::Timestamp(path));
+	size_t size = static_cast<size_t>(header[2]) * header[3];
+	if(header[0] != CACHE_VERSION || header[1] != static_cast<uint32_t>(timestamp)
+			|| header[4] != path.length() || !header[2] || !header[3] || (header[2] & 3) || (header[3] & 3)
+			|| static_cast<size_t>(file.end() - it) != header[4] + size
+			|| path.compare(0, string::npos, it, header[4]))
+		return nullptr;
+	it += header[4];
+	
+	ImageBuffer *buffer = new ImageBuffer;
+	buffer->width = header[2];
+	buffer->height = header[3];
+	buffer->blocks.assign(it, size);
+	return buffer;
+}
+
+
+
+void ImageBuffer::SaveCompressed(const string &path) const
+{
+	string cachePath = CachePath(path);
+	if(cachePath.empty() || blocks.empty())
+		return;
+	
+	uint32_t header[5] = {
+		CACHE_VERSION,
+		static_cast<uint32_t>(Files::Timestamp(path)),
+		static_cast<uint32_t>(width),
+		static_cast<uint32_t>(height),
+		static_cast<uint32_t>(path.length())
+	};
+	string data(reinterpret_cast<const char *>(header), sizeof(header));
+	data += path;
+	data += blocks;
+	
+	Files::WriteAtomically(cachePath, data);
+}
+
+
+
 namespace {
 	ImageBuffer *ReadPNG(const string &path)
 	{
@@ -257,32 +395,358 @@ namespace {
 	
 	
 	
+	bool ReadPNGSize(const string &path, int &width, int &height)
+	{
+		File file(path);
+		if(!file)
+			return false;
+		
+		png_struct *png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+		if(!png)
+			return false;
+		
+		png_info *info = png_create_info_struct(png);
+		if(!info)
+		{
+			png_destroy_read_struct(&png, nullptr, nullptr);
+			return false;
+		}
+		
+		if(setjmp(png_jmpbuf(png)))
+		{
+			png_destroy_read_struct(&png, &info, nullptr);
+			return false;
+		}
+		
+		// The dimensions are in the header, so there is no need to read any
+		// further than that.
+		png_init_io(png, file);
+		png_set_sig_bytes(png, 0);
+		png_read_info(png, info);
+		width = png_get_image_width(png, info);
+		height = png_get_image_height(png, info);
+		
+		png_destroy_read_struct(&png, &info, nullptr);
+		return (width && height);
+	}
+	
+	
+	
+	bool ReadJPGSize(const string &path, int &width, int &height)
+	{
+		File file(path);
+		if(!file)
+			return false;
+		
+		jpeg_decompress_struct cinfo;
+		struct jpeg_error_mgr jerr;
+		cinfo.err = jpeg_std_error(&jerr);
+		jpeg_create_decompress(&cinfo);
+		
+		jpeg_stdio_src(&cinfo, file);
+		jpeg_read_header(&cinfo, true);
+		width = cinfo.image_width;
+		height = cinfo.image_height;
+		
+		jpeg_destroy_decompress(&cinfo);
+		return (width && height);
+	}
+	
+	
+	
 	void Premultiply(ImageBuffer *buffer, int additive)
 	{
 		if(!buffer)
 			return;
 		
-		for(int y = 0; y < buffer->Height(); ++y)
+		// The rows of pixels are stored one after another, with no padding.
+		uint32_t *begin = buffer->Begin(0);
+		PremultiplyPixels(begin, begin + static_cast<size_t>(buffer->Width()) * buffer->Height(), additive);
+	}
+	
+	
+	
+	// Premultiply the given pixels by their alpha. If "additive" is 1, the
+	// alpha is also divided by four, and if it is 2, the alpha is set to zero.
+	void PremultiplyPixels(uint32_t *it, uint32_t *end, int additive)
+	{
+#ifdef __SSE2__
+		// Four pixels at a time, with each channel widened to 16 bits. Dividing
+		// a product of two bytes by 255 is the same as multiplying it by 0x8081
+		// and shifting right by 23 bits, which rounds down the same way.
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i divide = _mm_set1_epi16(static_cast<short>(0x8081));
+		const __m128i colorMask = _mm_set1_epi32(0x00FFFFFF);
+		const __m128i alphaMask = _mm_set1_epi32(additive == 1 ? 0x3F000000 : additive == 2 ? 0 : 0xFF000000);
+		const int alphaShift = (additive == 1) ? 2 : 0;
+		for( ; end - it >= 4; it += 4)
+		{
+			__m128i value = _mm_loadu_si128(reinterpret_cast<__m128i *>(it));
+			__m128i low = _mm_unpacklo_epi8(value, zero);
+			__m128i high = _mm_unpackhi_epi8(value, zero);
+			__m128i lowAlpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(low, 0xFF), 0xFF);
+			__m128i highAlpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(high, 0xFF), 0xFF);
+			low = _mm_srli_epi16(_mm_mulhi_epu16(_mm_mullo_epi16(low, lowAlpha), divide), 7);
+			high = _mm_srli_epi16(_mm_mulhi_epu16(_mm_mullo_epi16(high, highAlpha), divide), 7);
+			
+			__m128i color = _mm_and_si128(_mm_packus_epi16(low, high), colorMask);
+			__m128i alpha = _mm_and_si128(_mm_srli_epi32(value, alphaShift), alphaMask);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(it), _mm_or_si128(color, alpha));
+		}
+#endif
+		for( ; it != end; ++it)
 		{
-			uint32_t *it = buffer->Begin(y);
+			uint64_t value = *it;
+			uint64_t alpha = (value & 0xFF000000) >> 24;
+			
+			uint64_t red = (((value & 0xFF0000) * alpha) / 255) & 0xFF0000;
+			uint64_t green = (((value & 0xFF00) * alpha) / 255) & 0xFF00;
+			uint64_t blue = (((value & 0xFF) * alpha) / 255) & 0xFF;
 			
-			for(uint32_t *end = it + buffer->Width(); it != end; ++it)
+			value = red | green | blue;
+			if(additive == 1)
+				alpha >>= 2;
+			if(additive != 2)
+				value |= (alpha << 24);
+			
+			*it = static_cast<uint32_t>(value);
+		}
+	}
+	
+	// Average each 2x2 block of pixels from the two given rows into one pixel,
+	// rounding to the nearest value.
+	void ShrinkRow(const unsigned char *aIt, const unsigned char *bIt, unsigned char *out, int outWidth)
+	{
+		int x = 0;
+#ifdef __SSE2__
+		// Two output pixels at a time, from four pixels in each row.
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i two = _mm_set1_epi16(2);
+		for( ; x + 2 <= outWidth; x += 2, aIt += 16, bIt += 16, out += 8)
+		{
+			__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(aIt));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bIt));
+			__m128i low = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+			__m128i high = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+			// Add each pair of neighboring pixels together.
+			low = _mm_add_epi16(low, _mm_srli_si128(low, 8));
+			high = _mm_add_epi16(high, _mm_srli_si128(high, 8));
+			__m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(low, high), two), 2);
+			_mm_storel_epi64(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(sum, sum));
+		}
+#endif
+		for( ; x < outWidth; ++x, aIt += 4, bIt += 4)
+		{
+			for(int channel = 0; channel < 4; ++channel, ++aIt, ++bIt, ++out)
+				*out = (static_cast<unsigned>(aIt[0]) + static_cast<unsigned>(bIt[0])
+					+ static_cast<unsigned>(aIt[4]) + static_cast<unsigned>(bIt[4]) + 2) / 4;
+		}
+	}
+	
+	
+	
+	// Get the path where the compressed copy of the given image is cached.
+	// The file name is a hash of the image path.
+	string CachePath(const string &path)
+	{
+		if(Files::Cache().empty())
+			return string();
+		
+		// 64-bit FNV-1a hash.
+		uint64_t hash = 14695981039346656037ULL;
+		for(char c : path)
+		{
+			hash ^= static_cast<unsigned char>(c);
+			hash *= 1099511628211ULL;
+		}
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.dxt", static_cast<unsigned long long>(hash));
+		return Files::Cache() + name;
+	}
+	
+	// Pack a color (with each channel from 0 to 255) into RGB 5:6:5 format,
+	// and unpack it again.
+	uint16_t Pack565(const float color[3])
+	{
+		int r = min(31, max(0, static_cast<int>(color[0] * (31.f / 255.f) + .5f)));
+		int g = min(63, max(0, static_cast<int>(color[1] * (63.f / 255.f) + .5f)));
+		int b = min(31, max(0, static_cast<int>(color[2] * (31.f / 255.f) + .5f)));
+		return (r << 11) | (g << 5) | b;
+	}
+	
+	void Unpack565(uint16_t packed, float color[3])
+	{
+		int r = (packed >> 11) & 31;
+		int g = (packed >> 5) & 63;
+		int b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+	
+	// Compress the 4x4 block of pixels with the given top left corner into the
+	// 16 bytes of a DXT5 block: eight bytes of alpha followed by eight of color.
+	void CompressBlock(const ImageBuffer &image, int x, int y, char *out)
+	{
+		// Unpack the block. The pixels are stored as BGRA.
+		float color[16][3];
+		int alpha[16];
+		for(int j = 0; j < 4; ++j)
+		{
+			const uint32_t *it = image.Begin(y + j) + x;
+			for(int i = 0; i < 4; ++i)
+			{
+				uint32_t value = it[i];
+				float *c = color[4 * j + i];
+				c[0] = (value >> 16) & 0xFF;
+				c[1] = (value >> 8) & 0xFF;
+				c[2] = value & 0xFF;
+				alpha[4 * j + i] = value >> 24;
+			}
+		}
+		
+		// The alpha endpoints are the minimum and maximum values, with six
+		// values interpolated between them.
+		int alphaMax = *max_element(alpha, alpha + 16);
+		int alphaMin = *min_element(alpha, alpha + 16);
+		uint64_t alphaBits = 0;
+		if(alphaMax > alphaMin)
+		{
+			int palette[8] = {alphaMax, alphaMin};
+			for(int k = 2; k < 8; ++k)
+				palette[k] = ((8 - k) * alphaMax + (k - 1) * alphaMin + 3) / 7;
+			for(int i = 0; i < 16; ++i)
+			{
+				uint64_t best = 0;
+				for(int k = 1; k < 8; ++k)
+					if(abs(palette[k] - alpha[i]) < abs(palette[best] - alpha[i]))
+						best = k;
+				alphaBits |= best << (3 * i);
+			}
+		}
+		out[0] = static_cast<char>(alphaMax);
+		out[1] = static_cast<char>(alphaMin);
+		for(int i = 0; i < 6; ++i)
+			out[2 + i] = static_cast<char>(alphaBits >> (8 * i));
+		
+		// The color endpoints are the pixels at either end of the line through
+		// the colors that best fits them. Find that line's direction by power
+		// iteration on the covariance of the colors.
+		float mean[3] = {0.f, 0.f, 0.f};
+		for(int i = 0; i < 16; ++i)
+			for(int c = 0; c < 3; ++c)
+				mean[c] += color[i][c] / 16.f;
+		float cov[3][3] = {};
+		for(int i = 0; i < 16; ++i)
+			for(int a = 0; a < 3; ++a)
+				for(int b = 0; b < 3; ++b)
+					cov[a][b] += (color[i][a] - mean[a]) * (color[i][b] - mean[b]);
+		float axis[3] = {1.f, 1.f, 1.f};
+		for(int iteration = 0; iteration < 4; ++iteration)
+		{
+			float next[3];
+			for(int a = 0; a < 3; ++a)
+				next[a] = cov[a][0] * axis[0] + cov[a][1] * axis[1] + cov[a][2] * axis[2];
+			float length = max(fabs(next[0]), max(fabs(next[1]), fabs(next[2])));
+			if(length < 1e-6f)
+				break;
+			for(int a = 0; a < 3; ++a)
+				axis[a] = next[a] / length;
+		}
+		int low = 0;
+		int high = 0;
+		float lowDot = 0.f;
+		float highDot = 0.f;
+		for(int i = 0; i < 16; ++i)
+		{
+			float dot = color[i][0] * axis[0] + color[i][1] * axis[1] + color[i][2] * axis[2];
+			if(!i || dot < lowDot)
+			{
+				low = i;
+				lowDot = dot;
+			}
+			if(!i || dot > highDot)
+			{
+				high = i;
+				highDot = dot;
+			}
+		}
+		
+		// In the four-color mode, the first endpoint must be the larger one.
+		uint16_t first = Pack565(color[high]);
+		uint16_t second = Pack565(color[low]);
+		if(first < second)
+			swap(first, second);
+		uint32_t colorBits = 0;
+		if(first != second)
+		{
+			float palette[4][3];
+			Unpack565(first, palette[0]);
+			Unpack565(second, palette[1]);
+			for(int c = 0; c < 3; ++c)
 			{
-				uint64_t value = *it;
-				uint64_t alpha = (value & 0xFF000000) >> 24;
-				
-				uint64_t red = (((value & 0xFF0000) * alpha) / 255) & 0xFF0000;
-				uint64_t green = (((value & 0xFF00) * alpha) / 255) & 0xFF00;
-				uint64_t blue = (((value & 0xFF) * alpha) / 255) & 0xFF;
-				
-				value = red | green | blue;
-				if(additive == 1)
-					alpha >>= 2;
-				if(additive != 2)
-					value |= (alpha << 24);
-				
-				*it = static_cast<uint32_t>(value);
+				palette[2][c] = (2.f * palette[0][c] + palette[1][c]) / 3.f;
+				palette[3][c] = (palette[0][c] + 2.f * palette[1][c]) / 3.f;
 			}
+			for(int i = 0; i < 16; ++i)
+			{
+				uint32_t best = 0;
+				float bestDistance = 0.f;
+				for(int k = 0; k < 4; ++k)
+				{
+					float distance = 0.f;
+					for(int c = 0; c < 3; ++c)
+						distance += (palette[k][c] - color[i][c]) * (palette[k][c] - color[i][c]);
+					if(!k || distance < bestDistance)
+					{
+						best = k;
+						bestDistance = distance;
+					}
+				}
+				colorBits |= best << (2 * i);
+			}
+		}
+		out[8] = static_cast<char>(first);
+		out[9] = static_cast<char>(first >> 8);
+		out[10] = static_cast<char>(second);
+		out[11] = static_cast<char>(second >> 8);
+		for(int i = 0; i < 4; ++i)
+			out[12 + i] = static_cast<char>(colorBits >> (8 * i));
+	}
+	
+	// Convert one DXT5 block back into the 4x4 pixels with the given top left
+	// corner. Only the four-color mode is handled, because that is the only
+	// one that CompressBlock() produces.
+	void DecompressBlock(const char *in, ImageBuffer &image, int x, int y)
+	{
+		const unsigned char *it = reinterpret_cast<const unsigned char *>(in);
+		int alphaMax = it[0];
+		int alphaMin = it[1];
+		int alpha[8] = {alphaMax, alphaMin};
+		for(int k = 2; k < 8; ++k)
+			alpha[k] = ((8 - k) * alphaMax + (k - 1) * alphaMin + 3) / 7;
+		uint64_t alphaBits = 0;
+		for(int i = 0; i < 6; ++i)
+			alphaBits |= static_cast<uint64_t>(it[2 + i]) << (8 * i);
+		
+		float palette[4][3];
+		Unpack565(it[8] | (it[9] << 8), palette[0]);
+		Unpack565(it[10] | (it[11] << 8), palette[1]);
+		for(int c = 0; c < 3; ++c)
+		{
+			palette[2][c] = (2.f * palette[0][c] + palette[1][c]) / 3.f;
+			palette[3][c] = (palette[0][c] + 2.f * palette[1][c]) / 3.f;
+		}
+		uint32_t colorBits = it[12] | (it[13] << 8) | (it[14] << 16) | (static_cast<uint32_t>(it[15]) << 24);
+		
+		for(int i = 0; i < 16; ++i)
+		{
+			const float *color = palette[(colorBits >> (2 * i)) & 3];
+			uint32_t value = static_cast<uint32_t>(alpha[(alphaBits >> (3 * i)) & 7]) << 24;
+			value |= static_cast<uint32_t>(color[0] + .5f) << 16;
+			value |= static_cast<uint32_t>(color[1] + .5f) << 8;
+			value |= static_cast<uint32_t>(color[2] + .5f);
+			image.Begin(y + i / 4)[x + i % 4] = value;
 		}
 	}
 }
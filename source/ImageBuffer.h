@@ -22,7 +22,9 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 // time in different threads). It also handles converting images to
 // premultiplied alpha or additive or half-additive color mixing mode depending
 // on the file name, so that content creators do not have to save the images in
-// some sort of special format.
+// some sort of special format. Images can also be compressed into the DXT5
+// format, which takes up a quarter as much video memory, and a compressed copy
+// can be cached on disk so the image need not be decoded again.
 class ImageBuffer {
 public:
 	ImageBuffer();
@@ -43,13 +45,30 @@ public:
 	
 	void ShrinkToHalfSize();
 	
+	// Convert this image to DXT5 blocks, discarding the pixels. This is only
+	// possible if both dimensions are a multiple of four; if they are not,
+	// this returns false and the image is not changed.
+	bool Compress();
+	// Convert the compressed blocks back to pixels.
+	void Decompress();
+	bool IsCompressed() const;
+	// Get the compressed blocks, stored one row of blocks at a time.
+	const std::string &Blocks() const;
+	
 	static ImageBuffer *Read(const std::string &path);
+	// Read just the dimensions of the given image, without decoding it.
+	static bool ReadSize(const std::string &path, int &width, int &height);
+	// Read the compressed copy of the given image from the cache, if there is
+	// one and the image has not changed since it was saved.
+	static ImageBuffer *ReadCompressed(const std::string &path);
+	void SaveCompressed(const std::string &path) const;
 	
 	
 private:
 	int width;
 	int height;
 	uint32_t *pixels;
+	std::string blocks;
 };
 
 
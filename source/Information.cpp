@@ -14,94 +14,230 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 #include "Sprite.h"
 
+#include <map>
+#include <mutex>
+
 using namespace std;
 
+namespace {
+	// All the names that have been given keys so far. Interfaces may be loaded
+	// in a different thread from the one that draws them, so guard this map.
+	map<string, int> &Keys()
+	{
+		static map<string, int> keys;
+		return keys;
+	}
+	
+	mutex &KeyMutex()
+	{
+		static mutex keyMutex;
+		return keyMutex;
+	}
+	
+	// Find the key for the given name without registering it. A name that has
+	// no key cannot have been given a value, so the default is used instead.
+	int FindKey(const string &name)
+	{
+		lock_guard<mutex> lock(KeyMutex());
+		auto it = Keys().find(name);
+		return (it == Keys().end()) ? -1 : it->second;
+	}
+	
+	// Make sure the given list has a slot for the given key.
+	template <class Type>
+	void Reserve(vector<Type> &list, int key, const Type &value)
+	{
+		if(static_cast<size_t>(key) >= list.size())
+			list.resize(key + 1, value);
+	}
+	
+	// Get the value for the given key, or the default if it has not been set.
+	template <class Type>
+	const Type &Get(const vector<Type> &list, int key, const Type &value)
+	{
+		return (key < 0 || static_cast<size_t>(key) >= list.size()) ? value : list[key];
+	}
+	
+	const Sprite EMPTY_SPRITE;
+	const Point UP(0., -1.);
+	const string EMPTY_STRING;
+}
 
 
-void Information::SetSprite(const string &name, const Sprite *sprite, const Point &unit, int frame)
+
+// Get the key for the given name, registering it if it is new. The same
+// name always maps to the same key, and keys are shared by sprites, strings,
+// bars, and conditions.
+int Information::Key(const string &name)
 {
-	sprites[name] = sprite;
-	spriteUnits[name] = unit;
+	lock_guard<mutex> lock(KeyMutex());
+	map<string, int> &keys = Keys();
+	return keys.emplace(name, static_cast<int>(keys.size())).first->second;
+}
+
+
+
+void Information::SetSprite(int key, const Sprite *sprite, const Point &unit, int frame)
+{
+	Reserve(sprites, key, static_cast<const Sprite *>(&EMPTY_SPRITE));
+	Reserve(spriteUnits, key, UP);
+	sprites[key] = sprite;
+	spriteUnits[key] = unit;
 	if(frame)
-		spriteFrames[name] = frame;
+	{
+		Reserve(spriteFrames, key, 0);
+		spriteFrames[key] = frame;
+	}
 }
 
 
 
-const Sprite *Information::GetSprite(const string &name) const
+const Sprite *Information::GetSprite(int key) const
+{
+	return Get(sprites, key, static_cast<const Sprite *>(&EMPTY_SPRITE));
+}
+
+
+
+const Point &Information::GetSpriteUnit(int key) const
 {
-	static const Sprite empty;
+	return Get(spriteUnits, key, UP);
+}
+
+
+
+int Information::GetSpriteFrame(int key) const
+{
+	return Get(spriteFrames, key, 0);
+}
+
+
+
+void Information::SetString(int key, const string &value)
+{
+	Reserve(strings, key, EMPTY_STRING);
+	strings[key] = value;
+}
+
+
+
+const string &Information::GetString(int key) const
+{
+	return Get(strings, key, EMPTY_STRING);
+}
+
+
+
+void Information::SetBar(int key, double value, double segments)
+{
+	Reserve(bars, key, 1.);
+	Reserve(barSegments, key, 1.);
+	bars[key] = value;
+	barSegments[key] = segments;
+}
+
+
+
+double Information::BarValue(int key) const
+{
+	return Get(bars, key, 1.);
+}
+
+
+
+double Information::BarSegments(int key) const
+{
+	return Get(barSegments, key, 1.);
+}
+
+
+
+void Information::SetCondition(int key)
+{
+	if(static_cast<size_t>(key) >= conditions.size())
+		conditions.resize(key + 1, false);
+	conditions[key] = true;
+}
+
+
+
+// A negative key is a condition that is always true.
+bool Information::HasCondition(int key) const
+{
+	if(key < 0)
+		return true;
 	
-	auto it = sprites.find(name);
-	return (it == sprites.end()) ? &empty : it->second;
+	return (static_cast<size_t>(key) < conditions.size() && conditions[key]);
+}
+
+
+
+void Information::SetSprite(const string &name, const Sprite *sprite, const Point &unit, int frame)
+{
+	SetSprite(Key(name), sprite, unit, frame);
+}
+
+
+
+const Sprite *Information::GetSprite(const string &name) const
+{
+	return GetSprite(FindKey(name));
 }
 
 
 
 const Point &Information::GetSpriteUnit(const string &name) const
 {
-	static const Point up(0., -1.);
-	
-	auto it = spriteUnits.find(name);
-	return (it == spriteUnits.end()) ? up : it->second;
+	return GetSpriteUnit(FindKey(name));
 }
 
 
 
 int Information::GetSpriteFrame(const string &name) const
 {
-	auto it = spriteFrames.find(name);
-	return (it == spriteFrames.end()) ? 0 : it->second;
+	return GetSpriteFrame(FindKey(name));
 }
 
 
 
 void Information::SetString(const string &name, const string &value)
 {
-	strings[name] = value;
+	SetString(Key(name), value);
 }
 
 
 
 const string &Information::GetString(const string &name) const
 {
-	static const string empty;
-	
-	auto it = strings.find(name);
-	return (it == strings.end()) ? empty : it->second;
+	return GetString(FindKey(name));
 }
 
 
 
 void Information::SetBar(const string &name, double value, double segments)
 {
-	bars[name] = value;
-	barSegments[name] = static_cast<double>(segments);
+	SetBar(Key(name), value, segments);
 }
 
 
 
 double Information::BarValue(const string &name) const
 {
-	auto it = bars.find(name);
-	
-	return (it == bars.end()) ? 1. : it->second;
+	return BarValue(FindKey(name));
 }
 
 
 
 double Information::BarSegments(const string &name) const
 {
-	auto it = barSegments.find(name);
-	
-	return (it == barSegments.end()) ? 1. : it->second;
+	return BarSegments(FindKey(name));
 }
 
 
-	
+
 void Information::SetCondition(const string &condition)
 {
-	conditions.insert(condition);
+	SetCondition(Key(condition));
 }
 
 
@@ -114,11 +250,12 @@ bool Information::HasCondition(const string &condition) const
 	if(condition.front() == '!')
 		return !HasCondition(condition.substr(1));
 	
-	return conditions.count(condition);
+	int key = FindKey(condition);
+	return (key >= 0 && HasCondition(key));
 }
 
 
-	
+
 void Information::SetOutlineColor(const Color &color)
 {
 	outlineColor = color;
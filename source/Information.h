@@ -16,22 +16,45 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Color.h"
 #include "Point.h"
 
-#include <map>
-#include <set>
 #include <string>
+#include <vector>
 
 class Sprite;
 
 
 
 // Class representing information to be displayed in a user interface, independent
-// of how that information is laid out or shown.
+// of how that information is laid out or shown. Each name is interned as an
+// integer key, so that the interface elements and the code that fills in the
+// information can look up their values by index instead of by string.
 class Information {
 public:
+	// Get the key for the given name, registering it if it is new. The same
+	// name always maps to the same key, and keys are shared by sprites, strings,
+	// bars, and conditions.
+	static int Key(const std::string &name);
+	
+	void SetSprite(int key, const Sprite *sprite, const Point &unit = Point(0., -1.), int frame = 0);
+	const Sprite *GetSprite(int key) const;
+	const Point &GetSpriteUnit(int key) const;
+	int GetSpriteFrame(int key) const;
+	
+	void SetString(int key, const std::string &value);
+	const std::string &GetString(int key) const;
+	
+	void SetBar(int key, double value, double segments = 0.);
+	double BarValue(int key) const;
+	double BarSegments(int key) const;
+	
+	void SetCondition(int key);
+	// A negative key is a condition that is always true.
+	bool HasCondition(int key) const;
+	
+	// These versions look up the key for the given name.
 	void SetSprite(const std::string &name, const Sprite *sprite, const Point &unit = Point(0., -1.), int frame = 0);
 	const Sprite *GetSprite(const std::string &name) const;
 	const Point &GetSpriteUnit(const std::string &name) const;
-	int GetSpriteFrame(const std::string &namme) const;
+	int GetSpriteFrame(const std::string &name) const;
 	
 	void SetString(const std::string &name, const std::string &value);
 	const std::string &GetString(const std::string &name) const;
@@ -48,14 +71,16 @@ public:
 	
 	
 private:
-	std::map<std::string, const Sprite *> sprites;
-	std::map<std::string, Point> spriteUnits;
-	std::map<std::string, int> spriteFrames;
-	std::map<std::string, std::string> strings;
-	std::map<std::string, double> bars;
-	std::map<std::string, double> barSegments;
+	// Each value is stored at the index of its key. Any key that has not been
+	// set yet (including any past the end of these lists) has a default value.
+	std::vector<const Sprite *> sprites;
+	std::vector<Point> spriteUnits;
+	std::vector<int> spriteFrames;
+	std::vector<std::string> strings;
+	std::vector<double> bars;
+	std::vector<double> barSegments;
 	
-	std::set<std::string> conditions;
+	std::vector<bool> conditions;
 	
 	Color outlineColor;
 };
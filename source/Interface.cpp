@@ -51,6 +51,15 @@ namespace {
 				node.PrintTrace("Unrecognized interface element alignment:");
 		}
 	}
+	
+	// Convert a condition string into an Information key. Each leading "!"
+	// inverts the result, and an empty condition is always true.
+	void ParseCondition(const string &condition, int *key, bool *isInverted)
+	{
+		size_t start = condition.find_first_not_of('!');
+		*isInverted = (min(start, condition.length()) % 2);
+		*key = (start == string::npos) ? -1 : Information::Key(condition.substr(start));
+	}
 }
 
 
@@ -260,13 +269,13 @@ void Interface::Element::Load(const DataNode &node, const Point &globalAlignment
 // button, it will add a clickable zone to the given panel.
 void Interface::Element::DrawAt(const Point &anchor, const Information &info, Panel *panel) const
 {
-	if(!info.HasCondition(visibleIf))
+	if(info.HasCondition(visibleIf) == visibleIsInverted)
 		return;
 	
 	// Get the bounding box of this element, relative to the anchor point.
 	Rectangle box = bounds + anchor;
 	// Check if this element is active.
-	int state = info.HasCondition(activeIf);
+	int state = (info.HasCondition(activeIf) != activeIsInverted);
 	// Check if the mouse is hovering over this element.
 	state += (state && box.Contains(UI::GetMouse()));
 	// Place buttons even if they are inactive, in case the UI wants to show a
@@ -288,8 +297,8 @@ void Interface::Element::DrawAt(const Point &anchor, const Information &info, Pa
 // An empty string means it is always visible or active.
 void Interface::Element::SetConditions(const string &visible, const string &active)
 {
-	visibleIf = visible;
-	activeIf = active;
+	ParseCondition(visible, &visibleIf, &visibleIsInverted);
+	ParseCondition(active, &activeIf, &activeIsInverted);
 }
 
 
@@ -349,7 +358,10 @@ Interface::ImageElement::ImageElement(const DataNode &node, const Point &globalA
 	if(node.Token(0) == "sprite")
 		sprite[Element::ACTIVE] = SpriteSet::Get(node.Token(1));
 	else
+	{
 		name = node.Token(1);
+		key = Information::Key(name);
+	}
 	
 	// This function will call ParseLine() for any line it does not recognize.
 	Load(node, globalAlignment);
@@ -416,8 +428,8 @@ void Interface::ImageElement::Draw(const Rectangle &rect, const Information &inf
 	if(isOutline)
 	{
 		Color color = (isColored ? info.GetOutlineColor() : Color(1., 1.));
-		Point unit = info.GetSpriteUnit(name);
-		int frame = info.GetSpriteFrame(name);
+		Point unit = info.GetSpriteUnit(key);
+		int frame = info.GetSpriteFrame(key);
 		OutlineShader::Draw(sprite, rect.Center(), rect.Dimensions(), color, unit, frame);
 	}
 	else
@@ -428,7 +440,7 @@ void Interface::ImageElement::Draw(const Rectangle &rect, const Information &inf
 
 const Sprite *Interface::ImageElement::GetSprite(const Information &info, int state) const
 {
-	return name.empty() ? sprite[state] : info.GetSprite(name);
+	return name.empty() ? sprite[state] : info.GetSprite(key);
 }
 
 
@@ -450,6 +462,8 @@ Interface::TextElement::TextElement(const DataNode &node, const Point &globalAli
 	}
 	else
 		str = node.Token(1);
+	if(isDynamic)
+		key = Information::Key(str);
 	
 	// This function will call ParseLine() for any line it does not recognize.
 	Load(node, globalAlignment);
@@ -534,7 +548,7 @@ void Interface::TextElement::Place(const Rectangle &bounds, Panel *panel) const
 
 string Interface::TextElement::GetString(const Information &info) const
 {
-	return (isDynamic ? info.GetString(str) : str);
+	return (isDynamic ? info.GetString(key) : str);
 }
 
 
@@ -549,6 +563,7 @@ Interface::BarElement::BarElement(const DataNode &node, const Point &globalAlign
 	
 	// Get the name of the element and find out what type it is (bar or ring).
 	name = node.Token(1);
+	key = Information::Key(name);
 	isRing = (node.Token(0) == "ring");
 	
 	// This function will call ParseLine() for any line it does not recognize.
@@ -581,8 +596,8 @@ bool Interface::BarElement::ParseLine(const DataNode &node)
 void Interface::BarElement::Draw(const Rectangle &rect, const Information &info, int state) const
 {
 	// Get the current settings for this bar or ring.
-	double value = info.BarValue(name);
-	double segments = info.BarSegments(name);
+	double value = info.BarValue(key);
+	double segments = info.BarSegments(key);
 	if(segments <= 1.)
 		segments = 0.;
 	
@@ -94,8 +94,13 @@ private:
 		Rectangle bounds;
 		Point alignment;
 		Point padding;
-		std::string visibleIf;
-		std::string activeIf;
+		// Information keys for the conditions that control when this element
+		// is visible and active, or -1 if it always is. If a condition starts
+		// with "!", the key is for the rest of it and the result is inverted.
+		int visibleIf = -1;
+		int activeIf = -1;
+		bool visibleIsInverted = false;
+		bool activeIsInverted = false;
 	};
 	
 	// This class handles "sprite", "image", and "outline" elements.
@@ -118,6 +123,7 @@ private:
 	private:
 		// If a name is given, look up the sprite with that name and draw it.
 		std::string name;
+		int key = -1;
 		// Otherwise, draw a sprite. Which sprite is drawn depends on the current
 		// state of this element: inactive, active, or hover.
 		const Sprite *sprite[3] = {nullptr, nullptr, nullptr};
@@ -150,6 +156,7 @@ private:
 	private:
 		// The string may either be a name of a dynamic string, or static text.
 		std::string str;
+		int key = -1;
 		// Color for inactive, active, and hover states.
 		const Color *color[3] = {nullptr, nullptr, nullptr};
 		int fontSize = 14;
@@ -171,6 +178,7 @@ private:
 		
 	private:
 		std::string name;
+		int key = -1;
 		const Color *color = nullptr;
 		float width = 2.f;
 		bool isRing = false;
@@ -124,6 +124,15 @@ void ItemInfoDisplay::ClearHover()
 
 
 
+// Mark this display as out of date, so the next call to Show() rebuilds
+// it even if it is still showing the same item.
+void ItemInfoDisplay::Invalidate()
+{
+	isCurrent = false;
+}
+
+
+
 void ItemInfoDisplay::UpdateDescription(const string &text)
 {
 	description.Wrap(text);
@@ -140,8 +149,8 @@ Point ItemInfoDisplay::Draw(Point point, const vector<string> &labels, const vec
 	point.Y() += 10.;
 	
 	// Get standard colors to draw with.
-	Color labelColor = *GameData::Colors().Get("medium");
-	Color valueColor = *GameData::Colors().Get("bright");
+	static const Color &labelColor = *GameData::Colors().Get("medium");
+	static const Color &valueColor = *GameData::Colors().Get("bright");
 	
 	Table table;
 	// Use 10-pixel margins on both sides.
@@ -46,6 +46,10 @@ public:
 	void Hover(const Point &point);
 	void ClearHover();
 	
+	// Mark this display as out of date, so the next call to Show() rebuilds
+	// it even if it is still showing the same item.
+	void Invalidate();
+	
 	
 protected:
 	void UpdateDescription(const std::string &text);
@@ -65,6 +69,9 @@ protected:
 	
 	int maximumHeight = 0;
 	
+	// Whether Show() may skip rebuilding this display if the item is the same.
+	bool isCurrent = false;
+	
 	// For tooltips:
 	Point hoverPoint;
 	mutable std::string hover;
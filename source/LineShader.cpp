@@ -16,21 +16,43 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Point.h"
 #include "Screen.h"
 #include "Shader.h"
+#include "StreamBuffer.h"
 
 #include <stdexcept>
+#include <vector>
 
 using namespace std;
 
 namespace {
 	Shader shader;
 	GLint scaleI;
-	GLint startI;
-	GLint lengthI;
-	GLint widthI;
+	
+	GLint vertI;
+	GLint texI;
 	GLint colorI;
 	
 	GLuint vao;
-	GLuint vbo;
+	
+	// Each line is drawn as two triangles. Each vertex holds its position in
+	// screen coordinates, its position along and across the line, the line's
+	// length, and the line's color.
+	const int FLOATS = 9;
+	const GLfloat CORNERS[12] = {
+		0.f, -1.f,
+		1.f, -1.f,
+		0.f,  1.f,
+		1.f, -1.f,
+		0.f,  1.f,
+		1.f,  1.f
+	};
+	vector<GLfloat> vertices;
+	
+	void Attrib(GLint index, int size, int offset, GLintptr start)
+	{
+		glEnableVertexAttribArray(index);
+		glVertexAttribPointer(index, size, GL_FLOAT, GL_FALSE, FLOATS * sizeof(GLfloat),
+			(const GLvoid*)(start + offset * sizeof(GLfloat)));
+	}
 }
 
 
@@ -39,90 +61,106 @@ void LineShader::Init()
 {
 	static const char *vertexCode =
 		"uniform vec2 scale;\n"
-		"uniform vec2 start;\n"
-		"uniform vec2 len;\n"
-		"uniform vec2 width;\n"
 		
 		"in vec2 vert;\n"
+		"in vec3 tex;\n"
+		"in vec4 color;\n"
 		"out vec2 tpos;\n"
-		"out float tscale;\n"
+		"flat out float tscale;\n"
+		"flat out vec4 lineColor;\n"
 		
 		"void main() {\n"
-		"  tpos = vert;\n"
-		"  tscale = length(len);\n"
-		"  gl_Position = vec4((start + vert.x * len + vert.y * width) * scale, 0, 1);\n"
+		"  tpos = tex.xy;\n"
+		"  tscale = tex.z;\n"
+		"  lineColor = color;\n"
+		"  gl_Position = vec4(vert * scale, 0, 1);\n"
 		"}\n";
 
 	static const char *fragmentCode =
-		"uniform vec4 color = vec4(1, 1, 1, 1);\n"
-		
 		"in vec2 tpos;\n"
-		"in float tscale;\n"
+		"flat in float tscale;\n"
+		"flat in vec4 lineColor;\n"
 		"out vec4 finalColor;\n"
 		
 		"void main() {\n"
 		"  float alpha = min(tscale - abs(tpos.x * (2 * tscale) - tscale), 1 - abs(tpos.y));\n"
-		"  finalColor = color * alpha;\n"
+		"  finalColor = lineColor * alpha;\n"
 		"}\n";
 	
 	shader = Shader(vertexCode, fragmentCode);
 	scaleI = shader.Uniform("scale");
-	startI = shader.Uniform("start");
-	lengthI = shader.Uniform("len");
-	widthI = shader.Uniform("width");
-	colorI = shader.Uniform("color");
 	
-	// Generate the vertex data for drawing sprites.
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	vertI = shader.Attrib("vert");
+	texI = shader.Attrib("tex");
+	colorI = shader.Attrib("color");
 	
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	
-	GLfloat vertexData[] = {
-		0.f, -1.f,
-		1.f, -1.f,
-		0.f,  1.f,
-		1.f,  1.f
-	};
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertexData), vertexData, GL_STATIC_DRAW);
-	
-	glEnableVertexAttribArray(shader.Attrib("vert"));
-	glVertexAttribPointer(shader.Attrib("vert"), 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), nullptr);
-	
-	// unbind the VBO and VAO
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	// The vertex data is streamed in each time lines are drawn, so the VAO
+	// only needs to remember which attributes are enabled.
+	glGenVertexArrays(1, &vao);
 }
 
 
 
 void LineShader::Draw(const Point &from, const Point &to, float width, const Color &color)
 {
-	if(!shader.Object())
-		throw runtime_error("LineShader: Draw() called before Init().");
+	Bind();
 	
-	glUseProgram(shader.Object());
-	glBindVertexArray(vao);
+	Add(from, to, width, color);
 	
-	GLfloat scale[2] = {2.f / Screen::Width(), -2.f / Screen::Height()};
-	glUniform2fv(scaleI, 1, scale);
-	
-	GLfloat start[2] = {static_cast<float>(from.X()), static_cast<float>(from.Y())};
-	glUniform2fv(startI, 1, start);
+	Unbind();
+}
+
+
+
+void LineShader::Bind()
+{
+	if(!shader.Object())
+		throw runtime_error("LineShader: Bind() called before Init().");
 	
+	vertices.clear();
+}
+
+
+
+void LineShader::Add(const Point &from, const Point &to, float width, const Color &color)
+{
 	Point v = to - from;
 	Point u = v.Unit() * width;
-	GLfloat length[2] = {static_cast<float>(v.X()), static_cast<float>(v.Y())};
-	glUniform2fv(lengthI, 1, length);
+	Point w(u.Y(), -u.X());
+	float length = v.Length();
 	
-	GLfloat w[2] = {static_cast<float>(u.Y()), static_cast<float>(-u.X())};
-	glUniform2fv(widthI, 1, w);
+	const float *c = color.Get();
+	for(int i = 0; i < 12; i += 2)
+	{
+		Point corner = from + CORNERS[i] * v + CORNERS[i + 1] * w;
+		vertices.push_back(corner.X());
+		vertices.push_back(corner.Y());
+		vertices.push_back(CORNERS[i]);
+		vertices.push_back(CORNERS[i + 1]);
+		vertices.push_back(length);
+		vertices.insert(vertices.end(), c, c + 4);
+	}
+}
+
+
+
+void LineShader::Unbind()
+{
+	if(vertices.empty())
+		return;
 	
-	glUniform4fv(colorI, 1, color.Get());
+	shader.Use();
+	Shader::BindVertexArray(vao);
 	
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	GLfloat scale[2] = {2.f / Screen::Width(), -2.f / Screen::Height()};
+	glUniform2fv(scaleI, 1, scale);
 	
-	glBindVertexArray(0);
-	glUseProgram(0);
+	GLintptr start = StreamBuffer::Upload(vertices.data(), vertices.size() * sizeof(GLfloat));
+	Attrib(vertI, 2, 0, start);
+	Attrib(texI, 3, 2, start);
+	Attrib(colorI, 4, 5, start);
+	glDrawArrays(GL_TRIANGLES, 0, vertices.size() / FLOATS);
+	
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	vertices.clear();
 }
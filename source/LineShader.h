@@ -25,6 +25,10 @@ public:
 	static void Init();
 	
 	static void Draw(const Point &from, const Point &to, float width, const Color &color);
+	
+	static void Bind();
+	static void Add(const Point &from, const Point &to, float width, const Color &color);
+	static void Unbind();
 };
 
 
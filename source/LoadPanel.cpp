@@ -16,6 +16,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Command.h"
 #include "ConversationPanel.h"
 #include "DataFile.h"
+#include "DataWriter.h"
 #include "Dialog.h"
 #include "Files.h"
 #include "FillShader.h"
@@ -30,6 +31,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "PlayerInfo.h"
 #include "Preferences.h"
 #include "Rectangle.h"
+#include "SaveJournal.h"
 #include "ShipyardPanel.h"
 #include "StarField.h"
 #include "UI.h"
@@ -354,12 +356,17 @@ bool LoadPanel::Scroll(double dx, double dy)
 
 void LoadPanel::UpdateLists()
 {
+	// Make sure any saves still being written are done before listing them.
+	DataWriter::FinishSaving();
 	files.clear();
 	
 	vector<string> fileList = Files::List(Files::Saves());
 	for(const string &path : fileList)
 	{
 		string fileName = Files::Name(path);
+		// Skip anything that is not a saved game, such as autosave journals.
+		if(fileName.length() < 4 || fileName.compare(fileName.length() - 4, 4, ".txt"))
+			continue;
 		// The file name is either "Pilot Name.txt" or "Pilot Name~Date.txt".
 		size_t pos = fileName.find('~');
 		if(pos == string::npos)
@@ -424,7 +431,7 @@ void LoadPanel::SnapshotCallback(const string &name)
 	{
 		// Extract the date from this pilot's most recent save.
 		extension = "~0000-00-00.txt";
-		DataFile file(from);
+		DataFile file = SaveJournal::Load(from);
 		for(const DataNode &node : file)
 			if(node.Token(0) == "date")
 			{
@@ -445,6 +452,7 @@ void LoadPanel::SnapshotCallback(const string &name)
 	// Copy the autosave to a new, named file.
 	string to = from.substr(0, from.size() - 4) + extension;
 	Files::Copy(from, to);
+	SaveJournal::Copy(from, to);
 	if(Files::Exists(to))
 	{
 		UpdateLists();
@@ -494,6 +502,7 @@ void LoadPanel::DeletePilot()
 	{
 		string path = Files::Saves() + fit.first;
 		Files::Delete(path);
+		SaveJournal::Delete(path);
 		failed |= Files::Exists(path);
 	}
 	if(failed)
@@ -513,6 +522,7 @@ void LoadPanel::DeleteSave()
 	string pilot = selectedPilot;
 	string path = Files::Saves() + selectedFile;
 	Files::Delete(path);
+	SaveJournal::Delete(path);
 	if(Files::Exists(path))
 		GetUI()->Push(new Dialog("Deleting snapshot file failed."));
 	
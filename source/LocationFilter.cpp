@@ -14,13 +14,15 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 #include "DataNode.h"
 #include "DataWriter.h"
-#include "DistanceMap.h"
 #include "GameData.h"
 #include "Government.h"
 #include "Planet.h"
+#include "RouteTable.h"
 #include "Ship.h"
 #include "System.h"
 
+#include <algorithm>
+#include <map>
 #include <mutex>
 
 using namespace std;
@@ -45,32 +47,82 @@ namespace {
 		return false;
 	}
 	
-	// Check if the given system is within the given distance of the center.
-	int Distance(const System *center, const System *system, int maximum)
+	// Indexes for finding the planets and systems that might match a filter.
+	// These are built the first time they are needed after any change.
+	mutex indexMutex;
+	bool isIndexed = false;
+	vector<const System *> allSystems;
+	vector<const Planet *> allPlanets;
+	map<const Planet *, size_t> planetOrder;
+	map<const Government *, vector<const System *>> systemsByGovernment;
+	map<const System *, vector<const Planet *>> planetsBySystem;
+	map<string, vector<const Planet *>> planetsByAttribute;
+	
+	// Build the indexes, if they need to be. The index lock must be held.
+	void UpdateIndex()
 	{
-		// This function should only ever be called from the main thread, but
-		// just to be sure, use mutex protection on the static locals.
-		static mutex distanceMutex;
-		lock_guard<mutex> lock(distanceMutex);
+		if(isIndexed)
+			return;
 		
-		static const System *previousCenter = center;
-		static DistanceMap distance(center, -1, maximum);
-		int previousMaximum = maximum;
-		
-		if(center != previousCenter || maximum > previousMaximum)
+		allSystems.clear();
+		allPlanets.clear();
+		planetOrder.clear();
+		systemsByGovernment.clear();
+		planetsBySystem.clear();
+		planetsByAttribute.clear();
+		for(const auto &it : GameData::Systems())
+		{
+			if(it.second.Name().empty())
+				continue;
+			allSystems.push_back(&it.second);
+			systemsByGovernment[it.second.GetGovernment()].push_back(&it.second);
+		}
+		// A planet that is not in any system can never match.
+		for(const auto &it : GameData::Planets())
 		{
-			previousCenter = center;
-			previousMaximum = maximum;
-			distance = DistanceMap(center, -1, maximum);
+			const Planet &planet = it.second;
+			if(planet.Name().empty() || !planet.GetSystem())
+				continue;
+			planetOrder[&planet] = allPlanets.size();
+			allPlanets.push_back(&planet);
+			planetsBySystem[planet.GetSystem()].push_back(&planet);
+			for(const string &attribute : planet.Attributes())
+				planetsByAttribute[attribute].push_back(&planet);
 		}
+		isIndexed = true;
+	}
+	
+	// Each of a filter's requirements gives a list that every match must be
+	// in. Keep whichever such list is shortest.
+	template <class Type>
+	void Narrow(vector<const Type *> &result, bool &found, vector<const Type *> &list)
+	{
+		if(!found || list.size() < result.size())
+			result.swap(list);
+		found = true;
+	}
+	
+	// Check if the given system is within the given distance of the center.
+	int Distance(const System *center, const System *system, int maximum)
+	{
 		// If the distance is greater than the maximum, this is not a match.
-		int d = distance.Days(system);
+		int d = RouteTable::Days(center, system);
 		return (d > maximum) ? -1 : d;
 	}
 }
 
 
 
+// Discard the indexes used to find which planets and systems might match a
+// filter. This must be done after any change to the planets or systems.
+void LocationFilter::Invalidate()
+{
+	lock_guard<mutex> lock(indexMutex);
+	isIndexed = false;
+}
+
+
+
 // There is no need to save a location filter, because any mission that is
 // in the saved game will already have "applied" the filter to choose a
 // particular planet or system.
@@ -247,6 +299,98 @@ bool LocationFilter::Matches(const System *system, const System *origin) const
 
 
 
+// Get the planets, systems, or governments that a match must be one of. If any of
+// these are empty, there is no such restriction.
+const set<const Planet *> &LocationFilter::Planets() const
+{
+	return planets;
+}
+
+
+
+const set<const System *> &LocationFilter::Systems() const
+{
+	return systems;
+}
+
+
+
+const set<const Government *> &LocationFilter::Governments() const
+{
+	return governments;
+}
+
+
+
+// Get the systems or planets that might match this filter, if the player is in
+// the given system, in the same order as in GameData. This is usually far fewer
+// than all of them, but each must still be checked with Matches(). Any that
+// have not been defined in the game data are left out.
+vector<const System *> LocationFilter::CandidateSystems(const System *origin) const
+{
+	lock_guard<mutex> lock(indexMutex);
+	UpdateIndex();
+	
+	vector<const System *> result;
+	if(!FindSystems(origin, result))
+		result = allSystems;
+	return result;
+}
+
+
+
+vector<const Planet *> LocationFilter::CandidatePlanets(const System *origin) const
+{
+	lock_guard<mutex> lock(indexMutex);
+	UpdateIndex();
+	
+	vector<const Planet *> result;
+	bool found = false;
+	vector<const Planet *> list;
+	if(!planets.empty())
+	{
+		for(const Planet *planet : planets)
+			if(planetOrder.count(planet))
+				list.push_back(planet);
+		Narrow(result, found, list);
+	}
+	// A match must have one of the attributes in each set.
+	for(const set<string> &attr : attributes)
+	{
+		list.clear();
+		for(const string &attribute : attr)
+		{
+			auto it = planetsByAttribute.find(attribute);
+			if(it != planetsByAttribute.end())
+				list.insert(list.end(), it->second.begin(), it->second.end());
+		}
+		Narrow(result, found, list);
+	}
+	vector<const System *> systemList;
+	if(FindSystems(origin, systemList))
+	{
+		list.clear();
+		for(const System *system : systemList)
+		{
+			auto it = planetsBySystem.find(system);
+			if(it != planetsBySystem.end())
+				list.insert(list.end(), it->second.begin(), it->second.end());
+		}
+		Narrow(result, found, list);
+	}
+	if(!found)
+		return allPlanets;
+	
+	// Put the planets in order, and remove any that were in the list twice
+	// (because they have more than one of a set of attributes).
+	sort(result.begin(), result.end(),
+		[](const Planet *a, const Planet *b) { return planetOrder[a] < planetOrder[b]; });
+	result.erase(unique(result.begin(), result.end()), result.end());
+	return result;
+}
+
+
+
 bool LocationFilter::Matches(const Ship &ship) const
 {
 	if(!systems.empty() && !systems.count(ship.GetSystem()))
@@ -263,3 +407,47 @@ bool LocationFilter::Matches(const Ship &ship) const
 	}
 	return true;
 }
+
+
+
+// If this filter only allows certain systems, find a list that includes all of
+// them. The index lock must be held.
+bool LocationFilter::FindSystems(const System *origin, vector<const System *> &result) const
+{
+	bool found = false;
+	vector<const System *> list;
+	if(!systems.empty())
+	{
+		for(const System *system : systems)
+			if(!system->Name().empty())
+				list.push_back(system);
+		Narrow(result, found, list);
+	}
+	if(!governments.empty())
+	{
+		list.clear();
+		for(const Government *government : governments)
+		{
+			auto it = systemsByGovernment.find(government);
+			if(it != systemsByGovernment.end())
+				list.insert(list.end(), it->second.begin(), it->second.end());
+		}
+		Narrow(result, found, list);
+	}
+	// The distance limits are answered by the route table's cached maps. A
+	// system that cannot be reached at all never matches.
+	if(center)
+	{
+		list = RouteTable::Within(center, centerMaxDistance);
+		Narrow(result, found, list);
+	}
+	if(origin && originMaxDistance >= 0)
+	{
+		list = RouteTable::Within(origin, originMaxDistance);
+		Narrow(result, found, list);
+	}
+	if(found)
+		sort(result.begin(), result.end(),
+			[](const System *a, const System *b) { return a->Index() < b->Index(); });
+	return found;
+}
@@ -16,6 +16,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include <list>
 #include <set>
 #include <string>
+#include <vector>
 
 class DataNode;
 class DataWriter;
@@ -31,6 +32,12 @@ class System;
 // a certain attribute or be owned by a certain government, or be a certain
 // distance away from the current system.
 class LocationFilter {
+public:
+	// Discard the indexes used to find which planets and systems might match a
+	// filter. This must be done after any change to the planets or systems.
+	static void Invalidate();
+	
+	
 public:
 	void Load(const DataNode &node);
 	// This only saves the children. Save the root node separately. It does
@@ -45,6 +52,25 @@ public:
 	bool Matches(const System *system, const System *origin = nullptr) const;
 	bool Matches(const Ship &ship) const;
 	
+	// Get the planets, systems, or governments that a match must be one of. If
+	// any of these are empty, there is no such restriction.
+	const std::set<const Planet *> &Planets() const;
+	const std::set<const System *> &Systems() const;
+	const std::set<const Government *> &Governments() const;
+	
+	// Get the systems or planets that might match this filter, if the player is
+	// in the given system, in the same order as in GameData. This is usually far
+	// fewer than all of them, but each must still be checked with Matches().
+	// Any that have not been defined in the game data are left out.
+	std::vector<const System *> CandidateSystems(const System *origin = nullptr) const;
+	std::vector<const Planet *> CandidatePlanets(const System *origin = nullptr) const;
+	
+	
+private:
+	// If this filter only allows certain systems, find a list that includes all
+	// of them. The index lock must be held.
+	bool FindSystems(const System *origin, std::vector<const System *> &result) const;
+	
 	
 private:
 	// The planet must satisfy these conditions:
@@ -30,6 +30,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "PlayerInfoPanel.h"
 #include "Preferences.h"
 #include "Random.h"
+#include "Replay.h"
 #include "Screen.h"
 #include "StellarObject.h"
 #include "System.h"
@@ -52,8 +53,33 @@ MainPanel::MainPanel(PlayerInfo &player)
 
 void MainPanel::Step()
 {
+	// If the engine is still working on the last step when a frame's first
+	// step begins, put that step off so the interface can go on drawing the
+	// last finished step instead of stalling. Any other steps in the same
+	// frame (when catching up or fast-forwarding) wait for the engine, since
+	// the time for them has already been counted and the frame will draw the
+	// last of them. Never put off two frames' steps in a row, so the game does
+	// not fall far behind.
+	bool canDefer = isFirstStep && !deferredStep;
+	isFirstStep = false;
+	if(canDefer && !engine.IsReady())
+	{
+		deferredStep = true;
+		return;
+	}
+	deferredStep = false;
 	engine.Wait();
 	
+	// While a replay is playing, the engine only gets the recorded input, and
+	// none of the panels that were shown during the recording are shown.
+	if(Replay::IsPlaying())
+	{
+		Replay::PlayStep(engine, player);
+		canClick = false;
+		canDrag = false;
+		return;
+	}
+	
 	bool isActive = GetUI()->IsTop(this);
 	
 	if(show.Has(Command::MAP))
@@ -75,6 +101,8 @@ void MainPanel::Step()
 	// will call this object's OnCallback() function;
 	if(isActive && player.GetPlanet() && !player.GetPlanet()->IsWormhole())
 	{
+		// A recorded flight ends with landing.
+		Replay::End();
 		GetUI()->Push(new PlanetPanel(player, bind(&MainPanel::OnCallback, this)));
 		player.Land(GetUI());
 		isActive = false;
@@ -131,10 +159,13 @@ void MainPanel::Step()
 	}
 	
 	if(isActive)
-		engine.Go();
+		engine.Go(GetUI()->IsStepShown());
 	else
 		canDrag = false;
 	canClick = isActive;
+	// While the player is landed, the game is not moving, so the view of space
+	// under the planet panel never changes.
+	SetIsStatic(!isActive && player.GetPlanet());
 }
 
 
@@ -144,7 +175,8 @@ void MainPanel::Draw()
 	FrameTimer loadTimer;
 	glClear(GL_COLOR_BUFFER_BIT);
 	
-	engine.Draw();
+	engine.Draw(GetUI()->Interpolation());
+	isFirstStep = true;
 	
 	if(isDragging)
 	{
@@ -155,10 +187,10 @@ void MainPanel::Draw()
 		LineShader::Draw(Point(dragPoint.X(), dragSource.Y()), dragSource, .8, color);
 	}
 	
-	if(Preferences::Has("Show CPU / GPU load"))
+	if(Preferences::Has(Preferences::SHOW_CPU_GPU_LOAD))
 	{
 		string loadString = to_string(static_cast<int>(load * 100. + .5)) + "% GPU";
-		Color color = *GameData::Colors().Get("medium");
+		static const Color &color = *GameData::Colors().Get("medium");
 		FontSet::Get(14).Draw(loadString, Point(10., Screen::Height() * -.5 + 5.), color);
 	
 		loadSum += loadTimer.Time();
@@ -204,6 +236,14 @@ bool MainPanel::KeyDown(SDL_Keycode key, Uint16 mod, const Command &command)
 		Preferences::ZoomViewIn();
 	else if(key >= '0' && key <= '9')
 		engine.SelectGroup(key - '0', mod & KMOD_SHIFT, mod & (KMOD_CTRL | KMOD_GUI));
+	else if(key == SDLK_F5 && GameData::DebugMode())
+	{
+		// Reload any game data that has been edited since the game started.
+		// The engine must not be in the middle of a step while that happens.
+		engine.Wait();
+		int count = GameData::Reload();
+		Messages::Add("Reloaded " + to_string(count) + (count == 1 ? " data file." : " data files."));
+	}
 	else
 		return false;
 	
@@ -69,6 +69,10 @@ private:
 	bool isDragging = false;
 	bool hasShift = false;
 	bool canClick = false;
+	// Whether the next step is the first one since the last frame was drawn,
+	// and whether the last step was put off because the engine was busy.
+	bool isFirstStep = false;
+	bool deferredStep = false;
 	bool canDrag = false;
 };
 
@@ -480,11 +480,11 @@ void MapDetailPanel::DrawInfo()
 	
 	uiPoint.X() -= 90.;
 	uiPoint.Y() -= 97.;
-	for(const Trade::Commodity &commodity : GameData::Commodities())
+	for(unsigned i = 0; i < GameData::Commodities().size(); ++i)
 	{
-		bool isSelected = false;
-		if(static_cast<unsigned>(this->commodity) < GameData::Commodities().size())
-			isSelected = (&commodity == &GameData::Commodities()[this->commodity]);
+		const Trade::Commodity &commodity = GameData::Commodities()[i];
+		const vector<int> &prices = GameData::SystemPrices(i);
+		bool isSelected = (static_cast<unsigned>(this->commodity) == i);
 		Color &color = isSelected ? closeColor : farColor;
 		
 		font.Draw(commodity.name, uiPoint, color);
@@ -494,8 +494,8 @@ void MapDetailPanel::DrawInfo()
 		bool hasVisited = player.HasVisited(selectedSystem);
 		if(hasVisited && selectedSystem->IsInhabited(player.Flagship()))
 		{
-			int value = selectedSystem->Trade(commodity.name);
-			int localValue = (player.GetSystem() ? player.GetSystem()->Trade(commodity.name) : 0);
+			int value = prices[selectedSystem->Index()];
+			int localValue = (player.GetSystem() ? prices[player.GetSystem()->Index()] : 0);
 			// Don't "compare" prices if the current system is uninhabited and
 			// thus has no prices to compare to.
 			bool noCompare = (!player.GetSystem() || !player.GetSystem()->IsInhabited(player.Flagship()));
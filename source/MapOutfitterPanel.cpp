@@ -102,6 +102,8 @@ void MapOutfitterPanel::Select(int index)
 		selected = list[index];
 		selectedInfo.Update(*selected, player);
 	}
+	// The systems that sell the selected item are drawn in a different color.
+	InvalidateCache();
 }
 
 
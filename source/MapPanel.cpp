@@ -34,11 +34,13 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Politics.h"
 #include "Preferences.h"
 #include "RingShader.h"
+#include "RouteTable.h"
 #include "Screen.h"
 #include "Ship.h"
 #include "SpriteShader.h"
 #include "StellarObject.h"
 #include "System.h"
+#include "SystemGrid.h"
 #include "Trade.h"
 #include "UI.h"
 
@@ -49,13 +51,25 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 using namespace std;
 
+namespace {
+	// Find the given text in the given name, ignoring case, but only if the
+	// match begins before the given index. Otherwise, return -1.
+	int SearchBefore(const string &str, const string &sub, int limit)
+	{
+		auto end = str.begin() + min(str.size(), limit - 1 + sub.size());
+		auto it = search(str.begin(), end, sub.begin(), sub.end(),
+			[](char a, char b) { return toupper(a) == toupper(b); });
+		return (it == end ? -1 : it - str.begin());
+	}
+}
+
 const double MapPanel::OUTER = 6.;
 const double MapPanel::INNER = 3.5;
 
 
 
 MapPanel::MapPanel(PlayerInfo &player, int commodity, const System *special)
-	: player(player), distance(player),
+	: player(player), distance(RouteTable::Known(player)),
 	playerSystem(player.GetSystem()),
 	selectedSystem(special ? special : player.GetSystem()),
 	specialSystem(special),
@@ -80,9 +94,10 @@ void MapPanel::Draw()
 	for(const auto &it : GameData::Galaxies())
 		SpriteShader::Draw(it.second.GetSprite(), Zoom() * (center + it.second.Position()), Zoom());
 	
-	if(Preferences::Has("Hide unexplored map regions"))
+	if(Preferences::Has(Preferences::HIDE_UNEXPLORED_MAP_REGIONS))
 		FogShader::Draw(center, Zoom(), player);
 	
+	UpdateCache();
 	DrawTravelPlan();
 	
 	// Draw the "visible range" circle around your current location.
@@ -127,7 +142,7 @@ void MapPanel::DrawButtons(const string &condition)
 		info.SetCondition("max zoom");
 	if(player.MapZoom() == -2)
 		info.SetCondition("min zoom");
-	const Interface *interface = GameData::Interfaces().Get("map buttons");
+	static const Interface *interface = GameData::Interfaces().Get("map buttons");
 	interface->Draw(info, this);
 }
 
@@ -288,11 +303,11 @@ bool MapPanel::Click(int x, int y, int clicks)
 {
 	// Figure out if a system was clicked on.
 	Point click = Point(x, y) / Zoom() - center;
-	for(const auto &it : GameData::Systems())
-		if(click.Distance(it.second.Position()) < 10.
-				&& (player.HasSeen(&it.second) || &it.second == specialSystem))
+	SystemGrid::Circle(click, 10., visible);
+	for(const System *system : visible)
+		if(player.HasSeen(system) || system == specialSystem)
 		{
-			Select(&it.second);
+			Select(system);
 			break;
 		}
 	
@@ -432,7 +447,7 @@ void MapPanel::Select(const System *system)
 	}
 	else if(shift)
 	{
-		DistanceMap localDistance(player, plan.front());
+		DistanceMap localDistance = RouteTable::Known(player, plan.front());
 		if(localDistance.Days(system) <= 0)
 			return;
 		
@@ -463,39 +478,44 @@ void MapPanel::Select(const System *system)
 
 void MapPanel::Find(const string &name)
 {
+	// Once a match has been found, a later one only needs to be checked for
+	// near the start of each name, because it must begin earlier to be better.
 	int bestIndex = 9999;
+	const System *bestSystem = nullptr;
+	const Planet *bestPlanet = nullptr;
 	for(const auto &it : GameData::Systems())
 		if(player.HasVisited(&it.second))
 		{
-			int index = Search(it.first, name);
-			if(index >= 0 && index < bestIndex)
+			int index = SearchBefore(it.first, name, bestIndex);
+			if(index >= 0)
 			{
 				bestIndex = index;
-				selectedSystem = &it.second;
-				center = Zoom() * (Point() - selectedSystem->Position());
+				bestSystem = &it.second;
 				if(!index)
-				{
-					selectedPlanet = nullptr;
-					return;
-				}
+					break;
 			}
 		}
-	for(const auto &it : GameData::Planets())
-		if(player.HasVisited(it.second.GetSystem()))
-		{
-			int index = Search(it.first, name);
-			if(index >= 0 && index < bestIndex)
+	if(bestIndex)
+		for(const auto &it : GameData::Planets())
+			if(player.HasVisited(it.second.GetSystem()))
 			{
-				bestIndex = index;
-				selectedSystem = it.second.GetSystem();
-				center = Zoom() * (Point() - selectedSystem->Position());
-				if(!index)
+				int index = SearchBefore(it.first, name, bestIndex);
+				if(index >= 0)
 				{
-					selectedPlanet = &it.second;
-					return;
+					bestIndex = index;
+					bestSystem = it.second.GetSystem();
+					bestPlanet = &it.second;
+					if(!index)
+						break;
 				}
 			}
-		}
+	if(!bestSystem)
+		return;
+	
+	selectedSystem = bestSystem;
+	center = Zoom() * (Point() - selectedSystem->Position());
+	if(!bestIndex)
+		selectedPlanet = bestPlanet;
 }
 
 
@@ -536,6 +556,185 @@ int MapPanel::Search(const string &str, const string &sub)
 
 
 
+// Mark the cached system colors as out of date. Derived classes must call
+// this if something that SystemValue() depends on changes.
+void MapPanel::InvalidateCache()
+{
+	cacheIsValid = false;
+}
+
+
+
+// Work out which systems, links, wormholes and names should be drawn, and what
+// color each system should be, if that has not been done since the coloring
+// mode last changed.
+void MapPanel::UpdateCache()
+{
+	if(cacheIsValid && cachedCommodity == commodity)
+		return;
+	cacheIsValid = true;
+	cachedCommodity = commodity;
+	
+	nodes.assign(GameData::Systems().size(), Node());
+	links.clear();
+	wormholes.clear();
+	governments.clear();
+	map<const System *, const System *> drawn;
+	for(const auto &it : GameData::Systems())
+	{
+		const System &system = it.second;
+		
+		for(const StellarObject &object : system.Objects())
+			if(object.GetPlanet() && object.GetPlanet()->IsWormhole() && player.HasVisited(object.GetPlanet()))
+			{
+				const System *next = object.GetPlanet()->WormholeDestination(&system);
+				// Only draw a wormhole if both systems have been visited.
+				if(!player.HasVisited(&system) || !player.HasVisited(next))
+					continue;
+				
+				// Don't double-draw the links.
+				drawn[&system] = next;
+				Point unit = (system.Position() - next->Position()).Unit();
+				wormholes.push_back({system.Position(), next->Position(), unit, drawn[next] != &system});
+			}
+		
+		if(player.HasSeen(&system))
+			for(const System *link : system.Links())
+				if(link < &system || !player.HasSeen(link))
+				{
+					// Only draw links between two systems if one of the two is
+					// visited. Also, avoid drawing twice by only drawing in the
+					// direction of increasing pointer values.
+					if(!player.HasVisited(&system) && !player.HasVisited(link))
+						continue;
+					
+					Point unit = (system.Position() - link->Position()).Unit();
+					bool isClose = (&system == playerSystem || link == playerSystem);
+					links.push_back({system.Position(), link->Position(), unit, isClose});
+				}
+		
+		// Referring to a non-existent system in a mission can create a spurious
+		// system record. Ignore those, and any system that is not in the grid.
+		if(system.Name().empty() || system.Index() < 0)
+			continue;
+		Node &node = nodes[system.Index()];
+		node.isDrawn = (player.HasSeen(&system) || &system == specialSystem);
+		node.isNamed = player.KnowsName(&system);
+		if(node.isDrawn)
+		{
+			node.color = SystemColor(system);
+			if(commodity == SHOW_GOVERNMENT && player.HasVisited(&system) && system.IsInhabited(player.Flagship()))
+				governments.emplace_back(system.Position(), system.GetGovernment());
+		}
+	}
+}
+
+
+
+// Find the systems that are on screen or within the given number of pixels
+// of it, plus the given number of extra pixels to the left.
+void MapPanel::FindVisible(double margin, double leftMargin)
+{
+	Point corner(margin, margin);
+	Point topLeft = (Screen::TopLeft() - corner - Point(leftMargin, 0.)) / Zoom() - center;
+	Point bottomRight = (Screen::BottomRight() + corner) / Zoom() - center;
+	SystemGrid::Box(topLeft, bottomRight, visible);
+}
+
+
+
+// Check if any part of the line between the given map positions may be on
+// screen.
+bool MapPanel::IsVisible(const Point &start, const Point &end) const
+{
+	// Allow for the arrow heads drawn at the end of wormholes.
+	static const double MARGIN = 50.;
+	Point topLeft = (Screen::TopLeft() - Point(MARGIN, MARGIN)) / Zoom() - center;
+	Point bottomRight = (Screen::BottomRight() + Point(MARGIN, MARGIN)) / Zoom() - center;
+	return max(start.X(), end.X()) >= topLeft.X() && min(start.X(), end.X()) <= bottomRight.X()
+		&& max(start.Y(), end.Y()) >= topLeft.Y() && min(start.Y(), end.Y()) <= bottomRight.Y();
+}
+
+
+
+// Get the color a system should be drawn in, based on the selected criterion,
+// which may be government, services, or commodity prices.
+Color MapPanel::SystemColor(const System &system) const
+{
+	if(!player.HasVisited(&system))
+		return UnexploredColor();
+	if(!system.IsInhabited(player.Flagship()) && commodity != SHOW_SPECIAL)
+		return UninhabitedColor();
+	
+	if(commodity >= SHOW_SPECIAL)
+	{
+		double value = 0.;
+		if(commodity >= 0)
+		{
+			const Trade::Commodity &com = GameData::Commodities()[commodity];
+			double price = GameData::SystemPrices(commodity)[system.Index()];
+			if(!price)
+				value = numeric_limits<double>::quiet_NaN();
+			else
+				value = (2. * (price - com.low)) / (com.high - com.low) - 1.;
+		}
+		else if(commodity == SHOW_SHIPYARD)
+		{
+			double size = GameData::ShipyardSizes()[system.Index()];
+			value = size ? min(10., size) / 10. : -1.;
+		}
+		else if(commodity == SHOW_OUTFITTER)
+		{
+			double size = GameData::OutfitterSizes()[system.Index()];
+			value = size ? min(60., size) / 60. : -1.;
+		}
+		else if(commodity == SHOW_VISITED)
+		{
+			bool all = true;
+			bool some = false;
+			for(const StellarObject &object : system.Objects())
+				if(object.GetPlanet() && !object.GetPlanet()->IsWormhole())
+				{
+					bool visited = player.HasVisited(object.GetPlanet());
+					all &= visited;
+					some |= visited;
+				}
+			value = -1 + some + all;
+		}
+		else
+			value = SystemValue(&system);
+		
+		return MapColor(value);
+	}
+	if(commodity == SHOW_GOVERNMENT)
+		return GovernmentColor(system.GetGovernment());
+	
+	double reputation = system.GetGovernment()->Reputation();
+	
+	// A system should show up as dominated if it contains at least one
+	// inhabited planet and all inhabited planets have been dominated. It should
+	// show up as restricted if you cannot land on any of the planets that have
+	// spaceports.
+	bool hasDominated = true;
+	bool isInhabited = false;
+	bool canLand = false;
+	for(const StellarObject &object : system.Objects())
+		if(object.GetPlanet())
+		{
+			const Planet *planet = object.GetPlanet();
+			if(!planet->IsAccessible(player.Flagship()))
+				continue;
+			canLand |= planet->CanLand() && planet->HasSpaceport();
+			isInhabited |= planet->IsInhabited();
+			hasDominated &= (!planet->IsInhabited()
+				|| GameData::GetPolitics().HasDominated(planet));
+		}
+	hasDominated &= isInhabited;
+	return ReputationColor(reputation, canLand, canLand && hasDominated);
+}
+
+
+
 void MapPanel::DrawTravelPlan()
 {
 	if(!playerSystem)
@@ -626,39 +825,26 @@ void MapPanel::DrawWormholes()
 	const double wormholeLength = 4.;
 	const double wormholeArrowHeadRatio = .3;
 	
-	map<const System *, const System *> drawn;
-	for(const auto &it : GameData::Systems())
+	Angle left(45.);
+	Angle right(-45.);
+	for(const Wormhole &wormhole : wormholes)
 	{
-		const System *previous = &it.second;
-		for(const StellarObject &object : previous->Objects())
-			if(object.GetPlanet() && object.GetPlanet()->IsWormhole() && player.HasVisited(object.GetPlanet()))
-			{
-				const System *next = object.GetPlanet()->WormholeDestination(previous);
-				// Only draw a wormhole if both systems have been visited.
-				if(!player.HasVisited(previous) || !player.HasVisited(next))
-					continue;
-				
-				drawn[previous] = next;
-				Point from = Zoom() * (previous->Position() + center);
-				Point to = Zoom() * (next->Position() + center);
-				Point unit = (from - to).Unit() * 7.;
-				from -= unit;
-				to += unit;
-				
-				Angle left(45.);
-				Angle right(-45.);
-				
-				Point wormholeUnit = Zoom() * wormholeLength * unit;
-				Point arrowLeft = left.Rotate(wormholeUnit * wormholeArrowHeadRatio);
-				Point arrowRight = right.Rotate(wormholeUnit * wormholeArrowHeadRatio);
-				
-				// Don't double-draw the links.
-				if(drawn[next] != previous)
-					LineShader::Draw(from, to, wormholeWidth, wormholeDimColor);
-				LineShader::Draw(from - wormholeUnit + arrowLeft, from - wormholeUnit, wormholeWidth, wormholeColor);
-				LineShader::Draw(from - wormholeUnit + arrowRight, from - wormholeUnit, wormholeWidth, wormholeColor);
-				LineShader::Draw(from, from - (wormholeUnit + Zoom() * 0.1 * unit), wormholeWidth, wormholeColor);
-			}
+		if(!IsVisible(wormhole.start, wormhole.end))
+			continue;
+		
+		Point unit = 7. * wormhole.unit;
+		Point from = Zoom() * (wormhole.start + center) - unit;
+		Point to = Zoom() * (wormhole.end + center) + unit;
+		
+		Point wormholeUnit = Zoom() * wormholeLength * unit;
+		Point arrowLeft = left.Rotate(wormholeUnit * wormholeArrowHeadRatio);
+		Point arrowRight = right.Rotate(wormholeUnit * wormholeArrowHeadRatio);
+		
+		if(wormhole.drawLine)
+			LineShader::Draw(from, to, wormholeWidth, wormholeDimColor);
+		LineShader::Draw(from - wormholeUnit + arrowLeft, from - wormholeUnit, wormholeWidth, wormholeColor);
+		LineShader::Draw(from - wormholeUnit + arrowRight, from - wormholeUnit, wormholeWidth, wormholeColor);
+		LineShader::Draw(from, from - (wormholeUnit + Zoom() * 0.1 * unit), wormholeWidth, wormholeColor);
 	}
 }
 
@@ -669,149 +855,52 @@ void MapPanel::DrawLinks()
 	// Draw the links between the systems.
 	Color closeColor(.6, .6);
 	Color farColor(.3, .3);
-	for(const auto &it : GameData::Systems())
+	LineShader::Bind();
+	for(const Link &link : links)
 	{
-		const System *system = &it.second;
-		if(!player.HasSeen(system))
+		if(!IsVisible(link.start, link.end))
 			continue;
 		
-		for(const System *link : system->Links())
-			if(link < system || !player.HasSeen(link))
-			{
-				// Only draw links between two systems if one of the two is
-				// visited. Also, avoid drawing twice by only drawing in the
-				// direction of increasing pointer values.
-				if(!player.HasVisited(system) && !player.HasVisited(link))
-					continue;
-				
-				Point from = Zoom() * (system->Position() + center);
-				Point to = Zoom() * (link->Position() + center);
-				Point unit = (from - to).Unit() * 7.;
-				from -= unit;
-				to += unit;
-				
-				bool isClose = (system == playerSystem || link == playerSystem);
-				LineShader::Draw(from, to, 1.2, isClose ? closeColor : farColor);
-			}
+		Point unit = 7. * link.unit;
+		Point from = Zoom() * (link.start + center) - unit;
+		Point to = Zoom() * (link.end + center) + unit;
+		LineShader::Add(from, to, 1.2, link.isClose ? closeColor : farColor);
 	}
+	LineShader::Unbind();
 }
 
 
 
 void MapPanel::DrawSystems()
 {
+	// For every government that is drawn, keep track of how close it is to the
+	// center of the view. The four closest governments will be displayed in the
+	// key. This includes systems that are off screen.
 	if(commodity == SHOW_GOVERNMENT)
+	{
 		closeGovernments.clear();
+		for(const auto &it : governments)
+		{
+			double distance = Zoom() * (it.first + center).Length();
+			auto git = closeGovernments.find(it.second);
+			if(git == closeGovernments.end())
+				closeGovernments[it.second] = distance;
+			else
+				git->second = min(git->second, distance);
+		}
+	}
 	
 	// Draw the circles for the systems, colored based on the selected criterion,
 	// which may be government, services, or commodity prices.
-	for(const auto &it : GameData::Systems())
+	FindVisible(OUTER);
+	RingShader::Bind();
+	for(const System *system : visible)
 	{
-		const System &system = it.second;
-		// Referring to a non-existent system in a mission can create a spurious
-		// system record. Ignore those.
-		if(system.Name().empty())
-			continue;
-		if(!player.HasSeen(&system) && &system != specialSystem)
-			continue;
-		
-		Point pos = Zoom() * (system.Position() + center);
-		
-		Color color = UninhabitedColor();
-		if(!player.HasVisited(&system))
-			color = UnexploredColor();
-		else if(system.IsInhabited(player.Flagship()) || commodity == SHOW_SPECIAL)
-		{
-			if(commodity >= SHOW_SPECIAL)
-			{
-				double value = 0.;
-				if(commodity >= 0)
-				{
-					const Trade::Commodity &com = GameData::Commodities()[commodity];
-					double price = system.Trade(com.name);
-					if(!price)
-						value = numeric_limits<double>::quiet_NaN();
-					else
-						value = (2. * (price - com.low)) / (com.high - com.low) - 1.;
-				}
-				else if(commodity == SHOW_SHIPYARD)
-				{
-					double size = 0;
-					for(const StellarObject &object : system.Objects())
-						if(object.GetPlanet())
-							size += object.GetPlanet()->Shipyard().size();
-					value = size ? min(10., size) / 10. : -1.;
-				}
-				else if(commodity == SHOW_OUTFITTER)
-				{
-					double size = 0;
-					for(const StellarObject &object : system.Objects())
-						if(object.GetPlanet())
-							size += object.GetPlanet()->Outfitter().size();
-					value = size ? min(60., size) / 60. : -1.;
-				}
-				else if(commodity == SHOW_VISITED)
-				{
-					bool all = true;
-					bool some = false;
-					for(const StellarObject &object : system.Objects())
-						if(object.GetPlanet() && !object.GetPlanet()->IsWormhole())
-						{
-							bool visited = player.HasVisited(object.GetPlanet());
-							all &= visited;
-							some |= visited;
-						}
-					value = -1 + some + all;
-				}
-				else
-					value = SystemValue(&system);
-				
-				color = MapColor(value);
-			}
-			else if(commodity == SHOW_GOVERNMENT)
-			{
-				const Government *gov = system.GetGovernment();
-				color = GovernmentColor(gov);
-				
-				// For every government that is draw, keep track of how close it
-				// is to the center of the view. The four closest governments
-				// will be displayed in the key.
-				double distance = pos.Length();
-				auto it = closeGovernments.find(gov);
-				if(it == closeGovernments.end())
-					closeGovernments[gov] = distance;
-				else
-					it->second = min(it->second, distance);
-			}
-			else
-			{
-				double reputation = system.GetGovernment()->Reputation();
-				
-				// A system should show up as dominated if it contains at least
-				// one inhabited planet and all inhabited planets have been
-				// dominated. It should show up as restricted if you cannot land
-				// on any of the planets that have spaceports.
-				bool hasDominated = true;
-				bool isInhabited = false;
-				bool canLand = false;
-				for(const StellarObject &object : system.Objects())
-					if(object.GetPlanet())
-					{
-						const Planet *planet = object.GetPlanet();
-						if(!planet->IsAccessible(player.Flagship()))
-							continue;
-						canLand |= planet->CanLand() && planet->HasSpaceport();
-						isInhabited |= planet->IsInhabited();
-						hasDominated &= (!planet->IsInhabited()
-							|| GameData::GetPolitics().HasDominated(planet));
-					}
-				hasDominated &= isInhabited;
-				color = ReputationColor(reputation, canLand, canLand && hasDominated);
-			}
-		}
-		
-		RingShader::Draw(pos, OUTER, INNER, color);
+		const Node &node = nodes[system->Index()];
+		if(node.isDrawn)
+			RingShader::Add(Zoom() * (system->Position() + center), OUTER, INNER, node.color);
 	}
+	RingShader::Unbind();
 }
 
 
@@ -827,15 +916,12 @@ void MapPanel::DrawNames()
 	Color closeColor(.6, .6);
 	Color farColor(.3, .3);
 	Point offset((Zoom() > 2.0) ? 8. : 6., -.5 * font.Height());
-	for(const auto &it : GameData::Systems())
-	{
-		const System &system = it.second;
-		if(!player.KnowsName(&system) || system.Name().empty())
-			continue;
-		
-		font.Draw(system.Name(), Zoom() * (system.Position() + center) + offset,
-			(&system == playerSystem) ? closeColor : farColor);
-	}
+	// A name may be on screen even if its system is just off the left edge.
+	FindVisible(OUTER, 200.);
+	for(const System *system : visible)
+		if(nodes[system->Index()].isNamed)
+				font.Draw(system->Name(), Zoom() * (system->Position() + center) + offset,
+				(system == playerSystem) ? closeColor : farColor);
 }
 
 
@@ -21,6 +21,8 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 class Angle;
 class Government;
@@ -87,6 +89,10 @@ protected:
 	// Function for the "find" dialogs:
 	static int Search(const std::string &str, const std::string &sub);
 	
+	// Mark the cached system colors as out of date. Derived classes must call
+	// this if something that SystemValue() depends on changes.
+	void InvalidateCache();
+	
 	
 protected:
 	PlayerInfo &player;
@@ -107,6 +113,43 @@ protected:
 	
 	
 private:
+	// Nothing that decides which systems, links, and names are drawn or what
+	// color they are can change while the map is open, except for the coloring
+	// mode, so all of that is worked out once and kept in map coordinates. Each
+	// frame then only has to apply the current pan and zoom, and only to the
+	// systems that are on screen.
+	class Node {
+	public:
+		Color color;
+		bool isDrawn;
+		bool isNamed;
+	};
+	class Link {
+	public:
+		Point start;
+		Point end;
+		// The direction from the end to the start.
+		Point unit;
+		bool isClose;
+	};
+	class Wormhole {
+	public:
+		Point start;
+		Point end;
+		Point unit;
+		// Only one direction of a two-way wormhole draws the connecting line.
+		bool drawLine;
+	};
+	
+	void UpdateCache();
+	Color SystemColor(const System &system) const;
+	// Find the systems that are on screen or within the given number of pixels
+	// of it, plus the given number of extra pixels to the left.
+	void FindVisible(double margin, double leftMargin = 0.);
+	// Check if any part of the line between the given map positions may be on
+	// screen.
+	bool IsVisible(const Point &start, const Point &end) const;
+	
 	void DrawTravelPlan();
 	void DrawWormholes();
 	void DrawLinks();
@@ -115,6 +158,18 @@ private:
 	void DrawMissions();
 	void DrawPointer(const System *system, Angle &angle, const Color &color, bool bigger = false);
 	static void DrawPointer(Point position, Angle &angle, const Color &color, bool drawBack = true, bool bigger = false);
+	
+	
+private:
+	// The nodes are indexed by System::Index().
+	std::vector<Node> nodes;
+	std::vector<Link> links;
+	std::vector<Wormhole> wormholes;
+	// If systems are colored by government, this is where each government is.
+	std::vector<std::pair<Point, const Government *>> governments;
+	std::vector<const System *> visible;
+	bool cacheIsValid = false;
+	int cachedCommodity = 0;
 };
 
 
@@ -97,6 +97,8 @@ void MapShipyardPanel::Select(int index)
 		selected = list[index];
 		selectedInfo.Update(*selected, player.StockDepreciation(), player.GetDate().DaysSinceEpoch());
 	}
+	// The systems that sell the selected item are drawn in a different color.
+	InvalidateCache();
 }
 
 
@@ -0,0 +1,106 @@
+/* MappedFile.cpp
+Copyright (c) 2017 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "MappedFile.h"
+
+#include "File.h"
+
+#if defined _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <cstdio>
+
+using namespace std;
+
+
+
+MappedFile::MappedFile(const string &path)
+{
+	// The file itself only needs to stay open until the mapping is created.
+	File file(path);
+	if(!file)
+		return;
+	
+#if defined _WIN32
+	HANDLE handle = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(file)));
+	LARGE_INTEGER fileSize;
+	if(!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart <= 0)
+		return;
+	
+	mapping = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(!mapping)
+		return;
+	
+	data = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if(data)
+		size = fileSize.QuadPart;
+#else
+	struct stat buf;
+	if(fstat(fileno(file), &buf) || buf.st_size <= 0)
+		return;
+	
+	void *result = mmap(nullptr, buf.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+	if(result == MAP_FAILED)
+		return;
+	
+	data = static_cast<const char *>(result);
+	size = buf.st_size;
+#endif
+}
+
+
+
+MappedFile::~MappedFile()
+{
+#if defined _WIN32
+	if(data)
+		UnmapViewOfFile(data);
+	if(mapping)
+		CloseHandle(mapping);
+#else
+	if(data)
+		munmap(const_cast<char *>(data), size);
+#endif
+}
+
+
+
+MappedFile::operator bool() const
+{
+	return data;
+}
+
+
+
+const char *MappedFile::begin() const
+{
+	return data;
+}
+
+
+
+const char *MappedFile::end() const
+{
+	return data + size;
+}
+
+
+
+size_t MappedFile::Size() const
+{
+	return size;
+}
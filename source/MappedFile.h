@@ -0,0 +1,50 @@
+/* MappedFile.h
+Copyright (c) 2017 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+
+
+
+// RAII wrapper for a read-only memory mapping of a file, so that its contents
+// can be parsed in place rather than copied into a string first. The mapping
+// is released when this object is destroyed.
+class MappedFile {
+public:
+	explicit MappedFile(const std::string &path);
+	MappedFile(const MappedFile &) = delete;
+	~MappedFile();
+	
+	MappedFile &operator=(const MappedFile &) = delete;
+	
+	// Check if the file was mapped. An empty file is never mapped.
+	operator bool() const;
+	
+	const char *begin() const;
+	const char *end() const;
+	size_t Size() const;
+	
+	
+private:
+	const char *data = nullptr;
+	size_t size = 0;
+#if defined _WIN32
+	void *mapping = nullptr;
+#endif
+};
+
+
+
+#endif
@@ -12,11 +12,24 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 #include "Mask.h"
 
+#include "Files.h"
 #include "ImageBuffer.h"
 
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <limits>
+#include <list>
+#include <mutex>
 
 using namespace std;
 
@@ -30,25 +43,30 @@ namespace {
 		// Convert the pitch to uint32_ts instead of bytes.
 		int pitch = image->Width();
 		
-		// First, find a non-empty pixel.
+		// First, find a non-empty pixel. Most images have a transparent margin,
+		// so check four pixels at a time if possible.
+		size_t count = static_cast<size_t>(image->Width()) * image->Height();
+		size_t first = 0;
+#ifdef __SSE2__
+		const __m128i alpha = _mm_set1_epi32(static_cast<int>(on));
+		const __m128i zero = _mm_setzero_si128();
+		for( ; first + 4 <= count; first += 4)
+		{
+			__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin + first));
+			if(_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(pixels, alpha), zero)) != 0xFFFF)
+				break;
+		}
+#endif
+		while(first < count && !(begin[first] & on))
+			++first;
+		// If the image is completely transparent, it has no outline.
+		if(first == count)
+			return;
+		
 		// This points to the current pixel.
-		const uint32_t *it = begin;
+		const uint32_t *it = begin + first;
 		// This is where we will store the point:
-		Point point;
-		
-		for(int y = 0; y < image->Height(); ++y)
-			for(int x = 0; x < image->Width(); ++x)
-			{
-				// If this pixel is occupied, bail out of both loops.
-				if(*it & on)
-				{
-					point.Set(x, y);
-					// Break out of both loops.
-					y = image->Height();
-					break;
-				}
-				++it;
-			}
+		Point point(first % pitch, first / pitch);
 		
 		// Now "it" points to the first pixel, whose coordinates are in "point".
 		// We will step around the outline in these 8 basic directions:
@@ -198,6 +216,35 @@ namespace {
 	}
 	
 	
+	// Find the convex hull of the outline, using Andrew's monotone chain
+	// algorithm. The hull's vertices are a subset of the outline's.
+	void Hull(vector<Point> points, vector<Point> *hull)
+	{
+		hull->clear();
+		if(points.empty())
+			return;
+		
+		sort(points.begin(), points.end(), [](const Point &a, const Point &b)
+			{ return a.X() < b.X() || (a.X() == b.X() && a.Y() < b.Y()); });
+		
+		// Build the lower hull, then the upper hull. The last point of each is
+		// the first point of the other, so it is left off.
+		for(int pass = 0; pass < 2; ++pass)
+		{
+			size_t start = hull->size();
+			for(const Point &p : points)
+			{
+				while(hull->size() >= start + 2
+						&& (hull->back() - (*hull)[hull->size() - 2]).Cross(p - hull->back()) <= 0.)
+					hull->pop_back();
+				hull->push_back(p);
+			}
+			hull->pop_back();
+			reverse(points.begin(), points.end());
+		}
+	}
+	
+	
 	// Find the radius of the object.
 	double Radius(const vector<Point> &outline)
 	{
@@ -206,6 +253,69 @@ namespace {
 			radius = max(radius, p.LengthSquared());
 		return sqrt(radius);
 	}
+	
+	
+	// The frames of an animated sprite often differ only in color, so they have
+	// exactly the same traced outline. Remember the most recent outlines that
+	// were simplified, so those frames can reuse the result. Masks are created
+	// by several threads at once, so this is guarded by a mutex.
+	class Outline {
+	public:
+		Point size;
+		vector<Point> raw;
+		vector<Point> simplified;
+	};
+	const size_t MAX_OUTLINES = 32;
+	list<Outline> recentOutlines;
+	mutex outlineMutex;
+	
+	bool FindOutline(const vector<Point> &raw, Point size, vector<Point> *result)
+	{
+		lock_guard<mutex> lock(outlineMutex);
+		for(auto it = recentOutlines.begin(); it != recentOutlines.end(); ++it)
+			if(it->size.X() == size.X() && it->size.Y() == size.Y() && it->raw.size() == raw.size()
+					&& equal(raw.begin(), raw.end(), it->raw.begin(),
+						[](const Point &a, const Point &b) { return a.X() == b.X() && a.Y() == b.Y(); }))
+			{
+				*result = it->simplified;
+				recentOutlines.splice(recentOutlines.begin(), recentOutlines, it);
+				return true;
+			}
+		return false;
+	}
+	
+	void AddOutline(vector<Point> &&raw, Point size, const vector<Point> &simplified)
+	{
+		lock_guard<mutex> lock(outlineMutex);
+		recentOutlines.push_front(Outline{size, move(raw), simplified});
+		if(recentOutlines.size() > MAX_OUTLINES)
+			recentOutlines.pop_back();
+	}
+	
+	
+	// Bump this whenever a change to Create() would produce different outlines,
+	// so that any masks cached by older versions are regenerated.
+	const int CACHE_VERSION = 1;
+	
+	// Get the path where the mask for the given image is cached. The file name
+	// is a hash of the image path; the full path is stored inside the file, so
+	// a hash collision just results in a cache miss.
+	string CachePath(const string &imagePath)
+	{
+		if(Files::Cache().empty())
+			return string();
+		
+		// 64-bit FNV-1a hash.
+		uint64_t hash = 14695981039346656037ULL;
+		for(char c : imagePath)
+		{
+			hash ^= static_cast<unsigned char>(c);
+			hash *= 1099511628211ULL;
+		}
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.mask", static_cast<unsigned long long>(hash));
+		return Files::Cache() + name;
+	}
 }
 
 
@@ -225,11 +335,130 @@ void Mask::Create(ImageBuffer *image)
 	vector<Point> raw;
 	Trace(image, &raw);
 	
-	SmoothAndCenter(&raw, Point(image->Width(), image->Height()));
+	Point size(image->Width(), image->Height());
+	if(raw.empty())
+		outline.clear();
+	else if(!FindOutline(raw, size, &outline))
+	{
+		vector<Point> smoothed = raw;
+		SmoothAndCenter(&smoothed, size);
+		Simplify(smoothed, &outline);
+		AddOutline(move(raw), size, outline);
+	}
+	
+	Precompute();
+}
+
+
+
+// Load the outline from the cache if it was generated from the current version
+// of the given image file. Return false if it must be created from the image.
+bool Mask::LoadCache(const string &imagePath)
+{
+	string cachePath = CachePath(imagePath);
+	if(cachePath.empty() || !Files::Exists(cachePath))
+		return false;
+	
+	// The file contains the cache version, the image path, the image's
+	// timestamp, and the number of points, one per line, followed by the
+	// coordinates of each point.
+	string data = Files::Read(cachePath);
+	const char *it = data.c_str();
+	char *end = nullptr;
+	if(strtol(it, &end, 10) != CACHE_VERSION || *end != '\n')
+		return false;
+	it = end + 1;
+	
+	size_t length = imagePath.length();
+	if(data.compare(it - data.c_str(), length, imagePath) || it[length] != '\n')
+		return false;
+	it += length + 1;
+	
+	long long timestamp = strtoll(it, &end, 10);
+	if(end == it || timestamp != static_cast<long long>(Files::Timestamp(imagePath)))
+		return false;
+	it = end;
+	
+	long count = strtol(it, &end, 10);
+	if(end == it || count <= 0)
+		return false;
+	it = end;
+	
+	vector<Point> points;
+	points.reserve(count);
+	for(long i = 0; i < count; ++i)
+	{
+		double x = strtod(it, &end);
+		if(end == it)
+			return false;
+		it = end;
+		double y = strtod(it, &end);
+		if(end == it)
+			return false;
+		it = end;
+		points.emplace_back(x, y);
+	}
 	
-	Simplify(raw, &outline);
+	outline.swap(points);
+	Precompute();
+	return true;
+}
+
+
+
+// Save the outline to the cache, so that it need not be traced again from
+// the given image until that image file changes.
+void Mask::SaveCache(const string &imagePath) const
+{
+	string cachePath = CachePath(imagePath);
+	if(cachePath.empty() || outline.empty())
+		return;
 	
-	radius = Radius(outline);
+	string data = to_string(CACHE_VERSION) + '\n' + imagePath + '\n'
+		+ to_string(static_cast<long long>(Files::Timestamp(imagePath))) + '\n'
+		+ to_string(outline.size()) + '\n';
+	// Store each coordinate with enough precision to round-trip exactly, so a
+	// cached mask behaves identically to one traced from the image.
+	char buffer[64];
+	for(const Point &p : outline)
+	{
+		snprintf(buffer, sizeof(buffer), "%.17g %.17g\n", p.X(), p.Y());
+		data += buffer;
+	}
+	
+	Files::WriteAtomically(cachePath, data);
+}
+
+
+
+// Calculate all the information that is derived from the outline.
+void Mask::Precompute()
+{
+	radius = ::Radius(outline);
+	
+	Hull(outline, &hull);
+	boxMin = boxMax = outline.empty() ? Point() : outline.front();
+	for(const Point &p : outline)
+	{
+		boxMin = Point(min(boxMin.X(), p.X()), min(boxMin.Y(), p.Y()));
+		boxMax = Point(max(boxMax.X(), p.X()), max(boxMax.Y(), p.Y()));
+	}
+	
+	// Store the edges of the outline in the form Intersection() uses.
+	size_t padded = (outline.size() + 3) & ~static_cast<size_t>(3);
+	edgeX.assign(padded, 0.f);
+	edgeY.assign(padded, 0.f);
+	edgeDX.assign(padded, 0.f);
+	edgeDY.assign(padded, 0.f);
+	for(size_t i = 0; i < outline.size(); ++i)
+	{
+		const Point &prev = outline[i ? i - 1 : outline.size() - 1];
+		Point vB = outline[i] - prev;
+		edgeX[i] = prev.X();
+		edgeY[i] = prev.Y();
+		edgeDX[i] = vB.X();
+		edgeDY[i] = vB.Y();
+	}
 }
 
 
@@ -242,6 +471,23 @@ bool Mask::IsLoaded() const
 
 
 
+// Get the distance from the center to the farthest point of the outline.
+double Mask::Radius() const
+{
+	return radius;
+}
+
+
+
+// Get how much memory the outline and the arrays derived from it take up.
+size_t Mask::Memory() const
+{
+	return (outline.capacity() + hull.capacity()) * sizeof(Point)
+		+ (edgeX.capacity() + edgeY.capacity() + edgeDX.capacity() + edgeDY.capacity()) * sizeof(float);
+}
+
+
+
 // Check if this mask intersects the given line segment (from sA to vA). If
 // it does, return the fraction of the way along the segment where the
 // intersection occurs. The sA should be relative to this object's center.
@@ -265,6 +511,11 @@ double Mask::Collide(Point sA, Point vA, Angle facing) const
 	
 	// For simplicity, use a ray pointing straight downwards. A segment then
 	// intersects only if its x coordinates span the point's coordinates.
+	
+	// Most segments that get this far still miss the bounding box, in which
+	// case they can neither start inside the mask nor cross its outline.
+	if(!InBox(sA, vA))
+		return 1.;
 	if(distance <= radius && Contains(sA))
 		return 0.;
 	
@@ -280,7 +531,8 @@ bool Mask::Contains(Point point, Angle facing) const
 		return false;
 	
 	// Rotate into the mask's frame of reference.
-	return Contains((-facing).Rotate(point));
+	point = (-facing).Rotate(point);
+	return InBox(point) && Contains(point);
 }
 
 
@@ -295,9 +547,19 @@ bool Mask::WithinRange(Point point, Angle facing, double range) const
 	
 	// Rotate into the mask's frame of reference.
 	point = (-facing).Rotate(point);
+	// Every vertex is inside the bounding box, so if the box is out of range,
+	// so are all of them.
+	Point nearest(max(boxMin.X(), min(boxMax.X(), point.X())), max(boxMin.Y(), min(boxMax.Y(), point.Y())));
 	// For efficiency, compare to range^2 instead of range.
 	range *= range;
+	if(nearest.DistanceSquared(point) >= range)
+		return false;
 	
+	// The vertices of the convex hull are also vertices of the outline, and
+	// there are usually far fewer of them, so check them first.
+	for(const Point &p : hull)
+		if(p.DistanceSquared(point) < range)
+			return true;
 	for(const Point &p : outline)
 		if(p.DistanceSquared(point) < range)
 			return true;
@@ -329,6 +591,41 @@ double Mask::Range(Point point, Angle facing) const
 
 double Mask::Intersection(Point sA, Point vA) const
 {
+#ifdef __SSE__
+	// Check four edges at a time. This is the same test as below, but with any
+	// edge that is not hit given a range of 1. The padding edges have a length
+	// of zero, so their cross product is zero and they are never hit.
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 sAX = _mm_set1_ps(sA.X());
+	const __m128 sAY = _mm_set1_ps(sA.Y());
+	const __m128 vAX = _mm_set1_ps(vA.X());
+	const __m128 vAY = _mm_set1_ps(vA.Y());
+	__m128 closest = one;
+	for(size_t i = 0; i < edgeX.size(); i += 4)
+	{
+		__m128 vBX = _mm_loadu_ps(&edgeDX[i]);
+		__m128 vBY = _mm_loadu_ps(&edgeDY[i]);
+		__m128 vSX = _mm_sub_ps(_mm_loadu_ps(&edgeX[i]), sAX);
+		__m128 vSY = _mm_sub_ps(_mm_loadu_ps(&edgeY[i]), sAY);
+		
+		__m128 cross = _mm_sub_ps(_mm_mul_ps(vBX, vAY), _mm_mul_ps(vBY, vAX));
+		__m128 uB = _mm_sub_ps(_mm_mul_ps(vAX, vSY), _mm_mul_ps(vAY, vSX));
+		__m128 uA = _mm_sub_ps(_mm_mul_ps(vBX, vSY), _mm_mul_ps(vBY, vSX));
+		
+		__m128 isHit = _mm_and_ps(
+			_mm_and_ps(_mm_cmpgt_ps(cross, zero), _mm_cmpge_ps(uB, zero)),
+			_mm_and_ps(_mm_cmplt_ps(uB, cross), _mm_cmpge_ps(uA, zero)));
+		// Where cross is zero this divides by zero, but those lanes are masked out.
+		__m128 range = _mm_div_ps(uA, cross);
+		range = _mm_or_ps(_mm_and_ps(isHit, range), _mm_andnot_ps(isHit, one));
+		closest = _mm_min_ps(closest, range);
+	}
+	// Find the smallest of the four values.
+	closest = _mm_min_ps(closest, _mm_shuffle_ps(closest, closest, _MM_SHUFFLE(1, 0, 3, 2)));
+	closest = _mm_min_ps(closest, _mm_shuffle_ps(closest, closest, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtss_f32(closest);
+#else
 	// Keep track of the closest intersection point found.
 	double closest = 1.;
 	
@@ -355,6 +652,7 @@ double Mask::Intersection(Point sA, Point vA) const
 		prev = next;
 	}
 	return closest;
+#endif
 }
 
 
@@ -384,3 +682,40 @@ bool Mask::Contains(Point point) const
 	// If the number of intersections is odd, the point is within the mask.
 	return (intersections & 1);
 }
+
+
+
+// Check whether the given point is within the bounding box.
+bool Mask::InBox(Point point) const
+{
+	return (point.X() >= boxMin.X()) & (point.X() <= boxMax.X())
+		& (point.Y() >= boxMin.Y()) & (point.Y() <= boxMax.Y());
+}
+
+
+
+// Check whether the line segment from sA to sA + vA touches the bounding box,
+// by clipping it to the box one axis at a time.
+bool Mask::InBox(Point sA, Point vA) const
+{
+	double enter = 0.;
+	double exit = 1.;
+	const double start[2] = {sA.X(), sA.Y()};
+	const double direction[2] = {vA.X(), vA.Y()};
+	const double low[2] = {boxMin.X(), boxMin.Y()};
+	const double high[2] = {boxMax.X(), boxMax.Y()};
+	for(int i = 0; i < 2; ++i)
+	{
+		if(!direction[i])
+		{
+			if(start[i] < low[i] || start[i] > high[i])
+				return false;
+			continue;
+		}
+		double a = (low[i] - start[i]) / direction[i];
+		double b = (high[i] - start[i]) / direction[i];
+		enter = max(enter, min(a, b));
+		exit = min(exit, max(a, b));
+	}
+	return enter <= exit;
+}
@@ -16,6 +16,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Angle.h"
 #include "Point.h"
 
+#include <string>
 #include <vector>
 
 class ImageBuffer;
@@ -34,9 +35,17 @@ public:
 	
 	// Construct a mask from the alpha channel of an image.
 	void Create(ImageBuffer *image);
+	// Load a mask that was previously created from the given image file and
+	// saved in the cache. This fails if the image has changed since then.
+	bool LoadCache(const std::string &imagePath);
+	void SaveCache(const std::string &imagePath) const;
 	
 	// Check whether a mask was successfully loaded.
 	bool IsLoaded() const;
+	// Get the distance from the center to the farthest point of the outline.
+	double Radius() const;
+	// Get how much memory the outline and the arrays derived from it take up.
+	size_t Memory() const;
 	
 	// Check if this mask intersects the given line segment (from sA to vA). If
 	// it does, return the fraction of the way along the segment where the
@@ -57,13 +66,33 @@ public:
 	
 	
 private:
+	// Calculate the radius, hull, bounding box, and edge arrays.
+	void Precompute();
 	double Intersection(Point sA, Point vA) const;
 	bool Contains(Point point) const;
+	// Check whether the given point, or line segment, touches the bounding box.
+	bool InBox(Point point) const;
+	bool InBox(Point sA, Point vA) const;
 	
 	
 private:
 	std::vector<Point> outline;
 	double radius;
+	
+	// The convex hull of the outline, and the outline's bounding box in the
+	// mask's own frame of reference. These allow most near misses to be
+	// rejected without examining every edge of the outline.
+	std::vector<Point> hull;
+	Point boxMin;
+	Point boxMax;
+	
+	// For vectorized intersection tests, the start point and direction of each
+	// edge of the outline are also stored as separate arrays of floats. These
+	// are padded with empty edges to a multiple of four.
+	std::vector<float> edgeX;
+	std::vector<float> edgeY;
+	std::vector<float> edgeDX;
+	std::vector<float> edgeDY;
 };
 
 
@@ -20,6 +20,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include <list>
 #include <map>
 #include <memory>
+#include <vector>
 
 class DataNode;
 class Effect;
@@ -51,7 +52,7 @@ public:
 	// Move the object forward one step. If it has been reduced to zero hull, it
 	// will "explode" instead of moving, creating flotsam and explosion effects.
 	// In that case it will return false, meaning it should be deleted.
-	bool Move(std::list<Effect> &effects, std::list<std::shared_ptr<Flotsam>> &flotsam);
+	bool Move(std::vector<Effect> &effects, std::list<std::shared_ptr<Flotsam>> &flotsam);
 	
 	// Check if the given projectile collides with this object. If so, a value
 	// is returned indicating how far along its path the collision occurs.
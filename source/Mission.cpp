@@ -15,7 +15,6 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "DataNode.h"
 #include "DataWriter.h"
 #include "Dialog.h"
-#include "DistanceMap.h"
 #include "Format.h"
 #include "GameData.h"
 #include "Government.h"
@@ -23,6 +22,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Planet.h"
 #include "PlayerInfo.h"
 #include "Random.h"
+#include "RouteTable.h"
 #include "Ship.h"
 #include "ShipEvent.h"
 #include "System.h"
@@ -389,6 +389,22 @@ bool Mission::IsAtLocation(Location location) const
 
 
 
+// Get the planet this mission can only be offered on (if any), and the filter
+// that any planet it is offered on must match.
+const Planet *Mission::Source() const
+{
+	return source;
+}
+
+
+
+const LocationFilter &Mission::SourceFilter() const
+{
+	return sourceFilter;
+}
+
+
+
 // Information about what you are doing.
 const Planet *Mission::Destination() const
 {
@@ -927,19 +943,17 @@ Mission Mission::Instantiate(const PlayerInfo &player) const
 	while(!destinations.empty())
 	{
 		// Find the closest destination to this location.
-		DistanceMap distance(source);
 		auto it = destinations.begin();
 		auto bestIt = it;
 		for(++it; it != destinations.end(); ++it)
-			if(distance.Days(*it) < distance.Days(*bestIt))
+			if(RouteTable::Days(source, *it) < RouteTable::Days(source, *bestIt))
 				bestIt = it;
 		
+		jumps += RouteTable::Days(source, *bestIt);
 		source = *bestIt;
 		destinations.erase(bestIt);
-		jumps += distance.Days(*bestIt);
 	}
-	DistanceMap distance(source);
-	jumps += distance.Days(result.destination->GetSystem());
+	jumps += RouteTable::Days(source, result.destination->GetSystem());
 	int payload = result.cargoSize + 10 * result.passengers;
 	
 	// Set the deadline, if requested.
@@ -1024,16 +1038,12 @@ void Mission::Enter(const System *system, PlayerInfo &player, UI *ui)
 
 const System *Mission::PickSystem(const LocationFilter &filter, const PlayerInfo &player) const
 {
-	// Find a planet that satisfies the filter.
+	// Find a system that satisfies the filter. Only the systems that might
+	// match need to be checked.
 	vector<const System *> options;
-	for(const auto &it : GameData::Systems())
-	{
-		// Skip entries with incomplete data.
-		if(it.second.Name().empty())
-			continue;
-		if(filter.Matches(&it.second, player.GetSystem()))
-			options.push_back(&it.second);
-	}
+	for(const System *system : filter.CandidateSystems(player.GetSystem()))
+		if(filter.Matches(system, player.GetSystem()))
+			options.push_back(system);
 	return options.empty() ? nullptr : options[Random::Int(options.size())];
 }
 
@@ -1041,17 +1051,17 @@ const System *Mission::PickSystem(const LocationFilter &filter, const PlayerInfo
 
 const Planet *Mission::PickPlanet(const LocationFilter &filter, const PlayerInfo &player) const
 {
-	// Find a planet that satisfies the filter.
+	// Find a planet that satisfies the filter. Only the planets that might
+	// match need to be checked.
 	vector<const Planet *> options;
-	for(const auto &it : GameData::Planets())
+	for(const Planet *planet : filter.CandidatePlanets(player.GetSystem()))
 	{
-		// Skip entries with incomplete data.
-		if(it.second.Name().empty() || (clearance.empty() && !it.second.CanLand()))
+		if(clearance.empty() && !planet->CanLand())
 			continue;
-		if(it.second.IsWormhole() || !it.second.HasSpaceport())
+		if(planet->IsWormhole() || !planet->HasSpaceport())
 			continue;
-		if(filter.Matches(&it.second, player.GetSystem()))
-			options.push_back(&it.second);
+		if(filter.Matches(planet, player.GetSystem()))
+			options.push_back(planet);
 	}
 	return options.empty() ? nullptr : options[Random::Int(options.size())];
 }
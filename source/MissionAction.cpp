@@ -194,7 +194,7 @@ void MissionAction::Save(DataWriter &out) const
 			}
 			out.EndChild();
 		}
-		if(!conversation.IsEmpty())
+		if(!GetConversation().IsEmpty())
 			conversation.Save(out);
 		
 		for(const auto &it : gifts)
@@ -253,7 +253,7 @@ bool MissionAction::CanBeDone(const PlayerInfo &player) const
 void MissionAction::Do(PlayerInfo &player, UI *ui, const System *destination) const
 {
 	bool isOffer = (trigger == "offer");
-	if(!conversation.IsEmpty() && ui)
+	if(ui && !GetConversation().IsEmpty())
 	{
 		ConversationPanel *panel = new ConversationPanel(player, conversation, destination);
 		if(isOffer)
@@ -328,10 +328,14 @@ MissionAction MissionAction::Instantiate(map<string, string> &subs, int jumps, i
 	if(!dialogText.empty())
 		result.dialogText = Format::Replace(dialogText, subs);
 	
-	if(stockConversation)
-		result.conversation = stockConversation->Substitute(subs);
-	else if(!conversation.IsEmpty())
-		result.conversation = conversation.Substitute(subs);
+	// The conversation is filled in later, with a copy of the substitutions as
+	// they are now (since later actions may change the payment).
+	const Conversation *source = stockConversation ? stockConversation : &conversation;
+	if(!source->IsEmpty())
+	{
+		result.pendingConversation = source;
+		result.pendingSubs = make_shared<const map<string, string>>(subs);
+	}
 	
 	result.fail = fail;
 	
@@ -339,3 +343,18 @@ MissionAction MissionAction::Instantiate(map<string, string> &subs, int jumps, i
 	
 	return result;
 }
+
+
+
+// Get this action's conversation, filling in its text if that has not
+// been done yet.
+const Conversation &MissionAction::GetConversation() const
+{
+	if(pendingConversation)
+	{
+		conversation = pendingConversation->Substitute(*pendingSubs);
+		pendingConversation = nullptr;
+		pendingSubs.reset();
+	}
+	return conversation;
+}
@@ -17,6 +17,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Conversation.h"
 
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 
@@ -58,6 +59,12 @@ public:
 	MissionAction Instantiate(std::map<std::string, std::string> &subs, int jumps, int payload) const;
 	
 	
+private:
+	// Get this action's conversation, filling in its text if that has not
+	// been done yet.
+	const Conversation &GetConversation() const;
+	
+	
 private:
 	std::string trigger;
 	std::string system;
@@ -65,7 +72,12 @@ private:
 	std::string dialogText;
 	
 	const Conversation *stockConversation = nullptr;
-	Conversation conversation;
+	mutable Conversation conversation;
+	// Most jobs that are offered are never accepted, so an instantiated action
+	// does not fill in its conversation until it is shown or saved. Until then,
+	// these are the conversation and the substitutions to fill it in with.
+	mutable const Conversation *pendingConversation = nullptr;
+	mutable std::shared_ptr<const std::map<std::string, std::string>> pendingSubs;
 	
 	std::map<std::string, int> events;
 	std::map<const Outfit *, int> gifts;
@@ -35,9 +35,11 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "SpriteSet.h"
 #include "SpriteShader.h"
 #include "System.h"
+#include "SystemGrid.h"
 #include "UI.h"
 
 #include <sstream>
+#include <vector>
 
 using namespace std;
 
@@ -128,21 +130,19 @@ void MissionPanel::Draw()
 {
 	MapPanel::Draw();
 	
+	if(!listsAreCurrent)
+		UpdateLists();
+	
 	Color routeColor(.2, .1, 0., 0.);
-	const System *system = selectedSystem;
-	while(distance.Days(system) > 0)
+	for(unsigned i = 1; i < route.size(); ++i)
 	{
-		const System *next = distance.Route(system);
-		
-		Point from = Zoom() * (next->Position() + center);
-		Point to = Zoom() * (system->Position() + center);
+		Point from = Zoom() * (route[i] + center);
+		Point to = Zoom() * (route[i - 1] + center);
 		Point unit = (from - to).Unit() * 7.;
 		from -= unit;
 		to += unit;
 		
 		LineShader::Draw(from, to, 5., routeColor);
-		
-		system = next;
 	}
 	
 	DrawKey();
@@ -151,13 +151,13 @@ void MissionPanel::Draw()
 		Screen::TopLeft() + Point(0., -availableScroll),
 		"Missions available here:",
 		available.size());
-	DrawList(available, pos);
+	DrawList(availableList, pos);
 	
 	pos = DrawPanel(
 		Screen::TopRight() + Point(-SIDE_WIDTH, -acceptedScroll),
 		"Your current missions:",
-		AcceptedVisible());
-	DrawList(accepted, pos);
+		acceptedList.size());
+	DrawList(acceptedList, pos);
 	
 	DrawMissionInfo();
 	
@@ -179,6 +179,7 @@ void MissionPanel::Draw()
 // Only override the ones you need; the default action is to return false.
 bool MissionPanel::KeyDown(SDL_Keycode key, Uint16 mod, const Command &command)
 {
+	listsAreCurrent = false;
 	if(key == 'a' && CanAccept())
 	{
 		Accept();
@@ -256,6 +257,7 @@ bool MissionPanel::KeyDown(SDL_Keycode key, Uint16 mod, const Command &command)
 bool MissionPanel::Click(int x, int y, int clicks)
 {
 	dragSide = 0;
+	listsAreCurrent = false;
 	
 	if(x > Screen::Right() - 80 && y > Screen::Bottom() - 50)
 		return DoKey('p');
@@ -297,11 +299,12 @@ bool MissionPanel::Click(int x, int y, int clicks)
 	// Figure out if a system was clicked on.
 	Point click = Point(x, y) / Zoom() - center;
 	const System *system = nullptr;
-	for(const auto &it : GameData::Systems())
-		if(click.Distance(it.second.Position()) < 10.
-				&& (player.HasSeen(&it.second) || &it.second == specialSystem))
+	vector<const System *> nearby;
+	SystemGrid::Circle(click, 10., nearby);
+	for(const System *it : nearby)
+		if(player.HasSeen(it) || it == specialSystem)
 		{
-			system = &it.second;
+			system = it;
 			break;
 		}
 	if(system)
@@ -411,6 +414,37 @@ bool MissionPanel::Scroll(double dx, double dy)
 
 
 
+// Find the visible missions in each list, and the route to the selected system.
+void MissionPanel::UpdateLists()
+{
+	availableList.clear();
+	for(auto it = available.begin(); it != available.end(); ++it)
+		if(it->IsVisible())
+			availableList.push_back({it, it->HasSpace(player)});
+	
+	acceptedList.clear();
+	for(auto it = accepted.begin(); it != accepted.end(); ++it)
+		if(it->IsVisible())
+			acceptedList.push_back({it, IsSatisfied(*it)});
+	
+	route.clear();
+	const System *system = selectedSystem;
+	if(distance.Days(system) > 0)
+		route.push_back(system->Position());
+	while(distance.Days(system) > 0)
+	{
+		system = distance.Route(system);
+		route.push_back(system->Position());
+	}
+	
+	// Any panel that is shown on top of this one (e.g. a dialog asking whether
+	// to abort a mission) may change the missions when it closes, so keep
+	// checking until this panel is on top again.
+	listsAreCurrent = GetUI()->IsTop(this);
+}
+
+
+
 void MissionPanel::DrawKey() const
 {
 	const Sprite *back = SpriteSet::Get("ui/mission key");
@@ -491,7 +525,7 @@ void MissionPanel::DrawSelectedSystem() const
 
 void MissionPanel::DrawMissionSystem(const Mission &mission, const Color &color) const
 {
-	const Color &waypointColor = *GameData::Colors().Get("waypoint back");
+	static const Color &waypointColor = *GameData::Colors().Get("waypoint back");
 	
 	Point pos = Zoom() * (mission.Destination()->GetSystem()->Position() + center);
 	RingShader::Draw(pos, 22., 20.5, color);
@@ -507,8 +541,8 @@ Point MissionPanel::DrawPanel(Point pos, const string &label, int entries) const
 {
 	const Font &font = FontSet::Get(14);
 	Color back(.125, 1.);
-	Color unselected = *GameData::Colors().Get("medium");
-	Color selected = *GameData::Colors().Get("bright");
+	static const Color &unselected = *GameData::Colors().Get("medium");
+	static const Color &selected = *GameData::Colors().Get("bright");
 	
 	// Draw the panel.
 	Point size(SIDE_WIDTH, 20 * entries + 40);
@@ -546,31 +580,27 @@ Point MissionPanel::DrawPanel(Point pos, const string &label, int entries) const
 
 
 
-Point MissionPanel::DrawList(const list<Mission> &list, Point pos) const
+Point MissionPanel::DrawList(const vector<ListEntry> &list, Point pos) const
 {
 	const Font &font = FontSet::Get(14);
-	Color highlight = *GameData::Colors().Get("faint");
-	Color unselected = *GameData::Colors().Get("medium");
-	Color selected = *GameData::Colors().Get("bright");
-	Color dim = *GameData::Colors().Get("dim");
+	static const Color &highlight = *GameData::Colors().Get("faint");
+	static const Color &unselected = *GameData::Colors().Get("medium");
+	static const Color &selected = *GameData::Colors().Get("bright");
+	static const Color &dim = *GameData::Colors().Get("dim");
 	
-	for(auto it = list.begin(); it != list.end(); ++it)
+	for(const ListEntry &entry : list)
 	{
-		if(!it->IsVisible())
-			continue;
-		
 		pos.Y() += 20.;
 		
-		bool isSelected = (it == availableIt || it == acceptedIt);
+		bool isSelected = (entry.it == availableIt || entry.it == acceptedIt);
 		if(isSelected)
 			FillShader::Fill(
 				pos + Point(.5 * SIDE_WIDTH - 5., 8.),
 				Point(SIDE_WIDTH - 10., 20.),
 				highlight);
 		
-		bool canAccept = (&list == &available ? it->HasSpace(player) : IsSatisfied(*it));
-		font.Draw(it->Name(), pos,
-			(!canAccept ? dim : isSelected ? selected : unselected));
+		font.Draw(entry.it->Name(), pos,
+			(!entry.canAccept ? dim : isSelected ? selected : unselected));
 	}
 	
 	return pos;
@@ -594,7 +624,7 @@ void MissionPanel::DrawMissionInfo()
 	
 	info.SetString("today", player.GetDate().ToString());
 	
-	const Interface *interface = GameData::Interfaces().Get("mission");
+	static const Interface *interface = GameData::Interfaces().Get("mission");
 	interface->Draw(info, this);
 	
 	// If a mission is selected, draw its descriptive text.
@@ -18,6 +18,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "WrappedText.h"
 
 #include <list>
+#include <vector>
 
 class Color;
 class Mission;
@@ -47,11 +48,24 @@ protected:
 	
 	
 private:
+	// A mission that is shown in one of the lists.
+	class ListEntry {
+	public:
+		std::list<Mission>::const_iterator it;
+		// For an available job, whether there is space to accept it. For an
+		// accepted mission, whether its requirements have been satisfied.
+		bool canAccept;
+	};
+	
+	
+private:
+	void UpdateLists();
+	
 	void DrawKey() const;
 	void DrawSelectedSystem() const;
 	void DrawMissionSystem(const Mission &mission, const Color &color) const;
 	Point DrawPanel(Point pos, const std::string &label, int entries) const;
-	Point DrawList(const std::list<Mission> &list, Point pos) const;
+	Point DrawList(const std::vector<ListEntry> &list, Point pos) const;
 	void DrawMissionInfo();
 	
 	bool CanAccept() const;
@@ -78,6 +92,15 @@ private:
 	
 	int dragSide = 0;
 	WrappedText wrap;
+	
+	// Checking whether each mission can be accepted or is satisfied is slow
+	// when the player has many missions, so the visible missions and the route
+	// to the selected system (in map coordinates) are only worked out again
+	// after something happens that might change them.
+	std::vector<ListEntry> availableList;
+	std::vector<ListEntry> acceptedList;
+	std::vector<Point> route;
+	bool listsAreCurrent = false;
 };
 
 
@@ -13,9 +13,11 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Music.h"
 
 #include "Files.h"
+#include "ThreadPool.h"
 
 #include <mad.h>
 
+#include <algorithm>
 #include <cstring>
 #include <map>
 
@@ -27,6 +29,11 @@ namespace {
 	// How many samples to put in each output block. Because the output is in
 	// stereo, the duration of the sample is half this amount:
 	static const size_t OUTPUT_CHUNK = 32768;
+	// How many samples the ring buffer holds. This must be a power of two, and
+	// have room for more than two output blocks plus one decoded MP3 frame.
+	static const size_t RING_SIZE = 4 * OUTPUT_CHUNK;
+	// The most samples that one MP3 frame can decode to (in stereo).
+	static const size_t MAX_FRAME_SAMPLES = 2 * 1152;
 	
 	static map<string, string> paths;
 }
@@ -58,30 +65,65 @@ void Music::Init(const vector<string> &sources)
 
 
 
-// Music constructor, which starts the decoding thread. Initially, the thread
-// has no file to read, so it will sleep until a file is specified.
+// The state of the MP3 decoder, which must be remembered from one decoding task
+// to the next.
+class Music::Decoder {
+public:
+	Decoder();
+	~Decoder();
+	
+	// Start decoding the given file, closing the previous one. If the file is
+	// null, there is nothing more to decode.
+	void Open(FILE *file);
+	// Start decoding the given data in memory instead.
+	void Open(const shared_ptr<const vector<unsigned char>> &data, bool isLooping);
+	void Close();
+	
+	FILE *file = nullptr;
+	// This vector will store the input from the file.
+	vector<unsigned char> input;
+	// Data in memory is handed to the stream all at once. Remember where in
+	// the ring the data was last started from, to tell what has been decoded.
+	shared_ptr<const vector<unsigned char>> data;
+	bool isLooping = true;
+	bool isStarted = false;
+	size_t startPosition = 0;
+	// Whether the stream still has frames to decode from the last input that
+	// was read. Decoding stops in the middle of the input if the ring buffer
+	// fills up, and then picks up where it left off.
+	bool hasInput = false;
+	// Objects for MP3 decoding:
+	mad_stream stream;
+	mad_frame frame;
+	mad_synth synth;
+};
+
+
+
+// Music constructor. Initially, there is no file to read, so no decoding will
+// happen until a file is specified.
 Music::Music()
-	: silence(OUTPUT_CHUNK, 0)
+	: silence(OUTPUT_CHUNK, 0), current(OUTPUT_CHUNK, 0), ring(RING_SIZE, 0),
+	writePosition(0), readPosition(0), hasNewFile(false), hasFile(false),
+	hasEnded(false), isDecoding(false), decoder(new Decoder)
 {
-	// Don't start the thread until this object is fully constructed.
-	thread = std::thread(&Music::Decode, this);
 }
 
 
 
-// Destructor, which waits for the thread to stop.
+// Destructor, which waits for any decoding task to stop.
 Music::~Music()
 {
-	// Tell the decoding thread to stop.
+	// Tell the decoding task to stop, and wait until it is done.
 	{
 		unique_lock<mutex> lock(decodeMutex);
 		done = true;
+		while(isDecoding)
+			condition.wait(lock);
 	}
-	condition.notify_all();
-	thread.join();
 	
-	// If the decode thread has not yet taken possession of the next file, it is
-	// our job to close it.
+	// If the decoder has not yet taken possession of the next file, it is our
+	// job to close it.
 	if(nextFile)
 		fclose(nextFile);
 }
@@ -100,20 +142,46 @@ void Music::SetSource(const string &name)
 		return;
 	previousPath = path;
 	
-	// Inform the decoding thread that it should switch to decoding a new file.
+	// Inform the decoder that it should switch to decoding a new file.
 	unique_lock<mutex> lock(decodeMutex);
+	if(nextFile)
+		fclose(nextFile);
 	if(path.empty())
 		nextFile = nullptr;
 	else
 		nextFile = Files::Open(path);
+	nextData.reset();
 	hasNewFile = true;
+	hasEnded = false;
 	
-	// Also clear any decoded data left over from the previous file.
-	next.clear();
+	// Also clear any decoded data left over from the previous file. The decoder
+	// only writes to the ring while holding the lock, so none of the previous
+	// file's data can be added after this.
+	readPosition.store(writePosition.load(memory_order_acquire), memory_order_release);
+	lock.unlock();
+	
+	StartDecoding();
+}
+
+
+
+// Decode the given mp3 data, which must end with MAD_BUFFER_GUARD zeros.
+void Music::SetSource(const shared_ptr<const vector<unsigned char>> &data, bool isLooping)
+{
+	previousPath.clear();
 	
-	// Notify the decoding thread that it can start.
+	unique_lock<mutex> lock(decodeMutex);
+	if(nextFile)
+		fclose(nextFile);
+	nextFile = nullptr;
+	nextData = data;
+	nextIsLooping = isLooping;
+	hasNewFile = true;
+	hasEnded = false;
+	readPosition.store(writePosition.load(memory_order_acquire), memory_order_release);
 	lock.unlock();
-	condition.notify_all();
+	
+	StartDecoding();
 }
 
 
@@ -121,80 +189,142 @@ void Music::SetSource(const string &name)
 // Get the next audio buffer to play.
 const vector<int16_t> &Music::NextChunk()
 {
-	// Check whether the "next" buffer is ready.
-	unique_lock<mutex> lock(decodeMutex);
-	if(next.size() < OUTPUT_CHUNK)
+	// Check whether a whole chunk has been decoded. At the end of a source that
+	// does not loop, whatever is left is padded out with silence. The end must
+	// be checked first, so that all that was decoded before it is counted.
+	bool isEnd = hasEnded.load(memory_order_acquire);
+	size_t count = min(OUTPUT_CHUNK, Buffered());
+	if(count < OUTPUT_CHUNK && !(isEnd && count))
+	{
+		StartDecoding();
 		return silence;
+	}
 	
-	// If the next buffer is ready, move a chunk of data into the output buffer.
-	// All output buffers need to be the same size so that we can fade between
-	// two different sources.
-	current.clear();
-	current.insert(current.begin(), next.begin(), next.begin() + OUTPUT_CHUNK);
-	next.erase(next.begin(), next.begin() + OUTPUT_CHUNK);
+	// If it has, copy it into the output buffer. It may wrap around the end of
+	// the ring. All output buffers need to be the same size so that we can fade
+	// between two different sources.
+	size_t read = readPosition.load(memory_order_relaxed);
+	size_t start = read & (RING_SIZE - 1);
+	size_t first = min(count, RING_SIZE - start);
+	copy(ring.begin() + start, ring.begin() + start + first, current.begin());
+	copy(ring.begin(), ring.begin() + (count - first), current.begin() + first);
+	fill(current.begin() + count, current.end(), 0);
+	readPosition.store(read + count, memory_order_release);
 	
-	// Once the lock is unlocked, notify the decoding thread to continue.
-	lock.unlock();
-	condition.notify_all();
+	// Start decoding more data to replace what was just taken.
+	StartDecoding();
 	
 	// Return the buffer.
 	return current;
+}
+
+
+
+// Check if a chunk is ready, i.e. if NextChunk() will not return silence.
+bool Music::HasChunk() const
+{
+	bool isEnd = hasEnded.load(memory_order_acquire);
+	size_t buffered = Buffered();
+	return buffered >= OUTPUT_CHUNK || (isEnd && buffered);
+}
+
+
+
+// Check if a source that does not loop has been played all the way through.
+bool Music::IsFinished() const
+{
+	return hasEnded.load(memory_order_acquire) && !Buffered();
+}
+
+
+
+// Start a decoding task, unless one is already running or none is needed.
+void Music::StartDecoding()
+{
+	if(done)
+		return;
+	if(!hasNewFile && (!hasFile || Buffered() >= 2 * OUTPUT_CHUNK))
+		return;
+	// Only one task may use the decoder at a time.
+	if(isDecoding.exchange(true))
+		return;
 	
+	ThreadPool::Shared().Submit([this]() { Decode(); });
 }
 
 
 
-// Entry point for the decoding thread.
+// Get how many decoded samples are waiting to be played.
+size_t Music::Buffered() const
+{
+	return writePosition.load(memory_order_acquire) - readPosition.load(memory_order_acquire);
+}
+
+
+
+// Decode until enough data is queued up, or until told to switch files. This is
+// what the decoding task runs.
 void Music::Decode()
 {
-	// This vector will store the input from the file.
-	vector<unsigned char> input(INPUT_CHUNK, 0);
-	// Objects for MP3 decoding:
-	mad_stream stream;
-	mad_frame frame;
-	mad_synth synth;
-	// Loop until the thread is told to quit.
+	mad_stream &stream = decoder->stream;
+	mad_frame &frame = decoder->frame;
+	mad_synth &synth = decoder->synth;
+	vector<unsigned char> &input = decoder->input;
+	
+	// Loop until enough has been decoded.
 	while(true)
 	{
-		// First, wait until a new file has been specified or we're done.
 		FILE *file = nullptr;
-		while(!file)
 		{
 			unique_lock<mutex> lock(decodeMutex);
-			while(!done && !hasNewFile)
-				condition.wait(lock);
-			
-			// If the "done" variable has been set, exit this thread.
-			if(done)
+			if(hasNewFile && !done)
+			{
+				// The new file now belongs to the decoder, and it's the
+				// decoder's job to close it.
+				if(nextData)
+					decoder->Open(nextData, nextIsLooping);
+				else
+					decoder->Open(nextFile);
+				nextFile = nullptr;
+				nextData.reset();
+				hasNewFile = false;
+				hasFile = (decoder->file || decoder->data);
+			}
+			// If the ring buffer has filled up, stop until it is read from.
+			// Generally try to queue up two chunks worth of samples in it, just
+			// in case NextChunk() gets called twice in rapid succession.
+			file = decoder->file;
+			if(done || !hasFile || Buffered() >= 2 * OUTPUT_CHUNK)
+			{
+				isDecoding = false;
+				condition.notify_all();
 				return;
-			
-			// The new file now belongs to us, and it's our job to close it.
-			file = nextFile;
-			nextFile = nullptr;
-			hasNewFile = false;
+			}
 		}
 		
-		// Now, we have a file to read. Initialize the decoder.
-		mad_stream_init(&stream);
-		mad_frame_init(&frame);
-		mad_synth_init(&synth);
-		
-		// Loop until we are asked to switch files.
-		while(true)
+		if(!decoder->hasInput && decoder->data)
+		{
+			// Data in memory is decoded all in one go. Once it has been, either
+			// start over or stop. If nothing could be decoded from it, stop even
+			// if it loops, rather than trying over and over again.
+			size_t write = writePosition.load(memory_order_relaxed);
+			if(decoder->isStarted && (!decoder->isLooping || write == decoder->startPosition))
+			{
+				unique_lock<mutex> lock(decodeMutex);
+				if(!hasNewFile)
+				{
+					hasFile = false;
+					hasEnded.store(true, memory_order_release);
+				}
+				continue;
+			}
+			mad_stream_buffer(&stream, &decoder->data->front(), decoder->data->size());
+			decoder->isStarted = true;
+			decoder->startPosition = write;
+			decoder->hasInput = true;
+		}
+		else if(!decoder->hasInput)
 		{
-			// If the "next" buffer has filled up, wait until it is retrieved.
-			// Generally try to queue up two chunks worth of samples in it, just
-			// in case NextChunk() gets called twice in rapid succession.
-			unique_lock<mutex> lock(decodeMutex);
-			while(!done && next.size() >= 2 * OUTPUT_CHUNK)
-				condition.wait(lock);
-			// Check if we're done or if we need to switch files.
-			if(done || hasNewFile)
-				break;
-			
-			// The lock can be freed until we start filling the output buffer.
-			lock.unlock();
-			
 			// See if any input data is left undecoded in the stream. Typically
 			// this is because the last block of input contained a fraction of a
 			// full MP3 frame.
@@ -202,7 +332,7 @@ void Music::Decode()
 			if(stream.next_frame && stream.next_frame < stream.bufend)
 				remainder = stream.bufend - stream.next_frame;
 			if(remainder)
-				memcpy(&input.front(), stream.next_frame, remainder);
+				memmove(&input.front(), stream.next_frame, remainder);
 			
 			// Now, read a chunk of data from the file.
 			size_t read = fread(&input.front() + remainder, 1, INPUT_CHUNK - remainder, file);
@@ -215,58 +345,127 @@ void Music::Decode()
 			
 			// Hand the input to the stream decoder.
 			mad_stream_buffer(&stream, &input.front(), read + remainder);
+			decoder->hasInput = true;
+		}
+		
+		// Loop through the decoded result for that input block.
+		while(true)
+		{
+			// If there is no room in the ring for another frame, go back to the
+			// top of the loop, which stops decoding until some has been played.
+			if(RING_SIZE - Buffered() < MAX_FRAME_SAMPLES)
+				break;
 			
-			// Loop through the decoded result for that input block.
-			while(true)
+			// Decode the next frame, and check if there is an error.
+			if(mad_frame_decode(&frame, &stream))
 			{
-				// Decode the next frame, and check if there is an error.
-				if(mad_frame_decode(&frame, &stream))
-				{
-					// For recoverable errors, keep going.
-					if(MAD_RECOVERABLE(stream.error))
-						continue;
-					else
-						break;
-				}
-				// Convert the decoded audio into a PCM signal.
-				mad_synth_frame(&synth, &frame);
-				
-				// If the source is mono, read both output channels from the left input.
-				// Otherwise, read two separate input channels.
-				mad_fixed_t *channels[2] = {
-					synth.pcm.samples[0],
-					synth.pcm.samples[synth.pcm.channels > 1]
-				};
+				// For recoverable errors, keep going.
+				if(MAD_RECOVERABLE(stream.error))
+					continue;
+				// Otherwise, this is the end of the input.
+				decoder->hasInput = false;
+				break;
+			}
+			// Convert the decoded audio into a PCM signal.
+			mad_synth_frame(&synth, &frame);
+			
+			// If the source is mono, read both output channels from the left input.
+			// Otherwise, read two separate input channels.
+			mad_fixed_t *channels[2] = {
+				synth.pcm.samples[0],
+				synth.pcm.samples[synth.pcm.channels > 1]
+			};
+			
+			// Hold the lock while writing, so that SetSource() can be sure no
+			// more of this file's data will be added once it has cleared the ring.
+			unique_lock<mutex> lock(decodeMutex);
+			if(done || hasNewFile)
+				break;
+			
+			// We'll alternate what channel we read from each time through the loop.
+			size_t write = writePosition.load(memory_order_relaxed);
+			int channel = 0;
+			for(unsigned i = 0; i < 2 * synth.pcm.length; ++i)
+			{
+				// Read the next sample from the next channel.
+				mad_fixed_t sample = *channels[channel]++;
+				channel = !channel;
 				
-				// For this part, we need access to the output buffer.
-				lock.lock();
-				if(done || hasNewFile)
-					break;
-	
-				// We'll alternate what channel we read from each time through the loop.
-				int channel = 0;
-				for(unsigned i = 0; i < 2 * synth.pcm.length; ++i)
-				{
-					// Read the next sample from the next channel.
-					mad_fixed_t sample = *channels[channel]++;
-					channel = !channel;
-		
-					// Clip and scale the sample to 16 bits.
-					sample += (1L << (MAD_F_FRACBITS - 16));
-					sample = max(-MAD_F_ONE, min(MAD_F_ONE - 1, sample));
-					next.push_back(sample >> (MAD_F_FRACBITS + 1 - 16));
-				}
-				// Now, the "next" buffer can be used by others. In theory, the
-				// NextChunk() function could take what's in that buffer while
-				// we are right in the middle of this decoding cycle.
-				lock.unlock();
+				// Clip and scale the sample to 16 bits.
+				sample += (1L << (MAD_F_FRACBITS - 16));
+				sample = max(-MAD_F_ONE, min(MAD_F_ONE - 1, sample));
+				ring[(write + i) & (RING_SIZE - 1)] = sample >> (MAD_F_FRACBITS + 1 - 16);
 			}
+			// Now, NextChunk() can take these samples, even while this task is
+			// still decoding the next frame.
+			writePosition.store(write + 2 * synth.pcm.length, memory_order_release);
 		}
-		
-		// Clean up.
+	}
+}
+
+
+
+Music::Decoder::Decoder()
+	: input(INPUT_CHUNK, 0)
+{
+}
+
+
+
+Music::Decoder::~Decoder()
+{
+	Close();
+}
+
+
+
+// Start decoding the given file, closing the previous one. If the file is null,
+// there is nothing more to decode.
+void Music::Decoder::Open(FILE *newFile)
+{
+	Close();
+	
+	// Now, we have a file to read. Initialize the decoder.
+	file = newFile;
+	if(file)
+	{
+		mad_stream_init(&stream);
+		mad_frame_init(&frame);
+		mad_synth_init(&synth);
+	}
+}
+
+
+
+// Start decoding the given data in memory instead.
+void Music::Decoder::Open(const shared_ptr<const vector<unsigned char>> &newData, bool loop)
+{
+	Close();
+	
+	data = newData;
+	isLooping = loop;
+	if(data)
+	{
+		mad_stream_init(&stream);
+		mad_frame_init(&frame);
+		mad_synth_init(&synth);
+	}
+}
+
+
+
+void Music::Decoder::Close()
+{
+	if(file || data)
+	{
 		mad_synth_finish(&synth);
 		mad_frame_finish(&frame);
 		mad_stream_finish(&stream);
-		fclose(file);
 	}
+	if(file)
+		fclose(file);
+	file = nullptr;
+	data.reset();
+	hasInput = false;
+	isStarted = false;
 }
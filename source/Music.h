@@ -13,12 +13,13 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #ifndef MUSIC_H_
 #define MUSIC_H_
 
+#include <atomic>
 #include <condition_variable>
 #include <cstdint>
 #include <cstdio>
+#include <memory>
 #include <mutex>
 #include <string>
-#include <thread>
 #include <vector>
 
 
@@ -26,8 +27,13 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 // The Music class streams mp3 audio from a file and delivers it to the program
 // on "block" at a time, so it never needs to hold the entire decoded file in
 // memory. Each block is 16-bit stereo, 44100 Hz. If no file is specified, or if
-// the decoding thread is not done yet, it returns silence rather than blocking,
-// so the game won't freeze if the music stops for some reason.
+// the decoder has not caught up yet, it returns silence rather than blocking,
+// so the game won't freeze if the music stops for some reason. The decoding is
+// done by tasks in the shared thread pool, which run only when more decoded
+// data is needed. The decoded samples go in a ring buffer that the decoder
+// writes to and NextChunk() reads from without locking. Instead of a file, the
+// source can also be an mp3 file that has been loaded into memory, which is how
+// long sound effects are streamed; such a source may play just once.
 class Music {
 public:
 	static void Init(const std::vector<std::string> &sources);
@@ -38,30 +44,59 @@ public:
 	~Music();
 	
 	void SetSource(const std::string &name = "");
+	// Decode the given mp3 data, which must end with MAD_BUFFER_GUARD zeros.
+	void SetSource(const std::shared_ptr<const std::vector<unsigned char>> &data, bool isLooping);
 	const std::vector<int16_t> &NextChunk();
+	// Check if a chunk is ready, i.e. if NextChunk() will not return silence.
+	bool HasChunk() const;
+	// Check if a source that does not loop has been played all the way through.
+	bool IsFinished() const;
 	
 	
 private:
-	// This is the entry point for the decoding thread.
+	// Start a decoding task, unless one is already running or none is needed.
+	void StartDecoding();
+	// Get how many decoded samples are waiting to be played.
+	size_t Buffered() const;
+	// Decode until enough data is queued up, or until told to switch files. This
+	// is what the decoding task runs.
 	void Decode();
 	
 	
 private:
+	// The state of the MP3 decoder, which must be remembered from one decoding
+	// task to the next.
+	class Decoder;
+	
 	// Buffers for storing the decoded audio sample. The "silence" buffer holds
 	// a block of silence to be returned if nothing was read from the file.
 	std::vector<int16_t> silence;
-	std::vector<int16_t> next;
 	std::vector<int16_t> current;
+	// The ring buffer of decoded samples. Each position counts up forever, and
+	// is wrapped around to an index in the ring when it is used. Only the
+	// decoding task advances the write position, and only the main thread
+	// advances the read position.
+	std::vector<int16_t> ring;
+	std::atomic<size_t> writePosition;
+	std::atomic<size_t> readPosition;
 	
 	std::string previousPath;
 	// This pointer holds the file for as long as it is owned by the main
-	// thread. When the decode thread takes possession of it, it sets this
-	// pointer to null.
+	// thread. When the decoder takes possession of it, it sets this pointer to
+	// null.
 	FILE *nextFile = nullptr;
-	bool hasNewFile = false;
+	std::shared_ptr<const std::vector<unsigned char>> nextData;
+	bool nextIsLooping = true;
+	std::atomic<bool> hasNewFile;
+	// Whether the decoder has a file to read from.
+	std::atomic<bool> hasFile;
+	// Whether a source that does not loop has been completely decoded.
+	std::atomic<bool> hasEnded;
 	bool done = false;
+	// Only one decoding task may run at a time.
+	std::atomic<bool> isDecoding;
 	
-	std::thread thread;
+	std::unique_ptr<Decoder> decoder;
 	std::mutex decodeMutex;
 	std::condition_variable condition;
 };
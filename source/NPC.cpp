@@ -21,6 +21,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Government.h"
 #include "Messages.h"
 #include "PlayerInfo.h"
+#include "PoolAllocator.h"
 #include "Random.h"
 #include "Ship.h"
 #include "ShipEvent.h"
@@ -109,6 +110,9 @@ void NPC::Load(const DataNode &node)
 		{
 			if(child.HasChildren())
 			{
+				// This is the NPC's definition, which may be part of the game
+				// data and live until the program exits. Only the copies of
+				// these ships that are actually placed come from the pool.
 				ships.push_back(make_shared<Ship>());
 				ships.back()->Load(child);
 				for(const DataNode &grand : child)
@@ -235,12 +239,12 @@ void NPC::Do(const ShipEvent &event, PlayerInfo &player, UI *ui, bool isVisible)
 			// displayed a second time below. 
 			if(event.Type() & ShipEvent::CAPTURE)
 			{
-				Ship *copy = new Ship(*ptr);
+				shared_ptr<Ship> copy = allocate_shared<Ship>(PoolAllocator<Ship>(), *ptr);
 				copy->Destroy();
-				actions[copy] = actions[ptr.get()];
+				actions[copy.get()] = actions[ptr.get()];
 				// Count this ship as destroyed, as well as captured.
 				type |= ShipEvent::DESTROY;
-				ptr.reset(copy);
+				ptr = copy;
 			}
 			ship = ptr;
 			break;
@@ -375,14 +379,14 @@ NPC NPC::Instantiate(map<string, string> &subs, const System *origin, const Syst
 	// Convert fleets into instances of ships.
 	for(const shared_ptr<Ship> &ship : ships)
 	{
-		result.ships.push_back(make_shared<Ship>(*ship));
+		result.ships.push_back(allocate_shared<Ship>(PoolAllocator<Ship>(), *ship));
 		result.ships.back()->FinishLoading();
 	}
 	auto shipIt = stockShips.begin();
 	auto nameIt = shipNames.begin();
 	for( ; shipIt != stockShips.end() && nameIt != shipNames.end(); ++shipIt, ++nameIt)
 	{
-		result.ships.push_back(make_shared<Ship>(**shipIt));
+		result.ships.push_back(allocate_shared<Ship>(PoolAllocator<Ship>(), **shipIt));
 		result.ships.back()->SetName(*nameIt);
 	}
 	for(const Fleet &fleet : fleets)
@@ -19,11 +19,21 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "SpriteSet.h"
 
 #include <cmath>
+#include <mutex>
 
 using namespace std;
 
 namespace {
 	static const double EPS = 0.0000000001;
+	
+	// Map from attribute names to IDs. This is filled in during static
+	// initialization and data loading, so access to it must be locked.
+	mutex idMutex;
+	map<string, int> &AttributeIDs()
+	{
+		static map<string, int> ids;
+		return ids;
+	}
 }
 
 const vector<string> Outfit::CATEGORIES = {
@@ -79,7 +89,7 @@ void Outfit::Load(const DataNode &node)
 		else if(child.Token(0) == "cost" && child.Size() >= 2)
 			cost = child.Value(1);
 		else if(child.Size() >= 2)
-			attributes[child.Token(0)] = child.Value(1);
+			Set(child.Token(0), child.Value(1));
 		else
 			child.PrintTrace("Skipping unrecognized attribute:");
 	}
@@ -131,13 +141,23 @@ double Outfit::Get(const string &attribute) const
 
 
 
-const map<string, double> &Outfit::Attributes() const
+const FlatMap<string, double> &Outfit::Attributes() const
 {
 	return attributes;
 }
 
 
 
+// Get the ID used to look up the given attribute quickly.
+int Outfit::AttributeID(const string &attribute)
+{
+	lock_guard<mutex> lock(idMutex);
+	map<string, int> &ids = AttributeIDs();
+	return ids.emplace(attribute, static_cast<int>(ids.size())).first->second;
+}
+
+
+
 // Determine whether the given number of instances of the given outfit can
 // be added to a ship with the attributes represented by this instance. If
 // not, return the maximum number that can be added.
@@ -156,6 +176,25 @@ int Outfit::CanAdd(const Outfit &other, int count) const
 
 
 
+// Do the same check as if the given number of some other outfit had been
+// removed first, without having to copy all these attributes to find out.
+int Outfit::CanAdd(const Outfit &other, int count, const Outfit &removed, int removedCount) const
+{
+	for(const auto &at : other.attributes)
+	{
+		// Round off the value the same way Add() would have.
+		double value = Get(at.first) - removed.Get(at.first) * removedCount;
+		if(fabs(value) < EPS)
+			value = 0.;
+		if(value + at.second * count < -EPS)
+			count = value / -at.second + EPS;
+	}
+	
+	return count;
+}
+
+
+
 // For tracking a combination of outfits in a ship: add the given number of
 // instances of the given outfit to this outfit.
 void Outfit::Add(const Outfit &other, int count)
@@ -163,10 +202,20 @@ void Outfit::Add(const Outfit &other, int count)
 	cost += other.cost * count;
 	for(const auto &at : other.attributes)
 	{
-		attributes[at.first] += at.second * count;
-		if(fabs(attributes[at.first]) < EPS)
-			attributes[at.first] = 0.;
+		double &value = attributes[at.first];
+		value += at.second * count;
+		if(fabs(value) < EPS)
+			value = 0.;
 	}
+	if(values.size() < other.values.size())
+		values.resize(other.values.size(), 0.);
+	for(size_t i = 0; i < other.values.size(); ++i)
+		if(other.values[i])
+		{
+			values[i] += other.values[i] * count;
+			if(fabs(values[i]) < EPS)
+				values[i] = 0.;
+		}
 	
 	for(const auto &it : other.flareSprites)
 	{
@@ -191,9 +240,8 @@ void Outfit::Add(const Outfit &other, int count)
 // Modify this outfit's attributes.
 void Outfit::Add(const string &attribute, double value)
 {
-	attributes[attribute] += value;
-	if(fabs(attributes[attribute]) < EPS)
-		attributes[attribute] = 0.;
+	value += Get(attribute);
+	Set(attribute, (fabs(value) < EPS) ? 0. : value);
 }
 
 
@@ -201,7 +249,7 @@ void Outfit::Add(const string &attribute, double value)
 // Modify this outfit's attributes.
 void Outfit::Reset(const string &attribute, double value)
 {
-	attributes[attribute] = value;
+	Set(attribute, value);
 }
 
 
@@ -234,3 +282,16 @@ const Sprite *Outfit::FlotsamSprite() const
 {
 	return flotsamSprite;
 }
+
+
+
+// Set an attribute, both in the map and in the array indexed by ID.
+void Outfit::Set(const string &attribute, double value)
+{
+	attributes[attribute] = value;
+	
+	size_t id = AttributeID(attribute);
+	if(values.size() <= id)
+		values.resize(id + 1, 0.);
+	values[id] = value;
+}
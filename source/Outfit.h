@@ -16,6 +16,8 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Body.h"
 #include "Weapon.h"
 
+#include "FlatMap.h"
+
 #include <map>
 #include <string>
 #include <utility>
@@ -53,12 +55,20 @@ public:
 	const Sprite *Thumbnail() const;
 	
 	double Get(const std::string &attribute) const;
-	const std::map<std::string, double> &Attributes() const;
+	const FlatMap<std::string, double> &Attributes() const;
+	// Attributes that are read every frame can instead be looked up by a
+	// numeric ID, which avoids searching through the map. Each name is given
+	// an ID the first time it is seen.
+	static int AttributeID(const std::string &attribute);
+	double Get(int id) const;
 	
 	// Determine whether the given number of instances of the given outfit can
 	// be added to a ship with the attributes represented by this instance. If
 	// not, return the maximum number that can be added.
 	int CanAdd(const Outfit &other, int count = 1) const;
+	// Do the same check as if the given number of some other outfit had been
+	// removed first, without having to copy all these attributes to find out.
+	int CanAdd(const Outfit &other, int count, const Outfit &removed, int removedCount) const;
 	// For tracking a combination of outfits in a ship: add the given number of
 	// instances of the given outfit to this outfit.
 	void Add(const Outfit &other, int count = 1);
@@ -75,6 +85,11 @@ public:
 	const Sprite *FlotsamSprite() const;
 	
 	
+private:
+	// Set an attribute, both in the map and in the array indexed by ID.
+	void Set(const std::string &attribute, double value);
+	
+	
 private:
 	std::string name;
 	std::string pluralName;
@@ -83,7 +98,9 @@ private:
 	const Sprite *thumbnail = nullptr;
 	int64_t cost = 0;
 	
-	std::map<std::string, double> attributes;
+	FlatMap<std::string, double> attributes;
+	// The same attribute values, indexed by attribute ID.
+	std::vector<double> values;
 	
 	std::vector<std::pair<Body, int>> flareSprites;
 	std::map<const Sound *, int> flareSounds;
@@ -95,6 +112,7 @@ private:
 
 // This gets called a lot, so inline it for speed.
 inline int64_t Outfit::Cost() const { return cost; }
+inline double Outfit::Get(int id) const { return static_cast<size_t>(id) < values.size() ? values[id] : 0.; }
 
 
 
@@ -79,6 +79,21 @@ void OutfitInfoDisplay::Update(const Outfit &outfit, const PlayerInfo &player, b
 	UpdateAttributes(outfit);
 	
 	maximumHeight = max(descriptionHeight, max(requirementsHeight, attributesHeight));
+	
+	shownOutfit = &outfit;
+	shownPlayer = &player;
+	shownCanSell = canSell;
+	isCurrent = true;
+}
+
+
+
+// Update this display only if it is showing something else, or if it has
+// been invalidated since it was last updated.
+void OutfitInfoDisplay::Show(const Outfit &outfit, const PlayerInfo &player, bool canSell)
+{
+	if(!isCurrent || &outfit != shownOutfit || &player != shownPlayer || canSell != shownCanSell)
+		Update(outfit, player, canSell);
 }
 
 
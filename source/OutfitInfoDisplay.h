@@ -34,6 +34,9 @@ public:
 	
 	// Call this every time the ship changes.
 	void Update(const Outfit &outfit, const PlayerInfo &player, bool canSell = false);
+	// Update this display only if it is showing something else, or if it has
+	// been invalidated since it was last updated.
+	void Show(const Outfit &outfit, const PlayerInfo &player, bool canSell = false);
 	
 	// Provided by ItemInfoDisplay:
 	// int PanelWidth();
@@ -57,6 +60,11 @@ private:
 	std::vector<std::string> requirementLabels;
 	std::vector<std::string> requirementValues;
 	int requirementsHeight = 0;
+	
+	// What this display was last updated with.
+	const Outfit *shownOutfit = nullptr;
+	const PlayerInfo *shownPlayer = nullptr;
+	bool shownCanSell = false;
 };
 
 
@@ -50,7 +50,7 @@ namespace {
 OutfitterPanel::OutfitterPanel(PlayerInfo &player)
 	: ShopPanel(player, true)
 {
-	for(const pair<string, Outfit> &it : GameData::Outfits())
+	for(const auto &it : GameData::Outfits())
 		catalog[it.second.Category()].insert(it.first);
 	
 	if(player.GetPlanet())
@@ -77,10 +77,10 @@ int OutfitterPanel::TileSize() const
 
 int OutfitterPanel::DrawPlayerShipInfo(const Point &point)
 {
-	shipInfo.Update(*playerShip, player.FleetDepreciation(), day);
-	shipInfo.DrawAttributes(point);
+	playerShipInfo.Show(*playerShip, player.FleetDepreciation(), day);
+	playerShipInfo.DrawAttributes(point);
 	
-	return shipInfo.AttributesHeight();
+	return playerShipInfo.AttributesHeight();
 }
 
 
@@ -119,7 +119,7 @@ void OutfitterPanel::DrawItem(const string &name, const Point &point, int scroll
 	int mapSize = outfit->Get("map");
 	
 	const Font &font = FontSet::Get(14);
-	const Color &bright = *GameData::Colors().Get("bright");
+	static const Color &bright = *GameData::Colors().Get("bright");
 	if(playerShip || isLicense || mapSize)
 	{
 		int minCount = numeric_limits<int>::max();
@@ -187,7 +187,7 @@ int OutfitterPanel::DetailWidth() const
 
 int OutfitterPanel::DrawDetails(const Point &center)
 {
-	outfitInfo.Update(*selectedOutfit, player, CanSell());
+	outfitInfo.Show(*selectedOutfit, player, CanSell());
 	Point offset(outfitInfo.PanelWidth(), 0.);
 	
 	outfitInfo.DrawDescription(center - offset * 1.5 - Point(0., 10.));
@@ -646,7 +646,7 @@ void OutfitterPanel::DrawKey()
 	Point off = Point(10., -.5 * font.Height());
 	SpriteShader::Draw(box[showForSale], pos);
 	font.Draw("Show outfits for sale", pos + off, color[showForSale]);
-	AddZone(Rectangle(pos + Point(80., 0.), Point(180., 20.)), [this](){ showForSale = !showForSale; });
+	AddZone(Rectangle(pos + Point(80., 0.), Point(180., 20.)), [this](){ showForSale = !showForSale; shownItemsAreCurrent = false; });
 	
 	bool showCargo = !playerShip;
 	pos.Y() += 20.;
@@ -692,11 +692,7 @@ bool OutfitterPanel::ShipCanSell(const Ship *ship, const Outfit *outfit)
 	// the ammo for it first.
 	const Outfit *ammo = outfit->Ammo();
 	if(ammo && ship->OutfitCount(ammo))
-	{
-		Outfit attributes = ship->Attributes();
-		attributes.Add(*ammo, -ship->OutfitCount(ammo));
-		return attributes.CanAdd(*outfit, -1);
-	}
+		return ship->Attributes().CanAdd(*outfit, -1, *ammo, ship->OutfitCount(ammo));
 	
 	// Now, check whether this ship can sell this outfit.
 	return ship->Attributes().CanAdd(*outfit, -1);
@@ -821,22 +817,26 @@ void OutfitterPanel::Refill()
 			if(it.GetOutfit() && it.GetOutfit()->Ammo())
 				toRefill.insert(it.GetOutfit()->Ammo());
 		
-		// This is slower than just calculating the proper number to add, but
-		// that does not matter because this is not so time-consuming anyways.
+		// Find out how much of each kind of ammo fits, then install as much of
+		// that as possible from cargo, and buy the rest.
 		for(const Outfit *outfit : toRefill)
-			while(ship->Attributes().CanAdd(*outfit) > 0)
+		{
+			int amount = ship->Attributes().CanAdd(*outfit, 1000000);
+			if(amount <= 0)
+				continue;
+			
+			int fromCargo = min(amount, player.Cargo().Get(outfit));
+			player.Cargo().Remove(outfit, fromCargo);
+			int bought = amount - fromCargo;
+			if(!outfitter.Has(outfit))
+				bought = min(bought, max(0, player.Stock(outfit)));
+			if(bought)
 			{
-				if(player.Cargo().Get(outfit))
-					player.Cargo().Remove(outfit);
-				else if(!(player.Stock(outfit) > 0 || outfitter.Has(outfit)))
-					break;
-				else
-				{
-					int64_t price = player.StockDepreciation().Value(outfit, day);
-					player.Accounts().AddCredits(-price);
-					player.AddStock(outfit, -1);
-				}
-				ship->AddOutfit(outfit, 1);
+				int64_t price = player.StockDepreciation().Value(outfit, day, bought);
+				player.Accounts().AddCredits(-price);
+				player.AddStock(outfit, -bought);
 			}
+			ship->AddOutfit(outfit, fromCargo + bought);
+		}
 	}
 }
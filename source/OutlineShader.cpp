@@ -17,18 +17,32 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Screen.h"
 #include "Shader.h"
 #include "Sprite.h"
+#include "StreamBuffer.h"
 
 using namespace std;
 
 namespace {
 	Shader shader;
 	GLint scaleI;
-	GLint transformI;
-	GLint positionI;
+	GLint layerI;
+	
+	GLint vertI;
+	GLint vertTexCoordI;
+	GLint offI;
 	GLint colorI;
 	
 	GLuint vao;
-	GLuint vbo;
+	
+	// Each vertex holds its position in screen coordinates, its texture
+	// coordinates, the size of one pixel in texture coordinates, and the color.
+	const int FLOATS = 10;
+	
+	void Attrib(GLint index, int size, int offset, GLintptr start)
+	{
+		glEnableVertexAttribArray(index);
+		glVertexAttribPointer(index, size, GL_FLOAT, GL_FALSE, FLOATS * sizeof(GLfloat),
+			(const GLvoid*)(start + offset * sizeof(GLfloat)));
+	}
 }
 
 
@@ -36,25 +50,27 @@ namespace {
 void OutlineShader::Init()
 {
 	static const char *vertexCode =
-		"uniform mat2 transform;\n"
-		"uniform vec2 position;\n"
 		"uniform vec2 scale;\n"
 		"in vec2 vert;\n"
 		"in vec2 vertTexCoord;\n"
+		"in vec2 offset;\n"
+		"in vec4 color;\n"
 		"out vec2 tc;\n"
-		"out vec2 off;\n"
+		"flat out vec2 off;\n"
+		"flat out vec4 outlineColor;\n"
 		"void main() {\n"
 		"  tc = vertTexCoord;\n"
-		"  mat2 sq = matrixCompMult(transform, transform);\n"
-		"  off = vec2(.5 / sqrt(sq[0][0] + sq[0][1]), .5 / sqrt(sq[1][0] + sq[1][1]));\n"
-		"  gl_Position = vec4((transform * vert + position) * scale, 0, 1);\n"
+		"  off = offset;\n"
+		"  outlineColor = color;\n"
+		"  gl_Position = vec4(vert * scale, 0, 1);\n"
 		"}\n";
 
 	static const char *fragmentCode =
-		"uniform sampler2D tex;\n"
-		"uniform vec4 color = vec4(1, 1, 1, 1);\n"
+		"uniform sampler2DArray tex;\n"
+		"uniform float layer;\n"
 		"in vec2 tc;\n"
-		"in vec2 off;\n"
+		"flat in vec2 off;\n"
+		"flat in vec4 outlineColor;\n"
 		"out vec4 finalColor;\n"
 		"void main() {\n"
 		"  float sum = 0;\n"
@@ -63,88 +79,89 @@ void OutlineShader::Init()
 		"    for(int dx = -1; dx <= 1; ++dx)\n"
 		"    {\n"
 		"      vec2 d = vec2(.618 * dx * off.x, .618 * dy * off.y);\n"
-		"      float ae = texture(tex, d + vec2(tc.x - off.x, tc.y)).a;\n"
-		"      float aw = texture(tex, d + vec2(tc.x + off.x, tc.y)).a;\n"
-		"      float an = texture(tex, d + vec2(tc.x, tc.y - off.y)).a;\n"
-		"      float as = texture(tex, d + vec2(tc.x, tc.y + off.y)).a;\n"
-		"      float ane = texture(tex, d + vec2(tc.x - off.x, tc.y - off.y)).a;\n"
-		"      float anw = texture(tex, d + vec2(tc.x + off.x, tc.y - off.y)).a;\n"
-		"      float ase = texture(tex, d + vec2(tc.x - off.x, tc.y + off.y)).a;\n"
-		"      float asw = texture(tex, d + vec2(tc.x + off.x, tc.y + off.y)).a;\n"
+		"      float ae = texture(tex, vec3(d + vec2(tc.x - off.x, tc.y), layer)).a;\n"
+		"      float aw = texture(tex, vec3(d + vec2(tc.x + off.x, tc.y), layer)).a;\n"
+		"      float an = texture(tex, vec3(d + vec2(tc.x, tc.y - off.y), layer)).a;\n"
+		"      float as = texture(tex, vec3(d + vec2(tc.x, tc.y + off.y), layer)).a;\n"
+		"      float ane = texture(tex, vec3(d + vec2(tc.x - off.x, tc.y - off.y), layer)).a;\n"
+		"      float anw = texture(tex, vec3(d + vec2(tc.x + off.x, tc.y - off.y), layer)).a;\n"
+		"      float ase = texture(tex, vec3(d + vec2(tc.x - off.x, tc.y + off.y), layer)).a;\n"
+		"      float asw = texture(tex, vec3(d + vec2(tc.x + off.x, tc.y + off.y), layer)).a;\n"
 		"      float h = (ae * 2 + ane + ase) - (aw * 2 + anw + asw);\n"
 		"      float v = (an * 2 + ane + anw) - (as * 2 + ase + asw);\n"
 		"      sum += h * h + v * v;\n"
 		"    }\n"
 		"  }\n"
-		"  finalColor = color * sqrt(sum / 144);\n"
+		"  finalColor = outlineColor * sqrt(sum / 144);\n"
 		"}\n";
 	
 	shader = Shader(vertexCode, fragmentCode);
 	scaleI = shader.Uniform("scale");
-	transformI = shader.Uniform("transform");
-	positionI = shader.Uniform("position");
-	colorI = shader.Uniform("color");
+	layerI = shader.Uniform("layer");
+	
+	vertI = shader.Attrib("vert");
+	vertTexCoordI = shader.Attrib("vertTexCoord");
+	offI = shader.Attrib("offset");
+	colorI = shader.Attrib("color");
 	
 	glUniform1ui(shader.Uniform("tex"), 0);
 	
-	// Generate the vertex data for drawing sprites.
+	// The vertex data is streamed in each time an outline is drawn, so the VAO
+	// only needs to remember which attributes are enabled.
 	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-	
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	
-	GLfloat vertexData[] = {
-		-.5f, -.5f, 0.f, 0.f,
-		 .5f, -.5f, 1.f, 0.f,
-		-.5f,  .5f, 0.f, 1.f,
-		 .5f,  .5f, 1.f, 1.f
-	};
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertexData), vertexData, GL_STATIC_DRAW);
-	
-	glEnableVertexAttribArray(shader.Attrib("vert"));
-	glVertexAttribPointer(shader.Attrib("vert"), 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), nullptr);
-	
-	glEnableVertexAttribArray(shader.Attrib("vertTexCoord"));
-	glVertexAttribPointer(shader.Attrib("vertTexCoord"), 2, GL_FLOAT, GL_TRUE,
-		4 * sizeof(GLfloat), (const GLvoid*)(2 * sizeof(GLfloat)));
-	
-	// unbind the VBO and VAO
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
 }
 
 
 
 void OutlineShader::Draw(const Sprite *sprite, const Point &pos, const Point &size, const Color &color, const Point &unit, int frame)
 {
-	glUseProgram(shader.Object());
-	glBindVertexArray(vao);
-	glActiveTexture(GL_TEXTURE0);
-	
-	GLfloat scale[2] = {2.f / Screen::Width(), -2.f / Screen::Height()};
-	glUniform2fv(scaleI, 1, scale);
+	static const GLfloat CORNERS[8] = {
+		-.5f, -.5f,
+		 .5f, -.5f,
+		-.5f,  .5f,
+		 .5f,  .5f
+	};
 	
 	Point uw = unit * size.X();
 	Point uh = unit * size.Y();
-	GLfloat transform[4] = {
-		static_cast<float>(-uw.Y()),
-		static_cast<float>(uw.X()),
-		static_cast<float>(-uh.X()),
-		static_cast<float>(-uh.Y())
+	Point column[2] = {Point(-uw.Y(), uw.X()), Point(-uh.X(), -uh.Y())};
+	GLfloat off[2] = {
+		static_cast<float>(.5 / column[0].Length()),
+		static_cast<float>(.5 / column[1].Length())
 	};
-	glUniformMatrix2fv(transformI, 1, false, transform);
-	
-	GLfloat position[2] = {
-		static_cast<float>(pos.X()), static_cast<float>(pos.Y())};
-	glUniform2fv(positionI, 1, position);
+	const float *c = color.Get();
+	
+	GLfloat vertices[4 * FLOATS];
+	GLfloat *it = vertices;
+	for(int i = 0; i < 8; i += 2)
+	{
+		Point corner = pos + CORNERS[i] * column[0] + CORNERS[i + 1] * column[1];
+		*it++ = corner.X();
+		*it++ = corner.Y();
+		*it++ = CORNERS[i] + .5f;
+		*it++ = CORNERS[i + 1] + .5f;
+		*it++ = off[0];
+		*it++ = off[1];
+		for(int j = 0; j < 4; ++j)
+			*it++ = c[j];
+	}
+	
+	shader.Use();
+	Shader::BindVertexArray(vao);
+	glActiveTexture(GL_TEXTURE0);
 	
-	glUniform4fv(colorI, 1, color.Get());
+	GLfloat scale[2] = {2.f / Screen::Width(), -2.f / Screen::Height()};
+	glUniform2fv(scaleI, 1, scale);
 	
-	glBindTexture(GL_TEXTURE_2D, sprite->Texture(frame));
+	glUniform1f(layerI, sprite->Layer(frame));
+	glBindTexture(GL_TEXTURE_2D_ARRAY, sprite->Texture());
 	
+	GLintptr start = StreamBuffer::Upload(vertices, sizeof(vertices));
+	Attrib(vertI, 2, 0, start);
+	Attrib(vertTexCoordI, 2, 2, start);
+	Attrib(offI, 2, 4, start);
+	Attrib(colorI, 4, 6, start);
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 	
-	glBindVertexArray(0);
-	glUseProgram(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
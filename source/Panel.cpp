@@ -72,6 +72,15 @@ bool Panel::IsInterruptible() const
 
 
 
+// Return true if this panel only looks different after an event, or after a
+// panel is pushed or popped.
+bool Panel::IsStatic() const
+{
+	return isStatic;
+}
+
+
+
 // Clear the list of clickable zones.
 void Panel::ClearZones()
 {
@@ -186,6 +195,13 @@ void Panel::SetInterruptible(bool set)
 }
 
 
+
+void Panel::SetIsStatic(bool set)
+{
+	isStatic = set;
+}
+
+
 	
 // Dim the background of this panel.
 void Panel::DrawBackdrop() const
@@ -49,6 +49,10 @@ public:
 	bool TrapAllEvents();
 	// Check if this panel can be "interrupted" to return to the main menu.
 	bool IsInterruptible() const;
+	// Return true if this panel only looks different after an event, or after
+	// a panel is pushed or popped. If every panel being drawn is static, the
+	// last frame is left on the screen until one of those things happens.
+	bool IsStatic() const;
 	
 	// Clear the list of clickable zones.
 	void ClearZones();
@@ -76,6 +80,7 @@ protected:
 	void SetIsFullScreen(bool set);
 	void SetTrapAllEvents(bool set);
 	void SetInterruptible(bool set);
+	void SetIsStatic(bool set);
 	
 	// Dim the background of this panel.
 	void DrawBackdrop() const;
@@ -118,6 +123,7 @@ private:
 	bool isFullScreen = false;
 	bool trapAllEvents = true;
 	bool isInterruptible = true;
+	bool isStatic = false;
 	
 	std::list<Zone> zones;
 	
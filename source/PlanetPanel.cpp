@@ -27,6 +27,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Planet.h"
 #include "PlayerInfo.h"
 #include "PlayerInfoPanel.h"
+#include "Replay.h"
 #include "Ship.h"
 #include "ShipyardPanel.h"
 #include "SpaceportPanel.h"
@@ -50,6 +51,9 @@ PlanetPanel::PlanetPanel(PlayerInfo &player, function<void()> callback)
 	spaceport.reset(new SpaceportPanel(player));
 	hiring.reset(new HiringPanel(player));
 	
+	// Nothing on the planet screen changes unless the player does something.
+	SetIsStatic(true);
+	
 	text.SetFont(FontSet::Get(14));
 	text.SetAlignment(WrappedText::JUSTIFIED);
 	text.SetWrapWidth(480);
@@ -314,6 +318,7 @@ void PlanetPanel::TakeOffIfReady()
 void PlanetPanel::TakeOff()
 {
 	player.Save();
+	Replay::Begin(player);
 	if(player.TakeOff(GetUI()))
 	{
 		if(callback)
@@ -28,13 +28,18 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Person.h"
 #include "Planet.h"
 #include "Politics.h"
+#include "PoolAllocator.h"
+#include "Preferences.h"
 #include "Random.h"
+#include "SaveJournal.h"
 #include "SavedGame.h"
 #include "Ship.h"
 #include "ShipEvent.h"
+#include "Sprite.h"
 #include "StartConditions.h"
 #include "StellarObject.h"
 #include "System.h"
+#include "ThreadPool.h"
 #include "UI.h"
 
 #include <algorithm>
@@ -43,6 +48,30 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 using namespace std;
 
+namespace {
+	// Each change to any player's knowledge gets a new version number, so that
+	// a version is never reused even if the player is cleared or reloaded.
+	int lastKnowledgeVersion = 0;
+	
+	// Set or check the bit for the given system. Systems are only ever given
+	// an index by GameData, so a system without one is never set.
+	void SetBit(vector<bool> &bits, const System *system, bool value = true)
+	{
+		int index = system->Index();
+		if(index < 0)
+			return;
+		if(static_cast<size_t>(index) >= bits.size())
+			bits.resize(index + 1, false);
+		bits[index] = value;
+	}
+	
+	bool HasBit(const vector<bool> &bits, const System *system)
+	{
+		size_t index = system->Index();
+		return (index < bits.size() && bits[index]);
+	}
+}
+
 
 
 // Completely clear all loaded information, to prepare for loading a file or
@@ -102,7 +131,7 @@ void PlayerInfo::Load(const string &path)
 	Clear();
 	
 	filePath = path;
-	DataFile file(path);
+	DataFile file = SaveJournal::Load(path);
 	
 	hasFullClearance = false;
 	for(const DataNode &child : file)
@@ -220,16 +249,23 @@ void PlayerInfo::Load(const string &path)
 		else if(child.Token(0) == "ship")
 		{
 			// Ships owned by the player have various special characteristics:
-			ships.push_back(shared_ptr<Ship>(new Ship()));
+			ships.push_back(allocate_shared<Ship>(PoolAllocator<Ship>()));
 			ships.back()->Load(child);
 			ships.back()->SetIsSpecial();
 			ships.back()->SetGovernment(GameData::PlayerGovernment());
-			ships.back()->FinishLoading();
-			ships.back()->SetIsYours();
 		}
 		else if(child.Token(0) == "groups" && child.Size() >= 2 && !ships.empty())
 			groups[ships.back().get()] = child.Value(1);
 	}
+	// Reading the ships may refer to game data that has not been defined, which
+	// adds it to the game data, so that must be done one ship at a time. But the
+	// player's ships do not have parents until they take off, so each one can
+	// be finished independently of the others.
+	ThreadPool::Shared().ParallelFor(ships.size(), [this](size_t i)
+	{
+		ships[i]->FinishLoading();
+		ships[i]->SetIsYours();
+	});
 	// Based on the ships that were loaded, calculate the player's capacity for
 	// cargo and passengers.
 	UpdateCargoCapacities();
@@ -288,26 +324,35 @@ void PlayerInfo::Save() const
 	// Remember that this was the most recently saved player.
 	Files::Write(Files::Config() + "recent.txt", filePath + '\n');
 	
+	function<void()> backup;
 	if(filePath.rfind(".txt") == filePath.length() - 4)
 	{
-		// Only update the backups if this save will have a newer date.
+		// Only update the backups if this save will have a newer date. If an
+		// earlier save is still being written, wait for it before checking.
+		DataWriter::FinishSaving();
 		SavedGame saved(filePath);
 		if(saved.GetDate() != date.ToString())
 		{
+			// Copying the backups is slow for big saves, so do it in the same
+			// background thread that writes the new file.
 			string root = filePath.substr(0, filePath.length() - 4);
-			string files[4] = {
-				root + "~~previous-3.txt",
-				root + "~~previous-2.txt",
-				root + "~~previous-1.txt",
-				filePath
+			string path = filePath;
+			backup = [root, path]()
+			{
+				string files[4] = {
+					root + "~~previous-3.txt",
+					root + "~~previous-2.txt",
+					root + "~~previous-1.txt",
+					path
+				};
+				for(int i = 0; i < 3; ++i)
+					if(Files::Exists(files[i + 1]))
+						Files::Copy(files[i + 1], files[i]);
 			};
-			for(int i = 0; i < 3; ++i)
-				if(Files::Exists(files[i + 1]))
-					Files::Copy(files[i + 1], files[i]);
 		}
 	}
 		
-	Save(filePath);
+	Save(filePath, backup);
 }
 
 
@@ -390,7 +435,8 @@ void PlayerInfo::ApplyChanges()
 	
 	// Check which planets you have dominated.
 	static const string prefix = "tribute: ";
-	for(auto it = conditions.lower_bound(prefix); it != conditions.end(); ++it)
+	const ConditionsStore &tributes = conditions;
+	for(auto it = tributes.lower_bound(prefix); it != tributes.end(); ++it)
 	{
 		if(it->first.compare(0, prefix.length(), prefix))
 			break;
@@ -409,24 +455,20 @@ void PlayerInfo::ApplyChanges()
 // Apply the given set of changes to the game data.
 void PlayerInfo::AddChanges(list<DataNode> &changes)
 {
-	bool changedSystems = false;
-	for(const DataNode &change : changes)
-	{
-		changedSystems |= (change.Token(0) == "system");
-		changedSystems |= (change.Token(0) == "link");
-		changedSystems |= (change.Token(0) == "unlink");
-		GameData::Change(change);
-	}
+	bool changedSystems = GameData::Change(changes);
 	if(changedSystems)
 	{
-		// Recalculate what systems have been seen.
-		GameData::UpdateNeighbors();
-		seen.clear();
+		// Recalculate what systems have been seen. The systems may also have
+		// been given new indices, so start over from the list of visits.
+		knowledgeVersion = ++lastKnowledgeVersion;
+		isSeen.clear();
+		isVisited.clear();
 		for(const System *system : visitedSystems)
 		{
-			seen.insert(system);
+			SetBit(isSeen, system);
+			SetBit(isVisited, system);
 			for(const System *neighbor : system->Neighbors())
-				seen.insert(neighbor);
+				SetBit(isSeen, neighbor);
 		}
 	}
 	
@@ -521,9 +563,9 @@ const Date &PlayerInfo::GetDate() const
 void PlayerInfo::IncrementDate()
 {
 	++date;
-	conditions["day"] = date.Day();
-	conditions["month"] = date.Month();
-	conditions["year"] = date.Year();
+	conditions.Set("day", date.Day());
+	conditions.Set("month", date.Month());
+	conditions.Set("year", date.Year());
 	
 	// Check if any special events should happen today.
 	auto it = gameEvents.begin();
@@ -546,10 +588,11 @@ void PlayerInfo::IncrementDate()
 	// Check what salaries and tribute the player receives.
 	int total[2] = {0, 0};
 	static const string prefix[2] = {"salary: ", "tribute: "};
+	const ConditionsStore &income = conditions;
 	for(int i = 0; i < 2; ++i)
 	{
-		auto it = conditions.lower_bound(prefix[i]);
-		for( ; it != conditions.end() && !it->first.compare(0, prefix[i].length(), prefix[i]); ++it)
+		auto it = income.lower_bound(prefix[i]);
+		for( ; it != income.end() && !it->first.compare(0, prefix[i].length(), prefix[i]); ++it)
 			total[i] += it->second;
 	}
 	if(total[0] || total[1])
@@ -747,7 +790,7 @@ void PlayerInfo::BuyShip(const Ship *model, const string &name)
 	int64_t cost = stockDepreciation.Value(*model, day);
 	if(model && accounts.Credits() >= cost)
 	{
-		ships.push_back(shared_ptr<Ship>(new Ship(*model)));
+		ships.push_back(allocate_shared<Ship>(PoolAllocator<Ship>(), *model));
 		ships.back()->SetName(name);
 		ships.back()->SetSystem(system);
 		ships.back()->SetPlanet(planet);
@@ -1077,7 +1120,7 @@ bool PlayerInfo::TakeOff(UI *ui)
 			it.second.GetShip()->SetSystem(nullptr);
 	
 	// Store the total cargo counts in case we need to adjust cost bases below.
-	map<string, int> originalTotals = cargo.Commodities();
+	FlatMap<string, int> originalTotals = cargo.Commodities();
 	
 	// Move the flagship to the start of your list of ships. It does not make
 	// sense that the flagship would change if you are reunited with a different
@@ -1529,7 +1572,7 @@ int PlayerInfo::GetCondition(const string &name) const
 
 
 // Get mutable access to the player's list of conditions.
-map<string, int> &PlayerInfo::Conditions()
+ConditionsStore &PlayerInfo::Conditions()
 {
 	return conditions;
 }
@@ -1537,7 +1580,7 @@ map<string, int> &PlayerInfo::Conditions()
 
 
 // Access the player's list of conditions.
-const map<string, int> &PlayerInfo::Conditions() const
+const ConditionsStore &PlayerInfo::Conditions() const
 {
 	return conditions;
 }
@@ -1551,7 +1594,7 @@ void PlayerInfo::SetReputationConditions()
 	for(const auto &it : GameData::Governments())
 	{
 		int rep = it.second.Reputation();
-		conditions["reputation: " + it.first] = rep;
+		conditions.Set("reputation: " + it.first, rep);
 	}
 }
 
@@ -1562,7 +1605,7 @@ void PlayerInfo::CheckReputationConditions()
 	for(const auto &it : GameData::Governments())
 	{
 		int rep = it.second.Reputation();
-		int newRep = conditions["reputation: " + it.first];
+		int newRep = GetCondition("reputation: " + it.first);
 		if(newRep != rep)
 			it.second.AddReputation(newRep - rep);
 	}
@@ -1594,7 +1637,7 @@ bool PlayerInfo::HasSeen(const System *system) const
 				return true;
 	}
 	
-	return (seen.count(system) || KnowsName(system));
+	return (HasBit(isSeen, system) || KnowsName(system));
 }
 
 
@@ -1604,7 +1647,7 @@ bool PlayerInfo::HasVisited(const System *system) const
 {
 	if(!system)
 		return false;
-	return visitedSystems.count(system);
+	return HasBit(isVisited, system);
 }
 
 
@@ -1639,16 +1682,28 @@ bool PlayerInfo::KnowsName(const System *system) const
 
 
 
+// Get a number that changes whenever the player visits or unvisits any
+// system or planet, or the map changes what they have seen. This does not
+// include what is revealed by missions.
+int PlayerInfo::KnowledgeVersion() const
+{
+	return knowledgeVersion;
+}
+
+
+
 // Mark the given system as visited, and mark all its neighbors as seen.
 void PlayerInfo::Visit(const System *system)
 {
 	if(!system)
 		return;
 	
+	knowledgeVersion = ++lastKnowledgeVersion;
 	visitedSystems.insert(system);
-	seen.insert(system);
+	SetBit(isVisited, system);
+	SetBit(isSeen, system);
 	for(const System *neighbor : system->Neighbors())
-		seen.insert(neighbor);
+		SetBit(isSeen, neighbor);
 }
 
 
@@ -1657,7 +1712,10 @@ void PlayerInfo::Visit(const System *system)
 void PlayerInfo::Visit(const Planet *planet)
 {
 	if(planet && !planet->TrueName().empty())
+	{
+		knowledgeVersion = ++lastKnowledgeVersion;
 		visitedPlanets.insert(planet);
+	}
 }
 
 
@@ -1668,7 +1726,9 @@ void PlayerInfo::Unvisit(const System *system)
 	if(!system)
 		return;
 	
+	knowledgeVersion = ++lastKnowledgeVersion;
 	visitedSystems.erase(system);
+	SetBit(isVisited, system, false);
 	for(const StellarObject &object : system->Objects())
 		if(object.GetPlanet())
 			Unvisit(object.GetPlanet());
@@ -1681,6 +1741,7 @@ void PlayerInfo::Unvisit(const Planet *planet)
 	if(!planet)
 		return;
 	
+	knowledgeVersion = ++lastKnowledgeVersion;
 	visitedPlanets.erase(planet);
 }
 
@@ -2022,23 +2083,34 @@ void PlayerInfo::UpdateAutoConditions()
 {
 	// Set a condition for the player's net worth. Limit it to the range of a 32-bit int.
 	static const int64_t limit = 2000000000;
-	conditions["net worth"] = min(limit, max(-limit, accounts.NetWorth()));
+	conditions.Set("net worth", min(limit, max(-limit, accounts.NetWorth())));
 	SetReputationConditions();
-	// Clear any existing ships: conditions. (Note: '!' = ' ' + 1.)
-	auto first = conditions.lower_bound("ships: ");
-	auto last = conditions.lower_bound("ships:!");
-	if(first != last)
-		conditions.erase(first, last);
-	// Store special conditions for cargo and passenger space.
-	conditions["cargo space"] = 0;
-	conditions["passenger space"] = 0;
+	// Count up the cargo and passenger space and the ships of each category.
+	// Only the conditions whose values are different are changed, so that
+	// condition sets that depend on them do not need to be tested again.
+	int cargoSpace = 0;
+	int passengerSpace = 0;
+	map<string, int> shipCount;
 	for(const shared_ptr<Ship> &ship : ships)
 		if(!ship->IsParked() && !ship->IsDisabled() && ship->GetSystem() == system)
 		{
-			conditions["cargo space"] += ship->Attributes().Get("cargo space");
-			conditions["passenger space"] += ship->Attributes().Get("bunks") - ship->RequiredCrew();
-			++conditions["ships: " + ship->Attributes().Category()];
+			cargoSpace += ship->Attributes().Get("cargo space");
+			passengerSpace += ship->Attributes().Get("bunks") - ship->RequiredCrew();
+			++shipCount["ships: " + ship->Attributes().Category()];
 		}
+	conditions.Set("cargo space", cargoSpace);
+	conditions.Set("passenger space", passengerSpace);
+	// Clear any ships: conditions for categories the player no longer has.
+	// (Note: '!' = ' ' + 1.)
+	const ConditionsStore &current = conditions;
+	vector<string> cleared;
+	for(auto it = current.lower_bound("ships: "); it != current.end() && it->first < "ships:!"; ++it)
+		if(!shipCount.count(it->first))
+			cleared.push_back(it->first);
+	for(const string &name : cleared)
+		conditions.erase(name);
+	for(const auto &it : shipCount)
+		conditions.Set(it.first, it.second);
 }
 
 
@@ -2051,25 +2123,50 @@ void PlayerInfo::CreateMissions()
 	
 	// Check for available missions.
 	bool skipJobs = planet && !planet->HasSpaceport();
+	// Only the missions that could possibly be offered here need to be checked.
+	vector<const Mission *> candidates;
+	for(const Mission *mission : GameData::MissionsOffered(planet))
+		if(!skipJobs || !mission->IsAtLocation(Mission::JOB))
+			candidates.push_back(mission);
+	
+	// Checking whether a mission can be offered only reads from the player, so
+	// the missions are checked in parallel. Anything that would be looked up
+	// and remembered the first time it is needed must be looked up before the
+	// threads begin. As in AI, the batches do not depend on the number of
+	// threads, and each gets its own random seed, for conditions that use
+	// "random."
+	FlagshipPtr();
+	conditions.ResolveAll();
+	static const size_t BATCH_SIZE = 16;
+	size_t batches = (candidates.size() + BATCH_SIZE - 1) / BATCH_SIZE;
+	vector<char> canOffer(candidates.size(), false);
+	uint64_t seed = Random::NewSeed();
+	const PlayerInfo &player = *this;
+	ThreadPool::Shared().ParallelFor(batches, [&candidates, &canOffer, &player, seed](size_t batch)
+	{
+		Random::Seed(seed, batch);
+		size_t end = min(candidates.size(), (batch + 1) * BATCH_SIZE);
+		for(size_t i = batch * BATCH_SIZE; i < end; ++i)
+			canOffer[i] = candidates[i]->CanOffer(player);
+	});
+	Random::Seed(seed, batches);
+	
+	// Create the missions that can be offered, in the same order as always.
 	bool hasPriorityMissions = false;
-	for(const auto &it : GameData::Missions())
+	for(size_t i = 0; i < candidates.size(); ++i)
 	{
-		if(it.second.IsAtLocation(Mission::BOARDING) || it.second.IsAtLocation(Mission::ASSISTING))
-			continue;
-		if(skipJobs && it.second.IsAtLocation(Mission::JOB))
+		if(!canOffer[i])
 			continue;
 		
-		if(it.second.CanOffer(*this))
-		{
-			list<Mission> &missions =
-				it.second.IsAtLocation(Mission::JOB) ? availableJobs : availableMissions;
-			
-			missions.push_back(it.second.Instantiate(*this));
-			if(missions.back().HasFailed(*this))
-				missions.pop_back();
-			else if(!it.second.IsAtLocation(Mission::JOB))
-				hasPriorityMissions |= missions.back().HasPriority();
-		}
+		const Mission &mission = *candidates[i];
+		list<Mission> &missions =
+			mission.IsAtLocation(Mission::JOB) ? availableJobs : availableMissions;
+		
+		missions.push_back(mission.Instantiate(*this));
+		if(missions.back().HasFailed(*this))
+			missions.pop_back();
+		else if(!mission.IsAtLocation(Mission::JOB))
+			hasPriorityMissions |= missions.back().HasPriority();
 	}
 	
 	// If any of the available missions are "priority" missions, no other
@@ -2112,18 +2209,27 @@ void PlayerInfo::Autosave() const
 	if(filePath.length() < 4)
 		return;
 	
+	// Autosaves can happen often, so only the changes are written each time.
 	string path = filePath.substr(0, filePath.length() - 4) + "~autosave.txt";
-	Save(path);
+	Save(path, function<void()>(), true);
 }
 
 
 
-void PlayerInfo::Save(const string &path) const
+// Save to the given path in the background. If a function is given, it is
+// called in the background just before the file is written.
+void PlayerInfo::Save(const string &path, function<void()> beforeSaving, bool isJournaled) const
 {
 	if(!planet || !system)
 		return;
 	
 	DataWriter out(path);
+	if(Preferences::Has("Compress saved games"))
+		out.EnableCompression();
+	if(Preferences::Has("Binary saved games"))
+		out.EnableBinary();
+	else if(isJournaled)
+		out.EnableJournal();
 	
 	out.Write("pilot", firstName, lastName);
 	out.Write("date", date.Day(), date.Month(), date.Year());
@@ -2138,6 +2244,21 @@ void PlayerInfo::Save(const string &path) const
 	if(travelDestination)
 		out.Write("travel destination", travelDestination->TrueName());
 	
+	// Summarize what the "load game" panel shows, so that it only needs to read
+	// this far into the file.
+	out.Write("summary");
+	out.BeginChild();
+	{
+		out.Write("credits", accounts.Credits());
+		if(!ships.empty())
+		{
+			out.Write("ship name", ships.front()->Name());
+			if(ships.front()->GetSprite())
+				out.Write("ship sprite", ships.front()->GetSprite()->Name());
+		}
+	}
+	out.EndChild();
+	
 	out.Write("reputation with");
 	out.BeginChild();
 	{
@@ -2274,6 +2395,10 @@ void PlayerInfo::Save(const string &path) const
 	for(const Planet *planet : visitedPlanets)
 		if(!planet->TrueName().empty())
 			out.Write("visited planet", planet->TrueName());
+	
+	// Everything has been written into memory, so the game can go on changing
+	// the player's state while the file is saved to disk.
+	out.SaveInBackground(beforeSaving);
 }
 
 
@@ -15,12 +15,14 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 #include "Account.h"
 #include "CargoHold.h"
+#include "ConditionsStore.h"
 #include "Date.h"
 #include "Depreciation.h"
 #include "GameEvent.h"
 #include "Mission.h"
 #include "Planet.h"
 
+#include <functional>
 #include <list>
 #include <map>
 #include <memory>
@@ -66,6 +68,10 @@ public:
 	void LoadRecent();
 	// Save this player (using the Identifier() as the file name).
 	void Save() const;
+	// Save to the given path in the background. If a function is given, it is
+	// called in the background just before the file is written. A journaled
+	// save only appends what changed since the last save (see SaveJournal).
+	void Save(const std::string &path, std::function<void()> beforeSaving = std::function<void()>(), bool isJournaled = false) const;
 	
 	// Get the root filename used for this player's saved game files. (If there
 	// are multiple pilots with the same name it may have a digit appended.)
@@ -165,8 +171,8 @@ public:
 	
 	// Access the "condition" flags for this player.
 	int GetCondition(const std::string &name) const;
-	std::map<std::string, int> &Conditions();
-	const std::map<std::string, int> &Conditions() const;
+	ConditionsStore &Conditions();
+	const ConditionsStore &Conditions() const;
 	// Set and check the reputation conditions, which missions can use to modify
 	// the player's reputation.
 	void SetReputationConditions();
@@ -177,6 +183,10 @@ public:
 	bool HasVisited(const System *system) const;
 	bool HasVisited(const Planet *planet) const;
 	bool KnowsName(const System *system) const;
+	// Get a number that changes whenever the player visits or unvisits any
+	// system or planet, or the map changes what they have seen. This does not
+	// include what is revealed by missions.
+	int KnowledgeVersion() const;
 	void Visit(const System *system);
 	void Visit(const Planet *planet);
 	// Mark a system and its planets as unvisited, even if visited previously.
@@ -239,7 +249,6 @@ private:
 	void UpdateAutoConditions();
 	void CreateMissions();
 	void Autosave() const;
-	void Save(const std::string &path) const;
 	
 	// Helper function to update the ship selection.
 	void SelectShip(const std::shared_ptr<Ship> &ship, bool *first);
@@ -275,11 +284,15 @@ private:
 	std::shared_ptr<Ship> boardingShip;
 	std::list<Mission> doneMissions;
 	
-	std::map<std::string, int> conditions;
+	ConditionsStore conditions;
 	
-	std::set<const System *> seen;
 	std::set<const System *> visitedSystems;
 	std::set<const Planet *> visitedPlanets;
+	// Which systems have been seen or visited, indexed by System::Index(), so
+	// that the map can check every system each frame with just a bit test.
+	std::vector<bool> isSeen;
+	std::vector<bool> isVisited;
+	int knowledgeVersion = 0;
 	std::vector<const System *> travelPlan;
 	const Planet *travelDestination = nullptr;
 	
@@ -73,8 +73,8 @@ namespace {
 			}
 		}
 		
-		Color dim = *GameData::Colors().Get("medium");
-		Color bright = *GameData::Colors().Get("bright");
+		static const Color &dim = *GameData::Colors().Get("medium");
+		static const Color &bright = *GameData::Colors().Get("bright");
 		table.DrawGap(10);
 		table.DrawUnderline(dim);
 		table.Draw(title, bright);
@@ -159,7 +159,7 @@ void PlayerInfoPanel::Draw()
 	interfaceInfo.SetCondition("two buttons");
 	
 	// Draw the interface.
-	const Interface *interface = GameData::Interfaces().Get("info panel");
+	static const Interface *interface = GameData::Interfaces().Get("info panel");
 	interface->Draw(interfaceInfo, this);
 	
 	// Draw the player and fleet info sections.
@@ -346,8 +346,8 @@ void PlayerInfoPanel::DrawPlayer(const Rectangle &bounds)
 		return;
 	
 	// Colors to draw with.
-	Color dim = *GameData::Colors().Get("medium");
-	Color bright = *GameData::Colors().Get("bright");
+	static const Color &dim = *GameData::Colors().Get("medium");
+	static const Color &bright = *GameData::Colors().Get("bright");
 	
 	// Table attributes.
 	Table table;
@@ -400,10 +400,10 @@ void PlayerInfoPanel::DrawFleet(const Rectangle &bounds)
 		return;
 	
 	// Colors to draw with.
-	Color back = *GameData::Colors().Get("faint");
-	Color dim = *GameData::Colors().Get("medium");
-	Color bright = *GameData::Colors().Get("bright");
-	Color elsewhere = *GameData::Colors().Get("dim");
+	static const Color &back = *GameData::Colors().Get("faint");
+	static const Color &dim = *GameData::Colors().Get("medium");
+	static const Color &bright = *GameData::Colors().Get("bright");
+	static const Color &elsewhere = *GameData::Colors().Get("dim");
 	Color dead(.4, 0., 0., 0.);
 	
 	// Table attributes.
@@ -20,268 +20,6 @@ using namespace std;
 
 
 
-Point::Point()
-#ifdef __SSE3__
-	: v(_mm_setzero_pd())
-#else
-	: x(0.), y(0.)
-#endif
-{
-}
-
-
-
-Point::Point(double x, double y)
-#ifdef __SSE3__
-	: v(_mm_set_pd(y, x))
-#else
-	: x(x), y(y)
-#endif
-{
-}
-
-
-
-Point::Point(const Point &point)
-#ifdef __SSE3__
-	: v(point.v)
-#else
-	: x(point.x), y(point.y)
-#endif
-{
-}
-
-
-
-Point &Point::operator=(const Point &point)
-{
-#ifdef __SSE3__
-	v = point.v;
-#else
-	x = point.x;
-	y = point.y;
-#endif
-	return *this;
-}
-
-
-
-// Check if the point is anything but (0, 0).
-Point::operator bool() const
-{
-	return !!*this;
-}
-
-
-
-bool Point::operator!() const
-{
-	return (!x & !y);
-}
-
-
-
-Point Point::operator+(const Point &point) const
-{
-#ifdef __SSE3__
-	return Point(v + point.v);
-#else
-	return Point(x + point.x, y + point.y);
-#endif
-}
-
-
-
-Point &Point::operator+=(const Point &point)
-{
-#ifdef __SSE3__
-	v += point.v;
-#else
-	x += point.x;
-	y += point.y;
-#endif
-	return *this;
-}
-
-
-
-Point Point::operator-(const Point &point) const
-{
-#ifdef __SSE3__
-	return Point(v - point.v);
-#else
-	return Point(x - point.x, y - point.y);
-#endif
-}
-
-
-
-Point &Point::operator-=(const Point &point)
-{
-#ifdef __SSE3__
-	v -= point.v;
-#else
-	x -= point.x;
-	y -= point.y;
-#endif
-	return *this;
-}
-
-
-
-Point Point::operator-() const
-{
-	return Point() - *this;
-}
-
-
-
-Point Point::operator*(double scalar) const
-{
-#ifdef __SSE3__
-	return Point(v * _mm_loaddup_pd(&scalar));
-#else
-	return Point(x * scalar, y * scalar);
-#endif
-}
-
-
-
-Point operator*(double scalar, const Point &point)
-{
-#ifdef __SSE3__
-	return Point(point.v * _mm_loaddup_pd(&scalar));
-#else
-	return Point(point.x * scalar, point.y * scalar);
-#endif
-}
-
-
-
-Point &Point::operator*=(double scalar)
-{
-#ifdef __SSE3__
-	v *= _mm_loaddup_pd(&scalar);
-#else
-	x *= scalar;
-	y *= scalar;
-#endif
-	return *this;
-}
-
-
-
-Point Point::operator*(const Point &other) const
-{
-#ifdef __SSE3__
-	Point result;
-	result.v = v * other.v;
-	return result;
-#else
-	return Point(x * other.x, y * other.y);
-#endif
-}
-
-
-
-Point &Point::operator*=(const Point &other)
-{
-#ifdef __SSE3__
-	v *= other.v;
-#else
-	x *= other.x;
-	y *= other.y;
-#endif
-	return *this;
-}
-
-
-
-Point Point::operator/(double scalar) const
-{
-#ifdef __SSE3__
-	return Point(v / _mm_loaddup_pd(&scalar));
-#else
-	return Point(x / scalar, y / scalar);
-#endif
-}
-
-
-
-Point &Point::operator/=(double scalar)
-{
-#ifdef __SSE3__
-	v /= _mm_loaddup_pd(&scalar);
-#else
-	x /= scalar;
-	y /= scalar;
-#endif
-	return *this;
-}
-
-
-
-void Point::Set(double x, double y)
-{
-#ifdef __SSE3__
-	v = _mm_set_pd(y, x);
-#else
-	this->x = x;
-	this->y = y;
-#endif
-}
-
-
-
-// Operations that treat this point as a vector from (0, 0):
-double Point::Dot(const Point &point) const
-{
-#ifdef __SSE3__
-	__m128d b = v * point.v;
-	b = _mm_hadd_pd(b, b);
-	return reinterpret_cast<double &>(b);
-#else
-	return x * point.x + y * point.y;
-#endif
-}
-
-
-
-double Point::Cross(const Point &point) const
-{
-#ifdef __SSE3__
-	__m128d b = _mm_shuffle_pd(point.v, point.v, 0x01);
-	b *= v;
-	b = _mm_hsub_pd(b, b);
-	return reinterpret_cast<double &>(b);
-#else
-	return x * point.y - y * point.x;
-#endif
-}
-
-
-
-double Point::Length() const
-{
-#ifdef __SSE3__
-	__m128d b = v * v;
-	b = _mm_hadd_pd(b, b);
-	b = _mm_sqrt_pd(b);
-	return reinterpret_cast<double &>(b);
-#else
-	return sqrt(x * x + y * y);
-#endif
-}
-
-
-
-double Point::LengthSquared() const
-{
-	return Dot(*this);
-}
-
-
-
 Point Point::Unit() const
 {
 #ifdef __SSE3__
@@ -302,20 +40,6 @@ Point Point::Unit() const
 
 
 
-double Point::Distance(const Point &point) const
-{
-	return (*this - point).Length();
-}
-
-
-
-double Point::DistanceSquared(const Point &point) const
-{
-	return (*this - point).LengthSquared();
-}
-
-
-
 // Absolute value of both coordinates.
 Point abs(const Point &p)
 {
@@ -351,13 +75,3 @@ Point max(const Point &p, const Point &q)
 	return Point(max(p.x, q.x), max(p.y, q.y));
 #endif
 }
-
-
-
-#ifdef __SSE3__
-// Private constructor, using a vector.
-inline Point::Point(const __m128d &v)
-	: v(v)
-{
-}
-#endif
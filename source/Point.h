@@ -15,6 +15,8 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 #ifdef __SSE3__
 #include <pmmintrin.h>
+#else
+#include <cmath>
 #endif
 
 
@@ -101,7 +103,9 @@ private:
 
 
 
-// Inline accessor functions, for speed:
+// Inline accessor functions, for speed. The arithmetic operators are called in
+// every inner loop of the game, so they are inlined as well so that the compiler
+// can keep the coordinates in registers instead of making a call for each one.
 inline double &Point::X()
 {
 	return x;
@@ -130,4 +134,290 @@ inline const double &Point::Y() const
 
 
 
+#ifdef __SSE3__
+// Private constructor, using a vector.
+inline Point::Point(const __m128d &v)
+	: v(v)
+{
+}
+#endif
+
+
+
+inline Point::Point()
+#ifdef __SSE3__
+	: v(_mm_setzero_pd())
+#else
+	: x(0.), y(0.)
+#endif
+{
+}
+
+
+
+inline Point::Point(double x, double y)
+#ifdef __SSE3__
+	: v(_mm_set_pd(y, x))
+#else
+	: x(x), y(y)
+#endif
+{
+}
+
+
+
+inline Point::Point(const Point &point)
+#ifdef __SSE3__
+	: v(point.v)
+#else
+	: x(point.x), y(point.y)
+#endif
+{
+}
+
+
+
+inline Point &Point::operator=(const Point &point)
+{
+#ifdef __SSE3__
+	v = point.v;
+#else
+	x = point.x;
+	y = point.y;
+#endif
+	return *this;
+}
+
+
+
+// Check if the point is anything but (0, 0).
+inline Point::operator bool() const
+{
+	return !!*this;
+}
+
+
+
+inline bool Point::operator!() const
+{
+	return (!x & !y);
+}
+
+
+
+inline Point Point::operator+(const Point &point) const
+{
+#ifdef __SSE3__
+	return Point(v + point.v);
+#else
+	return Point(x + point.x, y + point.y);
+#endif
+}
+
+
+
+inline Point &Point::operator+=(const Point &point)
+{
+#ifdef __SSE3__
+	v += point.v;
+#else
+	x += point.x;
+	y += point.y;
+#endif
+	return *this;
+}
+
+
+
+inline Point Point::operator-(const Point &point) const
+{
+#ifdef __SSE3__
+	return Point(v - point.v);
+#else
+	return Point(x - point.x, y - point.y);
+#endif
+}
+
+
+
+inline Point &Point::operator-=(const Point &point)
+{
+#ifdef __SSE3__
+	v -= point.v;
+#else
+	x -= point.x;
+	y -= point.y;
+#endif
+	return *this;
+}
+
+
+
+inline Point Point::operator-() const
+{
+	return Point() - *this;
+}
+
+
+
+inline Point Point::operator*(double scalar) const
+{
+#ifdef __SSE3__
+	return Point(v * _mm_loaddup_pd(&scalar));
+#else
+	return Point(x * scalar, y * scalar);
+#endif
+}
+
+
+
+inline Point operator*(double scalar, const Point &point)
+{
+#ifdef __SSE3__
+	return Point(point.v * _mm_loaddup_pd(&scalar));
+#else
+	return Point(point.x * scalar, point.y * scalar);
+#endif
+}
+
+
+
+inline Point &Point::operator*=(double scalar)
+{
+#ifdef __SSE3__
+	v *= _mm_loaddup_pd(&scalar);
+#else
+	x *= scalar;
+	y *= scalar;
+#endif
+	return *this;
+}
+
+
+
+inline Point Point::operator*(const Point &other) const
+{
+#ifdef __SSE3__
+	Point result;
+	result.v = v * other.v;
+	return result;
+#else
+	return Point(x * other.x, y * other.y);
+#endif
+}
+
+
+
+inline Point &Point::operator*=(const Point &other)
+{
+#ifdef __SSE3__
+	v *= other.v;
+#else
+	x *= other.x;
+	y *= other.y;
+#endif
+	return *this;
+}
+
+
+
+inline Point Point::operator/(double scalar) const
+{
+#ifdef __SSE3__
+	return Point(v / _mm_loaddup_pd(&scalar));
+#else
+	return Point(x / scalar, y / scalar);
+#endif
+}
+
+
+
+inline Point &Point::operator/=(double scalar)
+{
+#ifdef __SSE3__
+	v /= _mm_loaddup_pd(&scalar);
+#else
+	x /= scalar;
+	y /= scalar;
+#endif
+	return *this;
+}
+
+
+
+inline void Point::Set(double x, double y)
+{
+#ifdef __SSE3__
+	v = _mm_set_pd(y, x);
+#else
+	this->x = x;
+	this->y = y;
+#endif
+}
+
+
+
+// Operations that treat this point as a vector from (0, 0):
+inline double Point::Dot(const Point &point) const
+{
+#ifdef __SSE3__
+	__m128d b = v * point.v;
+	b = _mm_hadd_pd(b, b);
+	return reinterpret_cast<double &>(b);
+#else
+	return x * point.x + y * point.y;
+#endif
+}
+
+
+
+inline double Point::Cross(const Point &point) const
+{
+#ifdef __SSE3__
+	__m128d b = _mm_shuffle_pd(point.v, point.v, 0x01);
+	b *= v;
+	b = _mm_hsub_pd(b, b);
+	return reinterpret_cast<double &>(b);
+#else
+	return x * point.y - y * point.x;
+#endif
+}
+
+
+
+inline double Point::Length() const
+{
+#ifdef __SSE3__
+	__m128d b = v * v;
+	b = _mm_hadd_pd(b, b);
+	b = _mm_sqrt_pd(b);
+	return reinterpret_cast<double &>(b);
+#else
+	return std::sqrt(x * x + y * y);
+#endif
+}
+
+
+
+inline double Point::LengthSquared() const
+{
+	return Dot(*this);
+}
+
+
+
+inline double Point::Distance(const Point &point) const
+{
+	return (*this - point).Length();
+}
+
+
+
+inline double Point::DistanceSquared(const Point &point) const
+{
+	return (*this - point).LengthSquared();
+}
+
+
+
 #endif
@@ -16,14 +16,18 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Point.h"
 #include "Screen.h"
 #include "Shader.h"
+#include "StreamBuffer.h"
 
 #include <stdexcept>
+#include <vector>
 
 using namespace std;
 
 namespace {
 	Shader shader;
 	GLint scaleI;
+	
+	GLint vertI;
 	GLint centerI;
 	GLint angleI;
 	GLint sizeI;
@@ -31,7 +35,23 @@ namespace {
 	GLint colorI;
 	
 	GLuint vao;
-	GLuint vbo;
+	
+	// Every vertex holds a copy of all the pointer's parameters, so that any
+	// number of pointers can be drawn at once.
+	const int FLOATS = 13;
+	const GLfloat CORNERS[6] = {
+		0.f, 0.f,
+		0.f, 1.f,
+		1.f, 0.f,
+	};
+	vector<GLfloat> vertices;
+	
+	void Attrib(GLint index, int size, int offset, GLintptr start)
+	{
+		glEnableVertexAttribArray(index);
+		glVertexAttribPointer(index, size, GL_FLOAT, GL_FALSE, FLOATS * sizeof(GLfloat),
+			(const GLvoid*)(start + offset * sizeof(GLfloat)));
+	}
 }
 
 
@@ -40,15 +60,20 @@ void PointerShader::Init()
 {
 	static const char *vertexCode =
 		"uniform vec2 scale;\n"
-		"uniform vec2 center;\n"
-		"uniform vec2 angle;\n"
-		"uniform vec2 size;\n"
-		"uniform float offset;\n"
 		
 		"in vec2 vert;\n"
+		"in vec2 center;\n"
+		"in vec2 angle;\n"
+		"in vec2 size;\n"
+		"in float offset;\n"
+		"in vec4 color;\n"
 		"out vec2 coord;\n"
+		"flat out float width;\n"
+		"flat out vec4 pointerColor;\n"
 		
 		"void main() {\n"
+		"  width = size.x;\n"
+		"  pointerColor = color;\n"
 		"  coord = vert * size.x;\n"
 		"  vec2 base = center + angle * (offset - size.y * (vert.x + vert.y));\n"
 		"  vec2 wing = vec2(angle.y, -angle.x) * (size.x * .5 * (vert.x - vert.y));\n"
@@ -56,49 +81,33 @@ void PointerShader::Init()
 		"}\n";
 
 	static const char *fragmentCode =
-		"uniform vec4 color = vec4(1, 1, 1, 1);\n"
-		"uniform vec2 size;\n"
-		
 		"in vec2 coord;\n"
+		"flat in float width;\n"
+		"flat in vec4 pointerColor;\n"
 		"out vec4 finalColor;\n"
 		
 		"void main() {\n"
-		"  float height = (coord.x + coord.y) / size.x;\n"
+		"  float height = (coord.x + coord.y) / width;\n"
 		"  float taper = height * height * height;\n"
-		"  taper *= taper * .5 * size.x;\n"
+		"  taper *= taper * .5 * width;\n"
 		"  float alpha = clamp(.8 * min(coord.x, coord.y) - taper, 0, 1);\n"
 		"  alpha *= clamp(1.8 * (1. - height), 0, 1);\n"
-		"  finalColor = color * alpha;\n"
+		"  finalColor = pointerColor * alpha;\n"
 		"}\n";
 	
 	shader = Shader(vertexCode, fragmentCode);
 	scaleI = shader.Uniform("scale");
-	centerI = shader.Uniform("center");
-	angleI = shader.Uniform("angle");
-	sizeI = shader.Uniform("size");
-	offsetI = shader.Uniform("offset");
-	colorI = shader.Uniform("color");
-	
-	// Generate the vertex data for drawing sprites.
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-	
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	
-	GLfloat vertexData[] = {
-		0.f, 0.f,
-		0.f, 1.f,
-		1.f, 0.f,
-	};
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertexData), vertexData, GL_STATIC_DRAW);
 	
-	glEnableVertexAttribArray(shader.Attrib("vert"));
-	glVertexAttribPointer(shader.Attrib("vert"), 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), nullptr);
+	vertI = shader.Attrib("vert");
+	centerI = shader.Attrib("center");
+	angleI = shader.Attrib("angle");
+	sizeI = shader.Attrib("size");
+	offsetI = shader.Attrib("offset");
+	colorI = shader.Attrib("color");
 	
-	// unbind the VBO and VAO
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	// The vertex data is streamed in each time pointers are drawn, so the VAO
+	// only needs to remember which attributes are enabled.
+	glGenVertexArrays(1, &vao);
 }
 
 
@@ -119,37 +128,67 @@ void PointerShader::Bind()
 	if(!shader.Object())
 		throw runtime_error("PointerShader: Bind() called before Init().");
 	
-	glUseProgram(shader.Object());
-	glBindVertexArray(vao);
-	
-	GLfloat scale[2] = {2.f / Screen::Width(), -2.f / Screen::Height()};
-	glUniform2fv(scaleI, 1, scale);
+	vertices.clear();
 }
 
 
 
 void PointerShader::Add(const Point &center, const Point &angle, float width, float height, float offset, const Color &color)
 {
-	GLfloat c[2] = {static_cast<float>(center.X()), static_cast<float>(center.Y())};
-	glUniform2fv(centerI, 1, c);
-	
-	GLfloat a[2] = {static_cast<float>(angle.X()), static_cast<float>(angle.Y())};
-	glUniform2fv(angleI, 1, a);
-	
-	GLfloat size[2] = {width, height};
-	glUniform2fv(sizeI, 1, size);
-	
-	glUniform1f(offsetI, offset);
-	
-	glUniform4fv(colorI, 1, color.Get());
-	
-	glDrawArrays(GL_TRIANGLES, 0, 3);
+	Add(vertices, center, angle, width, height, offset, color);
 }
 
 
 
 void PointerShader::Unbind()
 {
-	glBindVertexArray(0);
-	glUseProgram(0);
+	Draw(vertices);
+	vertices.clear();
+}
+
+
+
+// Record the vertices of a pointer in the given list, without drawing it.
+// This does not touch OpenGL, so it can be done in any thread, and the
+// whole list can be drawn later, in the drawing thread, in a single call.
+void PointerShader::Add(vector<float> &batch, const Point &center, const Point &angle, float width, float height, float offset, const Color &color)
+{
+	const float *c = color.Get();
+	GLfloat data[FLOATS - 2] = {
+		static_cast<float>(center.X()), static_cast<float>(center.Y()),
+		static_cast<float>(angle.X()), static_cast<float>(angle.Y()),
+		width, height,
+		offset,
+		c[0], c[1], c[2], c[3]
+	};
+	for(int i = 0; i < 6; i += 2)
+	{
+		batch.insert(batch.end(), CORNERS + i, CORNERS + i + 2);
+		batch.insert(batch.end(), data, data + FLOATS - 2);
+	}
+}
+
+
+
+void PointerShader::Draw(const vector<float> &batch)
+{
+	if(batch.empty())
+		return;
+	
+	shader.Use();
+	Shader::BindVertexArray(vao);
+	
+	GLfloat scale[2] = {2.f / Screen::Width(), -2.f / Screen::Height()};
+	glUniform2fv(scaleI, 1, scale);
+	
+	GLintptr start = StreamBuffer::Upload(batch.data(), batch.size() * sizeof(GLfloat));
+	Attrib(vertI, 2, 0, start);
+	Attrib(centerI, 2, 2, start);
+	Attrib(angleI, 2, 4, start);
+	Attrib(sizeI, 2, 6, start);
+	Attrib(offsetI, 1, 8, start);
+	Attrib(colorI, 4, 9, start);
+	glDrawArrays(GL_TRIANGLES, 0, batch.size() / FLOATS);
+	
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
@@ -13,6 +13,8 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #ifndef POINTER_SHADER_H_
 #define POINTER_SHADER_H_
 
+#include <vector>
+
 class Color;
 class Point;
 
@@ -28,6 +30,12 @@ public:
 	static void Bind();
 	static void Add(const Point &center, const Point &angle, float width, float height, float offset, const Color &color);
 	static void Unbind();
+	
+	// Record the vertices of a pointer in the given list, without drawing it.
+	// This does not touch OpenGL, so it can be done in any thread, and the
+	// whole list can be drawn later, in the drawing thread, in a single call.
+	static void Add(std::vector<float> &batch, const Point &center, const Point &angle, float width, float height, float offset, const Color &color);
+	static void Draw(const std::vector<float> &batch);
 };
 
 
@@ -43,6 +43,33 @@ void Politics::Reset()
 	// were already checked for when you first landed).
 	for(const auto &it : GameData::Governments())
 		fined.insert(&it.second);
+	
+	UpdateAttitudes();
+}
+
+
+
+// Rebuild the table of which governments are enemies, after their attitudes
+// toward each other have changed.
+void Politics::UpdateAttitudes()
+{
+	governments = 0;
+	for(const auto &it : GameData::Governments())
+		governments = max<size_t>(governments, it.second.Index() + 1);
+	
+	hostile.assign(governments * governments, false);
+	playerHostile.assign(governments, false);
+	for(const auto &first : GameData::Governments())
+		for(const auto &second : GameData::Governments())
+		{
+			const Government *gov = &first.second;
+			const Government *other = &second.second;
+			if(gov != other)
+				hostile[gov->Index() * governments + other->Index()] =
+					(gov->AttitudeToward(other) < 0. || other->AttitudeToward(gov) < 0.);
+		}
+	for(const auto &it : GameData::Governments())
+		UpdatePlayer(&it.second);
 }
 
 
@@ -58,17 +85,17 @@ bool Politics::IsEnemy(const Government *first, const Government *second) const
 		swap(first, second);
 	if(first->IsPlayer())
 	{
-		if(bribed.count(second))
-			return false;
-		if(provoked.count(second))
-			return true;
-		
-		auto it = reputationWith.find(second);
-		return (it != reputationWith.end() && it->second < 0.);
+		unsigned index = second->Index();
+		return (index < playerHostile.size() ? playerHostile[index] : IsPlayerEnemy(second));
 	}
 	
 	// Neither government is the player, so the question of enemies depends only
 	// on the attitude matrix.
+	unsigned index = first->Index();
+	unsigned otherIndex = second->Index();
+	if(index < governments && otherIndex < governments)
+		return hostile[index * governments + otherIndex];
+	
 	return (first->AttitudeToward(second) < 0. || second->AttitudeToward(first) < 0.);
 }
 
@@ -98,6 +125,7 @@ void Politics::Offend(const Government *gov, int eventType, int count)
 				// your bribe is cancelled out.
 				bribed.erase(other);
 				provoked.insert(other);
+				UpdatePlayer(other);
 			}
 		}
 		else if(abs(weight) >= .05 && count * weight)
@@ -111,6 +139,7 @@ void Politics::Offend(const Government *gov, int eventType, int count)
 				reputationWith[other] = min(0., reputationWith[other]);
 			
 			reputationWith[other] -= penalty;
+			UpdatePlayer(other);
 		}
 	}
 }
@@ -123,6 +152,7 @@ void Politics::Bribe(const Government *gov)
 	bribed.insert(gov);
 	provoked.erase(gov);
 	fined.insert(gov);
+	UpdatePlayer(gov);
 }
 
 
@@ -299,6 +329,7 @@ double Politics::Reputation(const Government *gov) const
 void Politics::AddReputation(const Government *gov, double value)
 {
 	reputationWith[gov] += value;
+	UpdatePlayer(gov);
 }
 
 
@@ -306,6 +337,7 @@ void Politics::AddReputation(const Government *gov, double value)
 void Politics::SetReputation(const Government *gov, double value)
 {
 	reputationWith[gov] = value;
+	UpdatePlayer(gov);
 }
 
 
@@ -317,4 +349,36 @@ void Politics::ResetDaily()
 	bribed.clear();
 	bribedPlanets.clear();
 	fined.clear();
+	
+	// Without any bribes or provocations, the player is only hostile to the
+	// governments they have a bad reputation with.
+	playerHostile.assign(playerHostile.size(), false);
+	for(const auto &it : reputationWith)
+		UpdatePlayer(it.first);
+}
+
+
+
+// Check whether the given government is hostile to the player.
+bool Politics::IsPlayerEnemy(const Government *gov) const
+{
+	if(bribed.count(gov))
+		return false;
+	if(provoked.count(gov))
+		return true;
+	
+	auto it = reputationWith.find(gov);
+	return (it != reputationWith.end() && it->second < 0.);
+}
+
+
+
+// Update the stored value of whether the given government is hostile to the
+// player, after anything it depends on has changed.
+void Politics::UpdatePlayer(const Government *gov)
+{
+	unsigned index = gov->Index();
+	if(index >= playerHostile.size())
+		playerHostile.resize(index + 1, false);
+	playerHostile[index] = IsPlayerEnemy(gov);
 }
@@ -16,6 +16,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 class Government;
 class Planet;
@@ -33,6 +34,9 @@ public:
 	// Reset to the initial political state defined in the game data.
 	void Reset();
 	
+	// Rebuild the table of which governments are enemies, after their
+	// attitudes toward each other have changed.
+	void UpdateAttitudes();
 	bool IsEnemy(const Government *first, const Government *second) const;
 	
 	// Commit the given "offense" against the given government (which may not
@@ -66,6 +70,13 @@ public:
 	void ResetDaily();
 	
 	
+private:
+	// Check whether the given government is hostile to the player, and update
+	// the stored value that IsEnemy() uses.
+	bool IsPlayerEnemy(const Government *gov) const;
+	void UpdatePlayer(const Government *gov);
+	
+	
 private:
 	// attitude[target][other] stores how much an action toward the given target
 	// government will affect your reputation with the given other government.
@@ -78,6 +89,14 @@ private:
 	std::map<const Planet *, bool> bribedPlanets;
 	std::set<const Planet *> dominatedPlanets;
 	std::set<const Government *> fined;
+	
+	// IsEnemy() is called very often, so whether each pair of governments is
+	// hostile is stored in a table indexed by Government::Index(). Hostility
+	// between two governments that are not the player only depends on their
+	// attitudes, so that part can only change due to an event.
+	std::vector<bool> hostile;
+	size_t governments = 0;
+	std::vector<bool> playerHostile;
 };
 
 
@@ -0,0 +1,121 @@
+/* PoolAllocator.h
+Copyright (c) 2017 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef POOL_ALLOCATOR_H_
+#define POOL_ALLOCATOR_H_
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+
+
+// This is a standard allocator that recycles the memory of objects that are
+// freed instead of returning it to the heap. It is meant for objects that are
+// created and destroyed constantly, like the ships in NPC fleets that jump in
+// and out of each system, so that over a long session they keep reusing the
+// same blocks instead of fragmenting the heap. Use it with std::allocate_shared
+// so that the object and its reference count share a single pooled block.
+// Objects owned by static data (e.g. the game data's ship definitions) should
+// not come from the pool, since they are only freed when the program exits.
+template <class Type>
+class PoolAllocator {
+public:
+	typedef Type value_type;
+	
+	template <class Other>
+	struct rebind { typedef PoolAllocator<Other> other; };
+	
+	PoolAllocator() = default;
+	template <class Other>
+	PoolAllocator(const PoolAllocator<Other> &) {}
+	
+	// Get storage for the given number of objects. Only single objects are
+	// pooled; arrays come directly from the heap.
+	Type *allocate(std::size_t n);
+	void deallocate(Type *p, std::size_t n);
+	
+	
+private:
+	// Never keep more than this many unused blocks around.
+	static const std::size_t MAX_FREE = 1024;
+	
+	// The free list is created the first time it is needed and never
+	// destroyed, so that it is still there when any static object that holds
+	// pooled objects is destroyed. The operating system reclaims its blocks
+	// when the program exits.
+	class Pool {
+	public:
+		std::mutex lock;
+		std::vector<void *> free;
+	};
+	static Pool &GetPool();
+};
+
+
+
+// All pools of the same type are interchangeable.
+template <class Type, class Other>
+bool operator==(const PoolAllocator<Type> &, const PoolAllocator<Other> &) { return true; }
+template <class Type, class Other>
+bool operator!=(const PoolAllocator<Type> &, const PoolAllocator<Other> &) { return false; }
+
+
+
+template <class Type>
+Type *PoolAllocator<Type>::allocate(std::size_t n)
+{
+	if(n == 1)
+	{
+		Pool &pool = GetPool();
+		std::lock_guard<std::mutex> guard(pool.lock);
+		if(!pool.free.empty())
+		{
+			void *p = pool.free.back();
+			pool.free.pop_back();
+			return static_cast<Type *>(p);
+		}
+	}
+	return static_cast<Type *>(::operator new(n * sizeof(Type)));
+}
+
+
+
+template <class Type>
+void PoolAllocator<Type>::deallocate(Type *p, std::size_t n)
+{
+	if(n == 1)
+	{
+		Pool &pool = GetPool();
+		std::lock_guard<std::mutex> guard(pool.lock);
+		if(pool.free.size() < MAX_FREE)
+		{
+			pool.free.push_back(p);
+			return;
+		}
+	}
+	::operator delete(p);
+}
+
+
+
+template <class Type>
+typename PoolAllocator<Type>::Pool &PoolAllocator<Type>::GetPool()
+{
+	static Pool *pool = new Pool;
+	return *pool;
+}
+
+
+
+#endif
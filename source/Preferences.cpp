@@ -26,7 +26,42 @@ using namespace std;
 
 namespace {
 	map<string, bool> settings;
+	// The names of the settings that are also cached as plain flags, in the
+	// same order as the Preferences::Setting enum.
+	const string CACHED_NAMES[Preferences::SETTING_COUNT] = {
+		"Automatic aiming",
+		"Automatic firing",
+		"Draw background haze",
+		"Dynamic resolution",
+		"Escorts expend ammo",
+		"Escorts use ammo frugally",
+		"Hide unexplored map regions",
+		"Highlight player's flagship",
+		"Late input",
+		"Render motion blur",
+		"Rotate flagship in HUD",
+		"Show CPU / GPU load",
+		"Show frame profiler",
+		"Show hyperspace flash",
+		"Show mini-map",
+		"Show planet labels",
+		"Show status overlays",
+		"Warning siren"
+	};
+	bool cached[Preferences::SETTING_COUNT] = {};
+	
+	// Copy the given setting into its flag, if it has one.
+	void Cache(const string &name, bool on)
+	{
+		for(int i = 0; i < Preferences::SETTING_COUNT; ++i)
+			if(CACHED_NAMES[i] == name)
+				cached[i] = on;
+	}
 	int scrollSpeed = 60;
+	int imageThreads = 0;
+	int spriteMemory = 0;
+	int soundMemory = 0;
+	int effectsQuality = 0;
 	
 	// Strings for ammo expenditure:
 	static const string EXPEND_AMMO = "Escorts expend ammo";
@@ -50,7 +85,15 @@ void Preferences::Load()
 	settings["Show hyperspace flash"] = true;
 	settings["Draw background haze"] = true;
 	settings["Reduce large graphics"] = false;
+	settings["Compress sprite textures"] = false;
 	settings["Hide unexplored map regions"] = true;
+	settings["Compress saved games"] = false;
+	settings["Binary saved games"] = false;
+	settings["Show frame profiler"] = false;
+	settings["Render in a separate thread"] = false;
+	settings["Dynamic resolution"] = false;
+	settings["Turbo fast-forward"] = false;
+	settings["Late input"] = false;
 	
 	DataFile prefs(Files::Config() + "preferences.txt");
 	for(const DataNode &node : prefs)
@@ -63,11 +106,22 @@ void Preferences::Load()
 			Audio::SetVolume(node.Value(1));
 		else if(node.Token(0) == "scroll speed" && node.Size() >= 2)
 			scrollSpeed = node.Value(1);
+		else if(node.Token(0) == "image threads" && node.Size() >= 2)
+			imageThreads = node.Value(1);
+		else if(node.Token(0) == "sprite memory" && node.Size() >= 2)
+			spriteMemory = node.Value(1);
+		else if(node.Token(0) == "sound memory" && node.Size() >= 2)
+			soundMemory = node.Value(1);
+		else if(node.Token(0) == "effects quality" && node.Size() >= 2)
+			effectsQuality = node.Value(1);
 		else if(node.Token(0) == "view zoom")
 			zoomIndex = node.Value(1);
 		else
 			settings[node.Token(0)] = (node.Size() == 1 || node.Value(1));
 	}
+	
+	for(int i = 0; i < SETTING_COUNT; ++i)
+		cached[i] = Has(CACHED_NAMES[i]);
 }
 
 
@@ -80,6 +134,10 @@ void Preferences::Save()
 	out.Write("window size", Screen::RawWidth(), Screen::RawHeight());
 	out.Write("zoom", Screen::Zoom());
 	out.Write("scroll speed", scrollSpeed);
+	out.Write("image threads", imageThreads);
+	out.Write("sprite memory", spriteMemory);
+	out.Write("sound memory", soundMemory);
+	out.Write("effects quality", effectsQuality);
 	out.Write("view zoom", zoomIndex);
 	
 	for(const auto &it : settings)
@@ -96,9 +154,17 @@ bool Preferences::Has(const string &name)
 
 
 
+bool Preferences::Has(Setting setting)
+{
+	return cached[setting];
+}
+
+
+
 void Preferences::Set(const string &name, bool on)
 {
 	settings[name] = on;
+	Cache(name, on);
 }
 
 
@@ -133,6 +199,69 @@ void Preferences::SetScrollSpeed(int speed)
 
 
 
+// Number of threads to read images with (zero means to pick automatically).
+int Preferences::ImageThreads()
+{
+	return imageThreads;
+}
+
+
+
+void Preferences::SetImageThreads(int threads)
+{
+	imageThreads = threads;
+}
+
+
+
+// How much video memory sprites may use, in megabytes. If this is zero, every
+// sprite is loaded at startup and kept loaded.
+int Preferences::SpriteMemory()
+{
+	return spriteMemory;
+}
+
+
+
+void Preferences::SetSpriteMemory(int megabytes)
+{
+	spriteMemory = megabytes;
+}
+
+
+
+// How much memory loaded sounds may use, in megabytes. If this is zero, sounds
+// are never unloaded once they have been played.
+int Preferences::SoundMemory()
+{
+	return soundMemory;
+}
+
+
+
+void Preferences::SetSoundMemory(int megabytes)
+{
+	soundMemory = megabytes;
+}
+
+
+
+// What percentage of the visual effects to show. If this is zero, it is
+// adjusted automatically depending on how far behind the game is falling.
+int Preferences::EffectsQuality()
+{
+	return effectsQuality;
+}
+
+
+
+void Preferences::SetEffectsQuality(int percent)
+{
+	effectsQuality = percent;
+}
+
+
+
 // View zoom.
 double Preferences::ViewZoom()
 {
@@ -18,11 +18,39 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 
 class Preferences {
+public:
+	// Settings that are checked every frame or every step. The current value of
+	// each of these is kept in a plain flag, so checking one does not require
+	// looking it up by name. Set() and Load() keep the flags up to date.
+	enum Setting {
+		AUTOMATIC_AIMING,
+		AUTOMATIC_FIRING,
+		DRAW_BACKGROUND_HAZE,
+		DYNAMIC_RESOLUTION,
+		ESCORTS_EXPEND_AMMO,
+		ESCORTS_USE_AMMO_FRUGALLY,
+		HIDE_UNEXPLORED_MAP_REGIONS,
+		HIGHLIGHT_PLAYERS_FLAGSHIP,
+		LATE_INPUT,
+		RENDER_MOTION_BLUR,
+		ROTATE_FLAGSHIP_IN_HUD,
+		SHOW_CPU_GPU_LOAD,
+		SHOW_FRAME_PROFILER,
+		SHOW_HYPERSPACE_FLASH,
+		SHOW_MINI_MAP,
+		SHOW_PLANET_LABELS,
+		SHOW_STATUS_OVERLAYS,
+		WARNING_SIREN,
+		SETTING_COUNT
+	};
+	
+	
 public:
 	static void Load();
 	static void Save();
 	
 	static bool Has(const std::string &name);
+	static bool Has(Setting setting);
 	static void Set(const std::string &name, bool on = true);
 	
 	// Toogle the ammo usage preferences, cycling between "never," "frugally,"
@@ -34,6 +62,25 @@ public:
 	static int ScrollSpeed();
 	static void SetScrollSpeed(int speed);
 	
+	// Number of threads to read images with (zero means to pick automatically).
+	static int ImageThreads();
+	static void SetImageThreads(int threads);
+	
+	// How much video memory sprites may use, in megabytes. If this is zero,
+	// every sprite is loaded at startup and kept loaded.
+	static int SpriteMemory();
+	static void SetSpriteMemory(int megabytes);
+	
+	// How much memory loaded sounds may use, in megabytes. If this is zero,
+	// sounds are never unloaded once they have been played.
+	static int SoundMemory();
+	static void SetSoundMemory(int megabytes);
+	
+	// What percentage of the visual effects to show. If this is zero, it is
+	// adjusted automatically depending on how far behind the game is falling.
+	static int EffectsQuality();
+	static void SetEffectsQuality(int percent);
+	
 	// View zoom.
 	static double ViewZoom();
 	static bool ZoomViewIn();
@@ -27,6 +27,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "SpriteShader.h"
 #include "StarField.h"
 #include "Table.h"
+#include "ThreadPool.h"
 #include "UI.h"
 #include "WrappedText.h"
 
@@ -43,6 +44,14 @@ namespace {
 	static const string FRUGAL_ESCORTS = "Escorts use ammo frugally";
 	static const string REACTIVATE_HELP = "Reactivate first-time help";
 	static const string SCROLL_SPEED = "Scroll speed";
+	static const string IMAGE_THREADS = "Image loading threads";
+	static const string SPRITE_MEMORY = "Sprite memory limit";
+	// The choices of sprite memory limit, in megabytes.
+	static const int MAX_SPRITE_MEMORY = 2048;
+	static const int MIN_SPRITE_MEMORY = 256;
+	static const string EFFECTS_QUALITY = "Effects quality";
+	// The effects quality goes up and down in steps of this many percent.
+	static const int EFFECTS_QUALITY_STEP = 25;
 }
 
 
@@ -174,6 +183,31 @@ bool PreferencesPanel::Click(int x, int y, int clicks)
 					speed = 20;
 				Preferences::SetScrollSpeed(speed);
 			}
+			else if(zone.Value() == IMAGE_THREADS)
+			{
+				// Count up to the number of threads in the pool, then cycle
+				// back around to picking the number automatically.
+				int threads = Preferences::ImageThreads() + 1;
+				if(threads > static_cast<int>(ThreadPool::Shared().Size()))
+					threads = 0;
+				Preferences::SetImageThreads(threads);
+			}
+			else if(zone.Value() == SPRITE_MEMORY)
+			{
+				// Double the limit until it reaches the maximum, then cycle
+				// back around to no limit.
+				int megabytes = Preferences::SpriteMemory();
+				megabytes = !megabytes ? MIN_SPRITE_MEMORY : megabytes < MAX_SPRITE_MEMORY ? 2 * megabytes : 0;
+				Preferences::SetSpriteMemory(megabytes);
+			}
+			else if(zone.Value() == EFFECTS_QUALITY)
+			{
+				// Step down from full quality, then cycle back around to
+				// adjusting it automatically.
+				int percent = Preferences::EffectsQuality();
+				percent = !percent ? 100 : percent > EFFECTS_QUALITY_STEP ? percent - EFFECTS_QUALITY_STEP : 0;
+				Preferences::SetEffectsQuality(percent);
+			}
 			else
 				Preferences::Set(zone.Value(), !Preferences::Has(zone.Value()));
 			break;
@@ -254,6 +288,33 @@ bool PreferencesPanel::Scroll(double dx, double dy)
 			speed = min(60, speed + 20);
 		Preferences::SetScrollSpeed(speed);
 	}
+	else if(hoverPreference == IMAGE_THREADS)
+	{
+		int threads = Preferences::ImageThreads();
+		if(dy < 0.)
+			threads = max(0, threads - 1);
+		else
+			threads = min(static_cast<int>(ThreadPool::Shared().Size()), threads + 1);
+		Preferences::SetImageThreads(threads);
+	}
+	else if(hoverPreference == SPRITE_MEMORY)
+	{
+		int megabytes = Preferences::SpriteMemory();
+		if(dy < 0.)
+			megabytes = (megabytes > MIN_SPRITE_MEMORY) ? megabytes / 2 : 0;
+		else
+			megabytes = !megabytes ? MIN_SPRITE_MEMORY : min(MAX_SPRITE_MEMORY, 2 * megabytes);
+		Preferences::SetSpriteMemory(megabytes);
+	}
+	else if(hoverPreference == EFFECTS_QUALITY)
+	{
+		int percent = Preferences::EffectsQuality();
+		if(dy < 0.)
+			percent = (percent > EFFECTS_QUALITY_STEP) ? percent - EFFECTS_QUALITY_STEP : 0;
+		else
+			percent = !percent ? EFFECTS_QUALITY_STEP : min(100, percent + EFFECTS_QUALITY_STEP);
+		Preferences::SetEffectsQuality(percent);
+	}
 	return true;
 }
 
@@ -268,10 +329,10 @@ void PreferencesPanel::EndEditing()
 
 void PreferencesPanel::DrawControls()
 {
-	Color back = *GameData::Colors().Get("faint");
-	Color dim = *GameData::Colors().Get("dim");
-	Color medium = *GameData::Colors().Get("medium");
-	Color bright = *GameData::Colors().Get("bright");
+	static const Color &back = *GameData::Colors().Get("faint");
+	static const Color &dim = *GameData::Colors().Get("dim");
+	static const Color &medium = *GameData::Colors().Get("medium");
+	static const Color &bright = *GameData::Colors().Get("bright");
 	
 	// Check for conflicts.
 	Color red(.3, 0., 0., .3);
@@ -392,10 +453,10 @@ void PreferencesPanel::DrawControls()
 
 void PreferencesPanel::DrawSettings()
 {
-	Color back = *GameData::Colors().Get("faint");
-	Color dim = *GameData::Colors().Get("dim");
-	Color medium = *GameData::Colors().Get("medium");
-	Color bright = *GameData::Colors().Get("bright");
+	static const Color &back = *GameData::Colors().Get("faint");
+	static const Color &dim = *GameData::Colors().Get("dim");
+	static const Color &medium = *GameData::Colors().Get("medium");
+	static const Color &bright = *GameData::Colors().Get("bright");
 	
 	Table table;
 	table.AddColumn(-115, Table::LEFT);
@@ -422,8 +483,13 @@ void PreferencesPanel::DrawSettings()
 		"",
 		"Performance",
 		"Show CPU / GPU load",
+		"Show frame profiler",
 		"Render motion blur",
 		"Reduce large graphics",
+		"Compress sprite textures",
+		IMAGE_THREADS,
+		SPRITE_MEMORY,
+		EFFECTS_QUALITY,
 		"Draw background haze",
 		"Show hyperspace flash",
 		"\n",
@@ -431,7 +497,13 @@ void PreferencesPanel::DrawSettings()
 		REACTIVATE_HELP,
 		SCROLL_SPEED,
 		"Warning siren",
-		"Hide unexplored map regions"
+		"Hide unexplored map regions",
+		"Compress saved games",
+		"Binary saved games",
+		"Render in a separate thread",
+		"Dynamic resolution",
+		"Turbo fast-forward",
+		"Late input"
 	};
 	bool isCategory = true;
 	for(const string &setting : SETTINGS)
@@ -496,6 +568,24 @@ void PreferencesPanel::DrawSettings()
 			isOn = true;
 			text = to_string(Preferences::ScrollSpeed());
 		}
+		else if(setting == IMAGE_THREADS)
+		{
+			isOn = true;
+			int threads = Preferences::ImageThreads();
+			text = threads ? to_string(threads) : "auto";
+		}
+		else if(setting == SPRITE_MEMORY)
+		{
+			int megabytes = Preferences::SpriteMemory();
+			isOn = megabytes;
+			text = megabytes ? to_string(megabytes) + " MB" : "off";
+		}
+		else if(setting == EFFECTS_QUALITY)
+		{
+			isOn = true;
+			int percent = Preferences::EffectsQuality();
+			text = percent ? to_string(percent) + "%" : "auto";
+		}
 		else
 			text = isOn ? "on" : "off";
 		
@@ -510,9 +600,9 @@ void PreferencesPanel::DrawSettings()
 
 void PreferencesPanel::DrawPlugins()
 {
-	Color back = *GameData::Colors().Get("faint");
-	Color medium = *GameData::Colors().Get("medium");
-	Color bright = *GameData::Colors().Get("bright");
+	static const Color &back = *GameData::Colors().Get("faint");
+	static const Color &medium = *GameData::Colors().Get("medium");
+	static const Color &bright = *GameData::Colors().Get("bright");
 	
 	Table table;
 	table.AddColumn(-115, Table::LEFT);
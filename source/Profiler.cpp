@@ -0,0 +1,497 @@
+/* Profiler.cpp
+Copyright (c) 2014 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "Profiler.h"
+
+#include "Audio.h"
+#include "Color.h"
+#include "FillShader.h"
+#include "Files.h"
+#include "Font.h"
+#include "FontSet.h"
+#include "GameData.h"
+#include "Point.h"
+#include "Screen.h"
+#include "SpriteSet.h"
+
+#include "gl_header.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+namespace {
+	const char *const NAMES[Profiler::PHASE_COUNT] = {
+		"Frame",
+		"Game steps",
+		"Engine wait",
+		"Draw panels",
+		"Draw engine",
+		"Audio",
+		"Engine step",
+		"AI",
+		"Ship movement",
+		"Projectile movement",
+		"Ship weapons",
+		"Collisions",
+		"Draw list",
+		"GPU",
+		"Background",
+		"Sprites",
+		"Interface",
+		"Input latency"
+	};
+	const int DEPTH[Profiler::PHASE_COUNT] = {0, 1, 2, 1, 2, 1, 0, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 0};
+	// Keep five seconds of history, at 60 frames per second.
+	const size_t HISTORY = 300;
+	
+	// Time spent in each phase so far in this frame, in nanoseconds. This may
+	// be added to from any thread.
+	atomic<int64_t> pending[Profiler::PHASE_COUNT];
+	
+	// The history is only used from the main thread. Each entry is a time in
+	// milliseconds, and the entries are overwritten in a circle.
+	vector<double> history[Profiler::PHASE_COUNT];
+	size_t nextEntry = 0;
+	// The total time of each phase, in milliseconds, over every frame so far.
+	double totals[Profiler::PHASE_COUNT] = {};
+	int64_t frames = 0;
+	chrono::steady_clock::time_point frameStart = chrono::steady_clock::now();
+	FILE *csv = nullptr;
+	
+	// The metrics file gets one line per second, summarizing the frames drawn
+	// during that second. The engine's object counts are set from its own
+	// thread, so they are atomic.
+	FILE *metrics = nullptr;
+	const char *const COUNT_NAMES[4] = {"ships", "projectiles", "effects", "flotsam"};
+	atomic<int> counts[4];
+	vector<double> second[Profiler::PHASE_COUNT];
+	chrono::steady_clock::time_point metricsStart;
+	chrono::steady_clock::time_point secondStart;
+	
+	// The GPU runs a frame or two behind the main thread, so the timer queries
+	// for each frame are only read back this many frames later. By then they
+	// are finished, and reading them will not stall the pipeline.
+	const int GPU_LATENCY = 3;
+	class GPUTiming {
+	public:
+		Profiler::Phase phase;
+		GLuint start;
+		GLuint end;
+	};
+	vector<GPUTiming> gpuFrames[GPU_LATENCY];
+	vector<GLuint> unusedQueries;
+	int64_t gpuFrame = 0;
+	bool gpuCollected = false;
+	
+	bool HasTimerQueries()
+	{
+		// The Mac OpenGL headers do not report which extensions are present,
+		// and the 3.2 core profile there does not require timer queries.
+#ifdef __APPLE__
+		return false;
+#else
+		return GLEW_ARB_timer_query;
+#endif
+	}
+	
+	// Record the time at which the GPU reaches this point in the commands it
+	// has been given, and return the query that will hold that time.
+	GLuint Timestamp()
+	{
+		GLuint query;
+		if(unusedQueries.empty())
+			glGenQueries(1, &query);
+		else
+		{
+			query = unusedQueries.back();
+			unusedQueries.pop_back();
+		}
+		glQueryCounter(query, GL_TIMESTAMP);
+		return query;
+	}
+	
+	// Read back the queries from the oldest frame, adding their times to the
+	// current frame, and make room for this frame's queries.
+	void CollectGPU()
+	{
+		if(gpuCollected)
+			return;
+		gpuCollected = true;
+		
+		vector<GPUTiming> &timings = gpuFrames[gpuFrame % GPU_LATENCY];
+		for(const GPUTiming &timing : timings)
+		{
+			GLuint64 start = 0;
+			GLuint64 end = 0;
+			glGetQueryObjectui64v(timing.start, GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(timing.end, GL_QUERY_RESULT, &end);
+			if(end > start)
+				Profiler::Add(timing.phase, chrono::nanoseconds(end - start));
+			unusedQueries.push_back(timing.start);
+			unusedQueries.push_back(timing.end);
+		}
+		timings.clear();
+	}
+	
+	// The things whose memory use is shown below the phases. Textures are in
+	// video memory; the rest are in ordinary memory.
+	const int MEMORY_COUNT = 3;
+	const char *const MEMORY_NAMES[MEMORY_COUNT] = {
+		"Textures",
+		"Masks",
+		"Sounds"
+	};
+	
+	// Get the memory used by each of the things listed above, in megabytes.
+	void GetMemory(double megabytes[MEMORY_COUNT])
+	{
+		megabytes[0] = SpriteSet::TextureMemory() / 1048576.;
+		megabytes[1] = SpriteSet::MaskMemory() / 1048576.;
+		megabytes[2] = Audio::Memory() / 1048576.;
+	}
+	
+	// Write one line to the metrics file, summarizing the frames in the second
+	// that just ended, and then forget them.
+	void WriteSecond(chrono::steady_clock::time_point now)
+	{
+		vector<double> &frameTimes = second[Profiler::FRAME];
+		fprintf(metrics, "{\"time\":%.3f,\"frames\":%d",
+			chrono::duration<double>(now - metricsStart).count(), static_cast<int>(frameTimes.size()));
+		
+		// The percentiles of the frame time show stutters that the average hides.
+		sort(frameTimes.begin(), frameTimes.end());
+		static const double PERCENTILES[3] = {.5, .9, .99};
+		static const char *const PERCENTILE_NAMES[3] = {"p50", "p90", "p99"};
+		fprintf(metrics, ",\"frame ms\":{");
+		for(int i = 0; i < 3; ++i)
+			fprintf(metrics, "\"%s\":%.3f,", PERCENTILE_NAMES[i],
+				frameTimes[min(frameTimes.size() - 1, static_cast<size_t>(PERCENTILES[i] * frameTimes.size()))]);
+		fprintf(metrics, "\"max\":%.3f}", frameTimes.back());
+		
+		fprintf(metrics, ",\"phase ms\":{");
+		for(int i = 0; i < Profiler::PHASE_COUNT; ++i)
+		{
+			double sum = 0.;
+			for(double time : second[i])
+				sum += time;
+			fprintf(metrics, (i ? ",\"%s\":%.3f" : "\"%s\":%.3f"), NAMES[i], sum / second[i].size());
+			second[i].clear();
+		}
+		fprintf(metrics, "}");
+		
+		for(int i = 0; i < 4; ++i)
+			fprintf(metrics, ",\"%s\":%d", COUNT_NAMES[i], counts[i].load());
+		fprintf(metrics, ",\"voices\":%d", Audio::Voices());
+		
+		double megabytes[MEMORY_COUNT];
+		GetMemory(megabytes);
+		fprintf(metrics, ",\"memory MB\":{");
+		for(int i = 0; i < MEMORY_COUNT; ++i)
+			fprintf(metrics, (i ? ",\"%s\":%.1f" : "\"%s\":%.1f"), MEMORY_NAMES[i], megabytes[i]);
+		fprintf(metrics, "}}\n");
+		// Flush each line, so that anything following the file sees it at once.
+		fflush(metrics);
+	}
+}
+
+
+
+// Time a phase for as long as this object exists.
+Profiler::Scope::Scope(Phase phase)
+	: phase(phase), start(chrono::steady_clock::now())
+{
+}
+
+
+
+Profiler::Scope::~Scope()
+{
+	End();
+}
+
+
+
+// Stop timing the current phase and begin timing the given one.
+void Profiler::Scope::Next(Phase phase)
+{
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	if(this->phase != PHASE_COUNT)
+		Add(this->phase, now - start);
+	this->phase = phase;
+	start = now;
+}
+
+
+
+// Stop timing before this object is destroyed.
+void Profiler::Scope::End()
+{
+	if(phase != PHASE_COUNT)
+		Add(phase, chrono::steady_clock::now() - start);
+	phase = PHASE_COUNT;
+}
+
+
+
+// Time one of the GPU phases for as long as this object exists.
+Profiler::GPUScope::GPUScope(Phase phase)
+	: phase(PHASE_COUNT), start(0)
+{
+	if(HasTimerQueries())
+		Next(phase);
+}
+
+
+
+Profiler::GPUScope::~GPUScope()
+{
+	End();
+}
+
+
+
+// Stop timing the current phase and begin timing the given one.
+void Profiler::GPUScope::Next(Phase phase)
+{
+	if(!HasTimerQueries())
+		return;
+	
+	CollectGPU();
+	GLuint now = Timestamp();
+	if(this->phase != PHASE_COUNT)
+		gpuFrames[gpuFrame % GPU_LATENCY].push_back(GPUTiming{this->phase, start, now});
+	this->phase = phase;
+	start = now;
+}
+
+
+
+// Stop timing before this object is destroyed.
+void Profiler::GPUScope::End()
+{
+	if(phase == PHASE_COUNT)
+		return;
+	
+	gpuFrames[gpuFrame % GPU_LATENCY].push_back(GPUTiming{phase, start, Timestamp()});
+	phase = PHASE_COUNT;
+}
+
+
+
+// Add time to the given phase in the current frame.
+void Profiler::Add(Phase phase, chrono::steady_clock::duration time)
+{
+	pending[phase] += chrono::duration_cast<chrono::nanoseconds>(time).count();
+}
+
+
+
+// End the current frame, adding its totals to the history.
+void Profiler::EndFrame()
+{
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	Add(FRAME, now - frameStart);
+	frameStart = now;
+	
+	for(int i = 0; i < PHASE_COUNT; ++i)
+	{
+		double time = pending[i].exchange(0) * .000001;
+		if(history[i].size() < HISTORY)
+			history[i].push_back(time);
+		else
+			history[i][nextEntry] = time;
+		totals[i] += time;
+		
+		if(csv)
+			fprintf(csv, (i + 1 < PHASE_COUNT) ? "%.3f," : "%.3f\n", time);
+		if(metrics)
+			second[i].push_back(time);
+	}
+	nextEntry = (nextEntry + 1) % HISTORY;
+	++frames;
+	
+	if(metrics && now - secondStart >= chrono::seconds(1))
+	{
+		WriteSecond(now);
+		secondStart = now;
+	}
+	
+	// The next frame's GPU queries go in the next slot, once the ones already
+	// there have been read back.
+	++gpuFrame;
+	gpuCollected = false;
+}
+
+
+
+// Get the time the given phase took in the most recent frame, in
+// milliseconds. GPU phases are measured a few frames after they happen.
+double Profiler::Latest(Phase phase)
+{
+	if(history[phase].empty())
+		return 0.;
+	
+	return history[phase][(nextEntry + HISTORY - 1) % HISTORY];
+}
+
+
+
+// Forget all the frames so far, and start timing a new one.
+void Profiler::Reset()
+{
+	for(int i = 0; i < PHASE_COUNT; ++i)
+	{
+		pending[i] = 0;
+		history[i].clear();
+		totals[i] = 0.;
+	}
+	nextEntry = 0;
+	frames = 0;
+	frameStart = chrono::steady_clock::now();
+}
+
+
+
+// Draw the overlay showing the recent time taken by each phase, and how much
+// memory the loaded sprites and sounds take up.
+void Profiler::Draw()
+{
+	if(history[FRAME].empty())
+		return;
+	
+	const Font &font = FontSet::Get(14);
+	const Color &dim = *GameData::Colors().Get("medium");
+	const Color &bright = *GameData::Colors().Get("bright");
+	static const double LINE_HEIGHT = 20.;
+	static const double COLUMN_WIDTH = 60.;
+	static const double WIDTH = 180. + 3. * COLUMN_WIDTH;
+	
+	Point corner = Screen::TopRight() + Point(-WIDTH - 10., 10.);
+	Point size(WIDTH + 10., LINE_HEIGHT * (PHASE_COUNT + MEMORY_COUNT + 2) + 10.);
+	FillShader::Fill(corner + .5 * size - Point(5., 5.), size, Color(0., .8));
+	
+	// Draw the column headings. The numbers are right-aligned in each column.
+	Point point = corner;
+	static const char *const HEADINGS[3] = {"min", "avg", "p99"};
+	font.Draw("ms", point, bright);
+	for(int column = 0; column < 3; ++column)
+	{
+		double right = 180. + COLUMN_WIDTH * (column + 1);
+		font.Draw(HEADINGS[column], point + Point(right - font.Width(HEADINGS[column]), 0.), bright);
+	}
+	
+	vector<double> sorted;
+	for(int i = 0; i < PHASE_COUNT; ++i)
+	{
+		point.Y() += LINE_HEIGHT;
+		font.Draw(NAMES[i], point + Point(15. * DEPTH[i], 0.), DEPTH[i] ? dim : bright);
+		
+		sorted = history[i];
+		sort(sorted.begin(), sorted.end());
+		double sum = 0.;
+		for(double time : sorted)
+			sum += time;
+		double values[3] = {
+			sorted.front(),
+			sum / sorted.size(),
+			sorted[min(sorted.size() - 1, static_cast<size_t>(.99 * sorted.size()))]
+		};
+		for(int column = 0; column < 3; ++column)
+		{
+			char text[16];
+			snprintf(text, sizeof(text), "%.2f", values[column]);
+			double right = 180. + COLUMN_WIDTH * (column + 1);
+			font.Draw(text, point + Point(right - font.Width(text), 0.), DEPTH[i] ? dim : bright);
+		}
+	}
+	
+	// Below the phases, show how much memory the loaded resources take up.
+	point.Y() += LINE_HEIGHT;
+	font.Draw("MB", point, bright);
+	double megabytes[MEMORY_COUNT];
+	GetMemory(megabytes);
+	for(int i = 0; i < MEMORY_COUNT; ++i)
+	{
+		point.Y() += LINE_HEIGHT;
+		font.Draw(MEMORY_NAMES[i], point + Point(15., 0.), dim);
+		
+		char text[16];
+		snprintf(text, sizeof(text), "%.1f", megabytes[i]);
+		double right = 180. + COLUMN_WIDTH * 3;
+		font.Draw(text, point + Point(right - font.Width(text), 0.), dim);
+	}
+}
+
+
+
+// Begin writing the totals for each frame to the given file.
+void Profiler::WriteCSV(const string &path)
+{
+	if(csv)
+		fclose(csv);
+	csv = Files::Open(path, true);
+	if(!csv)
+		return;
+	
+	for(int i = 0; i < PHASE_COUNT; ++i)
+		fprintf(csv, (i + 1 < PHASE_COUNT) ? "%s," : "%s\n", NAMES[i]);
+}
+
+
+
+// Begin writing a summary of each second of frames to the given file, as
+// one JSON object per line.
+void Profiler::WriteMetrics(const string &path)
+{
+	if(metrics)
+		fclose(metrics);
+	metrics = Files::Open(path, true);
+	for(vector<double> &times : second)
+		times.clear();
+	metricsStart = chrono::steady_clock::now();
+	secondStart = metricsStart;
+}
+
+
+
+// Record how many objects the engine is simulating, to be reported in the
+// metrics. This may be called from any thread.
+void Profiler::SetCounts(int ships, int projectiles, int effects, int flotsam)
+{
+	counts[0].store(ships, memory_order_relaxed);
+	counts[1].store(projectiles, memory_order_relaxed);
+	counts[2].store(effects, memory_order_relaxed);
+	counts[3].store(flotsam, memory_order_relaxed);
+}
+
+
+
+// Print the total and average time of each phase over all the frames so
+// far, and the memory used by sprites and sounds, to standard output.
+void Profiler::PrintTotals()
+{
+	printf("%-24s%12s%12s\n", "phase", "total ms", "avg ms");
+	for(int i = 0; i < PHASE_COUNT; ++i)
+		printf("%*s%-*s%12.1f%12.4f\n", 2 * DEPTH[i], "", 24 - 2 * DEPTH[i], NAMES[i],
+			totals[i], frames ? totals[i] / frames : 0.);
+	
+	printf("\n%-24s%12s\n", "memory", "MB");
+	double megabytes[MEMORY_COUNT];
+	GetMemory(megabytes);
+	for(int i = 0; i < MEMORY_COUNT; ++i)
+		printf("  %-22s%12.1f\n", MEMORY_NAMES[i], megabytes[i]);
+}
@@ -0,0 +1,129 @@
+/* Profiler.h
+Copyright (c) 2014 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <chrono>
+#include <string>
+
+
+
+// Class for measuring how much time each phase of the game loop takes. Each
+// frame, the time spent in each phase is added up, and a rolling history of
+// those totals is kept so that the minimum, average, and 99th percentile time
+// of each phase can be shown in an overlay. The totals for each frame can also
+// be written to a CSV file for later analysis, or summarized once a second in
+// a metrics file that a monitoring tool can follow as it grows. Phases may be timed from any
+// thread; the engine's calculations, for example, are timed in its own thread.
+// The time the graphics card spends drawing is measured separately, with
+// OpenGL timer queries, and is reported a few frames after it happens.
+class Profiler {
+public:
+	// The phases, in the order they are shown. Each phase other than FRAME,
+	// CALCULATE, GPU_PANELS and INPUT_LATENCY is part of the one above it that
+	// has less indentation. ENGINE_WAIT is how long the main thread is stalled
+	// waiting for the engine's calculation thread to finish a step, and
+	// INPUT_LATENCY is how old the keyboard input behind the frame being drawn
+	// is by the time it is drawn.
+	enum Phase {
+		FRAME,
+			GAME_STEPS,
+				ENGINE_WAIT,
+			DRAW_PANELS,
+				DRAW_ENGINE,
+			AUDIO,
+		CALCULATE,
+			AI_STEP,
+			SHIP_MOVE,
+			PROJECTILE_MOVE,
+			SHIP_FIRE,
+			COLLISION,
+			DRAW_LIST,
+		GPU_PANELS,
+			GPU_BACKGROUND,
+			GPU_SPRITES,
+			GPU_HUD,
+		INPUT_LATENCY,
+		PHASE_COUNT
+	};
+	
+	// Time a phase for as long as this object exists.
+	class Scope {
+	public:
+		explicit Scope(Phase phase);
+		Scope(const Scope &) = delete;
+		~Scope();
+		
+		Scope &operator=(const Scope &) = delete;
+		
+		// Stop timing the current phase and begin timing the given one.
+		void Next(Phase phase);
+		// Stop timing before this object is destroyed.
+		void End();
+	
+	private:
+		Phase phase;
+		std::chrono::steady_clock::time_point start;
+	};
+	
+	// Time one of the GPU phases for as long as this object exists. This must
+	// only be used in the main thread, while it has the OpenGL context. If the
+	// driver does not support timer queries, this does nothing.
+	class GPUScope {
+	public:
+		explicit GPUScope(Phase phase);
+		GPUScope(const GPUScope &) = delete;
+		~GPUScope();
+		
+		GPUScope &operator=(const GPUScope &) = delete;
+		
+		// Stop timing the current phase and begin timing the given one.
+		void Next(Phase phase);
+		// Stop timing before this object is destroyed.
+		void End();
+	
+	private:
+		Phase phase;
+		unsigned start;
+	};
+	
+	
+public:
+	// Add time to the given phase in the current frame.
+	static void Add(Phase phase, std::chrono::steady_clock::duration time);
+	// End the current frame, adding its totals to the history.
+	static void EndFrame();
+	// Get the time the given phase took in the most recent frame, in
+	// milliseconds. GPU phases are measured a few frames after they happen.
+	static double Latest(Phase phase);
+	// Forget all the frames so far, and start timing a new one.
+	static void Reset();
+	// Draw the overlay showing the recent time taken by each phase, and how much
+	// memory the loaded sprites and sounds take up.
+	static void Draw();
+	// Begin writing the totals for each frame to the given file.
+	static void WriteCSV(const std::string &path);
+	// Begin writing a summary of each second of frames to the given file, as
+	// one JSON object per line.
+	static void WriteMetrics(const std::string &path);
+	// Record how many objects the engine is simulating, to be reported in the
+	// metrics. This may be called from any thread.
+	static void SetCounts(int ships, int projectiles, int effects, int flotsam);
+	// Print the total and average time of each phase over all the frames so
+	// far, and the memory used by sprites and sounds, to standard output.
+	static void PrintTotals();
+};
+
+
+
+#endif
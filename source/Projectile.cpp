@@ -22,6 +22,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 #include <algorithm>
 #include <cmath>
+#include <functional>
 
 using namespace std;
 
@@ -32,6 +33,14 @@ namespace {
 	{
 		return (Random::Real() < base * pow(probability, .2));
 	}
+	
+	// Check whether projectiles of the given weapon just fly in a straight line
+	// at a constant speed, with nothing that needs to be checked each step.
+	bool IsSimple(const Outfit &weapon)
+	{
+		return !weapon.Homing() && !weapon.Turn() && !weapon.Acceleration()
+			&& !weapon.SplitRange() && weapon.LiveEffects().empty();
+	}
 }
 
 
@@ -58,6 +67,7 @@ Projectile::Projectile(const Ship &parent, Point position, Angle angle, const Ou
 	// If a random lifetime is specified, add a random amount up to that amount.
 	if(weapon->RandomLifetime())
 		lifetime += Random::Int(weapon->RandomLifetime() + 1);
+	isSimple = IsSimple(*weapon);
 }
 
 
@@ -86,6 +96,7 @@ Projectile::Projectile(const Projectile &parent, const Outfit *weapon)
 	// If a random lifetime is specified, add a random amount up to that amount.
 	if(weapon->RandomLifetime())
 		lifetime += Random::Int(weapon->RandomLifetime() + 1);
+	isSimple = IsSimple(*weapon);
 }
 
 
@@ -100,7 +111,49 @@ Projectile::Projectile(Point position, const Outfit *weapon)
 
 
 // This returns false if it is time to delete this projectile.
-bool Projectile::Move(list<Effect> &effects)
+// Stop tracking any target that has been destroyed, has left the system,
+// or has been captured by a different government. The projectiles are
+// grouped by target, so each ship is checked once no matter how many
+// projectiles are tracking it.
+void Projectile::UpdateTargets(vector<Projectile> &projectiles, vector<pair<const Ship *, Projectile *>> &tracking)
+{
+	// Ships are only ever deleted by this same thread, so if a target has not
+	// expired the cached pointer is still valid, and there is no need to lock
+	// it. A new ship may have been created where a deleted one used to be, so
+	// each projectile must check its own target before it can be grouped with
+	// the others by that address.
+	tracking.clear();
+	for(Projectile &projectile : projectiles)
+		if(projectile.cachedTarget)
+		{
+			if(projectile.targetShip.expired())
+				projectile.cachedTarget = nullptr;
+			else
+				tracking.emplace_back(projectile.cachedTarget, &projectile);
+		}
+	sort(tracking.begin(), tracking.end(),
+		[](const pair<const Ship *, Projectile *> &a, const pair<const Ship *, Projectile *> &b)
+		{
+			return less<const Ship *>()(a.first, b.first);
+		});
+	
+	for(auto it = tracking.begin(); it != tracking.end(); )
+	{
+		const Ship *target = it->first;
+		bool isTargetable = target->IsTargetable();
+		const Government *government = target->GetGovernment();
+		for( ; it != tracking.end() && it->first == target; ++it)
+			if(!isTargetable || it->second->targetGovernment != government)
+			{
+				it->second->targetShip.reset();
+				it->second->cachedTarget = nullptr;
+			}
+	}
+}
+
+
+
+bool Projectile::Move(vector<Effect> &effects)
 {
 	if(--lifetime <= 0)
 	{
@@ -123,18 +176,14 @@ bool Projectile::Move(list<Effect> &effects)
 			effects.back().Place(position, velocity, angle);
 		}
 	
-	// If the target has left the system, stop following it. Also stop if the
-	// target has been captured by a different government.
+	// UpdateTargets() has already dropped any target that is no longer valid.
 	const Ship *target = cachedTarget;
-	if(target)
+	
+	// Most projectiles fly straight ahead, so skip all the guidance for them.
+	if(isSimple)
 	{
-		target = targetShip.lock().get();
-		if(!target || !target->IsTargetable() || target->GetGovernment() != targetGovernment)
-		{
-			targetShip.reset();
-			cachedTarget = nullptr;
-			target = nullptr;
-		}
+		position += velocity;
+		return true;
 	}
 	
 	double turn = weapon->Turn();
@@ -225,10 +274,10 @@ bool Projectile::Move(list<Effect> &effects)
 
 // This is called when a projectile "dies," either of natural causes or
 // because it hit its target.
-void Projectile::MakeSubmunitions(list<Projectile> &projectiles) const
+void Projectile::MakeSubmunitions(vector<Projectile> &projectiles) const
 {
 	// Only make submunitions if you did *not* hit a target.
-	if(lifetime <= -100)
+	if(lifetime <= -100 || !weapon->SubmunitionCount())
 		return;
 	
 	for(const auto &it : weapon->Submunitions())
@@ -240,7 +289,7 @@ void Projectile::MakeSubmunitions(list<Projectile> &projectiles) const
 
 // This projectile hit something. Create the explosion, if any. This also
 // marks the projectile as needing deletion.
-void Projectile::Explode(list<Effect> &effects, double intersection, Point hitVelocity)
+void Projectile::Explode(vector<Effect> &effects, double intersection, Point hitVelocity)
 {
 	for(const auto &it : weapon->HitEffects())
 		for(int i = 0; i < it.second; ++i)
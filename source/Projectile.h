@@ -17,8 +17,9 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Body.h"
 #include "Point.h"
 
-#include <list>
 #include <memory>
+#include <utility>
+#include <vector>
 
 class Effect;
 class Government;
@@ -49,14 +50,21 @@ public:
 	const Government *GetGovernment() const;
 	*/
 	
+	// Stop tracking any target that has been destroyed, has left the system,
+	// or has been captured by a different government. The projectiles are
+	// grouped by target, so each ship is checked once no matter how many
+	// projectiles are tracking it. This must be done before they move. The
+	// given vector is scratch space, kept by the caller so that it is not
+	// reallocated every step.
+	static void UpdateTargets(std::vector<Projectile> &projectiles, std::vector<std::pair<const Ship *, Projectile *>> &tracking);
 	// This returns false if it is time to delete this projectile.
-	bool Move(std::list<Effect> &effects);
+	bool Move(std::vector<Effect> &effects);
 	// This is called when a projectile "dies," either of natural causes or
 	// because it hit its target.
-	void MakeSubmunitions(std::list<Projectile> &projectiles) const;
+	void MakeSubmunitions(std::vector<Projectile> &projectiles) const;
 	// This projectile hit something. Create the explosion, if any. This also
 	// marks the projectile as needing deletion.
-	void Explode(std::list<Effect> &effects, double intersection, Point hitVelocity = Point());
+	void Explode(std::vector<Effect> &effects, double intersection, Point hitVelocity = Point());
 	// This projectile was killed, e.g. by an anti-missile system.
 	void Kill();
 	
@@ -84,6 +92,9 @@ private:
 	
 	int lifetime = 0;
 	bool hasLock = true;
+	// Whether this projectile just flies in a straight line, so Move() does
+	// not need to check its target or steer it.
+	bool isSimple = false;
 };
 
 
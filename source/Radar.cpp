@@ -15,6 +15,10 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "PointerShader.h"
 #include "RingShader.h"
 
+#include <cmath>
+#include <set>
+#include <tuple>
+
 using namespace std;
 
 const int Radar::PLAYER = 0;
@@ -41,8 +45,11 @@ namespace {
 
 
 
-void Radar::Clear()
+// Clear the radar. If it will not be drawn, nothing is added to it until it
+// is cleared again.
+void Radar::Clear(bool isShown)
 {
+	this->isShown = isShown;
 	objects.clear();
 	pointers.clear();
 }
@@ -60,10 +67,10 @@ void Radar::SetCenter(const Point &center)
 // given position should be in world units (not shrunk to radar units).
 void Radar::Add(int type, Point position, double outer, double inner)
 {
-	if(type < 0 || type >= SIZE)
+	if(!isShown || type < 0 || type >= SIZE)
 		return;
 	
-	objects.emplace_back(color[type].Opaque(), position - center, outer, inner);
+	objects.emplace_back(type, position - center, outer, inner);
 }
 
 
@@ -71,7 +78,7 @@ void Radar::Add(int type, Point position, double outer, double inner)
 // Add a pointer, pointing in the direction of the given vector.
 void Radar::AddPointer(int type, const Point &position)
 {
-	if(type < 0 || type >= SIZE)
+	if(!isShown || type < 0 || type >= SIZE)
 		return;
 	
 	pointers.emplace_back(color[type], position.Unit());
@@ -82,13 +89,24 @@ void Radar::AddPointer(int type, const Point &position)
 // Draw the radar display at the given coordinates.
 void Radar::Draw(const Point &center, double scale, double radius, double pointerRadius) const
 {
+	// Anything beyond the edge of the radar is drawn on its rim, so in a big
+	// battle many blips may land on the same spot there. Only draw one blip of
+	// each type and size on each pixel of the rim.
+	set<tuple<int, int, int, double, double>> onRim;
+	
 	RingShader::Bind();
 	for(const Object &object : objects)
 	{
 		Point position = object.position * scale;
 		double length = position.Length();
 		if(length > radius)
+		{
 			position *= radius / length;
+			auto key = make_tuple(static_cast<int>(round(position.X())), static_cast<int>(round(position.Y())),
+				object.type, object.outer, object.inner);
+			if(!onRim.insert(key).second)
+				continue;
+		}
 		position += center;
 		
 		RingShader::Add(position, object.outer, object.inner, object.color);
@@ -113,8 +131,8 @@ const Color &Radar::GetColor(int type)
 
 
 
-Radar::Object::Object(const Color &color, const Point &pos, double out, double in)
-	: color(color), position(pos), outer(out), inner(in)
+Radar::Object::Object(int type, const Point &pos, double out, double in)
+	: type(type), color(GetColor(type).Opaque()), position(pos), outer(out), inner(in)
 {
 }
 
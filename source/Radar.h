@@ -34,7 +34,9 @@ public:
 	static const int ANOMALOUS;
 	
 public:
-	void Clear();
+	// Clear the radar. If it will not be drawn, nothing is added to it until it
+	// is cleared again.
+	void Clear(bool isShown = true);
 	void SetCenter(const Point &center);
 	
 	// Add an object. If "inner" is 0 it is a dot; otherwise, it is a ring. The
@@ -53,8 +55,9 @@ public:
 private:
 	class Object {
 	public:
-		Object(const Color &color, const Point &pos, double out, double in);
+		Object(int type, const Point &pos, double out, double in);
 		
+		int type;
 		Color color;
 		Point position;
 		double outer;
@@ -72,6 +75,7 @@ private:
 	
 private:
 	Point center;
+	bool isShown = true;
 	std::vector<Object> objects;
 	std::vector<Pointer> pointers;
 };
@@ -13,46 +13,83 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Random.h"
 
 #include <random>
-
-#ifndef __linux__
-#include <mutex>
-#endif
+#include <sstream>
 
 using namespace std;
 
-// Right now thread_local storage is only supported under Linux.
 namespace {
-#ifndef __linux__
-	mutex workaroundMutex;
-	mt19937_64 gen;
-	uniform_int_distribution<uint32_t> uniform;
-	uniform_real_distribution<double> real;
-#else
 	thread_local mt19937_64 gen;
 	thread_local uniform_int_distribution<uint32_t> uniform;
 	thread_local uniform_real_distribution<double> real;
-#endif
 }
 
 
 
-// Seed the generator (e.g. to make it produce exactly the same random
-// numbers it produced previously).
+// Seed this thread's generator (e.g. to make it produce exactly the same
+// random numbers it produced previously).
 void Random::Seed(uint64_t seed)
 {
-#ifndef __linux__
-	lock_guard<mutex> lock(workaroundMutex);
-#endif
 	gen.seed(seed);
 }
 
 
 
+// Seed this thread's generator for one of several separate streams of random
+// numbers that share the given seed, e.g. one for each batch of a parallel
+// loop. Each stream produces the same numbers no matter which thread it is
+// drawn on.
+void Random::Seed(uint64_t seed, uint64_t stream)
+{
+	// Mix the stream index into the seed (using the "splitmix64" finalizer) so
+	// that neighboring streams do not start from similar states.
+	uint64_t x = seed + (stream + 1) * 0x9E3779B97F4A7C15ull;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+	gen.seed(x ^ (x >> 31));
+}
+
+
+
+// Get a seed to use for a new set of streams.
+uint64_t Random::NewSeed()
+{
+	return gen();
+}
+
+
+
+// Get the next number this thread's generator will produce, without using
+// it up. This is for checking that two runs are in the same state.
+uint64_t Random::Peek()
+{
+	mt19937_64 copy = gen;
+	return copy();
+}
+
+
+
+// Get the complete state of this thread's generator, or put it back in a
+// state that was saved earlier, so that it goes on to produce the same
+// numbers that it did after that state was saved.
+string Random::State()
+{
+	ostringstream out;
+	out << gen;
+	return out.str();
+}
+
+
+
+void Random::SetState(const string &state)
+{
+	istringstream in(state);
+	in >> gen;
+}
+
+
+
 uint32_t Random::Int()
 {
-#ifndef __linux__
-	lock_guard<mutex> lock(workaroundMutex);
-#endif
 	return uniform(gen);
 }
 
@@ -60,9 +97,6 @@ uint32_t Random::Int()
 
 uint32_t Random::Int(uint32_t modulus)
 {
-#ifndef __linux__
-	lock_guard<mutex> lock(workaroundMutex);
-#endif
 	return uniform(gen) % modulus;
 }
 
@@ -70,9 +104,6 @@ uint32_t Random::Int(uint32_t modulus)
 
 double Random::Real()
 {
-#ifndef __linux__
-	lock_guard<mutex> lock(workaroundMutex);
-#endif
 	return real(gen);
 }
 
@@ -83,9 +114,6 @@ double Random::Real()
 uint32_t Random::Polya(uint32_t k, double p)
 {
 	negative_binomial_distribution<uint32_t> polya(k, p);
-#ifndef __linux__
-	lock_guard<mutex> lock(workaroundMutex);
-#endif
 	return polya(gen);
 }
 
@@ -95,9 +123,6 @@ uint32_t Random::Polya(uint32_t k, double p)
 uint32_t Random::Binomial(uint32_t t, double p)
 {
 	binomial_distribution<uint32_t> binomial(t, p);
-#ifndef __linux__
-	lock_guard<mutex> lock(workaroundMutex);
-#endif
 	return binomial(gen);
 }
 
@@ -107,8 +132,5 @@ uint32_t Random::Binomial(uint32_t t, double p)
 double Random::Normal()
 {
 	normal_distribution<double> normal;
-#ifndef __linux__
-	lock_guard<mutex> lock(workaroundMutex);
-#endif
 	return normal(gen);
 }
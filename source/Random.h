@@ -14,17 +14,33 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #define RANDOM_H_
 
 #include <cstdint>
+#include <string>
 
 
 
 // Collection of functions for generating random numbers with a variety of
-// different distributions. (This is done partly because on some systems the
-// random number generation is not thread-safe.)
+// different distributions. Each thread has its own generator, so threads never
+// have to wait for each other to get a random number.
 class Random {
 public:
-	// Seed the generator (e.g. to make it produce exactly the same random
-	// numbers it produced previously).
+	// Seed this thread's generator (e.g. to make it produce exactly the same
+	// random numbers it produced previously).
 	static void Seed(uint64_t seed);
+	// Seed this thread's generator for one of several separate streams of
+	// random numbers that share the given seed, e.g. one for each batch of a
+	// parallel loop. Each stream produces the same numbers no matter which
+	// thread it is drawn on.
+	static void Seed(uint64_t seed, uint64_t stream);
+	// Get a seed to use for a new set of streams.
+	static uint64_t NewSeed();
+	// Get the next number this thread's generator will produce, without using
+	// it up. This is for checking that two runs are in the same state.
+	static uint64_t Peek();
+	// Get the complete state of this thread's generator, or put it back in a
+	// state that was saved earlier, so that it goes on to produce the same
+	// numbers that it did after that state was saved.
+	static std::string State();
+	static void SetState(const std::string &state);
 	
 	static uint32_t Int();
 	static uint32_t Int(uint32_t modulus);
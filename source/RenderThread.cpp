@@ -0,0 +1,149 @@
+/* RenderThread.cpp
+Copyright (c) 2014 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "RenderThread.h"
+
+#include "CurrentThread.h"
+#include "Preferences.h"
+
+#include <SDL2/SDL.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+namespace {
+	SDL_Window *window = nullptr;
+	SDL_GLContext context = nullptr;
+	
+	thread renderThread;
+	mutex swapMutex;
+	condition_variable swapCondition;
+	// Whether a frame has been handed to the render thread and is not on the
+	// screen yet. This is protected by the mutex.
+	bool isSwapping = false;
+	// Whether the render thread should exit. This is protected by the mutex.
+	bool isDone = false;
+	// Whether the main thread has the OpenGL context. This is only used by the
+	// main thread, so it needs no protection.
+	bool hasContext = true;
+	
+	
+	
+	// Each time the main thread hands over a frame, take the context, swap the
+	// buffers, and give the context up again.
+	void Swap()
+	{
+		CurrentThread::SetName("es-render");
+		CurrentThread::RaisePriority();
+		unique_lock<mutex> lock(swapMutex);
+		while(true)
+		{
+			while(!isSwapping && !isDone)
+				swapCondition.wait(lock);
+			if(!isSwapping)
+				break;
+			
+			lock.unlock();
+			SDL_GL_MakeCurrent(window, context);
+			SDL_GL_SwapWindow(window);
+			SDL_GL_MakeCurrent(window, nullptr);
+			lock.lock();
+			
+			isSwapping = false;
+			swapCondition.notify_all();
+		}
+	}
+}
+
+
+
+// Set the window that frames are drawn in. Its OpenGL context must be current
+// in the calling thread, which must be the main thread.
+void RenderThread::Init(SDL_Window *window)
+{
+	::window = window;
+	context = SDL_GL_GetCurrentContext();
+	hasContext = true;
+}
+
+
+
+// The main thread is done drawing a frame. Put it on the screen.
+void RenderThread::Present()
+{
+	// Start or stop the render thread if the preference has changed. On OS X,
+	// windows may only be used from the main thread.
+#ifdef __APPLE__
+	bool useThread = false;
+#else
+	bool useThread = Preferences::Has("Render in a separate thread");
+#endif
+	if(!useThread && renderThread.joinable())
+		Quit();
+	if(!useThread)
+	{
+		SDL_GL_SwapWindow(window);
+		return;
+	}
+	if(!renderThread.joinable())
+		renderThread = thread(&Swap);
+	
+	// A context can only be current in one thread at a time, so release it
+	// before handing the frame over.
+	SDL_GL_MakeCurrent(window, nullptr);
+	hasContext = false;
+	{
+		lock_guard<mutex> lock(swapMutex);
+		isSwapping = true;
+	}
+	swapCondition.notify_all();
+}
+
+
+
+// Wait until the last frame is on the screen, and make the OpenGL context
+// current in the main thread again. This does nothing if the main thread
+// already has the context, so it is safe to call before any OpenGL call.
+void RenderThread::Acquire()
+{
+	if(hasContext)
+		return;
+	
+	{
+		unique_lock<mutex> lock(swapMutex);
+		while(isSwapping)
+			swapCondition.wait(lock);
+	}
+	SDL_GL_MakeCurrent(window, context);
+	hasContext = true;
+}
+
+
+
+// Stop the render thread, if it is running, and take back the context.
+void RenderThread::Quit()
+{
+	Acquire();
+	if(!renderThread.joinable())
+		return;
+	
+	{
+		lock_guard<mutex> lock(swapMutex);
+		isDone = true;
+	}
+	swapCondition.notify_all();
+	renderThread.join();
+	isDone = false;
+}
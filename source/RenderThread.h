@@ -0,0 +1,46 @@
+/* RenderThread.h
+Copyright (c) 2014 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef RENDER_THREAD_H_
+#define RENDER_THREAD_H_
+
+struct SDL_Window;
+
+
+
+// Class for putting each finished frame on the screen from a separate thread.
+// Swapping the window's buffers is where the graphics driver does most of its
+// work, and with vsync it may also block until the next refresh; meanwhile the
+// main thread can go on to handle the next frame's events and game steps. The
+// OpenGL context can only be current in one thread at a time, so the render
+// thread has it only while it is swapping, and anything in the main thread that
+// uses OpenGL must call Acquire() first to take it back. This is only done if
+// the "Render in a separate thread" preference is set; otherwise, Present()
+// simply swaps the buffers right away.
+class RenderThread {
+public:
+	// Set the window that frames are drawn in. Its OpenGL context must be
+	// current in the calling thread, which must be the main thread.
+	static void Init(SDL_Window *window);
+	// The main thread is done drawing a frame. Put it on the screen.
+	static void Present();
+	// Wait until the last frame is on the screen, and make the OpenGL context
+	// current in the main thread again. This does nothing if the main thread
+	// already has the context, so it is safe to call before any OpenGL call.
+	static void Acquire();
+	// Stop the render thread, if it is running, and take back the context.
+	static void Quit();
+};
+
+
+
+#endif
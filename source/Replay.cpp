@@ -0,0 +1,476 @@
+/* Replay.cpp
+Copyright (c) 2014 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "Replay.h"
+
+#include "DataFile.h"
+#include "DataNode.h"
+#include "DataWriter.h"
+#include "Engine.h"
+#include "PlayerInfo.h"
+#include "Preferences.h"
+#include "Random.h"
+#include "ShipEvent.h"
+
+#include <cmath>
+#include <ctime>
+#include <map>
+#include <vector>
+
+using namespace std;
+
+namespace {
+	// Positions and zoom levels are recorded as a whole number of fractions of
+	// this size, so that they can be written to the file exactly.
+	const double SCALE = 1024.;
+	
+	// The preferences that change how the player's ships behave.
+	const char *const PREFERENCES[] = {
+		"Automatic firing",
+		"Automatic aiming",
+		"Escorts expend ammo",
+		"Escorts use ammo frugally"
+	};
+	
+	// One change in the player's input, at the given step. In the file, this
+	// is a line with the type, the step, the name (if any), and the values.
+	class Entry {
+	public:
+		string type;
+		int step;
+		string name;
+		vector<int64_t> values;
+	};
+	
+	string recordPath;
+	bool isRecordPending = false;
+	bool isRecording = false;
+	bool isPlaying = false;
+	bool isBeginning = false;
+	
+	uint64_t seed = 0;
+	int firstStep = 0;
+	// The number of steps recorded or played back so far.
+	int steps = 0;
+	// The number of steps in the replay that is being played back.
+	int totalSteps = 0;
+	bool didGo = false;
+	// When playing, whether the last step was followed by a pause, and the
+	// first step after the current pause.
+	bool isPaused = false;
+	int pauseEnd = 0;
+	
+	vector<Entry> entries;
+	size_t nextEntry = 0;
+	// The most recent "pause" entry, if any.
+	size_t lastPause = 0;
+	// The input as of the last step. When recording, this is compared to the
+	// next step's input to see what changed; when playing, only the changes are
+	// applied to it.
+	Replay::Input last;
+	map<string, bool> lastPreferences;
+	// The player's own preferences, to restore after playing a replay.
+	map<string, bool> savedPreferences;
+	
+	
+	
+	int64_t Fixed(double value)
+	{
+		return llround(value * SCALE);
+	}
+	
+	
+	
+	double Unfixed(int64_t value)
+	{
+		return value / SCALE;
+	}
+	
+	
+	
+	// Round a value to what will be written to the file, so that recording and
+	// playback both use exactly the same value.
+	void Quantize(double &value)
+	{
+		value = Unfixed(Fixed(value));
+	}
+	
+	
+	
+	void Quantize(Point &point)
+	{
+		Quantize(point.X());
+		Quantize(point.Y());
+	}
+	
+	
+	
+	void Add(const string &type, const vector<int64_t> &values, const string &name = "")
+	{
+		entries.push_back({type, steps, name, values});
+	}
+	
+	
+	
+	// Note that the engine did not calculate anything after the given step,
+	// e.g. because a dialog was open. Consecutive pauses are recorded as one
+	// entry with a count, since a dialog may be open for quite a while.
+	void AddPause(int step)
+	{
+		if(lastPause < entries.size() && entries[lastPause].step + entries[lastPause].values[0] == step)
+			++entries[lastPause].values[0];
+		else
+		{
+			lastPause = entries.size();
+			entries.push_back({"pause", step, "", {1}});
+		}
+	}
+	
+	
+	
+	// Get the seed to use for the given step. The engine's calculations use
+	// their own stream of seeds, because they run in a different thread.
+	uint64_t StepSeed(int step, bool isCalculation)
+	{
+		return seed + 2 * static_cast<uint64_t>(step) + isCalculation;
+	}
+	
+	
+	
+	void RestorePreferences()
+	{
+		for(const auto &it : savedPreferences)
+			Preferences::Set(it.first, it.second);
+		savedPreferences.clear();
+	}
+}
+
+
+
+// Begin recording to the given file the next time the player takes off.
+void Replay::Record(const string &path)
+{
+	recordPath = path;
+	isRecordPending = true;
+}
+
+
+
+// Load the pilot from the given replay file, and get ready to play it back.
+bool Replay::Load(const string &path, PlayerInfo &player)
+{
+	DataFile file(path);
+	const DataNode *replay = nullptr;
+	for(const DataNode &node : file)
+		if(node.Token(0) == "replay")
+			replay = &node;
+	if(!replay)
+		return false;
+	
+	entries.clear();
+	seed = 0;
+	firstStep = 0;
+	totalSteps = 0;
+	for(const DataNode &child : *replay)
+	{
+		if(child.Token(0) == "seed" && child.Size() >= 2)
+			seed = child.Value(1);
+		else if(child.Token(0) == "first step" && child.Size() >= 2)
+			firstStep = child.Value(1);
+		else if(child.Token(0) == "steps" && child.Size() >= 2)
+			totalSteps = child.Value(1);
+		else if(child.Size() >= 2)
+		{
+			Entry entry;
+			entry.type = child.Token(0);
+			entry.step = child.Value(1);
+			int i = 2;
+			if(entry.type == "preference" && child.Size() >= 3)
+				entry.name = child.Token(i++);
+			for( ; i < child.Size(); ++i)
+				entry.values.push_back(child.Value(i));
+			entries.push_back(entry);
+		}
+		else
+			child.PrintTrace("Skipping unrecognized replay attribute:");
+	}
+	
+	// The replay file is also a saved game, which ignores the "replay" node.
+	player.Load(path);
+	player.ApplyChanges();
+	
+	// Playing a replay must not change the player's own preferences.
+	for(const char *name : PREFERENCES)
+		savedPreferences[name] = Preferences::Has(name);
+	
+	isPlaying = true;
+	isRecordPending = false;
+	return true;
+}
+
+
+
+// The player is about to take off.
+void Replay::Begin(const PlayerInfo &player)
+{
+	// A recording only covers one flight.
+	if(isRecording)
+		End();
+	
+	if(isRecordPending)
+	{
+		isRecordPending = false;
+		isRecording = true;
+		seed = Random::Int() ^ static_cast<uint32_t>(time(nullptr));
+		entries.clear();
+		lastPause = 0;
+		lastPreferences.clear();
+		player.Save(recordPath);
+	}
+	else if(!isPlaying)
+		return;
+	
+	isBeginning = true;
+	steps = 0;
+	nextEntry = 0;
+	didGo = false;
+	isPaused = false;
+	pauseEnd = 0;
+	last = Input();
+	Random::Seed(seed);
+}
+
+
+
+// Stop recording and write the replay file, or stop playing.
+void Replay::End()
+{
+	if(isPlaying)
+	{
+		RestorePreferences();
+		isPlaying = false;
+	}
+	if(!isRecording)
+		return;
+	
+	isRecording = false;
+	if(steps && !didGo)
+		AddPause(steps - 1);
+	
+	// The saved game was written in the background, so wait for it and then
+	// read it back in order to write it to the same file as the input.
+	DataWriter::FinishSaving();
+	DataFile start(recordPath);
+	DataWriter out(recordPath);
+	for(const DataNode &node : start)
+		if(node.Token(0) != "replay")
+			out.Write(node);
+	
+	out.Write("replay");
+	out.BeginChild();
+	{
+		out.Write("seed", seed);
+		out.Write("first step", firstStep);
+		out.Write("steps", steps);
+		for(const Entry &entry : entries)
+		{
+			out.WriteToken(entry.type);
+			out.WriteToken(entry.step);
+			if(!entry.name.empty())
+				out.WriteToken(entry.name);
+			for(int64_t value : entry.values)
+				out.WriteToken(value);
+			out.Write();
+		}
+	}
+	out.EndChild();
+	entries.clear();
+}
+
+
+
+bool Replay::IsRecording()
+{
+	return isRecording;
+}
+
+
+
+bool Replay::IsPlaying()
+{
+	return isPlaying;
+}
+
+
+
+// Check if the engine has not yet taken a step since Begin().
+bool Replay::IsBeginning()
+{
+	return isBeginning;
+}
+
+
+
+// Check if every step of the replay has been played.
+bool Replay::IsFinished()
+{
+	return isPlaying && steps >= totalSteps;
+}
+
+
+
+// Get the step number the engine should start at.
+int Replay::FirstStep(int step)
+{
+	if(isRecording)
+		firstStep = step;
+	return firstStep;
+}
+
+
+
+// Record the input for this step, or replace it with the recorded input.
+void Replay::Step(Input &input)
+{
+	isBeginning = false;
+	if(isRecording)
+	{
+		if(steps && !didGo)
+			AddPause(steps - 1);
+		didGo = false;
+		
+		Quantize(input.zoom);
+		Quantize(input.zoomTarget);
+		Quantize(input.clickPoint);
+		Point from = input.clickBox.TopLeft();
+		Point to = input.clickBox.BottomRight();
+		Quantize(from);
+		Quantize(to);
+		input.clickBox = Rectangle::WithCorners(from, to);
+		
+		if(!steps || input.keys.Bits() != last.keys.Bits() || input.shift != last.shift)
+			Add("keys", {static_cast<int64_t>(input.keys.Bits()), input.shift});
+		if(!steps || input.isActive != last.isActive)
+			Add("active", {input.isActive});
+		if(!steps || input.zoom != last.zoom || input.zoomTarget != last.zoomTarget)
+			Add("zoom", {Fixed(input.zoom), Fixed(input.zoomTarget)});
+		if(input.hasClick && input.isRightClick)
+			Add("right click", {Fixed(input.clickPoint.X()), Fixed(input.clickPoint.Y())});
+		else if(input.hasClick)
+			Add("click", {input.clickShift, Fixed(input.clickPoint.X()), Fixed(input.clickPoint.Y()),
+				Fixed(from.X()), Fixed(from.Y()), Fixed(to.X()), Fixed(to.Y())});
+		if(input.group >= 0)
+			Add("group", {input.group, input.groupShift, input.groupControl});
+		for(const char *name : PREFERENCES)
+		{
+			bool value = Preferences::Has(name);
+			auto it = lastPreferences.find(name);
+			if(it == lastPreferences.end() || it->second != value)
+			{
+				lastPreferences[name] = value;
+				Add("preference", {value}, name);
+			}
+		}
+		last = input;
+	}
+	else if(isPlaying)
+	{
+		// Clicks only last for one step, but everything else stays the same
+		// until it is changed.
+		last.hasClick = false;
+		last.group = -1;
+		for( ; nextEntry < entries.size() && entries[nextEntry].step <= steps; ++nextEntry)
+		{
+			const Entry &entry = entries[nextEntry];
+			const vector<int64_t> &v = entry.values;
+			if(entry.type == "keys" && v.size() >= 2)
+			{
+				last.keys = Command::FromBits(v[0]);
+				last.shift = v[1];
+			}
+			else if(entry.type == "active" && v.size() >= 1)
+				last.isActive = v[0];
+			else if(entry.type == "zoom" && v.size() >= 2)
+			{
+				last.zoom = Unfixed(v[0]);
+				last.zoomTarget = Unfixed(v[1]);
+			}
+			else if(entry.type == "right click" && v.size() >= 2)
+			{
+				last.hasClick = true;
+				last.isRightClick = true;
+				last.clickShift = false;
+				last.clickPoint = Point(Unfixed(v[0]), Unfixed(v[1]));
+			}
+			else if(entry.type == "click" && v.size() >= 7)
+			{
+				last.hasClick = true;
+				last.isRightClick = false;
+				last.clickShift = v[0];
+				last.clickPoint = Point(Unfixed(v[1]), Unfixed(v[2]));
+				last.clickBox = Rectangle::WithCorners(
+					Point(Unfixed(v[3]), Unfixed(v[4])), Point(Unfixed(v[5]), Unfixed(v[6])));
+			}
+			else if(entry.type == "group" && v.size() >= 3)
+			{
+				last.group = v[0];
+				last.groupShift = v[1];
+				last.groupControl = v[2];
+			}
+			else if(entry.type == "preference" && v.size() >= 1)
+				Preferences::Set(entry.name, v[0]);
+			else if(entry.type == "pause" && v.size() >= 1)
+				pauseEnd = entry.step + v[0];
+		}
+		isPaused = (steps < pauseEnd);
+		input = last;
+	}
+	else
+		return;
+	
+	Random::Seed(StepSeed(steps, false));
+	++steps;
+}
+
+
+
+// Note that the engine began calculating after the last step.
+void Replay::Go()
+{
+	didGo = true;
+}
+
+
+
+// Get the seed for the engine's calculations after the last step.
+uint64_t Replay::CalculationSeed()
+{
+	return StepSeed(steps - 1, true);
+}
+
+
+
+// Take the next step of playback in the given engine.
+bool Replay::PlayStep(Engine &engine, PlayerInfo &player)
+{
+	engine.Wait();
+	if(!isPlaying || IsFinished())
+		return false;
+	
+	// The engine gets whether it is active from the replay.
+	engine.Step(true);
+	for(const ShipEvent &event : engine.Events())
+		player.HandleEvent(event, nullptr);
+	if(!isPaused)
+		engine.Go();
+	return true;
+}
@@ -0,0 +1,100 @@
+/* Replay.h
+Copyright (c) 2014 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include "Command.h"
+#include "Point.h"
+#include "Rectangle.h"
+
+#include <cstdint>
+#include <string>
+
+class Engine;
+class PlayerInfo;
+
+
+
+// Class for recording what the player does during one flight, from taking off
+// until landing or quitting, so that exactly the same flight can be played back
+// later, either drawn on the screen or headless as part of a benchmark. The
+// replay file is a saved game of the pilot just before taking off, followed by
+// a "replay" node with the random seed and the input given to the engine in
+// each step. Only changes to the input are written, so the file stays small.
+// Dialogs and other panels that were shown during the flight are not part of
+// the replay, except for how they paused the engine; in particular, choices
+// made in conversations or while boarding a ship are not played back.
+class Replay {
+public:
+	// Everything the player does that affects one call to Engine::Step().
+	class Input {
+	public:
+		Command keys;
+		bool shift = false;
+		bool isActive = false;
+		double zoom = 1.;
+		double zoomTarget = 1.;
+		// A click since the last step, if any, as Engine::Click() or RClick()
+		// stored it.
+		bool hasClick = false;
+		bool isRightClick = false;
+		bool clickShift = false;
+		Point clickPoint;
+		Rectangle clickBox;
+		// A group selection since the last step, if any.
+		int group = -1;
+		bool groupShift = false;
+		bool groupControl = false;
+	};
+	
+	
+public:
+	// Begin recording to the given file the next time the player takes off.
+	static void Record(const std::string &path);
+	// Load the pilot from the given replay file, and get ready to play back
+	// what was recorded. This returns false if the file is not a replay.
+	static bool Load(const std::string &path, PlayerInfo &player);
+	
+	// The player is about to take off. If a recording or playback is due to
+	// begin, this saves the pilot (when recording) and seeds Random.
+	static void Begin(const PlayerInfo &player);
+	// Stop recording and write the replay file, or stop playing.
+	static void End();
+	
+	static bool IsRecording();
+	static bool IsPlaying();
+	// Check if the engine has not yet taken a step since Begin().
+	static bool IsBeginning();
+	// Check if every step of the replay has been played.
+	static bool IsFinished();
+	
+	// When the replay begins, get the step number the engine should start at
+	// (which matters for anything animated, like the ships' collision masks).
+	static int FirstStep(int step);
+	// Record the input for this step, or replace it with the recorded input,
+	// and seed Random for this step.
+	static void Step(Input &input);
+	// Note that the engine began calculating after the last step.
+	static void Go();
+	// Get the seed for the engine's calculations after the last step.
+	static uint64_t CalculationSeed();
+	
+	// Take the next step of playback in the given engine, once it is done with
+	// its previous calculations. Any events are given to the player, but no
+	// dialogs are shown. This returns false once the replay is over.
+	static bool PlayStep(Engine &engine, PlayerInfo &player);
+};
+
+
+
+#endif
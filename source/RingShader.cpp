@@ -17,24 +17,44 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Point.h"
 #include "Screen.h"
 #include "Shader.h"
+#include "StreamBuffer.h"
 
 #include <stdexcept>
+#include <vector>
 
 using namespace std;
 
 namespace {
 	Shader shader;
 	GLint scaleI;
+	
+	GLint vertI;
 	GLint positionI;
-	GLint radiusI;
-	GLint widthI;
-	GLint angleI;
-	GLint startAngleI;
-	GLint dashI;
+	GLint sizeI;
+	GLint arcI;
 	GLint colorI;
 	
 	GLuint vao;
-	GLuint vbo;
+	
+	// Each ring is drawn as two triangles. Every vertex holds a copy of all the
+	// ring's parameters, so that any number of rings can be drawn at once.
+	const int FLOATS = 13;
+	const GLfloat CORNERS[12] = {
+		-1.f, -1.f,
+		-1.f,  1.f,
+		 1.f, -1.f,
+		-1.f,  1.f,
+		 1.f, -1.f,
+		 1.f,  1.f
+	};
+	vector<GLfloat> vertices;
+	
+	void Attrib(GLint index, int size, int offset, GLintptr start)
+	{
+		glEnableVertexAttribArray(index);
+		glVertexAttribPointer(index, size, GL_FLOAT, GL_FALSE, FLOATS * sizeof(GLfloat),
+			(const GLvoid*)(start + offset * sizeof(GLfloat)));
+	}
 }
 
 
@@ -43,32 +63,40 @@ void RingShader::Init()
 {
 	static const char *vertexCode =
 		"uniform vec2 scale;\n"
-		"uniform vec2 position;\n"
-		"uniform float radius;\n"
-		"uniform float width;\n"
 		
 		"in vec2 vert;\n"
+		"in vec2 position;\n"
+		"in vec2 size;\n"
+		"in vec3 arc;\n"
+		"in vec4 color;\n"
 		"out vec2 coord;\n"
+		"flat out vec2 ringSize;\n"
+		"flat out vec3 ringArc;\n"
+		"flat out vec4 ringColor;\n"
 		
 		"void main() {\n"
-		"  coord = (radius + width) * vert;\n"
+		"  ringSize = size;\n"
+		"  ringArc = arc;\n"
+		"  ringColor = color;\n"
+		"  coord = (size.x + size.y) * vert;\n"
 		"  gl_Position = vec4((coord + position) * scale, 0, 1);\n"
 		"}\n";
 
 	static const char *fragmentCode =
-		"uniform vec4 color = vec4(1, 1, 1, 1);\n"
-		"uniform float radius;\n"
-		"uniform float width;\n"
-		"uniform float angle;\n"
-		"uniform float startAngle;\n"
-		"uniform float dash;\n"
 		"const float pi = 3.1415926535897932384626433832795;\n"
 		
 		"in vec2 coord;\n"
+		"flat in vec2 ringSize;\n"
+		"flat in vec3 ringArc;\n"
+		"flat in vec4 ringColor;\n"
 		"out vec4 finalColor;\n"
 		
 		"void main() {\n"
-		"  float arc = mod(atan(coord.x, coord.y) + pi + startAngle, 2 * pi);\n"
+		"  float radius = ringSize.x;\n"
+		"  float width = ringSize.y;\n"
+		"  float angle = ringArc.x;\n"
+		"  float dash = ringArc.z;\n"
+		"  float arc = mod(atan(coord.x, coord.y) + pi + ringArc.y, 2 * pi);\n"
 		"  float arcFalloff = 1 - min(2 * pi - arc, arc - angle) * radius;\n"
 		"  if(dash != 0)\n"
 		"  {\n"
@@ -78,40 +106,21 @@ void RingShader::Init()
 		"  float len = length(coord);\n"
 		"  float lenFalloff = width - abs(len - radius);\n"
 		"  float alpha = clamp(min(arcFalloff, lenFalloff), 0, 1);\n"
-		"  finalColor = color * alpha;\n"
+		"  finalColor = ringColor * alpha;\n"
 		"}\n";
 	
 	shader = Shader(vertexCode, fragmentCode);
 	scaleI = shader.Uniform("scale");
-	positionI = shader.Uniform("position");
-	radiusI = shader.Uniform("radius");
-	widthI = shader.Uniform("width");
-	angleI = shader.Uniform("angle");
-	startAngleI = shader.Uniform("startAngle");
-	dashI = shader.Uniform("dash");
-	colorI = shader.Uniform("color");
-	
-	// Generate the vertex data for drawing sprites.
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
 	
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	vertI = shader.Attrib("vert");
+	positionI = shader.Attrib("position");
+	sizeI = shader.Attrib("size");
+	arcI = shader.Attrib("arc");
+	colorI = shader.Attrib("color");
 	
-	GLfloat vertexData[] = {
-		-1.f, -1.f,
-		-1.f,  1.f,
-		 1.f, -1.f,
-		 1.f,  1.f
-	};
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertexData), vertexData, GL_STATIC_DRAW);
-	
-	glEnableVertexAttribArray(shader.Attrib("vert"));
-	glVertexAttribPointer(shader.Attrib("vert"), 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), nullptr);
-	
-	// unbind the VBO and VAO
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	// The vertex data is streamed in each time rings are drawn, so the VAO
+	// only needs to remember which attributes are enabled.
+	glGenVertexArrays(1, &vao);
 }
 
 
@@ -140,11 +149,7 @@ void RingShader::Bind()
 	if(!shader.Object())
 		throw runtime_error("RingShader: Bind() called before Init().");
 	
-	glUseProgram(shader.Object());
-	glBindVertexArray(vao);
-	
-	GLfloat scale[2] = {2.f / Screen::Width(), -2.f / Screen::Height()};
-	glUniform2fv(scaleI, 1, scale);
+	vertices.clear();
 }
 
 
@@ -159,24 +164,60 @@ void RingShader::Add(const Point &pos, float out, float in, const Color &color)
 
 void RingShader::Add(const Point &pos, float radius, float width, float fraction, const Color &color, float dash, float startAngle)
 {
-	GLfloat position[2] = {static_cast<float>(pos.X()), static_cast<float>(pos.Y())};
-	glUniform2fv(positionI, 1, position);
-	
-	glUniform1f(radiusI, radius);
-	glUniform1f(widthI, width);
-	glUniform1f(angleI, fraction * 2. * PI);
-	glUniform1f(startAngleI, startAngle * TO_RAD);
-	glUniform1f(dashI, dash ? 2. * PI / dash : 0.);
-	
-	glUniform4fv(colorI, 1, color.Get());
-	
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	Add(vertices, pos, radius, width, fraction, color, dash, startAngle);
 }
 
 
 
 void RingShader::Unbind()
 {
-	glBindVertexArray(0);
-	glUseProgram(0);
+	Draw(vertices);
+	vertices.clear();
+}
+
+
+
+// Record the vertices of a ring in the given list, without drawing it. This
+// does not touch OpenGL, so it can be done in any thread, and the whole
+// list can be drawn later, in the drawing thread, in a single call.
+void RingShader::Add(vector<float> &batch, const Point &pos, float radius, float width, float fraction, const Color &color, float dash, float startAngle)
+{
+	const float *c = color.Get();
+	GLfloat data[FLOATS - 2] = {
+		static_cast<float>(pos.X()), static_cast<float>(pos.Y()),
+		radius, width,
+		static_cast<float>(fraction * 2. * PI),
+		static_cast<float>(startAngle * TO_RAD),
+		static_cast<float>(dash ? 2. * PI / dash : 0.),
+		c[0], c[1], c[2], c[3]
+	};
+	for(int i = 0; i < 12; i += 2)
+	{
+		batch.insert(batch.end(), CORNERS + i, CORNERS + i + 2);
+		batch.insert(batch.end(), data, data + FLOATS - 2);
+	}
+}
+
+
+
+void RingShader::Draw(const vector<float> &batch)
+{
+	if(batch.empty())
+		return;
+	
+	shader.Use();
+	Shader::BindVertexArray(vao);
+	
+	GLfloat scale[2] = {2.f / Screen::Width(), -2.f / Screen::Height()};
+	glUniform2fv(scaleI, 1, scale);
+	
+	GLintptr start = StreamBuffer::Upload(batch.data(), batch.size() * sizeof(GLfloat));
+	Attrib(vertI, 2, 0, start);
+	Attrib(positionI, 2, 2, start);
+	Attrib(sizeI, 2, 4, start);
+	Attrib(arcI, 3, 6, start);
+	Attrib(colorI, 4, 9, start);
+	glDrawArrays(GL_TRIANGLES, 0, batch.size() / FLOATS);
+	
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
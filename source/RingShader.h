@@ -13,6 +13,8 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #ifndef RING_SHADER_H_
 #define RING_SHADER_H_
 
+#include <vector>
+
 class Color;
 class Point;
 
@@ -31,6 +33,12 @@ public:
 	static void Add(const Point &pos, float out, float in, const Color &color);
 	static void Add(const Point &pos, float radius, float width, float fraction, const Color &color, float dash = 0.f, float startAngle = 0.f);
 	static void Unbind();
+	
+	// Record the vertices of a ring in the given list, without drawing it. This
+	// does not touch OpenGL, so it can be done in any thread, and the whole
+	// list can be drawn later, in the drawing thread, in a single call.
+	static void Add(std::vector<float> &batch, const Point &pos, float radius, float width, float fraction, const Color &color, float dash = 0.f, float startAngle = 0.f);
+	static void Draw(const std::vector<float> &batch);
 };
 
 
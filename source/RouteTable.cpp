@@ -0,0 +1,236 @@
+/* RouteTable.cpp
+Copyright (c) 2017 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "RouteTable.h"
+
+#include "DistanceMap.h"
+#include "GameData.h"
+#include "Mission.h"
+#include "Planet.h"
+#include "PlayerInfo.h"
+#include "Ship.h"
+#include "System.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+
+namespace {
+	// Routes depend on the destination, the fuel each type of drive uses, and
+	// which of the wormholes with special requirements a ship can use. Maps
+	// of the routes a player knows about also depend on what systems and
+	// planets they have visited, and what their missions have revealed.
+	class CacheKey {
+	public:
+		bool operator<(const CacheKey &other) const
+		{
+			return tie(destination, hyperdriveFuel, jumpDriveFuel, useWormholes, wormholes, player, knowledge, systems, planets)
+				< tie(other.destination, other.hyperdriveFuel, other.jumpDriveFuel, other.useWormholes,
+					other.wormholes, other.player, other.knowledge, other.systems, other.planets);
+		}
+		
+		const System *destination = nullptr;
+		int hyperdriveFuel = 100;
+		int jumpDriveFuel = 0;
+		bool useWormholes = false;
+		vector<bool> wormholes;
+		
+		const PlayerInfo *player = nullptr;
+		int knowledge = 0;
+		set<const System *> systems;
+		set<const Planet *> planets;
+	};
+	
+	// Route queries come from both the main thread and the AI.
+	mutex routeMutex;
+	
+	// Once this many maps are cached, start a new cache. Anything that is not
+	// used again before that one fills up is dropped.
+	const size_t CACHE_SIZE = 200;
+	map<CacheKey, shared_ptr<const DistanceMap>> recent;
+	map<CacheKey, shared_ptr<const DistanceMap>> older;
+	
+	// Wormholes that only some ships can use. This is found the first time it
+	// is needed after the table is invalidated.
+	vector<const Planet *> restricted;
+	bool hasRestricted = false;
+	
+	// Look up the given key. If it is not cached, create the map using the
+	// given function.
+	template <class Create>
+	shared_ptr<const DistanceMap> Get(const CacheKey &key, Create create)
+	{
+		auto it = recent.find(key);
+		if(it != recent.end())
+			return it->second;
+		
+		if(recent.size() >= CACHE_SIZE)
+		{
+			older.swap(recent);
+			recent.clear();
+		}
+		it = older.find(key);
+		if(it != older.end())
+		{
+			it = recent.insert(*it).first;
+			older.erase(key);
+			return it->second;
+		}
+		
+		return recent.emplace(key, create()).first->second;
+	}
+	
+	// Get the key for routes to (or from) the given system, for a ship with
+	// the same capabilities as the given one.
+	CacheKey ShipKey(const Ship &ship, const System *destination)
+	{
+		if(!hasRestricted)
+		{
+			for(const auto &it : GameData::Planets())
+				if(it.second.IsWormhole() && !it.second.IsAccessible(nullptr))
+					restricted.push_back(&it.second);
+			hasRestricted = true;
+		}
+		
+		// This must match how DistanceMap decides which drives a ship can use.
+		CacheKey key;
+		key.destination = destination;
+		key.hyperdriveFuel = ship.HyperdriveFuel();
+		key.jumpDriveFuel = ship.JumpDriveFuel();
+		if(key.hyperdriveFuel == key.jumpDriveFuel)
+			key.hyperdriveFuel = 0;
+		key.useWormholes = true;
+		for(const Planet *planet : restricted)
+			key.wormholes.push_back(planet->IsAccessible(&ship));
+		return key;
+	}
+	
+	// Add the systems that the given mission reveals to the player.
+	void AddKnown(const Mission &mission, CacheKey &key)
+	{
+		for(const System *system : mission.Waypoints())
+			key.systems.insert(system);
+		for(const Planet *planet : mission.Stopovers())
+			key.planets.insert(planet);
+		key.planets.insert(mission.Destination());
+	}
+}
+
+
+
+// Discard all the cached routes.
+void RouteTable::Invalidate()
+{
+	lock_guard<mutex> lock(routeMutex);
+	recent.clear();
+	older.clear();
+	restricted.clear();
+	hasRestricted = false;
+}
+
+
+
+// Get the next system the given ship should jump to, in order to reach
+// the given destination. Returns null if there is no route.
+const System *RouteTable::Route(const Ship &ship, const System *destination)
+{
+	if(!ship.GetSystem() || !destination)
+		return nullptr;
+	
+	lock_guard<mutex> lock(routeMutex);
+	shared_ptr<const DistanceMap> distance = Get(ShipKey(ship, destination), [&ship, destination]()
+	{
+		return make_shared<DistanceMap>(ship, destination, true);
+	});
+	return distance->Route(ship.GetSystem());
+}
+
+
+
+// Get the number of jumps between the given systems using hyperspace links
+// only, or -1 if there is no such route.
+int RouteTable::Days(const System *from, const System *to)
+{
+	if(!from || !to)
+		return -1;
+	
+	lock_guard<mutex> lock(routeMutex);
+	CacheKey key;
+	key.destination = from;
+	shared_ptr<const DistanceMap> distance = Get(key, [from]()
+	{
+		return make_shared<DistanceMap>(from);
+	});
+	return distance->Days(to);
+}
+
+
+
+// Get every system that is at most the given number of jumps from the given one
+// using hyperspace links only, in order of System::Index().
+vector<const System *> RouteTable::Within(const System *from, int maxDays)
+{
+	vector<const System *> result;
+	if(!from || maxDays < 0)
+		return result;
+	
+	lock_guard<mutex> lock(routeMutex);
+	CacheKey key;
+	key.destination = from;
+	shared_ptr<const DistanceMap> distance = Get(key, [from]()
+	{
+		return make_shared<DistanceMap>(from);
+	});
+	// The systems are already in order of their indices.
+	for(const auto &it : GameData::Systems())
+	{
+		int days = distance->Days(&it.second);
+		if(days >= 0 && days <= maxDays)
+			result.push_back(&it.second);
+	}
+	return result;
+}
+
+
+
+// Get the routes from the given system that the player knows about, using
+// their flagship's drives. If no system is given, the routes start from
+// wherever the flagship is, or is jumping to.
+DistanceMap RouteTable::Known(const PlayerInfo &player, const System *center)
+{
+	const Ship *flagship = player.Flagship();
+	if(flagship && !center)
+		center = flagship->IsEnteringHyperspace() ? flagship->GetTargetSystem() : flagship->GetSystem();
+	if(!flagship || !center)
+		return DistanceMap(player, center);
+	
+	lock_guard<mutex> lock(routeMutex);
+	CacheKey key = ShipKey(*flagship, center);
+	key.player = &player;
+	key.knowledge = player.KnowledgeVersion();
+	for(const Mission &mission : player.AvailableJobs())
+		AddKnown(mission, key);
+	for(const Mission &mission : player.Missions())
+		if(mission.IsVisible())
+			AddKnown(mission, key);
+	
+	shared_ptr<const DistanceMap> distance = Get(key, [&player, center]()
+	{
+		return make_shared<DistanceMap>(player, center);
+	});
+	return *distance;
+}
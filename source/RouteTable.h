@@ -0,0 +1,54 @@
+/* RouteTable.h
+Copyright (c) 2017 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef ROUTE_TABLE_H_
+#define ROUTE_TABLE_H_
+
+#include "DistanceMap.h"
+
+#include <vector>
+
+class PlayerInfo;
+class Ship;
+class System;
+
+
+
+// This is a cache of the routes found by DistanceMap: for AI ships traveling
+// to meet their parents, for the distances used for choosing mission
+// destinations, and for the routes the player knows about. The routes to each
+// destination are found the first time they are needed, and shared by every
+// ship with the same travel capabilities. Any change to the map (systems,
+// links, or wormholes) must invalidate the table.
+class RouteTable {
+public:
+	// Discard all the cached routes.
+	static void Invalidate();
+	
+	// Get the next system the given ship should jump to, in order to reach
+	// the given destination. Returns null if there is no route.
+	static const System *Route(const Ship &ship, const System *destination);
+	// Get the number of jumps between the given systems using hyperspace links
+	// only, or -1 if there is no such route.
+	static int Days(const System *from, const System *to);
+	// Get every system that is at most the given number of jumps from the given
+	// one using hyperspace links only, in order of System::Index().
+	static std::vector<const System *> Within(const System *from, int maxDays);
+	// Get the routes from the given system that the player knows about, using
+	// their flagship's drives. If no system is given, the routes start from
+	// wherever the flagship is, or is jumping to.
+	static DistanceMap Known(const PlayerInfo &player, const System *center = nullptr);
+};
+
+
+
+#endif
@@ -0,0 +1,341 @@
+/* SaveJournal.cpp
+Copyright (c) 2014 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "SaveJournal.h"
+
+#include "Files.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace {
+	// Compact the journal into a new snapshot once it is half the size of the
+	// snapshot, or once loading it would mean replaying this many records.
+	const int MAX_RECORDS = 100;
+	
+	// A saved file, split into its root nodes (along with their children).
+	// Node i is the text from starts[i] to starts[i + 1].
+	class Version {
+	public:
+		Version() = default;
+		explicit Version(const string &text);
+		
+		size_t Size() const { return hashes.size(); }
+		const char *Begin(size_t i) const { return text.data() + starts[i]; }
+		size_t Length(size_t i) const { return starts[i + 1] - starts[i]; }
+		bool Equal(size_t i, const Version &other, size_t j) const;
+		
+		string text;
+		vector<size_t> starts;
+		vector<uint64_t> hashes;
+	};
+	
+	// What is known about each file that has been saved this session.
+	struct Journal {
+		// The latest version of the file, which the next record will apply to.
+		Version latest;
+		// The hash and size of the snapshot, and the size of the journal.
+		uint64_t snapshotHash = 0;
+		size_t snapshotSize = 0;
+		size_t size = 0;
+		int records = 0;
+	};
+	mutex journalMutex;
+	map<string, Journal> journals;
+	
+	
+	
+	string JournalPath(const string &path)
+	{
+		return path + ".journal";
+	}
+	
+	
+	
+	// FNV-1a hash, used to check which snapshot a journal belongs to and to
+	// quickly find nodes that may be unchanged.
+	uint64_t Hash(const char *it, const char *end)
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		for( ; it != end; ++it)
+			hash = (hash ^ static_cast<unsigned char>(*it)) * 1099511628211ULL;
+		return hash;
+	}
+	
+	
+	
+	Version::Version(const string &text)
+		: text(text)
+	{
+		// A new root node begins with any line that is not indented.
+		if(!text.empty())
+			starts.push_back(0);
+		for(size_t i = 0; i + 1 < text.size(); ++i)
+			if(text[i] == '\n' && text[i + 1] != '\t' && text[i + 1] != ' ')
+				starts.push_back(i + 1);
+		starts.push_back(text.size());
+		
+		hashes.reserve(starts.size() - 1);
+		for(size_t i = 0; i + 1 < starts.size(); ++i)
+			hashes.push_back(Hash(Begin(i), Begin(i) + Length(i)));
+	}
+	
+	
+	
+	bool Version::Equal(size_t i, const Version &other, size_t j) const
+	{
+		return hashes[i] == other.hashes[j] && Length(i) == other.Length(j)
+			&& !memcmp(Begin(i), other.Begin(j), Length(i));
+	}
+	
+	
+	
+	// Describe the new version in terms of the old one. The record is a list of
+	// "copy <first> <count>" lines, referring to runs of the old nodes, and
+	// "text <bytes>" lines, followed by the text of nodes that are new.
+	string Diff(const Version &from, const Version &to)
+	{
+		// Find the first copy of each node in the old version.
+		unordered_map<uint64_t, size_t> index;
+		for(size_t i = from.Size(); i--; )
+			index[from.hashes[i]] = i;
+		
+		ostringstream out;
+		out << "delta\n";
+		size_t copyStart = 0;
+		size_t copyCount = 0;
+		string literal;
+		auto flush = [&]()
+		{
+			if(copyCount)
+				out << "copy " << copyStart << ' ' << copyCount << '\n';
+			if(!literal.empty())
+				out << "text " << literal.size() << '\n' << literal;
+			copyCount = 0;
+			literal.clear();
+		};
+		for(size_t j = 0; j < to.Size(); ++j)
+		{
+			// The most common case is that this node is the same as the one
+			// after the last node that was copied.
+			size_t next = copyStart + copyCount;
+			if(copyCount && next < from.Size() && from.Equal(next, to, j))
+			{
+				++copyCount;
+				continue;
+			}
+			auto it = index.find(to.hashes[j]);
+			if(it != index.end() && from.Equal(it->second, to, j))
+			{
+				flush();
+				copyStart = it->second;
+				copyCount = 1;
+			}
+			else
+			{
+				if(copyCount)
+					flush();
+				literal.append(to.Begin(j), to.Length(j));
+			}
+		}
+		flush();
+		out << "end\n";
+		return out.str();
+	}
+	
+	
+	
+	// Read one line of a journal, advancing past it.
+	bool ReadLine(const char *&it, const char *end, string &line)
+	{
+		const char *next = static_cast<const char *>(memchr(it, '\n', end - it));
+		if(!next)
+			return false;
+		line.assign(it, next);
+		it = next + 1;
+		return true;
+	}
+	
+	
+	
+	// Apply one record of the journal to the given version of the file. If the
+	// record is incomplete (e.g. the game quit while it was being written) or
+	// otherwise invalid, return false and leave the text unchanged.
+	bool Apply(const char *&it, const char *end, string &text)
+	{
+		Version from(text);
+		string result;
+		string line;
+		const char *pos = it;
+		if(!ReadLine(pos, end, line) || line != "delta")
+			return false;
+		while(ReadLine(pos, end, line))
+		{
+			if(line == "end")
+			{
+				text.swap(result);
+				it = pos;
+				return true;
+			}
+			if(!line.compare(0, 5, "copy "))
+			{
+				char *rest = nullptr;
+				size_t first = strtoull(line.c_str() + 5, &rest, 10);
+				size_t count = strtoull(rest, nullptr, 10);
+				if(first + count > from.Size() || first + count < first)
+					return false;
+				for(size_t i = first; i < first + count; ++i)
+					result.append(from.Begin(i), from.Length(i));
+			}
+			else if(!line.compare(0, 5, "text "))
+			{
+				size_t size = strtoull(line.c_str() + 5, nullptr, 10);
+				if(size > static_cast<size_t>(end - pos))
+					return false;
+				result.append(pos, size);
+				pos += size;
+			}
+			else
+				return false;
+		}
+		return false;
+	}
+	
+	
+	
+	// Read the snapshot, decompressing it if necessary.
+	string ReadSnapshot(const string &path)
+	{
+		string text = Files::Read(path);
+		if(Files::IsCompressed(text.data(), text.data() + text.size()))
+			text = Files::Decompress(text.data(), text.data() + text.size());
+		return text;
+	}
+}
+
+
+
+// Try to save the given text by appending to the file's journal.
+bool SaveJournal::Append(const string &path, const string &text)
+{
+	lock_guard<mutex> lock(journalMutex);
+	auto it = journals.find(path);
+	// The first time this file is saved, there is no way to know what version
+	// of it is on disk without reading it, so just write it in full.
+	if(it == journals.end() || !Files::Exists(path))
+		return false;
+	
+	Journal &journal = it->second;
+	Version version(text);
+	string record = Diff(journal.latest, version);
+	if(journal.records >= MAX_RECORDS || 2 * (journal.size + record.size()) > journal.snapshotSize)
+		return false;
+	
+	// The journal begins with the hash of the snapshot it applies to.
+	if(!journal.size)
+		record = "journal " + to_string(journal.snapshotHash) + "\n" + record;
+	
+	if(journal.size)
+		Files::Append(JournalPath(path), record);
+	else
+		Files::WriteBinary(JournalPath(path), record);
+	journal.size += record.size();
+	++journal.records;
+	journal.latest = move(version);
+	return true;
+}
+
+
+
+// Remember that the given text was just written as the file's snapshot.
+void SaveJournal::Reset(const string &path, const string &text)
+{
+	lock_guard<mutex> lock(journalMutex);
+	Files::Delete(JournalPath(path));
+	
+	Journal &journal = journals[path];
+	journal.latest = Version(text);
+	journal.snapshotHash = Hash(text.data(), text.data() + text.size());
+	journal.snapshotSize = text.size();
+	journal.size = 0;
+	journal.records = 0;
+}
+
+
+
+// Read the current text of the given file, with any journaled changes.
+string SaveJournal::Read(const string &path)
+{
+	string text = ReadSnapshot(path);
+	string data = Files::Read(JournalPath(path));
+	const char *it = data.data();
+	const char *end = it + data.size();
+	
+	// Make sure this journal goes with this snapshot.
+	string line;
+	if(!ReadLine(it, end, line) || line.compare(0, 8, "journal ")
+			|| strtoull(line.c_str() + 8, nullptr, 10) != Hash(text.data(), text.data() + text.size()))
+		return text;
+	
+	while(it != end && Apply(it, end, text))
+		continue;
+	return text;
+}
+
+
+
+// Parse the given file, with any journaled changes.
+DataFile SaveJournal::Load(const string &path)
+{
+	if(!Exists(path))
+		return DataFile(path);
+	
+	istringstream in(Read(path));
+	return DataFile(in);
+}
+
+
+
+// Check if the given file has a journal.
+bool SaveJournal::Exists(const string &path)
+{
+	return Files::Exists(JournalPath(path));
+}
+
+
+
+// Copy the journal that goes with the given file, if any.
+void SaveJournal::Copy(const string &from, const string &to)
+{
+	if(Exists(from))
+		Files::Copy(JournalPath(from), JournalPath(to));
+	else if(Exists(to))
+		Files::Delete(JournalPath(to));
+}
+
+
+
+// Delete the journal that goes with the given file, if any.
+void SaveJournal::Delete(const string &path)
+{
+	lock_guard<mutex> lock(journalMutex);
+	journals.erase(path);
+	if(Files::Exists(JournalPath(path)))
+		Files::Delete(JournalPath(path));
+}
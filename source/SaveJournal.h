@@ -0,0 +1,55 @@
+/* SaveJournal.h
+Copyright (c) 2014 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef SAVE_JOURNAL_H_
+#define SAVE_JOURNAL_H_
+
+#include "DataFile.h"
+
+#include <string>
+
+
+
+// A file that is saved often, like the autosave, can be kept as a full copy
+// (a "snapshot") plus a journal of changes. Each time the file is saved, only
+// the root nodes that changed since the previous save are appended to the
+// journal, and the nodes that did not change are referred to by their place in
+// the previous version. Once the journal grows too large, the whole file is
+// written out again and the journal is started over. The journal records which
+// snapshot it applies to, so a journal left over from an older snapshot (e.g.
+// if the game quit while replacing it) is ignored.
+class SaveJournal {
+public:
+	// Try to save the given text by appending to the file's journal. If that is
+	// not possible, or the journal is due to be compacted, this returns false,
+	// and the whole file must be written and then passed to Reset().
+	static bool Append(const std::string &path, const std::string &text);
+	// Remember that the given text was just written as the file's snapshot,
+	// and delete any journal it had.
+	static void Reset(const std::string &path, const std::string &text);
+	
+	// Read the current text of the given file, with any journaled changes.
+	static std::string Read(const std::string &path);
+	// Parse the given file, with any journaled changes.
+	static DataFile Load(const std::string &path);
+	// Check if the given file has a journal.
+	static bool Exists(const std::string &path);
+	
+	// Copy or delete the journal that goes with the given file, if any. This
+	// should be done whenever the file itself is copied or deleted.
+	static void Copy(const std::string &from, const std::string &to);
+	static void Delete(const std::string &path);
+};
+
+
+
+#endif
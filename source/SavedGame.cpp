@@ -15,11 +15,77 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "DataFile.h"
 #include "DataNode.h"
 #include "Date.h"
+#include "Files.h"
 #include "Format.h"
+#include "MappedFile.h"
+#include "SaveJournal.h"
 #include "SpriteSet.h"
 
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
 using namespace std;
 
+namespace {
+	// Saved games begin with a few short nodes, including a summary of what
+	// the load panel shows, followed by the much larger rest of the file. Get
+	// just the part of the file up to the end of the summary. If this file has
+	// no summary, return an empty string.
+	string ReadSummary(const char *begin, const char *end)
+	{
+		// Binary files are quick to load in full, so they need no summary.
+		if(DataFile::IsBinary(begin, end))
+			return string();
+		
+		bool hasSummary = false;
+		for(const char *it = begin; it != end; )
+		{
+			const char *next = find(it, end, '\n');
+			if(next != end)
+				++next;
+			
+			// Only the lines that begin a root node matter here.
+			if(*it > ' ' && *it != '#')
+			{
+				const char *start = it + (*it == '"');
+				size_t length = find_if(start, next, [](char c) { return c == '"' || c <= ' '; }) - start;
+				bool isSummary = (length == 7 && !strncmp(start, "summary", 7));
+				if(hasSummary && !isSummary)
+					return string(begin, it);
+				hasSummary = isSummary;
+				// The summary is always saved before the reputations, so if
+				// it has not been found by now, this file does not have one.
+				if(!hasSummary && length == 15 && !strncmp(start, "reputation with", 15))
+					break;
+			}
+			it = next;
+		}
+		return hasSummary ? string(begin, end) : string();
+	}
+	
+	string ReadSummary(const string &path)
+	{
+		// A journaled file has to be pieced together before it can be read.
+		if(SaveJournal::Exists(path))
+		{
+			string data = SaveJournal::Read(path);
+			return ReadSummary(data.data(), data.data() + data.size());
+		}
+		
+		MappedFile file(path);
+		if(!file)
+			return string();
+		
+		// A compressed file must be decompressed in full to find its summary,
+		// but that is still much faster than parsing all of it.
+		if(!Files::IsCompressed(file.begin(), file.end()))
+			return ReadSummary(file.begin(), file.end());
+		string data = Files::Decompress(file.begin(), file.end());
+		return ReadSummary(data.data(), data.data() + data.size());
+	}
+}
+
 
 
 SavedGame::SavedGame(const string &path)
@@ -32,7 +98,11 @@ SavedGame::SavedGame(const string &path)
 void SavedGame::Load(const string &path)
 {
 	Clear();
-	DataFile file(path);
+	// If this file has a summary, only that much of it needs to be parsed.
+	// Otherwise, it must have been saved by an older version of the game, and
+	// the whole file must be read to find the flagship and the credits.
+	istringstream summary(ReadSummary(path));
+	DataFile file = summary.str().empty() ? SaveJournal::Load(path) : DataFile(summary);
 	if(file.begin() != file.end())
 		this->path = path;
 	
@@ -46,6 +116,18 @@ void SavedGame::Load(const string &path)
 			system = node.Token(1);
 		else if(node.Token(0) == "planet" && node.Size() >= 2)
 			planet = node.Token(1);
+		else if(node.Token(0) == "summary")
+		{
+			for(const DataNode &child : node)
+			{
+				if(child.Token(0) == "credits" && child.Size() >= 2)
+					credits = Format::Number(child.Value(1));
+				else if(child.Token(0) == "ship name" && child.Size() >= 2)
+					shipName = child.Token(1);
+				else if(child.Token(0) == "ship sprite" && child.Size() >= 2)
+					shipSprite = SpriteSet::Get(child.Token(1));
+			}
+		}
 		else if(node.Token(0) == "account")
 		{
 			for(const DataNode &child : node)
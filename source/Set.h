@@ -14,25 +14,37 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #define SET_H_
 
 #include <map>
+#include <set>
 #include <string>
+#include <unordered_map>
 
 
 
 // Template representing a set of named objects of a given type, where you can
 // query it for a pointer to any object and it will return one, whether or not that
-// object has been loaded yet. (This allows cyclic pointers.)
+// object has been loaded yet. (This allows cyclic pointers.) The pointer stays
+// valid for as long as the object is in the set, so code that looks up the same
+// name over and over (e.g. every frame) can just look it up once and keep it.
 template<class Type>
 class Set {
 public:
+	Set() = default;
+	// Copying a set must rebuild its index, so that it refers to the copies.
+	Set(const Set<Type> &other);
+	Set<Type> &operator=(const Set<Type> &other);
+	
 	// Allow non-const access to the owner of this set; it can hand off only
 	// const references to avoid anyone else modifying the objects.
-	Type *Get(const std::string &name) { return &data[name]; }
-	const Type *Get(const std::string &name) const { return &data[name]; }
+	Type *Get(const std::string &name);
+	const Type *Get(const std::string &name) const;
 	// If an item already exists in this set, get it. Otherwise, return a null
 	// pointer rather than creating the item.
 	const Type *Find(const std::string &name) const;
+	// Get an object in order to change it. The set remembers which objects
+	// have been changed this way, so that Revert() only has to restore those.
+	Type *Modify(const std::string &name);
 	
-	bool Has(const std::string &name) const { return data.count(name); }
+	bool Has(const std::string &name) const { return index.count(name); }
 	
 	typename std::map<std::string, Type>::iterator begin() { return data.begin(); }
 	typename std::map<std::string, Type>::const_iterator begin() const { return data.begin(); }
@@ -40,48 +52,129 @@ public:
 	typename std::map<std::string, Type>::const_iterator end() const { return data.end(); }
 	
 	int size() const { return data.size(); }
-	// Remove any objects in this set that are not in the given set, and for
-	// those that are in the given set, revert to their contents.
-	void Revert(const Set<Type> &other);
+	// Remove any objects in this set that are not in the given set, and revert
+	// any objects that were changed through Modify() to their contents in the
+	// given set. Return true if anything was removed or reverted.
+	bool Revert(const Set<Type> &other);
 	
 	
 private:
+	// The objects are stored in a map so that they can be listed in order, but
+	// looking them up by name is done through a hash table of their addresses.
 	mutable std::map<std::string, Type> data;
+	mutable std::unordered_map<std::string, Type *> index;
+	// The names of all the objects that have been modified since this set was
+	// copied or reverted. A copy of a set starts out with no modifications.
+	std::set<std::string> modified;
 };
 
 
 
+template <class Type>
+Set<Type>::Set(const Set<Type> &other)
+	: data(other.data)
+{
+	for(auto &it : data)
+		index.emplace(it.first, &it.second);
+}
+
+
+
+template <class Type>
+Set<Type> &Set<Type>::operator=(const Set<Type> &other)
+{
+	data = other.data;
+	index.clear();
+	for(auto &it : data)
+		index.emplace(it.first, &it.second);
+	modified.clear();
+	return *this;
+}
+
+
+
+template <class Type>
+Type *Set<Type>::Get(const std::string &name)
+{
+	auto it = index.find(name);
+	if(it != index.end())
+		return it->second;
+	
+	Type *object = &data[name];
+	index.emplace(name, object);
+	return object;
+}
+
+
+
+template <class Type>
+const Type *Set<Type>::Get(const std::string &name) const
+{
+	return const_cast<Set<Type> *>(this)->Get(name);
+}
+
+
+
 template <class Type>
 const Type *Set<Type>::Find(const std::string &name) const
 {
-	auto it = data.find(name);
-	return (it == data.end() ? nullptr : &it->second);
+	auto it = index.find(name);
+	return (it == index.end() ? nullptr : it->second);
 }
 
 
 
 template <class Type>
-void Set<Type>::Revert(const Set<Type> &other)
+Type *Set<Type>::Modify(const std::string &name)
 {
-	auto it = data.begin();
-	auto oit = other.data.begin();
+	modified.insert(name);
+	return Get(name);
+}
+
+
+
+template <class Type>
+bool Set<Type>::Revert(const Set<Type> &other)
+{
+	bool changed = !modified.empty();
 	
-	while(it != data.end())
+	// Any object that was added after the given set was copied from this one
+	// must be removed. If no objects were added, the names are all the same.
+	if(data.size() != other.data.size())
 	{
-		if(oit == other.data.end() || it->first < oit->first)
-			it = data.erase(it);
-		else if(it->first == oit->first)
+		changed = true;
+		auto it = data.begin();
+		auto oit = other.data.begin();
+		while(it != data.end())
 		{
-			// If this is an entry that is in the set we are reverting to, copy
-			// the state we are reverting to.
-			it->second = oit->second;
-			++it;
-			++oit;
+			if(oit == other.data.end() || it->first < oit->first)
+			{
+				index.erase(it->first);
+				it = data.erase(it);
+			}
+			else
+			{
+				// There should never be a case when an entry in the set we are
+				// reverting to has a name that is not also in this set.
+				if(it->first == oit->first)
+					++it;
+				++oit;
+			}
 		}
-		
-		// There should never be a case when an entry in the set we are
-		// reverting to has a name that is not also in this set.
 	}
+	
+	// Only the objects that have been modified need to be copied. The copy is
+	// made in place so that any pointers to the object remain valid.
+	for(const std::string &name : modified)
+	{
+		auto oit = other.data.find(name);
+		auto it = data.find(name);
+		if(oit != other.data.end() && it != data.end())
+			it->second = oit->second;
+	}
+	modified.clear();
+	
+	return changed;
 }
 
 
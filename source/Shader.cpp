@@ -12,7 +12,11 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 #include "Shader.h"
 
+#include "Files.h"
+
 #include <cctype>
+#include <cstdint>
+#include <cstdio>
 #include <cstring>
 #include <iostream>
 #include <stdexcept>
@@ -20,10 +24,63 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 using namespace std;
 
+namespace {
+	// The program and vertex array object that are currently bound. All the
+	// drawing happens in a single context, so this is the only copy of them.
+	GLuint currentProgram = 0;
+	GLuint currentVertexArray = 0;
+	
+	// Check if the driver can save and load linked programs. The Mac OpenGL
+	// headers do not report which extensions are present, so don't try there.
+	bool CanCacheBinary()
+	{
+#ifdef __APPLE__
+		return false;
+#else
+		return GLEW_ARB_get_program_binary;
+#endif
+	}
+	
+	// Get the path where the linked program for the given sources is cached.
+	// The file name is a 64-bit FNV-1a hash of the sources and of the driver,
+	// since a different driver or version cannot load the same binary.
+	string CachePath(const char *vertex, const char *fragment)
+	{
+		if(Files::Cache().empty() || !CanCacheBinary())
+			return string();
+		
+		string key;
+		for(GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION})
+		{
+			const GLubyte *value = glGetString(name);
+			if(value)
+				key += reinterpret_cast<const char *>(value);
+			key += '\n';
+		}
+		key += vertex;
+		key += '\n';
+		key += fragment;
+		
+		uint64_t hash = 14695981039346656037ULL;
+		for(char c : key)
+		{
+			hash ^= static_cast<unsigned char>(c);
+			hash *= 1099511628211ULL;
+		}
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.shader", static_cast<unsigned long long>(hash));
+		return Files::Cache() + name;
+	}
+}
+
 
 
 Shader::Shader(const char *vertex, const char *fragment)
 {
+	string cachePath = CachePath(vertex, fragment);
+	if(!cachePath.empty() && LoadBinary(cachePath))
+		return;
+	
 	GLuint vertexShader = Compile(vertex, GL_VERTEX_SHADER);
 	GLuint fragmentShader = Compile(fragment, GL_FRAGMENT_SHADER);
 	
@@ -34,6 +91,8 @@ Shader::Shader(const char *vertex, const char *fragment)
 	glAttachShader(program, vertexShader);
 	glAttachShader(program, fragmentShader);
 	
+	if(!cachePath.empty())
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glLinkProgram(program);
 	
 	glDetachShader(program, vertexShader);
@@ -43,6 +102,9 @@ Shader::Shader(const char *vertex, const char *fragment)
 	glGetProgramiv(program, GL_LINK_STATUS, &status);
 	if(status == GL_FALSE)
 		throw runtime_error("Linking OpenGL shader program failed.");
+	
+	if(!cachePath.empty())
+		SaveBinary(cachePath);
 }
 
 
@@ -54,6 +116,32 @@ GLuint Shader::Object() const
 
 
 
+// Make this the current program. The current program and vertex array are
+// remembered, so that drawing code can just ask for the ones it needs
+// without paying for a driver call if they are already bound, and never
+// needs to unbind them when it is done.
+void Shader::Use() const
+{
+	if(program == currentProgram)
+		return;
+	
+	glUseProgram(program);
+	currentProgram = program;
+}
+
+
+
+void Shader::BindVertexArray(GLuint vao)
+{
+	if(vao == currentVertexArray)
+		return;
+	
+	glBindVertexArray(vao);
+	currentVertexArray = vao;
+}
+
+
+
 GLint Shader::Attrib(const char *name) const
 {
 	GLint attrib = glGetAttribLocation(program, name);
@@ -124,3 +212,56 @@ GLuint Shader::Compile(const char *str, GLenum type)
 	
 	return object;
 }
+
+
+
+// Load the linked program from the cache, if the driver saved a copy of it
+// the last time these sources were compiled.
+bool Shader::LoadBinary(const string &path)
+{
+	// The file holds the binary format, followed by the binary itself.
+	string data = Files::Read(path);
+	if(data.size() <= sizeof(GLenum))
+		return false;
+	GLenum format;
+	memcpy(&format, data.data(), sizeof(format));
+	
+	program = glCreateProgram();
+	if(!program)
+		return false;
+	glProgramBinary(program, format, data.data() + sizeof(format), data.size() - sizeof(format));
+	
+	// A driver update may make the binary invalid even if the version string
+	// has not changed. In that case, compile the sources instead.
+	GLint status;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if(status == GL_FALSE)
+	{
+		glDeleteProgram(program);
+		program = 0;
+		return false;
+	}
+	return true;
+}
+
+
+
+// Save the linked program to the cache.
+void Shader::SaveBinary(const string &path) const
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if(length <= 0)
+		return;
+	
+	string data(sizeof(GLenum) + length, '\0');
+	GLenum format;
+	GLsizei written = 0;
+	glGetProgramBinary(program, length, &written, &format, &data[sizeof(GLenum)]);
+	if(written <= 0)
+		return;
+	memcpy(&data[0], &format, sizeof(format));
+	data.resize(sizeof(GLenum) + written);
+	
+	Files::WriteAtomically(path, data);
+}
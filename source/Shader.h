@@ -15,6 +15,8 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 #include "gl_header.h"
 
+#include <string>
+
 
 
 // Class representing a shader, i.e. a compiled GLSL program that the GPU uses
@@ -30,9 +32,21 @@ public:
 	GLint Attrib(const char *name) const;
 	GLint Uniform(const char *name) const;
 	
+	// Make this the current program. The current program and vertex array are
+	// remembered, so that drawing code can just ask for the ones it needs
+	// without paying for a driver call if they are already bound, and never
+	// needs to unbind them when it is done.
+	void Use() const;
+	static void BindVertexArray(GLuint vao);
+	
 	
 private:
 	GLuint Compile(const char *str, GLenum type);
+	// Load the linked program from the cache, if the driver saved a copy of it
+	// the last time these sources were compiled. If not, compile and link the
+	// sources and save the result for next time.
+	bool LoadBinary(const std::string &path);
+	void SaveBinary(const std::string &path) const;
 	
 	
 private:
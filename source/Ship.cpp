@@ -22,6 +22,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Messages.h"
 #include "Phrase.h"
 #include "Planet.h"
+#include "PoolAllocator.h"
 #include "Projectile.h"
 #include "Random.h"
 #include "ShipEvent.h"
@@ -52,19 +53,76 @@ namespace {
 	const vector<Angle> BAY_ANGLE = {Angle(0.), Angle(-90.), Angle(90.), Angle(180.)};
 	
 	static const double SCAN_TIME = 60.;
+	
+	// IDs of the attributes that are looked up every frame.
+	const int ACTIVE_COOLING = Outfit::AttributeID("active cooling");
+	const int AFTERBURNER_ENERGY = Outfit::AttributeID("afterburner energy");
+	const int AFTERBURNER_FUEL = Outfit::AttributeID("afterburner fuel");
+	const int AFTERBURNER_HEAT = Outfit::AttributeID("afterburner heat");
+	const int AFTERBURNER_THRUST = Outfit::AttributeID("afterburner thrust");
+	const int AUTOMATON = Outfit::AttributeID("automaton");
+	const int BUNKS = Outfit::AttributeID("bunks");
+	const int CARGO_SCAN = Outfit::AttributeID("cargo scan");
+	const int CARGO_SCAN_POWER = Outfit::AttributeID("cargo scan power");
+	const int CARGO_SCAN_SPEED = Outfit::AttributeID("cargo scan speed");
+	const int CARGO_SPACE = Outfit::AttributeID("cargo space");
+	const int CLOAK = Outfit::AttributeID("cloak");
+	const int CLOAKING_ENERGY = Outfit::AttributeID("cloaking energy");
+	const int CLOAKING_FUEL = Outfit::AttributeID("cloaking fuel");
+	const int COOLING = Outfit::AttributeID("cooling");
+	const int COOLING_ENERGY = Outfit::AttributeID("cooling energy");
+	const int COOLING_INEFFICIENCY = Outfit::AttributeID("cooling inefficiency");
+	const int DRAG = Outfit::AttributeID("drag");
+	const int ENERGY_CAPACITY = Outfit::AttributeID("energy capacity");
+	const int ENERGY_CONSUMPTION = Outfit::AttributeID("energy consumption");
+	const int ENERGY_GENERATION = Outfit::AttributeID("energy generation");
+	const int FUEL_CAPACITY = Outfit::AttributeID("fuel capacity");
+	const int HEAT_DISSIPATION = Outfit::AttributeID("heat dissipation");
+	const int HEAT_GENERATION = Outfit::AttributeID("heat generation");
+	const int HULL = Outfit::AttributeID("hull");
+	const int HULL_ENERGY = Outfit::AttributeID("hull energy");
+	const int HULL_HEAT = Outfit::AttributeID("hull heat");
+	const int HULL_REPAIR_RATE = Outfit::AttributeID("hull repair rate");
+	const int HYPERDRIVE = Outfit::AttributeID("hyperdrive");
+	const int JUMP_DRIVE = Outfit::AttributeID("jump drive");
+	const int JUMP_FUEL = Outfit::AttributeID("jump fuel");
+	const int JUMP_SPEED = Outfit::AttributeID("jump speed");
+	const int MASS = Outfit::AttributeID("mass");
+	const int OUTFIT_SCAN = Outfit::AttributeID("outfit scan");
+	const int OUTFIT_SCAN_POWER = Outfit::AttributeID("outfit scan power");
+	const int OUTFIT_SCAN_SPEED = Outfit::AttributeID("outfit scan speed");
+	const int RAMSCOOP = Outfit::AttributeID("ramscoop");
+	const int REQUIRED_CREW = Outfit::AttributeID("required crew");
+	const int REVERSE_THRUST = Outfit::AttributeID("reverse thrust");
+	const int REVERSE_THRUSTING_ENERGY = Outfit::AttributeID("reverse thrusting energy");
+	const int REVERSE_THRUSTING_HEAT = Outfit::AttributeID("reverse thrusting heat");
+	const int SCRAM_DRIVE = Outfit::AttributeID("scram drive");
+	const int SELF_DESTRUCT = Outfit::AttributeID("self destruct");
+	const int SHIELD_ENERGY = Outfit::AttributeID("shield energy");
+	const int SHIELD_GENERATION = Outfit::AttributeID("shield generation");
+	const int SHIELD_HEAT = Outfit::AttributeID("shield heat");
+	const int SHIELDS = Outfit::AttributeID("shields");
+	const int SOLAR_COLLECTION = Outfit::AttributeID("solar collection");
+	const int THRUST = Outfit::AttributeID("thrust");
+	const int THRUSTING_ENERGY = Outfit::AttributeID("thrusting energy");
+	const int THRUSTING_HEAT = Outfit::AttributeID("thrusting heat");
+	const int TURN = Outfit::AttributeID("turn");
+	const int TURNING_ENERGY = Outfit::AttributeID("turning energy");
+	const int TURNING_HEAT = Outfit::AttributeID("turning heat");
 }
 
 
 
 void Ship::Load(const DataNode &node)
 {
+	EditChassis();
 	if(node.Size() >= 2)
 	{
-		modelName = node.Token(1);
-		pluralModelName = modelName + 's';
+		chassis->modelName = node.Token(1);
+		chassis->pluralModelName = chassis->modelName + 's';
 	}
 	if(node.Size() >= 3)
-		base = GameData::Ships().Get(modelName);
+		base = GameData::Ships().Get(chassis->modelName);
 	
 	government = GameData::PlayerGovernment();
 	equipped.clear();
@@ -86,19 +144,19 @@ void Ship::Load(const DataNode &node)
 		else if(child.Token(0) == "name" && child.Size() >= 2)
 			name = child.Token(1);
 		else if(child.Token(0) == "plural" && child.Size() >= 2)
-			pluralModelName = child.Token(1);
+			chassis->pluralModelName = child.Token(1);
 		else if(child.Token(0) == "noun" && child.Size() >= 2)
-			noun = child.Token(1);
+			chassis->noun = child.Token(1);
 		else if(child.Token(0) == "attributes")
-			baseAttributes.Load(child);
+			chassis->baseAttributes.Load(child);
 		else if(child.Token(0) == "engine" && child.Size() >= 3)
 		{
 			if(!hasEngine)
 			{
-				enginePoints.clear();
+				chassis->enginePoints.clear();
 				hasEngine = true;
 			}
-			enginePoints.emplace_back(.5 * child.Value(1), .5 * child.Value(2),
+			chassis->enginePoints.emplace_back(.5 * child.Value(1), .5 * child.Value(2),
 				(child.Size() > 3 ? child.Value(3) : 1.));
 		}
 		else if(child.Token(0) == "gun" || child.Token(0) == "turret")
@@ -132,11 +190,11 @@ void Ship::Load(const DataNode &node)
 		{
 			if(!hasLicenses)
 			{
-				licenses.clear();
+				chassis->licenses.clear();
 				hasLicenses = true;
 			}
 			for(const DataNode &grand : child)
-				licenses.push_back(grand.Token(0));
+				chassis->licenses.push_back(grand.Token(0));
 		}
 		else if(child.Token(0) == "never disabled")
 			neverDisabled = true;
@@ -164,23 +222,23 @@ void Ship::Load(const DataNode &node)
 		{
 			if(!hasExplode)
 			{
-				explosionEffects.clear();
+				chassis->explosionEffects.clear();
 				explosionTotal = 0;
 				hasExplode = true;
 			}
 			int count = (child.Size() >= 3) ? child.Value(2) : 1;
-			explosionEffects[GameData::Effects().Get(child.Token(1))] += count;
+			chassis->explosionEffects[GameData::Effects().Get(child.Token(1))] += count;
 			explosionTotal += count;
 		}
 		else if(child.Token(0) == "final explode" && child.Size() >= 2)
 		{
 			if(!hasFinalExplode)
 			{
-				finalExplosions.clear();
+				chassis->finalExplosions.clear();
 				hasFinalExplode = true;
 			}
 			int count = (child.Size() >= 3) ? child.Value(2) : 1;
-			finalExplosions[GameData::Effects().Get(child.Token(1))] += count;
+			chassis->finalExplosions[GameData::Effects().Get(child.Token(1))] += count;
 		}
 		else if(child.Token(0) == "outfits")
 		{
@@ -222,11 +280,11 @@ void Ship::Load(const DataNode &node)
 		{
 			if(!hasDescription)
 			{
-				description.clear();
+				chassis->description.clear();
 				hasDescription = true;
 			}
-			description += child.Token(1);
-			description += '\n';
+			chassis->description += child.Token(1);
+			chassis->description += '\n';
 		}
 		else if(child.Token(0) != "actions")
 			child.PrintTrace("Skipping unrecognized attribute:");
@@ -256,12 +314,16 @@ void Ship::FinishLoading()
 	// All copies of this ship should save pointers to the "explosion" weapon
 	// definition stored safely in the ship model, which will not be destroyed
 	// until GameData is when the program quits.
-	if(GameData::Ships().Has(modelName))
+	if(GameData::Ships().Has(chassis->modelName))
 	{
-		const Ship *model = GameData::Ships().Get(modelName);
+		const Ship *model = GameData::Ships().Get(chassis->modelName);
 		explosionWeapon = &model->BaseAttributes();
-		pluralModelName = model->pluralModelName;
-		noun = model->noun;
+		if(chassis->pluralModelName != model->chassis->pluralModelName || chassis->noun != model->chassis->noun)
+		{
+			Chassis &edit = EditChassis();
+			edit.pluralModelName = model->chassis->pluralModelName;
+			edit.noun = model->chassis->noun;
+		}
 	}
 	
 	// If this ship has a base class, copy any attributes not defined here.
@@ -270,23 +332,23 @@ void Ship::FinishLoading()
 	{
 		if(!GetSprite())
 			reinterpret_cast<Body &>(*this) = *base;
-		if(baseAttributes.Attributes().empty())
-			baseAttributes = base->baseAttributes;
+		if(chassis->baseAttributes.Attributes().empty())
+			EditChassis().baseAttributes = base->chassis->baseAttributes;
 		if(bays.empty() && !base->bays.empty())
 			bays = base->bays;
-		if(enginePoints.empty())
-			enginePoints = base->enginePoints;
-		if(explosionEffects.empty())
+		if(chassis->enginePoints.empty())
+			EditChassis().enginePoints = base->chassis->enginePoints;
+		if(chassis->explosionEffects.empty())
 		{
-			explosionEffects = base->explosionEffects;
+			EditChassis().explosionEffects = base->chassis->explosionEffects;
 			explosionTotal = base->explosionTotal;
 		}
-		if(finalExplosions.empty())
-			finalExplosions = base->finalExplosions;
+		if(chassis->finalExplosions.empty())
+			EditChassis().finalExplosions = base->chassis->finalExplosions;
 		if(outfits.empty())
 			outfits = base->outfits;
-		if(description.empty())
-			description = base->description;
+		if(chassis->description.empty())
+			EditChassis().description = base->chassis->description;
 		
 		bool hasHardpoints = false;
 		for(const Hardpoint &weapon : armament.Get())
@@ -329,19 +391,27 @@ void Ship::FinishLoading()
 	
 	// Mark any drone that has no "automaton" value as an automaton, to
 	// grandfather in the drones from before that attribute existed.
-	if(baseAttributes.Category() == "Drone" && !baseAttributes.Attributes().count("automaton"))
-		baseAttributes.Add("automaton", 1.);
-	
-	baseAttributes.Reset("gun ports", armament.GunCount());
-	baseAttributes.Reset("turret mounts", armament.TurretCount());
+	if(chassis->baseAttributes.Category() == "Drone" && !chassis->baseAttributes.Attributes().count("automaton"))
+		EditChassis().baseAttributes.Add("automaton", 1.);
+	
+	// Copies of a ship that has already been loaded (e.g. the ships in an NPC
+	// fleet) will already have the right hardpoint counts, so they can keep
+	// sharing the chassis data.
+	if(chassis->baseAttributes.Get("gun ports") != armament.GunCount()
+			|| chassis->baseAttributes.Get("turret mounts") != armament.TurretCount())
+	{
+		Chassis &edit = EditChassis();
+		edit.baseAttributes.Reset("gun ports", armament.GunCount());
+		edit.baseAttributes.Reset("turret mounts", armament.TurretCount());
+	}
 	
 	// Add the attributes of all your outfits to the ship's base attributes.
-	attributes = baseAttributes;
+	attributes = chassis->baseAttributes;
 	for(const auto &it : outfits)
 	{
 		if(it.first->Name().empty())
 		{
-			cerr << "Unrecognized outfit in " << modelName << " \"" << name << "\"" << endl;
+			cerr << "Unrecognized outfit in " << chassis->modelName << " \"" << name << "\"" << endl;
 			continue;
 		}
 		attributes.Add(*it.first, it.second);
@@ -356,9 +426,10 @@ void Ship::FinishLoading()
 				armament.Add(it.first, count);
 		}
 	}
-	cargo.SetSize(attributes.Get("cargo space"));
+	cargo.SetSize(attributes.Get(CARGO_SPACE));
 	equipped.clear();
 	armament.FinishLoading();
+	UpdateOutfitStats();
 	
 	// Figure out how far from center the farthest weapon it.
 	weaponRadius = 0.;
@@ -381,17 +452,26 @@ void Ship::FinishLoading()
 
 
 
+// Get the ship model that this variant copies any undefined data from, or
+// null if this ship is not a variant.
+const Ship *Ship::Base() const
+{
+	return base;
+}
+
+
+
 // Save a full description of this ship, as currently configured.
 void Ship::Save(DataWriter &out) const
 {
-	out.Write("ship", modelName);
+	out.Write("ship", chassis->modelName);
 	out.BeginChild();
 	{
 		out.Write("name", name);
-		if(pluralModelName != modelName + 's')
-			out.Write("plural", pluralModelName);
-		if(!noun.empty())
-			out.Write("noun", noun);
+		if(chassis->pluralModelName != chassis->modelName + 's')
+			out.Write("plural", chassis->pluralModelName);
+		if(!chassis->noun.empty())
+			out.Write("noun", chassis->noun);
 		SaveSprite(out);
 		
 		if(neverDisabled)
@@ -402,9 +482,9 @@ void Ship::Save(DataWriter &out) const
 		out.Write("attributes");
 		out.BeginChild();
 		{
-			out.Write("category", baseAttributes.Category());
-			out.Write("cost", baseAttributes.Cost());
-			for(const auto &it : baseAttributes.Attributes())
+			out.Write("category", chassis->baseAttributes.Category());
+			out.Write("cost", chassis->baseAttributes.Cost());
+			for(const auto &it : chassis->baseAttributes.Attributes())
 				if(it.second)
 					out.Write(it.first, it.second);
 		}
@@ -431,7 +511,7 @@ void Ship::Save(DataWriter &out) const
 		out.Write("hull", hull);
 		out.Write("position", position.X(), position.Y());
 		
-		for(const EnginePoint &point : enginePoints)
+		for(const EnginePoint &point : chassis->enginePoints)
 			out.Write("engine", 2. * point.X(), 2. * point.Y(), point.Zoom());
 		for(const Hardpoint &weapon : armament.Get())
 		{
@@ -455,10 +535,10 @@ void Ship::Save(DataWriter &out) const
 			else
 				out.Write(BAY_TYPE[bay.isFighter], x, y);
 		}
-		for(const auto &it : explosionEffects)
+		for(const auto &it : chassis->explosionEffects)
 			if(it.first && it.second)
 				out.Write("explode", it.first->Name(), it.second);
-		for(const auto &it : finalExplosions)
+		for(const auto &it : chassis->finalExplosions)
 			if(it.first && it.second)
 				out.Write("final explode", it.first->Name(), it.second);
 		
@@ -491,14 +571,14 @@ const string &Ship::Name() const
 
 const string &Ship::ModelName() const
 {
-	return modelName;
+	return chassis->modelName;
 }
 
 
 
 const string &Ship::PluralModelName() const
 {
-	return pluralModelName;
+	return chassis->pluralModelName;
 }
 
 
@@ -507,7 +587,7 @@ const string &Ship::PluralModelName() const
 const string &Ship::Noun() const
 {
 	static const string SHIP = "ship";
-	return noun.empty() ? SHIP : noun;
+	return chassis->noun.empty() ? SHIP : chassis->noun;
 }
 
 
@@ -515,7 +595,7 @@ const string &Ship::Noun() const
 // Get this ship's description.
 const string &Ship::Description() const
 {
-	return description;
+	return chassis->description;
 }
 
 
@@ -531,7 +611,7 @@ int64_t Ship::Cost() const
 // Get the cost of this ship's chassis, with no outfits installed.
 int64_t Ship::ChassisCost() const
 {
-	return baseAttributes.Cost();
+	return chassis->baseAttributes.Cost();
 }
 
 
@@ -539,7 +619,7 @@ int64_t Ship::ChassisCost() const
 // Get the licenses needed to buy or operate this ship.
 const vector<string> &Ship::Licenses() const
 {
-	return licenses;
+	return chassis->licenses;
 }
 
 
@@ -553,7 +633,7 @@ void Ship::Place(Point position, Point velocity, Angle angle)
 	if(landingPlanet)
 	{
 		landingPlanet = nullptr;
-		zoom = parent.lock() ? (-.2 + -.8 * Random::Real()) : 0.;
+		zoom = !parent.expired() ? (-.2 + -.8 * Random::Real()) : 0.;
 	}
 	else
 		zoom = 1.;
@@ -702,7 +782,7 @@ const Command &Ship::Commands() const
 // Move this ship. A ship may create effects as it moves, in particular if
 // it is in the process of blowing up. If this returns false, the ship
 // should be deleted.
-bool Ship::Move(list<Effect> &effects, list<shared_ptr<Flotsam>> &flotsam)
+bool Ship::Move(vector<Effect> &effects, list<shared_ptr<Flotsam>> &flotsam)
 {
 	// Check if this ship has been in a different system from the player for so
 	// long that it should be "forgotten." Also eliminate ships that have no
@@ -712,616 +792,204 @@ bool Ship::Move(list<Effect> &effects, list<shared_ptr<Flotsam>> &flotsam)
 	if((!isSpecial && forget >= 1000) || !currentSystem)
 		return false;
 	isInSystem = false;
-	if(!fuel || !(attributes.Get("hyperdrive") || attributes.Get("jump drive")))
+	if(!fuel || !(attributes.Get(HYPERDRIVE) || attributes.Get(JUMP_DRIVE)))
 		hyperspaceSystem = nullptr;
 	
-	// Adjust the error in the pilot's targeting.
-	personality.UpdateConfusion(commands.IsFiring());
+	// Adjust the error in the pilot's targeting. Ships outside the player's
+	// system never fire, so they have no need to do this.
+	if(!forget)
+		personality.UpdateConfusion(commands.IsFiring());
 	
-	// Handle ionization effects, etc.
-	if(ionization)
+	UpdateStatusEffects(effects, flotsam);
+	double slowMultiplier = 1. / (1. + slowness * .05);
+	UpdateSupplies();
+	
+	// A ship can be locked into one of three special states: exploding,
+	// hyperspacing, and landing. A ship that is exploding keeps drifting, but
+	// in the other two states the ship's own controls do nothing.
+	if(IsDestroyed())
 	{
-		ionization *= .99;
-		CreateSparks(effects, "ion spark", ionization * .1);
+		if(!UpdateExplosion(effects, flotsam))
+			return false;
 	}
-	if(disruption)
+	else if(hyperspaceSystem || hyperspaceCount)
 	{
-		disruption *= .99;
-		CreateSparks(effects, "disruption spark", disruption * .1);
+		MoveInHyperspace(effects);
+		return true;
 	}
-	if(slowness)
+	else if(landingPlanet || zoom < 1.)
+		return MoveWhileLanding();
+	
+	if(isDisabled)
 	{
-		slowness *= .99;
-		CreateSparks(effects, "slowing spark", slowness * .1);
+		// If you're disabled, you can't initiate landing or jumping.
 	}
-	double slowMultiplier = 1. / (1. + slowness * .05);
-	// Jettisoned cargo effects (only for ships in the current system).
-	if(!jettisoned.empty() && !forget)
+	else if(commands.Has(Command::LAND) && CanLand())
+		landingPlanet = GetTargetStellar()->GetPlanet();
+	else if(commands.Has(Command::JUMP) && IsReadyToJump())
 	{
-		jettisoned.front()->Place(*this);
-		flotsam.splice(flotsam.end(), jettisoned, jettisoned.begin());
+		hyperspaceSystem = GetTargetSystem();
+		isUsingJumpDrive = !attributes.Get(HYPERDRIVE) || !currentSystem->Links().count(hyperspaceSystem);
+		hyperspaceFuelCost = JumpFuel(hyperspaceSystem);
 	}
 	
-	// When ships recharge, what actually happens is that they can exceed their
-	// maximum capacity for the rest of the turn, but must be clamped to the
-	// maximum here before they gain more. This is so that, for example, a ship
-	// with no batteries but a good generator can still move.
-	energy = min(energy, attributes.Get("energy capacity"));
-	
-	heat -= .001 * heat * attributes.Get("heat dissipation");
-	if(heat > Mass() * 100.)
-		isOverheated = true;
-	else if(heat < Mass() * 90.)
-		isOverheated = false;
-	
-	double maxShields = attributes.Get("shields");
-	shields = min(shields, maxShields);
-	double maxHull = attributes.Get("hull");
-	hull = min(hull, maxHull);
+	UpdatePilot();
+	UpdateVelocity(effects, slowMultiplier);
 	
-	int requiredCrew = RequiredCrew();
-	isDisabled = isOverheated || hull < MinimumHull() || (!crew && requiredCrew);
+	// Boarding depends on the target ship's position, so it is handled in
+	// MoveRelative() after every ship has moved.
+	isTrackingTarget = true;
 	
-	// Whenever not actively scanning, the amount of scan information the ship
-	// has "decays" over time. For a scanner with a speed of 1, one second of
-	// uninterrupted scanning is required to successfully scan its target.
-	// Only apply the decay if not already done scanning the target.
-	if(cargoScan < SCAN_TIME)
-		cargoScan = max(0., cargoScan - 1.);
-	if(outfitScan < SCAN_TIME)
-		outfitScan = max(0., outfitScan - 1.);
+	// Shield and hull recharge. This comes after movement so that engines take
+	// priority over shield recharge.
+	RegenerateHullAndShields();
 	
-	// Update ship supply levels.
-	if(!isDisabled)
-	{
-		// Ramscoops work much better when close to the system center. Even if a
-		// ship has no ramscoop, it can harvest a tiny bit of fuel by flying
-		// close to the star.
-		double scale = .2 + 1.8 / (.001 * position.Length() + 1);
-		fuel += .03 * scale * (sqrt(attributes.Get("ramscoop")) + .05 * scale);
-		fuel = min(fuel, attributes.Get("fuel capacity"));
-		
-		energy += scale * attributes.Get("solar collection");
-		
-		double coolingEfficiency = CoolingEfficiency();
-		energy += attributes.Get("energy generation") - attributes.Get("energy consumption");
-		energy -= ionization;
-		energy = max(0., energy);
-		heat += attributes.Get("heat generation");
-		heat -= coolingEfficiency * attributes.Get("cooling");
-		heat = max(0., heat);
-		
-		// Apply active cooling. The fraction of full cooling to apply equals
-		// your ship's current fraction of its maximum temperature.
-		double activeCooling = coolingEfficiency * attributes.Get("active cooling");
-		if(activeCooling > 0.)
-		{
-			// Although it's a misuse of this feature, handle the case where
-			// "active cooling" does not require any energy.
-			double coolingEnergy = attributes.Get("cooling energy");
-			if(coolingEnergy)
-			{
-				double spentEnergy = min(energy, coolingEnergy * min(1., Heat()));
-				heat -= activeCooling * spentEnergy / coolingEnergy;
-				energy -= spentEnergy;
-			}
-			else
-				heat -= activeCooling;
-			
-			heat = max(0., heat);
-		}
-	}
+	// And finally: move the ship!
+	position += velocity;
 	
-	if(!isInvisible)
+	return true;
+}
+
+
+
+// Before any ship moves, copy anything Move() needs from other ships,
+// since those ships may change it while they are moving.
+void Ship::PrepareToMove()
+{
+	// A ship leaving hyperspace may aim at its parent's target planet, which
+	// the parent clears if it is leaving hyperspace on the same step.
+	shared_ptr<const Ship> parent = (hyperspaceSystem ? GetParent() : nullptr);
+	parentTargetPlanet = (parent ? parent->targetPlanet : nullptr);
+}
+
+
+
+// Finish moving this ship, based on where its parent and its target ended up
+// after they moved. This must not be called until Move() has been called for
+// every ship, but unlike Move() it may modify other ships.
+void Ship::MoveRelative()
+{
+	if(isTrackingParent)
 	{
-		double cloakingSpeed = attributes.Get("cloak");
-		bool canCloak = (!isDisabled && cloakingSpeed > 0.
-			&& fuel >= attributes.Get("cloaking fuel")
-			&& energy >= attributes.Get("cloaking energy"));
-		if(commands.Has(Command::CLOAK) && canCloak)
+		isTrackingParent = false;
+		shared_ptr<const Ship> parent = GetParent();
+		if(parent && parent->currentSystem == currentSystem)
 		{
-			cloak = min(1., cloak + cloakingSpeed);
-			fuel -= attributes.Get("cloaking fuel");
-			energy -= attributes.Get("cloaking energy");
+			hyperspaceOffset = position - parent->position;
+			double length = hyperspaceOffset.Length();
+			if(length > 1000.)
+				hyperspaceOffset *= 1000. / length;
 		}
-		else if(cloakingSpeed)
-			cloak = max(0., cloak - cloakingSpeed);
-		else
-			cloak = 0.;
 	}
+	if(!isTrackingTarget)
+		return;
+	isTrackingTarget = false;
 	
-	if(IsDestroyed())
+	// Boarding:
+	if(isBoarding && (commands.Has(Command::FORWARD | Command::BACK) || commands.Turn()))
+		isBoarding = false;
+	shared_ptr<const Ship> target = GetTargetShip();
+	// Remember the actual target, since the boarding target may be different.
+	shared_ptr<const Ship> currentTarget = target;
+	// If this is a fighter or drone and it is not assisting someone at the
+	// moment, its boarding target should be its parent ship.
+	if(CanBeCarried() && !(target && target == GetShipToAssist()))
+		target = GetParent();
+	if(target && !isDisabled)
 	{
-		// Make sure the shields are zero, as well as the hull.
-		shields = 0.;
-		
-		// Once we've created enough little explosions, die.
-		if(explosionCount == explosionTotal || forget)
+		Point dp = (target->position - position);
+		double distance = dp.Length();
+		Point dv = (target->velocity - velocity);
+		double speed = dv.Length();
+		isBoarding |= (distance < 50. && speed < 1. && commands.Has(Command::BOARD));
+		if(isBoarding && !CanBeCarried())
 		{
-			if(!forget)
-			{
-				const Effect *effect = GameData::Effects().Get("smoke");
-				double size = Width() + Height();
-				double scale = .03 * size + .5;
-				double radius = .2 * size;
-				int debrisCount = attributes.Get("mass") * .07;
-				for(int i = 0; i < debrisCount; ++i)
-				{
-					effects.push_back(*effect);
-					
-					Angle angle = Angle::Random();
-					Point effectVelocity = velocity + angle.Unit() * (scale * Random::Real());
-					Point effectPosition = position + radius * angle.Unit();
-					effects.back().Place(effectPosition, effectVelocity, angle);
-				}
-					
-				for(unsigned i = 0; i < explosionTotal / 2; ++i)
-					CreateExplosion(effects, true);
-				for(const auto &it : finalExplosions)
-				{
-					effects.push_back(*it.first);
-					effects.back().Place(position, velocity, angle);
-				}
-				// For everything in this ship's cargo hold there is a 25% chance
-				// that it will survive as flotsam.
-				for(const auto &it : cargo.Commodities())
-					Jettison(it.first, Random::Binomial(it.second, .25));
-				for(const auto &it : cargo.Outfits())
-					Jettison(it.first, Random::Binomial(it.second, .25));
-				for(shared_ptr<Flotsam> &it : jettisoned)
-					it->Place(*this);
-				flotsam.splice(flotsam.end(), jettisoned);
-			}
-			energy = 0.;
-			heat = 0.;
-			ionization = 0.;
-			fuel = 0.;
-			return false;
+			if(!target->IsDisabled() && government->IsEnemy(target->government))
+				isBoarding = false;
+			else if(target->IsDestroyed() || target->IsLanding() || target->IsHyperspacing()
+					|| target->GetSystem() != GetSystem())
+				isBoarding = false;
 		}
-		
-		// If the ship is dead, it first creates explosions at an increasing
-		// rate, then disappears in one big explosion.
-		++explosionRate;
-		if(Random::Int(1024) < explosionRate)
-			CreateExplosion(effects);
-	}
-	else if(hyperspaceSystem || hyperspaceCount)
-	{
-		// Don't apply external acceleration while jumping.
-		acceleration = Point();
-		
-		// Enter hyperspace.
-		int direction = hyperspaceSystem ? 1 : -1;
-		hyperspaceCount += direction;
-		static const int HYPER_C = 100;
-		static const double HYPER_A = 2.;
-		static const double HYPER_D = 1000.;
-		if(hyperspaceSystem)
-			fuel -= hyperspaceFuelCost / HYPER_C;
-		
-		// Create the particle effects for the jump drive. This may create 100
-		// or more particles per ship per turn at the peak of the jump.
-		if(isUsingJumpDrive && !forget)
-			CreateSparks(effects, "jump drive", hyperspaceCount * Width() * Height() * .000006);
-		
-		if(hyperspaceCount == HYPER_C)
+		if(isBoarding && !pilotError)
 		{
-			currentSystem = hyperspaceSystem;
-			hyperspaceSystem = nullptr;
-			targetSystem = nullptr;
-			// Check if the target planet is in the destination system or not.
-			const Planet *planet = (targetPlanet ? targetPlanet->GetPlanet() : nullptr);
-			if(!planet || planet->IsWormhole() || !planet->IsInSystem(currentSystem))
-				targetPlanet = nullptr;
-			// Check if your parent has a target planet in this system.
-			shared_ptr<Ship> parent = GetParent();
-			if(!targetPlanet && parent && parent->targetPlanet)
-			{
-				planet = parent->targetPlanet->GetPlanet();
-				if(planet && !planet->IsWormhole() && planet->IsInSystem(currentSystem))
-					targetPlanet = parent->targetPlanet;
-			}
-			direction = -1;
+			Angle facing = angle;
+			bool left = target->Unit().Cross(facing.Unit()) < 0.;
+			double turn = left - !left;
 			
-			// If you have a target planet in the destination system, exit
-			// hyperpace aimed at it. Otherwise, target the first planet that
-			// has a spaceport.
-			Point target;
-			if(targetPlanet)
-				target = targetPlanet->Position();
-			else
-			{
-				for(const StellarObject &object : currentSystem->Objects())
-					if(object.GetPlanet() && object.GetPlanet()->HasSpaceport())
-					{
-						target = object.Position();
-						break;
-					}
-			}
+			// Check if the ship will still be pointing to the same side of the target
+			// angle if it turns by this amount.
+			facing += TurnRate() * turn;
+			bool stillLeft = target->Unit().Cross(facing.Unit()) < 0.;
+			if(left != stillLeft)
+				turn = 0.;
+			angle += TurnRate() * turn;
 			
-			if(isUsingJumpDrive)
-			{
-				position = target + Angle::Random().Unit() * 300. * (Random::Real() + 1.);
-				return true;
-			}
+			// This ship has already moved this step, so move it by the change in
+			// velocity too, as if it had been applied before it moved.
+			velocity += dv.Unit() * .1;
+			position += dv.Unit() * .1 + dp.Unit() * .5;
 			
-			// Have all ships exit hyperspace at the same distance so that
-			// your escorts always stay with you.
-			double distance = (HYPER_C * HYPER_C) * .5 * HYPER_A + HYPER_D;
-			position = (target - distance * angle.Unit());
-			position += hyperspaceOffset;
-			// Make sure your velocity is in exactly the direction you are
-			// traveling in, so that when you decelerate there will not be a
-			// sudden shift in direction at the end.
-			velocity = velocity.Length() * angle.Unit();
-		}
-		if(!isUsingJumpDrive)
-		{
-			velocity += (HYPER_A * direction) * angle.Unit();
-			if(!hyperspaceSystem)
+			if(distance < 10. && speed < 1. && (CanBeCarried() || !turn))
 			{
-				// Exit hyperspace far enough from the planet to be able to land.
-				// This does not take drag into account, so it is always an over-
-				// estimate of how long it will take to stop.
-				// We start decellerating after rotating about 150 degrees (that
-				// is, about acos(.8) from the proper angle). So:
-				// Stopping distance = .5*a*(v/a)^2 + (150/turn)*v.
-				// Exit distance = HYPER_D + .25 * v^2 = stopping distance.
-				double exitV = MaxVelocity();
-				double a = (.5 / Acceleration() - .25);
-				double b = 150. / TurnRate();
-				double discriminant = b * b - 4. * a * -HYPER_D;
-				if(discriminant > 0.)
+				if(cloak)
 				{
-					double altV = (-b + sqrt(discriminant)) / (2. * a);
-					if(altV > 0. && altV < exitV)
-						exitV = altV;
+					// Allow the player to get all the way to the end of the
+					// boarding sequence (including locking on to the ship) but
+					// not to actually board, if they are cloaked.
+					if(government->IsPlayer())
+						Messages::Add("You cannot board a ship while cloaked.");
 				}
-				if(velocity.Length() <= exitV)
+				else
 				{
-					velocity = angle.Unit() * exitV;
-					hyperspaceCount = 0;
+					isBoarding = false;
+					bool isEnemy = government->IsEnemy(target->government);
+					if(isEnemy && Random::Real() < target->Attributes().Get(SELF_DESTRUCT))
+					{
+						Messages::Add("The " + target->ModelName() + " \"" + target->Name()
+							+ "\" has activated its self-destruct mechanism.");
+						targetShip.lock()->SelfDestruct();
+					}
+					else
+						hasBoarded = true;
 				}
 			}
 		}
-		position += velocity;
-		if(GetParent() && GetParent()->currentSystem == currentSystem)
-		{
-			hyperspaceOffset = position - GetParent()->position;
-			double length = hyperspaceOffset.Length();
-			if(length > 1000.)
-				hyperspaceOffset *= 1000. / length;
-		}
-		
-		return true;
 	}
-	else if(landingPlanet || zoom < 1.)
-	{
-		// Don't apply external acceleration while landing.
-		acceleration = Point();
-		
-		// If a ship was disabled at the very moment it began landing, do not
-		// allow it to continue landing.
-		if(isDisabled)
-			landingPlanet = nullptr;
-		
-		// Special ships do not disappear forever when they land; they
-		// just slowly refuel.
-		if(landingPlanet && zoom)
-		{
-			// Move the ship toward the center of the planet while landing.
-			if(GetTargetStellar())
-				position = .97 * position + .03 * GetTargetStellar()->Position();
-			zoom -= .02;
-			if(zoom < 0.)
-			{
-				// If this is not a special ship, it ceases to exist when it
-				// lands on a true planet. If this is a wormhole, the ship is
-				// instantly transported.
-				if(landingPlanet->IsWormhole())
-				{
-					currentSystem = landingPlanet->WormholeDestination(currentSystem);
-					for(const StellarObject &object : currentSystem->Objects())
-						if(object.GetPlanet() == landingPlanet)
-							position = object.Position();
-					SetTargetStellar(nullptr);
-					landingPlanet = nullptr;
-				}
-				else if(!isSpecial || personality.IsFleeing())
-					return false;
-				
-				zoom = 0.;
-			}
-		}
-		// Only refuel if this planet has a spaceport.
-		else if(fuel == attributes.Get("fuel capacity")
-				|| !landingPlanet || !landingPlanet->HasSpaceport())
+	
+	// Clear your target if it is destroyed. This is only important for NPCs,
+	// because ordinary ships cease to exist once they are destroyed.
+	if(currentTarget && currentTarget->IsDestroyed() && currentTarget->explosionCount >= currentTarget->explosionTotal)
+		targetShip.reset();
+}
+
+
+
+// Launch any ships that are ready to launch.
+void Ship::Launch(list<shared_ptr<Ship>> &ships)
+{
+	// Allow fighters to launch from a disabled ship, but not from a ship that
+	// is landing, jumping, or cloaked.
+	if(!IsDestroyed() && (!commands.Has(Command::DEPLOY) || zoom != 1. || hyperspaceCount || cloak))
+		return;
+	
+	for(Bay &bay : bays)
+		if(bay.ship && !Random::Int(40 + 20 * bay.isFighter))
 		{
-			zoom = min(1., zoom + .02);
-			SetTargetStellar(nullptr);
-			landingPlanet = nullptr;
-		}
-		else
-			fuel = min(fuel + 1., attributes.Get("fuel capacity"));
-		
-		// Move the ship at the velocity it had when it began landing, but
-		// scaled based on how small it is now.
-		if(zoom > 0.)
-			position += velocity * zoom;
-		
-		return true;
-	}
-	if(isDisabled)
-	{
-		// If you're disabled, you can't initiate landing or jumping.
-	}
-	else if(commands.Has(Command::LAND) && CanLand())
-		landingPlanet = GetTargetStellar()->GetPlanet();
-	else if(commands.Has(Command::JUMP) && IsReadyToJump())
-	{
-		hyperspaceSystem = GetTargetSystem();
-		isUsingJumpDrive = !attributes.Get("hyperdrive") || !currentSystem->Links().count(hyperspaceSystem);
-		hyperspaceFuelCost = JumpFuel(hyperspaceSystem);
-	}
-	
-	if(pilotError)
-		--pilotError;
-	else if(pilotOkay)
-		--pilotOkay;
-	else if(isDisabled)
-	{
-		// If the ship is disabled, don't show a warning message due to missing crew.
-	}
-	else if(requiredCrew && static_cast<int>(Random::Int(requiredCrew)) >= Crew())
-	{
-		pilotError = 30;
-		if(parent.lock() || !government->IsPlayer())
-			Messages::Add(name + " is moving erratically because there are not enough crew to pilot it.");
-		else
-			Messages::Add("Your ship is moving erratically because you do not have enough crew to pilot it.");
-	}
-	else
-		pilotOkay = 30;
-	
-	// This ship is not landing or entering hyperspace. So, move it. If it is
-	// disabled, all it can do is slow down to a stop.
-	double mass = Mass();
-	if(isDisabled)
-		velocity *= 1. - attributes.Get("drag") / mass;
-	else if(!pilotError)
-	{
-		double thrustCommand = commands.Has(Command::FORWARD) - commands.Has(Command::BACK);
-		if(thrustCommand)
-		{
-			// Check if we are able to apply this thrust.
-			double cost = attributes.Get((thrustCommand > 0.) ?
-				"thrusting energy" : "reverse thrusting energy");
-			if(energy < cost)
-				thrustCommand = 0.;
-			else
-			{
-				// If a reverse thrust is commanded and the capability does not
-				// exist, ignore it (do not even slow under drag).
-				isThrusting = (thrustCommand > 0.);
-				double thrust = attributes.Get(isThrusting ? "thrust" : "reverse thrust");
-				if(!thrust)
-					thrustCommand = 0.;
-				else
-				{
-					energy -= cost;
-					heat += attributes.Get(isThrusting ? "thrusting heat" : "reverse thrusting heat");
-					acceleration += angle.Unit() * (thrustCommand * thrust / mass);
-				}
-			}
-		}
-		bool applyAfterburner = commands.Has(Command::AFTERBURNER) && !CannotAct();
-		if(applyAfterburner)
-		{
-			double thrust = attributes.Get("afterburner thrust");
-			double cost = attributes.Get("afterburner fuel");
-			double energyCost = attributes.Get("afterburner energy");
-			if(!thrust || fuel < cost || energy < energyCost)
-				applyAfterburner = false;
-			else
-			{
-				heat += attributes.Get("afterburner heat");
-				fuel -= cost;
-				energy -= energyCost;
-				acceleration += angle.Unit() * thrust / mass;
-				
-				if(!forget)
-					for(const EnginePoint &point : enginePoints)
-					{
-						Point pos = angle.Rotate(point) * Zoom() + position;
-						for(const auto &it : attributes.AfterburnerEffects())
-							for(int i = 0; i < it.second; ++i)
-							{
-								effects.push_back(*it.first);
-								effects.back().Place(pos + velocity, velocity - 6. * angle.Unit(), angle);
-							}
-					}
-			}
-		}
-		if(commands.Turn())
-		{
-			// Check if we are able to turn.
-			double cost = attributes.Get("turning energy");
-			if(energy < cost)
-				commands.SetTurn(0.);
-			else
-			{
-				energy -= cost;
-				heat += attributes.Get("turning heat");
-				angle += commands.Turn() * TurnRate() * slowMultiplier;
-			}
-		}
-	}
-	if(acceleration)
-	{
-		acceleration *= slowMultiplier;
-		Point dragAcceleration = acceleration - velocity * (attributes.Get("drag") / mass);
-		// Make sure dragAcceleration has nonzero length, to avoid divide by zero.
-		if(dragAcceleration)
-		{
-			// What direction will the net acceleration be if this drag is applied?
-			// If the net acceleration will be opposite the thrust, do not apply drag.
-			dragAcceleration *= .5 * (acceleration.Unit().Dot(dragAcceleration.Unit()) + 1.);
-			
-			// A ship can only "cheat" to stop if it is moving slow enough that
-			// it could stop completely this frame. This is to avoid overshooting
-			// when trying to stop and ending up headed in the other direction.
-			if(commands.Has(Command::STOP))
-			{
-				// How much acceleration would it take to come to a stop in the
-				// direction normal to the ship's current facing? This is only
-				// possible if the acceleration plus drag vector is in the
-				// opposite direction from the velocity vector when both are
-				// projected onto the current facing vector, and the acceleration
-				// vector is the larger of the two.
-				double vNormal = velocity.Dot(angle.Unit());
-				double aNormal = dragAcceleration.Dot(angle.Unit());
-				if((aNormal > 0.) != (vNormal > 0.) && fabs(aNormal) > fabs(vNormal))
-					dragAcceleration = -vNormal * angle.Unit();
-			}
-			velocity += dragAcceleration;
-		}
-		acceleration = Point();
-	}
-	
-	// Boarding:
-	if(isBoarding && (commands.Has(Command::FORWARD | Command::BACK) || commands.Turn()))
-		isBoarding = false;
-	shared_ptr<const Ship> target = GetTargetShip();
-	// If this is a fighter or drone and it is not assisting someone at the
-	// moment, its boarding target should be its parent ship.
-	if(CanBeCarried() && !(target && target == GetShipToAssist()))
-		target = GetParent();
-	if(target && !isDisabled)
-	{
-		Point dp = (target->position - position);
-		double distance = dp.Length();
-		Point dv = (target->velocity - velocity);
-		double speed = dv.Length();
-		isBoarding |= (distance < 50. && speed < 1. && commands.Has(Command::BOARD));
-		if(isBoarding && !CanBeCarried())
-		{
-			if(!target->IsDisabled() && government->IsEnemy(target->government))
-				isBoarding = false;
-			else if(target->IsDestroyed() || target->IsLanding() || target->IsHyperspacing()
-					|| target->GetSystem() != GetSystem())
-				isBoarding = false;
-		}
-		if(isBoarding && !pilotError)
-		{
-			Angle facing = angle;
-			bool left = target->Unit().Cross(facing.Unit()) < 0.;
-			double turn = left - !left;
-			
-			// Check if the ship will still be pointing to the same side of the target
-			// angle if it turns by this amount.
-			facing += TurnRate() * turn;
-			bool stillLeft = target->Unit().Cross(facing.Unit()) < 0.;
-			if(left != stillLeft)
-				turn = 0.;
-			angle += TurnRate() * turn;
-			
-			velocity += dv.Unit() * .1;
-			position += dp.Unit() * .5;
-			
-			if(distance < 10. && speed < 1. && (CanBeCarried() || !turn))
-			{
-				if(cloak)
-				{
-					// Allow the player to get all the way to the end of the
-					// boarding sequence (including locking on to the ship) but
-					// not to actually board, if they are cloaked.
-					if(government->IsPlayer())
-						Messages::Add("You cannot board a ship while cloaked.");
-				}
-				else
-				{
-					isBoarding = false;
-					bool isEnemy = government->IsEnemy(target->government);
-					if(isEnemy && Random::Real() < target->Attributes().Get("self destruct"))
-					{
-						Messages::Add("The " + target->ModelName() + " \"" + target->Name()
-							+ "\" has activated its self-destruct mechanism.");
-						targetShip.lock()->SelfDestruct();
-					}
-					else
-						hasBoarded = true;
-				}
-			}
-		}
-	}
-	
-	// Shield and hull recharge. This comes after movement so that engines take
-	// priority over shield recharge.
-	if(!isDisabled)
-	{
-		// Recharge is limited by available energy. Extra recharge capacity can
-		// be used on fighters this ship is carrying.
-		double hullRate = attributes.Get("hull repair rate");
-		if(hullRate > 0.)
-		{
-			double hullEnergy = attributes.Get("hull energy");
-			double hullHeat = attributes.Get("hull heat");
-			double hullAdded = AddHull(hullRate * min(1., hullEnergy ? energy / hullEnergy : 1.));
-			energy -= hullEnergy * hullAdded / hullRate;
-			heat += hullHeat * hullAdded / hullRate;
-		}
-		
-		double shieldRate = attributes.Get("shield generation");
-		if(shieldRate > 0.)
-		{
-			double shieldEnergy = attributes.Get("shield energy");
-			double shieldHeat = attributes.Get("shield heat");
-			double shieldsAdded = AddShields(shieldRate * min(1., shieldEnergy ? energy / shieldEnergy : 1.));
-			energy -= shieldEnergy * shieldsAdded / shieldRate;
-			heat += shieldHeat * shieldsAdded / shieldRate;
-		}
-	}
-	
-	// Clear your target if it is destroyed. This is only important for NPCs,
-	// because ordinary ships cease to exist once they are destroyed.
-	target = targetShip.lock();
-	if(target && target->IsDestroyed() && target->explosionCount >= target->explosionTotal)
-		targetShip.reset();
-	
-	// And finally: move the ship!
-	position += velocity;
-	
-	return true;
-}
-
-
-
-// Launch any ships that are ready to launch.
-void Ship::Launch(list<shared_ptr<Ship>> &ships)
-{
-	// Allow fighters to launch from a disabled ship, but not from a ship that
-	// is landing, jumping, or cloaked.
-	if(!IsDestroyed() && (!commands.Has(Command::DEPLOY) || zoom != 1. || hyperspaceCount || cloak))
-		return;
-	
-	for(Bay &bay : bays)
-		if(bay.ship && !Random::Int(40 + 20 * bay.isFighter))
-		{
-			ships.push_back(bay.ship);
-			double maxV = bay.ship->MaxVelocity();
-			Angle launchAngle = angle + BAY_ANGLE[bay.facing];
-			Point v = velocity + (.3 * maxV) * launchAngle.Unit() + (.2 * maxV) * Angle::Random().Unit();
-			bay.ship->Place(position + angle.Rotate(bay.point), v, launchAngle);
-			bay.ship->SetSystem(currentSystem);
-			bay.ship->SetParent(shared_from_this());
-			// Fighters in your ship have the same temperature as your ship
-			// itself, so when they launch they should take their share of heat
-			// with them, so that the fighter and the mothership remain at the
-			// same temperature.
-			bay.ship->heat = heat * bay.ship->Mass() / Mass();
-			heat -= bay.ship->heat;
-			
-			bay.ship.reset();
+			ships.push_back(bay.ship);
+			double maxV = bay.ship->MaxVelocity();
+			Angle launchAngle = angle + BAY_ANGLE[bay.facing];
+			Point v = velocity + (.3 * maxV) * launchAngle.Unit() + (.2 * maxV) * Angle::Random().Unit();
+			bay.ship->Place(position + angle.Rotate(bay.point), v, launchAngle);
+			bay.ship->SetSystem(currentSystem);
+			bay.ship->SetParent(shared_from_this());
+			// Fighters in your ship have the same temperature as your ship
+			// itself, so when they launch they should take their share of heat
+			// with them, so that the fighter and the mothership remain at the
+			// same temperature.
+			bay.ship->heat = heat * bay.ship->Mass() / Mass();
+			heat -= bay.ship->heat;
+			
+			bay.ship.reset();
 		}
 }
 
@@ -1403,10 +1071,10 @@ int Ship::Scan()
 		return 0;
 	
 	// The range of a scanner is proportional to the square root of its power.
-	double cargoPower = attributes.Get("cargo scan power");
-	double cargoDistance = cargoPower ? 100. * sqrt(cargoPower) : attributes.Get("cargo scan");
-	double outfitPower = attributes.Get("outfit scan power");
-	double outfitDistance = outfitPower ? 100. * sqrt(outfitPower) : attributes.Get("outfit scan");
+	double cargoPower = attributes.Get(CARGO_SCAN_POWER);
+	double cargoDistance = cargoPower ? 100. * sqrt(cargoPower) : attributes.Get(CARGO_SCAN);
+	double outfitPower = attributes.Get(OUTFIT_SCAN_POWER);
+	double outfitDistance = outfitPower ? 100. * sqrt(outfitPower) : attributes.Get(OUTFIT_SCAN);
 	
 	// Bail out if this ship has no scanners.
 	if(!cargoDistance && !outfitDistance)
@@ -1414,10 +1082,10 @@ int Ship::Scan()
 	
 	// Scanning speed also uses a square root, so you need four scanners to get
 	// twice the speed out of them.
-	double cargoSpeed = sqrt(attributes.Get("cargo scan speed"));
+	double cargoSpeed = sqrt(attributes.Get(CARGO_SCAN_SPEED));
 	if(!cargoSpeed)
 		cargoSpeed = 1.;
-	double outfitSpeed = sqrt(attributes.Get("outfit scan speed"));
+	double outfitSpeed = sqrt(attributes.Get(OUTFIT_SCAN_SPEED));
 	if(!outfitSpeed)
 		outfitSpeed = 1.;
 	
@@ -1502,7 +1170,7 @@ double Ship::OutfitScanFraction() const
 // Fire any weapons that are ready to fire. If an anti-missile is ready,
 // instead of firing here this function returns true and it can be fired if
 // collision detection finds a missile in range.
-bool Ship::Fire(list<Projectile> &projectiles, list<Effect> &effects)
+bool Ship::Fire(vector<Projectile> &projectiles, vector<Effect> &effects)
 {
 	isInSystem = true;
 	forget = 0;
@@ -1517,16 +1185,35 @@ bool Ship::Fire(list<Projectile> &projectiles, list<Effect> &effects)
 	
 	antiMissileRange = 0.;
 	
+	// Turrets aim at this ship's target. Look it up once, the first time any
+	// weapon fires, rather than separately for each turret.
+	shared_ptr<const Ship> target;
+	bool hasTarget = false;
+	
 	const vector<Hardpoint> &weapons = armament.Get();
 	for(unsigned i = 0; i < weapons.size(); ++i)
 	{
 		const Outfit *outfit = weapons[i].GetOutfit();
-		if(outfit && CanFire(outfit))
+		if(!outfit)
+			continue;
+		
+		// Only check whether a weapon can fire if it would actually be used.
+		if(outfit->AntiMissile())
 		{
-			if(outfit->AntiMissile())
+			if(CanFire(outfit))
 				antiMissileRange = max(antiMissileRange, outfit->Velocity() + weaponRadius);
-			else if(commands.HasFire(i))
-				armament.Fire(i, *this, projectiles, effects);
+		}
+		else if(commands.HasFire(i) && CanFire(outfit))
+		{
+			if(!hasTarget)
+			{
+				hasTarget = true;
+				target = GetTargetShip();
+				// If you are boarding your target, do not fire on it.
+				if(target && (IsBoarding() || commands.Has(Command::BOARD) || !target->IsTargetable()))
+					target.reset();
+			}
+			armament.Fire(i, *this, target.get(), projectiles, effects);
 		}
 	}
 	
@@ -1537,8 +1224,16 @@ bool Ship::Fire(list<Projectile> &projectiles, list<Effect> &effects)
 
 
 
+// Get the range of the anti-missiles that Fire() found ready to fire.
+double Ship::AntiMissileRange() const
+{
+	return antiMissileRange;
+}
+
+
+
 // Fire an anti-missile.
-bool Ship::FireAntiMissile(const Projectile &projectile, list<Effect> &effects)
+bool Ship::FireAntiMissile(const Projectile &projectile, vector<Effect> &effects)
 {
 	if(projectile.Position().Distance(position) > antiMissileRange)
 		return false;
@@ -1687,8 +1382,8 @@ bool Ship::IsReadyToJump() const
 		return false;
 	
 	Point direction = targetSystem->Position() - currentSystem->Position();
-	bool isJump = !attributes.Get("hyperdrive") || !currentSystem->Links().count(targetSystem);
-	double scramThreshold = attributes.Get("scram drive");
+	bool isJump = !attributes.Get(HYPERDRIVE) || !currentSystem->Links().count(targetSystem);
+	double scramThreshold = attributes.Get(SCRAM_DRIVE);
 	
 	// The ship can only enter hyperspace if it is traveling slowly enough
 	// and pointed in the right direction.
@@ -1698,7 +1393,7 @@ bool Ship::IsReadyToJump() const
 		if(deviation > scramThreshold)
 			return false;
 	}
-	else if(velocity.Length() > attributes.Get("jump speed"))
+	else if(velocity.Length() > attributes.Get(JUMP_SPEED))
 		return false;
 	
 	if(!isJump)
@@ -1728,7 +1423,7 @@ bool Ship::IsThrusting() const
 // Get the points from which engine flares should be drawn.
 const vector<Ship::EnginePoint> &Ship::EnginePoints() const
 {
-	return enginePoints;
+	return chassis->enginePoints;
 }
 
 
@@ -1773,20 +1468,20 @@ void Ship::Recharge(bool atSpaceport)
 	
 	if(atSpaceport)
 	{
-		crew = min<int>(max(crew, RequiredCrew()), attributes.Get("bunks"));
-		fuel = attributes.Get("fuel capacity");
+		crew = min<int>(max(crew, RequiredCrew()), attributes.Get(BUNKS));
+		fuel = attributes.Get(FUEL_CAPACITY);
 	}
 	pilotError = 0;
 	pilotOkay = 0;
 	
 	if(!personality.IsDerelict())
 	{
-		if(atSpaceport || attributes.Get("shield generation"))
-			shields = attributes.Get("shields");
-		if(atSpaceport || attributes.Get("hull repair rate"))
-			hull = attributes.Get("hull");
-		if(atSpaceport || attributes.Get("energy generation"))
-			energy = attributes.Get("energy capacity");
+		if(atSpaceport || attributes.Get(SHIELD_GENERATION))
+			shields = attributes.Get(SHIELDS);
+		if(atSpaceport || attributes.Get(HULL_REPAIR_RATE))
+			hull = attributes.Get(HULL);
+		if(atSpaceport || attributes.Get(ENERGY_GENERATION))
+			energy = attributes.Get(ENERGY_CAPACITY);
 	}
 	heat = IdleHeat();
 	ionization = 0.;
@@ -1805,10 +1500,10 @@ bool Ship::CanRefuel(const Ship &other) const
 
 double Ship::TransferFuel(double amount, Ship *to)
 {
-	amount = max(fuel - attributes.Get("fuel capacity"), amount);
+	amount = max(fuel - attributes.Get(FUEL_CAPACITY), amount);
 	if(to)
 	{
-		amount = min(to->attributes.Get("fuel capacity") - to->fuel, amount);
+		amount = min(to->attributes.Get(FUEL_CAPACITY) - to->fuel, amount);
 		to->fuel += amount;
 	}
 	fuel -= amount;
@@ -1860,7 +1555,7 @@ void Ship::WasCaptured(const shared_ptr<Ship> &capturer)
 // Get characteristics of this ship, as a fraction between 0 and 1.
 double Ship::Shields() const
 {
-	double maximum = attributes.Get("shields");
+	double maximum = attributes.Get(SHIELDS);
 	return maximum ? min(1., shields / maximum) : 0.;
 }
 
@@ -1868,7 +1563,7 @@ double Ship::Shields() const
 
 double Ship::Hull() const
 {
-	double maximum = attributes.Get("hull");
+	double maximum = attributes.Get(HULL);
 	return maximum ? min(1., hull / maximum) : 1.;
 }
 
@@ -1876,7 +1571,7 @@ double Ship::Hull() const
 
 double Ship::Energy() const
 {
-	double maximum = attributes.Get("energy capacity");
+	double maximum = attributes.Get(ENERGY_CAPACITY);
 	return maximum ? min(1., energy / maximum) : (hull > 0.) ? 1. : 0.;
 }
 
@@ -1892,7 +1587,7 @@ double Ship::Heat() const
 
 double Ship::Fuel() const
 {
-	double maximum = attributes.Get("fuel capacity");
+	double maximum = attributes.Get(FUEL_CAPACITY);
 	return maximum ? min(1., fuel / maximum) : 0.;
 }
 
@@ -1915,10 +1610,10 @@ double Ship::JumpFuel(const System *destination) const
 		return max(JumpDriveFuel(), HyperdriveFuel());
 	
 	// Figure out what sort of jump we're making.
-	if(attributes.Get("hyperdrive") && currentSystem->Links().count(destination))
+	if(attributes.Get(HYPERDRIVE) && currentSystem->Links().count(destination))
 		return HyperdriveFuel();
 	
-	if(attributes.Get("jump drive") && currentSystem->Neighbors().count(destination))
+	if(attributes.Get(JUMP_DRIVE) && currentSystem->Neighbors().count(destination))
 		return JumpDriveFuel();
 	
 	// If the given system is not a possible destination, return 0.
@@ -1930,25 +1625,14 @@ double Ship::JumpFuel(const System *destination) const
 // Get the cost of making a jump of the given type (if possible).
 double Ship::HyperdriveFuel() const
 {
-	// Don't bother searching through the outfits if there is no hyperdrive.
-	if(!attributes.Get("hyperdrive"))
-		return JumpDriveFuel();
-	
-	if(attributes.Get("scram drive"))
-		return BestFuel("hyperdrive", "scram drive", 150.);
-	
-	return BestFuel("hyperdrive", "", 100.);
+	return hyperdriveFuel;
 }
 
 
 
 double Ship::JumpDriveFuel() const
 {
-	// Don't bother searching through the outfits if there is no jump drive.
-	if(!attributes.Get("jump drive"))
-		return 0.;
-	
-	return BestFuel("jump drive", "", 200.);
+	return jumpDriveFuel;
 }
 
 
@@ -1958,7 +1642,7 @@ double Ship::JumpFuelMissing() const
 	// Used for smart refuelling: transfer only as much as really needed
 	// includes checking if fuel cap is high enough at all
 	double jumpFuel = JumpFuel(targetSystem);
-	if(!jumpFuel || fuel > jumpFuel || jumpFuel > attributes.Get("fuel capacity"))
+	if(!jumpFuel || fuel > jumpFuel || jumpFuel > attributes.Get(FUEL_CAPACITY))
 		return 0.;
 	
 	return jumpFuel - fuel;
@@ -1971,15 +1655,15 @@ double Ship::IdleHeat() const
 {
 	// This ship's cooling ability:
 	double coolingEfficiency = CoolingEfficiency();
-	double cooling = coolingEfficiency * attributes.Get("cooling");
-	double activeCooling = coolingEfficiency * attributes.Get("active cooling");
+	double cooling = coolingEfficiency * attributes.Get(COOLING);
+	double activeCooling = coolingEfficiency * attributes.Get(ACTIVE_COOLING);
 	
 	// Idle heat is the heat level where:
 	// heat = heat * diss + heatGen - cool - activeCool * heat / (100 * mass)
 	// heat = heat * (diss - activeCool / (100 * mass)) + (heatGen - cool)
 	// heat * (1 - diss + activeCool / (100 * mass)) = (heatGen - cool)
-	double production = max(0., attributes.Get("heat generation") - cooling);
-	double dissipation = .001 * attributes.Get("heat dissipation") + activeCooling / (100. * Mass());
+	double production = max(0., attributes.Get(HEAT_GENERATION) - cooling);
+	double dissipation = .001 * attributes.Get(HEAT_DISSIPATION) + activeCooling / (100. * Mass());
 	return production / dissipation;
 }
 
@@ -1988,11 +1672,7 @@ double Ship::IdleHeat() const
 // Calculate the multiplier for cooling efficiency.
 double Ship::CoolingEfficiency() const
 {
-	// This is an S-curve where the efficiency is 100% if you have no outfits
-	// that create "cooling inefficiency", and as that value increases the
-	// efficiency stays high for a while, then drops off, then approaches 0.
-	double x = attributes.Get("cooling inefficiency");
-	return 2. + 2. / (1. + exp(x / -2.)) - 4. / (1. + exp(x / -4.));
+	return coolingEfficiency;
 }
 
 
@@ -2006,18 +1686,18 @@ int Ship::Crew() const
 
 int Ship::RequiredCrew() const
 {
-	if(attributes.Get("automaton"))
+	if(attributes.Get(AUTOMATON))
 		return 0;
 	
 	// Drones do not need crew, but all other ships need at least one.
-	return max<int>(1, attributes.Get("required crew"));
+	return max<int>(1, attributes.Get(REQUIRED_CREW));
 }
 
 
 
 void Ship::AddCrew(int count)
 {
-	crew = min<int>(crew + count, attributes.Get("bunks"));
+	crew = min<int>(crew + count, attributes.Get(BUNKS));
 }
 
 
@@ -2036,21 +1716,21 @@ double Ship::Mass() const
 	for(const Bay &bay : bays)
 		if(bay.ship)
 			carried += bay.ship->Mass();
-	return carried + cargo.Used() + attributes.Get("mass");
+	return carried + cargo.Used() + attributes.Get(MASS);
 }
 
 
 
 double Ship::TurnRate() const
 {
-	return attributes.Get("turn") / Mass();
+	return attributes.Get(TURN) / Mass();
 }
 
 
 
 double Ship::Acceleration() const
 {
-	return attributes.Get("thrust") / Mass();
+	return attributes.Get(THRUST) / Mass();
 }
 
 
@@ -2060,7 +1740,7 @@ double Ship::MaxVelocity() const
 	// v * drag / mass == thrust / mass
 	// v * drag == thrust
 	// v = thrust / drag
-	return attributes.Get("thrust") / attributes.Get("drag");
+	return attributes.Get(THRUST) / attributes.Get(DRAG);
 }
 
 
@@ -2231,6 +1911,17 @@ const vector<Ship::Bay> &Ship::Bays() const
 
 
 
+// Put the given ships back in this ship's bays, one for each bay, in the
+// same order that Bays() lists them. Copying a bay does not copy the ship
+// inside it, so this is needed to restore a ship from a copy of it.
+void Ship::RestoreBays(const vector<shared_ptr<Ship>> &carried)
+{
+	for(unsigned i = 0; i < bays.size() && i < carried.size(); ++i)
+		bays[i].ship = carried[i];
+}
+
+
+
 // Adjust the positions and velocities of any visible carried fighters or
 // drones. If any are visible, return true.
 bool Ship::PositionFighters() const
@@ -2276,7 +1967,7 @@ void Ship::Jettison(const string &commodity, int tons)
 	
 	static const int perBox = 5;
 	for( ; tons >= perBox; tons -= perBox)
-		jettisoned.emplace_back(new Flotsam(commodity, perBox));
+		jettisoned.push_back(allocate_shared<Flotsam>(PoolAllocator<Flotsam>(), commodity, perBox));
 }
 
 
@@ -2290,14 +1981,14 @@ void Ship::Jettison(const Outfit *outfit, int count)
 	
 	// Jettisoned cargo must carry some of the ship's heat with it. Otherwise
 	// jettisoning cargo would increase the ship's temperature.
-	double mass = outfit->Get("mass");
+	double mass = outfit->Get(MASS);
 	double shipMass = Mass();
 	heat *= shipMass / (shipMass + count * mass);
 	
 	const int perBox = (mass <= 0.) ? count : (mass > 5.) ? 1 : static_cast<int>(5. / mass);
 	while(count > 0)
 	{
-		jettisoned.emplace_back(new Flotsam(outfit, (perBox < count) ? perBox : count));
+		jettisoned.push_back(allocate_shared<Flotsam>(PoolAllocator<Flotsam>(), outfit, (perBox < count) ? perBox : count));
 		count -= perBox;
 	}
 }
@@ -2313,13 +2004,13 @@ const Outfit &Ship::Attributes() const
 
 const Outfit &Ship::BaseAttributes() const
 {
-	return baseAttributes;
+	return chassis->baseAttributes;
 }
 
 
 
 // Get outfit information.
-const map<const Outfit *, int> &Ship::Outfits() const
+const FlatMap<const Outfit *, int> &Ship::Outfits() const
 {
 	return outfits;
 }
@@ -2341,7 +2032,7 @@ void Ship::AddOutfit(const Outfit *outfit, int count)
 	{
 		auto it = outfits.find(outfit);
 		if(it == outfits.end())
-			outfits[outfit] = count;
+			outfits.emplace(outfit, count);
 		else
 		{
 			it->second += count;
@@ -2352,10 +2043,11 @@ void Ship::AddOutfit(const Outfit *outfit, int count)
 		if(outfit->IsWeapon())
 			armament.Add(outfit, count);
 		
-		if(outfit->Get("cargo space"))
-			cargo.SetSize(attributes.Get("cargo space"));
-		if(outfit->Get("hull"))
-			hull += outfit->Get("hull") * count;
+		if(outfit->Get(CARGO_SPACE))
+			cargo.SetSize(attributes.Get(CARGO_SPACE));
+		if(outfit->Get(HULL))
+			hull += outfit->Get(HULL) * count;
+		UpdateOutfitStats();
 	}
 }
 
@@ -2538,6 +2230,530 @@ const vector<weak_ptr<const Ship>> &Ship::GetEscorts() const
 
 
 
+// Let ionization, disruption and slowing wear off, and release any cargo
+// that was jettisoned.
+void Ship::UpdateStatusEffects(vector<Effect> &effects, list<shared_ptr<Flotsam>> &flotsam)
+{
+	// Handle ionization effects, etc.
+	if(ionization)
+	{
+		ionization *= .99;
+		CreateSparks(effects, "ion spark", ionization * .1);
+	}
+	if(disruption)
+	{
+		disruption *= .99;
+		CreateSparks(effects, "disruption spark", disruption * .1);
+	}
+	if(slowness)
+	{
+		slowness *= .99;
+		CreateSparks(effects, "slowing spark", slowness * .1);
+	}
+	// Jettisoned cargo effects (only for ships in the current system).
+	if(!jettisoned.empty() && !forget)
+	{
+		jettisoned.front()->Place(*this);
+		flotsam.splice(flotsam.end(), jettisoned, jettisoned.begin());
+	}
+}
+
+
+
+// Update this ship's energy, heat, fuel, scanning and cloaking, and check
+// whether it is disabled.
+void Ship::UpdateSupplies()
+{
+	// When ships recharge, what actually happens is that they can exceed their
+	// maximum capacity for the rest of the turn, but must be clamped to the
+	// maximum here before they gain more. This is so that, for example, a ship
+	// with no batteries but a good generator can still move.
+	energy = min(energy, attributes.Get(ENERGY_CAPACITY));
+	
+	heat -= .001 * heat * attributes.Get(HEAT_DISSIPATION);
+	if(heat > Mass() * 100.)
+		isOverheated = true;
+	else if(heat < Mass() * 90.)
+		isOverheated = false;
+	
+	double maxShields = attributes.Get(SHIELDS);
+	shields = min(shields, maxShields);
+	double maxHull = attributes.Get(HULL);
+	hull = min(hull, maxHull);
+	
+	int requiredCrew = RequiredCrew();
+	isDisabled = isOverheated || hull < MinimumHull() || (!crew && requiredCrew);
+	
+	// Whenever not actively scanning, the amount of scan information the ship
+	// has "decays" over time. For a scanner with a speed of 1, one second of
+	// uninterrupted scanning is required to successfully scan its target.
+	// Only apply the decay if not already done scanning the target.
+	if(cargoScan < SCAN_TIME)
+		cargoScan = max(0., cargoScan - 1.);
+	if(outfitScan < SCAN_TIME)
+		outfitScan = max(0., outfitScan - 1.);
+	
+	// Update ship supply levels.
+	if(!isDisabled)
+	{
+		// Ramscoops work much better when close to the system center. Even if a
+		// ship has no ramscoop, it can harvest a tiny bit of fuel by flying
+		// close to the star.
+		double scale = .2 + 1.8 / (.001 * position.Length() + 1);
+		fuel += .03 * scale * (sqrt(attributes.Get(RAMSCOOP)) + .05 * scale);
+		fuel = min(fuel, attributes.Get(FUEL_CAPACITY));
+		
+		energy += scale * attributes.Get(SOLAR_COLLECTION);
+		
+		double coolingEfficiency = CoolingEfficiency();
+		energy += attributes.Get(ENERGY_GENERATION) - attributes.Get(ENERGY_CONSUMPTION);
+		energy -= ionization;
+		energy = max(0., energy);
+		heat += attributes.Get(HEAT_GENERATION);
+		heat -= coolingEfficiency * attributes.Get(COOLING);
+		heat = max(0., heat);
+		
+		// Apply active cooling. The fraction of full cooling to apply equals
+		// your ship's current fraction of its maximum temperature.
+		double activeCooling = coolingEfficiency * attributes.Get(ACTIVE_COOLING);
+		if(activeCooling > 0.)
+		{
+			// Although it's a misuse of this feature, handle the case where
+			// "active cooling" does not require any energy.
+			double coolingEnergy = attributes.Get(COOLING_ENERGY);
+			if(coolingEnergy)
+			{
+				double spentEnergy = min(energy, coolingEnergy * min(1., Heat()));
+				heat -= activeCooling * spentEnergy / coolingEnergy;
+				energy -= spentEnergy;
+			}
+			else
+				heat -= activeCooling;
+			
+			heat = max(0., heat);
+		}
+	}
+	
+	if(!isInvisible)
+	{
+		double cloakingSpeed = attributes.Get(CLOAK);
+		bool canCloak = (!isDisabled && cloakingSpeed > 0.
+			&& fuel >= attributes.Get(CLOAKING_FUEL)
+			&& energy >= attributes.Get(CLOAKING_ENERGY));
+		if(commands.Has(Command::CLOAK) && canCloak)
+		{
+			cloak = min(1., cloak + cloakingSpeed);
+			fuel -= attributes.Get(CLOAKING_FUEL);
+			energy -= attributes.Get(CLOAKING_ENERGY);
+		}
+		else if(cloakingSpeed)
+			cloak = max(0., cloak - cloakingSpeed);
+		else
+			cloak = 0.;
+	}
+}
+
+
+
+// Create the explosions for a ship that is being destroyed. This returns
+// false once the ship is done exploding and should be deleted.
+bool Ship::UpdateExplosion(vector<Effect> &effects, list<shared_ptr<Flotsam>> &flotsam)
+{
+	// Make sure the shields are zero, as well as the hull.
+	shields = 0.;
+	
+	// Once we've created enough little explosions, die.
+	if(explosionCount == explosionTotal || forget)
+	{
+		if(!forget)
+		{
+			static const Effect *effect = GameData::Effects().Get("smoke");
+			double size = Width() + Height();
+			double scale = .03 * size + .5;
+			double radius = .2 * size;
+			int debrisCount = attributes.Get(MASS) * .07;
+			for(int i = 0; i < debrisCount; ++i)
+			{
+				effects.push_back(*effect);
+				
+				Angle angle = Angle::Random();
+				Point effectVelocity = velocity + angle.Unit() * (scale * Random::Real());
+				Point effectPosition = position + radius * angle.Unit();
+				effects.back().Place(effectPosition, effectVelocity, angle);
+			}
+				
+			for(unsigned i = 0; i < explosionTotal / 2; ++i)
+				CreateExplosion(effects, true);
+			for(const auto &it : chassis->finalExplosions)
+			{
+				effects.push_back(*it.first);
+				effects.back().Place(position, velocity, angle);
+			}
+			// For everything in this ship's cargo hold there is a 25% chance
+			// that it will survive as flotsam.
+			for(const auto &it : cargo.Commodities())
+				Jettison(it.first, Random::Binomial(it.second, .25));
+			for(const auto &it : cargo.Outfits())
+				Jettison(it.first, Random::Binomial(it.second, .25));
+			for(shared_ptr<Flotsam> &it : jettisoned)
+				it->Place(*this);
+			flotsam.splice(flotsam.end(), jettisoned);
+		}
+		energy = 0.;
+		heat = 0.;
+		ionization = 0.;
+		fuel = 0.;
+		return false;
+	}
+	
+	// If the ship is dead, it first creates explosions at an increasing
+	// rate, then disappears in one big explosion.
+	++explosionRate;
+	if(Random::Int(1024) < explosionRate)
+		CreateExplosion(effects);
+	
+	return true;
+}
+
+
+
+// Move a ship that is entering or leaving hyperspace.
+void Ship::MoveInHyperspace(vector<Effect> &effects)
+{
+	// Don't apply external acceleration while jumping.
+	acceleration = Point();
+	
+	// Enter hyperspace.
+	int direction = hyperspaceSystem ? 1 : -1;
+	hyperspaceCount += direction;
+	static const int HYPER_C = 100;
+	static const double HYPER_A = 2.;
+	static const double HYPER_D = 1000.;
+	if(hyperspaceSystem)
+		fuel -= hyperspaceFuelCost / HYPER_C;
+	
+	// Create the particle effects for the jump drive. This may create 100
+	// or more particles per ship per turn at the peak of the jump.
+	if(isUsingJumpDrive && !forget)
+		CreateSparks(effects, "jump drive", hyperspaceCount * Width() * Height() * .000006);
+	
+	if(hyperspaceCount == HYPER_C)
+	{
+		currentSystem = hyperspaceSystem;
+		hyperspaceSystem = nullptr;
+		targetSystem = nullptr;
+		// Check if the target planet is in the destination system or not.
+		const Planet *planet = (targetPlanet ? targetPlanet->GetPlanet() : nullptr);
+		if(!planet || planet->IsWormhole() || !planet->IsInSystem(currentSystem))
+			targetPlanet = nullptr;
+		// Check if your parent has a target planet in this system.
+		if(!targetPlanet && parentTargetPlanet)
+		{
+			planet = parentTargetPlanet->GetPlanet();
+			if(planet && !planet->IsWormhole() && planet->IsInSystem(currentSystem))
+				targetPlanet = parentTargetPlanet;
+		}
+		direction = -1;
+		
+		// If you have a target planet in the destination system, exit
+		// hyperpace aimed at it. Otherwise, target the first planet that
+		// has a spaceport.
+		Point target;
+		if(targetPlanet)
+			target = targetPlanet->Position();
+		else
+		{
+			for(const StellarObject &object : currentSystem->Objects())
+				if(object.GetPlanet() && object.GetPlanet()->HasSpaceport())
+				{
+					target = object.Position();
+					break;
+				}
+		}
+		
+		if(isUsingJumpDrive)
+		{
+			position = target + Angle::Random().Unit() * 300. * (Random::Real() + 1.);
+			return;
+		}
+		
+		// Have all ships exit hyperspace at the same distance so that
+		// your escorts always stay with you.
+		double distance = (HYPER_C * HYPER_C) * .5 * HYPER_A + HYPER_D;
+		position = (target - distance * angle.Unit());
+		position += hyperspaceOffset;
+		// Make sure your velocity is in exactly the direction you are
+		// traveling in, so that when you decelerate there will not be a
+		// sudden shift in direction at the end.
+		velocity = velocity.Length() * angle.Unit();
+	}
+	if(!isUsingJumpDrive)
+	{
+		velocity += (HYPER_A * direction) * angle.Unit();
+		if(!hyperspaceSystem)
+		{
+			// Exit hyperspace far enough from the planet to be able to land.
+			// This does not take drag into account, so it is always an over-
+			// estimate of how long it will take to stop.
+			// We start decellerating after rotating about 150 degrees (that
+			// is, about acos(.8) from the proper angle). So:
+			// Stopping distance = .5*a*(v/a)^2 + (150/turn)*v.
+			// Exit distance = HYPER_D + .25 * v^2 = stopping distance.
+			double exitV = MaxVelocity();
+			double a = (.5 / Acceleration() - .25);
+			double b = 150. / TurnRate();
+			double discriminant = b * b - 4. * a * -HYPER_D;
+			if(discriminant > 0.)
+			{
+				double altV = (-b + sqrt(discriminant)) / (2. * a);
+				if(altV > 0. && altV < exitV)
+					exitV = altV;
+			}
+			if(velocity.Length() <= exitV)
+			{
+				velocity = angle.Unit() * exitV;
+				hyperspaceCount = 0;
+			}
+		}
+	}
+	position += velocity;
+	// Once every ship has moved, MoveRelative() will update this ship's
+	// offset from its parent.
+	isTrackingParent = true;
+}
+
+
+
+// Move a ship that is landing on or taking off from a planet. This returns
+// false if the ship has landed and should be deleted.
+bool Ship::MoveWhileLanding()
+{
+	// Don't apply external acceleration while landing.
+	acceleration = Point();
+	
+	// If a ship was disabled at the very moment it began landing, do not
+	// allow it to continue landing.
+	if(isDisabled)
+		landingPlanet = nullptr;
+	
+	// Special ships do not disappear forever when they land; they
+	// just slowly refuel.
+	if(landingPlanet && zoom)
+	{
+		// Move the ship toward the center of the planet while landing.
+		if(GetTargetStellar())
+			position = .97 * position + .03 * GetTargetStellar()->Position();
+		zoom -= .02;
+		if(zoom < 0.)
+		{
+			// If this is not a special ship, it ceases to exist when it
+			// lands on a true planet. If this is a wormhole, the ship is
+			// instantly transported.
+			if(landingPlanet->IsWormhole())
+			{
+				currentSystem = landingPlanet->WormholeDestination(currentSystem);
+				for(const StellarObject &object : currentSystem->Objects())
+					if(object.GetPlanet() == landingPlanet)
+						position = object.Position();
+				SetTargetStellar(nullptr);
+				landingPlanet = nullptr;
+			}
+			else if(!isSpecial || personality.IsFleeing())
+				return false;
+			
+			zoom = 0.;
+		}
+	}
+	// Only refuel if this planet has a spaceport.
+	else if(fuel == attributes.Get(FUEL_CAPACITY)
+			|| !landingPlanet || !landingPlanet->HasSpaceport())
+	{
+		zoom = min(1., zoom + .02);
+		SetTargetStellar(nullptr);
+		landingPlanet = nullptr;
+	}
+	else
+		fuel = min(fuel + 1., attributes.Get(FUEL_CAPACITY));
+	
+	// Move the ship at the velocity it had when it began landing, but
+	// scaled based on how small it is now.
+	if(zoom > 0.)
+		position += velocity * zoom;
+	
+	return true;
+}
+
+
+
+// Check whether a ship without enough crew makes a piloting error this step.
+void Ship::UpdatePilot()
+{
+	int requiredCrew = RequiredCrew();
+	if(pilotError)
+		--pilotError;
+	else if(pilotOkay)
+		--pilotOkay;
+	else if(isDisabled)
+	{
+		// If the ship is disabled, don't show a warning message due to missing crew.
+	}
+	else if(requiredCrew && static_cast<int>(Random::Int(requiredCrew)) >= Crew())
+	{
+		pilotError = 30;
+		if(!parent.expired() || !government->IsPlayer())
+			Messages::Add(name + " is moving erratically because there are not enough crew to pilot it.");
+		else
+			Messages::Add("Your ship is moving erratically because you do not have enough crew to pilot it.");
+	}
+	else
+		pilotOkay = 30;
+}
+
+
+
+// Apply this ship's thrust, afterburner and turning commands, along with
+// drag, to its velocity and facing.
+void Ship::UpdateVelocity(vector<Effect> &effects, double slowMultiplier)
+{
+	// This ship is not landing or entering hyperspace. So, move it. If it is
+	// disabled, all it can do is slow down to a stop.
+	double mass = Mass();
+	if(isDisabled)
+		velocity *= 1. - attributes.Get(DRAG) / mass;
+	else if(!pilotError)
+	{
+		double thrustCommand = commands.Has(Command::FORWARD) - commands.Has(Command::BACK);
+		if(thrustCommand)
+		{
+			// Check if we are able to apply this thrust.
+			double cost = attributes.Get((thrustCommand > 0.) ?
+				THRUSTING_ENERGY : REVERSE_THRUSTING_ENERGY);
+			if(energy < cost)
+				thrustCommand = 0.;
+			else
+			{
+				// If a reverse thrust is commanded and the capability does not
+				// exist, ignore it (do not even slow under drag).
+				isThrusting = (thrustCommand > 0.);
+				double thrust = attributes.Get(isThrusting ? THRUST : REVERSE_THRUST);
+				if(!thrust)
+					thrustCommand = 0.;
+				else
+				{
+					energy -= cost;
+					heat += attributes.Get(isThrusting ? THRUSTING_HEAT : REVERSE_THRUSTING_HEAT);
+					acceleration += angle.Unit() * (thrustCommand * thrust / mass);
+				}
+			}
+		}
+		bool applyAfterburner = commands.Has(Command::AFTERBURNER) && !CannotAct();
+		if(applyAfterburner)
+		{
+			double thrust = attributes.Get(AFTERBURNER_THRUST);
+			double cost = attributes.Get(AFTERBURNER_FUEL);
+			double energyCost = attributes.Get(AFTERBURNER_ENERGY);
+			if(!thrust || fuel < cost || energy < energyCost)
+				applyAfterburner = false;
+			else
+			{
+				heat += attributes.Get(AFTERBURNER_HEAT);
+				fuel -= cost;
+				energy -= energyCost;
+				acceleration += angle.Unit() * thrust / mass;
+				
+				if(!forget)
+					for(const EnginePoint &point : chassis->enginePoints)
+					{
+						Point pos = angle.Rotate(point) * Zoom() + position;
+						for(const auto &it : attributes.AfterburnerEffects())
+							for(int i = 0; i < it.second; ++i)
+							{
+								effects.push_back(*it.first);
+								effects.back().Place(pos + velocity, velocity - 6. * angle.Unit(), angle);
+							}
+					}
+			}
+		}
+		if(commands.Turn())
+		{
+			// Check if we are able to turn.
+			double cost = attributes.Get(TURNING_ENERGY);
+			if(energy < cost)
+				commands.SetTurn(0.);
+			else
+			{
+				energy -= cost;
+				heat += attributes.Get(TURNING_HEAT);
+				angle += commands.Turn() * TurnRate() * slowMultiplier;
+			}
+		}
+	}
+	if(acceleration)
+	{
+		acceleration *= slowMultiplier;
+		Point dragAcceleration = acceleration - velocity * (attributes.Get(DRAG) / mass);
+		// Make sure dragAcceleration has nonzero length, to avoid divide by zero.
+		if(dragAcceleration)
+		{
+			// What direction will the net acceleration be if this drag is applied?
+			// If the net acceleration will be opposite the thrust, do not apply drag.
+			dragAcceleration *= .5 * (acceleration.Unit().Dot(dragAcceleration.Unit()) + 1.);
+			
+			// A ship can only "cheat" to stop if it is moving slow enough that
+			// it could stop completely this frame. This is to avoid overshooting
+			// when trying to stop and ending up headed in the other direction.
+			if(commands.Has(Command::STOP))
+			{
+				// How much acceleration would it take to come to a stop in the
+				// direction normal to the ship's current facing? This is only
+				// possible if the acceleration plus drag vector is in the
+				// opposite direction from the velocity vector when both are
+				// projected onto the current facing vector, and the acceleration
+				// vector is the larger of the two.
+				double vNormal = velocity.Dot(angle.Unit());
+				double aNormal = dragAcceleration.Dot(angle.Unit());
+				if((aNormal > 0.) != (vNormal > 0.) && fabs(aNormal) > fabs(vNormal))
+					dragAcceleration = -vNormal * angle.Unit();
+			}
+			velocity += dragAcceleration;
+		}
+		acceleration = Point();
+	}
+}
+
+
+
+// Use this ship's energy to repair its hull and recharge its shields.
+void Ship::RegenerateHullAndShields()
+{
+	if(isDisabled)
+		return;
+	
+	// Recharge is limited by available energy. Extra recharge capacity can
+	// be used on fighters this ship is carrying.
+	double hullRate = attributes.Get(HULL_REPAIR_RATE);
+	if(hullRate > 0.)
+	{
+		double hullEnergy = attributes.Get(HULL_ENERGY);
+		double hullHeat = attributes.Get(HULL_HEAT);
+		double hullAdded = AddHull(hullRate * min(1., hullEnergy ? energy / hullEnergy : 1.));
+		energy -= hullEnergy * hullAdded / hullRate;
+		heat += hullHeat * hullAdded / hullRate;
+	}
+	
+	double shieldRate = attributes.Get(SHIELD_GENERATION);
+	if(shieldRate > 0.)
+	{
+		double shieldEnergy = attributes.Get(SHIELD_ENERGY);
+		double shieldHeat = attributes.Get(SHIELD_HEAT);
+		double shieldsAdded = AddShields(shieldRate * min(1., shieldEnergy ? energy / shieldEnergy : 1.));
+		energy -= shieldEnergy * shieldsAdded / shieldRate;
+		heat += shieldHeat * shieldsAdded / shieldRate;
+	}
+}
+
+
+
 // Add escorts to this ship. Escorts look to the parent ship for movement
 // cues and try to stay with it when it lands or goes into hyperspace.
 void Ship::AddEscort(const Ship &ship)
@@ -2565,7 +2781,7 @@ double Ship::MinimumHull() const
 	if(neverDisabled)
 		return 0.;
 	
-	double maximumHull = attributes.Get("hull");
+	double maximumHull = attributes.Get(HULL);
 	return max(.20 * maximumHull, min(.50 * maximumHull, 400.));
 }
 
@@ -2575,7 +2791,7 @@ double Ship::MinimumHull() const
 // ship is carrying fighters, add to them as well.
 double Ship::AddHull(double rate)
 {
-	double added = min(rate, attributes.Get("hull") - hull);
+	double added = min(rate, attributes.Get(HULL) - hull);
 	hull += added;
 	rate -= added;
 	
@@ -2584,8 +2800,8 @@ double Ship::AddHull(double rate)
 		if(!bay.ship)
 			continue;
 		
-		double myGen = bay.ship->Attributes().Get("hull repair rate");
-		double myMax = bay.ship->Attributes().Get("hull");
+		double myGen = bay.ship->Attributes().Get(HULL_REPAIR_RATE);
+		double myMax = bay.ship->Attributes().Get(HULL);
 		bay.ship->hull = min(myMax, bay.ship->hull + myGen);
 		if(rate > 0. && bay.ship->hull < myMax)
 		{
@@ -2602,7 +2818,7 @@ double Ship::AddHull(double rate)
 
 double Ship::AddShields(double rate)
 {
-	double added = min(rate, attributes.Get("shields") - shields);
+	double added = min(rate, attributes.Get(SHIELDS) - shields);
 	shields += added;
 	rate -= added;
 	
@@ -2611,8 +2827,8 @@ double Ship::AddShields(double rate)
 		if(!bay.ship)
 			continue;
 		
-		double myGen = bay.ship->Attributes().Get("shield generation");
-		double myMax = bay.ship->Attributes().Get("shields");
+		double myGen = bay.ship->Attributes().Get(SHIELD_GENERATION);
+		double myMax = bay.ship->Attributes().Get(SHIELDS);
 		bay.ship->shields = min(myMax, bay.ship->shields + myGen);
 		if(rate > 0. && bay.ship->shields < myMax)
 		{
@@ -2633,9 +2849,9 @@ double Ship::BestFuel(const string &type, const string &subtype, double defaultF
 	// Find the outfit that provides the least costly hyperjump.
 	double best = 0.;
 	// Make it possible for a hyperdrive to be integrated into a ship.
-	if(baseAttributes.Get(type) && (subtype.empty() || baseAttributes.Get(subtype)))
+	if(chassis->baseAttributes.Get(type) && (subtype.empty() || chassis->baseAttributes.Get(subtype)))
 	{
-		best = baseAttributes.Get("jump fuel");
+		best = chassis->baseAttributes.Get(JUMP_FUEL);
 		if(!best)
 			best = defaultFuel;
 	}
@@ -2643,7 +2859,7 @@ double Ship::BestFuel(const string &type, const string &subtype, double defaultF
 	for(const auto &it : outfits)
 		if(it.first->Get(type) && (subtype.empty() || it.first->Get(subtype)))
 		{
-			double fuel = it.first->Get("jump fuel");
+			double fuel = it.first->Get(JUMP_FUEL);
 			if(!fuel)
 				fuel = defaultFuel;
 			if(!best || fuel < best)
@@ -2654,9 +2870,9 @@ double Ship::BestFuel(const string &type, const string &subtype, double defaultF
 
 
 
-void Ship::CreateExplosion(list<Effect> &effects, bool spread)
+void Ship::CreateExplosion(vector<Effect> &effects, bool spread)
 {
-	if(!HasSprite() || !GetMask().IsLoaded() || explosionEffects.empty())
+	if(!HasSprite() || !GetMask().IsLoaded() || chassis->explosionEffects.empty())
 		return;
 	
 	// Bail out if this loops enough times, just in case.
@@ -2668,8 +2884,8 @@ void Ship::CreateExplosion(list<Effect> &effects, bool spread)
 		{
 			// Pick an explosion.
 			int type = Random::Int(explosionTotal);
-			auto it = explosionEffects.begin();
-			for( ; it != explosionEffects.end(); ++it)
+			auto it = chassis->explosionEffects.begin();
+			for( ; it != chassis->explosionEffects.end(); ++it)
 			{
 				type -= it->second;
 				if(type < 0)
@@ -2692,7 +2908,7 @@ void Ship::CreateExplosion(list<Effect> &effects, bool spread)
 
 
 // Place a "spark" effect, like ionization or disruption.
-void Ship::CreateSparks(list<Effect> &effects, const string &name, double amount)
+void Ship::CreateSparks(vector<Effect> &effects, const string &name, double amount)
 {
 	if(forget)
 		return;
@@ -2716,3 +2932,37 @@ void Ship::CreateSparks(list<Effect> &effects, const string &name, double amount
 		}
 	}
 }
+
+
+
+// Recalculate the cached values that depend only on the outfits. This must be
+// done whenever the outfits change.
+void Ship::UpdateOutfitStats()
+{
+	// Don't bother searching through the outfits if there is no jump drive.
+	jumpDriveFuel = attributes.Get(JUMP_DRIVE) ? BestFuel("jump drive", "", 200.) : 0.;
+	
+	if(!attributes.Get(HYPERDRIVE))
+		hyperdriveFuel = jumpDriveFuel;
+	else if(attributes.Get(SCRAM_DRIVE))
+		hyperdriveFuel = BestFuel("hyperdrive", "scram drive", 150.);
+	else
+		hyperdriveFuel = BestFuel("hyperdrive", "", 100.);
+	
+	// This is an S-curve where the efficiency is 100% if you have no outfits
+	// that create "cooling inefficiency", and as that value increases the
+	// efficiency stays high for a while, then drops off, then approaches 0.
+	double x = attributes.Get(COOLING_INEFFICIENCY);
+	coolingEfficiency = 2. + 2. / (1. + exp(x / -2.)) - 4. / (1. + exp(x / -4.));
+}
+
+
+
+// Get a version of the chassis data that this ship can modify, copying it if
+// it is shared with any other ship.
+Ship::Chassis &Ship::EditChassis()
+{
+	if(chassis.use_count() > 1)
+		chassis = make_shared<Chassis>(*chassis);
+	return *chassis;
+}
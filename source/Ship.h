@@ -104,6 +104,9 @@ public:
 	// When loading a ship, some of the outfits it lists may not have been
 	// loaded yet. So, wait until everything has been loaded, then call this.
 	void FinishLoading();
+	// Get the ship model that this variant copies any undefined data from, or
+	// null if this ship is not a variant.
+	const Ship *Base() const;
 	// Save a full description of this ship, as currently configured.
 	void Save(DataWriter &out) const;
 	
@@ -152,8 +155,16 @@ public:
 	const Command &Commands() const;
 	// Move this ship. A ship may create effects as it moves, in particular if
 	// it is in the process of blowing up. If this returns false, the ship
-	// should be deleted.
-	bool Move(std::list<Effect> &effects, std::list<std::shared_ptr<Flotsam>> &flotsam);
+	// should be deleted. This only modifies this ship and the ships it is
+	// carrying, so many ships can be moved at once in different threads, as
+	// long as each one has its own effects and flotsam lists.
+	bool Move(std::vector<Effect> &effects, std::list<std::shared_ptr<Flotsam>> &flotsam);
+	// Before any ship moves, copy anything Move() needs from other ships,
+	// since those ships may change it while they are moving.
+	void PrepareToMove();
+	// Once all ships have moved, update anything that depends on the position
+	// of some other ship, such as boarding or escorts following a jump.
+	void MoveRelative();
 	// Launch any ships that are ready to launch.
 	void Launch(std::list<std::shared_ptr<Ship>> &ships);
 	// Check if this ship is boarding another ship. If it is, it either plunders
@@ -170,9 +181,11 @@ public:
 	// Fire any weapons that are ready to fire. If an anti-missile is ready,
 	// instead of firing here this function returns true and it can be fired if
 	// collision detection finds a missile in range.
-	bool Fire(std::list<Projectile> &projectiles, std::list<Effect> &effects);
+	bool Fire(std::vector<Projectile> &projectiles, std::vector<Effect> &effects);
+	// Get the range of the anti-missiles that Fire() found ready to fire.
+	double AntiMissileRange() const;
 	// Fire an anti-missile. Returns true if the missile was killed.
-	bool FireAntiMissile(const Projectile &projectile, std::list<Effect> &effects);
+	bool FireAntiMissile(const Projectile &projectile, std::vector<Effect> &effects);
 	
 	// Get the system this ship is in.
 	const System *GetSystem() const;
@@ -285,6 +298,10 @@ public:
 	void UnloadBays();
 	// Get a list of any ships this ship is carrying.
 	const std::vector<Bay> &Bays() const;
+	// Put the given ships back in this ship's bays, one for each bay, in the
+	// same order that Bays() lists them. Copying a bay does not copy the ship
+	// inside it, so this is needed to restore a ship from a copy of it.
+	void RestoreBays(const std::vector<std::shared_ptr<Ship>> &carried);
 	// Adjust the positions and velocities of any visible carried fighters or
 	// drones. If any are visible, return true.
 	bool PositionFighters() const;
@@ -301,7 +318,7 @@ public:
 	// Get the attributes of this ship chassis before any outfits were added.
 	const Outfit &BaseAttributes() const;
 	// Get the list of all outfits installed in this ship.
-	const std::map<const Outfit *, int> &Outfits() const;
+	const FlatMap<const Outfit *, int> &Outfits() const;
 	// Find out how many outfits of the given type this ship contains.
 	int OutfitCount(const Outfit *outfit) const;
 	// Add or remove outfits. (To remove, pass a negative number.)
@@ -348,6 +365,29 @@ private:
 	// Add or remove a ship from this ship's list of escorts.
 	void AddEscort(const Ship &ship);
 	void RemoveEscort(const Ship &ship);
+	// The stages of Move(), in the order it does them:
+	// Let ionization, disruption and slowing wear off, and release any cargo
+	// that was jettisoned.
+	void UpdateStatusEffects(std::vector<Effect> &effects, std::list<std::shared_ptr<Flotsam>> &flotsam);
+	// Update this ship's energy, heat, fuel, scanning and cloaking, and check
+	// whether it is disabled.
+	void UpdateSupplies();
+	// Create the explosions for a ship that is being destroyed. This returns
+	// false once the ship is done exploding and should be deleted.
+	bool UpdateExplosion(std::vector<Effect> &effects, std::list<std::shared_ptr<Flotsam>> &flotsam);
+	// Move a ship that is entering or leaving hyperspace.
+	void MoveInHyperspace(std::vector<Effect> &effects);
+	// Move a ship that is landing on or taking off from a planet. This returns
+	// false if the ship has landed and should be deleted.
+	bool MoveWhileLanding();
+	// Check whether a ship without enough crew makes a piloting error this step.
+	void UpdatePilot();
+	// Apply this ship's thrust, afterburner and turning commands, along with
+	// drag, to its velocity and facing.
+	void UpdateVelocity(std::vector<Effect> &effects, double slowMultiplier);
+	// Use this ship's energy to repair its hull and recharge its shields.
+	void RegenerateHullAndShields();
+	
 	// Get the hull amount at which this ship is disabled.
 	double MinimumHull() const;
 	// Add to this ship's hull or shields, and return the amount added. If the
@@ -358,9 +398,15 @@ private:
 	double BestFuel(const std::string &type, const std::string &subtype, double defaultFuel) const;
 	// Create one of this ship's explosions, within its mask. The explosions can
 	// either stay over the ship, or spread out if this is the final explosion.
-	void CreateExplosion(std::list<Effect> &effects, bool spread = false);
+	void CreateExplosion(std::vector<Effect> &effects, bool spread = false);
 	// Place a "spark" effect, like ionization or disruption.
-	void CreateSparks(std::list<Effect> &effects, const std::string &name, double amount);
+	void CreateSparks(std::vector<Effect> &effects, const std::string &name, double amount);
+	// Recalculate the cached values that depend only on the outfits.
+	void UpdateOutfitStats();
+	// Get a version of the chassis data that this ship can modify, copying it
+	// if it is shared with any other ship.
+	class Chassis;
+	Chassis &EditChassis();
 	
 	
 private:
@@ -373,17 +419,25 @@ private:
 	const Government *government;
 	*/
 	
-	// Characteristics of the chassis:
-	const Ship *base = nullptr;
-	std::string modelName;
-	std::string pluralModelName;
-	std::string noun;
-	std::string description;
-	// Characteristics of this particular ship:
-	std::string name;
+	// The state of the ship that changes from one step to the next. Every step
+	// looks at most of this for every ship in the game, so it is all kept
+	// together, right after the Body data, and the much larger description of
+	// the ship and its outfits comes after it.
+	// Current status of this particular ship:
+	const System *currentSystem = nullptr;
+	// A Ship can be locked into one of three special states: landing,
+	// hyperspacing, and exploding. Each one must track some special counters:
+	const Planet *landingPlanet = nullptr;
 	
-	// Licenses needed to operate this ship.
-	std::vector<std::string> licenses;
+	int hyperspaceCount = 0;
+	const System *hyperspaceSystem = nullptr;
+	bool isUsingJumpDrive = false;
+	double hyperspaceFuelCost = 0.;
+	Point hyperspaceOffset;
+	
+	unsigned explosionRate = 0;
+	unsigned explosionCount = 0;
+	unsigned explosionTotal = 0;
 	
 	int forget = 0;
 	bool isInSystem = true;
@@ -396,6 +450,11 @@ private:
 	bool isDisabled = false;
 	bool isBoarding = false;
 	bool hasBoarded = false;
+	// Flags telling MoveRelative() what still needs to be done this step.
+	bool isTrackingParent = false;
+	bool isTrackingTarget = false;
+	// The parent's target planet, as of the start of this step.
+	const StellarObject *parentTargetPlanet = nullptr;
 	bool isThrusting = false;
 	bool neverDisabled = false;
 	bool isCapturable = true;
@@ -404,31 +463,15 @@ private:
 	// Cached values for figuring out when anti-missile is in range.
 	double antiMissileRange = 0.;
 	double weaponRadius = 0.;
+	// Cached values that are derived from the installed outfits, so that they
+	// need not be recalculated every frame.
+	double hyperdriveFuel = 0.;
+	double jumpDriveFuel = 0.;
+	double coolingEfficiency = 1.;
 	// Cargo and outfit scanning takes time.
 	double cargoScan = 0.;
 	double outfitScan = 0.;
 	
-	Command commands;
-	
-	Personality personality;
-	const Phrase *hail = nullptr;
-	
-	// Installed outfits, cargo, etc.:
-	Outfit attributes;
-	Outfit baseAttributes;
-	const Outfit *explosionWeapon = nullptr;
-	std::map<const Outfit *, int> outfits;
-	CargoHold cargo;
-	std::list<std::shared_ptr<Flotsam>> jettisoned;
-	
-	std::vector<Bay> bays;
-	
-	std::vector<EnginePoint> enginePoints;
-	Armament armament;
-	// While loading, keep track of which outfits already have been equipped.
-	// (That is, they were specified as linked to a given gun or turret point.)
-	std::map<const Outfit *, int> equipped;
-	
 	// Various energy levels:
 	double shields = 0.;
 	double hull = 0.;
@@ -445,23 +488,10 @@ private:
 	int pilotError = 0;
 	int pilotOkay = 0;
 	
-	// Current status of this particular ship:
-	const System *currentSystem = nullptr;
-	// A Ship can be locked into one of three special states: landing,
-	// hyperspacing, and exploding. Each one must track some special counters:
-	const Planet *landingPlanet = nullptr;
-	
-	int hyperspaceCount = 0;
-	const System *hyperspaceSystem = nullptr;
-	bool isUsingJumpDrive = false;
-	double hyperspaceFuelCost = 0.;
-	Point hyperspaceOffset;
+	Command commands;
 	
-	std::map<const Effect *, int> explosionEffects;
-	unsigned explosionRate = 0;
-	unsigned explosionCount = 0;
-	unsigned explosionTotal = 0;
-	std::map<const Effect *, int> finalExplosions;
+	Personality personality;
+	const Phrase *hail = nullptr;
 	
 	// Target ships, planets, systems, etc.
 	std::weak_ptr<Ship> targetShip;
@@ -474,6 +504,42 @@ private:
 	// Links between escorts and parents.
 	std::vector<std::weak_ptr<const Ship>> escorts;
 	std::weak_ptr<Ship> parent;
+	
+	// Characteristics of the chassis. These do not change once the ship has
+	// been loaded, so copies of a ship (e.g. every ship that a fleet spawns
+	// from the same model) share them instead of each having their own.
+	class Chassis {
+	public:
+		std::string modelName;
+		std::string pluralModelName;
+		std::string noun;
+		std::string description;
+		// Licenses needed to operate this ship.
+		std::vector<std::string> licenses;
+		Outfit baseAttributes;
+		std::vector<EnginePoint> enginePoints;
+		// The effects to create while exploding.
+		std::map<const Effect *, int> explosionEffects;
+		std::map<const Effect *, int> finalExplosions;
+	};
+	std::shared_ptr<Chassis> chassis = std::make_shared<Chassis>();
+	const Ship *base = nullptr;
+	// Characteristics of this particular ship:
+	std::string name;
+	
+	// Installed outfits, cargo, etc.:
+	Outfit attributes;
+	const Outfit *explosionWeapon = nullptr;
+	FlatMap<const Outfit *, int> outfits;
+	CargoHold cargo;
+	std::list<std::shared_ptr<Flotsam>> jettisoned;
+	
+	std::vector<Bay> bays;
+	
+	Armament armament;
+	// While loading, keep track of which outfits already have been equipped.
+	// (That is, they were specified as linked to a given gun or turret point.)
+	FlatMap<const Outfit *, int> equipped;
 };
 
 
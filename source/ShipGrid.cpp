@@ -0,0 +1,145 @@
+/* ShipGrid.cpp
+Copyright (c) 2017 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "ShipGrid.h"
+
+#include "Ship.h"
+
+#include <algorithm>
+#include <numeric>
+
+using namespace std;
+
+
+
+// Initialize a grid. The cell size and cell count should both be powers of
+// two; otherwise, they are rounded down to a power of two.
+ShipGrid::ShipGrid(int cellSize, int cellCount)
+{
+	// Right shift amount to convert from (x, y) location to grid (x, y).
+	SHIFT = 0;
+	while(cellSize >>= 1)
+		++SHIFT;
+	CELL_SIZE = (1 << SHIFT);
+	
+	// Number of grid rows and columns.
+	CELLS = 1;
+	while(cellCount >>= 1)
+		CELLS <<= 1;
+	WRAP_MASK = CELLS - 1;
+	
+	// Just in case Clear() isn't called before ships are added:
+	Clear();
+}
+
+
+
+// Remove all ships from the grid.
+void ShipGrid::Clear()
+{
+	ships.clear();
+	added.clear();
+	sorted.clear();
+	counts.clear();
+	// The counts vector starts with two sentinel slots that will be used in the
+	// course of performing the radix sort.
+	counts.resize(CELLS * CELLS + 2, 0);
+}
+
+
+
+// Add a ship to the grid at the given position.
+void ShipGrid::Add(const shared_ptr<Ship> &ship, const Point &position)
+{
+	int x = static_cast<int>(position.X()) >> SHIFT;
+	int y = static_cast<int>(position.Y()) >> SHIFT;
+	added.emplace_back(ships.size(), position, x, y);
+	ships.push_back(ship);
+	++counts[(y & WRAP_MASK) * CELLS + (x & WRAP_MASK) + 2];
+}
+
+
+
+// Finish adding ships (and organize them into the final lookup table).
+void ShipGrid::Finish()
+{
+	// Perform a partial sum to convert the counts of items in each bin into the
+	// index of the output element where that bin begins.
+	partial_sum(counts.begin(), counts.end(), counts.begin());
+	
+	// Now, perform a radix sort. Within each bin, the entries stay in the
+	// order they were added.
+	sorted.resize(added.size());
+	for(const Entry &entry : added)
+	{
+		int index = (entry.y & WRAP_MASK) * CELLS + (entry.x & WRAP_MASK) + 1;
+		sorted[counts[index]++] = entry;
+	}
+}
+
+
+
+// Get the index of every ship that is within the given range of the given
+// point. The indices are in the order the ships were added.
+void ShipGrid::Circle(const Point &center, double radius, vector<size_t> &result) const
+{
+	result.clear();
+	
+	// If the circle covers the entire grid, there's no point in looking at
+	// individual cells. (This also handles an infinite radius.)
+	if(!(radius < .5 * CELL_SIZE * CELLS))
+	{
+		for(const Entry &entry : added)
+			if(entry.position.Distance(center) <= radius)
+				result.push_back(entry.index);
+		return;
+	}
+	
+	// Calculate the range of (x, y) grid coordinates this circle covers.
+	int minX = static_cast<int>(center.X() - radius) >> SHIFT;
+	int minY = static_cast<int>(center.Y() - radius) >> SHIFT;
+	int maxX = static_cast<int>(center.X() + radius) >> SHIFT;
+	int maxY = static_cast<int>(center.Y() + radius) >> SHIFT;
+	
+	for(int y = minY; y <= maxY; ++y)
+	{
+		int gy = y & WRAP_MASK;
+		for(int x = minX; x <= maxX; ++x)
+		{
+			int gx = x & WRAP_MASK;
+			int i = gy * CELLS + gx;
+			vector<Entry>::const_iterator it = sorted.begin() + counts[i];
+			vector<Entry>::const_iterator end = sorted.begin() + counts[i + 1];
+			
+			for( ; it != end; ++it)
+			{
+				// Skip ships that were put in this same grid cell only because
+				// of the cell coordinates wrapping around.
+				if(it->x != x || it->y != y)
+					continue;
+				
+				if(it->position.Distance(center) <= radius)
+					result.push_back(it->index);
+			}
+		}
+	}
+	// Each ship is only in one cell, so there are no duplicates to remove.
+	sort(result.begin(), result.end());
+}
+
+
+
+// Get the ship with the given index.
+const shared_ptr<Ship> &ShipGrid::At(size_t index) const
+{
+	return ships[index];
+}
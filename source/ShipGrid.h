@@ -0,0 +1,82 @@
+/* ShipGrid.h
+Copyright (c) 2017 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef SHIP_GRID_H_
+#define SHIP_GRID_H_
+
+#include "Point.h"
+
+#include <memory>
+#include <vector>
+
+class Ship;
+
+
+
+// A ShipGrid sorts ships into a coarse grid based on a single point for each
+// ship, so that the AI can find all the ships near a given point without
+// checking every ship in the system. Unlike a CollisionSet, the point need not
+// be where the ship is right now, and lookups do not modify the grid, so any
+// number of threads can search it at once.
+class ShipGrid {
+public:
+	// Initialize a grid. The cell size and cell count should both be powers of
+	// two; otherwise, they are rounded down to a power of two.
+	ShipGrid(int cellSize, int cellCount);
+	
+	// Remove all ships from the grid.
+	void Clear();
+	// Add a ship to the grid at the given position.
+	void Add(const std::shared_ptr<Ship> &ship, const Point &position);
+	// Finish adding ships (and organize them into the final lookup table).
+	void Finish();
+	
+	// Get the index of every ship that is within the given range of the given
+	// point. The indices are in the order the ships were added.
+	void Circle(const Point &center, double radius, std::vector<size_t> &result) const;
+	// Get the ship with the given index.
+	const std::shared_ptr<Ship> &At(size_t index) const;
+	
+	
+private:
+	class Entry {
+	public:
+		Entry() = default;
+		Entry(size_t index, const Point &position, int x, int y) : index(index), position(position), x(x), y(y) {}
+		
+		size_t index;
+		Point position;
+		int x;
+		int y;
+	};
+	
+	
+private:
+	// The size of individual cells of the grid.
+	int CELL_SIZE;
+	int SHIFT;
+	
+	// The number of grid cells.
+	int CELLS;
+	int WRAP_MASK;
+	
+	// The ships, in the order they were added.
+	std::vector<std::shared_ptr<Ship>> ships;
+	// Vectors to store the sorted grid.
+	std::vector<Entry> added;
+	std::vector<Entry> sorted;
+	std::vector<int> counts;
+};
+
+
+
+#endif
@@ -44,6 +44,21 @@ void ShipInfoDisplay::Update(const Ship &ship, const Depreciation &depreciation,
 	UpdateOutfits(ship, depreciation, day);
 	
 	maximumHeight = max(descriptionHeight, max(attributesHeight, outfitsHeight));
+	
+	shownShip = &ship;
+	shownDepreciation = &depreciation;
+	shownDay = day;
+	isCurrent = true;
+}
+
+
+
+// Update this display only if it is showing something else, or if it has
+// been invalidated since it was last updated.
+void ShipInfoDisplay::Show(const Ship &ship, const Depreciation &depreciation, int day)
+{
+	if(!isCurrent || &ship != shownShip || &depreciation != shownDepreciation || day != shownDay)
+		Update(ship, depreciation, day);
 }
 
 
@@ -68,8 +83,8 @@ void ShipInfoDisplay::DrawAttributes(const Point &topLeft) const
 	Point point = Draw(topLeft, attributeLabels, attributeValues);
 	
 	// Get standard colors to draw with.
-	Color labelColor = *GameData::Colors().Get("medium");
-	Color valueColor = *GameData::Colors().Get("bright");
+	static const Color &labelColor = *GameData::Colors().Get("medium");
+	static const Color &valueColor = *GameData::Colors().Get("bright");
 	
 	Table table;
 	table.AddColumn(10, Table::LEFT);
@@ -105,7 +120,7 @@ void ShipInfoDisplay::DrawSale(const Point &topLeft) const
 {
 	Draw(topLeft, saleLabels, saleValues);
 	
-	Color color = *GameData::Colors().Get("medium");
+	static const Color &color = *GameData::Colors().Get("medium");
 	FillShader::Fill(topLeft + Point(.5 * WIDTH, saleHeight + 8.), Point(WIDTH - 20., 1.), color);
 }
 
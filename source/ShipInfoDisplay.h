@@ -35,6 +35,9 @@ public:
 	
 	// Call this every time the ship changes.
 	void Update(const Ship &ship, const Depreciation &depreciation, int day);
+	// Update this display only if it is showing something else, or if it has
+	// been invalidated since it was last updated.
+	void Show(const Ship &ship, const Depreciation &depreciation, int day);
 	
 	// Provided by ItemInfoDisplay:
 	// int PanelWidth();
@@ -69,6 +72,11 @@ private:
 	std::vector<std::string> saleLabels;
 	std::vector<std::string> saleValues;
 	int saleHeight = 0;
+	
+	// What this display was last updated with.
+	const Ship *shownShip = nullptr;
+	const Depreciation *shownDepreciation = nullptr;
+	int shownDay = 0;
 };
 
 
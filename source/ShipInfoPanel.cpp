@@ -87,7 +87,7 @@ void ShipInfoPanel::Draw()
 		interfaceInfo.SetCondition("two buttons");
 	
 	// Draw the interface.
-	const Interface *interface = GameData::Interfaces().Get("info panel");
+	static const Interface *interface = GameData::Interfaces().Get("info panel");
 	interface->Draw(interfaceInfo, this);
 	
 	// Draw all the different information sections.
@@ -272,8 +272,8 @@ void ShipInfoPanel::DrawShipStats(const Rectangle &bounds)
 		return;
 	
 	// Colors to draw with.
-	Color dim = *GameData::Colors().Get("medium");
-	Color bright = *GameData::Colors().Get("bright");
+	static const Color &dim = *GameData::Colors().Get("medium");
+	static const Color &bright = *GameData::Colors().Get("bright");
 	const Ship &ship = **shipIt;
 	
 	// Table attributes.
@@ -302,8 +302,8 @@ void ShipInfoPanel::DrawOutfits(const Rectangle &bounds, Rectangle &cargoBounds)
 		return;
 	
 	// Colors to draw with.
-	Color dim = *GameData::Colors().Get("medium");
-	Color bright = *GameData::Colors().Get("bright");
+	static const Color &dim = *GameData::Colors().Get("medium");
+	static const Color &bright = *GameData::Colors().Get("bright");
 	const Ship &ship = **shipIt;
 	
 	// Table attributes.
@@ -371,8 +371,8 @@ void ShipInfoPanel::DrawOutfits(const Rectangle &bounds, Rectangle &cargoBounds)
 void ShipInfoPanel::DrawWeapons(const Rectangle &bounds)
 {
 	// Colors to draw with.
-	Color dim = *GameData::Colors().Get("medium");
-	Color bright = *GameData::Colors().Get("bright");
+	static const Color &dim = *GameData::Colors().Get("medium");
+	static const Color &bright = *GameData::Colors().Get("bright");
 	const Font &font = FontSet::Get(14);
 	const Ship &ship = **shipIt;
 	
@@ -483,9 +483,9 @@ void ShipInfoPanel::DrawWeapons(const Rectangle &bounds)
 
 void ShipInfoPanel::DrawCargo(const Rectangle &bounds)
 {
-	Color dim = *GameData::Colors().Get("medium");
-	Color bright = *GameData::Colors().Get("bright");
-	Color backColor = *GameData::Colors().Get("faint");
+	static const Color &dim = *GameData::Colors().Get("medium");
+	static const Color &bright = *GameData::Colors().Get("bright");
+	static const Color &backColor = *GameData::Colors().Get("faint");
 	const Ship &ship = **shipIt;
 
 	// Cargo list.
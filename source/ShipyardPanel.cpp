@@ -92,11 +92,11 @@ int ShipyardPanel::TileSize() const
 
 int ShipyardPanel::DrawPlayerShipInfo(const Point &point)
 {
-	shipInfo.Update(*playerShip, player.FleetDepreciation(), player.GetDate().DaysSinceEpoch());
-	shipInfo.DrawSale(point);
-	shipInfo.DrawAttributes(point + Point(0, shipInfo.SaleHeight()));
+	playerShipInfo.Show(*playerShip, player.FleetDepreciation(), player.GetDate().DaysSinceEpoch());
+	playerShipInfo.DrawSale(point);
+	playerShipInfo.DrawAttributes(point + Point(0, playerShipInfo.SaleHeight()));
 	
-	return shipInfo.SaleHeight() + shipInfo.AttributesHeight();
+	return playerShipInfo.SaleHeight() + playerShipInfo.AttributesHeight();
 }
 
 
@@ -137,7 +137,7 @@ int ShipyardPanel::DetailWidth() const
 
 int ShipyardPanel::DrawDetails(const Point &center)
 {
-	shipInfo.Update(*selectedShip, player.StockDepreciation(), player.GetDate().DaysSinceEpoch());
+	shipInfo.Show(*selectedShip, player.StockDepreciation(), player.GetDate().DaysSinceEpoch());
 	Point offset(shipInfo.PanelWidth(), 0.);
 	
 	shipInfo.DrawDescription(center - offset * 1.5);
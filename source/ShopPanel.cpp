@@ -80,6 +80,15 @@ void ShopPanel::Draw()
 {
 	glClear(GL_COLOR_BUFFER_BIT);
 	
+	// Anything that might change which items are shown might also change what
+	// the info displays say about them.
+	if(!shownItemsAreCurrent)
+	{
+		playerShipInfo.Invalidate();
+		shipInfo.Invalidate();
+		outfitInfo.Invalidate();
+	}
+	
 	// Clear the list of clickable zones.
 	zones.clear();
 	categoryZones.clear();
@@ -89,6 +98,7 @@ void ShopPanel::Draw()
 	DrawMain();
 	DrawKey();
 	
+	playerShipInfo.DrawTooltips();
 	shipInfo.DrawTooltips();
 	outfitInfo.DrawTooltips();
 	
@@ -107,8 +117,8 @@ void ShopPanel::Draw()
 void ShopPanel::DrawSidebar()
 {
 	const Font &font = FontSet::Get(14);
-	Color medium = *GameData::Colors().Get("medium");
-	Color bright = *GameData::Colors().Get("bright");
+	static const Color &medium = *GameData::Colors().Get("medium");
+	static const Color &bright = *GameData::Colors().Get("bright");
 	sideDetailHeight = 0;
 	
 	// Fill in the background.
@@ -211,8 +221,8 @@ void ShopPanel::DrawButtons()
 		Point(SIDE_WIDTH, 1), Color(.3, 1.));
 	
 	const Font &font = FontSet::Get(14);
-	Color bright = *GameData::Colors().Get("bright");
-	Color dim = *GameData::Colors().Get("medium");
+	static const Color &bright = *GameData::Colors().Get("bright");
+	static const Color &dim = *GameData::Colors().Get("medium");
 	
 	Point point(
 		Screen::Right() - SIDE_WIDTH + 10,
@@ -262,8 +272,8 @@ void ShopPanel::DrawButtons()
 void ShopPanel::DrawMain()
 {
 	const Font &bigFont = FontSet::Get(18);
-	Color dim = *GameData::Colors().Get("medium");
-	Color bright = *GameData::Colors().Get("bright");
+	static const Color &dim = *GameData::Colors().Get("medium");
+	static const Color &bright = *GameData::Colors().Get("bright");
 	mainDetailHeight = 0;
 	
 	const Sprite *collapsedArrow = SpriteSet::Get("ui/collapsed");
@@ -283,35 +293,34 @@ void ShopPanel::DrawMain()
 	float endX = Screen::Right() - (SIDE_WIDTH + 1);
 	double nextY = begin.Y() + TILE_SIZE;
 	int scrollY = 0;
+	// This should never happen, but bail out if we don't know what planet
+	// we are on (meaning there's no way to know what ships are for sale).
+	if(planet && !shownItemsAreCurrent)
+		UpdateShownItems();
 	for(const string &category : categories)
 	{
-		map<string, set<string>>::const_iterator it = catalog.find(category);
-		if(it == catalog.end())
-			continue;
-		
-		// This should never happen, but bail out if we don't know what planet
-		// we are on (meaning there's no way to know what ships are for sale).
 		if(!planet)
 			break;
 		
+		map<string, vector<ShownItem>>::const_iterator it = shownItems.find(category);
+		if(it == shownItems.end())
+			continue;
+		
 		Point side(Screen::Left() + 5., point.Y() - TILE_SIZE / 2 + 10);
 		point.Y() += bigFont.Height() + 20;
 		nextY += bigFont.Height() + 20;
 		
 		bool isCollapsed = collapsed.count(category);
-		bool isEmpty = true;
-		for(const string &name : it->second)
+		bool isEmpty = it->second.empty();
+		for(const ShownItem &item : it->second)
 		{
-			if(!HasItem(name))
-				continue;
-			isEmpty = false;
 			if(isCollapsed)
 				break;
 			
-			DrawItem(name, point, scrollY);
+			DrawItem(*item.name, point, scrollY);
 			
-			bool isSelected = (selectedShip && GameData::Ships().Get(name) == selectedShip)
-				|| (selectedOutfit && GameData::Outfits().Get(name) == selectedOutfit);
+			bool isSelected = (selectedShip && item.ship == selectedShip)
+				|| (selectedOutfit && item.outfit == selectedOutfit);
 			
 			if(isSelected)
 			{
@@ -437,6 +446,7 @@ void ShopPanel::DrawKey()
 bool ShopPanel::KeyDown(SDL_Keycode key, Uint16 mod, const Command &command)
 {
 	scrollDetailsIntoView = false;
+	shownItemsAreCurrent = false;
 	if((key == 'l' || key == 'd' || key == SDLK_ESCAPE
 			|| (key == 'w' && (mod & (KMOD_CTRL | KMOD_GUI)))) && FlightCheck())
 	{
@@ -512,6 +522,7 @@ bool ShopPanel::KeyDown(SDL_Keycode key, Uint16 mod, const Command &command)
 bool ShopPanel::Click(int x, int y, int clicks)
 {
 	dragShip = nullptr;
+	shownItemsAreCurrent = false;
 	// Handle clicks on the buttons.
 	if(x >= Screen::Right() - SIDE_WIDTH && y >= Screen::Bottom() - BUTTON_HEIGHT)
 	{
@@ -624,11 +635,13 @@ bool ShopPanel::Hover(int x, int y)
 	// Check that the point is not in the button area.
 	if(x >= Screen::Right() - SIDE_WIDTH && y >= Screen::Bottom() - BUTTON_HEIGHT)
 	{
+		playerShipInfo.ClearHover();
 		shipInfo.ClearHover();
 		outfitInfo.ClearHover();
 	}
 	else
 	{
+		playerShipInfo.Hover(point);
 		shipInfo.Hover(point);
 		outfitInfo.Hover(point);
 	}
@@ -724,6 +737,33 @@ double ShopPanel::Zone::ScrollY() const
 
 
 
+ShopPanel::ShownItem::ShownItem(const string &name)
+	: name(&name), ship(GameData::Ships().Find(name)), outfit(GameData::Outfits().Find(name))
+{
+}
+
+
+
+// Find out which items in the catalog should be shown, i.e. the ones that are
+// for sale here or that the player owns.
+void ShopPanel::UpdateShownItems()
+{
+	shownItems.clear();
+	for(const auto &it : catalog)
+	{
+		vector<ShownItem> &items = shownItems[it.first];
+		for(const string &name : it.second)
+			if(HasItem(name))
+				items.emplace_back(name);
+	}
+	// Any panel that is shown on top of this one (e.g. a dialog asking for the
+	// name of a new ship) may change what the player owns when it closes, so
+	// keep checking until this panel is on top again.
+	shownItemsAreCurrent = GetUI()->IsTop(this);
+}
+
+
+
 bool ShopPanel::DoScroll(double dy)
 {
 	double &scroll = dragMain ? mainScroll : sideScroll;
@@ -91,6 +91,15 @@ protected:
 		const Outfit *outfit = nullptr;
 	};
 	
+	class ShownItem {
+	public:
+		ShownItem(const std::string &name);
+		
+		const std::string *name;
+		const Ship *ship;
+		const Outfit *outfit;
+	};
+	
 	
 protected:
 	static const int SIDE_WIDTH = 250;
@@ -126,14 +135,23 @@ protected:
 	std::vector<ClickZone<std::string>> categoryZones;
 	
 	std::map<std::string, std::set<std::string>> catalog;
+	// The items in each category that HasItem() accepts. This only changes
+	// when the player buys or sells something or picks different ships, so it
+	// is cached instead of checking every item in the catalog every frame.
+	std::map<std::string, std::vector<ShownItem>> shownItems;
+	bool shownItemsAreCurrent = false;
 	const std::vector<std::string> &categories;
 	std::set<std::string> &collapsed;
 	
+	// The info displays are only rebuilt when they show a different item, or
+	// when shownItemsAreCurrent says the player's ships may have changed.
+	ShipInfoDisplay playerShipInfo;
 	ShipInfoDisplay shipInfo;
 	OutfitInfoDisplay outfitInfo;
 	
 	
 private:
+	void UpdateShownItems();
 	bool DoScroll(double dy);
 	void SideSelect(int count);
 	void SideSelect(Ship *ship);
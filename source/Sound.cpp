@@ -27,6 +27,10 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 using namespace std;
 
 namespace {
+	// Compressed data needs this many zero bytes after it for the mp3 decoder to
+	// be able to decode the last frame (MAD_BUFFER_GUARD).
+	const size_t GUARD_BYTES = 8;
+	
 	// Read a WAV header, and return the size of the data, in bytes. If the file
 	// is an unsupported format (anything but little-endian 16-bit PCM at 44100 HZ),
 	// this will return 0.
@@ -37,13 +41,55 @@ namespace {
 
 
 
-bool Sound::Load(const string &path)
+Sound::Sound()
+	: isLoaded(false), buffer(0), memory(0)
+{
+}
+
+
+
+// Set the file to load this sound from, without reading it yet.
+void Sound::SetPath(const string &path)
 {
+	this->path = path;
+	isLooped = (path.length() >= 5 && path[path.length() - 5] == '~');
+	isStreamed = (path.length() >= 4 && !path.compare(path.length() - 4, 4, ".mp3"));
+}
+
+
+
+const string &Sound::Path() const
+{
+	return path;
+}
+
+
+
+bool Sound::Load()
+{
+	if(isStreamed)
+	{
+		File in(path);
+		if(!in)
+			return false;
+		fseek(in, 0, SEEK_END);
+		long size = ftell(in);
+		if(size <= 0)
+			return false;
+		fseek(in, 0, SEEK_SET);
+		
+		shared_ptr<vector<unsigned char>> compressed(new vector<unsigned char>(size + GUARD_BYTES, 0));
+		if(fread(&compressed->front(), 1, size, in) != static_cast<size_t>(size))
+			return false;
+		
+		data = compressed;
+		memory = compressed->size();
+		isLoaded = true;
+		return true;
+	}
 	if(path.length() < 5 || path.compare(path.length() - 4, 4, ".wav"))
 		return false;
 	
-	isLooped = path[path.length() - 5] == '~';
-	
 	File in(path);
 	if(!in)
 		return false;
@@ -56,15 +102,41 @@ bool Sound::Load(const string &path)
 	if(fread(&data[0], 1, bytes, in) != bytes)
 		return false;
 	
-	if(!buffer)
-		alGenBuffers(1, &buffer);
-	alBufferData(buffer, AL_FORMAT_MONO16, &data.front(), bytes, frequency);
+	// Only make the buffer visible to other threads once its data is in it.
+	unsigned id = buffer;
+	if(!id)
+		alGenBuffers(1, &id);
+	alBufferData(id, AL_FORMAT_MONO16, &data.front(), bytes, frequency);
+	memory = bytes;
+	buffer = id;
+	isLoaded = true;
 	
 	return true;
 }
 
 
 
+// Free this sound's buffer. It must not be attached to any source. Streams
+// that are playing keep their own reference to the compressed data.
+void Sound::Unload()
+{
+	isLoaded = false;
+	data.reset();
+	unsigned id = buffer.exchange(0);
+	if(id)
+		alDeleteBuffers(1, &id);
+	memory = 0;
+}
+
+
+
+bool Sound::IsLoaded() const
+{
+	return isLoaded;
+}
+
+
+
 unsigned Sound::Buffer() const
 {
 	return buffer;
@@ -79,6 +151,30 @@ bool Sound::IsLooping() const
 
 
 
+// Check if this sound is streamed from compressed data, instead of being in a
+// buffer. The data ends with MAD_BUFFER_GUARD zero bytes.
+bool Sound::IsStreamed() const
+{
+	return isStreamed;
+}
+
+
+
+shared_ptr<const vector<unsigned char>> Sound::Data() const
+{
+	return data;
+}
+
+
+
+// Get the size of this sound's data, in bytes, or 0 if it is not loaded.
+size_t Sound::Memory() const
+{
+	return memory;
+}
+
+
+
 namespace {
 	// Read a WAV header, and return the size of the data, in bytes. If the file
 	// is an unsupported format (anything but little-endian 16-bit PCM at 44100 HZ),
@@ -13,23 +13,49 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #ifndef SOUND_H_
 #define SOUND_H_
 
+#include <atomic>
+#include <cstddef>
+#include <memory>
 #include <string>
+#include <vector>
 
 
 
 // This is a sound that can be played. The sound's file name will determine
-// whether it is looping (ends in '~') or not.
+// whether it is looping (ends in '~') or not. The file is not read until the
+// sound is loaded, and it may be unloaded again to free up memory; until then,
+// its buffer is zero. Loading may be done in any thread. A sound can also be an
+// mp3 file, in which case it is kept compressed in memory and decoded a little
+// at a time as it plays, which takes much less memory for long sounds.
 class Sound {
 public:
-	bool Load(const std::string &path);
+	Sound();
 	
+	// Set the file to load this sound from, without reading it yet.
+	void SetPath(const std::string &path);
+	const std::string &Path() const;
+	bool Load();
+	void Unload();
+	
+	bool IsLoaded() const;
 	unsigned Buffer() const;
 	bool IsLooping() const;
+	// Check if this sound is streamed from compressed data, instead of being
+	// in a buffer. The data ends with MAD_BUFFER_GUARD zero bytes.
+	bool IsStreamed() const;
+	std::shared_ptr<const std::vector<unsigned char>> Data() const;
+	// Get the size of this sound's data, in bytes, or 0 if it is not loaded.
+	size_t Memory() const;
 	
 	
 private:
-	unsigned buffer = 0;
+	std::string path;
+	std::atomic<bool> isLoaded;
+	std::atomic<unsigned> buffer;
+	std::shared_ptr<const std::vector<unsigned char>> data;
+	std::atomic<size_t> memory;
 	bool isLooped = false;
+	bool isStreamed = false;
 };
 
 
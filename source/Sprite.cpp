@@ -14,6 +14,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 #include "ImageBuffer.h"
 #include "Preferences.h"
+#include "RenderThread.h"
 #include "Screen.h"
 
 #include "gl_header.h"
@@ -23,10 +24,27 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 using namespace std;
 
+namespace {
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+	const GLenum GL_COMPRESSED_RGBA_S3TC_DXT5_EXT = 0x83F3;
+#endif
+	
+	// Check if the driver can use DXT5 textures. Every Mac that can run this
+	// game supports them, but the header there does not say so.
+	bool CanUseCompressed()
+	{
+#ifdef __APPLE__
+		return true;
+#else
+		return GLEW_EXT_texture_compression_s3tc;
+#endif
+	}
+}
+
 
 
 Sprite::Sprite(const string &name)
-	: name(name), width(0.f), height(0.f)
+	: name(name), width(0.f), height(0.f), isUsed(false), isUsed2x(false)
 {
 }
 
@@ -39,46 +57,141 @@ const string &Sprite::Name() const
 
 
 
-void Sprite::AddFrame(int frame, ImageBuffer *image, Mask *mask, bool is2x)
+// Upload all the frames of one resolution of this sprite. Any image may be
+// null if that frame failed to load. The images and masks are deleted once
+// they have been added.
+void Sprite::AddFrames(const vector<ImageBuffer *> &images, const vector<Mask *> &newMasks, bool is2x)
 {
-	if(!image || frame < 0)
-		return;
-	
-	// If this is an @2x buffer, cut its dimensions in half. Then, if the
-	// dimensions are larger than the current sprite dimensions, store them.
-	width = max<float>(width, image->Width() >> is2x);
-	height = max<float>(height, image->Height() >> is2x);
-	
-	vector<uint32_t> &textureIndex = (is2x ? textures2x : textures);
-	if(textureIndex.size() <= static_cast<unsigned>(frame))
-		textureIndex.resize(frame + 1, 0);
-	if(!textureIndex[frame])
-		glGenTextures(1, &textureIndex[frame]);
-	glBindTexture(GL_TEXTURE_2D, textureIndex[frame]);
-	
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	// Compressed and uncompressed frames cannot share one array texture, and
+	// not every driver supports compressed textures. In either case, fall
+	// back to uncompressed frames.
+	bool isCompressed = CanUseCompressed();
+	for(ImageBuffer *image : images)
+		if(image && !image->IsCompressed())
+			isCompressed = false;
+	if(!isCompressed)
+		for(ImageBuffer *image : images)
+			if(image)
+				image->Decompress();
 	
-	if(Preferences::Has("Reduce large graphics") && image->Width() * image->Height() >= 1000000)
-		image->ShrinkToHalfSize();
-	
-	// ImageBuffer always loads images into 32-bit BGRA buffers.
-	// That is supposedly the fastest format to upload.
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image->Width(), image->Height(), 0,
-		GL_BGRA, GL_UNSIGNED_BYTE, image->Pixels());
-	
-	glBindTexture(GL_TEXTURE_2D, 0);
-	delete image;
+	// All the layers of an array texture must be the same size.
+	int layerWidth = 0;
+	int layerHeight = 0;
+	bool isUniform = true;
+	for(ImageBuffer *image : images)
+	{
+		if(!image)
+		{
+			isUniform = false;
+			continue;
+		}
+		// If this is an @2x buffer, cut its dimensions in half. Then, if the
+		// dimensions are larger than the current sprite dimensions, store them.
+		width = max<float>(width, image->Width() >> is2x);
+		height = max<float>(height, image->Height() >> is2x);
+		
+		// Compressed images already use a quarter of the memory. They must be
+		// compressed from full-size images to match the cached copies.
+		if(!isCompressed && Preferences::Has("Reduce large graphics") && image->Width() * image->Height() >= 1000000)
+			image->ShrinkToHalfSize();
+		
+		if(layerWidth && (image->Width() != layerWidth || image->Height() != layerHeight))
+			isUniform = false;
+		layerWidth = max(layerWidth, image->Width());
+		layerHeight = max(layerHeight, image->Height());
+	}
 	
-	if(mask)
+	if(layerWidth && layerHeight)
 	{
-		if(masks.size() <= static_cast<unsigned>(frame))
-			masks.resize(frame + 1);
-		masks[frame] = move(*mask);
-		delete mask;
+		// Uploading needs the OpenGL context, which the render thread may have.
+		RenderThread::Acquire();
+		uint32_t &texture = textures[is2x];
+		if(!texture)
+			glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		
+		// Uncompressed textures get a full chain of mipmaps, so that sprites
+		// drawn smaller than their actual size (e.g. when zoomed out) use
+		// trilinear filtering and read much less texture memory. Mipmaps
+		// cannot reliably be generated for compressed textures.
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, isCompressed ? GL_LINEAR : GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, isCompressed ? 0 : 1000);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		
+		if(isCompressed)
+		{
+			// A DXT5 block of all zeros is transparent black, so that works as
+			// a blank layer too. Each block of 16 pixels takes 16 bytes.
+			size_t size = static_cast<size_t>(layerWidth) * layerHeight * images.size();
+			vector<char> blank;
+			if(!isUniform)
+				blank.resize(size, 0);
+			glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,
+				layerWidth, layerHeight, images.size(), 0, size, blank.empty() ? nullptr : blank.data());
+			for(size_t i = 0; i < images.size(); ++i)
+				if(images[i])
+					glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i,
+						images[i]->Width(), images[i]->Height(), 1, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,
+						images[i]->Blocks().size(), images[i]->Blocks().data());
+			memory[is2x] = size;
+		}
+		else
+		{
+			// If any layer will not be completely filled in, start with all the
+			// layers transparent rather than undefined.
+			vector<uint32_t> blank;
+			if(!isUniform)
+				blank.resize(static_cast<size_t>(layerWidth) * layerHeight * images.size(), 0);
+			// ImageBuffer always loads images into 32-bit BGRA buffers.
+			// That is supposedly the fastest format to upload.
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, layerWidth, layerHeight, images.size(), 0,
+				GL_BGRA, GL_UNSIGNED_BYTE, blank.empty() ? nullptr : blank.data());
+			for(size_t i = 0; i < images.size(); ++i)
+				if(images[i])
+					glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, images[i]->Width(), images[i]->Height(), 1,
+						GL_BGRA, GL_UNSIGNED_BYTE, images[i]->Pixels());
+			glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+			// The mipmaps take up another third as much memory.
+			memory[is2x] = 4 * static_cast<size_t>(layerWidth) * layerHeight * images.size() * 4 / 3;
+		}
+		
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		layers[is2x] = images.size();
 	}
+	for(ImageBuffer *image : images)
+		delete image;
+	
+	for(size_t i = 0; i < newMasks.size(); ++i)
+		if(newMasks[i])
+		{
+			if(masks.size() <= i)
+				masks.resize(i + 1);
+			masks[i] = move(*newMasks[i]);
+			delete newMasks[i];
+		}
+}
+
+
+
+// Give one resolution of this sprite its size, number of frames and masks, but
+// no textures. The game can then use it as if it were loaded, except that it
+// draws nothing until its frames are added.
+void Sprite::AddPlaceholder(int frames, int frameWidth, int frameHeight, const vector<Mask *> &newMasks, bool is2x)
+{
+	width = max<float>(width, frameWidth >> is2x);
+	height = max<float>(height, frameHeight >> is2x);
+	layers[is2x] = frames;
+	
+	for(size_t i = 0; i < newMasks.size(); ++i)
+		if(newMasks[i])
+		{
+			if(masks.size() <= i)
+				masks.resize(i + 1);
+			masks[i] = move(*newMasks[i]);
+			delete newMasks[i];
+		}
 }
 
 
@@ -86,16 +199,9 @@ void Sprite::AddFrame(int frame, ImageBuffer *image, Mask *mask, bool is2x)
 // Free up all textures loaded for this sprite.
 void Sprite::Unload()
 {
-	if(!textures.empty())
-	{
-		glDeleteTextures(textures.size(), &textures.front());
-		textures.clear();
-	}
-	if(!textures2x.empty())
-	{
-		glDeleteTextures(textures2x.size(), &textures2x.front());
-		textures2x.clear();
-	}
+	UnloadTextures();
+	layers[0] = 0;
+	layers[1] = 0;
 	
 	masks.clear();
 	width = 0.f;
@@ -104,6 +210,21 @@ void Sprite::Unload()
 
 
 
+// Free up the textures, but leave the size, frames and masks as they are.
+void Sprite::UnloadTextures()
+{
+	for(int i = 0; i < 2; ++i)
+		if(textures[i])
+		{
+			RenderThread::Acquire();
+			glDeleteTextures(1, &textures[i]);
+			textures[i] = 0;
+			memory[i] = 0;
+		}
+}
+
+
+
 float Sprite::Width() const
 {
 	return width;
@@ -120,7 +241,7 @@ float Sprite::Height() const
 
 int Sprite::Frames() const
 {
-	return textures.size();
+	return layers[0];
 }
 
 
@@ -132,22 +253,34 @@ Point Sprite::Center() const
 
 
 
-uint32_t Sprite::Texture(int frame) const
+uint32_t Sprite::Texture() const
 {
-	return Texture(frame, Screen::IsHighResolution());
+	return Texture(Screen::IsHighResolution());
 }
 
 
 
-uint32_t Sprite::Texture(int frame, bool isHighDPI) const
+uint32_t Sprite::Texture(bool isHighDPI) const
 {
-	if(isHighDPI && !textures2x.empty())
-		return textures2x[frame % textures2x.size()];
-	
-	if(textures.empty())
-		return 0;
-	
-	return textures[frame % textures.size()];
+	isUsed.store(true, memory_order_relaxed);
+	if(isHighDPI)
+		isUsed2x.store(true, memory_order_relaxed);
+	return (isHighDPI && textures[1]) ? textures[1] : textures[0];
+}
+
+
+
+int Sprite::Layer(int frame) const
+{
+	return Layer(frame, Screen::IsHighResolution());
+}
+
+
+
+int Sprite::Layer(int frame, bool isHighDPI) const
+{
+	int count = layers[isHighDPI && textures[1]];
+	return count ? frame % count : 0;
 }
 
 
@@ -155,8 +288,45 @@ uint32_t Sprite::Texture(int frame, bool isHighDPI) const
 const Mask &Sprite::GetMask(int frame) const
 {
 	static const Mask empty;
-	if(masks.empty() || masks.size() != textures.size())
+	if(masks.empty() || masks.size() != static_cast<size_t>(layers[0]))
 		return empty;
 	
 	return masks[frame % masks.size()];
 }
+
+
+
+// Get how much video memory this sprite's textures take up.
+size_t Sprite::Memory() const
+{
+	return memory[0] + memory[1];
+}
+
+
+
+// Get how much memory this sprite's collision masks take up.
+size_t Sprite::MaskMemory() const
+{
+	size_t total = masks.capacity() * sizeof(Mask);
+	for(const Mask &mask : masks)
+		total += mask.Memory();
+	return total;
+}
+
+
+
+// Check whether this sprite's texture has been asked for since the last time
+// this function was called.
+bool Sprite::CheckUsed() const
+{
+	return isUsed.exchange(false, memory_order_relaxed);
+}
+
+
+
+// Check whether this sprite's @2x texture has been asked for since the last
+// time this function was called, even if it is not loaded.
+bool Sprite::CheckUsed2x() const
+{
+	return isUsed2x.exchange(false, memory_order_relaxed);
+}
@@ -16,6 +16,8 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Mask.h"
 #include "Point.h"
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -26,19 +28,29 @@ class ImageBuffer;
 
 // Class representing a drawable sprite. A sprite can have multiple frames, for
 // animation. Certain sprites will also include a "mask" that can be used to
-// check whether something has collided with them. Each frame is stored in a
-// separate OpenGL texture object. This may not be as efficient as sprite
-// sheets, but with modern graphics cards it will not matter much and it makes
-// working with the graphics a lot simpler.
+// check whether something has collided with them. All the frames of a sprite
+// are stored in a single OpenGL array texture, with one layer per frame, so
+// that switching between frames does not require binding a different texture.
+// The @2x frames, if any, are stored in a second array texture.
 class Sprite {
 public:
 	explicit Sprite(const std::string &name = "");
 	
 	const std::string &Name() const;
 	
-	void AddFrame(int frame, ImageBuffer *image, Mask *mask, bool is2x);
+	// Upload all the frames of one resolution of this sprite. Any image may be
+	// null if that frame failed to load. The images and masks are deleted once
+	// they have been added. If the frames are not all the same size, smaller
+	// ones are placed in the top left corner of their layer.
+	void AddFrames(const std::vector<ImageBuffer *> &images, const std::vector<Mask *> &newMasks, bool is2x);
+	// Give one resolution of this sprite its size, number of frames and masks,
+	// but no textures. The game can then use it as if it were loaded, except
+	// that it draws nothing until its frames are added.
+	void AddPlaceholder(int frames, int frameWidth, int frameHeight, const std::vector<Mask *> &newMasks, bool is2x);
 	// Free up all textures loaded for this sprite.
 	void Unload();
+	// Free up the textures, but leave the size, frames and masks as they are.
+	void UnloadTextures();
 	
 	float Width() const;
 	float Height() const;
@@ -48,20 +60,42 @@ public:
 	// shifting of corner to center coordinates.
 	Point Center() const;
 	
-	uint32_t Texture(int frame = 0) const;
-	uint32_t Texture(int frame, bool isHighDPI) const;
+	// Get the array texture holding this sprite's frames, and the layer in that
+	// texture that holds the given frame.
+	uint32_t Texture() const;
+	uint32_t Texture(bool isHighDPI) const;
+	int Layer(int frame = 0) const;
+	int Layer(int frame, bool isHighDPI) const;
 	const Mask &GetMask(int frame = 0) const;
 	
+	// Get how much video memory this sprite's textures take up.
+	size_t Memory() const;
+	// Get how much memory this sprite's collision masks take up.
+	size_t MaskMemory() const;
+	// Check whether this sprite's texture has been asked for since the last time
+	// this function was called.
+	bool CheckUsed() const;
+	// Check whether this sprite's @2x texture has been asked for since the last
+	// time this function was called, even if it is not loaded.
+	bool CheckUsed2x() const;
+	
 	
 private:
 	std::string name;
 	
-	std::vector<uint32_t> textures;
-	std::vector<uint32_t> textures2x;
+	// The array textures for the ordinary and the @2x frames, and how many
+	// layers each of them has.
+	uint32_t textures[2] = {0, 0};
+	int layers[2] = {0, 0};
+	size_t memory[2] = {0, 0};
 	std::vector<Mask> masks;
 	
 	float width;
 	float height;
+	
+	// Drawing happens in more than one thread, so this must be atomic.
+	mutable std::atomic<bool> isUsed;
+	mutable std::atomic<bool> isUsed2x;
 };
 
 
@@ -14,11 +14,13 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 #include "ImageBuffer.h"
 #include "Mask.h"
+#include "Preferences.h"
 #include "Sprite.h"
 #include "SpriteSet.h"
+#include "ThreadPool.h"
 
 #include <algorithm>
-#include <functional>
+#include <vector>
 
 using namespace std;
 
@@ -29,55 +31,89 @@ namespace {
 		size_t len = path.length();
 		return (len > 7 && path[len - 7] == '@' && path[len - 6] == '2' && path[len - 5] == 'x');
 	}
+	
+	// Get how much memory the pixels or compressed blocks of an image take up.
+	size_t Bytes(const ImageBuffer &image)
+	{
+		return image.IsCompressed() ? image.Blocks().size() : 4 * image.Width() * image.Height();
+	}
+	
+	// Once this much memory is taken up by images that are waiting to be
+	// uploaded, stop reading more of them until the uploads catch up.
+	const size_t MAX_PENDING_BYTES = 256 << 20;
+	// Uploading textures stalls the main thread, so when sprites are loaded in
+	// the middle of the game, only upload this much in each frame. Larger
+	// sprites, like landscapes, are still uploaded one at a time. While the
+	// game is starting up, nothing is moving, so more can be uploaded at once.
+	const size_t MAX_UPLOAD_BYTES = 16 << 20;
+	const size_t MAX_STARTUP_UPLOAD_BYTES = 128 << 20;
+	
+	// Load the cached mask for the given image, if it has not changed since
+	// the mask was saved. Otherwise, return null.
+	Mask *LoadMask(const string &path)
+	{
+		Mask *mask = new Mask;
+		if(mask->LoadCache(path))
+			return mask;
+		
+		delete mask;
+		return nullptr;
+	}
 }
 
 
 
 SpriteQueue::SpriteQueue()
-	: added(0), completed(0)
+	: added(0), reading(0), pauses(0), completed(0), pendingBytes(0), ready(0), isTiming(false), isStarting(true)
 {
-	threads.resize(max(4u, thread::hardware_concurrency()));
-	for(thread &t : threads)
-		t = thread(ref(*this));
 }
 
 
 
 SpriteQueue::~SpriteQueue()
 {
-	{
-		lock_guard<mutex> lock(readMutex);
-		added = -1;
-	}
-	readCondition.notify_all();
-	for(thread &t : threads)
-		t.join();
+	// Tell any reading tasks that are still queued up to do nothing, then wait
+	// for the ones that are already reading to finish.
+	unique_lock<mutex> lock(readMutex);
+	added = -1;
+	while(reading)
+		readCondition.wait(lock);
 }
 
 
 
 // Add a sprite to load.
-void SpriteQueue::Add(const string &name, const string &path)
+void SpriteQueue::Add(const string &name, const string &path, bool sizeOnly)
 {
 	Sprite *sprite = SpriteSet::Modify(name);
 	{
-		lock_guard<mutex> lock(readMutex);
-		// Do nothing if we are destroying the queue already.
-		if(added < 0)
-			return;
-		
-		bool is2x = Is2x(path);
-		int &frame = (is2x ? count2x[name] : count[name]);
-		toRead.emplace(sprite, name, path, frame++, is2x);
-		++added;
+		// The frame must be counted as unread before any reading task can
+		// see it in the queue.
+		lock_guard<mutex> lock(loadMutex);
+		++unread[sprite];
+		if(!isTiming)
+		{
+			isTiming = true;
+			loadTimer = FrameTimer();
+		}
 	}
-	readCondition.notify_one();
+	lock_guard<mutex> lock(readMutex);
+	// Do nothing if we are destroying the queue already.
+	if(added < 0)
+		return;
+	
+	bool is2x = Is2x(path);
+	int &frame = (is2x ? count2x[name] : count[name]);
+	toRead.emplace(sprite, name, path, frame++, is2x, Preferences::Has("Compress sprite textures"), sizeOnly);
+	++added;
+	StartReading();
 }
 
 
 
-// Unload the texture for the given sprite (to free up memory).
-void SpriteQueue::Unload(const string &name)
+// Unload the texture for the given sprite (to free up memory). If asked to
+// unload only the textures, the sprite keeps its size, frames and masks.
+void SpriteQueue::Unload(const string &name, bool texturesOnly)
 {
 	{
 		lock_guard<mutex> lock(readMutex);
@@ -86,7 +122,7 @@ void SpriteQueue::Unload(const string &name)
 	}
 	
 	unique_lock<mutex> lock(loadMutex);
-	toUnload.push(name);
+	toUnload.emplace(name, texturesOnly);
 }
 
 
@@ -95,7 +131,7 @@ void SpriteQueue::Unload(const string &name)
 double SpriteQueue::Progress() const
 {
 	unique_lock<mutex> lock(loadMutex);
-	return DoLoad(lock);
+	return DoLoad(lock, isStarting ? MAX_STARTUP_UPLOAD_BYTES : MAX_UPLOAD_BYTES);
 }
 
 
@@ -109,108 +145,300 @@ void SpriteQueue::Finish() const
 		unique_lock<mutex> lock(loadMutex);
 		
 		// Load whatever is already queued up for loading.
-		if(DoLoad(lock) == 1.)
+		if(DoLoad(lock, 0) == 1.)
 			break;
 		
 		// We still have sprites to upload, but none of them have been read from
-		// disk yet. Wait until one arrives.
-		loadCondition.wait(lock);
+		// disk yet. Wait until one arrives. (If some are ready, they were left
+		// for the next call because DoLoad() only uploads so many at once.)
+		if(!ready)
+		{
+			FrameTimer timer;
+			loadCondition.wait(lock);
+			timing.wait += timer.Time();
+		}
 	}
 }
 
 
 
-// Thread entry point.
-void SpriteQueue::operator()()
+// Get the time spent in each phase of loading so far.
+SpriteQueue::Timing SpriteQueue::GetTiming() const
 {
-	while(true)
+	unique_lock<mutex> lock(loadMutex);
+	Timing result = timing;
+	if(isTiming)
+		result.elapsed += loadTimer.Time();
+	
+	unique_lock<mutex> readLock(readMutex);
+	result.pauses = pauses;
+	return result;
+}
+
+
+
+// Read images from the queue until it is empty. This is run by the thread pool,
+// in as many tasks as the preferences allow.
+void SpriteQueue::Read() const
+{
+	unique_lock<mutex> lock(readMutex);
+	// To signal that we are quitting, "added" is set to -1.
+	while(added >= 0 && !toRead.empty())
 	{
-		unique_lock<mutex> lock(readMutex);
-		while(true)
+		// If too many images are waiting to be uploaded, stop reading until
+		// the main thread uploads them. But, only do so if there is a sprite
+		// that it can upload. Otherwise, the frames it is waiting for may be
+		// the very ones this task would have read next.
+		if(pendingBytes >= MAX_PENDING_BYTES && ready)
 		{
-			// To signal this thread that it is time for it to quit, we set
-			// "added" to -1.
-			if(added < 0)
-				return;
-			if(toRead.empty())
-				break;
-			
-			Item item = toRead.front();
-			toRead.pop();
-			
-			lock.unlock();
-			
-			// Load the sprite.
+			++pauses;
+			break;
+		}
+		Item item = toRead.front();
+		toRead.pop();
+		
+		lock.unlock();
+		
+		// Don't ever create masks for @2x sprites; just use the ordinary
+		// sprite masks instead.
+		bool needsMask = (!item.is2x && (!item.name.compare(0, 5, "ship/") || !item.name.compare(0, 9, "asteroid/")));
+		
+		FrameTimer timer;
+		// If only the size of this image is needed, it does not need to be
+		// decoded unless its mask must be traced again.
+		bool hasSize = false;
+		if(item.sizeOnly)
+		{
+			if(needsMask)
+				item.mask = LoadMask(item.path);
+			if(!needsMask || item.mask)
+				hasSize = ImageBuffer::ReadSize(item.path, item.width, item.height);
+		}
+		// If a compressed copy of this image was cached, the image does not
+		// need to be decoded at all, unless its mask must be traced again.
+		else if(item.compress)
+		{
+			item.image = ImageBuffer::ReadCompressed(item.path);
+			if(item.image && needsMask)
+			{
+				item.mask = LoadMask(item.path);
+				if(!item.mask)
+				{
+					delete item.image;
+					item.image = nullptr;
+				}
+			}
+		}
+		// Load the sprite. If sprite loading fails, just skip this sprite.
+		if(!item.image && !hasSize)
 			item.image = ImageBuffer::Read(item.path);
-			// If sprite loading fails, just skip this sprite.
-			if(!item.image)
+		double readTime = timer.Time();
+		double maskTime = 0.;
+		double compressTime = 0.;
+		if(item.image)
+		{
+			if(needsMask && !item.mask)
 			{
-				lock.lock();
-				continue;
+				timer = FrameTimer();
+				// Tracing the outline is slow, so reuse the one from the last
+				// time this image was loaded unless the file has changed.
+				item.mask = LoadMask(item.path);
+				if(!item.mask)
+				{
+					item.mask = new Mask;
+					item.mask->Create(item.image);
+					item.mask->SaveCache(item.path);
+				}
+				maskTime = timer.Time();
 			}
-			// Don't ever create masks for @2x sprites; just use the ordinary
-			// sprite masks instead.
-			if(!item.is2x && (!item.name.compare(0, 5, "ship/") || !item.name.compare(0, 9, "asteroid/")))
+			if(item.compress && !item.image->IsCompressed())
 			{
-				item.mask = new Mask;
-				item.mask->Create(item.image);
+				timer = FrameTimer();
+				if(item.image->Compress())
+					item.image->SaveCompressed(item.path);
+				compressTime = timer.Time();
 			}
-			
+			// If the image was only decoded to trace its mask, it is not needed
+			// any more.
+			if(item.sizeOnly)
+			{
+				hasSize = true;
+				item.width = item.image->Width();
+				item.height = item.image->Height();
+				delete item.image;
+				item.image = nullptr;
+			}
+		}
+		if(item.image || hasSize)
+		{
 			// Don't bother to copy the path, now that we've loaded the file.
 			item.name.clear();
 			item.path.clear();
+		}
+		{
+			// The texture must be uploaded to OpenGL in the main thread.
+			unique_lock<mutex> lock(loadMutex);
+			timing.read += readTime;
+			timing.mask += maskTime;
+			timing.compress += compressTime;
+			// An image that could not be read still counts as completed, so
+			// that Finish() does not wait for it forever.
+			if(item.image || hasSize)
 			{
-				// The texture must be uploaded to OpenGL in the main thread.
-				unique_lock<mutex> lock(loadMutex);
-				toLoad.push(item);
+				if(item.image)
+					pendingBytes += Bytes(*item.image);
+				waiting[item.sprite].push_back(item);
 			}
-			loadCondition.notify_one();
+			else
+				++completed;
 			
-			lock.lock();
+			auto it = unread.find(item.sprite);
+			if(!--it->second)
+			{
+				unread.erase(it);
+				if(waiting.count(item.sprite))
+					++ready;
+			}
 		}
+		loadCondition.notify_one();
 		
-		readCondition.wait(lock);
+		lock.lock();
+	}
+	if(!--reading)
+		readCondition.notify_all();
+}
+
+
+
+// Start more reading tasks, if there are images waiting to be read and fewer
+// tasks than allowed. The caller must hold the read mutex.
+void SpriteQueue::StartReading() const
+{
+	// By default, allow as many reading tasks as there are threads in the
+	// pool. Each one reads images until the queue is empty, so there is no
+	// sense in starting more tasks than there are images left to read.
+	int limit = Preferences::ImageThreads();
+	if(limit <= 0)
+		limit = ThreadPool::Shared().Size();
+	while(added >= 0 && reading < limit && static_cast<size_t>(reading) < toRead.size())
+	{
+		++reading;
+		ThreadPool::Shared().Submit([this]() { Read(); });
 	}
 }
 
 
-double SpriteQueue::DoLoad(unique_lock<mutex> &lock) const
+
+// Upload any sprites that have been read, up to the given number of bytes
+// (or all of them, if that is zero), and return the fraction of the sprites
+// that have been loaded.
+double SpriteQueue::DoLoad(unique_lock<mutex> &lock, size_t maxBytes) const
 {
 	while(!toUnload.empty())
 	{
-		Sprite *sprite = SpriteSet::Modify(toUnload.front());
+		Sprite *sprite = SpriteSet::Modify(toUnload.front().first);
+		bool texturesOnly = toUnload.front().second;
 		toUnload.pop();
 		
 		lock.unlock();
-		sprite->Unload();
+		if(texturesOnly)
+			sprite->UnloadTextures();
+		else
+			sprite->Unload();
 		lock.lock();
 	}
 	
-	for(int i = 0; !toLoad.empty() && i < 100; ++i)
+	// All the frames of a sprite go into a single array texture, so a sprite
+	// can only be uploaded once none of its frames are still being read.
+	size_t uploaded = 0;
+	for(auto it = waiting.begin(); it != waiting.end() && (!maxBytes || uploaded < maxBytes); )
 	{
-		Item item = toLoad.front();
-		toLoad.pop();
+		if(unread.count(it->first))
+		{
+			++it;
+			continue;
+		}
+		vector<Item> items;
+		items.swap(it->second);
+		it = waiting.erase(it);
+		--ready;
 		
 		lock.unlock();
 		
-		item.sprite->AddFrame(item.frame, item.image, item.mask, item.is2x);
+		FrameTimer timer;
+		size_t bytes = 0;
+		vector<ImageBuffer *> images[2];
+		vector<Mask *> masks;
+		// For frames that were only sized, keep track of how many frames there
+		// are and the largest frame size.
+		int placeholders[2] = {0, 0};
+		int widths[2] = {0, 0};
+		int heights[2] = {0, 0};
+		for(const Item &item : items)
+		{
+			if(item.image)
+			{
+				bytes += Bytes(*item.image);
+				vector<ImageBuffer *> &frames = images[item.is2x];
+				if(frames.size() <= static_cast<size_t>(item.frame))
+					frames.resize(item.frame + 1, nullptr);
+				frames[item.frame] = item.image;
+			}
+			else
+			{
+				placeholders[item.is2x] = max(placeholders[item.is2x], item.frame + 1);
+				widths[item.is2x] = max(widths[item.is2x], item.width);
+				heights[item.is2x] = max(heights[item.is2x], item.height);
+			}
+			if(item.mask)
+			{
+				if(masks.size() <= static_cast<size_t>(item.frame))
+					masks.resize(item.frame + 1, nullptr);
+				masks[item.frame] = item.mask;
+			}
+		}
+		Sprite *sprite = items.front().sprite;
+		if(!images[0].empty())
+			sprite->AddFrames(images[0], masks, false);
+		else if(placeholders[0])
+			sprite->AddPlaceholder(placeholders[0], widths[0], heights[0], masks, false);
+		if(!images[1].empty())
+			sprite->AddFrames(images[1], vector<Mask *>(), true);
+		else if(placeholders[1])
+			sprite->AddPlaceholder(placeholders[1], widths[1], heights[1], vector<Mask *>(), true);
+		double uploadTime = timer.Time();
 		
 		lock.lock();
-		++completed;
+		pendingBytes -= bytes;
+		timing.upload += uploadTime;
+		timing.images += items.size();
+		completed += items.size();
+		uploaded += bytes;
 	}
 	
 	// Wait until we have completed loading of as many sprites as we have added.
 	// The value of "added" is protected by readMutex.
 	unique_lock<mutex> readLock(readMutex);
+	// If reading was paused, there may now be room to read more images.
+	StartReading();
 	// Special cases: we're bailing out, or we are done.
 	if(added <= 0 || added == completed)
+	{
+		if(isTiming)
+		{
+			timing.elapsed += loadTimer.Time();
+			isTiming = false;
+		}
+		isStarting = false;
 		return 1.;
+	}
 	return static_cast<double>(completed) / static_cast<double>(added);
 }
 
 
 
-SpriteQueue::Item::Item(Sprite *sprite, const string &name, const string &path, int frame, bool is2x)
-	: sprite(sprite), name(name), path(path), image(nullptr), mask(nullptr), frame(frame), is2x(is2x)
+SpriteQueue::Item::Item(Sprite *sprite, const string &name, const string &path, int frame, bool is2x, bool compress, bool sizeOnly)
+	: sprite(sprite), name(name), path(path), image(nullptr), mask(nullptr), frame(frame), is2x(is2x),
+	compress(compress), sizeOnly(sizeOnly), width(0), height(0)
 {
 }
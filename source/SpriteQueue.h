@@ -13,12 +13,15 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #ifndef SPRITE_QUEUE_H_
 #define SPRITE_QUEUE_H_
 
+#include "FrameTimer.h"
+
+#include <atomic>
 #include <condition_variable>
+#include <cstddef>
 #include <map>
 #include <mutex>
 #include <queue>
 #include <string>
-#include <thread>
 #include <vector>
 
 class ImageBuffer;
@@ -27,34 +30,67 @@ class Sprite;
 
 
 
-// Class for queuing up a list of sprites to be loaded from the disk, with a set of
-// worker threads that begins loading them as soon as they are added.
+// Class for queuing up a list of sprites to be loaded from the disk. The images
+// are read by a limited number of tasks in the shared thread pool, which begin
+// loading them as soon as they are added. Reading pauses whenever too many of
+// the images that have been read are still waiting to be uploaded to OpenGL.
 class SpriteQueue {
+public:
+	// The total time, in seconds, spent in each phase of loading the sprites.
+	// The reading times are added up over all the threads that read images,
+	// so they may be much larger than the time that actually elapsed.
+	class Timing {
+	public:
+		double read = 0.;
+		double mask = 0.;
+		double compress = 0.;
+		double upload = 0.;
+		// Time the main thread spent waiting for images to be read.
+		double wait = 0.;
+		// Time from when loading started until every image was uploaded.
+		double elapsed = 0.;
+		int images = 0;
+		// How many times reading paused to let the uploads catch up.
+		int pauses = 0;
+	};
+	
+	
 public:
 	SpriteQueue();
 	~SpriteQueue();
 	
-	// Add a sprite to load.
-	void Add(const std::string &name, const std::string &path);
-	// Unload the texture for the given sprite (to free up memory).
-	void Unload(const std::string &name);
+	// Add a sprite to load. If only the size is wanted, the image is not
+	// decoded (unless its mask must be traced); the sprite gets its size, frame
+	// count and mask, but no textures until it is added again without this.
+	void Add(const std::string &name, const std::string &path, bool sizeOnly = false);
+	// Unload the texture for the given sprite (to free up memory). If asked to
+	// unload only the textures, the sprite keeps its size, frames and masks.
+	void Unload(const std::string &name, bool texturesOnly = false);
 	// Find out our percent completion.
 	double Progress() const;
 	// Finish loading.
 	void Finish() const;
-	
-	// Thread entry point.
-	void operator()();
+	// Get the time spent in each phase of loading so far.
+	Timing GetTiming() const;
 	
 	
 private:
-	double DoLoad(std::unique_lock<std::mutex> &lock) const;
+	// Read images from the queue until it is empty. This is run by the thread
+	// pool, in as many tasks as the preferences allow.
+	void Read() const;
+	// Start more reading tasks, if there are images waiting to be read and
+	// fewer tasks than allowed. The caller must hold the read mutex.
+	void StartReading() const;
+	// Upload any sprites that have been read, up to the given number of bytes
+	// (or all of them, if that is zero), and return the fraction of the sprites
+	// that have been loaded.
+	double DoLoad(std::unique_lock<std::mutex> &lock, std::size_t maxBytes) const;
 	
 	
 private:
 	class Item {
 	public:
-		Item(Sprite *sprite, const std::string &name, const std::string &path, int frame, bool is2x);
+		Item(Sprite *sprite, const std::string &name, const std::string &path, int frame, bool is2x, bool compress, bool sizeOnly);
 		
 		Sprite *sprite;
 		std::string name;
@@ -63,27 +99,53 @@ private:
 		Mask *mask;
 		int frame;
 		bool is2x;
+		bool compress;
+		// If only the size is wanted, it is stored here instead of in an image.
+		bool sizeOnly;
+		int width;
+		int height;
 	};
 	
 	
 private:
-	std::queue<Item> toRead;
-	// We must read the value of "added" in const functions, so this mutex must
-	// be mutable.
+	// Reading tasks may be started by the const DoLoad(), so the queue of images
+	// to read must be mutable. We must also read the value of "added" in const
+	// functions, so this mutex must be mutable.
+	mutable std::queue<Item> toRead;
 	mutable std::mutex readMutex;
-	std::condition_variable readCondition;
+	mutable std::condition_variable readCondition;
 	int added;
+	// The number of reading tasks that have not finished yet, and how many
+	// times they have paused to let the uploads catch up.
+	mutable int reading;
+	mutable int pauses;
 	std::map<std::string, int> count;
 	std::map<std::string, int> count2x;
 	
-	mutable std::queue<Item> toLoad;
+	// Frames that have been read, waiting to be uploaded once the rest of the
+	// frames of the same sprite are read, and how many frames of each sprite
+	// are still being read.
+	mutable std::map<Sprite *, std::vector<Item>> waiting;
+	mutable std::map<const Sprite *, int> unread;
 	mutable std::mutex loadMutex;
 	mutable std::condition_variable loadCondition;
 	mutable int completed;
+	// The reading tasks check these without locking the load mutex, to find
+	// out whether they should pause: the memory taken up by images that have
+	// been read but not uploaded, and how many sprites are ready to upload.
+	mutable std::atomic<std::size_t> pendingBytes;
+	mutable std::atomic<int> ready;
 	
-	mutable std::queue<std::string> toUnload;
+	// The timing is guarded by the load mutex.
+	mutable Timing timing;
+	mutable bool isTiming;
+	mutable FrameTimer loadTimer;
+	// Whether the sprites that were added at startup are still being loaded.
+	// This is guarded by the load mutex.
+	mutable bool isStarting;
 	
-	std::vector<std::thread> threads;
+	// The names of sprites to unload, and whether to unload only the textures.
+	mutable std::queue<std::pair<std::string, bool>> toUnload;
 };
 
 #endif
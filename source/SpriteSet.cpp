@@ -15,6 +15,8 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Sprite.h"
 
 #include <map>
+#include <tuple>
+#include <utility>
 
 using namespace std;
 
@@ -31,10 +33,32 @@ const Sprite *SpriteSet::Get(const string &name)
 
 
 
+// Get how much video memory all the sprites' textures take up, and how much
+// memory their collision masks take up.
+size_t SpriteSet::TextureMemory()
+{
+	size_t total = 0;
+	for(const auto &it : sprites)
+		total += it.second.Memory();
+	return total;
+}
+
+
+
+size_t SpriteSet::MaskMemory()
+{
+	size_t total = 0;
+	for(const auto &it : sprites)
+		total += it.second.MaskMemory();
+	return total;
+}
+
+
+
 Sprite *SpriteSet::Modify(const string &name)
 {
 	auto it = sprites.find(name);
 	if(it == sprites.end())
-		it = sprites.insert(make_pair(name, Sprite(name))).first;
+		it = sprites.emplace(piecewise_construct, forward_as_tuple(name), forward_as_tuple(name)).first;
 	return &it->second;
 }
@@ -13,6 +13,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #ifndef SPRITE_SET_H_
 #define SPRITE_SET_H_
 
+#include <cstddef>
 #include <string>
 
 class Sprite;
@@ -26,6 +27,11 @@ class SpriteSet {
 public:
 	static const Sprite *Get(const std::string &name);
 	
+	// Get how much video memory all the sprites' textures take up, and how much
+	// memory their collision masks take up.
+	static size_t TextureMemory();
+	static size_t MaskMemory();
+	
 	
 private:
 	// Only SpriteQueue is allowed to modify the sprites.
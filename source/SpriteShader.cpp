@@ -17,19 +17,32 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Shader.h"
 #include "Sprite.h"
 
+#include <algorithm>
+#include <cstddef>
+
 using namespace std;
 
 namespace {
 	Shader shader;
 	GLint scaleI;
-	GLint transformI;
+	GLint showBlurI;
+	GLint backI;
+	
+	// Per-instance attributes.
 	GLint positionI;
+	GLint transformI;
 	GLint blurI;
 	GLint clipI;
-	GLint fadeI;
+	GLint motionI;
+	GLint flagsI;
+	GLint layersI;
 	
 	GLuint vao;
 	GLuint vbo;
+	GLuint instanceVbo;
+	// Instanced arrays are only core in OpenGL 3.3 and up. Otherwise, each
+	// item's attributes are set as constants and it is drawn on its own.
+	bool useInstancing = false;
 
 	static const GLint SWIZZLE[9][4] = {
 		{GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA}, // red + yellow markings (republic)
@@ -42,6 +55,27 @@ namespace {
 		{GL_BLUE, GL_ZERO, GL_ZERO, GL_ALPHA},  // red only (cloaked)
 		{GL_ZERO, GL_ZERO, GL_ZERO, GL_ALPHA}  // black only (outline)
 	};
+	
+	// Point the per-instance attributes at the given item in the instance buffer.
+	void PointAttributes(size_t first)
+	{
+		static const GLsizei STRIDE = sizeof(SpriteShader::Item);
+		size_t base = first * STRIDE;
+		glVertexAttribPointer(positionI, 2, GL_FLOAT, GL_FALSE, STRIDE,
+			(const GLvoid*)(base + offsetof(SpriteShader::Item, position)));
+		glVertexAttribPointer(transformI, 4, GL_FLOAT, GL_FALSE, STRIDE,
+			(const GLvoid*)(base + offsetof(SpriteShader::Item, transform)));
+		glVertexAttribPointer(blurI, 2, GL_FLOAT, GL_FALSE, STRIDE,
+			(const GLvoid*)(base + offsetof(SpriteShader::Item, blur)));
+		glVertexAttribPointer(clipI, 1, GL_FLOAT, GL_FALSE, STRIDE,
+			(const GLvoid*)(base + offsetof(SpriteShader::Item, clip)));
+		glVertexAttribPointer(motionI, 2, GL_FLOAT, GL_FALSE, STRIDE,
+			(const GLvoid*)(base + offsetof(SpriteShader::Item, motion)));
+		glVertexAttribIPointer(flagsI, 1, GL_UNSIGNED_INT, STRIDE,
+			(const GLvoid*)(base + offsetof(SpriteShader::Item, flags)));
+		glVertexAttribPointer(layersI, 2, GL_FLOAT, GL_FALSE, STRIDE,
+			(const GLvoid*)(base + offsetof(SpriteShader::Item, layers)));
+	}
 }
 
 
@@ -50,71 +84,123 @@ namespace {
 void SpriteShader::Init()
 {
 	static const char *vertexCode =
-		"uniform mat2 transform;\n"
-		"uniform vec2 position;\n"
 		"uniform vec2 scale;\n"
-		"uniform vec2 blur;\n"
-		"uniform float clip;\n"
+		"uniform float showBlur;\n"
+		"uniform float back;\n"
+		"uniform mat4 swizzleMatrix[9];\n"
 		
 		"in vec2 vert;\n"
+		"in vec2 position;\n"
+		"in vec4 transform;\n"
+		"in vec2 blur;\n"
+		"in float clip;\n"
+		"in vec2 motion;\n"
+		"in uint flags;\n"
+		"in vec2 layers;\n"
 		"out vec2 fragTexCoord;\n"
+		"flat out vec2 fragLayers;\n"
+		"flat out vec2 fragBlur;\n"
+		"flat out float fragFade;\n"
+		"flat out mat4 fragSwizzle;\n"
 		
 		"void main() {\n"
-		"  vec2 blurOff = 2 * vec2(vert.x * abs(blur.x), vert.y * abs(blur.y));\n"
-		"  gl_Position = vec4((transform * (vert + blurOff) + position) * scale, 0, 1);\n"
+		"  fragBlur = showBlur * blur;\n"
+		"  vec2 blurOff = 2 * vec2(vert.x * abs(fragBlur.x), vert.y * abs(fragBlur.y));\n"
+		"  vec2 center = position - back * motion;\n"
+		"  gl_Position = vec4((mat2(transform) * (vert + blurOff) + center) * scale, 0, 1);\n"
 		"  vec2 texCoord = vert + vec2(.5, .5);\n"
-		"  fragTexCoord = vec2(texCoord.x, max(clip, texCoord.y)) + blurOff;\n"
+		"  fragTexCoord = vec2(texCoord.x, max(1. - clip, texCoord.y)) + blurOff;\n"
+		"  fragFade = float(flags >> 8u) / 256.;\n"
+		"  fragSwizzle = swizzleMatrix[int(flags & 255u)];\n"
+		"  fragLayers = layers;\n"
 		"}\n";
 
 	static const char *fragmentCode =
-		"uniform sampler2D tex0;\n"
-		"uniform sampler2D tex1;\n"
-		"uniform float fade;\n"
-		"uniform vec2 blur;\n"
+		"uniform sampler2DArray tex0;\n"
+		"uniform sampler2DArray tex1;\n"
 		"const int range = 5;\n"
 		
 		"in vec2 fragTexCoord;\n"
+		"flat in vec2 fragBlur;\n"
+		"flat in float fragFade;\n"
+		"flat in mat4 fragSwizzle;\n"
+		"flat in vec2 fragLayers;\n"
 		"out vec4 finalColor;\n"
 		
 		"void main() {\n"
-		"  if(blur.x == 0 && blur.y == 0)\n"
+		"  vec4 color;\n"
+		"  if(fragBlur.x == 0 && fragBlur.y == 0)\n"
 		"  {\n"
-		"    if(fade != 0)\n"
-		"     finalColor = mix(texture(tex0, fragTexCoord), texture(tex1, fragTexCoord), fade);\n"
+		"    if(fragFade != 0)\n"
+		"      color = mix(texture(tex0, vec3(fragTexCoord, fragLayers.x)),\n"
+		"        texture(tex1, vec3(fragTexCoord, fragLayers.y)), fragFade);\n"
 		"    else\n"
-		"      finalColor = texture(tex0, fragTexCoord);\n"
-		"    return;\n"
+		"      color = texture(tex0, vec3(fragTexCoord, fragLayers.x));\n"
 		"  }\n"
-		"  const float divisor = range * (range + 2) + 1;\n"
-		"  vec4 color = vec4(0., 0., 0., 0.);\n"
-		"  for(int i = -range; i <= range; ++i)\n"
+		"  else\n"
 		"  {\n"
-		"    float scale = (range + 1 - abs(i)) / divisor;\n"
-		"    vec2 coord = fragTexCoord + (blur * i) / range;\n"
-		"    if(fade != 0)\n"
-		"      color += scale * mix(texture(tex0, coord), texture(tex1, coord), fade);\n"
-		"    else\n"
-		"      color += scale * texture(tex0, coord);\n"
+		"    const float divisor = range * (range + 2) + 1;\n"
+		"    color = vec4(0., 0., 0., 0.);\n"
+		"    for(int i = -range; i <= range; ++i)\n"
+		"    {\n"
+		"      float scale = (range + 1 - abs(i)) / divisor;\n"
+		"      vec2 coord = fragTexCoord + (fragBlur * i) / range;\n"
+		"      if(fragFade != 0)\n"
+		"        color += scale * mix(texture(tex0, vec3(coord, fragLayers.x)),\n"
+		"          texture(tex1, vec3(coord, fragLayers.y)), fragFade);\n"
+		"      else\n"
+		"        color += scale * texture(tex0, vec3(coord, fragLayers.x));\n"
+		"    }\n"
 		"  }\n"
-		"  finalColor = color;\n"
+		"  finalColor = fragSwizzle * color;\n"
 		"}\n";
 	
 	shader = Shader(vertexCode, fragmentCode);
 	scaleI = shader.Uniform("scale");
-	transformI = shader.Uniform("transform");
-	positionI = shader.Uniform("position");
-	blurI = shader.Uniform("blur");
-	clipI = shader.Uniform("clip");
-	fadeI = shader.Uniform("fade");
+	showBlurI = shader.Uniform("showBlur");
+	backI = shader.Uniform("back");
+	positionI = shader.Attrib("position");
+	transformI = shader.Attrib("transform");
+	blurI = shader.Attrib("blur");
+	clipI = shader.Attrib("clip");
+	motionI = shader.Attrib("motion");
+	flagsI = shader.Attrib("flags");
+	layersI = shader.Attrib("layers");
 	
-	glUseProgram(shader.Object());
+	// The color swizzles are done by the shader rather than by setting each
+	// texture's swizzle, so that sprites with different swizzles can be drawn
+	// in a single call. Convert each swizzle into a (column-major) matrix.
+	GLfloat swizzleMatrix[9][16] = {};
+	for(int i = 0; i < 9; ++i)
+		for(int row = 0; row < 4; ++row)
+		{
+			int column = -1;
+			if(SWIZZLE[i][row] == GL_RED)
+				column = 0;
+			else if(SWIZZLE[i][row] == GL_GREEN)
+				column = 1;
+			else if(SWIZZLE[i][row] == GL_BLUE)
+				column = 2;
+			else if(SWIZZLE[i][row] == GL_ALPHA)
+				column = 3;
+			if(column >= 0)
+				swizzleMatrix[i][4 * column + row] = 1.f;
+		}
+	
+	shader.Use();
 	glUniform1i(shader.Uniform("tex0"), 0);
 	glUniform1i(shader.Uniform("tex1"), 1);
-	glUseProgram(0);
+	glUniformMatrix4fv(shader.Uniform("swizzleMatrix"), 9, false, &swizzleMatrix[0][0]);
+	
+	GLint major = 0;
+	GLint minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	useInstancing = (major > 3 || (major == 3 && minor >= 3));
 	
 	// Generate the vertex data for drawing sprites.
 	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	Shader::BindVertexArray(vao);
 	
 	glGenBuffers(1, &vbo);
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
@@ -130,9 +216,23 @@ void SpriteShader::Init()
 	glEnableVertexAttribArray(shader.Attrib("vert"));
 	glVertexAttribPointer(shader.Attrib("vert"), 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), nullptr);
 	
+	// The per-instance data goes in a separate buffer, which is refilled every
+	// time a list of items is drawn. Each attribute advances once per instance.
+	glGenBuffers(1, &instanceVbo);
+	if(useInstancing)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+		PointAttributes(0);
+		for(GLint attrib : {positionI, transformI, blurI, clipI, motionI, flagsI, layersI})
+		{
+			glEnableVertexAttribArray(attrib);
+			glVertexAttribDivisor(attrib, 1);
+		}
+	}
+	
 	// unbind the VBO and VAO
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	Shader::BindVertexArray(0);
 }
 
 
@@ -142,61 +242,90 @@ void SpriteShader::Draw(const Sprite *sprite, const Point &position, float zoom,
 	if(!sprite)
 		return;
 	
-	float pos[2] = {
-		static_cast<float>(position.X()), static_cast<float>(position.Y())};
-	float trans[4] = {sprite->Width() * zoom, 0.f, 0.f, sprite->Height() * zoom};
+	// A sprite drawn at half size or smaller, like a ship thumbnail in a shop,
+	// has enough pixels in its ordinary texture even on a high DPI screen, so
+	// there is no need to sample (or stream in) its @2x texture.
+	bool isHighDPI = Screen::IsHighResolution() && zoom > .5f;
+	
+	vector<Item> items(1);
+	Item &item = items.front();
+	item.tex0 = sprite->Texture(isHighDPI);
+	item.tex1 = item.tex0;
+	item.position[0] = static_cast<float>(position.X());
+	item.position[1] = static_cast<float>(position.Y());
+	item.transform[0] = sprite->Width() * zoom;
+	item.transform[3] = sprite->Height() * zoom;
+	item.flags = swizzle;
 	
-	Bind();
-	Add(sprite->Texture(), 0, pos, trans, swizzle, 1.f, 0.f);
-	Unbind();
+	Draw(items);
 }
 
 
 
-void SpriteShader::Bind()
+// Draw the given items, in order. Each run of items that use the same
+// textures is drawn with a single call, if instanced drawing is available.
+// If the interpolation is less than 1, each item is drawn that fraction of
+// the way from where it was in the previous step to where it is now.
+void SpriteShader::Draw(const vector<Item> &items, bool showBlur, double interpolation)
 {
-	glUseProgram(shader.Object());
-	glBindVertexArray(vao);
+	if(items.empty())
+		return;
+	
+	shader.Use();
+	Shader::BindVertexArray(vao);
 	glActiveTexture(GL_TEXTURE0);
 	
 	GLfloat scale[2] = {2.f / Screen::Width(), -2.f / Screen::Height()};
 	glUniform2fv(scaleI, 1, scale);
-}
-
-
-
-void SpriteShader::Add(uint32_t tex0, uint32_t tex1, const float position[2], const float transform[4], int swizzle, float clip, float fade, const float blur[2])
-{
-	glUniformMatrix2fv(transformI, 1, false, transform);
-	glUniform2fv(positionI, 1, position);
-	glBindTexture(GL_TEXTURE_2D, tex0);
+	glUniform1f(showBlurI, showBlur ? 1.f : 0.f);
+	// Each item's position in the previous step was its current position minus
+	// its motion, so moving it back along that is exact for anything that is
+	// not turning or accelerating.
+	glUniform1f(backI, static_cast<float>(1. - min(interpolation, 1.)));
 	
-	if(fade && tex1)
+	if(useInstancing)
 	{
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, tex1);
-		glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, SWIZZLE[swizzle]);
-		glActiveTexture(GL_TEXTURE0);
+		glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(Item) * items.size(), items.data(), GL_STREAM_DRAW);
 	}
-	else
-		fade = 0.f;
-	
-	// Set the color swizzle.
-	glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, SWIZZLE[swizzle]);
 	
-	// Set the clipping.
-	glUniform1f(clipI, 1.f - clip);
-	glUniform1f(fadeI, fade);
-	const float noBlur[2] = {0.f, 0.f};
-	glUniform2fv(blurI, 1, blur ? blur : noBlur);
+	for(size_t start = 0; start < items.size(); )
+	{
+		// Find how many items in a row use these same textures.
+		const Item &first = items[start];
+		size_t end = start + 1;
+		while(end < items.size() && items[end].tex0 == first.tex0 && items[end].tex1 == first.tex1)
+			++end;
+		
+		if(first.tex1)
+		{
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, first.tex1);
+			glActiveTexture(GL_TEXTURE0);
+		}
+		glBindTexture(GL_TEXTURE_2D_ARRAY, first.tex0);
+		
+		if(useInstancing)
+		{
+			PointAttributes(start);
+			glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, end - start);
+		}
+		else
+			for(size_t i = start; i < end; ++i)
+			{
+				const Item &item = items[i];
+				glVertexAttrib2fv(positionI, item.position);
+				glVertexAttrib4fv(transformI, item.transform);
+				glVertexAttrib2fv(blurI, item.blur);
+				glVertexAttrib1f(clipI, item.clip);
+				glVertexAttrib2fv(motionI, item.motion);
+				glVertexAttribI1ui(flagsI, item.flags);
+				glVertexAttrib2fv(layersI, item.layers);
+				glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+			}
+		start = end;
+	}
 	
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-}
-
-
-
-void SpriteShader::Unbind()
-{
-	glBindVertexArray(0);
-	glUseProgram(0);
+	if(useInstancing)
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
@@ -17,6 +17,7 @@ class Sprite;
 class Point;
 
 #include <cstdint>
+#include <vector>
 
 
 
@@ -26,16 +27,40 @@ class Point;
 // most often just for use by the DrawList class, which calculates those input
 // parameters based on an object's rotation, animation frame, etc.
 class SpriteShader {
+public:
+	// Everything needed to draw one sprite. A list of these is uploaded to the
+	// GPU as is, so each one can be drawn as one "instance" of a single square.
+	// The textures are array textures, and each item can blend between a layer
+	// of the first one and a layer of the second one.
+	class Item {
+	public:
+		uint32_t tex0 = 0;
+		uint32_t tex1 = 0;
+		float layers[2] = {0.f, 0.f};
+		float position[2] = {0.f, 0.f};
+		float transform[4] = {0.f, 0.f, 0.f, 0.f};
+		float blur[2] = {0.f, 0.f};
+		float clip = 1.f;
+		// How far the item moves on the screen in one step. When drawing a
+		// frame in between two steps, it is moved back along this vector.
+		float motion[2] = {0.f, 0.f};
+		// The low byte is the color swizzle, and the rest is how far to fade
+		// from tex0 to tex1, times 256.
+		uint32_t flags = 0;
+	};
+	
+	
 public:
 	// Initialize the shaders.
 	static void Init();
 	
 	// Draw a sprite.
 	static void Draw(const Sprite *sprite, const Point &position, float zoom = 1., int swizzle = 0);
-	
-	static void Bind();
-	static void Add(uint32_t tex0, uint32_t tex1, const float position[2], const float transform[4], int swizzle = 0, float clip = 1., float fade = 0., const float blur[2] = nullptr);
-	static void Unbind();
+	// Draw the given items, in order. Each run of items that use the same
+	// textures is drawn with a single call, if instanced drawing is available.
+	// If the interpolation is less than 1, each item is drawn that fraction of
+	// the way from where it was in the previous step to where it is now.
+	static void Draw(const std::vector<Item> &items, bool showBlur = false, double interpolation = 1.);
 };
 
 
@@ -23,6 +23,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Sprite.h"
 #include "SpriteSet.h"
 
+#include <algorithm>
 #include <cmath>
 #include <numeric>
 
@@ -89,8 +90,8 @@ void StarField::SetHaze(const Sprite *sprite)
 
 void StarField::Draw(const Point &pos, const Point &vel, double zoom) const
 {
-	glUseProgram(shader.Object());
-	glBindVertexArray(vao);
+	shader.Use();
+	Shader::BindVertexArray(vao);
 	
 	float length = vel.Length();
 	Point unit = length ? vel.Unit() : Point(1., 0.);
@@ -121,27 +122,54 @@ void StarField::Draw(const Point &pos, const Point &vel, double zoom) const
 	minX &= ~(TILE_SIZE - 1l);
 	minY &= ~(TILE_SIZE - 1l);
 	
-	for(int gy = minY; gy < maxY; gy += TILE_SIZE)
-		for(int gx = minX; gx < maxX; gx += TILE_SIZE)
+	// The stars in each row of tiles are stored one after another, so each
+	// copy of the repeating star field needs only one call to draw the visible
+	// part of every row, or of the whole copy if all its tiles are visible.
+	int width = widthMod + 1;
+	vector<GLint> first;
+	vector<GLsizei> count;
+	for(int cy = minY & ~widthMod; cy < maxY; cy += width)
+		for(int cx = minX & ~widthMod; cx < maxX; cx += width)
 		{
-			Point off = Point(gx, gy) - pos;
+			// Find the range of tiles in this copy that are visible.
+			int startCol = max(minX - cx, 0) / TILE_SIZE;
+			int endCol = (min(maxX - cx, width) + TILE_SIZE - 1) / TILE_SIZE;
+			int startRow = max(minY - cy, 0) / TILE_SIZE;
+			int endRow = (min(maxY - cy, width) + TILE_SIZE - 1) / TILE_SIZE;
+			
+			first.clear();
+			count.clear();
+			for(int row = startRow; row < endRow; ++row)
+			{
+				int begin = 6 * tileIndex[startCol + row * tileCols];
+				int end = 6 * tileIndex[endCol + row * tileCols];
+				if(end == begin)
+					continue;
+				// If this row continues right where the previous one ended,
+				// just extend the previous range.
+				if(!first.empty() && first.back() + count.back() == begin)
+					count.back() += end - begin;
+				else
+				{
+					first.push_back(begin);
+					count.push_back(end - begin);
+				}
+			}
+			if(first.empty())
+				continue;
+			
+			Point off = Point(cx, cy) - pos;
 			GLfloat translate[2] = {
 				static_cast<float>(off.X()),
 				static_cast<float>(off.Y())
 			};
 			glUniform2fv(translateI, 1, translate);
-			
-			int index = (gx & widthMod) / TILE_SIZE + ((gy & widthMod) / TILE_SIZE) * tileCols;
-			int first = 6 * tileIndex[index];
-			int count = 6 * tileIndex[index + 1] - first;
-			glDrawArrays(GL_TRIANGLES, first, count);
+			glMultiDrawArrays(GL_TRIANGLES, first.data(), count.data(), first.size());
 		}
 	
-	glBindVertexArray(0);
-	glUseProgram(0);
 	
 	// Draw the background haze unless it is disabled in the preferences.
-	if(!Preferences::Has("Draw background haze"))
+	if(!Preferences::Has(Preferences::DRAW_BACKGROUND_HAZE))
 		return;
 	
 	DrawList drawList;
@@ -207,7 +235,7 @@ void StarField::SetUpGraphics()
 	
 	// make and bind the VAO
 	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	Shader::BindVertexArray(vao);
 	
 	// make and bind the VBO
 	glGenBuffers(1, &vbo);
@@ -293,8 +321,8 @@ void StarField::MakeStars(int stars, int width)
 		
 		// Randomize its sub-pixel position and its size / brightness.
 		int random = Random::Int(4096);
-		float fx = (x & (TILE_SIZE - 1)) + (random & 15) * 0.0625f;
-		float fy = (y & (TILE_SIZE - 1)) + (random >> 8) * 0.0625f;
+		float fx = x + (random & 15) * 0.0625f;
+		float fy = y + (random >> 8) * 0.0625f;
 		float size = (((random >> 4) & 15) + 20) * 0.0625f;
 		
 		// Fill in the data array.
@@ -335,5 +363,5 @@ void StarField::MakeStars(int stars, int width)
 	
 	// unbind the VBO and VAO
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	Shader::BindVertexArray(0);
 }
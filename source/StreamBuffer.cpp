@@ -0,0 +1,115 @@
+/* StreamBuffer.cpp
+Copyright (c) 2017 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "StreamBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+	// The mapped buffer is divided into segments. Before moving on to the next
+	// segment, a fence is placed after the last draw call that uses the current
+	// one, so it will not be overwritten until the GPU is done with it.
+	const size_t SEGMENT_SIZE = 1 << 20;
+	const int SEGMENTS = 4;
+	
+	bool isPersistent = false;
+	GLuint mappedBuffer = 0;
+	char *mapped = nullptr;
+	GLsync fences[SEGMENTS] = {};
+	int segment = 0;
+	size_t mappedOffset = 0;
+	
+	// The fallback buffer, which is also used for any upload too big to fit in
+	// a single segment of the mapped buffer.
+	GLuint streamBuffer = 0;
+	size_t streamSize = SEGMENT_SIZE * SEGMENTS;
+	size_t streamOffset = 0;
+}
+
+
+
+void StreamBuffer::Init()
+{
+	// Persistent mapping requires OpenGL 4.4. On systems whose headers do not
+	// even define it, always use the fallback.
+#ifdef GL_MAP_PERSISTENT_BIT
+	GLint major = 0;
+	GLint minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	if(major > 4 || (major == 4 && minor >= 4))
+	{
+		glGenBuffers(1, &mappedBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, mappedBuffer);
+		
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, SEGMENT_SIZE * SEGMENTS, nullptr, flags);
+		mapped = static_cast<char *>(glMapBufferRange(GL_ARRAY_BUFFER, 0, SEGMENT_SIZE * SEGMENTS, flags));
+		isPersistent = (mapped != nullptr);
+	}
+#endif
+	
+	glGenBuffers(1, &streamBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, streamBuffer);
+	glBufferData(GL_ARRAY_BUFFER, streamSize, nullptr, GL_STREAM_DRAW);
+	
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+
+GLintptr StreamBuffer::Upload(const void *data, size_t bytes)
+{
+	if(isPersistent && bytes <= SEGMENT_SIZE)
+	{
+		if(mappedOffset + bytes > (segment + 1) * SEGMENT_SIZE)
+		{
+			fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			segment = (segment + 1) % SEGMENTS;
+			mappedOffset = segment * SEGMENT_SIZE;
+			
+			// Usually the GPU finished with this segment long ago, so this
+			// will not actually have to wait.
+			if(fences[segment])
+			{
+				while(glClientWaitSync(fences[segment], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+					continue;
+				glDeleteSync(fences[segment]);
+				fences[segment] = nullptr;
+			}
+		}
+		memcpy(mapped + mappedOffset, data, bytes);
+		GLintptr offset = mappedOffset;
+		mappedOffset += bytes;
+		
+		glBindBuffer(GL_ARRAY_BUFFER, mappedBuffer);
+		return offset;
+	}
+	
+	glBindBuffer(GL_ARRAY_BUFFER, streamBuffer);
+	if(streamOffset + bytes > streamSize)
+	{
+		// Orphan the old storage instead of waiting for the GPU to finish
+		// drawing from it.
+		streamSize = max(streamSize, bytes);
+		glBufferData(GL_ARRAY_BUFFER, streamSize, nullptr, GL_STREAM_DRAW);
+		streamOffset = 0;
+	}
+	glBufferSubData(GL_ARRAY_BUFFER, streamOffset, bytes, data);
+	GLintptr offset = streamOffset;
+	streamOffset += bytes;
+	
+	return offset;
+}
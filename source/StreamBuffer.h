@@ -0,0 +1,39 @@
+/* StreamBuffer.h
+Copyright (c) 2017 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef STREAM_BUFFER_H_
+#define STREAM_BUFFER_H_
+
+#include "gl_header.h"
+
+#include <cstddef>
+
+
+
+// A single vertex buffer shared by all the shaders that build their vertex data
+// on the CPU each frame. If the driver supports it, the buffer is mapped once
+// and written directly, with fences to keep from overwriting any part of it the
+// GPU is still reading from. Otherwise, the data is appended with
+// glBufferSubData() and the buffer is orphaned whenever it fills up.
+class StreamBuffer {
+public:
+	static void Init();
+	
+	// Copy the given data into the stream, and leave the buffer it is now in
+	// bound to GL_ARRAY_BUFFER. The return value is the data's offset in that
+	// buffer, for use in glVertexAttribPointer().
+	static GLintptr Upload(const void *data, size_t bytes);
+};
+
+
+
+#endif
@@ -22,12 +22,36 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Planet.h"
 #include "Random.h"
 #include "SpriteSet.h"
+#include "SystemGrid.h"
 
 #include <cmath>
+#include <map>
+#include <mutex>
+#include <vector>
 
 using namespace std;
 
 namespace {
+	// Map from commodity names to their indices in each system's price list.
+	mutex commodityMutex;
+	map<string, int> commodityIndex;
+	
+	// Get the index of the given commodity. If it is not yet known, return -1,
+	// or give it the next index if "create" is set.
+	int CommodityIndex(const string &commodity, bool create = false)
+	{
+		lock_guard<mutex> lock(commodityMutex);
+		auto it = commodityIndex.find(commodity);
+		if(it != commodityIndex.end())
+			return it->second;
+		if(!create)
+			return -1;
+		
+		int index = commodityIndex.size();
+		commodityIndex[commodity] = index;
+		return index;
+	}
+	
 	// Dynamic economy parameters: how much of its production each system keeps
 	// and exports each day:
 	static const double KEEP = .89;
@@ -164,7 +188,12 @@ void System::Load(const DataNode &node, Set<Planet> &planets)
 		else if(child.Token(0) == "haze" && child.Size() >= 2)
 			haze = SpriteSet::Get(child.Token(1));
 		else if(child.Token(0) == "trade" && child.Size() >= 3)
-			trade[child.Token(1)].SetBase(child.Value(2));
+		{
+			size_t index = CommodityIndex(child.Token(1), true);
+			if(trade.size() <= index)
+				trade.resize(index + 1);
+			trade[index].SetBase(child.Value(2));
+		}
 		else if(child.Token(0) == "fleet")
 		{
 			if(resetFleets)
@@ -242,9 +271,12 @@ void System::Load(const DataNode &node, Set<Planet> &planets)
 
 
 // Once the star map is fully loaded, figure out which stars are "neighbors"
-// of this one, i.e. close enough to see or to reach via jump drive.
-void System::UpdateNeighbors(const Set<System> &systems)
+// of this one, i.e. close enough to see or to reach via jump drive. This
+// also gives the system its index in the list of all systems. The
+// SystemGrid must already be up to date.
+void System::UpdateNeighbors(int index)
 {
+	this->index = index;
 	neighbors.clear();
 	
 	// Every star system that is linked to this one is automatically a neighbor,
@@ -255,9 +287,11 @@ void System::UpdateNeighbors(const Set<System> &systems)
 	
 	// Any other star system that is within the neighbor distance is also a
 	// neighbor. This will include any nearby linked systems.
-	for(const auto &it : systems)
-		if(&it.second != this && it.second.Position().Distance(position) <= NEIGHBOR_DISTANCE)
-			neighbors.insert(&it.second);
+	vector<const System *> nearby;
+	SystemGrid::Circle(position, NEIGHBOR_DISTANCE, nearby);
+	for(const System *system : nearby)
+		if(system != this)
+			neighbors.insert(system);
 }
 
 
@@ -315,6 +349,15 @@ const Point &System::Position() const
 
 
 
+// Get this system's index in the list of all systems, or -1 if it was
+// created after the star map was last updated.
+int System::Index() const
+{
+	return index;
+}
+
+
+
 // Get this system's government.
 const Government *System::GetGovernment() const
 {
@@ -490,15 +533,18 @@ const Sprite *System::Haze() const
 // Get the price of the given commodity in this system.
 int System::Trade(const string &commodity) const
 {
-	auto it = trade.find(commodity);
-	return (it == trade.end()) ? 0 : it->second.price;
+	const Price *price = Find(commodity);
+	return price ? price->price : 0;
 }
 
 
 
 bool System::HasTrade() const
 {
-	return !trade.empty();
+	for(const Price &price : trade)
+		if(price.isTraded)
+			return true;
+	return false;
 }
 
 
@@ -506,12 +552,35 @@ bool System::HasTrade() const
 // Update the economy.
 void System::StepEconomy()
 {
-	for(auto &it : trade)
+	for(Price &price : trade)
+		if(price.isTraded)
+		{
+			price.exports = EXPORT * price.supply;
+			price.supply *= KEEP;
+			price.supply += Random::Normal() * VOLUME;
+			price.Update();
+		}
+}
+
+
+
+// Add the goods exported by the systems linked to this one. This must not
+// be done until every system has done StepEconomy().
+void System::ImportGoods()
+{
+	for(size_t i = 0; i < trade.size(); ++i)
 	{
-		it.second.exports = EXPORT * it.second.supply;
-		it.second.supply *= KEEP;
-		it.second.supply += Random::Normal() * VOLUME;
-		it.second.Update();
+		Price &price = trade[i];
+		if(!price.isTraded)
+			continue;
+		
+		for(const System *neighbor : links)
+		{
+			double scale = neighbor->links.size();
+			if(scale && i < neighbor->trade.size() && neighbor->trade[i].isTraded)
+				price.supply += neighbor->trade[i].exports / scale;
+		}
+		price.Update();
 	}
 }
 
@@ -519,28 +588,28 @@ void System::StepEconomy()
 
 void System::SetSupply(const string &commodity, double tons)
 {
-	auto it = trade.find(commodity);
-	if(it == trade.end())
+	Price *price = Find(commodity);
+	if(!price)
 		return;
 	
-	it->second.supply = tons;
-	it->second.Update();
+	price->supply = tons;
+	price->Update();
 }
 
 
 
 double System::Supply(const string &commodity) const
 {
-	auto it = trade.find(commodity);
-	return (it == trade.end()) ? 0 : it->second.supply;
+	const Price *price = Find(commodity);
+	return price ? price->supply : 0.;
 }
 
 
 
 double System::Exports(const string &commodity) const
 {
-	auto it = trade.find(commodity);
-	return (it == trade.end()) ? 0 : it->second.exports;
+	const Price *price = Find(commodity);
+	return price ? price->exports : 0.;
 }
 
 
@@ -607,8 +676,27 @@ void System::LoadObject(const DataNode &node, Set<Planet> &planets, int parent)
 
 
 
+// Find the price of the given commodity, or null if it is not traded here.
+System::Price *System::Find(const string &commodity)
+{
+	int index = CommodityIndex(commodity);
+	if(index < 0 || static_cast<size_t>(index) >= trade.size() || !trade[index].isTraded)
+		return nullptr;
+	return &trade[index];
+}
+
+
+
+const System::Price *System::Find(const string &commodity) const
+{
+	return const_cast<System *>(this)->Find(commodity);
+}
+
+
+
 void System::Price::SetBase(int base)
 {
+	this->isTraded = true;
 	this->base = base;
 	this->price = base;
 }
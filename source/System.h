@@ -75,8 +75,10 @@ public:
 	// Load a system's description.
 	void Load(const DataNode &node, Set<Planet> &planets);
 	// Once the star map is fully loaded, figure out which stars are "neighbors"
-	// of this one, i.e. close enough to see or to reach via jump drive.
-	void UpdateNeighbors(const Set<System> &systems);
+	// of this one, i.e. close enough to see or to reach via jump drive. This
+	// also gives the system its index in the list of all systems. The
+	// SystemGrid must already be up to date.
+	void UpdateNeighbors(int index);
 	
 	// Modify a system's links.
 	void Link(System *other);
@@ -85,6 +87,9 @@ public:
 	// Get this system's name and position (in the star map).
 	const std::string &Name() const;
 	const Point &Position() const;
+	// Get this system's index in the list of all systems, or -1 if it was
+	// created after the star map was last updated.
+	int Index() const;
 	// Get this system's government.
 	const Government *GetGovernment() const;
 	// Get the name of the ambient audio to play in this system.
@@ -126,6 +131,9 @@ public:
 	bool HasTrade() const;
 	// Update the economy. Returns the amount of trade goods this system exports.
 	void StepEconomy();
+	// Add the goods exported by the systems linked to this one. This must not
+	// be done until every system has done StepEconomy().
+	void ImportGoods();
 	void SetSupply(const std::string &commodity, double tons);
 	double Supply(const std::string &commodity) const;
 	double Exports(const std::string &commodity) const;
@@ -147,17 +155,23 @@ private:
 		void SetBase(int base);
 		void Update();
 		
+		bool isTraded = false;
 		int base = 0;
 		int price = 0;
 		double supply = 0.;
 		double exports = 0.;
 	};
 	
+	// Find the price of the given commodity, or null if it is not traded here.
+	Price *Find(const std::string &commodity);
+	const Price *Find(const std::string &commodity) const;
+	
 	
 private:
 	// Name and position (within the star map) of this system.
 	std::string name;
 	Point position;
+	int index = -1;
 	const Government *government = nullptr;
 	std::string music;
 	
@@ -176,8 +190,9 @@ private:
 	double habitable = 1000.;
 	double asteroidBelt = 1500.;
 	
-	// Commodity prices.
-	std::map<std::string, Price> trade;
+	// Commodity prices, indexed by a number assigned to each commodity name
+	// the first time it is seen.
+	std::vector<Price> trade;
 };
 
 
@@ -0,0 +1,162 @@
+/* SystemGrid.cpp
+Copyright (c) 2017 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "SystemGrid.h"
+
+#include "Point.h"
+#include "System.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+using namespace std;
+
+namespace {
+	// Systems are usually 50 to 100 units apart, so this puts a handful of
+	// them in each cell.
+	const double CELL_SIZE = 128.;
+	
+	class Entry {
+	public:
+		Entry() = default;
+		Entry(int index, const System *system) : index(index), system(system) {}
+		
+		// The position of this system in the list of all systems.
+		int index;
+		const System *system;
+	};
+	
+	// The corner of the grid with the smallest coordinates, and the number of
+	// rows and columns. Every system is inside the grid.
+	Point origin;
+	int columns = 0;
+	int rows = 0;
+	// The systems, sorted by cell. The systems in cell i are the ones from
+	// sorted[counts[i]] up to (but not including) sorted[counts[i + 1]].
+	vector<Entry> sorted;
+	vector<int> counts;
+	
+	// Get the cell coordinate for the given map coordinate, clamped to the
+	// edges of the grid. This is done before converting to an integer so that
+	// even an infinite range is handled.
+	int Clamp(double cell, int cells)
+	{
+		return (cell < 0.) ? 0 : (cell >= cells) ? cells - 1 : static_cast<int>(cell);
+	}
+	
+	int Column(double x)
+	{
+		return Clamp(floor((x - origin.X()) / CELL_SIZE), columns);
+	}
+	
+	int Row(double y)
+	{
+		return Clamp(floor((y - origin.Y()) / CELL_SIZE), rows);
+	}
+	
+	// Get every system in the cells that the given rectangle touches that
+	// passes the given test, in the order of the list of all systems.
+	template <class Test>
+	void Find(const Point &topLeft, const Point &bottomRight, vector<const System *> &result, Test test)
+	{
+		result.clear();
+		if(sorted.empty())
+			return;
+		
+		vector<Entry> found;
+		int maxX = Column(bottomRight.X());
+		int maxY = Row(bottomRight.Y());
+		for(int y = Row(topLeft.Y()); y <= maxY; ++y)
+			for(int x = Column(topLeft.X()); x <= maxX; ++x)
+			{
+				int i = y * columns + x;
+				for(int j = counts[i]; j < counts[i + 1]; ++j)
+					if(test(sorted[j].system->Position()))
+						found.push_back(sorted[j]);
+			}
+		
+		// Each system is only in one cell, so there are no duplicates to remove.
+		sort(found.begin(), found.end(),
+			[](const Entry &a, const Entry &b) { return a.index < b.index; });
+		for(const Entry &entry : found)
+			result.push_back(entry.system);
+	}
+}
+
+
+
+// Sort the given systems into the grid.
+void SystemGrid::Update(const Set<System> &systems)
+{
+	sorted.clear();
+	counts.clear();
+	columns = 0;
+	rows = 0;
+	if(!systems.size())
+		return;
+	
+	// Find the bounds of the map.
+	Point low = systems.begin()->second.Position();
+	Point high = low;
+	for(const auto &it : systems)
+	{
+		const Point &position = it.second.Position();
+		low = Point(min(low.X(), position.X()), min(low.Y(), position.Y()));
+		high = Point(max(high.X(), position.X()), max(high.Y(), position.Y()));
+	}
+	origin = low;
+	columns = static_cast<int>((high.X() - low.X()) / CELL_SIZE) + 1;
+	rows = static_cast<int>((high.Y() - low.Y()) / CELL_SIZE) + 1;
+	
+	// Count how many systems are in each cell, then turn those counts into the
+	// index where each cell begins. Within each cell, the systems stay in the
+	// same order as in the list of all systems.
+	counts.resize(columns * rows + 1, 0);
+	for(const auto &it : systems)
+		++counts[Row(it.second.Position().Y()) * columns + Column(it.second.Position().X()) + 1];
+	partial_sum(counts.begin(), counts.end(), counts.begin());
+	
+	vector<int> next(counts.begin(), counts.end() - 1);
+	sorted.resize(systems.size());
+	int index = 0;
+	for(const auto &it : systems)
+	{
+		const Point &position = it.second.Position();
+		sorted[next[Row(position.Y()) * columns + Column(position.X())]++] = Entry(index++, &it.second);
+	}
+}
+
+
+
+// Get every system that is within the given range of the given point. The
+// systems are in the same order as in the list of all systems.
+void SystemGrid::Circle(const Point &center, double radius, vector<const System *> &result)
+{
+	Point corner(radius, radius);
+	Find(center - corner, center + corner, result,
+		[&center, radius](const Point &position) { return position.Distance(center) <= radius; });
+}
+
+
+
+// Get every system within the rectangle with the given top left and bottom
+// right corners, in the same order as in the list of all systems.
+void SystemGrid::Box(const Point &topLeft, const Point &bottomRight, vector<const System *> &result)
+{
+	Find(topLeft, bottomRight, result,
+		[&topLeft, &bottomRight](const Point &position)
+		{
+			return position.X() >= topLeft.X() && position.X() <= bottomRight.X()
+				&& position.Y() >= topLeft.Y() && position.Y() <= bottomRight.Y();
+		});
+}
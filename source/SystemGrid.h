@@ -0,0 +1,45 @@
+/* SystemGrid.h
+Copyright (c) 2017 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef SYSTEM_GRID_H_
+#define SYSTEM_GRID_H_
+
+#include "Set.h"
+
+#include <vector>
+
+class Point;
+class System;
+
+
+
+// A SystemGrid sorts every star system into a coarse grid based on its position
+// on the map, so that the systems near a given point, or within the part of
+// the map that is on screen, can be found without checking all of them. The
+// grid must be updated whenever the map changes, i.e. whenever the neighbors
+// of each system are recalculated.
+class SystemGrid {
+public:
+	// Sort the given systems into the grid.
+	static void Update(const Set<System> &systems);
+	
+	// Get every system that is within the given range of the given point. The
+	// systems are in the same order as in the list of all systems.
+	static void Circle(const Point &center, double radius, std::vector<const System *> &result);
+	// Get every system within the rectangle with the given top left and bottom
+	// right corners, in the same order as in the list of all systems.
+	static void Box(const Point &topLeft, const Point &bottomRight, std::vector<const System *> &result);
+};
+
+
+
+#endif
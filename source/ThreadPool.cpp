@@ -0,0 +1,264 @@
+/* ThreadPool.cpp
+Copyright (c) 2017 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "ThreadPool.h"
+
+#include "CurrentThread.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+
+using namespace std;
+
+namespace {
+	// The shared state of one call to ParallelFor(). Helper tasks for it may
+	// still be sitting in a queue after the call returns, so this is kept in a
+	// shared pointer that each helper holds on to.
+	class Batch {
+	public:
+		explicit Batch(size_t count) : count(count), next(0), remaining(count) {}
+		
+		// Run jobs from this batch until none are left to start.
+		void Run(const function<void(size_t)> &job)
+		{
+			while(true)
+			{
+				size_t index = next++;
+				if(index >= count)
+					return;
+				
+				job(index);
+				if(!--remaining)
+				{
+					unique_lock<mutex> lock(doneMutex);
+					doneCondition.notify_all();
+				}
+			}
+		}
+		
+		size_t count;
+		atomic<size_t> next;
+		atomic<size_t> remaining;
+		mutex doneMutex;
+		condition_variable doneCondition;
+	};
+}
+
+
+
+// Get the pool that the whole game shares. It is never destroyed, so it can
+// safely be used by other objects that are being destroyed at exit.
+ThreadPool &ThreadPool::Shared()
+{
+	// The main thread does the drawing, and other threads may be waiting for
+	// the pool to finish their work, so leave one core free for them. Always
+	// have at least two workers, because many tasks (like loading images) spend
+	// much of their time waiting on the disk.
+	static ThreadPool *shared = new ThreadPool(max(2u, DefaultSize(1)));
+	return *shared;
+}
+
+
+
+// Get a sensible number of worker threads for a pool, given how many other
+// threads are expected to be busy at the same time as it.
+unsigned ThreadPool::DefaultSize(unsigned otherThreads)
+{
+	// If the number of cores is unknown, this returns zero.
+	unsigned cores = thread::hardware_concurrency();
+	return (cores > otherThreads) ? cores - otherThreads : 0;
+}
+
+
+
+// Create a pool with the given number of worker threads.
+ThreadPool::ThreadPool(unsigned count)
+	: workers(count)
+{
+	threads.reserve(count);
+	for(unsigned i = 0; i < count; ++i)
+		threads.emplace_back(&ThreadPool::ThreadEntryPoint, this, i);
+}
+
+
+
+ThreadPool::~ThreadPool()
+{
+	{
+		unique_lock<mutex> lock(sleepMutex);
+		terminate = true;
+	}
+	wake.notify_all();
+	for(thread &t : threads)
+		t.join();
+}
+
+
+
+// Get the number of worker threads in this pool.
+unsigned ThreadPool::Size() const
+{
+	return threads.size();
+}
+
+
+
+// Queue up a task for one of the worker threads to run.
+void ThreadPool::Submit(function<void()> task)
+{
+	if(workers.empty())
+	{
+		task();
+		return;
+	}
+	
+	// A worker adds tasks to its own queue, since the data the task needs is
+	// probably in its cache. Anyone else spreads the tasks out evenly. The task
+	// must be counted as pending before it is queued; otherwise, a busy worker
+	// could take it and decrement the count before it was incremented.
+	int index = CurrentWorker();
+	{
+		unique_lock<mutex> lock(sleepMutex);
+		if(index < 0)
+			index = nextWorker++ % workers.size();
+		++pending;
+	}
+	{
+		Worker &worker = workers[index];
+		unique_lock<mutex> lock(worker.mutex);
+		worker.tasks.push_back(move(task));
+	}
+	wake.notify_one();
+}
+
+
+
+// Call the given function once for each index from 0 to count - 1. The calls
+// may happen in any order, and in different threads, but this does not return
+// until all of them are done.
+void ThreadPool::ParallelFor(size_t count, const function<void(size_t)> &job)
+{
+	// There is no point in waking up the workers for a single job.
+	if(workers.empty() || count < 2)
+	{
+		for(size_t i = 0; i < count; ++i)
+			job(i);
+		return;
+	}
+	
+	// Each helper keeps taking jobs from the batch until there are none left,
+	// so there is no need for more helpers than there are workers.
+	shared_ptr<Batch> batch = make_shared<Batch>(count);
+	const function<void(size_t)> *jobPtr = &job;
+	size_t helpers = min(count - 1, workers.size());
+	{
+		unique_lock<mutex> lock(sleepMutex);
+		for(size_t i = 0; i < helpers; ++i)
+			urgent.emplace_back([batch, jobPtr]() { batch->Run(*jobPtr); });
+		pending += helpers;
+	}
+	wake.notify_all();
+	
+	// This thread works on the jobs too, instead of just waiting. Any helper
+	// that starts after all the jobs have been taken will return immediately,
+	// without touching the job function.
+	batch->Run(job);
+	unique_lock<mutex> lock(batch->doneMutex);
+	while(batch->remaining)
+		batch->doneCondition.wait(lock);
+}
+
+
+
+// Entry point for the worker threads.
+void ThreadPool::ThreadEntryPoint(unsigned index)
+{
+	// The workers run the engine's parallel loops as well as loading, so they
+	// keep the ordinary priority.
+	CurrentThread::SetName(("es-worker-" + to_string(index)).c_str());
+	while(true)
+	{
+		{
+			unique_lock<mutex> lock(sleepMutex);
+			while(!pending && !terminate)
+				wake.wait(lock);
+			if(terminate)
+				return;
+		}
+		
+		function<void()> task;
+		if(Take(index, task))
+			task();
+	}
+}
+
+
+
+// Find the index of the worker running in this thread, or -1 if this thread is
+// not part of this pool.
+int ThreadPool::CurrentWorker() const
+{
+	thread::id id = this_thread::get_id();
+	for(unsigned i = 0; i < threads.size(); ++i)
+		if(threads[i].get_id() == id)
+			return i;
+	return -1;
+}
+
+
+
+// Take a task to run, either from the urgent queue, from the given worker's
+// own queue, or from some other worker's queue.
+bool ThreadPool::Take(unsigned index, function<void()> &task)
+{
+	{
+		unique_lock<mutex> lock(sleepMutex);
+		if(!urgent.empty())
+		{
+			task = move(urgent.front());
+			urgent.pop_front();
+			--pending;
+			return true;
+		}
+	}
+	
+	// Take the newest task from this worker's own queue, but steal the oldest
+	// task from anyone else's queue.
+	bool found = false;
+	for(unsigned i = 0; i < workers.size() && !found; ++i)
+	{
+		Worker &worker = workers[(index + i) % workers.size()];
+		unique_lock<mutex> lock(worker.mutex);
+		if(worker.tasks.empty())
+			continue;
+		
+		if(!i)
+		{
+			task = move(worker.tasks.back());
+			worker.tasks.pop_back();
+		}
+		else
+		{
+			task = move(worker.tasks.front());
+			worker.tasks.pop_front();
+		}
+		found = true;
+	}
+	if(found)
+	{
+		unique_lock<mutex> lock(sleepMutex);
+		--pending;
+	}
+	return found;
+}
@@ -0,0 +1,97 @@
+/* ThreadPool.h
+Copyright (c) 2017 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+
+// Class representing a set of worker threads that share the work of running
+// tasks. Each worker has its own queue of tasks, and when that queue is empty
+// it "steals" tasks from the other workers, so that no core is left idle as
+// long as there is work to be done. Rather than each part of the game creating
+// its own threads, they should all hand their work to the Shared() pool, so
+// that the number of busy threads never exceeds the number of cores.
+class ThreadPool {
+public:
+	// Get the pool that the whole game shares. It is never destroyed, so it can
+	// safely be used by other objects that are being destroyed at exit.
+	static ThreadPool &Shared();
+	
+	// Get a sensible number of worker threads for a pool, given how many other
+	// threads are expected to be busy at the same time as it.
+	static unsigned DefaultSize(unsigned otherThreads);
+	
+	
+public:
+	// Create a pool with the given number of worker threads.
+	explicit ThreadPool(unsigned threads);
+	~ThreadPool();
+	
+	// Get the number of worker threads in this pool.
+	unsigned Size() const;
+	
+	// Queue up a task for one of the worker threads to run. There is no
+	// guarantee what order tasks will run in. To find out when a task is done,
+	// the task itself must signal that somehow.
+	void Submit(std::function<void()> task);
+	// Call the given function once for each index from 0 to count - 1. The
+	// calls may happen in any order, and in different threads, but this does
+	// not return until all of them are done. The calling thread does some of
+	// the work itself, and jobs for this have priority over other tasks.
+	void ParallelFor(std::size_t count, const std::function<void(std::size_t)> &job);
+	
+	
+private:
+	class Worker {
+	public:
+		std::deque<std::function<void()>> tasks;
+		std::mutex mutex;
+	};
+	
+	
+private:
+	// Entry point for the worker threads.
+	void ThreadEntryPoint(unsigned index);
+	// Find the index of the worker running in this thread, or -1 if this
+	// thread is not part of this pool.
+	int CurrentWorker() const;
+	// Take a task to run, either from the urgent queue, from the given worker's
+	// own queue, or from some other worker's queue.
+	bool Take(unsigned index, std::function<void()> &task);
+	
+	
+private:
+	std::vector<std::thread> threads;
+	std::vector<Worker> workers;
+	
+	// This mutex guards the urgent queue, the count of pending tasks, and the
+	// condition that idle workers wait on.
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::deque<std::function<void()>> urgent;
+	std::size_t pending = 0;
+	unsigned nextWorker = 0;
+	bool terminate = false;
+};
+
+
+
+#endif
@@ -61,6 +61,7 @@ TradingPanel::TradingPanel(PlayerInfo &player)
 	: player(player), system(*player.GetSystem()), COMMODITY_COUNT(GameData::Commodities().size())
 {
 	SetTrapAllEvents(false);
+	SetIsStatic(true);
 }
 
 
@@ -92,14 +93,14 @@ void TradingPanel::Step()
 
 void TradingPanel::Draw()
 {
-	Color back = *GameData::Colors().Get("faint");
+	static const Color &back = *GameData::Colors().Get("faint");
 	int selectedRow = player.MapColoring();
 	if(selectedRow >= 0 && selectedRow < COMMODITY_COUNT)
 		FillShader::Fill(Point(-60., FIRST_Y + 20 * selectedRow + 33), Point(480., 20.), back);
 	
 	const Font &font = FontSet::Get(14);
-	Color unselected = *GameData::Colors().Get("medium");
-	Color selected = *GameData::Colors().Get("bright");
+	static const Color &unselected = *GameData::Colors().Get("medium");
+	static const Color &selected = *GameData::Colors().Get("bright");
 	
 	int y = FIRST_Y;
 	FillShader::Fill(Point(-60., y + 15.), Point(480., 1.), unselected);
@@ -202,7 +203,7 @@ void TradingPanel::Draw()
 		}
 	}
 	
-	const Interface *interface = GameData::Interfaces().Get("trade");
+	static const Interface *interface = GameData::Interfaces().Get("trade");
 	Information info;
 	if(sellOutfits)
 		info.SetCondition("can sell outfits");
@@ -36,6 +36,7 @@ UI::UI()
 // of them handles it. If none do, this returns false.
 bool UI::Handle(const SDL_Event &event)
 {
+	isDirty = true;
 	bool handled = false;
 	
 	vector<shared_ptr<Panel>>::iterator it = stack.end();
@@ -99,8 +100,12 @@ bool UI::Handle(const SDL_Event &event)
 
 
 // Step all the panels forward (advance animations, move objects, etc.).
-void UI::StepAll()
+// If many steps are taken for each frame, the results of most of them are
+// never shown, so panels can skip whatever they only do for drawing.
+void UI::StepAll(bool isShown)
 {
+	isStepShown = isShown;
+	
 	// Handle any queued push or pop commands.
 	PushOrPop();
 	
@@ -112,8 +117,11 @@ void UI::StepAll()
 
 
 // Draw all the panels.
-void UI::DrawAll()
+void UI::DrawAll(double interpolation)
 {
+	this->interpolation = interpolation;
+	isDirty = false;
+	
 	// First, clear all the clickable zones. New ones will be added in the
 	// course of drawing the screen.
 	for(const shared_ptr<Panel> &it : stack)
@@ -131,6 +139,41 @@ void UI::DrawAll()
 
 
 
+// Get how far the frame being drawn is between the last step and the next.
+double UI::Interpolation() const
+{
+	return interpolation;
+}
+
+
+
+bool UI::IsStepShown() const
+{
+	return isStepShown;
+}
+
+
+
+// Check whether the panels must be drawn again.
+bool UI::NeedsRedraw() const
+{
+	if(isDirty)
+		return true;
+	
+	// Only the topmost full-screen panel and the ones above it are drawn.
+	vector<shared_ptr<Panel>>::const_iterator it = stack.end();
+	while(it != stack.begin())
+	{
+		if(!(*--it)->IsStatic())
+			return true;
+		if((*it)->IsFullScreen())
+			break;
+	}
+	return false;
+}
+
+
+
 // Add the given panel to the stack. UI is responsible for deleting it.
 void UI::Push(Panel *panel)
 {
@@ -186,6 +229,7 @@ void UI::Reset()
 	toPush.clear();
 	toPop.clear();
 	isDone = false;
+	isDirty = true;
 }
 
 
@@ -244,6 +288,9 @@ Point UI::GetMouse()
 // If a push or pop is queued, apply it.
 void UI::PushOrPop()
 {
+	if(!toPush.empty() || !toPop.empty())
+		isDirty = true;
+	
 	// Handle any panels that should be added.
 	for(shared_ptr<Panel> &panel : toPush)
 		if(panel)
@@ -38,9 +38,20 @@ public:
 	bool Handle(const SDL_Event &event);
 	
 	// Step all the panels forward (advance animations, move objects, etc.).
-	void StepAll();
-	// Draw all the panels.
-	void DrawAll();
+	// If many steps are taken for each frame, the results of most of them are
+	// never shown, so panels can skip whatever they only do for drawing.
+	void StepAll(bool isShown = true);
+	bool IsStepShown() const;
+	// Draw all the panels. The interpolation is how far the current frame is
+	// between the last step and the next one, from 0 to 1. The game only steps
+	// at a fixed rate, so if frames are drawn more often than that, this lets
+	// moving objects be drawn partway between where they are in each step.
+	void DrawAll(double interpolation = 1.);
+	double Interpolation() const;
+	// Check whether the panels must be drawn again. This is true unless every
+	// panel that would be drawn is static and nothing has happened to them
+	// since the last time they were drawn.
+	bool NeedsRedraw() const;
 	
 	// Add the given panel to the stack. If you do not want a panel to be
 	// deleted when it is popped, save a copy of its shared pointer elsewhere.
@@ -81,6 +92,10 @@ private:
 	std::vector<std::shared_ptr<Panel>> stack;
 	
 	bool isDone;
+	double interpolation = 1.;
+	bool isStepShown = true;
+	// Whether an event or a push or pop has happened since the last draw.
+	bool isDirty = true;
 	std::vector<std::shared_ptr<Panel>> toPush;
 	std::vector<const Panel *> toPop;
 };
@@ -19,6 +19,8 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Outfit.h"
 #include "SpriteSet.h"
 
+#include <algorithm>
+
 using namespace std;
 
 
@@ -64,7 +66,14 @@ void Weapon::LoadWeapon(const DataNode &node)
 		else if(child.Token(0) == "submunition" && child.Size() >= 2)
 		{
 			int count = (child.Size() >= 3) ? child.Value(2) : 1;
-			submunitions[GameData::Outfits().Get(child.Token(1))] += count;
+			const Outfit *outfit = GameData::Outfits().Get(child.Token(1));
+			auto it = find_if(submunitions.begin(), submunitions.end(),
+				[outfit](const pair<const Outfit *, int> &entry) { return entry.first == outfit; });
+			if(it == submunitions.end())
+				submunitions.emplace_back(outfit, count);
+			else
+				it->second += count;
+			submunitionCount += count;
 		}
 		else if(child.Token(0) == "stream")
 			isStreamed = true;
@@ -125,17 +134,17 @@ void Weapon::LoadWeapon(const DataNode &node)
 			else if(child.Token(0) == "blast radius")
 				blastRadius = child.Value(1);
 			else if(child.Token(0) == "shield damage")
-				damage[SHIELD_DAMAGE] = child.Value(1);
+				ownDamage[SHIELD_DAMAGE] = child.Value(1);
 			else if(child.Token(0) == "hull damage")
-				damage[HULL_DAMAGE] = child.Value(1);
+				ownDamage[HULL_DAMAGE] = child.Value(1);
 			else if(child.Token(0) == "heat damage")
-				damage[HEAT_DAMAGE] = child.Value(1);
+				ownDamage[HEAT_DAMAGE] = child.Value(1);
 			else if(child.Token(0) == "ion damage")
-				damage[ION_DAMAGE] = child.Value(1);
+				ownDamage[ION_DAMAGE] = child.Value(1);
 			else if(child.Token(0) == "disruption damage")
-				damage[DISRUPTION_DAMAGE] = child.Value(1);
+				ownDamage[DISRUPTION_DAMAGE] = child.Value(1);
 			else if(child.Token(0) == "slowing damage")
-				damage[SLOWING_DAMAGE] = child.Value(1);
+				ownDamage[SLOWING_DAMAGE] = child.Value(1);
 			else if(child.Token(0) == "hit force")
 				hitForce = child.Value(1);
 			else if(child.Token(0) == "piercing")
@@ -174,6 +183,8 @@ void Weapon::LoadWeapon(const DataNode &node)
 			++it;
 		}
 	}
+	
+	ResetTotals();
 }
 
 
@@ -250,13 +261,38 @@ const map<const Effect *, int> &Weapon::DieEffects() const
 
 
 
-const map<const Outfit *, int> &Weapon::Submunitions() const
+const vector<pair<const Outfit *, int>> &Weapon::Submunitions() const
 {
 	return submunitions;
 }
 
 
 
+// Once all the outfits have been loaded, add up the damage that each weapon's
+// submunitions do, so that it need not be done each time something is hit.
+void Weapon::FinishLoading()
+{
+	for(int i = SHIELD_DAMAGE; i <= SLOWING_DAMAGE; ++i)
+		TotalDamage(i);
+	TotalLifetime();
+}
+
+
+
+// Forget the totals that FinishLoading() added up, so they can be added up
+// again after this weapon or any of its submunitions has been reloaded.
+void Weapon::ResetTotals()
+{
+	for(int i = SHIELD_DAMAGE; i <= SLOWING_DAMAGE; ++i)
+	{
+		damage[i] = ownDamage[i];
+		calculatedDamage[i] = false;
+	}
+	totalLifetime = -1.;
+}
+
+
+
 double Weapon::TotalLifetime() const
 {
 	if(totalLifetime < 0.)
@@ -16,6 +16,8 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Body.h"
 
 #include <map>
+#include <utility>
+#include <vector>
 
 class DataNode;
 class Effect;
@@ -48,7 +50,11 @@ public:
 	const std::map<const Effect *, int> &LiveEffects() const;
 	const std::map<const Effect *, int> &HitEffects() const;
 	const std::map<const Effect *, int> &DieEffects() const;
-	const std::map<const Outfit *, int> &Submunitions() const;
+	// The submunitions are kept in the order they were listed in, each with the
+	// number of copies to create, so spawning them is just a walk over a vector.
+	const std::vector<std::pair<const Outfit *, int>> &Submunitions() const;
+	// The total number of submunitions this weapon splits into.
+	int SubmunitionCount() const;
 	
 	// Accessor functions for various attributes.
 	int Lifetime() const;
@@ -89,6 +95,13 @@ public:
 	double BlastRadius() const;
 	double HitForce() const;
 	
+	// Once all the outfits have been loaded, add up the damage that each weapon's
+	// submunitions do, so that it need not be done each time something is hit.
+	void FinishLoading();
+	// Forget the totals that FinishLoading() added up, so they can be added up
+	// again after this weapon or any of its submunitions has been reloaded.
+	void ResetTotals();
+	
 	// These values include all submunitions:
 	double ShieldDamage() const;
 	double HullDamage() const;
@@ -123,7 +136,8 @@ private:
 	std::map<const Effect *, int> liveEffects;
 	std::map<const Effect *, int> hitEffects;
 	std::map<const Effect *, int> dieEffects;
-	std::map<const Outfit *, int> submunitions;
+	std::vector<std::pair<const Outfit *, int>> submunitions;
+	int submunitionCount = 0;
 	
 	// This stores whether or not the weapon has been loaded.
 	bool isWeapon = false;
@@ -171,6 +185,8 @@ private:
 	static const int DISRUPTION_DAMAGE = 4;
 	static const int SLOWING_DAMAGE = 5;
 	mutable double damage[6] = {0., 0., 0., 0., 0., 0.};
+	// The damage done by this projectile alone, not counting submunitions.
+	double ownDamage[6] = {0., 0., 0., 0., 0., 0.};
 	
 	double piercing = 0.;
 	
@@ -187,6 +203,7 @@ inline int Weapon::RandomLifetime() const { return randomLifetime; }
 inline double Weapon::Reload() const { return reload; }
 inline double Weapon::BurstReload() const { return burstReload; }
 inline int Weapon::BurstCount() const { return burstCount; }
+inline int Weapon::SubmunitionCount() const { return submunitionCount; }
 inline int Weapon::Homing() const { return homing; }
 
 inline int Weapon::MissileStrength() const { return missileStrength; }
@@ -219,12 +236,12 @@ inline double Weapon::TriggerRadius() const { return triggerRadius; }
 inline double Weapon::BlastRadius() const { return blastRadius; }
 inline double Weapon::HitForce() const { return hitForce; }
 
-inline double Weapon::ShieldDamage() const { return TotalDamage(SHIELD_DAMAGE); }
-inline double Weapon::HullDamage() const { return TotalDamage(HULL_DAMAGE); }
-inline double Weapon::HeatDamage() const { return TotalDamage(HEAT_DAMAGE); }
-inline double Weapon::IonDamage() const { return TotalDamage(ION_DAMAGE); }
-inline double Weapon::DisruptionDamage() const { return TotalDamage(DISRUPTION_DAMAGE); }
-inline double Weapon::SlowingDamage() const { return TotalDamage(SLOWING_DAMAGE); }
+inline double Weapon::ShieldDamage() const { return damage[SHIELD_DAMAGE]; }
+inline double Weapon::HullDamage() const { return damage[HULL_DAMAGE]; }
+inline double Weapon::HeatDamage() const { return damage[HEAT_DAMAGE]; }
+inline double Weapon::IonDamage() const { return damage[ION_DAMAGE]; }
+inline double Weapon::DisruptionDamage() const { return damage[DISRUPTION_DAMAGE]; }
+inline double Weapon::SlowingDamage() const { return damage[SLOWING_DAMAGE]; }
 
 
 
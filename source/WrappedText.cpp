@@ -16,14 +16,44 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Point.h"
 
 #include <cstring>
+#include <map>
+#include <tuple>
 
 using namespace std;
 
+namespace {
+	// Many panels re-wrap the same text every time they are drawn, so keep a
+	// cache of recent results, keyed by the text and all the layout settings.
+	class CacheKey {
+	public:
+		bool operator<(const CacheKey &other) const
+		{
+			return tie(font, wrapWidth, tabWidth, lineHeight, paragraphBreak, alignment, text)
+				< tie(other.font, other.wrapWidth, other.tabWidth, other.lineHeight,
+					other.paragraphBreak, other.alignment, other.text);
+		}
+		
+		const Font *font;
+		int wrapWidth;
+		int tabWidth;
+		int lineHeight;
+		int paragraphBreak;
+		int alignment;
+		string text;
+	};
+	
+	// Once this many results are cached, start a new cache. Anything that is
+	// not used again before that one fills up is dropped.
+	const size_t CACHE_SIZE = 100;
+	map<CacheKey, WrappedText> recent;
+	map<CacheKey, WrappedText> older;
+}
+
 
 
 WrappedText::WrappedText()
 	: font(nullptr), space(0), wrapWidth(1000), tabWidth(0),
-	  lineHeight(0), paragraphBreak(0), alignment(JUSTIFIED), height(0)
+	  lineHeight(0), paragraphBreak(0), alignment(JUSTIFIED), height(0), isCurrent(false)
 {
 }
 
@@ -48,6 +78,7 @@ WrappedText::Align WrappedText::Alignment() const
 void WrappedText::SetAlignment(Align align)
 {
 	alignment = align;
+	isCurrent = false;
 }
 
 
@@ -63,6 +94,7 @@ int WrappedText::WrapWidth() const
 void WrappedText::SetWrapWidth(int width)
 {
 	wrapWidth = width;
+	isCurrent = false;
 }
 
 
@@ -73,6 +105,7 @@ void WrappedText::SetWrapWidth(int width)
 void WrappedText::SetFont(const Font &font)
 {
 	this->font = &font;
+	isCurrent = false;
 	
 	space = font.Space();
 	SetTabWidth(4 * space);
@@ -93,6 +126,7 @@ int WrappedText::TabWidth() const
 void WrappedText::SetTabWidth(int width)
 {
 	tabWidth = width;
+	isCurrent = false;
 }
 
 
@@ -108,6 +142,7 @@ int WrappedText::LineHeight() const
 void WrappedText::SetLineHeight(int height)
 {
 	lineHeight = height;
+	isCurrent = false;
 }
 
 
@@ -123,6 +158,7 @@ int WrappedText::ParagraphBreak() const
 void WrappedText::SetParagraphBreak(int height)
 {
 	paragraphBreak = height;
+	isCurrent = false;
 }
 
 
@@ -131,18 +167,14 @@ void WrappedText::SetParagraphBreak(int height)
 // always begin at (0, 0).
 void WrappedText::Wrap(const string &str)
 {
-	SetText(str.data(), str.length());
-	
-	Wrap();
+	Wrap(str.data(), str.length());
 }
 
 
 
 void WrappedText::Wrap(const char *str)
 {
-	SetText(str, strlen(str));
-	
-	Wrap();
+	Wrap(str, strlen(str));
 }
 
 
@@ -185,6 +217,21 @@ Point WrappedText::Word::Pos() const
 
 
 
+void WrappedText::Wrap(const char *str, size_t length)
+{
+	// Panels that keep a WrappedText usually wrap the same text with the same
+	// settings every frame. In that case, the words are already laid out.
+	if(isCurrent && source.size() == length && !source.compare(0, length, str, length))
+		return;
+	
+	SetText(str, length);
+	Wrap();
+	source.assign(str, length);
+	isCurrent = true;
+}
+
+
+
 void WrappedText::SetText(const char *it, size_t length)
 {
 	// Clear any previous word-wrapping data. It becomes invalid as soon as the
@@ -203,6 +250,30 @@ void WrappedText::Wrap()
 	if(text.empty() || !font)
 		return;
 	
+	CacheKey key{font, wrapWidth, tabWidth, lineHeight, paragraphBreak, alignment, text};
+	auto it = recent.find(key);
+	if(it == recent.end())
+	{
+		if(recent.size() >= CACHE_SIZE)
+		{
+			older.swap(recent);
+			recent.clear();
+		}
+		it = older.find(key);
+		if(it != older.end())
+		{
+			it = recent.insert(*it).first;
+			older.erase(key);
+		}
+	}
+	if(it != recent.end())
+	{
+		text = it->second.text;
+		words = it->second.words;
+		height = it->second.height;
+		return;
+	}
+	
 	// Do this as a finite state machine.
 	Word word;
 	bool hasWord = false;
@@ -286,6 +357,7 @@ void WrappedText::Wrap()
 	AdjustLine(lineBegin, lineWidth, true);
 	
 	height = word.y;
+	recent.emplace(key, *this);
 }
 
 
@@ -68,6 +68,7 @@ public:
 	
 	
 private:
+	void Wrap(const char *str, size_t length);
 	void SetText(const char *it, size_t length);
 	void Wrap();
 	void AdjustLine(unsigned &lineBegin, int &lineWidth, bool isEnd);
@@ -105,6 +106,11 @@ private:
 	std::string text;
 	std::vector<Word> words;
 	int height;
+	
+	// The text as it was given to Wrap(), and whether the words are still laid
+	// out for it with the current settings.
+	std::string source;
+	bool isCurrent;
 };
 
 
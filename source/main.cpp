@@ -18,16 +18,24 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "ConversationPanel.h"
 #include "DataFile.h"
 #include "DataNode.h"
+#include "DataWriter.h"
 #include "Dialog.h"
+#include "Engine.h"
 #include "Files.h"
 #include "Font.h"
 #include "FrameTimer.h"
 #include "GameData.h"
+#include "Headless.h"
 #include "ImageBuffer.h"
+#include "MainPanel.h"
 #include "MenuPanel.h"
 #include "Panel.h"
 #include "PlayerInfo.h"
+#include "Point.h"
 #include "Preferences.h"
+#include "Profiler.h"
+#include "RenderThread.h"
+#include "Replay.h"
 #include "Screen.h"
 #include "SpriteSet.h"
 #include "SpriteShader.h"
@@ -36,6 +44,8 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "gl_header.h"
 #include <SDL2/SDL.h>
 
+#include <algorithm>
+#include <chrono>
 #include <cstring>
 #include <iostream>
 #include <map>
@@ -57,12 +67,24 @@ int DoError(string message, SDL_Window *window = nullptr, SDL_GLContext context
 void Cleanup(SDL_Window *window, SDL_GLContext context);
 Conversation LoadConversation();
 
+namespace {
+	// Frames are never drawn faster than this, even if vsync is not working.
+	const int MAX_FRAME_RATE = 240;
+	// If the game is running this many steps behind, give up on catching up.
+	const int MAX_STEPS_PER_FRAME = 5;
+	// In turbo fast-forward, take as many steps in each frame as can be done in
+	// this many seconds, up to the given limit.
+	const double TURBO_STEP_TIME = .012;
+	const int MAX_TURBO_STEPS = 100;
+}
+
 
 
 int main(int argc, char *argv[])
 {
 	Conversation conversation;
 	bool debugMode = false;
+	string replay;
 	for(const char *const *it = argv + 1; *it; ++it)
 	{
 		string arg = *it;
@@ -80,7 +102,22 @@ int main(int argc, char *argv[])
 			conversation = LoadConversation();
 		else if(arg == "-d" || arg == "--debug")
 			debugMode = true;
+		else if((arg == "-p" || arg == "--profile") && it[1])
+			Profiler::WriteCSV(*++it);
+		else if(arg == "--metrics" && it[1])
+			Profiler::WriteMetrics(*++it);
+		else if(arg == "--state-log" && it[1])
+			Engine::WriteStateLog(*++it);
+		else if(arg == "--record" && it[1])
+			Replay::Record(*++it);
+		else if(arg == "--replay" && it[1])
+			replay = *++it;
 	}
+	// The benchmarks and other tools do not need a window, so run them before
+	// creating one.
+	int status = 0;
+	if(Headless::Run(argv, status))
+		return status;
 	PlayerInfo player;
 	
 	try {
@@ -96,15 +133,20 @@ int main(int argc, char *argv[])
 		timeBeginPeriod(1);
 #endif
 		
-		player.LoadRecent();
-		player.ApplyChanges();
+		// A replay brings its own pilot.
+		if(replay.empty())
+		{
+			player.LoadRecent();
+			player.ApplyChanges();
+		}
+		else if(!Replay::Load(replay, player))
+			return DoError("Unable to load the replay \"" + replay + "\".");
 		
 		// Check how big the window can be.
 		SDL_DisplayMode mode;
 		if(SDL_GetCurrentDisplayMode(0, &mode))
 			return DoError("Unable to query monitor resolution!");
 		
-		Preferences::Load();
 		Uint32 flags = SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_SHOWN | SDL_WINDOW_ALLOW_HIGHDPI;
 		bool isFullscreen = Preferences::Has("fullscreen");
 		if(isFullscreen)
@@ -186,6 +228,7 @@ int main(int argc, char *argv[])
 		glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 		
 		GameData::LoadShaders();
+		RenderThread::Init(window);
 		// Make sure the screen size and viewport are set correctly.
 		AdjustViewport(window);
 #ifndef __APPLE__
@@ -200,7 +243,17 @@ int main(int argc, char *argv[])
 		
 		UI gamePanels;
 		UI menuPanels;
-		menuPanels.Push(new MenuPanel(player, gamePanels));
+		if(Replay::IsPlaying())
+		{
+			// Take off just as the recorded pilot did, skipping the main menu.
+			MainPanel *panel = new MainPanel(player);
+			gamePanels.Push(panel);
+			Replay::Begin(player);
+			player.TakeOff(nullptr);
+			panel->OnCallback();
+		}
+		else
+			menuPanels.Push(new MenuPanel(player, gamePanels));
 		if(!conversation.IsEmpty())
 			menuPanels.Push(new ConversationPanel(player, conversation));
 		
@@ -225,17 +278,27 @@ int main(int argc, char *argv[])
 				"government they belong to. So, all human ships will be the same color, which "
 				"may be confusing. Consider upgrading your graphics driver (or your OS)."));
 		
+		// The game steps forward at a fixed rate, no matter how often frames are
+		// drawn. Frames are drawn as often as the display allows (up to a limit,
+		// in case vsync is not available), and if frames take too long to draw,
+		// the game takes several steps per frame to keep up.
 		int frameRate = 60;
-		FrameTimer timer(frameRate);
+		FrameTimer timer(MAX_FRAME_RATE);
+		chrono::steady_clock::time_point lastFrame = chrono::steady_clock::now();
+		double pendingTime = 0.;
+		int turboSteps = MAX_STEPS_PER_FRAME;
 		bool isPaused = false;
-		// If fast forwarding, keep track of whether the current frame should be drawn.
-		int skipFrame = 0;
+		// If nothing on the screen can have changed, the last frame is left
+		// there instead of drawing the same thing again.
+		const UI *lastDrawn = nullptr;
 		while(!menuPanels.IsDone())
 		{
 			// Handle any events that occurred in this frame.
 			SDL_Event event;
+			bool hadEvents = false;
 			while(SDL_PollEvent(&event))
 			{
+				hadEvents = true;
 				UI &activeUI = (menuPanels.IsEmpty() ? gamePanels : menuPanels);
 				
 				// The caps lock key slows the game down (to make it easier to
@@ -259,6 +322,7 @@ int main(int argc, char *argv[])
 				{
 					// The window has been resized. Adjust the raw screen size
 					// and the OpenGL viewport to match.
+					RenderThread::Acquire();
 					AdjustViewport(window);
 					if(!isFullscreen)
 						SDL_GetWindowSize(window, &windowWidth, &windowHeight);
@@ -270,6 +334,7 @@ int main(int argc, char *argv[])
 					// Toggle full-screen mode. This will generate a window size
 					// change event, so no need to adjust the viewport here.
 					isFullscreen = !isFullscreen;
+					RenderThread::Acquire();
 					if(!isFullscreen)
 					{
 						SDL_SetWindowFullscreen(window, 0);
@@ -286,50 +351,103 @@ int main(int argc, char *argv[])
 			SDL_Keymod mod = SDL_GetModState();
 			Font::ShowUnderlines(mod & KMOD_ALT);
 			
-			// Tell all the panels to step forward, then draw them.
-			((!isPaused && menuPanels.IsEmpty()) ? gamePanels : menuPanels).StepAll();
-			
-			// Caps lock slows the frame rate in debug mode, but raises it in
+			// Caps lock slows the game down in debug mode, but speeds it up in
 			// normal mode. Slowing eases in and out over a couple of frames.
 			bool fastForward = false;
 			if(mod & KMOD_CAPS)
 			{
 				if(debugMode)
-				{
-					if(frameRate > 10)
-					{
-						frameRate = max(frameRate - 5, 10);
-						timer.SetFrameRate(frameRate);
-					}
-				}
+					frameRate = max(frameRate - 5, 10);
 				else
-				{
 					fastForward = true;
-					skipFrame = (skipFrame + 1) % 3;
-					if(skipFrame)
-						continue;
-				}
 			}
 			else if(frameRate < 60)
-			{
 				frameRate = min(frameRate + 5, 60);
-				timer.SetFrameRate(frameRate);
+			double stepTime = 1. / (fastForward ? 3 * frameRate : frameRate);
+			
+			// Tell all the panels to take as many steps as are due, then draw
+			// them. If the game falls too far behind, let it slow down rather
+			// than taking ever more steps to catch up.
+			chrono::steady_clock::time_point now = chrono::steady_clock::now();
+			pendingTime += chrono::duration<double>(now - lastFrame).count();
+			lastFrame = now;
+			Profiler::Scope scope(Profiler::GAME_STEPS);
+			int steps = 0;
+			bool isTurbo = (fastForward && !isPaused && menuPanels.IsEmpty()
+				&& Preferences::Has("Turbo fast-forward"));
+			if(isTurbo)
+			{
+				// Run as many steps as the CPU can keep up with, without waiting
+				// for them to be due. Each step's calculations are only drawn
+				// after the step that follows it, so only the last two steps
+				// need to fill in their lists of things to draw.
+				for( ; steps < turboSteps; ++steps)
+					gamePanels.StepAll(steps + 2 >= turboSteps);
+				pendingTime = 0.;
+				
+				// Adjust the number of steps based on how long they took.
+				double elapsed = chrono::duration<double>(chrono::steady_clock::now() - now).count();
+				if(elapsed < TURBO_STEP_TIME)
+					turboSteps = min(MAX_TURBO_STEPS, turboSteps + 1);
+				else
+					turboSteps = max(MAX_STEPS_PER_FRAME, turboSteps - 2);
+			}
+			for( ; !isTurbo && pendingTime >= stepTime && steps < MAX_STEPS_PER_FRAME; ++steps)
+			{
+				((!isPaused && menuPanels.IsEmpty()) ? gamePanels : menuPanels).StepAll();
+				pendingTime -= stepTime;
 			}
+			if(steps == MAX_STEPS_PER_FRAME)
+				pendingTime = min(pendingTime, stepTime);
+			if(Replay::IsFinished())
+				menuPanels.Quit();
 			
+			scope.Next(Profiler::AUDIO);
 			Audio::Step();
 			// Events in this frame may have cleared out the menu, in which case
-			// we should draw the game panels instead:
-			(menuPanels.IsEmpty() ? gamePanels : menuPanels).DrawAll();
-			if(fastForward)
-				SpriteShader::Draw(SpriteSet::Get("ui/fast forward"), Screen::TopLeft() + Point(10., 10.));
-			
-			SDL_GL_SwapWindow(window);
+			// we should draw the game panels instead. If the game is not moving,
+			// draw it exactly as it is in the last step.
+			scope.Next(Profiler::DRAW_PANELS);
+			// If the last frame is being put on the screen in another thread,
+			// everything up to this point overlapped with it.
+			RenderThread::Acquire();
+			UI &drawnUI = (menuPanels.IsEmpty() ? gamePanels : menuPanels);
+			bool showProfiler = Preferences::Has(Preferences::SHOW_FRAME_PROFILER);
+			// Anything that is still loading may appear on screen once it is
+			// done, so keep drawing until it is.
+			bool redraw = (hadEvents || &drawnUI != lastDrawn || drawnUI.NeedsRedraw()
+				|| showProfiler || fastForward || GameData::Progress() < 1.);
+			if(redraw)
+			{
+				Profiler::GPUScope gpuScope(Profiler::GPU_PANELS);
+				bool isMoving = (!isPaused && menuPanels.IsEmpty());
+				drawnUI.DrawAll(isMoving ? pendingTime / stepTime : 1.);
+				lastDrawn = &drawnUI;
+			}
+			scope.End();
+			if(redraw)
+			{
+				if(showProfiler)
+					Profiler::Draw();
+				if(fastForward)
+					SpriteShader::Draw(SpriteSet::Get("ui/fast forward"), Screen::TopLeft() + Point(10., 10.));
+				
+				RenderThread::Present();
+				// Load any streamed sprites that were drawn for the first time
+				// in this frame, now that the frame is on the screen.
+				GameData::StreamSprites();
+			}
 			timer.Wait();
+			Profiler::EndFrame();
 		}
 		
-		// If you quit while landed on a planet, save the game.
-		if(player.GetPlanet())
+		// If you quit while landed on a planet, save the game. A replay's pilot
+		// is never saved, because that would overwrite the replay.
+		if(player.GetPlanet() && replay.empty())
 			player.Save();
+		// Finish writing any replay that is being recorded, and restore any
+		// preferences that a replay that was being played back changed.
+		Replay::End();
 		
 		// Remember the window state.
 		bool isMaximized = (SDL_GetWindowFlags(window) & SDL_WINDOW_MAXIMIZED);
@@ -339,7 +457,10 @@ int main(int argc, char *argv[])
 		// match the actual window size.
 		Screen::SetRaw(windowWidth, windowHeight);
 		Preferences::Save();
+		// Don't exit until the saved game has been written to disk.
+		DataWriter::FinishSaving();
 		
+		RenderThread::Quit();
 		Cleanup(window, context);
 	}
 	catch(const runtime_error &error)
@@ -363,7 +484,25 @@ void PrintHelp()
 	cerr << "    -t, --talk: read and display a conversation from STDIN." << endl;
 	cerr << "    -r, --resources <path>: load resources from given directory." << endl;
 	cerr << "    -c, --config <path>: save user's files to given directory." << endl;
-	cerr << "    -d, --debug: turn on debugging features (e.g. caps lock slow motion)." << endl;
+	cerr << "    -d, --debug: turn on debugging features (e.g. caps lock slow motion), and report" << endl;
+	cerr << "        how long each step of loading took and how much memory it used. While flying," << endl;
+	cerr << "        F5 reloads any data files that have changed." << endl;
+	cerr << "    -p, --profile <path>: write the time taken by each part of each frame to a CSV file." << endl;
+	cerr << "    --metrics <path>: once a second, write frame time percentiles, object counts, and" << endl;
+	cerr << "        memory use to a file, as one line of JSON." << endl;
+	cerr << "    --convert <from> <to>: convert a saved game between text and binary." << endl;
+	cerr << "    --benchmark <path>: run the scenario in the given file without drawing it, and report" << endl;
+	cerr << "        how long each part of the engine's calculations took." << endl;
+	cerr << "    --simulate <path>: run the battles described in the given file on all cores, without" << endl;
+	cerr << "        drawing them, and report how often each side wins and how long it takes." << endl;
+	cerr << "    --soak <path>: fly a saved pilot around a route of planets for many days, without" << endl;
+	cerr << "        drawing anything, and report how the time each day takes and memory use grow." << endl;
+	cerr << "    --generate-galaxy <count> <path>: write a synthetic galaxy with the given number of" << endl;
+	cerr << "        systems to a data file for a plugin, and print a benchmark scenario that uses it." << endl;
+	cerr << "    --state-log <path>: write a hash of the state of every ship after each step to a file." << endl;
+	cerr << "    --compare-logs <path> <path>: report the first step where two state logs differ." << endl;
+	cerr << "    --record <path>: record the next flight (from taking off until landing) to a file." << endl;
+	cerr << "    --replay <path>: play back a recorded flight." << endl;
 	cerr << endl;
 	cerr << "Report bugs to: mzahniser@gmail.com" << endl;
 	cerr << "Home page: <https://endless-sky.github.io>" << endl;
@@ -427,6 +566,10 @@ void AdjustViewport(SDL_Window *window)
 	int drawWidth, drawHeight;
 	SDL_GL_GetDrawableSize(window, &drawWidth, &drawHeight);
 	Screen::SetHighDPI(drawWidth > width || drawHeight > height);	
+	// The @2x frames of the sprites are not loaded until they are needed, but
+	// on a high DPI screen they will be needed for everything.
+	if(Screen::IsHighResolution())
+		GameData::LoadHighDPI();
 	
 	// Set the viewport to go off the edge of the window, if necessary, to get
 	// everything pixel-aligned.